@@ -111,6 +111,27 @@ struct trie {
 	knot_mm_t mm;
 };
 
+/*!
+ * \brief Copy-on-write transaction.
+ *
+ * The new trie shares all nodes with the old one, until they are modified.
+ * Before any modification, the whole path from the root is unshared, i.e.
+ * every twigs array on the path not allocated in this transaction is copied.
+ * The blocks (twigs arrays and keys) allocated in this transaction are kept
+ * in the \a fresh set, the old blocks dropped from the new trie are kept
+ * in the \a stale set. The sets are tries keyed by block addresses, valued
+ * by the block addresses with the lowest bit set for keys.
+ */
+struct trie_cow {
+	trie_t *old;
+	trie_t *new;
+	trie_t *fresh;
+	trie_t *stale;
+};
+
+/*! \brief Tag of key blocks in copy-on-write sets. */
+#define COW_KEY ((uintptr_t)1)
+
 /*! \brief Make the root node empty (debug-only). */
 static inline void empty_root(node_t *root) {
 #ifndef NDEBUG
@@ -301,7 +322,80 @@ trie_val_t* trie_get_try(trie_t *tbl, const char *key, uint32_t len)
 	return &t->leaf.val;
 }
 
-int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val)
+/*! \brief Test if the key of a leaf is a prefix of the given key. */
+static bool leaf_is_prefix(node_t *t, const char *key, uint32_t len)
+{
+	assert(!isbranch(t));
+	tkey_t *lkey = t->leaf.key;
+	return lkey->len <= len && memcmp(lkey->chars, key, lkey->len) == 0;
+}
+
+trie_val_t* trie_get_lpm(trie_t *tbl, const char *key, uint32_t len)
+{
+	assert(tbl);
+	if (!tbl->weight)
+		return NULL;
+	node_t *t = &tbl->root;
+	node_t *best = NULL;
+	while (isbranch(t)) {
+		__builtin_prefetch(t->branch.twigs);
+		// All keys below are longer than the searched one.
+		if (t->branch.index > len)
+			break;
+		// The end-of-string child is the only key of exactly index length.
+		if (hastwig(t, 1 << 0)) {
+			node_t *prefix = twig(t, 0);
+			// Mismatch in the skipped part, no longer prefix below.
+			if (!leaf_is_prefix(prefix, key, len))
+				break;
+			best = prefix;
+		}
+		bitmap_t b = twigbit(t, key, len);
+		if (b == (1 << 0) || !hastwig(t, b))
+			break;
+		t = twig(t, twigoff(t, b));
+	}
+	if (!isbranch(t) && leaf_is_prefix(t, key, len))
+		best = t;
+	return best != NULL ? &best->leaf.val : NULL;
+}
+
+/*! \brief Add a block to a copy-on-write set. */
+static int cow_set_add(trie_t *set, const void *block, bool is_key)
+{
+	trie_val_t *val = trie_get_ins(set, (const char *)&block, sizeof(block));
+	if (unlikely(!val))
+		return KNOT_ENOMEM;
+	*val = (trie_val_t)((uintptr_t)block | (is_key ? COW_KEY : 0));
+	return KNOT_EOK;
+}
+
+/*! \brief Test if a block is in a copy-on-write set. */
+static bool cow_set_has(trie_t *set, const void *block)
+{
+	return trie_get_try(set, (const char *)&block, sizeof(block)) != NULL;
+}
+
+/*! \brief Remove a block from a copy-on-write set. */
+static void cow_set_del(trie_t *set, const void *block)
+{
+	trie_del(set, (const char *)&block, sizeof(block), NULL);
+}
+
+/*! \brief Free a block of the new trie, or keep it if shared with the old one. */
+static int cow_drop(trie_cow_t *cow, void *block, bool is_key)
+{
+	if (cow_set_has(cow->fresh, block)) {
+		cow_set_del(cow->fresh, block);
+		mm_free(&cow->new->mm, block);
+		return KNOT_EOK;
+	}
+	return cow_set_add(cow->stale, block, is_key);
+}
+
+/*! \brief Remove an item, optionally within a copy-on-write transaction. */
+static int del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val,
+               trie_cow_t *cow)
 {
 	assert(tbl);
 	if (!tbl->weight)
@@ -319,14 +413,22 @@ int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val)
 	}
 	if (key_cmp(key, len, t->leaf.key->chars, t->leaf.key->len) != 0)
 		return KNOT_ENOENT;
-	mm_free(&tbl->mm, t->leaf.key);
+	int ret = KNOT_EOK;
+	if (cow) {
+		// Only the key may still be used by the old trie.
+		bool shared = !cow_set_has(cow->fresh, t->leaf.key);
+		ERR_RETURN(cow_drop(cow, t->leaf.key, true));
+		ret = shared ? KNOT_EOK : 1;
+	} else {
+		mm_free(&tbl->mm, t->leaf.key);
+	}
 	if (val != NULL)
 		*val = t->leaf.val; // we return trie_val_t directly when deleting
 	--tbl->weight;
 	if (unlikely(!p)) { // whole trie was a single leaf
 		assert(tbl->weight == 0);
 		empty_root(&tbl->root);
-		return KNOT_EOK;
+		return ret;
 	}
 	// remove leaf t as child of p
 	int ci = t - p->twigs, // child index via pointer arithmetic
@@ -336,18 +438,31 @@ int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val)
 	if (cc == 2) { // collapse binary node p: move the other child to this node
 		node_t *twigs = p->twigs;
 		(*(node_t *)p) = twigs[1 - ci]; // it might be a leaf or branch
+		if (cow) {
+			// Path is unshared, the twigs are fresh.
+			cow_set_del(cow->fresh, twigs);
+		}
 		mm_free(&tbl->mm, twigs);
-		return KNOT_EOK;
+		return ret;
 	}
 	memmove(p->twigs + ci, p->twigs + ci + 1, sizeof(node_t) * (cc - ci - 1));
 	p->bitmap &= ~b;
+	if (cow) {
+		// Don't shrink, the new address would have to be tracked.
+		return ret;
+	}
 	node_t *twigs = mm_realloc(&tbl->mm, p->twigs, sizeof(node_t) * (cc - 1),
 	                           sizeof(node_t) * cc);
 	if (likely(twigs != NULL))
 		p->twigs = twigs;
 		/* We can ignore mm_realloc failure, only beware that next time
 		 * the prev_size passed to it wouldn't be correct; TODO? */
-	return KNOT_EOK;
+	return ret;
+}
+
+int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val)
+{
+	return del(tbl, key, len, val, NULL);
 }
 
 /*!
@@ -552,7 +667,7 @@ static int ns_prev_leaf(nstack_t *ns)
 	assert(ns && ns->len > 0);
 
 	node_t *t = ns->stack[ns->len - 1];
-	if (hastwig(t, 1 << 0)) { // the prefix leaf
+	if (isbranch(t) && hastwig(t, 1 << 0)) { // the prefix leaf
 		t = twig(t, 0);
 		ERR_RETURN(ns_longer(ns));
 		ns->stack[ns->len++] = t;
@@ -605,27 +720,23 @@ static int ns_next_leaf(nstack_t *ns)
 	} while (true);
 }
 
-int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val)
+/*!
+ * \brief Advance the node stack to the less-or-equal leaf.
+ *
+ * \return KNOT_EOK for exact match, 1 for previous, KNOT_ENOENT for not-found,
+ *         or KNOT_ENOMEM.
+ */
+static int ns_get_leq(nstack_t *ns, const char *key, uint32_t len)
 {
-	assert(tbl && val);
-	*val = NULL; // so on failure we can just return;
-	if (tbl->weight == 0)
-		return KNOT_ENOENT;
-	{ // Intentionally un-indented; until end of function, to bound cleanup attr.
+	assert(ns && ns->len);
 	// First find a key with longest-matching prefix
-	__attribute__((cleanup(ns_cleanup)))
-		nstack_t ns_local;
-	ns_init(&ns_local, tbl);
-	nstack_t *ns = &ns_local;
 	branch_t bp;
 	int un_leaf; // first unmatched character in the leaf
 	ERR_RETURN(ns_find_branch(ns, key, len, &bp, &un_leaf));
 	int un_key = bp.index < len ? key[bp.index] : -256;
 	node_t *t = ns->stack[ns->len - 1];
-	if (bp.flags == 0) { // found exact match
-		*val = &t->leaf.val;
+	if (bp.flags == 0) // found exact match
 		return KNOT_EOK;
-	}
 	// Get t: the last node on matching path
 	if (isbranch(t) && t->branch.index == bp.index && t->branch.flags == bp.flags) {
 		// t is OK
@@ -636,7 +747,7 @@ int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val)
 			if (un_key < un_leaf)
 				return KNOT_ENOENT;
 			ERR_RETURN(ns_last_leaf(ns));
-			goto success;
+			return 1;
 		}
 		--ns->len;
 		t = ns->stack[ns->len - 1];
@@ -654,10 +765,25 @@ int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val)
 	} else {
 		ERR_RETURN(ns_prev_leaf(ns));
 	}
-success:
 	assert(!isbranch(ns->stack[ns->len - 1]));
-	*val = &ns->stack[ns->len - 1]->leaf.val;
 	return 1;
+}
+
+int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val)
+{
+	assert(tbl && val);
+	*val = NULL; // so on failure we can just return;
+	if (tbl->weight == 0)
+		return KNOT_ENOENT;
+	{ // Intentionally un-indented; until end of function, to bound cleanup attr.
+	__attribute__((cleanup(ns_cleanup)))
+		nstack_t ns_local;
+	ns_init(&ns_local, tbl);
+	nstack_t *ns = &ns_local;
+	int ret = ns_get_leq(ns, key, len);
+	if (ret == KNOT_EOK || ret == 1)
+		*val = &ns->stack[ns->len - 1]->leaf.val;
+	return ret;
 	}
 }
 
@@ -682,12 +808,36 @@ static int mk_leaf(node_t *leaf, const char *key, uint32_t len, knot_mm_t *mm)
 	return KNOT_EOK;
 }
 
-trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
+/*! \brief Initialize a new leaf, tracking the key in a copy-on-write transaction. */
+static int mk_leaf_cow(node_t *leaf, const char *key, uint32_t len, knot_mm_t *mm,
+                       trie_cow_t *cow)
+{
+	ERR_RETURN(mk_leaf(leaf, key, len, mm));
+	if (cow && unlikely(cow_set_add(cow->fresh, leaf->leaf.key, true))) {
+		mm_free(mm, leaf->leaf.key);
+		return KNOT_ENOMEM;
+	}
+	return KNOT_EOK;
+}
+
+/*! \brief Allocate twigs, tracking them in a copy-on-write transaction. */
+static node_t* alloc_twigs(uint count, knot_mm_t *mm, trie_cow_t *cow)
+{
+	node_t *twigs = mm_alloc(mm, sizeof(node_t) * count);
+	if (cow && twigs && unlikely(cow_set_add(cow->fresh, twigs, false))) {
+		mm_free(mm, twigs);
+		return NULL;
+	}
+	return twigs;
+}
+
+/*! \brief Search the trie, inserting on failure, optionally within a copy-on-write. */
+static trie_val_t* get_ins(trie_t *tbl, const char *key, uint32_t len, trie_cow_t *cow)
 {
 	assert(tbl);
 	// First leaf in an empty tbl?
 	if (unlikely(!tbl->weight)) {
-		if (unlikely(mk_leaf(&tbl->root, key, len, &tbl->mm)))
+		if (unlikely(mk_leaf_cow(&tbl->root, key, len, &tbl->mm, cow)))
 			return NULL;
 		++tbl->weight;
 		return &tbl->root.leaf.val;
@@ -706,7 +856,7 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
 	if (bp.flags == 0) // the same key was already present
 		return &t->leaf.val;
 	node_t leaf;
-	if (unlikely(mk_leaf(&leaf, key, len, &tbl->mm)))
+	if (unlikely(mk_leaf_cow(&leaf, key, len, &tbl->mm, cow)))
 		return NULL;
 
 	if (isbranch(t) && bp.index == t->branch.index && bp.flags == t->branch.flags) {
@@ -714,10 +864,21 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
 		bitmap_t b1 = twigbit(t, key, len);
 		assert(!hastwig(t, b1));
 		uint s, m; TWIGOFFMAX(s, m, t, b1); // new child position and original child count
-		node_t *twigs = mm_realloc(&tbl->mm, t->branch.twigs,
-				sizeof(node_t) * (m + 1), sizeof(node_t) * m);
-		if (unlikely(!twigs))
-			goto err_leaf;
+		node_t *twigs;
+		if (cow) {
+			// The twigs are fresh, but reallocation would move them untracked.
+			twigs = alloc_twigs(m + 1, &tbl->mm, cow);
+			if (unlikely(!twigs))
+				goto err_leaf;
+			memcpy(twigs, t->branch.twigs, sizeof(node_t) * m);
+			cow_set_del(cow->fresh, t->branch.twigs);
+			mm_free(&tbl->mm, t->branch.twigs);
+		} else {
+			twigs = mm_realloc(&tbl->mm, t->branch.twigs,
+			                   sizeof(node_t) * (m + 1), sizeof(node_t) * m);
+			if (unlikely(!twigs))
+				goto err_leaf;
+		}
 		memmove(twigs + s + 1, twigs + s, sizeof(node_t) * (m - s));
 		twigs[s] = leaf;
 		t->branch.twigs = twigs;
@@ -733,7 +894,7 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
 				assert(hastwig(pt, twigbit(pt, key, len)));
 			}
 		#endif
-		node_t *twigs = mm_alloc(&tbl->mm, sizeof(node_t) * 2);
+		node_t *twigs = alloc_twigs(2, &tbl->mm, cow);
 		if (unlikely(!twigs))
 			goto err_leaf;
 		node_t t2 = *t; // Save before overwriting t.
@@ -749,11 +910,101 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
 		return &twig(t, twigoff(t, b1))->leaf.val;
 	};
 err_leaf:
+	if (cow)
+		cow_set_del(cow->fresh, leaf.leaf.key);
 	mm_free(&tbl->mm, leaf.leaf.key);
 	return NULL;
 	}
 }
 
+trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
+{
+	return get_ins(tbl, key, len, NULL);
+}
+
+/*!
+ * \brief Build a subtrie of sorted keys at node t, a recursive solution.
+ *
+ * All the keys are identical up to the index \a from.
+ */
+static int load_sorted(node_t *t, const char *keys[], const uint32_t lens[],
+                       const trie_val_t vals[], size_t count, uint32_t from,
+                       knot_mm_t *mm)
+{
+	assert(count > 0);
+	if (count == 1) {
+		ERR_RETURN(mk_leaf(t, keys[0], lens[0], mm));
+		t->leaf.val = vals[0];
+		return KNOT_EOK;
+	}
+	// The first and the last key differ first, the others are in between.
+	const char *k1 = keys[0], *k2 = keys[count - 1];
+	uint32_t len1 = lens[0], len2 = lens[count - 1];
+	uint32_t index = from;
+	while (index < MIN(len1, len2) && k1[index] == k2[index])
+		++index;
+	assert(index < len2); // keys are unique and ascending
+	uint flags = 1; // also if k1 is prefix of the others
+	if (index < len1 && !(((byte)k1[index] ^ (byte)k2[index]) & 0xf0))
+		flags = 2;
+	node_t branch = { .branch = {
+		.flags = flags,
+		.bitmap = 0,
+		.index = index,
+		.twigs = NULL
+	} };
+	// The keys of each twig are contiguous, in the order of twigs.
+	uint twig_count = 0;
+	for (size_t i = 0; i < count; ++i) {
+		bitmap_t b = twigbit(&branch, keys[i], lens[i]);
+		if (!hastwig(&branch, b)) {
+			branch.branch.bitmap |= b;
+			++twig_count;
+		}
+	}
+	node_t *twigs = mm_alloc(mm, sizeof(node_t) * twig_count);
+	if (unlikely(!twigs))
+		return KNOT_ENOMEM;
+	size_t first = 0;
+	for (uint i = 0; i < twig_count; ++i) {
+		bitmap_t b = twigbit(&branch, keys[first], lens[first]);
+		size_t last = first + 1;
+		while (last < count && twigbit(&branch, keys[last], lens[last]) == b)
+			++last;
+		int ret = load_sorted(twigs + i, keys + first, lens + first,
+		                      vals + first, last - first, index, mm);
+		if (unlikely(ret != KNOT_EOK)) {
+			for (uint j = 0; j < i; ++j)
+				clear_trie(twigs + j, mm);
+			mm_free(mm, twigs);
+			return ret;
+		}
+		first = last;
+	}
+	assert(first == count);
+	branch.branch.twigs = twigs;
+	*t = branch;
+	return KNOT_EOK;
+}
+
+int trie_load_sorted(trie_t *tbl, const char *keys[], const uint32_t lens[],
+                     const trie_val_t vals[], size_t count)
+{
+	assert(tbl);
+	if (tbl->weight != 0)
+		return KNOT_EINVAL;
+	if (count == 0)
+		return KNOT_EOK;
+	assert(keys && lens && vals);
+	for (size_t i = 1; i < count; ++i) {
+		if (key_cmp(keys[i - 1], lens[i - 1], keys[i], lens[i]) >= 0)
+			return KNOT_EINVAL;
+	}
+	ERR_RETURN(load_sorted(&tbl->root, keys, lens, vals, count, 0, &tbl->mm));
+	tbl->weight = count;
+	return KNOT_EOK;
+}
+
 /*! \brief Apply a function to every trie_val_t*, in order; a recursive solution. */
 static int apply_trie(node_t *t, int (*f)(trie_val_t *, void *), void *d)
 {
@@ -792,6 +1043,50 @@ trie_it_t* trie_it_begin(trie_t *tbl)
 	return it;
 }
 
+trie_it_t* trie_it_begin_leq(trie_t *tbl, const char *key, uint32_t len)
+{
+	assert(tbl);
+	trie_it_t *it = malloc(sizeof(nstack_t));
+	if (!it)
+		return NULL;
+	ns_init(it, tbl);
+	if (it->len == 0) // empty tbl
+		return it;
+	int ret = ns_get_leq(it, key, len);
+	if (ret == KNOT_ENOENT) {
+		it->len = 0;
+	} else if (ret != KNOT_EOK && ret != 1) {
+		ns_cleanup(it);
+		free(it);
+		return NULL;
+	}
+	return it;
+}
+
+trie_it_t* trie_it_begin_last(trie_t *tbl)
+{
+	assert(tbl);
+	trie_it_t *it = malloc(sizeof(nstack_t));
+	if (!it)
+		return NULL;
+	ns_init(it, tbl);
+	if (it->len == 0) // empty tbl
+		return it;
+	if (ns_last_leaf(it)) {
+		ns_cleanup(it);
+		free(it);
+		return NULL;
+	}
+	return it;
+}
+
+void trie_it_prev(trie_it_t *it)
+{
+	assert(it && it->len);
+	if (ns_prev_leaf(it) != KNOT_EOK)
+		it->len = 0;
+}
+
 void trie_it_next(trie_it_t *it)
 {
 	assert(it && it->len);
@@ -831,3 +1126,154 @@ trie_val_t* trie_it_val(trie_it_t *it)
 	assert(!isbranch(t));
 	return &t->leaf.val;
 }
+
+trie_cow_t* trie_cow(trie_t *old)
+{
+	assert(old);
+	trie_cow_t *cow = mm_alloc(&old->mm, sizeof(trie_cow_t));
+	if (!cow)
+		return NULL;
+	cow->old = old;
+	cow->new = trie_create(&old->mm);
+	cow->fresh = trie_create(NULL);
+	cow->stale = trie_create(NULL);
+	if (!cow->new || !cow->fresh || !cow->stale) {
+		trie_free(cow->stale);
+		trie_free(cow->fresh);
+		mm_free(&old->mm, cow->new);
+		mm_free(&old->mm, cow);
+		return NULL;
+	}
+	cow->new->root = old->root;
+	cow->new->weight = old->weight;
+	return cow;
+}
+
+trie_t* trie_cow_new(trie_cow_t *cow)
+{
+	assert(cow);
+	return cow->new;
+}
+
+/*! \brief Make the twigs of a branch of the new trie not shared with the old one. */
+static int cow_unshare(trie_cow_t *cow, node_t *t)
+{
+	assert(isbranch(t));
+	node_t *twigs = t->branch.twigs;
+	if (cow_set_has(cow->fresh, twigs))
+		return KNOT_EOK;
+	uint count = bitmap_weight(t->branch.bitmap);
+	node_t *copy = alloc_twigs(count, &cow->new->mm, cow);
+	if (unlikely(!copy))
+		return KNOT_ENOMEM;
+	if (unlikely(cow_set_add(cow->stale, twigs, false))) {
+		cow_set_del(cow->fresh, copy);
+		mm_free(&cow->new->mm, copy);
+		return KNOT_ENOMEM;
+	}
+	memcpy(copy, twigs, sizeof(node_t) * count);
+	t->branch.twigs = copy;
+	return KNOT_EOK;
+}
+
+/*! \brief Unshare the search path of a key, as walked by ns_find_branch(). */
+static int cow_unshare_path(trie_cow_t *cow, const char *key, uint32_t len)
+{
+	if (!cow->new->weight)
+		return KNOT_EOK;
+	node_t *t = &cow->new->root;
+	while (isbranch(t)) {
+		ERR_RETURN(cow_unshare(cow, t));
+		bitmap_t b = twigbit(t, key, len);
+		uint i = hastwig(t, b) ? twigoff(t, b) : 0;
+		t = twig(t, i);
+	}
+	return KNOT_EOK;
+}
+
+trie_val_t* trie_get_cow(trie_cow_t *cow, const char *key, uint32_t len)
+{
+	assert(cow);
+	if (unlikely(cow_unshare_path(cow, key, len)))
+		return NULL;
+	return get_ins(cow->new, key, len, cow);
+}
+
+int trie_del_cow(trie_cow_t *cow, const char *key, uint32_t len, trie_val_t *val)
+{
+	assert(cow);
+	ERR_RETURN(cow_unshare_path(cow, key, len));
+	return del(cow->new, key, len, val, cow);
+}
+
+/*! \brief Context for releasing the blocks of a copy-on-write set. */
+typedef struct {
+	trie_t *tbl;
+	trie_cb *cb;
+	void *d;
+} cow_release_t;
+
+/*! \brief Report the value of the leaf with a key from the set. */
+static int cow_release_val(trie_val_t *block, void *d)
+{
+	cow_release_t *ctx = d;
+	uintptr_t addr = (uintptr_t)*block;
+	if (addr & COW_KEY) {
+		tkey_t *key = (tkey_t *)(addr & ~COW_KEY);
+		trie_val_t *val = trie_get_try(ctx->tbl, key->chars, key->len);
+		assert(val);
+		ctx->cb(*val, ctx->d);
+	}
+	return KNOT_EOK;
+}
+
+/*! \brief Free a block from the set. */
+static int cow_release_block(trie_val_t *block, void *d)
+{
+	cow_release_t *ctx = d;
+	mm_free(&ctx->tbl->mm, (void *)((uintptr_t)*block & ~COW_KEY));
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Free the blocks of a set, used only by the given trie.
+ *
+ * The values are reported first, as the trie must remain searchable.
+ */
+static void cow_release(trie_t *set, trie_t *tbl, trie_cb *cb, void *d)
+{
+	cow_release_t ctx = { .tbl = tbl, .cb = cb, .d = d };
+	if (cb)
+		(void)trie_apply(set, cow_release_val, &ctx);
+	(void)trie_apply(set, cow_release_block, &ctx);
+}
+
+/*! \brief Free the transaction, except for the tries. */
+static void cow_free(trie_cow_t *cow)
+{
+	knot_mm_t mm = cow->old->mm;
+	trie_free(cow->fresh);
+	trie_free(cow->stale);
+	mm_free(&mm, cow);
+}
+
+trie_t* trie_cow_commit(trie_cow_t *cow, trie_cb *cb, void *d)
+{
+	assert(cow);
+	trie_t *ret = cow->new;
+	cow_release(cow->stale, cow->old, cb, d);
+	mm_free(&cow->old->mm, cow->old);
+	cow->old = ret; // for cow_free()
+	cow_free(cow);
+	return ret;
+}
+
+trie_t* trie_cow_rollback(trie_cow_t *cow, trie_cb *cb, void *d)
+{
+	assert(cow);
+	trie_t *ret = cow->old;
+	cow_release(cow->fresh, cow->new, cb, d);
+	mm_free(&cow->new->mm, cow->new);
+	cow_free(cow);
+	return ret;
+}
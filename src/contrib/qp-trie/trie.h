@@ -39,6 +39,12 @@ typedef struct trie trie_t;
 /*! \brief Opaque type for holding a QP-trie iterator. */
 typedef struct trie_it trie_it_t;
 
+/*! \brief Opaque type for holding a copy-on-write transaction. */
+typedef struct trie_cow trie_cow_t;
+
+/*! \brief Callback for values dropped by a copy-on-write commit or rollback. */
+typedef void trie_cb(trie_val_t val, void *d);
+
 /*! \brief Create a trie instance. */
 trie_t* trie_create(knot_mm_t *mm);
 
@@ -57,6 +63,22 @@ trie_val_t* trie_get_try(trie_t *tbl, const char *key, uint32_t len);
 /*! \brief Search the trie, inserting NULL trie_val_t on failure. */
 trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len);
 
+/*!
+ * \brief Fill an empty trie with keys in ascending order at once.
+ *
+ * The trie structure is built directly, without searching for the insertion
+ * point of each key, which is much faster for many keys.
+ *
+ * \param keys   Keys, strictly ascending in the order of iteration.
+ * \param lens   Key lengths.
+ * \param vals   Values of the keys.
+ * \param count  Number of keys.
+ * \return KNOT_EOK, KNOT_EINVAL if the trie is not empty or the keys are not
+ *         unique and ascending, or KNOT_ENOMEM.
+ */
+int trie_load_sorted(trie_t *tbl, const char *keys[], const uint32_t lens[],
+                     const trie_val_t vals[], size_t count);
+
 /*!
  * \brief Search for less-or-equal element.
  *
@@ -69,6 +91,15 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len);
  */
 int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val);
 
+/*!
+ * \brief Search for the longest key which is a prefix of the searched key.
+ *
+ * The whole key is also considered its own prefix.
+ *
+ * \return Value of the longest prefix key or NULL if none found.
+ */
+trie_val_t* trie_get_lpm(trie_t *tbl, const char *key, uint32_t len);
+
 /*!
  * \brief Apply a function to every trie_val_t, in order.
  *
@@ -86,6 +117,16 @@ int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val);
 /*! \brief Create a new iterator pointing to the first element (if any). */
 trie_it_t* trie_it_begin(trie_t *tbl);
 
+/*!
+ * \brief Create a new iterator pointing to the less-or-equal element.
+ *
+ * The iterator is finished if there is no such element.
+ */
+trie_it_t* trie_it_begin_leq(trie_t *tbl, const char *key, uint32_t len);
+
+/*! \brief Create a new iterator pointing to the last element (if any). */
+trie_it_t* trie_it_begin_last(trie_t *tbl);
+
 /*!
  * \brief Advance the iterator to the next element.
  *
@@ -94,6 +135,9 @@ trie_it_t* trie_it_begin(trie_t *tbl);
  */
 void trie_it_next(trie_it_t *it);
 
+/*! \brief Move the iterator to the previous element (finished if none). */
+void trie_it_prev(trie_it_t *it);
+
 /*! \brief Test if the iterator has gone past the last element. */
 bool trie_it_finished(trie_it_t *it);
 
@@ -110,3 +154,59 @@ const char* trie_it_key(trie_it_t *it, size_t *len);
 
 /*! \brief Return pointer to the value of the current element (writable). */
 trie_val_t* trie_it_val(trie_it_t *it);
+
+/*!
+ * \brief Start a copy-on-write transaction.
+ *
+ * A new version of the trie is created, sharing all nodes with the old one.
+ * Only the paths to modified keys are copied, so the old version is not
+ * affected by any change and it can be still read by other threads.
+ * The old version must not be modified until the transaction is finished.
+ *
+ * \return Transaction or NULL on allocation failure.
+ */
+trie_cow_t* trie_cow(trie_t *old);
+
+/*!
+ * \brief Return the new version of the trie.
+ *
+ * \note It may be read, but it must be modified only by trie_get_cow()
+ *       and trie_del_cow() until the transaction is finished.
+ */
+trie_t* trie_cow_new(trie_cow_t *cow);
+
+/*! \brief Search the new version, inserting NULL trie_val_t on failure. */
+trie_val_t* trie_get_cow(trie_cow_t *cow, const char *key, uint32_t len);
+
+/*!
+ * \brief Remove an item from the new version.
+ *
+ * If val!=NULL and deletion succeeded, the deleted value is set.
+ *
+ * \return KNOT_EOK if the item is still in the old version, 1 if it was
+ *         inserted within the transaction, KNOT_ENOENT if not found,
+ *         or KNOT_E*.
+ */
+int trie_del_cow(trie_cow_t *cow, const char *key, uint32_t len, trie_val_t *val);
+
+/*!
+ * \brief Finish the transaction, keeping the new version.
+ *
+ * The nodes used only by the old version are freed, including the old trie.
+ *
+ * \param cb  Optional callback for values of the items only in the old version.
+ *
+ * \return The new version of the trie.
+ */
+trie_t* trie_cow_commit(trie_cow_t *cow, trie_cb *cb, void *d);
+
+/*!
+ * \brief Finish the transaction, keeping the old version.
+ *
+ * The nodes used only by the new version are freed, including the new trie.
+ *
+ * \param cb  Optional callback for values of the items only in the new version.
+ *
+ * \return The old version of the trie.
+ */
+trie_t* trie_cow_rollback(trie_cow_t *cow, trie_cb *cb, void *d);
@@ -155,6 +155,23 @@ int dnssec_nsec3_hash(const dnssec_binary_t *data,
 		      const dnssec_nsec3_params_t *params,
 		      dnssec_binary_t *hash);
 
+/*!
+ * Compute NSEC3 hashes for a batch of data.
+ *
+ * The hashes are computed by several at once, which is faster than hashing
+ * the data one by one.
+ *
+ * \param[in]  data    Array of data to be hashed (usually domain names).
+ * \param[in]  count   Number of items in the data.
+ * \param[in]  params  NSEC3 parameters.
+ * \param[out] hashes  Array of computed hashes (will be allocated or resized).
+ *
+ * \return Error code, DNSSEC_EOK if successful.
+ */
+int dnssec_nsec3_hash_batch(const dnssec_binary_t *data, size_t count,
+			    const dnssec_nsec3_params_t *params,
+			    dnssec_binary_t *hashes);
+
 /*!
  * Get length of raw NSEC3 hash for a given algorithm.
  *
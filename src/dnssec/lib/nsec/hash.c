@@ -21,9 +21,15 @@
 
 #include "error.h"
 #include "nsec.h"
+#include "nsec/sha1.h"
 #include "shared.h"
 #include "wire.h"
 
+/*!
+ * Maximal size of hashed data and salt hashed by native SHA-1.
+ */
+#define NATIVE_INPUT_MAX 512
+
 /*!
  * Compute NSEC3 hash for given data and algorithm.
  *
@@ -78,6 +84,97 @@ static int nsec3_hash(gnutls_digest_algorithm_t algorithm, int iterations,
 	return DNSSEC_EOK;
 }
 
+/*!
+ * Compute NSEC3 SHA-1 hashes for a group of data, using one lane for each.
+ */
+static void nsec3_hash_lanes(int iterations, const dnssec_binary_t *salt,
+			     const dnssec_binary_t *data[], size_t count,
+			     dnssec_binary_t *hashes[])
+{
+	assert(count <= SHA1_LANES);
+
+	uint8_t buffers[SHA1_LANES][SHA1_PADDED_SIZE(NATIVE_INPUT_MAX)];
+	const uint8_t *messages[SHA1_LANES];
+	size_t sizes[SHA1_LANES] = { 0 };
+	uint8_t *digests[SHA1_LANES];
+
+	for (size_t i = 0; i < count; i++) {
+		uint8_t *buffer = buffers[i];
+		memcpy(buffer, data[i]->data, data[i]->size);
+		memcpy(buffer + data[i]->size, salt->data, salt->size);
+
+		messages[i] = buffer;
+		sizes[i] = sha1_pad(buffer, data[i]->size + salt->size);
+		digests[i] = hashes[i]->data;
+	}
+
+	sha1_lanes(messages, sizes, count, digests);
+
+	if (iterations == 0) {
+		return;
+	}
+
+	// the iterated messages differ only in the previous digest
+	for (size_t i = 0; i < count; i++) {
+		uint8_t *buffer = buffers[i];
+		memcpy(buffer + SHA1_DIGEST_SIZE, salt->data, salt->size);
+		sizes[i] = sha1_pad(buffer, SHA1_DIGEST_SIZE + salt->size);
+	}
+
+	for (int round = 0; round < iterations; round++) {
+		for (size_t i = 0; i < count; i++) {
+			memcpy(buffers[i], digests[i], SHA1_DIGEST_SIZE);
+		}
+		sha1_lanes(messages, sizes, count, digests);
+	}
+}
+
+/*!
+ * Compute NSEC3 SHA-1 hashes for given data, SHA1_LANES at once.
+ *
+ * A single remaining item is hashed by GnuTLS, which is faster for one
+ * message if hardware SHA-1 instructions are available.
+ */
+static int nsec3_hash_sha1(int iterations, const dnssec_binary_t *salt,
+			   const dnssec_binary_t *data, size_t count,
+			   dnssec_binary_t *hashes)
+{
+	const dnssec_binary_t *lane_data[SHA1_LANES];
+	dnssec_binary_t *lane_hashes[SHA1_LANES];
+	size_t lanes = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		int result = dnssec_binary_resize(&hashes[i], SHA1_DIGEST_SIZE);
+		if (result != DNSSEC_EOK) {
+			return result;
+		}
+
+		// last single item or oversized input for the native buffers
+		if (data[i].size + salt->size > NATIVE_INPUT_MAX ||
+		    (lanes == 0 && i + 1 == count)) {
+			result = nsec3_hash(GNUTLS_DIG_SHA1, iterations, salt,
+					    &data[i], &hashes[i]);
+			if (result != DNSSEC_EOK) {
+				return result;
+			}
+			continue;
+		}
+
+		lane_data[lanes] = &data[i];
+		lane_hashes[lanes] = &hashes[i];
+		if (++lanes == SHA1_LANES) {
+			nsec3_hash_lanes(iterations, salt, lane_data, lanes, lane_hashes);
+			lanes = 0;
+		}
+	}
+
+	if (lanes > 0) {
+		nsec3_hash_lanes(iterations, salt, lane_data, lanes, lane_hashes);
+	}
+
+	return DNSSEC_EOK;
+}
+
 /*!
  * Get GnuTLS digest algorithm from DNSSEC algorithm number.
  */
@@ -99,7 +196,18 @@ int dnssec_nsec3_hash(const dnssec_binary_t *data,
 		      const dnssec_nsec3_params_t *params,
 		      dnssec_binary_t *hash)
 {
-	if (!data || !params || !hash) {
+	return dnssec_nsec3_hash_batch(data, 1, params, hash);
+}
+
+/*!
+ * Compute NSEC3 hashes for a batch of data.
+ */
+_public_
+int dnssec_nsec3_hash_batch(const dnssec_binary_t *data, size_t count,
+			    const dnssec_nsec3_params_t *params,
+			    dnssec_binary_t *hashes)
+{
+	if (!data || !params || !hashes) {
 		return DNSSEC_EINVAL;
 	}
 
@@ -108,7 +216,9 @@ int dnssec_nsec3_hash(const dnssec_binary_t *data,
 		return DNSSEC_INVALID_NSEC3_ALGORITHM;
 	}
 
-	return nsec3_hash(algorithm, params->iterations, &params->salt, data, hash);
+	assert(algorithm == GNUTLS_DIG_SHA1);
+	return nsec3_hash_sha1(params->iterations, &params->salt, data, count,
+			       hashes);
 }
 
 /*!
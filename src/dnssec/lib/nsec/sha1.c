@@ -0,0 +1,151 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <string.h>
+
+#include "nsec/sha1.h"
+
+/*!
+ * One 32-bit word of each lane.
+ */
+typedef uint32_t word_t __attribute__((vector_size(SHA1_LANES * sizeof(uint32_t))));
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define F1(b, c, d) (((b) & (c)) | (~(b) & (d)))
+#define F2(b, c, d) ((b) ^ (c) ^ (d))
+#define F3(b, c, d) (((b) & (c)) | ((b) & (d)) | ((c) & (d)))
+
+#define K1 0x5a827999
+#define K2 0x6ed9eba1
+#define K3 0x8f1bbcdc
+#define K4 0xca62c1d6
+
+#define ROUND(F, K, t) { \
+	if ((t) >= 16) { \
+		w[(t) & 15] = ROTL(w[((t) + 13) & 15] ^ w[((t) + 8) & 15] ^ \
+		                   w[((t) + 2) & 15] ^ w[(t) & 15], 1); \
+	} \
+	word_t tmp = ROTL(a, 5) + F(b, c, d) + e + K + w[(t) & 15]; \
+	e = d; d = c; c = ROTL(b, 30); b = a; a = tmp; \
+}
+
+#define ROUNDS4(F, K, t) \
+	ROUND(F, K, (t)); ROUND(F, K, (t) + 1); ROUND(F, K, (t) + 2); ROUND(F, K, (t) + 3);
+#define ROUNDS20(F, K, t) \
+	ROUNDS4(F, K, (t)); ROUNDS4(F, K, (t) + 4); ROUNDS4(F, K, (t) + 8); \
+	ROUNDS4(F, K, (t) + 12); ROUNDS4(F, K, (t) + 16);
+
+static void compress(word_t state[5], word_t w[16])
+{
+	word_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+	ROUNDS20(F1, K1, 0);
+	ROUNDS20(F2, K2, 20);
+	ROUNDS20(F3, K3, 40);
+	ROUNDS20(F2, K4, 60);
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+static uint32_t read_u32(const uint8_t *data)
+{
+	return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 |
+	       (uint32_t)data[2] << 8  | (uint32_t)data[3];
+}
+
+static void write_u32(uint8_t *data, uint32_t value)
+{
+	data[0] = value >> 24;
+	data[1] = value >> 16;
+	data[2] = value >> 8;
+	data[3] = value;
+}
+
+size_t sha1_pad(uint8_t *buffer, size_t size)
+{
+	assert(buffer);
+
+	size_t padded = SHA1_PADDED_SIZE(size);
+	uint64_t bits = (uint64_t)size * 8;
+
+	buffer[size] = 0x80;
+	memset(buffer + size + 1, 0, padded - size - 9);
+	write_u32(buffer + padded - 8, bits >> 32);
+	write_u32(buffer + padded - 4, bits);
+
+	return padded;
+}
+
+void sha1_lanes(const uint8_t *messages[], const size_t sizes[], size_t count,
+		uint8_t *digests[])
+{
+	assert(messages);
+	assert(sizes);
+	assert(count <= SHA1_LANES);
+	assert(digests);
+
+	word_t state[5];
+	const uint32_t init[5] = {
+		0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+	};
+	for (int i = 0; i < 5; i++) {
+		state[i] = (word_t){ 0 } + init[i];
+	}
+
+	size_t max_size = 0;
+	for (size_t lane = 0; lane < count; lane++) {
+		assert(sizes[lane] % SHA1_BLOCK_SIZE == 0);
+		if (sizes[lane] > max_size) {
+			max_size = sizes[lane];
+		}
+	}
+
+	for (size_t offset = 0; offset < max_size; offset += SHA1_BLOCK_SIZE) {
+		word_t w[16] = { { 0 } };
+		word_t active = { 0 };
+		for (size_t lane = 0; lane < count; lane++) {
+			if (offset >= sizes[lane]) {
+				continue;
+			}
+			active[lane] = UINT32_MAX;
+			const uint8_t *block = messages[lane] + offset;
+			for (int i = 0; i < 16; i++) {
+				w[i][lane] = read_u32(block + 4 * i);
+			}
+		}
+
+		word_t next[5];
+		memcpy(next, state, sizeof(next));
+		compress(next, w);
+
+		// keep the state of the finished lanes
+		for (int i = 0; i < 5; i++) {
+			state[i] = (next[i] & active) | (state[i] & ~active);
+		}
+	}
+
+	for (size_t lane = 0; lane < count; lane++) {
+		for (int i = 0; i < 5; i++) {
+			write_u32(digests[lane] + 4 * i, state[i][lane]);
+		}
+	}
+}
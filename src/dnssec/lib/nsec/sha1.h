@@ -0,0 +1,59 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Multi-buffer SHA-1 for NSEC3 hashing.
+ *
+ * Up to SHA1_LANES independent messages are hashed at once, each message
+ * in one lane of vector registers (using the compiler vector extensions,
+ * so SSE2/NEON is used where available). The messages may have different
+ * lengths, finished lanes are just masked out.
+ */
+
+#define SHA1_LANES 4
+#define SHA1_BLOCK_SIZE 64
+#define SHA1_DIGEST_SIZE 20
+
+/*!
+ * Size of a message after padding.
+ */
+#define SHA1_PADDED_SIZE(size) ((((size) + 8) / SHA1_BLOCK_SIZE + 1) * SHA1_BLOCK_SIZE)
+
+/*!
+ * Pad a message in place.
+ *
+ * \param buffer  Message buffer of at least SHA1_PADDED_SIZE(size) bytes.
+ * \param size    Message size.
+ *
+ * \return Padded message size.
+ */
+size_t sha1_pad(uint8_t *buffer, size_t size);
+
+/*!
+ * Compute SHA-1 digests of padded messages.
+ *
+ * \param[in]  messages  Padded messages.
+ * \param[in]  sizes     Padded message sizes.
+ * \param[in]  count     Number of messages, at most SHA1_LANES.
+ * \param[out] digests   Output buffers of SHA1_DIGEST_SIZE bytes.
+ */
+void sha1_lanes(const uint8_t *messages[], const size_t sizes[], size_t count,
+		uint8_t *digests[]);
@@ -14,6 +14,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <gnutls/crypto.h>
+#include <stdbool.h>
 #include <string.h>
 #include <tap/basic.h>
 
@@ -84,6 +86,72 @@ static void test_hashing(void)
 	dnssec_binary_free(&hash);
 }
 
+/*!
+ * Reference NSEC3 hash computed by GnuTLS.
+ */
+static void reference_hash(const dnssec_binary_t *data,
+			   const dnssec_nsec3_params_t *params, uint8_t *hash)
+{
+	uint8_t buffer[1024];
+
+	memcpy(buffer, data->data, data->size);
+	memcpy(buffer + data->size, params->salt.data, params->salt.size);
+	gnutls_hash_fast(GNUTLS_DIG_SHA1, buffer, data->size + params->salt.size, hash);
+
+	for (int i = 0; i < params->iterations; i++) {
+		memcpy(buffer, hash, 20);
+		memcpy(buffer + 20, params->salt.data, params->salt.size);
+		gnutls_hash_fast(GNUTLS_DIG_SHA1, buffer, 20 + params->salt.size, hash);
+	}
+}
+
+static void test_hashing_batch(void)
+{
+	// different lengths to cover various numbers of SHA-1 blocks
+	uint8_t input[11][600];
+	dnssec_binary_t data[11];
+	const size_t sizes[11] = { 0, 1, 13, 41, 55, 56, 64, 119, 255, 300, 600 };
+	for (int i = 0; i < 11; i++) {
+		memset(input[i], 'a' + i, sizes[i]);
+		data[i].data = input[i];
+		data[i].size = sizes[i];
+	}
+
+	const struct {
+		uint16_t iterations;
+		const char *salt;
+	} cases[] = {
+		{ 0, "" },
+		{ 1, "ab" },
+		{ 10, "happywithnsec3" },
+		{ 3, "0123456789012345678901234567890123456789012345678901234567890123" },
+	};
+
+	for (size_t c = 0; c < sizeof(cases) / sizeof(*cases); c++) {
+		const dnssec_nsec3_params_t params = {
+			.algorithm = DNSSEC_NSEC3_ALGORITHM_SHA1,
+			.iterations = cases[c].iterations,
+			.salt = { .size = strlen(cases[c].salt),
+			          .data = (uint8_t *)cases[c].salt }
+		};
+
+		dnssec_binary_t hashes[11] = { { 0 } };
+		int result = dnssec_nsec3_hash_batch(data, 11, &params, hashes);
+		ok(result == DNSSEC_EOK, "dnssec_nsec3_hash_batch(), iterations %u",
+		   params.iterations);
+
+		bool valid = true;
+		for (int i = 0; i < 11; i++) {
+			uint8_t expected[20];
+			reference_hash(&data[i], &params, expected);
+			valid = valid && hashes[i].size == 20 &&
+			        memcmp(hashes[i].data, expected, 20) == 0;
+			dnssec_binary_free(&hashes[i]);
+		}
+		ok(valid, "valid hashes");
+	}
+}
+
 static void test_clear(void)
 {
 	const dnssec_nsec3_params_t empty = { 0 };
@@ -108,6 +176,7 @@ int main(void)
 	test_length();
 	test_parsing();
 	test_hashing();
+	test_hashing_batch();
 	test_clear();
 
 	return 0;
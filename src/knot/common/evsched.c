@@ -24,39 +24,370 @@
 #include "knot/server/dthreads.h"
 #include "knot/common/evsched.h"
 
-/*! \brief Some implementations of timercmp >= are broken, this is for compat.*/
-static inline int timercmp_ge(struct timeval *a, struct timeval *b) {
-	return timercmp(a, b, >) || timercmp(a, b, ==);
+#ifdef HAVE_ATOMIC
+ #define ATOMIC_GET(src)         __atomic_load_n(&(src), __ATOMIC_SEQ_CST)
+ #define ATOMIC_SET(dst, val)    __atomic_store_n(&(dst), val, __ATOMIC_SEQ_CST)
+ #define ATOMIC_INC(dst)         __atomic_add_fetch(&(dst), 1, __ATOMIC_SEQ_CST)
+ #define ATOMIC_OR(dst, val)     __atomic_fetch_or(&(dst), val, __ATOMIC_SEQ_CST)
+ #define ATOMIC_AND(dst, val)    __atomic_fetch_and(&(dst), val, __ATOMIC_SEQ_CST)
+ #define ATOMIC_FENCE()          __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+ #define ATOMIC_GET(src)         __sync_fetch_and_add(&(src), 0)
+ #define ATOMIC_SET(dst, val)    { __sync_synchronize(); (dst) = (val); __sync_synchronize(); }
+ #define ATOMIC_INC(dst)         __sync_add_and_fetch(&(dst), 1)
+ #define ATOMIC_OR(dst, val)     __sync_fetch_and_or(&(dst), val)
+ #define ATOMIC_AND(dst, val)    __sync_fetch_and_and(&(dst), val)
+ #define ATOMIC_FENCE()          __sync_synchronize()
+#endif
+
+#define NEVER		UINT64_MAX
+#define SLOT_MASK	(EVSCHED_WHEEL_SLOTS - 1)
+
+/*! \brief Events expired at once and the tasks deferred by their callbacks. */
+typedef struct evsched_batch {
+	struct {
+		event_t *ev;
+		uint32_t gen;
+	} *events;
+	size_t events_count;
+	size_t events_max;
+	task_t **tasks;
+	worker_pool_t **pools;
+	size_t tasks_count;
+	size_t tasks_max;
+	bool active;
+} evsched_batch_t;
+
+/*! \brief Scheduler whose expired events this thread is dispatching. */
+static __thread evsched_t *dispatcher;
+
+/*!
+ * \brief Milliseconds since the scheduler initialization.
+ *
+ * The tick expires once the next one starts, so no event expires early.
+ */
+static uint64_t now_tick(evsched_t *sched)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	int64_t ns = (now.tv_sec - sched->epoch.tv_sec) * 1000000000LL +
+	             (now.tv_nsec - sched->epoch.tv_nsec);
+
+	return ns / 1000000;
+}
+
+/*!
+ * \brief Get the slot of the tick for the given cursor.
+ *
+ * The level is given by the most significant slot digit the tick differs
+ * from the cursor in, so each slot except the current ones at level 0
+ * covers only the future ticks.
+ */
+static unsigned slot_index(uint64_t tick, uint64_t cursor)
+{
+	uint64_t diff = tick ^ cursor;
+	unsigned level = (diff == 0) ? 0 :
+	                 (63 - __builtin_clzll(diff)) / EVSCHED_WHEEL_BITS;
+	unsigned slot = (tick >> (level * EVSCHED_WHEEL_BITS)) & SLOT_MASK;
+
+	return level * EVSCHED_WHEEL_SLOTS + slot;
+}
+
+static uint64_t level_unit(unsigned level)
+{
+	return (uint64_t)1 << (level * EVSCHED_WHEEL_BITS);
+}
+
+/*! \brief Insert the event into a slot, the slot must be locked. */
+static void bucket_add(evsched_t *sched, unsigned idx, event_t *ev)
+{
+	evsched_bucket_t *bucket = &sched->wheel[idx];
+
+	add_tail(&bucket->events, &ev->node);
+	ATOMIC_SET(ev->bucket, bucket);
+
+	/* Avoid writing the shared bitmap if possible. */
+	uint64_t *occupied = &sched->occupied[idx / EVSCHED_WHEEL_SLOTS];
+	uint64_t bit = (uint64_t)1 << (idx % EVSCHED_WHEEL_SLOTS);
+	if (!(ATOMIC_GET(*occupied) & bit)) {
+		ATOMIC_OR(*occupied, bit);
+	}
 }
 
-static int compare_event_heap_nodes(void *e1, void *e2)
+/*! \brief Remove the event from its slot, the slot must be locked. */
+static void bucket_rem(evsched_t *sched, event_t *ev)
 {
-	if (timercmp(&((event_t *)e1)->tv, &((event_t *)e2)->tv, <)) return -1;
-	if (timercmp(&((event_t *)e1)->tv, &((event_t *)e2)->tv, >)) return 1;
-	return 0;
+	evsched_bucket_t *bucket = ev->bucket;
+
+	rem_node(&ev->node);
+	ATOMIC_SET(ev->bucket, NULL);
+	if (EMPTY_LIST(bucket->events)) {
+		unsigned idx = bucket - sched->wheel;
+		ATOMIC_AND(sched->occupied[idx / EVSCHED_WHEEL_SLOTS],
+		           ~((uint64_t)1 << (idx % EVSCHED_WHEEL_SLOTS)));
+	}
 }
 
 /*!
- * \brief Get time T (now) + dt miliseconds.
+ * \brief Remove the event from the wheel.
+ *
+ * \retval true if the event was in the given slot or if any slot is NULL.
  */
-static struct timeval timeval_in(uint32_t dt)
+static bool event_unlink(evsched_t *sched, event_t *ev, evsched_bucket_t *only)
 {
-	struct timeval tv = { 0 };
-	gettimeofday(&tv, NULL);
+	for (;;) {
+		evsched_bucket_t *bucket = ATOMIC_GET(ev->bucket);
+		if (bucket == NULL || (only != NULL && bucket != only)) {
+			return only == NULL;
+		}
+
+		/* The scheduler thread may move the event meanwhile. */
+		pthread_mutex_lock(&bucket->lock);
+		bool found = (ev->bucket == bucket);
+		if (found) {
+			bucket_rem(sched, ev);
+		}
+		pthread_mutex_unlock(&bucket->lock);
+
+		if (found) {
+			return true;
+		}
+	}
+}
+
+/*!
+ * \brief Insert the event into the wheel.
+ *
+ * If the cursor moves meanwhile, the used slot may have been already passed,
+ * then the event is reinserted unless the scheduler thread has taken it.
+ */
+static void event_link(evsched_t *sched, event_t *ev, uint64_t expires)
+{
+	for (;;) {
+		uint64_t cursor = ATOMIC_GET(sched->cursor);
+		uint64_t tick = (expires > cursor) ? expires : cursor;
+		unsigned idx = slot_index(tick, cursor);
+
+		pthread_mutex_lock(&sched->wheel[idx].lock);
+		ev->expires = tick;
+		bucket_add(sched, idx, ev);
+		pthread_mutex_unlock(&sched->wheel[idx].lock);
+
+		uint64_t now_cursor = ATOMIC_GET(sched->cursor);
+		if (now_cursor == cursor ||
+		    slot_index((tick > now_cursor) ? tick : now_cursor, now_cursor) == idx) {
+			return;
+		}
+
+		if (!event_unlink(sched, ev, &sched->wheel[idx])) {
+			return;
+		}
+	}
+}
+
+/*!
+ * \brief Get the lower bound of the next expiration.
+ *
+ * The start tick of the first occupied slot after the cursor is returned.
+ */
+static uint64_t next_tick(evsched_t *sched)
+{
+	uint64_t cursor = ATOMIC_GET(sched->cursor);
+
+	for (unsigned level = 0; level < EVSCHED_WHEEL_LEVELS; level++) {
+		unsigned shift = level * EVSCHED_WHEEL_BITS;
+		unsigned digit = (cursor >> shift) & SLOT_MASK;
+
+		/* Slots at the upper levels start after the current one. */
+		uint64_t mask = ~(uint64_t)0 << digit;
+		if (level > 0) {
+			mask = (digit == SLOT_MASK) ? 0 : mask << 1;
+		}
+
+		uint64_t occupied = ATOMIC_GET(sched->occupied[level]) & mask;
+		if (occupied == 0) {
+			continue;
+		}
+
+		unsigned slot = __builtin_ctzll(occupied);
+		uint64_t base = 0;
+		if (shift + EVSCHED_WHEEL_BITS < 64) {
+			unsigned upper = shift + EVSCHED_WHEEL_BITS;
+			base = (cursor >> upper) << upper;
+		}
+
+		return base | ((uint64_t)slot << shift);
+	}
+
+	return NEVER;
+}
+
+static bool batch_add(evsched_batch_t *batch, event_t *ev)
+{
+	if (batch->events_count == batch->events_max) {
+		size_t max = (batch->events_max > 0) ? 2 * batch->events_max : 64;
+		void *events = realloc(batch->events, max * sizeof(*batch->events));
+		if (events == NULL) {
+			return false;
+		}
+		batch->events = events;
+		batch->events_max = max;
+	}
+
+	/* Cancellation waits for the dispatch from now on. */
+	ATOMIC_SET(ev->dispatching, 1);
+
+	batch->events[batch->events_count].ev = ev;
+	batch->events[batch->events_count].gen = ATOMIC_GET(ev->gen);
+	batch->events_count++;
+
+	return true;
+}
+
+/*!
+ * \brief Expire the events of the slot and move the other ones lower.
+ */
+static void slot_expire(evsched_t *sched, unsigned idx, uint64_t cursor)
+{
+	evsched_bucket_t *bucket = &sched->wheel[idx];
+
+	pthread_mutex_lock(&bucket->lock);
+
+	node_t *n, *nxt;
+	WALK_LIST_DELSAFE(n, nxt, bucket->events) {
+		event_t *ev = (event_t *)n;
+		if (ev->expires < cursor) {
+			if (batch_add(sched->batch, ev)) {
+				bucket_rem(sched, ev);
+				continue;
+			}
+			/* Retry in the next round. */
+			ev->expires = cursor;
+		}
+
+		unsigned new_idx = slot_index(ev->expires, cursor);
+		if (new_idx == idx) {
+			continue;
+		}
 
-	/* Add number of seconds. */
-	tv.tv_sec += dt / 1000;
+		/* Inserters lock only one slot, so the order can't deadlock. */
+		bucket_rem(sched, ev);
+		pthread_mutex_lock(&sched->wheel[new_idx].lock);
+		bucket_add(sched, new_idx, ev);
+		pthread_mutex_unlock(&sched->wheel[new_idx].lock);
+	}
+
+	pthread_mutex_unlock(&bucket->lock);
+}
+
+/*!
+ * \brief Move the cursor and collect the expired events.
+ *
+ * The level 0 slots of the ticks before the new cursor are expired and the
+ * upper level slots the cursor has entered are spread to lower levels. The
+ * cursor is published first so that the inserters racing with the slot
+ * processing can detect a passed slot.
+ */
+static void advance(evsched_t *sched, uint64_t target)
+{
+	uint64_t prev = sched->cursor;
+	if (target <= prev) {
+		return;
+	}
+
+	ATOMIC_SET(sched->cursor, target);
+
+	for (unsigned level = 0; level < EVSCHED_WHEEL_LEVELS; level++) {
+		/* Expired ticks at level 0, entered slots at the upper levels. */
+		uint64_t unit = level_unit(level);
+		uint64_t first = prev / unit + (level > 0);
+		uint64_t last = target / unit + (level > 0);
+		if (first >= last) {
+			break;
+		}
+
+		uint64_t count = last - first;
+		if (count > EVSCHED_WHEEL_SLOTS) {
+			count = EVSCHED_WHEEL_SLOTS;
+		}
+
+		uint64_t occupied = ATOMIC_GET(sched->occupied[level]);
+		for (uint64_t i = 0; i < count && occupied != 0; i++) {
+			unsigned slot = (first + i) & SLOT_MASK;
+			if (occupied & ((uint64_t)1 << slot)) {
+				slot_expire(sched, level * EVSCHED_WHEEL_SLOTS + slot,
+				            target);
+			}
+		}
+	}
+}
 
-	/* Add the number of microseconds. */
-	tv.tv_usec += (dt % 1000) * 1000;
+/*!
+ * \brief Run the callbacks of the expired events.
+ *
+ * The callbacks are called without any slot locked. The events rescheduled
+ * or canceled after the expiration are skipped.
+ */
+static void dispatch(evsched_t *sched)
+{
+	evsched_batch_t *batch = sched->batch;
+
+	batch->active = true;
+	dispatcher = sched;
+	for (size_t i = 0; i < batch->events_count; i++) {
+		event_t *ev = batch->events[i].ev;
+		if (ATOMIC_GET(ev->gen) == batch->events[i].gen) {
+			ev->cb(ev);
+		}
+	}
+	dispatcher = NULL;
+	batch->active = false;
+
+	/* Assign the deferred tasks, pool by pool. */
+	size_t begin = 0;
+	for (size_t i = 1; i <= batch->tasks_count; i++) {
+		if (i == batch->tasks_count || batch->pools[i] != batch->pools[begin]) {
+			worker_pool_assign_batch(batch->pools[begin],
+			                         batch->tasks + begin, i - begin);
+			begin = i;
+		}
+	}
+	batch->tasks_count = 0;
 
-	/* Check for overflow. */
-	while (tv.tv_usec > 999999) {
-		tv.tv_sec += 1;
-		tv.tv_usec -= 1 * 1000 * 1000;
+	pthread_mutex_lock(&sched->lock);
+	for (size_t i = 0; i < batch->events_count; i++) {
+		ATOMIC_SET(batch->events[i].ev->dispatching, 0);
 	}
+	pthread_cond_broadcast(&sched->dispatched);
+	pthread_mutex_unlock(&sched->lock);
 
-	return tv;
+	batch->events_count = 0;
+}
+
+/*! \brief Wait until the tick or until an earlier event is scheduled. */
+static void sleep_until(evsched_t *sched, uint64_t tick)
+{
+	if (tick == NEVER) {
+		pthread_cond_wait(&sched->notify, &sched->lock);
+		return;
+	}
+
+	uint64_t now = now_tick(sched);
+	uint64_t dt = (tick > now) ? tick - now : 0;
+
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+
+	struct timespec ts;
+	ts.tv_sec = tv.tv_sec + dt / 1000;
+	ts.tv_nsec = tv.tv_usec * 1000L + (dt % 1000) * 1000000L;
+	if (ts.tv_nsec > 999999999L) {
+		ts.tv_sec += 1;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	pthread_cond_timedwait(&sched->notify, &sched->lock, &ts);
 }
 
 /*! \brief Event scheduler loop. */
@@ -68,33 +399,32 @@ static int evsched_run(dthread_t *thread)
 	}
 
 	/* Run event loop. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	while (!dt_is_cancelled(thread)) {
-		if (EMPTY_HEAP(&sched->heap)) {
-			pthread_cond_wait(&sched->notify, &sched->heap_lock);
-			continue;
+		pthread_mutex_unlock(&sched->lock);
+		advance(sched, now_tick(sched));
+		bool expired = (sched->batch->events_count > 0);
+		if (expired) {
+			dispatch(sched);
 		}
+		pthread_mutex_lock(&sched->lock);
 
-		/* Get current time. */
-		struct timeval dt;
-		gettimeofday(&dt, 0);
-
-		/* Get next event. */
-		event_t *ev = *((event_t**)HHEAD(&sched->heap));
-		assert(ev != NULL);
+		if (expired) {
+			continue;
+		}
 
-		if (timercmp_ge(&dt, &ev->tv)) {
-			heap_delmin(&sched->heap);
-			ev->cb(ev);
-		} else {
-			/* Wait for next event or interrupt. Unlock calendar. */
-			struct timespec ts;
-			ts.tv_sec = ev->tv.tv_sec;
-			ts.tv_nsec = ev->tv.tv_usec * 1000L;
-			pthread_cond_timedwait(&sched->notify, &sched->heap_lock, &ts);
+		/* Publish the wake up time, recheck the racing insertions. */
+		uint64_t next = next_tick(sched);
+		ATOMIC_SET(sched->wakeup, next);
+		if (next_tick(sched) < next || next < now_tick(sched)) {
+			ATOMIC_SET(sched->wakeup, 0);
+			continue;
 		}
+
+		sleep_until(sched, (next == NEVER) ? NEVER : next + 1);
+		ATOMIC_SET(sched->wakeup, 0);
 	}
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	return KNOT_EOK;
 }
@@ -103,11 +433,27 @@ int evsched_init(evsched_t *sched, void *ctx)
 {
 	memset(sched, 0, sizeof(evsched_t));
 	sched->ctx = ctx;
+	clock_gettime(CLOCK_MONOTONIC, &sched->epoch);
 
 	/* Initialize event calendar. */
-	pthread_mutex_init(&sched->heap_lock, 0);
+	pthread_mutex_init(&sched->lock, 0);
 	pthread_cond_init(&sched->notify, 0);
-	heap_init(&sched->heap, compare_event_heap_nodes, 0);
+	pthread_cond_init(&sched->dispatched, 0);
+
+	size_t slots = EVSCHED_WHEEL_LEVELS * EVSCHED_WHEEL_SLOTS;
+	sched->wheel = malloc(slots * sizeof(evsched_bucket_t));
+	sched->batch = calloc(1, sizeof(evsched_batch_t));
+	if (sched->wheel == NULL || sched->batch == NULL) {
+		free(sched->wheel);
+		sched->wheel = NULL;
+		evsched_deinit(sched);
+		return KNOT_ENOMEM;
+	}
+
+	for (size_t i = 0; i < slots; i++) {
+		pthread_mutex_init(&sched->wheel[i].lock, 0);
+		init_list(&sched->wheel[i].events);
+	}
 
 	sched->thread = dt_create(1, evsched_run, NULL, sched);
 
@@ -126,16 +472,28 @@ void evsched_deinit(evsched_t *sched)
 	}
 
 	/* Deinitialize event calendar. */
-	pthread_mutex_destroy(&sched->heap_lock);
+	pthread_mutex_destroy(&sched->lock);
 	pthread_cond_destroy(&sched->notify);
-
-	while (!EMPTY_HEAP(&sched->heap)) {
-		event_t *e = (event_t *)*HHEAD(&sched->heap);
-		heap_delmin(&sched->heap);
-		evsched_event_free(e);
+	pthread_cond_destroy(&sched->dispatched);
+
+	if (sched->wheel != NULL) {
+		size_t slots = EVSCHED_WHEEL_LEVELS * EVSCHED_WHEEL_SLOTS;
+		for (size_t i = 0; i < slots; i++) {
+			node_t *n, *nxt;
+			WALK_LIST_DELSAFE(n, nxt, sched->wheel[i].events) {
+				evsched_event_free((event_t *)n);
+			}
+			pthread_mutex_destroy(&sched->wheel[i].lock);
+		}
+		free(sched->wheel);
 	}
 
-	heap_deinit(&sched->heap);
+	if (sched->batch != NULL) {
+		free(sched->batch->events);
+		free(sched->batch->tasks);
+		free(sched->batch->pools);
+		free(sched->batch);
+	}
 
 	if (sched->thread != NULL) {
 		dt_delete(&sched->thread);
@@ -160,10 +518,10 @@ event_t *evsched_event_create(evsched_t *sched, event_cb_t cb, void *data)
 
 	/* Initialize. */
 	memset(e, 0, sizeof(event_t));
+	pthread_mutex_init(&e->lock, NULL);
 	e->sched = sched;
 	e->cb = cb;
 	e->data = data;
-	e->hpos.pos=0;
 
 	return e;
 }
@@ -174,6 +532,7 @@ void evsched_event_free(event_t *ev)
 		return;
 	}
 
+	pthread_mutex_destroy(&ev->lock);
 	free(ev);
 }
 
@@ -183,27 +542,23 @@ int evsched_schedule(event_t *ev, uint32_t dt)
 		return KNOT_EINVAL;
 	}
 
-	struct timeval new_time = timeval_in(dt);
-
 	evsched_t *sched = ev->sched;
-
-	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
-
-	ev->tv = new_time;
-
-	/* Make sure it's not already enqueued. */
-	int found = heap_find(&sched->heap, (heap_val_t *)ev);
-	if (found > 0) {
-		heap_replace(&sched->heap, found, (heap_val_t *)ev);
-	} else {
-		heap_insert(&sched->heap, (heap_val_t *)ev);
+	uint64_t expires = now_tick(sched) + dt;
+
+	/* Replace the previous schedule, pending dispatch is skipped. */
+	pthread_mutex_lock(&ev->lock);
+	ATOMIC_INC(ev->gen);
+	event_unlink(sched, ev, NULL);
+	event_link(sched, ev, expires);
+	pthread_mutex_unlock(&ev->lock);
+
+	/* Wake up the scheduler thread only if sleeping for longer. */
+	if (expires < ATOMIC_GET(sched->wakeup)) {
+		pthread_mutex_lock(&sched->lock);
+		pthread_cond_signal(&sched->notify);
+		pthread_mutex_unlock(&sched->lock);
 	}
 
-	/* Unlock calendar. */
-	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
-
 	return KNOT_EOK;
 }
 
@@ -215,24 +570,57 @@ int evsched_cancel(event_t *ev)
 
 	evsched_t *sched = ev->sched;
 
-	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&ev->lock);
+	ATOMIC_INC(ev->gen);
+	event_unlink(sched, ev, NULL);
+	ev->expires = 0;
+	pthread_mutex_unlock(&ev->lock);
 
-	int found = heap_find(&sched->heap, (heap_val_t *)ev);
-	if (found > 0) {
-		heap_delete(&sched->heap, found);
+	/* A callback can't wait for its own batch, the event is skipped if
+	 * not dispatched yet. */
+	if (dispatcher == sched) {
+		return KNOT_EOK;
 	}
 
-	/* Unlock calendar. */
-	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
-
-	/* Reset event timer. */
-	memset(&ev->tv, 0, sizeof(struct timeval));
+	/* Wait for the batch with the expired event. */
+	if (ATOMIC_GET(ev->dispatching)) {
+		pthread_mutex_lock(&sched->lock);
+		while (ev->dispatching) {
+			pthread_cond_wait(&sched->dispatched, &sched->lock);
+		}
+		pthread_mutex_unlock(&sched->lock);
+	}
 
 	return KNOT_EOK;
 }
 
+void evsched_assign(event_t *ev, worker_pool_t *pool, task_t *task)
+{
+	assert(ev && ev->sched && ev->sched->batch->active);
+
+	evsched_batch_t *batch = ev->sched->batch;
+	if (batch->tasks_count == batch->tasks_max) {
+		size_t max = (batch->tasks_max > 0) ? 2 * batch->tasks_max : 64;
+		task_t **tasks = realloc(batch->tasks, max * sizeof(*tasks));
+		if (tasks != NULL) {
+			batch->tasks = tasks;
+		}
+		worker_pool_t **pools = realloc(batch->pools, max * sizeof(*pools));
+		if (pools != NULL) {
+			batch->pools = pools;
+		}
+		if (tasks == NULL || pools == NULL) {
+			worker_pool_assign(pool, task);
+			return;
+		}
+		batch->tasks_max = max;
+	}
+
+	batch->tasks[batch->tasks_count] = task;
+	batch->pools[batch->tasks_count] = pool;
+	batch->tasks_count++;
+}
+
 void evsched_start(evsched_t *sched)
 {
 	dt_start(sched->thread);
@@ -240,10 +628,10 @@ void evsched_start(evsched_t *sched)
 
 void evsched_stop(evsched_t *sched)
 {
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	dt_stop(sched->thread);
 	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 }
 
 void evsched_join(evsched_t *sched)
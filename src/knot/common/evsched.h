@@ -22,13 +22,25 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
-#include <sys/time.h>
+#include <time.h>
 
 #include "knot/server/dthreads.h"
-#include "contrib/ucw/heap.h"
+#include "knot/worker/pool.h"
+#include "contrib/ucw/lists.h"
+
+/*!
+ * \brief Timing wheel geometry.
+ *
+ * The events are kept in a hierarchical timing wheel with millisecond ticks.
+ * Each level has 64 slots and the levels together cover the 64-bit tick range.
+ */
+#define EVSCHED_WHEEL_BITS	6
+#define EVSCHED_WHEEL_SLOTS	(1 << EVSCHED_WHEEL_BITS)
+#define EVSCHED_WHEEL_LEVELS	11
 
 /* Forward decls. */
 struct evsched;
+struct evsched_bucket;
 struct event;
 
 /*!
@@ -50,21 +62,39 @@ typedef void (*event_cb_t)(struct event *);
  * \brief Event structure.
  */
 typedef struct event {
-	struct heap_val hpos;
-	struct timeval tv; /*!< Event scheduled time. */
-	void *data;        /*!< Usable data ptr. */
-	event_cb_t cb;     /*!< Event callback. */
+	node_t node;           /*!< Node in the timing wheel bucket. */
+	struct evsched_bucket *bucket; /*!< Current bucket, NULL if not scheduled. */
+	pthread_mutex_t lock;  /*!< Serializes scheduling of the event. */
+	uint64_t expires;      /*!< Event scheduled tick. */
+	uint32_t gen;          /*!< Changed by each scheduling or cancellation. */
+	int dispatching;       /*!< Event is in the batch being dispatched. */
+	void *data;            /*!< Usable data ptr. */
+	event_cb_t cb;         /*!< Event callback. */
 	struct evsched *sched; /*!< Scheduler for this event. */
 } event_t;
 
+/*!
+ * \brief Timing wheel slot.
+ */
+typedef struct evsched_bucket {
+	pthread_mutex_t lock;  /*!< Bucket locking. */
+	list_t events;         /*!< Events in the slot. */
+} evsched_bucket_t;
+
 /*!
  * \brief Event scheduler structure.
  */
 typedef struct evsched {
 	volatile bool running;     /*!< True if running. */
-	pthread_mutex_t heap_lock; /*!< Event heap locking. */
-	pthread_cond_t notify;     /*!< Event heap notification. */
-	struct heap heap;          /*!< Event heap. */
+	pthread_mutex_t lock;      /*!< Scheduler thread sleep locking. */
+	pthread_cond_t notify;     /*!< Earlier event notification. */
+	pthread_cond_t dispatched; /*!< Batch dispatch finished. */
+	evsched_bucket_t *wheel;   /*!< Timing wheel slots, level by level. */
+	uint64_t occupied[EVSCHED_WHEEL_LEVELS]; /*!< Non-empty slots bitmaps. */
+	uint64_t cursor;           /*!< First tick not yet expired. */
+	uint64_t wakeup;           /*!< Planned wake up tick of the sleeping thread. */
+	struct timespec epoch;     /*!< Time of the tick 0. */
+	struct evsched_batch *batch; /*!< Expired events being dispatched. */
 	void *ctx;                 /*!< Scheduler context. */
 	dt_unit_t *thread;
 } evsched_t;
@@ -124,11 +154,12 @@ int evsched_schedule(event_t *ev, uint32_t dt);
 /*!
  * \brief Cancel a scheduled event.
  *
- * \warning May block until current running event is finished (as it cannot
- *          interrupt running event).
+ * \warning May block until the batch containing the event is dispatched
+ *          (as it cannot interrupt running event).
  *
- * \warning Never cancel event in it's callback. As it never finishes,
- *          it deadlocks.
+ * \note Called from an event callback, it doesn't wait for the current batch.
+ *       The event is skipped if not dispatched yet, but the tasks it has
+ *       already deferred in the batch are still assigned.
  *
  * \param ev Scheduled event.
  *
@@ -137,6 +168,19 @@ int evsched_schedule(event_t *ev, uint32_t dt);
  */
 int evsched_cancel(event_t *ev);
 
+/*!
+ * \brief Assign a task to the worker pool once the current batch is dispatched.
+ *
+ * The tasks of all events expired at once are assigned to the pool together.
+ *
+ * \note Only usable from the event callback.
+ *
+ * \param ev Event being dispatched.
+ * \param pool Worker pool.
+ * \param task Task to be assigned.
+ */
+void evsched_assign(event_t *ev, worker_pool_t *pool, task_t *task);
+
 void evsched_start(evsched_t *sched);
 void evsched_stop(evsched_t *sched);
 void evsched_join(evsched_t *sched);
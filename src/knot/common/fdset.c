@@ -1,4 +1,4 @@
-/*  Copyright (C) 2011 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
 
     This program is free software: you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -14,6 +14,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -22,6 +24,9 @@
 #include "contrib/time.h"
 #include "libknot/errcode.h"
 
+/* Marks a received event of a descriptor pending removal. */
+#define FDSET_REMOVED (1u << 31)
+
 /* Realloc memory or return error (part of fdset_resize). */
 #define MEM_RESIZE(tmp, p, n) \
 	if ((tmp = realloc((p), (n) * sizeof(*p))) == NULL) \
@@ -32,12 +37,58 @@ static int fdset_resize(fdset_t *set, unsigned size)
 {
 	void *tmp = NULL;
 	MEM_RESIZE(tmp, set->ctx, size);
+	MEM_RESIZE(tmp, set->wd, size);
+	MEM_RESIZE(tmp, set->ready, size);
+#ifdef ENABLE_EPOLL
+	MEM_RESIZE(tmp, set->fd, size);
+	MEM_RESIZE(tmp, set->events, size);
+	MEM_RESIZE(tmp, set->recv_ev, size);
+#else
 	MEM_RESIZE(tmp, set->pfd, size);
-	MEM_RESIZE(tmp, set->timeout, size);
+#endif
 	set->size = size;
+
+	/* Watchdog timers could have moved. */
+	for (unsigned i = 0; i < set->n; ++i) {
+		int pos = set->wd[i].hv.pos;
+		if (pos > 0) {
+			*HELEMENT(&set->wd_heap, pos) = &set->wd[i].hv;
+		}
+	}
+
 	return KNOT_EOK;
 }
 
+static int wd_cmp(void *a, void *b)
+{
+	time_t t1 = ((fdset_wd_t *)a)->timeout;
+	time_t t2 = ((fdset_wd_t *)b)->timeout;
+	return (t1 < t2) ? -1 : (t1 > t2);
+}
+
+static void wd_disarm(fdset_t *set, unsigned i)
+{
+	int pos = set->wd[i].hv.pos;
+	if (pos > 0) {
+		heap_delete(&set->wd_heap, pos);
+		set->wd[i].hv.pos = 0;
+	}
+	set->wd[i].timeout = 0;
+}
+
+#ifdef ENABLE_EPOLL
+/* Note: poll event flags have the same values as epoll ones on Linux. */
+static int epoll_ctl_idx(fdset_t *set, int op, unsigned i)
+{
+	struct epoll_event ev = {
+		.events = set->events[i],
+		.data.u32 = i
+	};
+
+	return epoll_ctl(set->efd, op, set->fd[i], &ev);
+}
+#endif
+
 int fdset_init(fdset_t *set, unsigned size)
 {
 	if (set == NULL) {
@@ -45,7 +96,28 @@ int fdset_init(fdset_t *set, unsigned size)
 	}
 
 	memset(set, 0, sizeof(fdset_t));
-	return fdset_resize(set, size);
+#ifdef ENABLE_EPOLL
+	set->efd = -1;
+#endif
+
+	if (!heap_init(&set->wd_heap, wd_cmp, 0)) {
+		return KNOT_ENOMEM;
+	}
+
+#ifdef ENABLE_EPOLL
+	set->efd = epoll_create1(EPOLL_CLOEXEC);
+	if (set->efd < 0) {
+		heap_deinit(&set->wd_heap);
+		return knot_map_errno();
+	}
+#endif
+
+	int ret = fdset_resize(set, size > 0 ? size : FDSET_INIT_SIZE);
+	if (ret != KNOT_EOK) {
+		fdset_clear(set);
+	}
+
+	return ret;
 }
 
 int fdset_clear(fdset_t* set)
@@ -55,9 +127,23 @@ int fdset_clear(fdset_t* set)
 	}
 
 	free(set->ctx);
+	free(set->wd);
+	free(set->ready);
+#ifdef ENABLE_EPOLL
+	if (set->efd >= 0) {
+		close(set->efd);
+	}
+	free(set->fd);
+	free(set->events);
+	free(set->recv_ev);
+#else
 	free(set->pfd);
-	free(set->timeout);
+#endif
+	heap_deinit(&set->wd_heap);
 	memset(set, 0, sizeof(fdset_t));
+#ifdef ENABLE_EPOLL
+	set->efd = -1;
+#endif
 	return KNOT_EOK;
 }
 
@@ -72,12 +158,22 @@ int fdset_add(fdset_t *set, int fd, unsigned events, void *ctx)
 		return KNOT_ENOMEM;
 
 	/* Initialize. */
-	int i = set->n++;
+	int i = set->n;
+#ifdef ENABLE_EPOLL
+	set->fd[i] = fd;
+	set->events[i] = events;
+	if (epoll_ctl_idx(set, EPOLL_CTL_ADD, i) != 0) {
+		return knot_map_errno();
+	}
+#else
 	set->pfd[i].fd = fd;
 	set->pfd[i].events = events;
 	set->pfd[i].revents = 0;
+#endif
 	set->ctx[i] = ctx;
-	set->timeout[i] = 0;
+	set->wd[i].hv.pos = 0;
+	set->wd[i].timeout = 0;
+	set->n++;
 
 	/* Return index to this descriptor. */
 	return i;
@@ -89,6 +185,10 @@ int fdset_remove(fdset_t *set, unsigned i)
 		return KNOT_EINVAL;
 	}
 
+	/* Descriptors removed by iterator are already unwatched. */
+	int ret = fdset_unwatch(set, i);
+	wd_disarm(set, i);
+
 	/* Decrement number of elms. */
 	--set->n;
 
@@ -96,14 +196,181 @@ int fdset_remove(fdset_t *set, unsigned i)
 	 * Move last -> i if some remain. */
 	unsigned last = set->n; /* Already decremented */
 	if (i < last) {
-		set->pfd[i] = set->pfd[last];
-		set->timeout[i] = set->timeout[last];
 		set->ctx[i] = set->ctx[last];
+		set->wd[i] = set->wd[last];
+		if (set->wd[i].hv.pos > 0) {
+			*HELEMENT(&set->wd_heap, set->wd[i].hv.pos) = &set->wd[i].hv;
+		}
+#ifdef ENABLE_EPOLL
+		set->fd[i] = set->fd[last];
+		set->events[i] = set->events[last];
+		if (set->fd[i] >= 0 && ret == KNOT_EOK) {
+			/* Update index stored with the descriptor. */
+			if (epoll_ctl_idx(set, EPOLL_CTL_MOD, i) != 0) {
+				ret = knot_map_errno();
+			}
+		}
+#else
+		set->pfd[i] = set->pfd[last];
+#endif
+	}
+
+	return ret;
+}
+
+int fdset_unwatch(fdset_t *set, unsigned i)
+{
+	if (set == NULL || i >= set->n) {
+		return KNOT_EINVAL;
 	}
 
+#ifdef ENABLE_EPOLL
+	if (set->fd[i] < 0) {
+		return KNOT_EOK;
+	}
+	int ret = epoll_ctl(set->efd, EPOLL_CTL_DEL, set->fd[i], NULL);
+	set->fd[i] = -1;
+	if (ret != 0) {
+		return knot_map_errno();
+	}
+#else
+	set->pfd[i].fd = -1;
+#endif
+
 	return KNOT_EOK;
 }
 
+int fdset_get_fd(const fdset_t *set, unsigned i)
+{
+	if (set == NULL || i >= set->n) {
+		return -1;
+	}
+
+#ifdef ENABLE_EPOLL
+	return set->fd[i];
+#else
+	return set->pfd[i].fd;
+#endif
+}
+
+int fdset_set_events(fdset_t *set, unsigned i, unsigned events)
+{
+	if (set == NULL || i >= set->n) {
+		return KNOT_EINVAL;
+	}
+
+#ifdef ENABLE_EPOLL
+	if (set->events[i] != events) {
+		set->events[i] = events;
+		if (epoll_ctl_idx(set, EPOLL_CTL_MOD, i) != 0) {
+			return knot_map_errno();
+		}
+	}
+#else
+	set->pfd[i].events = events;
+#endif
+
+	return KNOT_EOK;
+}
+
+int fdset_poll(fdset_t *set, fdset_it_t *it, int timeout_ms)
+{
+	if (set == NULL || it == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	memset(it, 0, sizeof(*it));
+	it->set = set;
+
+	if (set->n == 0) {
+		return 0;
+	}
+
+#ifdef ENABLE_EPOLL
+	int ret = epoll_wait(set->efd, set->recv_ev, set->size, timeout_ms);
+	for (int i = 0; i < ret; ++i) {
+		set->ready[i].idx = set->recv_ev[i].data.u32;
+		set->ready[i].events = set->recv_ev[i].events;
+	}
+#else
+	int ret = poll(set->pfd, set->n, timeout_ms);
+	int found = 0;
+	for (unsigned i = 0; found < ret && i < set->n; ++i) {
+		if (set->pfd[i].revents != 0) {
+			set->ready[found].idx = i;
+			set->ready[found].events = set->pfd[i].revents;
+			found++;
+		}
+	}
+#endif
+	if (ret < 0) {
+		return knot_map_errno();
+	}
+
+	it->end = ret;
+
+	return ret;
+}
+
+int fdset_it_remove(fdset_it_t *it)
+{
+	assert(it && !fdset_it_done(it));
+
+	fdset_t *set = it->set;
+	fdset_ready_t *ready = &set->ready[it->pos];
+	if (ready->events & FDSET_REMOVED) {
+		return KNOT_EOK;
+	}
+
+	/* Stop watching the descriptor now, it's likely to be closed. */
+	unsigned i = ready->idx;
+	int ret = fdset_unwatch(set, i);
+	wd_disarm(set, i);
+
+	ready->events |= FDSET_REMOVED;
+	it->removed++;
+
+	return ret;
+}
+
+static int ready_idx_cmp(const void *a, const void *b)
+{
+	unsigned i1 = ((const fdset_ready_t *)a)->idx;
+	unsigned i2 = ((const fdset_ready_t *)b)->idx;
+	return (i1 < i2) ? 1 : -(i1 > i2); /* Descending order. */
+}
+
+int fdset_it_commit(fdset_it_t *it)
+{
+	if (it == NULL || it->removed == 0) {
+		return KNOT_EOK;
+	}
+
+	fdset_t *set = it->set;
+
+	/* Gather the removed descriptors. */
+	unsigned removed = 0;
+	for (unsigned i = 0; i < it->end; ++i) {
+		if (set->ready[i].events & FDSET_REMOVED) {
+			set->ready[removed++] = set->ready[i];
+		}
+	}
+
+	/* Remove from the highest index, so that the lower ones stay valid. */
+	qsort(set->ready, removed, sizeof(*set->ready), ready_idx_cmp);
+	int ret = KNOT_EOK;
+	for (unsigned i = 0; i < removed; ++i) {
+		int rm = fdset_remove(set, set->ready[i].idx);
+		if (ret == KNOT_EOK) {
+			ret = rm;
+		}
+	}
+
+	it->pos = it->end = it->removed = 0;
+
+	return ret;
+}
+
 int fdset_set_watchdog(fdset_t* set, int i, int interval)
 {
 	if (set == NULL || i >= set->n) {
@@ -111,41 +378,86 @@ int fdset_set_watchdog(fdset_t* set, int i, int interval)
 	}
 
 	/* Lift watchdog if interval is negative. */
+	wd_disarm(set, i);
 	if (interval < 0) {
-		set->timeout[i] = 0;
 		return KNOT_EOK;
 	}
 
 	/* Update clock. */
 	struct timespec now = time_now();
 
-	set->timeout[i] = now.tv_sec + interval; /* Only seconds precision. */
+	set->wd[i].timeout = now.tv_sec + interval; /* Only seconds precision. */
+	if (!heap_insert(&set->wd_heap, &set->wd[i].hv)) {
+		set->wd[i].timeout = 0;
+		return KNOT_ENOMEM;
+	}
+
 	return KNOT_EOK;
 }
 
+static int unsigned_desc_cmp(const void *a, const void *b)
+{
+	unsigned i1 = *(const unsigned *)a;
+	unsigned i2 = *(const unsigned *)b;
+	return (i1 < i2) ? 1 : -(i1 > i2);
+}
+
 int fdset_sweep(fdset_t* set, fdset_sweep_cb_t cb, void *data)
 {
 	if (set == NULL || cb == NULL) {
 		return KNOT_EINVAL;
 	}
 
+	struct heap *heap = &set->wd_heap;
+	if (EMPTY_HEAP(heap)) {
+		return KNOT_EOK;
+	}
+
 	/* Get time threshold. */
 	struct timespec now = time_now();
 
-	unsigned i = 0;
-	while (i < set->n) {
+	fdset_wd_t *first = (fdset_wd_t *)*HHEAD(heap);
+	if (first->timeout > now.tv_sec) {
+		return KNOT_EOK;
+	}
+
+	/* Expired timers form a subtree at the top of the heap, collect
+	 * heap positions first and convert them to fd indexes in place. */
+	unsigned *expired = malloc((heap->num + 1) * sizeof(*expired));
+	if (expired == NULL) {
+		return KNOT_ENOMEM;
+	}
 
+	unsigned count = 0, todo = 0;
+	expired[todo++] = 1;
+	while (count < todo) {
+		int pos = expired[count];
+		fdset_wd_t *wd = (fdset_wd_t *)*HELEMENT(heap, pos);
+		if (wd->timeout > now.tv_sec) {
+			expired[count] = expired[--todo];
+			continue;
+		}
+		expired[count++] = wd - set->wd;
+		for (int child = 2 * pos; child <= 2 * pos + 1 && child <= heap->num; ++child) {
+			expired[todo++] = child;
+		}
+	}
+
+	/* Sweep from the highest index, so that the lower ones stay valid. */
+	qsort(expired, count, sizeof(*expired), unsigned_desc_cmp);
+	int ret = KNOT_EOK;
+	for (unsigned k = 0; k < count; ++k) {
+		unsigned i = expired[k];
 		/* Check sweep state, remove if requested. */
-		if (set->timeout[i] > 0 && set->timeout[i] <= now.tv_sec) {
-			if (cb(set, i, data) == FDSET_SWEEP) {
-				if (fdset_remove(set, i) == KNOT_EOK)
-					continue; /* Stay on the index. */
+		if (cb(set, i, data) == FDSET_SWEEP) {
+			int rm = fdset_remove(set, i);
+			if (ret == KNOT_EOK) {
+				ret = rm;
 			}
 		}
-
-		/* Next descriptor. */
-		++i;
 	}
 
-	return KNOT_EOK;
+	free(expired);
+
+	return ret;
 }
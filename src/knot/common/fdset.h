@@ -15,26 +15,65 @@
  */
 /*!
  * \brief I/O multiplexing with context and timeouts for each fd.
+ *
+ * The set is backed by epoll(7) if available, poll(2) is used otherwise.
+ * Watchdog timeouts are kept in a heap, so that neither waiting nor sweeping
+ * needs to visit every descriptor in the set.
  */
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <poll.h>
 #include <sys/time.h>
 #include <signal.h>
+#ifdef ENABLE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#include "contrib/ucw/heap.h"
 
 #define FDSET_INIT_SIZE 256 /* Resize step. */
 
+/*! \brief Watchdog timer of a file descriptor. */
+typedef struct {
+	heap_val_t hv;       /*!< Heap position (0 if not armed). */
+	time_t timeout;      /*!< Expiration time (seconds precision). */
+} fdset_wd_t;
+
+/*! \brief Descriptor with received events. */
+typedef struct {
+	unsigned idx;        /*!< Index of the fd in the set. */
+	unsigned events;     /*!< Received poll events. */
+} fdset_ready_t;
+
 /*! \brief Set of filedescriptors with associated context and timeouts. */
 typedef struct fdset {
 	unsigned n;          /*!< Active fds. */
 	unsigned size;       /*!< Array size (allocated). */
 	void* *ctx;          /*!< Context for each fd. */
+	fdset_wd_t *wd;      /*!< Watchdog timer for each fd. */
+	struct heap wd_heap; /*!< Armed watchdog timers. */
+	fdset_ready_t *ready;/*!< Descriptors with received events. */
+#ifdef ENABLE_EPOLL
+	int efd;             /*!< epoll instance. */
+	int *fd;             /*!< Watched fds. */
+	unsigned *events;    /*!< Watched events for each fd. */
+	struct epoll_event *recv_ev; /*!< Buffer for received events. */
+#else
 	struct pollfd *pfd;  /*!< poll state for each fd */
-	time_t *timeout;     /*!< Timeout for each fd (seconds precision). */
+#endif
 } fdset_t;
 
+/*! \brief Iterator over descriptors with received events. */
+typedef struct {
+	fdset_t *set;        /*!< Iterated set. */
+	unsigned pos;        /*!< Current position in the ready list. */
+	unsigned end;        /*!< Number of descriptors with events. */
+	unsigned removed;    /*!< Number of descriptors marked for removal. */
+} fdset_it_t;
+
 /*! \brief Mark-and-sweep state. */
 enum fdset_sweep_state {
 	FDSET_KEEP,
@@ -73,6 +112,9 @@ int fdset_add(fdset_t *set, int fd, unsigned events, void *ctx);
 /*!
  * \brief Remove file descriptor from watched set.
  *
+ * The last descriptor in the set is moved to the freed index.
+ * The descriptor must still be open unless it was unwatched before.
+ *
  * \param set Target set.
  * \param i Index of the removed fd.
  *
@@ -81,6 +123,92 @@ int fdset_add(fdset_t *set, int fd, unsigned events, void *ctx);
  */
 int fdset_remove(fdset_t *set, unsigned i);
 
+/*!
+ * \brief Stop watching the descriptor, it is kept in the set until removed.
+ *
+ * Must be called before the descriptor is closed, the kernel can't find it
+ * in the event set any more afterwards.
+ *
+ * \param set Target set.
+ * \param i Index of the fd.
+ *
+ * \retval 0 if successful.
+ * \retval <0 on errors.
+ */
+int fdset_unwatch(fdset_t *set, unsigned i);
+
+/*!
+ * \brief Get file descriptor at given index.
+ */
+int fdset_get_fd(const fdset_t *set, unsigned i);
+
+/*!
+ * \brief Change the mask of watched events of a file descriptor.
+ *
+ * \param set Target set.
+ * \param i Index of the fd.
+ * \param events Mask of watched events.
+ *
+ * \retval 0 if successful.
+ * \retval -1 on errors.
+ */
+int fdset_set_events(fdset_t *set, unsigned i, unsigned events);
+
+/*!
+ * \brief Wait for events on the watched file descriptors.
+ *
+ * \param set Target set.
+ * \param it Iterator over the received events (output).
+ * \param timeout_ms Maximum wait time (-1 for infinity).
+ *
+ * \retval number of descriptors with events.
+ * \retval -1 on errors.
+ */
+int fdset_poll(fdset_t *set, fdset_it_t *it, int timeout_ms);
+
+/*!
+ * \brief Mark the current descriptor of the iterator for removal.
+ *
+ * The descriptor stops being watched immediately, indexes of the other
+ * descriptors don't change until \a fdset_it_commit is called.
+ *
+ * \retval 0 if successful.
+ * \retval <0 if the descriptor couldn't be unwatched (it's still marked).
+ */
+int fdset_it_remove(fdset_it_t *it);
+
+/*!
+ * \brief Remove descriptors marked by \a fdset_it_remove from the set.
+ *
+ * \retval 0 if successful.
+ * \retval <0 if some descriptor couldn't be updated (all are removed).
+ */
+int fdset_it_commit(fdset_it_t *it);
+
+/*! \brief Check if all descriptors with events were iterated. */
+static inline bool fdset_it_done(const fdset_it_t *it)
+{
+	return it->pos >= it->end;
+}
+
+/*! \brief Move the iterator to the next descriptor with events. */
+static inline void fdset_it_next(fdset_it_t *it)
+{
+	it->pos++;
+}
+
+/*! \brief Get index of the current descriptor of the iterator. */
+static inline unsigned fdset_it_get_idx(const fdset_it_t *it)
+{
+	return it->set->ready[it->pos].idx;
+}
+
+/*! \brief Get received events (POLLIN, POLLOUT, ...) of the current descriptor. */
+static inline unsigned fdset_it_get_events(const fdset_it_t *it)
+{
+	return it->set->ready[it->pos].events;
+}
+
 /*!
  * \brief Set file descriptor watchdog interval.
  *
@@ -102,11 +230,14 @@ int fdset_set_watchdog(fdset_t* set, int i, int interval);
 /*!
  * \brief Sweep file descriptors with exceeding inactivity period.
  *
+ * Only descriptors with expired watchdog timers are visited. A callback
+ * closing the descriptor must call \a fdset_unwatch first.
+ *
  * \param set Target set.
  * \param cb Callback for sweeped descriptors.
  * \param data Pointer to extra data.
  *
- * \retval number of sweeped descriptors.
- * \retval -1 on errors.
+ * \retval 0 if successful.
+ * \retval <0 on errors.
  */
 int fdset_sweep(fdset_t* set, fdset_sweep_cb_t cb, void *data);
@@ -23,6 +23,9 @@
 #include "contrib/files.h"
 #include "knot/common/stats.h"
 #include "knot/common/log.h"
+#include "knot/journal/journal.h"
+#include "knot/nameserver/answer_cache.h"
+#include "knot/nameserver/axfr_cache.h"
 #include "knot/nameserver/query_module.h"
 
 struct {
@@ -51,27 +54,161 @@ uint64_t server_zone_count(server_t *server)
 	return knot_zonedb_size(server->zone_db);
 }
 
+static void zone_answer_cache(zone_t *zone, uint64_t *hits, uint64_t *misses)
+{
+	answer_cache_stats(zone->answer_cache, hits, misses);
+}
+
+static uint64_t server_answer_cache_hit(server_t *server)
+{
+	uint64_t hits = 0, misses = 0;
+	rcu_read_lock();
+	knot_zonedb_foreach(server->zone_db, zone_answer_cache, &hits, &misses);
+	rcu_read_unlock();
+	return hits;
+}
+
+static uint64_t server_answer_cache_miss(server_t *server)
+{
+	uint64_t hits = 0, misses = 0;
+	rcu_read_lock();
+	knot_zonedb_foreach(server->zone_db, zone_answer_cache, &hits, &misses);
+	rcu_read_unlock();
+	return misses;
+}
+
+static void zone_axfr_cache(zone_t *zone, uint64_t *hits, uint64_t *misses)
+{
+	axfr_cache_stats(zone->axfr_cache, hits, misses);
+}
+
+static uint64_t server_axfr_cache_hit(server_t *server)
+{
+	uint64_t hits = 0, misses = 0;
+	rcu_read_lock();
+	knot_zonedb_foreach(server->zone_db, zone_axfr_cache, &hits, &misses);
+	rcu_read_unlock();
+	return hits;
+}
+
+static uint64_t server_axfr_cache_miss(server_t *server)
+{
+	uint64_t hits = 0, misses = 0;
+	rcu_read_lock();
+	knot_zonedb_foreach(server->zone_db, zone_axfr_cache, &hits, &misses);
+	rcu_read_unlock();
+	return misses;
+}
+
+static uint64_t server_udp_dropped(server_t *server)
+{
+#ifdef HAVE_ATOMIC
+	return __atomic_load_n(&server->udp_dropped, __ATOMIC_RELAXED);
+#else
+	return __sync_fetch_and_add(&server->udp_dropped, 0);
+#endif
+}
+
+static journal_group_stats_t server_journal_group(server_t *server)
+{
+	journal_group_stats_t stats = { 0 };
+	journal_db_group_stats(server->journal_db, &stats);
+	return stats;
+}
+
+static uint64_t server_journal_commits(server_t *server)
+{
+	return server_journal_group(server).commits;
+}
+
+static uint64_t server_journal_commit_stores(server_t *server)
+{
+	return server_journal_group(server).stores;
+}
+
+static uint64_t server_journal_commit_max_batch(server_t *server)
+{
+	return server_journal_group(server).max_batch;
+}
+
+static uint64_t server_journal_commit_wait(server_t *server)
+{
+	return server_journal_group(server).wait_usec;
+}
+
+static worker_pool_stats_t server_workers(server_t *server, task_prio_t prio)
+{
+	worker_pool_stats_t stats = { 0 };
+	worker_pool_stats(server->workers, prio, &stats);
+	return stats;
+}
+
+#define WORKER_STATS(class, prio) \
+static uint64_t server_workers_##class##_queued(server_t *server) \
+{ \
+	return server_workers(server, prio).queued; \
+} \
+static uint64_t server_workers_##class##_executed(server_t *server) \
+{ \
+	return server_workers(server, prio).executed; \
+} \
+static uint64_t server_workers_##class##_stolen(server_t *server) \
+{ \
+	return server_workers(server, prio).stolen; \
+} \
+static uint64_t server_workers_##class##_wait(server_t *server) \
+{ \
+	return server_workers(server, prio).wait_usec; \
+}
+
+WORKER_STATS(high,   TASK_PRIO_HIGH)
+WORKER_STATS(normal, TASK_PRIO_NORMAL)
+WORKER_STATS(low,    TASK_PRIO_LOW)
+
 const stats_item_t server_stats[] = {
-	{ "zone-count", server_zone_count },
+	{ "zone-count",                server_zone_count },
+	{ "answer-cache-hit",          server_answer_cache_hit },
+	{ "answer-cache-miss",         server_answer_cache_miss },
+	{ "axfr-cache-hit",            server_axfr_cache_hit },
+	{ "axfr-cache-miss",           server_axfr_cache_miss },
+	{ "udp-dropped",               server_udp_dropped },
+	{ "journal-commits",           server_journal_commits },
+	{ "journal-commit-stores",     server_journal_commit_stores },
+	{ "journal-commit-max-batch",  server_journal_commit_max_batch },
+	{ "journal-commit-wait-usec",  server_journal_commit_wait },
+	{ "worker-high-queued",        server_workers_high_queued },
+	{ "worker-high-executed",      server_workers_high_executed },
+	{ "worker-high-stolen",        server_workers_high_stolen },
+	{ "worker-high-wait-usec",     server_workers_high_wait },
+	{ "worker-normal-queued",      server_workers_normal_queued },
+	{ "worker-normal-executed",    server_workers_normal_executed },
+	{ "worker-normal-stolen",      server_workers_normal_stolen },
+	{ "worker-normal-wait-usec",   server_workers_normal_wait },
+	{ "worker-low-queued",         server_workers_low_queued },
+	{ "worker-low-executed",       server_workers_low_executed },
+	{ "worker-low-stolen",         server_workers_low_stolen },
+	{ "worker-low-wait-usec",      server_workers_low_wait },
 	{ 0 }
 };
 
 static void dump_counters(FILE *fd, int level, mod_ctr_t *ctr)
 {
 	for (uint32_t j = 0; j < ctr->count; j++) {
+		uint64_t counter = mod_ctr_get(ctr, j);
+
 		// Skip empty counters.
-		if (ctr->counters[j] == 0) {
+		if (counter == 0) {
 			continue;
 		}
 
 		if (ctr->idx_to_str != NULL) {
 			char *str = ctr->idx_to_str(j, ctr->count);
 			if (str != NULL) {
-				DUMP_CTR(fd, level, "%s", str, ctr->counters[j]);
+				DUMP_CTR(fd, level, "%s", str, counter);
 				free(str);
 			}
 		} else {
-			DUMP_CTR(fd, level, "%u", j, ctr->counters[j]);
+			DUMP_CTR(fd, level, "%u", j, counter);
 		}
 	}
 }
@@ -114,7 +251,7 @@ static void dump_modules(dump_ctx_t *ctx)
 			}
 			if (ctr->count == 1) {
 				// Simple counter.
-				DUMP_CTR(ctx->fd, level + 1, "%s", ctr->name, ctr->counter);
+				DUMP_CTR(ctx->fd, level + 1, "%s", ctr->name, mod_ctr_get(ctr, 0));
 			} else {
 				// Array of counters.
 				DUMP_STR(ctx->fd, level + 1, "%s", ctr->name, "");
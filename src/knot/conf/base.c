@@ -19,8 +19,10 @@
 
 #include "knot/conf/base.h"
 #include "knot/conf/confdb.h"
+#include "knot/conf/confio.h"
 #include "knot/conf/module.h"
 #include "knot/conf/tools.h"
+#include "knot/conf/zones.h"
 #include "knot/common/log.h"
 #include "knot/nameserver/query_module.h"
 #include "libknot/libknot.h"
@@ -326,6 +328,10 @@ int conf_clone(
 	// Initialize cached values.
 	init_cache(out);
 
+	// Share the compiled zone settings.
+	out->zones = s_conf->zones;
+	conf_zones_retain(out->zones);
+
 	out->is_clone = true;
 
 	*conf = out;
@@ -333,6 +339,31 @@ int conf_clone(
 	return KNOT_EOK;
 }
 
+static void update_zones(
+	conf_t *conf,
+	conf_t *prev)
+{
+	conf_zones_t *prev_zones = (prev != NULL) ? prev->zones : NULL;
+	yp_flag_t io_flags = (prev != NULL) ? prev->io.flags : YP_FNONE;
+
+	// Recompile just the changed zones after a confio commit.
+	bool full = prev_zones == NULL || !(io_flags & CONF_IO_FACTIVE) ||
+	            (io_flags & (CONF_IO_FRLD_ZONES | CONF_IO_FDIFF_ZONES |
+	                         CONF_IO_FCOMPILE_ZONES));
+
+	// The ACLs are always rebuilt as the acl and key sections can
+	// change without marking any zone.
+	conf_zones_t *zones = NULL;
+	if (full) {
+		zones = conf_zones_compile(conf, NULL, NULL);
+	} else {
+		zones = conf_zones_compile(conf, prev_zones, prev->io.zones);
+	}
+
+	conf_zones_release(conf->zones);
+	conf->zones = zones;
+}
+
 conf_t *conf_update(
 	conf_t *conf,
 	conf_update_flag_t flags)
@@ -349,6 +380,9 @@ conf_t *conf_update(
 			conf->query_modules = s_conf->query_modules;
 			conf->query_plan = s_conf->query_plan;
 		}
+		if (flags & CONF_UPD_FZONES) {
+			update_zones(conf, s_conf);
+		}
 	}
 
 	conf_t **current_conf = &s_conf;
@@ -383,6 +417,7 @@ void conf_free(
 		return;
 	}
 
+	conf_zones_release(conf->zones);
 	yp_schema_free(conf->schema);
 	free(conf->filename);
 	free(conf->hostname);
@@ -127,6 +127,9 @@ typedef struct {
 		conf_val_t srv_nsid;
 	} cache;
 
+	/*! Compiled zone settings (shared with clones), can be NULL. */
+	struct conf_zones *zones;
+
 	/*! List of dynamically loaded modules. */
 	mod_dynarray_t modules;
 	/*! List of old schemas (lazy freed). */
@@ -157,6 +160,7 @@ typedef enum {
 	CONF_UPD_FNOFREE  = 1 << 0, /*!< Disable auto-free of previous config. */
 	CONF_UPD_FMODULES = 1 << 1, /*!< Reuse previous global modules. */
 	CONF_UPD_FCONFIO  = 1 << 2, /*!< Reuse previous cofio reload context. */
+	CONF_UPD_FZONES   = 1 << 3, /*!< Compile zone settings. */
 } conf_update_flag_t;
 
 /*!
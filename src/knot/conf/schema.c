@@ -25,6 +25,7 @@
 #include "knot/conf/tools.h"
 #include "knot/common/log.h"
 #include "knot/journal/journal.h"
+#include "knot/server/udp-handler.h"
 #include "knot/updates/acl.h"
 #include "libknot/rrtype/opt.h"
 #include "dnssec/lib/dnssec/tsig.h"
@@ -109,6 +110,13 @@ static const knot_lookup_t log_severities[] = {
 	{ 0, NULL }
 };
 
+static const knot_lookup_t udp_backends[] = {
+	{ UDP_BACKEND_RECVFROM, "recvfrom" },
+	{ UDP_BACKEND_RECVMMSG, "recvmmsg" },
+	{ UDP_BACKEND_IO_URING, "io-uring" },
+	{ 0, NULL }
+};
+
 static const knot_lookup_t journal_modes[] = {
 	{ JOURNAL_MODE_ROBUST, "robust" },
 	{ JOURNAL_MODE_ASYNC,  "asynchronous" },
@@ -131,6 +139,12 @@ static const yp_item_t desc_server[] = {
 	{ C_PIDFILE,              YP_TSTR,  YP_VSTR = { "knot.pid" } },
 	{ C_UDP_WORKERS,          YP_TINT,  YP_VINT = { 1, 255, YP_NIL } },
 	{ C_TCP_WORKERS,          YP_TINT,  YP_VINT = { 1, 255, YP_NIL } },
+	{ C_UDP_BACKEND,          YP_TOPT,  YP_VOPT = { udp_backends, UDP_BACKEND_RECVMMSG } },
+	{ C_UDP_BATCH_SIZE,       YP_TINT,  YP_VINT = { 1, 1024, RECVMMSG_BATCHLEN } },
+	{ C_UDP_RX_SIZE,          YP_TINT,  YP_VINT = { KNOT_WIRE_MIN_PKTSIZE,
+	                                                KNOT_WIRE_MAX_PKTSIZE,
+	                                                UDP_RX_SIZE, YP_SSIZE } },
+	{ C_UDP_RING_SIZE,        YP_TINT,  YP_VINT = { 1, 4096, UDP_RING_SIZE } },
 	{ C_BG_WORKERS,           YP_TINT,  YP_VINT = { 1, 255, YP_NIL } },
 	{ C_ASYNC_START,          YP_TBOOL, YP_VNONE },
 	{ C_TCP_HSHAKE_TIMEOUT,   YP_TINT,  YP_VINT = { 0, INT32_MAX, 5, YP_STIME } },
@@ -253,6 +267,10 @@ static const yp_item_t desc_policy[] = {
 	                                   CONF_IO_FRLD_ZONES },
 	{ C_RRSIG_REFRESH,       YP_TINT,  YP_VINT = { 1, UINT32_MAX, DAYS(7), YP_STIME },
 	                                   CONF_IO_FRLD_ZONES },
+	{ C_RRSIG_JITTER,        YP_TINT,  YP_VINT = { 0, UINT32_MAX, 0, YP_STIME },
+	                                   CONF_IO_FRLD_ZONES },
+	{ C_RRSIG_REFRESH_LIMIT, YP_TINT,  YP_VINT = { 0, UINT32_MAX, 0 }, CONF_IO_FRLD_ZONES },
+	{ C_SIGNING_THREADS,     YP_TINT,  YP_VINT = { 1, 255, YP_NIL }, CONF_IO_FRLD_ZONES },
 	{ C_NSEC3,               YP_TBOOL, YP_VNONE, CONF_IO_FRLD_ZONES },
 	{ C_NSEC3_ITER,          YP_TINT,  YP_VINT = { 0, UINT16_MAX, 10 }, CONF_IO_FRLD_ZONES },
 	{ C_NSEC3_OPT_OUT,       YP_TBOOL, YP_VNONE, CONF_IO_FRLD_ZONES },
@@ -274,6 +292,9 @@ static const yp_item_t desc_policy[] = {
 	{ C_ACL,                 YP_TREF,  YP_VREF = { C_ACL }, YP_FMULTI, { check_ref } }, \
 	{ C_SEM_CHECKS,          YP_TBOOL, YP_VNONE, FLAGS }, \
 	{ C_DISABLE_ANY,         YP_TBOOL, YP_VNONE }, \
+	{ C_ANSWER_CACHE,        YP_TINT,  YP_VINT = { 0, 1 << 20, 0 }, FLAGS }, \
+	{ C_AXFR_CACHE,          YP_TINT,  YP_VINT = { 0, SSIZE_MAX, 0, YP_SSIZE }, FLAGS }, \
+	{ C_AXFR_CACHE_KEEP,     YP_TBOOL, YP_VBOOL = { true }, FLAGS }, \
 	{ C_ZONEFILE_SYNC,       YP_TINT,  YP_VINT = { -1, INT32_MAX, 0, YP_STIME } }, \
 	{ C_JOURNAL_CONTENT,     YP_TOPT,  YP_VOPT = { journal_content, JOURNAL_CONTENT_CHANGES } }, \
 	{ C_ZONEFILE_LOAD,       YP_TOPT,  YP_VOPT = { zonefile_load, ZONEFILE_LOAD_WHOLE } }, \
@@ -331,10 +352,12 @@ const yp_item_t conf_schema[] = {
 	{ C_KEYSTORE, YP_TGRP, YP_VGRP = { desc_keystore }, YP_FMULTI, { check_keystore } },
 	{ C_KEY,      YP_TGRP, YP_VGRP = { desc_key }, YP_FMULTI, { check_key } },
 	{ C_ACL,      YP_TGRP, YP_VGRP = { desc_acl }, YP_FMULTI, { check_acl } },
-	{ C_RMT,      YP_TGRP, YP_VGRP = { desc_remote }, YP_FMULTI, { check_remote } },
+	{ C_RMT,      YP_TGRP, YP_VGRP = { desc_remote }, YP_FMULTI | CONF_IO_FCOMPILE_ZONES,
+	                                                     { check_remote } },
 	{ C_SBM,      YP_TGRP, YP_VGRP = { desc_submission }, YP_FMULTI },
 	{ C_POLICY,   YP_TGRP, YP_VGRP = { desc_policy }, YP_FMULTI, { check_policy } },
-	{ C_TPL,      YP_TGRP, YP_VGRP = { desc_template }, YP_FMULTI, { check_template } },
+	{ C_TPL,      YP_TGRP, YP_VGRP = { desc_template }, YP_FMULTI | CONF_IO_FCOMPILE_ZONES,
+	                                                       { check_template } },
 	{ C_ZONE,     YP_TGRP, YP_VGRP = { desc_zone }, YP_FMULTI | CONF_IO_FZONE, { check_zone } },
 	{ C_INCL,     YP_TSTR, YP_VNONE, CONF_IO_FDIFF_ZONES | CONF_IO_FRLD_ALL, { include_file } },
 	/* Renamed modules. */
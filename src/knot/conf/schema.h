@@ -33,8 +33,11 @@
 #define C_ADDR			"\x07""address"
 #define C_ALG			"\x09""algorithm"
 #define C_ANY			"\x03""any"
+#define C_ANSWER_CACHE		"\x0C""answer-cache"
 #define C_APPEND		"\x06""append"
 #define C_ASYNC_START		"\x0B""async-start"
+#define C_AXFR_CACHE		"\x0A""axfr-cache"
+#define C_AXFR_CACHE_KEEP	"\x0F""axfr-cache-keep"
 #define C_BACKEND		"\x07""backend"
 #define C_BG_WORKERS		"\x12""background-workers"
 #define C_CHK_INTERVAL		"\x0E""check-interval"
@@ -100,14 +103,17 @@
 #define C_RATE_LIMIT_WHITELIST	"\x14""rate-limit-whitelist"
 #define C_REQUEST_EDNS_OPTION	"\x13""request-edns-option"
 #define C_RMT			"\x06""remote"
+#define C_RRSIG_JITTER		"\x0C""rrsig-jitter"
 #define C_RRSIG_LIFETIME	"\x0E""rrsig-lifetime"
 #define C_RRSIG_REFRESH		"\x0D""rrsig-refresh"
+#define C_RRSIG_REFRESH_LIMIT	"\x13""rrsig-refresh-limit"
 #define C_RUNDIR		"\x06""rundir"
 #define C_SBM			"\x0A""submission"
 #define C_SECRET		"\x06""secret"
 #define C_SEM_CHECKS		"\x0F""semantic-checks"
 #define C_SERIAL_POLICY		"\x0D""serial-policy"
 #define C_SERVER		"\x06""server"
+#define C_SIGNING_THREADS	"\x0F""signing-threads"
 #define C_SINGLE_TYPE_SIGNING	"\x13""single-type-signing"
 #define C_SRV			"\x06""server"
 #define C_STATS			"\x0A""statistics"
@@ -121,6 +127,10 @@
 #define C_TIMER			"\x05""timer"
 #define C_TIMER_DB		"\x08""timer-db"
 #define C_TPL			"\x08""template"
+#define C_UDP_BACKEND		"\x0B""udp-backend"
+#define C_UDP_BATCH_SIZE	"\x0E""udp-batch-size"
+#define C_UDP_RING_SIZE		"\x0D""udp-ring-size"
+#define C_UDP_RX_SIZE		"\x0B""udp-rx-size"
 #define C_UDP_WORKERS		"\x0B""udp-workers"
 #define C_USER			"\x04""user"
 #define C_VERSION		"\x07""version"
@@ -153,6 +163,12 @@ enum {
 	ZONEFILE_LOAD_WHOLE = 2,
 };
 
+enum {
+	UDP_BACKEND_RECVFROM = 1,
+	UDP_BACKEND_RECVMMSG = 2,
+	UDP_BACKEND_IO_URING = 3
+};
+
 extern const knot_lookup_t acl_actions[];
 
 extern const yp_item_t conf_schema[];
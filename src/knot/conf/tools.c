@@ -319,6 +319,8 @@ int check_policy(
 	                                    C_RRSIG_LIFETIME, args->id, args->id_len);
 	conf_val_t refresh = conf_rawid_get_txn(args->extra->conf, args->extra->txn, C_POLICY,
 	                                    C_RRSIG_REFRESH, args->id, args->id_len);
+	conf_val_t jitter = conf_rawid_get_txn(args->extra->conf, args->extra->txn, C_POLICY,
+	                                    C_RRSIG_JITTER, args->id, args->id_len);
 
 	conf_val_t prop_del = conf_rawid_get_txn(args->extra->conf, args->extra->txn, C_POLICY,
 						 C_PROPAG_DELAY, args->id, args->id_len);
@@ -354,6 +356,12 @@ int check_policy(
 		return KNOT_EINVAL;
 	}
 
+	int64_t jitter_val = conf_int(&jitter);
+	if (lifetime_val - jitter_val <= refresh_val) {
+		args->err_str = "RRSIG refresh has to be lower than RRSIG lifetime minus jitter";
+		return KNOT_EINVAL;
+	}
+
 	int64_t prop_del_val = conf_int(&prop_del);
 	int64_t zsk_life_val = conf_int(&zsk_life);
 	int64_t ksk_life_val = conf_int(&ksk_life);
@@ -0,0 +1,397 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "knot/conf/zones.h"
+#include "knot/common/log.h"
+#include "knot/common/ref.h"
+#include "knot/updates/acl.h"
+#include "contrib/mempattern.h"
+#include "contrib/qp-trie/trie.h"
+#include "contrib/ucw/mempool.h"
+
+struct conf_zones {
+	ref_t ref;
+	knot_mm_t mm;
+	trie_t *trie; // Zone name -> conf_zone_t.
+	trie_t *acls; // ACL list value -> acl_t.
+	acl_t *no_acl;
+};
+
+static const acl_t *zone_acl(
+	conf_t *conf,
+	conf_zones_t *zones,
+	conf_val_t *val)
+{
+	switch (val->code) {
+	case KNOT_EOK:
+		break;
+	case KNOT_ENOENT:
+		return zones->no_acl;
+	default:
+		return NULL;
+	}
+
+	// Zones mostly share a few ACL lists, compile each once.
+	trie_val_t *acl = trie_get_ins(zones->acls, (const char *)val->blob,
+	                               val->blob_len);
+	if (acl == NULL) {
+		return NULL;
+	}
+	if (*acl == NULL) {
+		*acl = acl_compile(conf, val);
+	}
+
+	return *acl;
+}
+
+static void compile_zone(
+	conf_t *conf,
+	knot_db_txn_t *txn,
+	const knot_dname_t *name,
+	conf_zones_t *zones,
+	conf_zone_t *out)
+{
+	conf_val_t val = conf_zone_get_txn(conf, txn, C_MASTER, name);
+	out->is_slave = conf_val_count(&val) > 0;
+
+	val = conf_zone_get_txn(conf, txn, C_DISABLE_ANY, name);
+	out->disable_any = conf_bool(&val);
+
+	val = conf_zone_get_txn(conf, txn, C_DNSSEC_SIGNING, name);
+	out->dnssec_signing = conf_bool(&val);
+
+	val = conf_zone_get_txn(conf, txn, C_SEM_CHECKS, name);
+	out->sem_checks = conf_bool(&val);
+
+	val = conf_zone_get_txn(conf, txn, C_SERIAL_POLICY, name);
+	out->serial_policy = conf_opt(&val);
+
+	val = conf_zone_get_txn(conf, txn, C_JOURNAL_CONTENT, name);
+	out->journal_content = conf_opt(&val);
+
+	val = conf_zone_get_txn(conf, txn, C_ZONEFILE_SYNC, name);
+	out->zonefile_sync = conf_int(&val);
+
+	val = conf_zone_get_txn(conf, txn, C_MAX_ZONE_SIZE, name);
+	out->max_zone_size = conf_int(&val);
+
+	val = conf_zone_get_txn(conf, txn, C_MAX_JOURNAL_USAGE, name);
+	out->max_journal_usage = conf_int(&val);
+
+	val = conf_zone_get_txn(conf, txn, C_MAX_JOURNAL_DEPTH, name);
+	out->max_journal_depth = conf_int(&val);
+
+	val = conf_zone_get_txn(conf, txn, C_MIN_REFRESH_INTERVAL, name);
+	out->min_refresh_interval = conf_int(&val);
+
+	val = conf_zone_get_txn(conf, txn, C_MAX_REFRESH_INTERVAL, name);
+	out->max_refresh_interval = conf_int(&val);
+
+	// ACLs are compiled only into the table.
+	if (zones != NULL) {
+		val = conf_zone_get_txn(conf, txn, C_ACL, name);
+		out->acl = zone_acl(conf, zones, &val);
+	} else {
+		out->acl = NULL;
+	}
+}
+
+static int insert_zone(
+	conf_zones_t *zones,
+	const char *key,
+	size_t key_len,
+	const conf_zone_t *zone)
+{
+	conf_zone_t *copy = mm_alloc(&zones->mm, sizeof(*copy));
+	if (copy == NULL) {
+		return KNOT_ENOMEM;
+	}
+	*copy = *zone;
+
+	trie_val_t *val = trie_get_ins(zones->trie, key, key_len);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+	*val = copy;
+
+	return KNOT_EOK;
+}
+
+static int compile_all(
+	conf_t *conf,
+	conf_zones_t *zones)
+{
+	for (conf_iter_t iter = conf_iter(conf, C_ZONE); iter.code == KNOT_EOK;
+	     conf_iter_next(conf, &iter)) {
+		conf_val_t id = conf_iter_id(conf, &iter);
+		const knot_dname_t *name = conf_dname(&id);
+
+		conf_zone_t zone;
+		compile_zone(conf, &conf->read_txn, name, zones, &zone);
+
+		int ret = insert_zone(zones, (const char *)name,
+		                      knot_dname_size(name), &zone);
+		if (ret != KNOT_EOK) {
+			conf_iter_finish(conf, &iter);
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static int recompile_acls(
+	conf_t *conf,
+	conf_zones_t *zones,
+	conf_zones_t *prev,
+	trie_t *remap)
+{
+	// The ACL and key sections can change without marking the zones.
+	conf_val_t val = {
+		.item = yp_schema_find(C_ACL, C_ZONE, conf->schema),
+		.code = KNOT_EOK
+	};
+	if (val.item == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	trie_it_t *it = trie_it_begin(prev->acls);
+	for (; !trie_it_finished(it); trie_it_next(it)) {
+		size_t len;
+		val.blob = (const uint8_t *)trie_it_key(it, &len);
+		val.blob_len = len;
+		val.data = NULL;
+		val.code = KNOT_EOK;
+
+		const acl_t *old = *trie_it_val(it);
+		trie_val_t *new = trie_get_ins(remap, (const char *)&old, sizeof(old));
+		if (new == NULL) {
+			trie_it_free(it);
+			return KNOT_ENOMEM;
+		}
+		*new = (trie_val_t)zone_acl(conf, zones, &val);
+	}
+	trie_it_free(it);
+
+	return KNOT_EOK;
+}
+
+static int compile_changed(
+	conf_t *conf,
+	conf_zones_t *zones,
+	conf_zones_t *prev,
+	trie_t *changed)
+{
+	trie_t *remap = trie_create(&zones->mm);
+	if (remap == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = recompile_acls(conf, zones, prev, remap);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	// Copy the unchanged zones.
+	trie_it_t *it = trie_it_begin(prev->trie);
+	for (; !trie_it_finished(it); trie_it_next(it)) {
+		size_t len;
+		const char *key = trie_it_key(it, &len);
+		if (changed != NULL && trie_get_try(changed, key, len) != NULL) {
+			continue;
+		}
+
+		conf_zone_t zone = *(conf_zone_t *)*trie_it_val(it);
+		if (zone.acl == prev->no_acl) {
+			zone.acl = zones->no_acl;
+		} else if (zone.acl != NULL) {
+			trie_val_t *acl = trie_get_try(remap, (const char *)&zone.acl,
+			                               sizeof(zone.acl));
+			zone.acl = (acl != NULL) ? *acl : NULL;
+		}
+
+		ret = insert_zone(zones, key, len, &zone);
+		if (ret != KNOT_EOK) {
+			trie_it_free(it);
+			return ret;
+		}
+	}
+	trie_it_free(it);
+
+	if (changed == NULL) {
+		return KNOT_EOK;
+	}
+
+	// Compile the changed zones, skip the removed ones.
+	it = trie_it_begin(changed);
+	for (; !trie_it_finished(it); trie_it_next(it)) {
+		size_t len;
+		const char *key = trie_it_key(it, &len);
+		if (!conf_rawid_exists(conf, C_ZONE, (const uint8_t *)key, len)) {
+			continue;
+		}
+
+		conf_zone_t zone;
+		compile_zone(conf, &conf->read_txn, (const knot_dname_t *)key,
+		             zones, &zone);
+
+		ret = insert_zone(zones, key, len, &zone);
+		if (ret != KNOT_EOK) {
+			trie_it_free(it);
+			return ret;
+		}
+	}
+	trie_it_free(it);
+
+	return KNOT_EOK;
+}
+
+static int acl_free_cb(trie_val_t *val, void *ctx)
+{
+	acl_free(*val);
+	return KNOT_EOK;
+}
+
+static void zones_free(ref_t *ref)
+{
+	conf_zones_t *zones = (conf_zones_t *)ref;
+
+	if (zones->acls != NULL) {
+		trie_apply(zones->acls, acl_free_cb, NULL);
+		trie_free(zones->acls);
+	}
+	acl_free(zones->no_acl);
+
+	// The entries are allocated from the mempool.
+	trie_free(zones->trie);
+	mp_delete(zones->mm.ctx);
+	free(zones);
+}
+
+conf_zones_t *conf_zones_compile(
+	conf_t *conf,
+	conf_zones_t *prev,
+	trie_t *changed)
+{
+	if (conf == NULL) {
+		return NULL;
+	}
+
+	conf_zones_t *zones = calloc(1, sizeof(*zones));
+	if (zones == NULL) {
+		return NULL;
+	}
+
+	mm_ctx_mempool(&zones->mm, MM_DEFAULT_BLKSIZE);
+	zones->trie = trie_create(&zones->mm);
+	if (zones->trie == NULL) {
+		mp_delete(zones->mm.ctx);
+		free(zones);
+		return NULL;
+	}
+
+	ref_init(&zones->ref, zones_free);
+	ref_retain(&zones->ref);
+
+	conf_val_t no_acl = { .code = KNOT_ENOENT };
+	zones->acls = trie_create(&zones->mm);
+	zones->no_acl = acl_compile(conf, &no_acl);
+
+	int ret = KNOT_ENOMEM;
+	if (zones->acls != NULL && zones->no_acl != NULL) {
+		ret = (prev != NULL) ? compile_changed(conf, zones, prev, changed) :
+		                       compile_all(conf, zones);
+	}
+	if (ret != KNOT_EOK) {
+		CONF_LOG(LOG_WARNING, "failed to compile zone settings (%s)",
+		         knot_strerror(ret));
+		conf_zones_release(zones);
+		return NULL;
+	}
+
+	return zones;
+}
+
+void conf_zones_retain(
+	conf_zones_t *zones)
+{
+	if (zones != NULL) {
+		ref_retain(&zones->ref);
+	}
+}
+
+void conf_zones_release(
+	conf_zones_t *zones)
+{
+	if (zones != NULL) {
+		ref_release(&zones->ref);
+	}
+}
+
+size_t conf_zones_count(
+	conf_zones_t *zones)
+{
+	if (zones == NULL) {
+		return 0;
+	}
+
+	return trie_weight(zones->trie);
+}
+
+conf_zone_t conf_zone_txn(
+	conf_t *conf,
+	knot_db_txn_t *txn,
+	const knot_dname_t *name)
+{
+	assert(conf != NULL && name != NULL);
+
+	// The compiled settings correspond to the committed configuration.
+	if (conf->zones != NULL && txn == &conf->read_txn) {
+		trie_val_t *val = trie_get_try(conf->zones->trie, (const char *)name,
+		                               knot_dname_size(name));
+		if (val != NULL) {
+			return *(conf_zone_t *)*val;
+		}
+	}
+
+	conf_zone_t out;
+	compile_zone(conf, txn, name, NULL, &out);
+
+	return out;
+}
+
+const struct acl *conf_zone_acl(
+	conf_t *conf,
+	const knot_dname_t *name)
+{
+	assert(conf != NULL && name != NULL);
+
+	if (conf->zones == NULL) {
+		return NULL;
+	}
+
+	trie_val_t *val = trie_get_try(conf->zones->trie, (const char *)name,
+	                               knot_dname_size(name));
+	if (val == NULL) {
+		return NULL;
+	}
+
+	return ((conf_zone_t *)*val)->acl;
+}
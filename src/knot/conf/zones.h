@@ -0,0 +1,156 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file
+ *
+ * Compiled zone settings.
+ *
+ * The frequently used zone items are resolved (explicit zone value, template,
+ * default template) once per configuration commit and stored in an immutable
+ * table, which is shared by the master configuration and its clones.
+ *
+ * \addtogroup config
+ *
+ * @{
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "knot/conf/conf.h"
+
+struct acl;
+
+/*! Resolved zone settings. */
+typedef struct {
+	/*! At least one master is configured. */
+	bool is_slave;
+	/*! C_DISABLE_ANY value. */
+	bool disable_any;
+	/*! C_DNSSEC_SIGNING value. */
+	bool dnssec_signing;
+	/*! C_SEM_CHECKS value. */
+	bool sem_checks;
+	/*! C_SERIAL_POLICY value. */
+	unsigned serial_policy;
+	/*! C_JOURNAL_CONTENT value. */
+	unsigned journal_content;
+	/*! C_ZONEFILE_SYNC value. */
+	int64_t zonefile_sync;
+	/*! C_MAX_ZONE_SIZE value. */
+	int64_t max_zone_size;
+	/*! C_MAX_JOURNAL_USAGE value. */
+	int64_t max_journal_usage;
+	/*! C_MAX_JOURNAL_DEPTH value. */
+	int64_t max_journal_depth;
+	/*! C_MIN_REFRESH_INTERVAL value. */
+	int64_t min_refresh_interval;
+	/*! C_MAX_REFRESH_INTERVAL value. */
+	int64_t max_refresh_interval;
+	/*! Compiled C_ACL list, NULL if not available. */
+	const struct acl *acl;
+} conf_zone_t;
+
+/*! Table of compiled zone settings. */
+typedef struct conf_zones conf_zones_t;
+
+/*!
+ * Compiles the settings of all configured zones.
+ *
+ * If the previous table and the set of changed zones are specified, only
+ * the changed zones are compiled and the other entries are copied.
+ *
+ * \param[in] conf     Configuration.
+ * \param[in] prev     Previous table (optional).
+ * \param[in] changed  Changed zones, the keys are zone names (optional).
+ *
+ * \return New table with one reference or NULL if failed.
+ */
+conf_zones_t *conf_zones_compile(
+	conf_t *conf,
+	conf_zones_t *prev,
+	trie_t *changed
+);
+
+/*!
+ * Takes a reference to the table.
+ *
+ * \param[in] zones  Table of compiled zone settings.
+ */
+void conf_zones_retain(
+	conf_zones_t *zones
+);
+
+/*!
+ * Releases a reference to the table, the last one frees it.
+ *
+ * \param[in] zones  Table of compiled zone settings.
+ */
+void conf_zones_release(
+	conf_zones_t *zones
+);
+
+/*!
+ * Returns the number of zones in the table.
+ *
+ * \param[in] zones  Table of compiled zone settings.
+ *
+ * \return Number of zones.
+ */
+size_t conf_zones_count(
+	conf_zones_t *zones
+);
+
+/*!
+ * Gets the settings of the zone.
+ *
+ * The compiled settings are used if available, otherwise the settings
+ * are resolved from the configuration database.
+ *
+ * \param[in] conf  Configuration.
+ * \param[in] txn   Configuration DB transaction.
+ * \param[in] name  Zone name.
+ *
+ * \return Zone settings.
+ */
+conf_zone_t conf_zone_txn(
+	conf_t *conf,
+	knot_db_txn_t *txn,
+	const knot_dname_t *name
+);
+static inline conf_zone_t conf_zone(
+	conf_t *conf,
+	const knot_dname_t *name)
+{
+	return conf_zone_txn(conf, &conf->read_txn, name);
+}
+
+/*!
+ * Gets the compiled ACL of the zone.
+ *
+ * \param[in] conf  Configuration.
+ * \param[in] name  Zone name.
+ *
+ * \return Compiled ACL or NULL if not available.
+ */
+const struct acl *conf_zone_acl(
+	conf_t *conf,
+	const knot_dname_t *name
+);
+
+/*! @} */
@@ -17,6 +17,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <urcu.h>
 
 #include "knot/common/log.h"
 #include "knot/common/stats.h"
@@ -34,6 +35,7 @@
 #include "contrib/macros.h"
 #include "contrib/mempattern.h"
 #include "contrib/string.h"
+#include "contrib/ucw/mempool.h"
 #include "zscanner/scanner.h"
 #include "contrib/strtonum.h"
 
@@ -73,6 +75,85 @@ void ctl_log_data(knot_ctl_data_t *data)
 	}
 }
 
+/*! Data unit queued by a read-only command. */
+typedef struct {
+	node_t n;
+	knot_ctl_type_t type;
+	knot_ctl_data_t data;
+} ctl_unit_t;
+
+static int ctl_send(ctl_args_t *args, knot_ctl_type_t type, knot_ctl_data_t *data)
+{
+	if (!args->deferred) {
+		return knot_ctl_send(args->ctl, type, data);
+	}
+
+	ctl_unit_t *unit = mm_alloc(&args->out_mm, sizeof(*unit));
+	if (unit == NULL) {
+		return KNOT_ENOMEM;
+	}
+	memset(unit, 0, sizeof(*unit));
+	unit->type = type;
+
+	// The data can point to buffers reused for the next data unit.
+	for (size_t i = 0; data != NULL && i < KNOT_CTL_IDX__COUNT; i++) {
+		const char *item = (*data)[i];
+		if (item == NULL) {
+			continue;
+		}
+
+		size_t len = strlen(item) + 1;
+		char *copy = mm_alloc(&args->out_mm, len);
+		if (copy == NULL) {
+			return KNOT_ENOMEM;
+		}
+		memcpy(copy, item, len);
+		unit->data[i] = copy;
+	}
+
+	add_tail(&args->out, &unit->n);
+
+	return KNOT_EOK;
+}
+
+static int ctl_flush(ctl_args_t *args)
+{
+	int ret = KNOT_EOK;
+
+	ctl_unit_t *unit;
+	WALK_LIST(unit, args->out) {
+		ret = knot_ctl_send(args->ctl, unit->type, &unit->data);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+	}
+
+	init_list(&args->out);
+	mp_flush(args->out_mm.ctx);
+
+	return ret;
+}
+
+/*! Enters a read-side section of a read-only command. */
+static void read_begin(ctl_args_t *args)
+{
+	if (args->deferred) {
+		rcu_read_lock();
+	}
+}
+
+/*! Leaves the read-side section and sends the output queued in it. */
+static int read_end(ctl_args_t *args)
+{
+	if (!args->deferred) {
+		return KNOT_EOK;
+	}
+
+	rcu_read_unlock();
+
+	return ctl_flush(args);
+}
+
 static void send_error(ctl_args_t *args, const char *msg)
 {
 	knot_ctl_data_t data;
@@ -80,7 +161,7 @@ static void send_error(ctl_args_t *args, const char *msg)
 
 	data[KNOT_CTL_IDX_ERROR] = msg;
 
-	int ret = knot_ctl_send(args->ctl, KNOT_CTL_TYPE_DATA, &data);
+	int ret = ctl_send(args, KNOT_CTL_TYPE_DATA, &data);
 	if (ret != KNOT_EOK) {
 		log_ctl_debug("control, failed to send error (%s)", knot_strerror(ret));
 	}
@@ -113,15 +194,33 @@ static int get_zone(ctl_args_t *args, zone_t **zone)
 
 static int zones_apply(ctl_args_t *args, int (*fcn)(zone_t *, ctl_args_t *))
 {
+	int ret = KNOT_EOK;
+
 	// Process all configured zones if none is specified.
 	if (args->data[KNOT_CTL_IDX_ZONE] == NULL) {
-		knot_zonedb_foreach(args->server->zone_db, fcn, args);
-		return KNOT_EOK;
+		// Continue after the last zone as the database can be replaced
+		// between the read-side sections.
+		uint8_t name[KNOT_DNAME_MAXLEN];
+		bool first = true;
+
+		while (true) {
+			read_begin(args);
+			zone_t *zone = knot_zonedb_find_next(args->server->zone_db,
+			                                     first ? NULL : name);
+			if (zone != NULL) {
+				memcpy(name, zone->name, knot_dname_size(zone->name));
+				first = false;
+				(void)fcn(zone, args);
+			}
+			ret = read_end(args);
+			if (zone == NULL || ret != KNOT_EOK) {
+				return ret;
+			}
+		}
 	}
 
-	int ret = KNOT_EOK;
-
 	while (true) {
+		read_begin(args);
 		zone_t *zone;
 		ret = get_zone(args, &zone);
 		if (ret == KNOT_EOK) {
@@ -132,6 +231,10 @@ static int zones_apply(ctl_args_t *args, int (*fcn)(zone_t *, ctl_args_t *))
 			                       "control, error (%s)", knot_strerror(ret));
 			send_error(args, knot_strerror(ret));
 		}
+		ret = read_end(args);
+		if (ret != KNOT_EOK) {
+			break;
+		}
 
 		// Get next zone name.
 		ret = knot_ctl_receive(args->ctl, &args->type, &args->data);
@@ -168,7 +271,7 @@ static int zone_status(zone_t *zone, ctl_args_t *args)
 			data[KNOT_CTL_IDX_DATA] = "master";
 		}
 
-		ret = knot_ctl_send(args->ctl, type, &data);
+		ret = ctl_send(args, type, &data);
 		if (ret != KNOT_EOK) {
 			return ret;
 		} else {
@@ -192,7 +295,7 @@ static int zone_status(zone_t *zone, ctl_args_t *args)
 
 		data[KNOT_CTL_IDX_DATA] = buff;
 
-		ret = knot_ctl_send(args->ctl, type, &data);
+		ret = ctl_send(args, type, &data);
 		if (ret != KNOT_EOK) {
 			return ret;
 		} else {
@@ -203,7 +306,7 @@ static int zone_status(zone_t *zone, ctl_args_t *args)
 	if (MATCH_FILTER(args, CTL_FILTER_STATUS_TRANSACTION)) {
 		data[KNOT_CTL_IDX_TYPE] = "transaction";
 		data[KNOT_CTL_IDX_DATA] = (zone->control_update != NULL) ? "open" : "none";
-		ret = knot_ctl_send(args->ctl, type, &data);
+		ret = ctl_send(args, type, &data);
 		if (ret != KNOT_EOK) {
 			return ret;
 		} else {
@@ -228,7 +331,7 @@ static int zone_status(zone_t *zone, ctl_args_t *args)
 
 			}
 		}
-		ret = knot_ctl_send(args->ctl, type, &data);
+		ret = ctl_send(args, type, &data);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
@@ -262,7 +365,7 @@ static int zone_status(zone_t *zone, ctl_args_t *args)
 			}
 			data[KNOT_CTL_IDX_DATA] = buff;
 
-			ret = knot_ctl_send(args->ctl, type, &data);
+			ret = ctl_send(args, type, &data);
 			if (ret != KNOT_EOK) {
 				return ret;
 			}
@@ -538,7 +641,7 @@ static int send_rrset(knot_rrset_t *rrset, send_ctx_t *ctx)
 			return ret;
 		}
 
-		ret = knot_ctl_send(ctx->args->ctl, KNOT_CTL_TYPE_DATA, &ctx->data);
+		ret = ctl_send(ctx->args, KNOT_CTL_TYPE_DATA, &ctx->data);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
@@ -618,6 +721,65 @@ static int get_owner(uint8_t *out, size_t out_len, knot_dname_t *origin,
 	return KNOT_EOK;
 }
 
+static int send_nodes(const knot_dname_t *zone_name, send_ctx_t *ctx)
+{
+	ctl_args_t *args = ctx->args;
+
+	uint8_t owner[KNOT_DNAME_MAXLEN];
+	bool first = true;
+
+	while (true) {
+		// The zone or its contents could have been replaced meanwhile.
+		zone_t *zone = knot_zonedb_find(args->server->zone_db, zone_name);
+		if (zone == NULL || zone->contents == NULL) {
+			return KNOT_EOK;
+		}
+
+		zone_tree_it_t it = { 0 };
+		int ret;
+		if (first) {
+			ret = zone_tree_it_begin(zone->contents->nodes, &it);
+		} else {
+			// Continue after the last sent node, which might not exist now.
+			ret = zone_tree_it_begin_leq(zone->contents->nodes, owner, &it);
+			if (ret == KNOT_EOK && zone_tree_it_finished(&it)) {
+				zone_tree_it_free(&it);
+				ret = zone_tree_it_begin(zone->contents->nodes, &it);
+			} else if (ret == KNOT_EOK) {
+				zone_tree_it_next(&it);
+			}
+		}
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		zone_node_t *node = NULL;
+		if (!zone_tree_it_finished(&it)) {
+			node = zone_tree_it_val(&it);
+		}
+		zone_tree_it_free(&it);
+		if (node == NULL) {
+			return KNOT_EOK;
+		}
+
+		ret = send_node(node, ctx);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		memcpy(owner, node->owner, knot_dname_size(node->owner));
+		first = false;
+
+		// Leave the read-side section after each node. A contents switched
+		// meanwhile is continued from the same owner, so the output can
+		// combine both versions of the zone.
+		ret = read_end(args);
+		read_begin(args);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+}
+
 static int zone_read(zone_t *zone, ctl_args_t *args)
 {
 	send_ctx_t *ctx = create_send_ctx(zone->name, args);
@@ -625,6 +787,9 @@ static int zone_read(zone_t *zone, ctl_args_t *args)
 		return KNOT_ENOMEM;
 	}
 
+	// The contents can be switched by a concurrent transaction.
+	zone_contents_t *contents = zone->contents;
+
 	int ret = KNOT_EOK;
 
 	if (args->data[KNOT_CTL_IDX_OWNER] != NULL) {
@@ -635,15 +800,19 @@ static int zone_read(zone_t *zone, ctl_args_t *args)
 			goto zone_read_failed;
 		}
 
-		const zone_node_t *node = zone_contents_find_node(zone->contents, owner);
+		const zone_node_t *node = zone_contents_find_node(contents, owner);
 		if (node == NULL) {
 			ret = KNOT_ENONODE;
 			goto zone_read_failed;
 		}
 
 		ret = send_node((zone_node_t *)node, ctx);
-	} else if (zone->contents != NULL) {
-		ret = zone_contents_apply(zone->contents, send_node, ctx);
+	} else if (contents != NULL) {
+		// The zone isn't valid after the first node is sent.
+		uint8_t name[KNOT_DNAME_MAXLEN];
+		memcpy(name, zone->name, knot_dname_size(zone->name));
+
+		ret = send_nodes(name, ctx);
 	}
 
 zone_read_failed:
@@ -1037,7 +1206,8 @@ static int send_stats_ctr(mod_ctr_t *ctr, ctl_args_t *args, knot_ctl_data_t *dat
 	char value[32];
 
 	if (ctr->count == 1) {
-		int ret = snprintf(value, sizeof(value), "%"PRIu64, ctr->counter);
+		int ret = snprintf(value, sizeof(value), "%"PRIu64,
+		                   mod_ctr_get(ctr, 0));
 		if (ret <= 0 || ret >= sizeof(value)) {
 			return KNOT_ESPACE;
 		}
@@ -1045,7 +1215,7 @@ static int send_stats_ctr(mod_ctr_t *ctr, ctl_args_t *args, knot_ctl_data_t *dat
 		(*data)[KNOT_CTL_IDX_ID] = NULL;
 		(*data)[KNOT_CTL_IDX_DATA] = value;
 
-		ret = knot_ctl_send(args->ctl, KNOT_CTL_TYPE_DATA, data);
+		ret = ctl_send(args, KNOT_CTL_TYPE_DATA, data);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
@@ -1054,8 +1224,10 @@ static int send_stats_ctr(mod_ctr_t *ctr, ctl_args_t *args, knot_ctl_data_t *dat
 		                          CTL_FLAG_FORCE);
 
 		for (uint32_t i = 0; i < ctr->count; i++) {
+			uint64_t counter = mod_ctr_get(ctr, i);
+
 			// Skip empty counters.
-			if (ctr->counters[i] == 0 && !force) {
+			if (counter == 0 && !force) {
 				continue;
 			}
 
@@ -1074,8 +1246,7 @@ static int send_stats_ctr(mod_ctr_t *ctr, ctl_args_t *args, knot_ctl_data_t *dat
 				return KNOT_ESPACE;
 			}
 
-			ret = snprintf(value, sizeof(value), "%"PRIu64,
-			               ctr->counters[i]);
+			ret = snprintf(value, sizeof(value), "%"PRIu64, counter);
 			if (ret <= 0 || ret >= sizeof(value)) {
 				return KNOT_ESPACE;
 			}
@@ -1085,7 +1256,7 @@ static int send_stats_ctr(mod_ctr_t *ctr, ctl_args_t *args, knot_ctl_data_t *dat
 
 			knot_ctl_type_t type = (i == 0) ? KNOT_CTL_TYPE_DATA :
 			                                  KNOT_CTL_TYPE_EXTRA;
-			ret = knot_ctl_send(args->ctl, type, data);
+			ret = ctl_send(args, type, data);
 			if (ret != KNOT_EOK) {
 				return ret;
 			}
@@ -1250,7 +1421,7 @@ static int server_status(ctl_args_t *args)
 
 	args->data[KNOT_CTL_IDX_DATA] = buff;
 
-	return knot_ctl_send(args->ctl, KNOT_CTL_TYPE_DATA, &args->data);
+	return ctl_send(args, KNOT_CTL_TYPE_DATA, &args->data);
 }
 
 static int ctl_server(ctl_args_t *args, ctl_cmd_t cmd)
@@ -1259,10 +1430,12 @@ static int ctl_server(ctl_args_t *args, ctl_cmd_t cmd)
 
 	switch (cmd) {
 	case CTL_STATUS:
+		read_begin(args);
 		ret = server_status(args);
 		if (ret != KNOT_EOK) {
 			send_error(args, knot_strerror(ret));
 		}
+		(void)read_end(args);
 		break;
 	case CTL_STOP:
 		ret = KNOT_CTL_ESTOP;
@@ -1281,7 +1454,7 @@ static int ctl_server(ctl_args_t *args, ctl_cmd_t cmd)
 	return ret;
 }
 
-static int ctl_stats(ctl_args_t *args, ctl_cmd_t cmd)
+static int send_stats(ctl_args_t *args)
 {
 	const char *section = args->data[KNOT_CTL_IDX_SECTION];
 	const char *item = args->data[KNOT_CTL_IDX_ITEM];
@@ -1318,7 +1491,7 @@ static int ctl_stats(ctl_args_t *args, ctl_cmd_t cmd)
 				return ret;
 			}
 
-			ret = knot_ctl_send(args->ctl, KNOT_CTL_TYPE_DATA, &data);
+			ret = ctl_send(args, KNOT_CTL_TYPE_DATA, &data);
 			if (ret != KNOT_EOK) {
 				send_error(args, knot_strerror(ret));
 				return ret;
@@ -1345,9 +1518,18 @@ static int ctl_stats(ctl_args_t *args, ctl_cmd_t cmd)
 	return KNOT_EOK;
 }
 
+static int ctl_stats(ctl_args_t *args, ctl_cmd_t cmd)
+{
+	read_begin(args);
+	int ret = send_stats(args);
+	int flush_ret = read_end(args);
+
+	return (ret != KNOT_EOK) ? ret : flush_ret;
+}
+
 static int send_block_data(conf_io_t *io, knot_ctl_data_t *data)
 {
-	knot_ctl_t *ctl = (knot_ctl_t *)io->misc;
+	ctl_args_t *args = (ctl_args_t *)io->misc;
 
 	const yp_item_t *item = (io->key1 != NULL) ? io->key1 : io->key0;
 	assert(item != NULL);
@@ -1364,7 +1546,7 @@ static int send_block_data(conf_io_t *io, knot_ctl_data_t *data)
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
-		return knot_ctl_send(ctl, KNOT_CTL_TYPE_DATA, data);
+		return ctl_send(args, KNOT_CTL_TYPE_DATA, data);
 	// Format all multivalued item data if no specified index.
 	} else if ((item->flags & YP_FMULTI) && io->data.index == 0) {
 		size_t values = conf_val_count(io->data.val);
@@ -1380,7 +1562,7 @@ static int send_block_data(conf_io_t *io, knot_ctl_data_t *data)
 
 			knot_ctl_type_t type = (i == 0) ? KNOT_CTL_TYPE_DATA :
 			                                  KNOT_CTL_TYPE_EXTRA;
-			ret = knot_ctl_send(ctl, type, data);
+			ret = ctl_send(args, type, data);
 			if (ret != KNOT_EOK) {
 				return ret;
 			}
@@ -1397,13 +1579,13 @@ static int send_block_data(conf_io_t *io, knot_ctl_data_t *data)
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
-		return knot_ctl_send(ctl, KNOT_CTL_TYPE_DATA, data);
+		return ctl_send(args, KNOT_CTL_TYPE_DATA, data);
 	}
 }
 
 static int send_block(conf_io_t *io)
 {
-	knot_ctl_t *ctl = (knot_ctl_t *)io->misc;
+	ctl_args_t *args = (ctl_args_t *)io->misc;
 
 	// Get possible error message.
 	const char *err = io->error.str;
@@ -1447,7 +1629,7 @@ static int send_block(conf_io_t *io)
 	}
 
 	if (io->data.val == NULL && io->data.bin == NULL) {
-		return knot_ctl_send(ctl, KNOT_CTL_TYPE_DATA, &data);
+		return ctl_send(args, KNOT_CTL_TYPE_DATA, &data);
 	} else {
 		return send_block_data(io, &data);
 	}
@@ -1457,7 +1639,7 @@ static int ctl_conf_txn(ctl_args_t *args, ctl_cmd_t cmd)
 {
 	conf_io_t io = {
 		.fcn = send_block,
-		.misc = args->ctl
+		.misc = args
 	};
 
 	int ret = KNOT_EOK;
@@ -1506,7 +1688,7 @@ static int ctl_conf_read(ctl_args_t *args, ctl_cmd_t cmd)
 {
 	conf_io_t io = {
 		.fcn = send_block,
-		.misc = args->ctl
+		.misc = args
 	};
 
 	int ret = KNOT_EOK;
@@ -1516,6 +1698,8 @@ static int ctl_conf_read(ctl_args_t *args, ctl_cmd_t cmd)
 		const char *key1 = args->data[KNOT_CTL_IDX_ITEM];
 		const char *id   = args->data[KNOT_CTL_IDX_ID];
 
+		read_begin(args);
+
 		switch (cmd) {
 		case CTL_CONF_LIST:
 			ret = conf_io_list(key0, &io);
@@ -1535,6 +1719,11 @@ static int ctl_conf_read(ctl_args_t *args, ctl_cmd_t cmd)
 		}
 		if (ret != KNOT_EOK) {
 			send_error(args, knot_strerror(ret));
+		}
+
+		int flush_ret = read_end(args);
+		if (ret != KNOT_EOK || flush_ret != KNOT_EOK) {
+			ret = (ret != KNOT_EOK) ? ret : flush_ret;
 			break;
 		}
 
@@ -1577,6 +1766,11 @@ static int ctl_conf_modify(ctl_args_t *args, ctl_cmd_t cmd)
 		}
 		if (ret != KNOT_EOK) {
 			send_error(args, knot_strerror(ret));
+		}
+
+		int flush_ret = read_end(args);
+		if (ret != KNOT_EOK || flush_ret != KNOT_EOK) {
+			ret = (ret != KNOT_EOK) ? ret : flush_ret;
 			break;
 		}
 
@@ -1604,17 +1798,18 @@ static int ctl_conf_modify(ctl_args_t *args, ctl_cmd_t cmd)
 typedef struct {
 	const char *name;
 	int (*fcn)(ctl_args_t *, ctl_cmd_t);
+	bool readonly;
 } desc_t;
 
 static const desc_t cmd_table[] = {
 	[CTL_NONE]            = { "" },
 
-	[CTL_STATUS]          = { "status",          ctl_server },
+	[CTL_STATUS]          = { "status",          ctl_server, true },
 	[CTL_STOP]            = { "stop",            ctl_server },
 	[CTL_RELOAD]          = { "reload",          ctl_server },
-	[CTL_STATS]           = { "stats",           ctl_stats },
+	[CTL_STATS]           = { "stats",           ctl_stats, true },
 
-	[CTL_ZONE_STATUS]     = { "zone-status",     ctl_zone },
+	[CTL_ZONE_STATUS]     = { "zone-status",     ctl_zone, true },
 	[CTL_ZONE_RELOAD]     = { "zone-reload",     ctl_zone },
 	[CTL_ZONE_REFRESH]    = { "zone-refresh",    ctl_zone },
 	[CTL_ZONE_RETRANSFER] = { "zone-retransfer", ctl_zone },
@@ -1624,7 +1819,7 @@ static const desc_t cmd_table[] = {
 	[CTL_ZONE_FREEZE]     = { "zone-freeze",     ctl_zone },
 	[CTL_ZONE_THAW]       = { "zone-thaw",       ctl_zone },
 
-	[CTL_ZONE_READ]       = { "zone-read",       ctl_zone },
+	[CTL_ZONE_READ]       = { "zone-read",       ctl_zone, true },
 	[CTL_ZONE_BEGIN]      = { "zone-begin",      ctl_zone },
 	[CTL_ZONE_COMMIT]     = { "zone-commit",     ctl_zone },
 	[CTL_ZONE_ABORT]      = { "zone-abort",      ctl_zone },
@@ -1633,10 +1828,10 @@ static const desc_t cmd_table[] = {
 	[CTL_ZONE_SET]        = { "zone-set",        ctl_zone },
 	[CTL_ZONE_UNSET]      = { "zone-unset",      ctl_zone },
 	[CTL_ZONE_PURGE]      = { "zone-purge",      ctl_zone },
-	[CTL_ZONE_STATS]      = { "zone-stats",	     ctl_zone },
+	[CTL_ZONE_STATS]      = { "zone-stats",      ctl_zone, true },
 
-	[CTL_CONF_LIST]       = { "conf-list",       ctl_conf_read },
-	[CTL_CONF_READ]       = { "conf-read",       ctl_conf_read },
+	[CTL_CONF_LIST]       = { "conf-list",       ctl_conf_read, true },
+	[CTL_CONF_READ]       = { "conf-read",       ctl_conf_read, true },
 	[CTL_CONF_BEGIN]      = { "conf-begin",      ctl_conf_txn },
 	[CTL_CONF_COMMIT]     = { "conf-commit",     ctl_conf_txn },
 	[CTL_CONF_ABORT]      = { "conf-abort",      ctl_conf_txn },
@@ -1672,13 +1867,36 @@ ctl_cmd_t ctl_str_to_cmd(const char *cmd_str)
 	return CTL_NONE;
 }
 
+bool ctl_cmd_readonly(ctl_cmd_t cmd)
+{
+	if (cmd <= CTL_NONE || cmd > MAX_CTL_CODE) {
+		return false;
+	}
+
+	return cmd_table[cmd].readonly;
+}
+
 int ctl_exec(ctl_cmd_t cmd, ctl_args_t *args)
 {
 	if (args == NULL) {
 		return KNOT_EINVAL;
 	}
 
-	return cmd_table[cmd].fcn(args, cmd);
+	if (!cmd_table[cmd].readonly) {
+		return cmd_table[cmd].fcn(args, cmd);
+	}
+
+	// Read-only commands enter the read-side sections on their own.
+	args->deferred = true;
+	init_list(&args->out);
+	mm_ctx_mempool(&args->out_mm, MM_DEFAULT_BLKSIZE);
+
+	int ret = cmd_table[cmd].fcn(args, cmd);
+
+	mp_delete(args->out_mm.ctx);
+	args->deferred = false;
+
+	return ret;
 }
 
 bool ctl_has_flag(const char *flags, const char *flag)
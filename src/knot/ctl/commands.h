@@ -93,6 +93,9 @@ typedef struct {
 	knot_ctl_type_t type;
 	knot_ctl_data_t data;
 	server_t *server;
+	bool deferred;  /*!< Queue the output until the read-side section ends. */
+	knot_mm_t out_mm;
+	list_t out;
 } ctl_args_t;
 
 /*!
@@ -113,6 +116,19 @@ const char *ctl_cmd_to_str(ctl_cmd_t cmd);
  */
 ctl_cmd_t ctl_str_to_cmd(const char *cmd_str);
 
+/*!
+ * Checks if the command only reads the server state.
+ *
+ * Such commands can be executed concurrently. They hold the RCU read lock
+ * only for one zone or one zone node at a time and their output is sent
+ * outside of these read-side sections.
+ *
+ * \param[in] cmd  Control command.
+ *
+ * \return True if read-only.
+ */
+bool ctl_cmd_readonly(ctl_cmd_t cmd);
+
 /*!
  * Executes a control command.
  *
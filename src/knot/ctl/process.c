@@ -14,6 +14,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
+
 #include "contrib/mempattern.h"
 #include "contrib/ucw/mempool.h"
 #include "knot/common/log.h"
@@ -21,6 +23,34 @@
 #include "knot/ctl/process.h"
 #include "libknot/error.h"
 
+/*! Serializes the commands changing the server state. */
+static pthread_mutex_t exclusive = PTHREAD_MUTEX_INITIALIZER;
+
+void ctl_lock(void)
+{
+	pthread_mutex_lock(&exclusive);
+}
+
+void ctl_unlock(void)
+{
+	pthread_mutex_unlock(&exclusive);
+}
+
+static int process_cmd(ctl_cmd_t cmd, ctl_args_t *args)
+{
+	int ret;
+	if (ctl_cmd_readonly(cmd)) {
+		// The command takes the RCU read lock per zone or zone node.
+		ret = ctl_exec(cmd, args);
+	} else {
+		ctl_lock();
+		ret = ctl_exec(cmd, args);
+		ctl_unlock();
+	}
+
+	return ret;
+}
+
 int ctl_process(knot_ctl_t *ctl, server_t *server)
 {
 	if (ctl == NULL || server == NULL) {
@@ -93,7 +123,7 @@ int ctl_process(knot_ctl_t *ctl, server_t *server)
 		}
 
 		// Execute the command.
-		int cmd_ret = ctl_exec(cmd, &args);
+		int cmd_ret = process_cmd(cmd, &args);
 		switch (cmd_ret) {
 		case KNOT_EOK:
 			strip = false;
@@ -30,6 +30,9 @@
 /*!
  * Processes incoming control commands.
  *
+ * Several control contexts can be processed at once. The read-only commands
+ * are executed concurrently, the other commands exclusively.
+ *
  * \param[in] ctl     Control context.
  * \param[in] server  Server instance.
  *
@@ -37,4 +40,16 @@
  */
 int ctl_process(knot_ctl_t *ctl, server_t *server);
 
+/*!
+ * Locks out the exclusive control commands.
+ *
+ * \note Used for server operations triggered outside of the control processing.
+ */
+void ctl_lock(void);
+
+/*!
+ * Unlocks the exclusive control commands.
+ */
+void ctl_unlock(void);
+
 /*! @} */
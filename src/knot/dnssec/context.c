@@ -70,6 +70,16 @@ static void policy_load(knot_kasp_policy_t *policy, conf_val_t *id)
 	val = conf_id_get(conf(), C_POLICY, C_RRSIG_REFRESH, id);
 	policy->rrsig_refresh_before = conf_int(&val);
 
+	val = conf_id_get(conf(), C_POLICY, C_RRSIG_JITTER, id);
+	policy->rrsig_jitter = conf_int(&val);
+
+	val = conf_id_get(conf(), C_POLICY, C_RRSIG_REFRESH_LIMIT, id);
+	policy->rrsig_refresh_limit = conf_int(&val);
+
+	val = conf_id_get(conf(), C_POLICY, C_SIGNING_THREADS, id);
+	num = conf_int(&val);
+	policy->signing_threads = (num != YP_NIL) ? num : conf_bg_threads(conf());
+
 	val = conf_id_get(conf(), C_POLICY, C_NSEC3, id);
 	policy->nsec3_enabled = conf_bool(&val);
 
@@ -153,6 +163,11 @@ int kdnssec_ctx_init(conf_t *conf, kdnssec_ctx_t *ctx, const knot_dname_t *zone_
 	conf_val_t val = conf_id_get(conf, C_KEYSTORE, C_BACKEND, &keystore_id);
 	unsigned backend = conf_opt(&val);
 
+	// PKCS #11 sessions are not shared among signing threads.
+	if (backend == KEYSTORE_BACKEND_PKCS11) {
+		ctx->policy->signing_threads = 1;
+	}
+
 	val = conf_id_get(conf, C_KEYSTORE, C_CONFIG, &keystore_id);
 	const char *config = conf_str(&val);
 
@@ -77,6 +77,9 @@ typedef struct {
 	// RRSIG
 	uint32_t rrsig_lifetime;
 	uint32_t rrsig_refresh_before;
+	uint32_t rrsig_jitter;
+	uint32_t rrsig_refresh_limit;
+	size_t signing_threads;
 	// NSEC3
 	bool nsec3_enabled;
 	bool nsec3_opt_out;
@@ -0,0 +1,188 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dnssec/error.h"
+#include "knot/dnssec/nsec3-cache.h"
+#include "knot/dnssec/zone-nsec.h"
+#include "contrib/murmurhash3/murmurhash3.h"
+
+#define CACHE_SETS	128	/*!< Number of sets (power of 2). */
+#define CACHE_WAYS	4	/*!< Number of entries in a set. */
+#define CACHE_PARAMS	8	/*!< Number of cached NSEC3 parameters. */
+#define CACHE_HASH_MAX	20	/*!< Maximal cached hash size (SHA-1). */
+
+/*! \brief Cached NSEC3 parameters, identified by a generation. */
+typedef struct {
+	uint32_t gen;     /*!< Generation of the parameters, 0 if unused. */
+	uint32_t used;    /*!< Last use time. */
+	uint8_t algorithm;
+	uint16_t iterations;
+	uint8_t salt_size;
+	uint8_t salt[UINT8_MAX];
+} cache_params_t;
+
+/*! \brief Cached NSEC3 hash of a name. */
+typedef struct {
+	uint32_t gen;     /*!< Generation of the parameters, 0 if empty. */
+	uint32_t used;    /*!< Last use time. */
+	uint8_t hash_size;
+	uint8_t hash[CACHE_HASH_MAX];
+	uint16_t name_size;
+	uint8_t name[KNOT_DNAME_MAXLEN];
+} cache_entry_t;
+
+typedef struct {
+	uint32_t clock;   /*!< Logical time for the LRU replacement. */
+	uint32_t gen;     /*!< Last assigned generation. */
+	cache_params_t params[CACHE_PARAMS];
+	cache_entry_t entries[CACHE_SETS][CACHE_WAYS];
+} nsec3_cache_t;
+
+static pthread_key_t cache_key;
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static bool cache_key_valid = false;
+
+static void cache_key_init(void)
+{
+	cache_key_valid = (pthread_key_create(&cache_key, free) == 0);
+}
+
+static nsec3_cache_t *cache_get(void)
+{
+	(void)pthread_once(&cache_once, cache_key_init);
+	if (!cache_key_valid) {
+		return NULL;
+	}
+
+	nsec3_cache_t *cache = pthread_getspecific(cache_key);
+	if (cache == NULL) {
+		cache = calloc(1, sizeof(*cache));
+		if (cache != NULL && pthread_setspecific(cache_key, cache) != 0) {
+			free(cache);
+			cache = NULL;
+		}
+	}
+
+	return cache;
+}
+
+/*!
+ * \brief Get the generation of the parameters, assign a new one if not cached.
+ */
+static uint32_t params_gen(nsec3_cache_t *cache, const dnssec_nsec3_params_t *params)
+{
+	cache_params_t *lru = &cache->params[0];
+	for (int i = 0; i < CACHE_PARAMS; i++) {
+		cache_params_t *p = &cache->params[i];
+		if (p->gen != 0 && p->algorithm == params->algorithm &&
+		    p->iterations == params->iterations &&
+		    p->salt_size == params->salt.size &&
+		    memcmp(p->salt, params->salt.data, p->salt_size) == 0) {
+			p->used = ++cache->clock;
+			return p->gen;
+		}
+		if (p->used < lru->used) {
+			lru = p;
+		}
+	}
+
+	// new generation, the entries of the replaced one never match again
+	if (++cache->gen == 0) {
+		++cache->gen;
+	}
+
+	lru->gen = cache->gen;
+	lru->used = ++cache->clock;
+	lru->algorithm = params->algorithm;
+	lru->iterations = params->iterations;
+	lru->salt_size = params->salt.size;
+	memcpy(lru->salt, params->salt.data, params->salt.size);
+
+	return lru->gen;
+}
+
+static knot_dname_t *create_owner(const knot_dname_t *owner,
+                                  const knot_dname_t *zone_apex,
+                                  const dnssec_nsec3_params_t *params,
+                                  cache_entry_t *entry, uint32_t gen)
+{
+	dnssec_binary_t data = {
+		.data = (uint8_t *)owner,
+		.size = knot_dname_size(owner)
+	};
+	dnssec_binary_t hash = { 0 };
+
+	int ret = dnssec_nsec3_hash(&data, params, &hash);
+	if (ret != DNSSEC_EOK) {
+		return NULL;
+	}
+
+	if (entry != NULL && hash.size <= CACHE_HASH_MAX) {
+		entry->gen = gen;
+		entry->hash_size = hash.size;
+		memcpy(entry->hash, hash.data, hash.size);
+		entry->name_size = data.size;
+		memcpy(entry->name, data.data, data.size);
+	}
+
+	knot_dname_t *result = knot_nsec3_hash_to_dname(hash.data, hash.size, zone_apex);
+
+	dnssec_binary_free(&hash);
+
+	return result;
+}
+
+knot_dname_t *knot_nsec3_cache_owner(const knot_dname_t *owner,
+                                     const knot_dname_t *zone_apex,
+                                     const dnssec_nsec3_params_t *params)
+{
+	if (owner == NULL || zone_apex == NULL || params == NULL) {
+		return NULL;
+	}
+
+	nsec3_cache_t *cache = cache_get();
+	if (cache == NULL || params->salt.size > UINT8_MAX) {
+		return knot_create_nsec3_owner(owner, zone_apex, params);
+	}
+
+	uint32_t gen = params_gen(cache, params);
+	size_t owner_size = knot_dname_size(owner);
+	uint32_t set = (hash((const char *)owner, owner_size) ^ gen) & (CACHE_SETS - 1);
+
+	cache_entry_t *lru = &cache->entries[set][0];
+	for (int i = 0; i < CACHE_WAYS; i++) {
+		cache_entry_t *entry = &cache->entries[set][i];
+		if (entry->gen == gen && entry->name_size == owner_size &&
+		    memcmp(entry->name, owner, owner_size) == 0) {
+			entry->used = ++cache->clock;
+			return knot_nsec3_hash_to_dname(entry->hash, entry->hash_size,
+			                                zone_apex);
+		}
+		if (entry->used < lru->used) {
+			lru = entry;
+		}
+	}
+
+	lru->gen = 0;
+	lru->used = ++cache->clock;
+
+	return create_owner(owner, zone_apex, params, lru, gen);
+}
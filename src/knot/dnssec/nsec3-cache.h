@@ -0,0 +1,48 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file
+ *
+ * \brief Per-thread cache of NSEC3 hashes.
+ *
+ * Negative answers from NSEC3 zones need hashes of the closest encloser and
+ * the wildcard, which are mostly the same names even for random query names.
+ * Each thread keeps a small set-associative LRU cache of recent hashes, keyed
+ * by the name and the NSEC3 parameters (algorithm, iterations, and salt).
+ *
+ * \addtogroup dnssec
+ * @{
+ */
+
+#pragma once
+
+#include "dnssec/nsec.h"
+#include "libknot/dname.h"
+
+/*!
+ * \brief Create NSEC3 owner name from regular owner name, using the cache.
+ *
+ * \param owner      Owner name.
+ * \param zone_apex  Zone apex name.
+ * \param params     Params for NSEC3 hashing function.
+ *
+ * \return NSEC3 owner name, NULL in case of error.
+ */
+knot_dname_t *knot_nsec3_cache_owner(const knot_dname_t *owner,
+                                     const knot_dname_t *zone_apex,
+                                     const dnssec_nsec3_params_t *params);
+
+/*! @} */
@@ -15,6 +15,8 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
 
 #include "libknot/dname.h"
 #include "knot/dnssec/nsec-chain.h"
@@ -125,10 +127,14 @@ static int copy_signatures(zone_tree_t *from, zone_tree_t *to)
 
 	assert(to);
 
-	trie_it_t *it = trie_it_begin(from);
+	zone_tree_it_t it;
+	int ret = zone_tree_it_begin(from, &it);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
 
-	for (/* NOP */; !trie_it_finished(it); trie_it_next(it)) {
-		zone_node_t *node_from = (zone_node_t *)*trie_it_val(it);
+	for (/* NOP */; !zone_tree_it_finished(&it); zone_tree_it_next(&it)) {
+		zone_node_t *node_from = zone_tree_it_val(&it);
 		zone_node_t *node_to = NULL;
 
 		zone_tree_get(to, node_from->owner, &node_to);
@@ -140,17 +146,29 @@ static int copy_signatures(zone_tree_t *from, zone_tree_t *to)
 			continue;
 		}
 
-		int ret = shallow_copy_signature(node_from, node_to);
+		ret = shallow_copy_signature(node_from, node_to);
 		if (ret != KNOT_EOK) {
-			trie_it_free(it);
+			zone_tree_it_free(&it);
 			return ret;
 		}
 	}
 
-	trie_it_free(it);
+	zone_tree_it_free(&it);
 	return KNOT_EOK;
 }
 
+/*!
+ * \brief Free newly allocated NSEC3 node.
+ */
+static void free_nsec3_node(zone_node_t *node)
+{
+	knot_rdataset_t *nsec3 = node_rdataset(node, KNOT_RRTYPE_NSEC3);
+	knot_rdataset_t *rrsig = node_rdataset(node, KNOT_RRTYPE_RRSIG);
+	knot_rdataset_clear(nsec3, NULL);
+	knot_rdataset_clear(rrsig, NULL);
+	node_free(&node, NULL);
+}
+
 /*!
  * \brief Custom NSEC3 tree free function.
  *
@@ -159,18 +177,13 @@ static void free_nsec3_tree(zone_tree_t *nodes)
 {
 	assert(nodes);
 
-	trie_it_t *it = trie_it_begin(nodes);
-	for (/* NOP */; !trie_it_finished(it); trie_it_next(it)) {
-		zone_node_t *node = (zone_node_t *)*trie_it_val(it);
-		// newly allocated NSEC3 nodes
-		knot_rdataset_t *nsec3 = node_rdataset(node, KNOT_RRTYPE_NSEC3);
-		knot_rdataset_t *rrsig = node_rdataset(node, KNOT_RRTYPE_RRSIG);
-		knot_rdataset_clear(nsec3, NULL);
-		knot_rdataset_clear(rrsig, NULL);
-		node_free(&node, NULL);
+	zone_tree_it_t it;
+	(void)zone_tree_it_begin(nodes, &it);
+	for (/* NOP */; !zone_tree_it_finished(&it); zone_tree_it_next(&it)) {
+		free_nsec3_node(zone_tree_it_val(&it));
 	}
 
-	trie_it_free(it);
+	zone_tree_it_free(&it);
 	zone_tree_free(&nodes);
 }
 
@@ -269,25 +282,23 @@ static int create_nsec3_rrset(knot_rrset_t *rrset,
 
 /*!
  * \brief Create NSEC3 node.
+ *
+ * \note The parent of the node is not set.
  */
 static zone_node_t *create_nsec3_node(knot_dname_t *owner,
                                       const dnssec_nsec3_params_t *nsec3_params,
-                                      zone_node_t *apex_node,
                                       const dnssec_nsec_bitmap_t *rr_types,
                                       uint32_t ttl)
 {
 	assert(owner);
 	assert(nsec3_params);
-	assert(apex_node);
 	assert(rr_types);
 
-	zone_node_t *new_node = node_new(owner, NULL);
+	zone_node_t *new_node = node_new(owner, false, false, NULL);
 	if (!new_node) {
 		return NULL;
 	}
 
-	node_set_parent(new_node, apex_node);
-
 	knot_rrset_t nsec3_rrset;
 	int ret = create_nsec3_rrset(&nsec3_rrset, owner, nsec3_params,
 	                             rr_types, NULL, ttl);
@@ -306,6 +317,52 @@ static zone_node_t *create_nsec3_node(knot_dname_t *owner,
 	return new_node;
 }
 
+/*!
+ * \brief Create new NSEC3 node with already hashed owner for given regular node.
+ *
+ * \note The parent of the node is not set, the function doesn't modify any
+ *       other node, so it may be called from multiple threads.
+ *
+ * \param node         Node for which the NSEC3 node is created.
+ * \param nsec3_owner  NSEC3 owner name, consumed by the function.
+ * \param apex         Zone apex node.
+ * \param params       NSEC3 hash function parameters.
+ * \param ttl          TTL of the new NSEC3 node.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+static zone_node_t *create_nsec3_node_hashed(const zone_node_t *node,
+                                             knot_dname_t *nsec3_owner,
+                                             const zone_node_t *apex,
+                                             const dnssec_nsec3_params_t *params,
+                                             uint32_t ttl)
+{
+	assert(node);
+	assert(nsec3_owner);
+	assert(apex);
+	assert(params);
+
+	dnssec_nsec_bitmap_t *rr_types = dnssec_nsec_bitmap_new();
+	if (!rr_types) {
+		knot_dname_free(&nsec3_owner, NULL);
+		return NULL;
+	}
+
+	bitmap_add_node_rrsets(rr_types, KNOT_RRTYPE_NSEC3, node);
+	if (node->rrset_count > 0 && node_should_be_signed_nsec3(node)) {
+		dnssec_nsec_bitmap_add(rr_types, KNOT_RRTYPE_RRSIG);
+	}
+	if (node == apex) {
+		dnssec_nsec_bitmap_add(rr_types, KNOT_RRTYPE_NSEC3PARAM);
+	}
+
+	zone_node_t *nsec3_node;
+	nsec3_node = create_nsec3_node(nsec3_owner, params, rr_types, ttl);
+	dnssec_nsec_bitmap_free(rr_types);
+
+	return nsec3_node;
+}
+
 /*!
  * \brief Create new NSEC3 node for given regular node.
  *
@@ -313,7 +370,6 @@ static zone_node_t *create_nsec3_node(knot_dname_t *owner,
  * \param apex       Zone apex node.
  * \param params     NSEC3 hash function parameters.
  * \param ttl        TTL of the new NSEC3 node.
- * \param apex_cds   Hint to guess apex node type bitmap: false=just DNSKEY, true=DNSKEY,CDS,CDNSKEY.
  *
  * \return Error code, KNOT_EOK if successful.
  */
@@ -332,24 +388,146 @@ static zone_node_t *create_nsec3_node_for_node(const zone_node_t *node,
 		return NULL;
 	}
 
-	dnssec_nsec_bitmap_t *rr_types = dnssec_nsec_bitmap_new();
-	if (!rr_types) {
-		return NULL;
+	zone_node_t *nsec3_node;
+	nsec3_node = create_nsec3_node_hashed(node, nsec3_owner, apex, params, ttl);
+	node_set_parent(nsec3_node, apex);
+
+	return nsec3_node;
+}
+
+/*!
+ * \brief Create NSEC3 nodes for a batch of regular nodes, hashed at once.
+ *
+ * \param nsec3_nodes  Output NSEC3 nodes, at the positions of regular nodes.
+ */
+static int create_nsec3_nodes_batch(const zone_contents_t *zone,
+                                    const dnssec_nsec3_params_t *params,
+                                    uint32_t ttl,
+                                    const zone_node_t *batch[],
+                                    zone_node_t *nsec3_nodes[],
+                                    size_t count)
+{
+	const knot_dname_t *owners[KNOT_NSEC3_BATCH];
+	knot_dname_t *nsec3_owners[KNOT_NSEC3_BATCH];
+	for (size_t i = 0; i < count; i++) {
+		owners[i] = batch[i]->owner;
 	}
 
-	bitmap_add_node_rrsets(rr_types, KNOT_RRTYPE_NSEC3, node);
-	if (node->rrset_count > 0 && node_should_be_signed_nsec3(node)) {
-		dnssec_nsec_bitmap_add(rr_types, KNOT_RRTYPE_RRSIG);
+	int result = knot_create_nsec3_owners(owners, count, zone->apex->owner,
+	                                      params, nsec3_owners);
+	if (result != KNOT_EOK) {
+		return result;
 	}
-	if (node == apex) {
-		dnssec_nsec_bitmap_add(rr_types, KNOT_RRTYPE_NSEC3PARAM);
+
+	for (size_t i = 0; i < count; i++) {
+		if (result != KNOT_EOK) {
+			knot_dname_free(&nsec3_owners[i], NULL);
+			continue;
+		}
+
+		nsec3_nodes[i] = create_nsec3_node_hashed(batch[i], nsec3_owners[i],
+		                                          zone->apex, params, ttl);
+		if (!nsec3_nodes[i]) {
+			result = KNOT_ENOMEM;
+		}
 	}
 
-	zone_node_t *nsec3_node;
-	nsec3_node = create_nsec3_node(nsec3_owner, params, apex, rr_types, ttl);
-	dnssec_nsec_bitmap_free(rr_types);
+	return result;
+}
 
-	return nsec3_node;
+/*! \brief Minimal number of nodes hashed by one thread. */
+#define HASH_RANGE_MIN_NODES 1024
+
+/*!
+ * \brief Contiguous range of regular nodes, hashed by one thread.
+ */
+typedef struct {
+	const zone_contents_t *zone;
+	const dnssec_nsec3_params_t *params;
+	uint32_t ttl;
+	const zone_node_t **nodes;  //!< Regular nodes in the range.
+	zone_node_t **nsec3_nodes;  //!< Created NSEC3 nodes.
+	size_t count;               //!< Number of nodes in the range.
+	pthread_t thread;
+	bool started;
+	int result;
+} hash_range_t;
+
+static void *hash_range(void *data)
+{
+	hash_range_t *range = data;
+
+	range->result = KNOT_EOK;
+	for (size_t i = 0; i < range->count && range->result == KNOT_EOK;
+	     i += KNOT_NSEC3_BATCH) {
+		range->result = create_nsec3_nodes_batch(range->zone, range->params,
+		                                         range->ttl, range->nodes + i,
+		                                         range->nsec3_nodes + i,
+		                                         MIN(KNOT_NSEC3_BATCH,
+		                                             range->count - i));
+	}
+
+	return NULL;
+}
+
+/*!
+ * \brief Create NSEC3 nodes for the regular nodes, in parallel.
+ *
+ * The nodes are split into ranges of (almost) the same size, the first range
+ * is processed by the calling thread.
+ *
+ * \param nsec3_nodes  Output NSEC3 nodes, zero-initialized. On failure, some
+ *                     of them may be already created.
+ */
+static int hash_ranges(const zone_contents_t *zone,
+                       const dnssec_nsec3_params_t *params,
+                       uint32_t ttl,
+                       size_t threads,
+                       const zone_node_t *nodes[],
+                       zone_node_t *nsec3_nodes[],
+                       size_t count)
+{
+	threads = MAX(MIN(threads, count / HASH_RANGE_MIN_NODES), 1);
+
+	hash_range_t *ranges = calloc(threads, sizeof(*ranges));
+	if (ranges == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	for (size_t i = 0; i < threads; i++) {
+		size_t first = i * count / threads;
+		ranges[i].zone = zone;
+		ranges[i].params = params;
+		ranges[i].ttl = ttl;
+		ranges[i].nodes = nodes + first;
+		ranges[i].nsec3_nodes = nsec3_nodes + first;
+		ranges[i].count = (i + 1) * count / threads - first;
+		if (i > 0) {
+			ranges[i].started = (pthread_create(&ranges[i].thread, NULL,
+			                                    hash_range, &ranges[i]) == 0);
+		}
+	}
+
+	// Hash the first range and the ranges without a thread here.
+	for (size_t i = 0; i < threads; i++) {
+		if (!ranges[i].started) {
+			hash_range(&ranges[i]);
+		}
+	}
+
+	int ret = KNOT_EOK;
+	for (size_t i = 0; i < threads; i++) {
+		if (ranges[i].started) {
+			pthread_join(ranges[i].thread, NULL);
+		}
+		if (ret == KNOT_EOK) {
+			ret = ranges[i].result;
+		}
+	}
+
+	free(ranges);
+
+	return ret;
 }
 
 /* - NSEC3 chain creation --------------------------------------------------- */
@@ -467,11 +645,14 @@ static int connect_nsec3_nodes2(zone_node_t *a, zone_node_t *b,
 /*!
  * \brief Create NSEC3 node for each regular node in the zone.
  *
+ * The owners are hashed in parallel, the NSEC3 tree is then built from
+ * the sorted NSEC3 nodes at once.
+ *
  * \param zone         Zone.
  * \param params       NSEC3 params.
  * \param ttl          TTL for the created NSEC records.
- * \param cds_in_apex  Hint to guess apex node type bitmap: false=just DNSKEY, true=DNSKEY,CDS,CDNSKEY.
- * \param nsec3_nodes  Tree whereto new NSEC3 nodes will be added.
+ * \param threads      Number of threads used for hashing.
+ * \param nsec3_nodes  Empty tree whereto new NSEC3 nodes will be added.
  * \param chgset       Changeset used for possible NSEC removals
  *
  * \return Error code, KNOT_EOK if successful.
@@ -479,6 +660,7 @@ static int connect_nsec3_nodes2(zone_node_t *a, zone_node_t *b,
 static int create_nsec3_nodes(const zone_contents_t *zone,
                               const dnssec_nsec3_params_t *params,
                               uint32_t ttl,
+                              size_t threads,
                               zone_tree_t *nsec3_nodes,
                               changeset_t *chgset)
 {
@@ -486,11 +668,21 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
 	assert(nsec3_nodes);
 	assert(chgset);
 
-	int result = KNOT_EOK;
+	size_t max_count = zone_tree_count(zone->nodes);
+	const zone_node_t **nodes = malloc(max_count * sizeof(*nodes));
+	zone_node_t **created = calloc(max_count, sizeof(*created));
+	if (nodes == NULL || created == NULL) {
+		free(nodes);
+		free(created);
+		return KNOT_ENOMEM;
+	}
 
-	trie_it_t *it = trie_it_begin(zone->nodes);
-	while (!trie_it_finished(it)) {
-		zone_node_t *node = (zone_node_t *)*trie_it_val(it);
+	zone_tree_it_t it = { 0 };
+	int result = zone_tree_it_begin(zone->nodes, &it);
+	size_t count = 0;
+
+	while (result == KNOT_EOK && !zone_tree_it_finished(&it)) {
+		zone_node_t *node = zone_tree_it_val(&it);
 
 		/*!
 		 * Remove possible NSEC from the node. (Do not allow both NSEC
@@ -503,28 +695,36 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
 		if (node_rrtype_exists(node, KNOT_RRTYPE_NSEC)) {
 			node->flags |= NODE_FLAGS_REMOVED_NSEC;
 		}
-		if (node->flags & NODE_FLAGS_NONAUTH || node->flags & NODE_FLAGS_EMPTY) {
-			trie_it_next(it);
-			continue;
+		if (!(node->flags & NODE_FLAGS_NONAUTH) && !(node->flags & NODE_FLAGS_EMPTY)) {
+			assert(count < max_count);
+			nodes[count++] = node;
 		}
 
-		zone_node_t *nsec3_node;
-		nsec3_node = create_nsec3_node_for_node(node, zone->apex,
-							params, ttl);
-		if (!nsec3_node) {
-			result = KNOT_ENOMEM;
-			break;
-		}
+		zone_tree_it_next(&it);
+	}
 
-		result = zone_tree_insert(nsec3_nodes, nsec3_node);
-		if (result != KNOT_EOK) {
-			break;
-		}
+	zone_tree_it_free(&it);
 
-		trie_it_next(it);
+	if (result == KNOT_EOK) {
+		result = hash_ranges(zone, params, ttl, threads, nodes, created, count);
+	}
+	if (result == KNOT_EOK) {
+		result = zone_tree_load(nsec3_nodes, created, count);
+	}
+	if (result == KNOT_EOK) {
+		for (size_t i = 0; i < count; i++) {
+			node_set_parent(created[i], zone->apex);
+		}
+	} else {
+		for (size_t i = 0; i < count; i++) {
+			if (created[i] != NULL) {
+				free_nsec3_node(created[i]);
+			}
+		}
 	}
 
-	trie_it_free(it);
+	free(nodes);
+	free(created);
 
 	return result;
 }
@@ -637,21 +837,25 @@ static int fix_nsec3_nodes(zone_update_t *update, const dnssec_nsec3_params_t *p
 
 	int ret = KNOT_EOK;
 
-	trie_it_t *rem_it = trie_it_begin(update->change.remove->nodes);
-	while (!trie_it_finished(rem_it) && ret == KNOT_EOK) {
-		zone_node_t *n = (zone_node_t *)*trie_it_val(rem_it);
+	zone_tree_it_t rem_it;
+	ret = zone_tree_it_begin(update->change.remove->nodes, &rem_it);
+	while (ret == KNOT_EOK && !zone_tree_it_finished(&rem_it)) {
+		zone_node_t *n = zone_tree_it_val(&rem_it);
 		ret = fix_nsec3_for_node(update, params, ttl, opt_out, chgset, n->owner);
-		trie_it_next(rem_it);
+		zone_tree_it_next(&rem_it);
 	}
-	trie_it_free(rem_it);
+	zone_tree_it_free(&rem_it);
 
-	trie_it_t *add_it = trie_it_begin(update->change.add->nodes);
-	while (!trie_it_finished(add_it) && ret == KNOT_EOK) {
-		zone_node_t *n = (zone_node_t *)*trie_it_val(add_it);
+	zone_tree_it_t add_it = { 0 };
+	if (ret == KNOT_EOK) {
+		ret = zone_tree_it_begin(update->change.add->nodes, &add_it);
+	}
+	while (ret == KNOT_EOK && !zone_tree_it_finished(&add_it)) {
+		zone_node_t *n = zone_tree_it_val(&add_it);
 		ret = fix_nsec3_for_node(update, params, ttl, opt_out, chgset, n->owner);
-		trie_it_next(add_it);
+		zone_tree_it_next(&add_it);
 	}
-	trie_it_free(add_it);
+	zone_tree_it_free(&add_it);
 
 	return ret;
 }
@@ -737,6 +941,7 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
                             const dnssec_nsec3_params_t *params,
                             uint32_t ttl,
                             bool opt_out,
+                            size_t threads,
                             changeset_t *changeset)
 {
 	assert(zone);
@@ -745,7 +950,7 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
 
 	int result;
 
-	zone_tree_t *nsec3_nodes = zone_tree_create();
+	zone_tree_t *nsec3_nodes = zone_tree_create(0);
 	if (!nsec3_nodes) {
 		return KNOT_ENOMEM;
 	}
@@ -764,7 +969,7 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
 		return result;
 	}
 
-	result = create_nsec3_nodes(zone, params, ttl, nsec3_nodes, changeset);
+	result = create_nsec3_nodes(zone, params, ttl, threads, nsec3_nodes, changeset);
 	if (result != KNOT_EOK) {
 		free_nsec3_tree(nsec3_nodes);
 		return result;
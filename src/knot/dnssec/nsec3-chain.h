@@ -29,6 +29,7 @@
  * \param params     NSEC3 parameters.
  * \param ttl        TTL for new records.
  * \param opt_out    NSEC3 opt-out enabled for insecure delegations.
+ * \param threads    Number of threads used for hashing of the owner names.
  * \param changeset  Changeset to store changes into.
  *
  * \return KNOT_E*
@@ -37,6 +38,7 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
                             const dnssec_nsec3_params_t *params,
                             uint32_t ttl,
                             bool opt_out,
+                            size_t threads,
                             changeset_t *changeset);
 
 /*!
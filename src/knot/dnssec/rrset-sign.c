@@ -16,6 +16,7 @@
 
 #include <assert.h>
 
+#include "contrib/murmurhash3/murmurhash3.h"
 #include "contrib/wire_ctx.h"
 #include "dnssec/error.h"
 #include "knot/dnssec/rrset-sign.h"
@@ -261,6 +262,24 @@ static int rrsigs_create_rdata(knot_rrset_t *rrsigs, dnssec_sign_ctx_t *ctx,
 	                            knot_rdata_ttl(covered_data), mm);
 }
 
+/*!
+ * \brief Compute pseudo-random shortening of the signature validity.
+ *
+ * The value is stable for the RR set, so all its signatures expire at once
+ * and the spread of expirations is kept after refreshing.
+ */
+static uint32_t rrsig_jitter(const knot_rrset_t *covered, uint32_t max_jitter)
+{
+	if (max_jitter == 0) {
+		return 0;
+	}
+
+	uint32_t h = hash((const char *)covered->owner, knot_dname_size(covered->owner));
+	h ^= covered->type * 0x9E3779B1U;
+
+	return h % ((uint64_t)max_jitter + 1);
+}
+
 int knot_sign_rrset(knot_rrset_t *rrsigs, const knot_rrset_t *covered,
                     const dnssec_key_t *key, dnssec_sign_ctx_t *sign_ctx,
                     const kdnssec_ctx_t *dnssec_ctx, knot_mm_t *mm)
@@ -273,7 +292,8 @@ int knot_sign_rrset(knot_rrset_t *rrsigs, const knot_rrset_t *covered,
 	}
 
 	uint32_t sig_incept = dnssec_ctx->now - RRSIG_INCEPT_IN_PAST;
-	uint32_t sig_expire = dnssec_ctx->now + dnssec_ctx->policy->rrsig_lifetime;
+	uint32_t sig_expire = dnssec_ctx->now + dnssec_ctx->policy->rrsig_lifetime -
+	                      rrsig_jitter(covered, dnssec_ctx->policy->rrsig_jitter);
 
 	return rrsigs_create_rdata(rrsigs, sign_ctx, covered, key, sig_incept,
 	                           sig_expire, mm);
@@ -178,16 +178,30 @@ int knot_dnssec_zone_sign(zone_update_t *update,
 		goto done;
 	}
 
-	result = knot_zone_create_nsec_chain(update, &keyset, &ctx, false);
-	if (result != KNOT_EOK) {
-		log_zone_error(zone_name, "DNSSEC, failed to create NSEC%s chain (%s)",
-		               ctx.policy->nsec3_enabled ? "3" : "",
-		               knot_strerror(result));
-		goto done;
-	}
+	// refresh just the expiring signatures if nothing else has changed
+
+	bool expiring_only = (flags & ZONE_SIGN_EXPIRING) &&
+	                     !(flags & ZONE_SIGN_DROP_SIGNATURES) &&
+	                     zone_update_no_change(update) &&
+	                     knot_zone_nsec_chain_current(update->new_cont, &ctx) &&
+	                     knot_zone_sign_keys_match(update->new_cont, &keyset);
 
 	knot_time_t zone_expire = 0;
-	result = knot_zone_sign(update, &keyset, &ctx, &zone_expire);
+	result = KNOT_ENOENT;
+	if (expiring_only) {
+		result = knot_zone_sign_expiring(update, &keyset, &ctx, &zone_expire);
+	}
+	if (result == KNOT_ENOENT) {
+		result = knot_zone_create_nsec_chain(update, &keyset, &ctx, false);
+		if (result != KNOT_EOK) {
+			log_zone_error(zone_name, "DNSSEC, failed to create NSEC%s chain (%s)",
+			               ctx.policy->nsec3_enabled ? "3" : "",
+			               knot_strerror(result));
+			goto done;
+		}
+
+		result = knot_zone_sign(update, &keyset, &ctx, &zone_expire);
+	}
 	if (result != KNOT_EOK) {
 		log_zone_error(zone_name, "DNSSEC, failed to sign zone content (%s)",
 		               knot_strerror(result));
@@ -296,7 +310,8 @@ int knot_dnssec_sign_update(zone_update_t *update, zone_sign_reschedule_t *resch
 	log_zone_info(zone_name, "DNSSEC, successfully signed");
 
 	// schedule next re-signing (only new signatures are made)
-	reschedule->next_sign = ctx.now + ctx.policy->rrsig_lifetime - ctx.policy->rrsig_refresh_before;
+	reschedule->next_sign = ctx.now + ctx.policy->rrsig_lifetime - ctx.policy->rrsig_jitter -
+	                        ctx.policy->rrsig_refresh_before;
 	assert(reschedule->next_sign > 0);
 	(void)expire_at; // the result of expire_at is actually unused because we computed next_sign easily
 			 // we can freely reschedule dnssec event to next_sign because if it's already scheduled
@@ -27,6 +27,7 @@ enum zone_sign_flags {
 	ZONE_SIGN_NONE = 0,
 	ZONE_SIGN_DROP_SIGNATURES = (1 << 0),
 	ZONE_SIGN_KEEP_SERIAL = (1 << 1),
+	ZONE_SIGN_EXPIRING = (1 << 2),
 };
 
 typedef enum zone_sign_flags zone_sign_flags_t;
@@ -56,6 +57,9 @@ int knot_dnssec_sign_process_events(const kdnssec_ctx_t *kctx,
  * \brief DNSSEC re-sign zone, store new records into changeset. Valid signatures
  *        and NSEC(3) records will not be changed.
  *
+ * With ZONE_SIGN_EXPIRING, if the keys and the NSEC(3) parameters haven't
+ * changed, only the signatures expiring within the refresh period are updated.
+ *
  * \param update       Zone Update structure with current zone contents to be updated by signing.
  * \param flags        Zone signing flags.
  * \param reschedule   Signature refresh time of the oldest signature in zone.
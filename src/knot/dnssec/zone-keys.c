@@ -478,6 +478,41 @@ int load_zone_keys(knot_kasp_zone_t *zone, dnssec_keystore_t *store,
 	return KNOT_EOK;
 }
 
+/*!
+ * \brief Duplicate zone keys with own cryptographic contexts.
+ */
+int dup_zone_keys(const zone_keyset_t *from, zone_keyset_t *to)
+{
+	if (!from || !to) {
+		return KNOT_EINVAL;
+	}
+
+	zone_keyset_t keyset = { 0 };
+
+	keyset.keys = calloc(from->count, sizeof(zone_key_t));
+	if (!keyset.keys && from->count > 0) {
+		return KNOT_ENOMEM;
+	}
+
+	for (size_t i = 0; i < from->count; i++) {
+		zone_key_t *key = &keyset.keys[i];
+		*key = from->keys[i];
+		key->ctx = NULL;
+		key->precomputed_ds = (dnssec_binary_t){ 0 };
+		keyset.count++;
+
+		int r = dnssec_sign_new(&key->ctx, key->key);
+		if (r != DNSSEC_EOK) {
+			free_zone_keys(&keyset);
+			return knot_error_from_libdnssec(r);
+		}
+	}
+
+	*to = keyset;
+
+	return KNOT_EOK;
+}
+
 /*!
  * \brief Free structure with zone keys and associated DNSSEC contexts.
  */
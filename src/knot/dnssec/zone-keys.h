@@ -117,6 +117,18 @@ int load_zone_keys(knot_kasp_zone_t *zone, dnssec_keystore_t *store,
  */
 struct keyptr_dynarray get_zone_keys(const zone_keyset_t *keyset, uint16_t search);
 
+/*!
+ * \brief Duplicate zone keys with own cryptographic contexts.
+ *
+ * The keys are shared, the copy can be used for signing in another thread.
+ *
+ * \param from  Source zone keyset.
+ * \param to    Resulting zone keyset.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int dup_zone_keys(const zone_keyset_t *from, zone_keyset_t *to);
+
 /*!
  * \brief Free structure with zone keys and associated DNSSEC contexts.
  *
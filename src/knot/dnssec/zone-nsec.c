@@ -46,7 +46,7 @@ static int delete_nsec3_chain(const zone_contents_t *zone, changeset_t *changese
 		return KNOT_EOK;
 	}
 
-	zone_tree_t *empty_tree = zone_tree_create();
+	zone_tree_t *empty_tree = zone_tree_create(0);
 	if (!empty_tree) {
 		return KNOT_ENOMEM;
 	}
@@ -197,6 +197,50 @@ knot_dname_t *knot_create_nsec3_owner(const knot_dname_t *owner,
 	return result;
 }
 
+int knot_create_nsec3_owners(const knot_dname_t *owners[], size_t count,
+                             const knot_dname_t *zone_apex,
+                             const dnssec_nsec3_params_t *params,
+                             knot_dname_t *nsec3_owners[])
+{
+	if (owners == NULL || count > KNOT_NSEC3_BATCH || zone_apex == NULL ||
+	    params == NULL || nsec3_owners == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	dnssec_binary_t data[KNOT_NSEC3_BATCH] = { { 0 } };
+	dnssec_binary_t hashes[KNOT_NSEC3_BATCH] = { { 0 } };
+	for (size_t i = 0; i < count; i++) {
+		data[i].data = (uint8_t *)owners[i];
+		data[i].size = knot_dname_size(owners[i]);
+	}
+
+	int ret = dnssec_nsec3_hash_batch(data, count, params, hashes);
+	if (ret != DNSSEC_EOK) {
+		ret = knot_error_from_libdnssec(ret);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		nsec3_owners[i] = NULL;
+		if (ret == KNOT_EOK) {
+			nsec3_owners[i] = knot_nsec3_hash_to_dname(hashes[i].data,
+			                                           hashes[i].size,
+			                                           zone_apex);
+			if (nsec3_owners[i] == NULL) {
+				ret = KNOT_ENOMEM;
+			}
+		}
+		dnssec_binary_free(&hashes[i]);
+	}
+
+	if (ret != KNOT_EOK) {
+		for (size_t i = 0; i < count; i++) {
+			knot_dname_free(&nsec3_owners[i], NULL);
+		}
+	}
+
+	return ret;
+}
+
 static bool nsec3param_valid(const knot_rdataset_t *rrs,
                              const dnssec_nsec3_params_t *params)
 {
@@ -391,7 +435,8 @@ int knot_zone_create_nsec_chain(zone_update_t *update,
 
 	if (ctx->policy->nsec3_enabled) {
 		ret = knot_nsec3_create_chain(update->new_cont, &params, nsec_ttl,
-					      ctx->policy->nsec3_opt_out, &ch);
+					      ctx->policy->nsec3_opt_out,
+					      ctx->policy->signing_threads, &ch);
 		if (ret != KNOT_EOK) {
 			goto cleanup;
 		}
@@ -427,6 +472,22 @@ cleanup:
 }
 
 
+bool knot_zone_nsec_chain_current(const zone_contents_t *zone,
+                                  const kdnssec_ctx_t *ctx)
+{
+	if (zone == NULL || ctx == NULL) {
+		return false;
+	}
+
+	const knot_rdataset_t *nsec3param = node_rdataset(zone->apex, KNOT_RRTYPE_NSEC3PARAM);
+	if (!ctx->policy->nsec3_enabled) {
+		return nsec3param == NULL && node_rrtype_exists(zone->apex, KNOT_RRTYPE_NSEC);
+	}
+
+	dnssec_nsec3_params_t params = nsec3param_init(ctx->policy, ctx->zone);
+	return nsec3param != NULL && nsec3param_valid(nsec3param, &params);
+}
+
 int knot_zone_fix_nsec_chain(zone_update_t *update,
                              const zone_keyset_t *zone_keys,
                              const kdnssec_ctx_t *ctx,
@@ -465,7 +526,8 @@ int knot_zone_fix_nsec_chain(zone_update_t *update,
 		}
 		if (ctx->policy->nsec3_enabled) {
 			ret = knot_nsec3_create_chain(update->new_cont, &params, nsec_ttl,
-						      ctx->policy->nsec3_opt_out, &ch);
+						      ctx->policy->nsec3_opt_out,
+						      ctx->policy->signing_threads, &ch);
 		} else {
 			ret = knot_nsec_create_chain(update->new_cont, nsec_ttl, &ch);
 		}
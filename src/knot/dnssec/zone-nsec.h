@@ -23,6 +23,9 @@
 #include "knot/updates/zone-update.h"
 #include "knot/zone/contents.h"
 
+/*! \brief Maximal number of names hashed by knot_create_nsec3_owners(). */
+#define KNOT_NSEC3_BATCH 16
+
 /*!
  * Check if NSEC3 is enabled for the given zone.
  *
@@ -57,6 +60,25 @@ knot_dname_t *knot_create_nsec3_owner(const knot_dname_t *owner,
                                       const knot_dname_t *zone_apex,
                                       const dnssec_nsec3_params_t *params);
 
+/*!
+ * \brief Create NSEC3 owner names from a batch of regular owner names.
+ *
+ * The names are hashed by several at once, which is faster than
+ * knot_create_nsec3_owner() for each of them.
+ *
+ * \param owners        Node owner names.
+ * \param count         Number of the names, at most KNOT_NSEC3_BATCH.
+ * \param zone_apex     Zone apex name.
+ * \param params        Params for NSEC3 hashing function.
+ * \param nsec3_owners  Output: NSEC3 owner names.
+ *
+ * \return KNOT_E*
+ */
+int knot_create_nsec3_owners(const knot_dname_t *owners[], size_t count,
+                             const knot_dname_t *zone_apex,
+                             const dnssec_nsec3_params_t *params,
+                             knot_dname_t *nsec3_owners[]);
+
 /*!
  * \brief Create NSEC or NSEC3 chain in the zone.
  *
@@ -72,6 +94,20 @@ int knot_zone_create_nsec_chain(zone_update_t *update,
                                 const kdnssec_ctx_t *ctx,
                                 bool sign_nsec_chain);
 
+/*!
+ * \brief Check if the type and parameters of the NSEC or NSEC3 chain in the zone
+ *        correspond to the signing policy.
+ *
+ * \note The chain itself is expected to be kept consistent by the updates.
+ *
+ * \param zone  Zone contents.
+ * \param ctx   Signing context.
+ *
+ * \return True if the chain doesn't have to be recreated.
+ */
+bool knot_zone_nsec_chain_current(const zone_contents_t *zone,
+                                  const kdnssec_ctx_t *ctx);
+
 /*!
  * \brief Fix NSEC or NSEC3 chain after zone was updated.
  *
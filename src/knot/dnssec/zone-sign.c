@@ -15,6 +15,7 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <sys/types.h>
 
 #include "dnssec/error.h"
@@ -578,6 +579,150 @@ static int sign_node(zone_node_t **node, void *data)
 	return result;
 }
 
+/*! \brief Minimal number of nodes signed by one thread. */
+#define SIGN_RANGE_MIN_NODES 1024
+
+/*!
+ * \brief Contiguous range of zone tree nodes signed by one thread.
+ */
+typedef struct {
+	zone_tree_t *tree;
+	const knot_dname_t *first;  //!< Owner of the first node in the range.
+	size_t count;               //!< Number of nodes in the range.
+	zone_keyset_t zone_keys;    //!< Keys with own signing contexts.
+	changeset_t changeset;
+	node_sign_args_t args;
+	pthread_t thread;
+	bool started;
+	int result;
+} sign_range_t;
+
+static void *sign_range(void *data)
+{
+	sign_range_t *range = data;
+
+	zone_tree_it_t it = { 0 };
+	range->result = zone_tree_it_begin_leq(range->tree, range->first, &it);
+	for (size_t i = 0; i < range->count && range->result == KNOT_EOK; i++) {
+		assert(!zone_tree_it_finished(&it));
+		zone_node_t *node = zone_tree_it_val(&it);
+		range->result = sign_node(&node, &range->args);
+		zone_tree_it_next(&it);
+	}
+	zone_tree_it_free(&it);
+
+	return NULL;
+}
+
+/*!
+ * \brief Split the zone tree into ranges of (almost) the same size.
+ */
+static int split_ranges(zone_tree_t *tree, sign_range_t *ranges, size_t count)
+{
+	size_t nodes = zone_tree_count(tree);
+
+	zone_tree_it_t it = { 0 };
+	int ret = zone_tree_it_begin(tree, &it);
+	for (size_t i = 0, r = 0; i < nodes && ret == KNOT_EOK; i++) {
+		assert(!zone_tree_it_finished(&it));
+		if (i == r * nodes / count) {
+			ranges[r].tree = tree;
+			ranges[r].first = zone_tree_it_val(&it)->owner;
+			ranges[r].count = (r + 1) * nodes / count - i;
+			r++;
+		}
+		zone_tree_it_next(&it);
+	}
+	zone_tree_it_free(&it);
+
+	return ret;
+}
+
+static int init_range(sign_range_t *range, bool first,
+                      const zone_keyset_t *zone_keys,
+                      const kdnssec_ctx_t *dnssec_ctx,
+                      changeset_t *changeset,
+                      knot_time_t expires_at)
+{
+	range->args.dnssec_ctx = dnssec_ctx;
+	range->args.expires_at = expires_at;
+
+	if (first) {
+		range->args.zone_keys = zone_keys;
+		range->args.changeset = changeset;
+		return KNOT_EOK;
+	}
+
+	int ret = dup_zone_keys(zone_keys, &range->zone_keys);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	range->args.zone_keys = &range->zone_keys;
+
+	ret = changeset_init(&range->changeset, changeset->add->apex->owner);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	range->args.changeset = &range->changeset;
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Sign the zone tree ranges in parallel.
+ *
+ * The first range is signed by the calling thread directly into the target
+ * changeset, the changesets of the other ranges are merged into it in the tree
+ * order, so the result doesn't depend on the threads scheduling.
+ */
+static int sign_ranges(sign_range_t *ranges, size_t count,
+                       const zone_keyset_t *zone_keys,
+                       const kdnssec_ctx_t *dnssec_ctx,
+                       changeset_t *changeset,
+                       knot_time_t *expires_at)
+{
+	int ret = KNOT_EOK;
+	for (size_t i = 0; i < count && ret == KNOT_EOK; i++) {
+		ret = init_range(&ranges[i], i == 0, zone_keys, dnssec_ctx,
+		                 changeset, *expires_at);
+		if (ret == KNOT_EOK && i > 0) {
+			ranges[i].started = (pthread_create(&ranges[i].thread, NULL,
+			                                    sign_range, &ranges[i]) == 0);
+		}
+	}
+
+	// Sign the first range and the ranges without a thread here.
+	for (size_t i = 0; i < count && ret == KNOT_EOK; i++) {
+		if (!ranges[i].started) {
+			sign_range(&ranges[i]);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		sign_range_t *range = &ranges[i];
+		if (range->started) {
+			pthread_join(range->thread, NULL);
+		}
+
+		if (ret == KNOT_EOK) {
+			ret = range->result;
+		}
+		if (ret == KNOT_EOK && i > 0) {
+			ret = changeset_merge(changeset, &range->changeset, 0);
+		}
+		if (ret == KNOT_EOK) {
+			*expires_at = knot_time_min(*expires_at, range->args.expires_at);
+		}
+
+		if (i > 0) {
+			changeset_clear(&range->changeset);
+			free_zone_keys(&range->zone_keys);
+		}
+	}
+
+	return ret;
+}
+
 /*!
  * \brief Update RRSIGs in a given zone tree by updating changeset.
  *
@@ -599,15 +744,37 @@ static int zone_tree_sign(zone_tree_t *tree,
 	assert(dnssec_ctx);
 	assert(changeset);
 
-	node_sign_args_t args = {
-		.zone_keys = zone_keys,
-		.dnssec_ctx = dnssec_ctx,
-		.changeset = changeset,
-		.expires_at = knot_time_add(dnssec_ctx->now, dnssec_ctx->policy->rrsig_lifetime),
-	};
+	*expires_at = knot_time_add(dnssec_ctx->now, dnssec_ctx->policy->rrsig_lifetime -
+	                                               dnssec_ctx->policy->rrsig_jitter);
+
+	size_t threads = MIN(dnssec_ctx->policy->signing_threads,
+	                     zone_tree_count(tree) / SIGN_RANGE_MIN_NODES);
+	if (threads <= 1) {
+		node_sign_args_t args = {
+			.zone_keys = zone_keys,
+			.dnssec_ctx = dnssec_ctx,
+			.changeset = changeset,
+			.expires_at = *expires_at,
+		};
+
+		int result = zone_tree_apply(tree, sign_node, &args);
+		*expires_at = args.expires_at;
 
-	int result = zone_tree_apply(tree, sign_node, &args);
-	*expires_at = args.expires_at;
+		return result;
+	}
+
+	sign_range_t *ranges = calloc(threads, sizeof(*ranges));
+	if (ranges == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int result = split_ranges(tree, ranges, threads);
+	if (result == KNOT_EOK) {
+		result = sign_ranges(ranges, threads, zone_keys, dnssec_ctx,
+		                     changeset, expires_at);
+	}
+
+	free(ranges);
 
 	return result;
 }
@@ -987,6 +1154,48 @@ int knot_zone_sign(zone_update_t *update,
 	return result;
 }
 
+int knot_zone_sign_expiring(zone_update_t *update,
+                            zone_keyset_t *zone_keys,
+                            const kdnssec_ctx_t *dnssec_ctx,
+                            knot_time_t *expire_at)
+{
+	if (!update || !zone_keys || !dnssec_ctx || !expire_at) {
+		return KNOT_EINVAL;
+	}
+
+	changeset_t ch;
+	int result = changeset_init(&ch, update->new_cont->apex->owner);
+	if (result != KNOT_EOK) {
+		return result;
+	}
+
+	node_sign_args_t args = {
+		.zone_keys = zone_keys,
+		.dnssec_ctx = dnssec_ctx,
+		.changeset = &ch,
+		.expires_at = knot_time_add(dnssec_ctx->now, dnssec_ctx->policy->rrsig_lifetime -
+		                                             dnssec_ctx->policy->rrsig_jitter),
+	};
+
+	knot_time_t refresh_until = knot_time_add(dnssec_ctx->now,
+	                                          dnssec_ctx->policy->rrsig_refresh_before);
+	knot_time_t next_expire = 0;
+	result = zone_contents_rrsig_expiring(update->new_cont, refresh_until,
+	                                      dnssec_ctx->policy->rrsig_refresh_limit,
+	                                      sign_node, &args, &next_expire);
+	if (result != KNOT_EOK) {
+		changeset_clear(&ch);
+		return result;
+	}
+
+	*expire_at = knot_time_min(args.expires_at, next_expire);
+
+	result = zone_update_apply_changeset(update, &ch);
+	changeset_clear(&ch);
+
+	return result;
+}
+
 int knot_zone_sign_update_dnskeys(zone_update_t *update,
                                   zone_keyset_t *zone_keys,
                                   const kdnssec_ctx_t *dnssec_ctx)
@@ -1133,6 +1342,68 @@ bool knot_zone_sign_soa_expired(const zone_contents_t *zone,
 	return !all_signatures_exist(&soa, &rrsigs, zone_keys, dnssec_ctx);
 }
 
+/*!
+ * \brief Check if the apex RR set is signed exactly by the keys in use.
+ */
+static bool apex_signed_by_keys(const zone_node_t *apex, uint16_t type,
+                                const zone_keyset_t *zone_keys)
+{
+	knot_rrset_t covered = node_rrset(apex, type);
+	knot_rrset_t rrsigs = node_rrset(apex, KNOT_RRTYPE_RRSIG);
+	if (knot_rrset_empty(&covered)) {
+		return false;
+	}
+
+	// Every key in use has a signature.
+	for (size_t i = 0; i < zone_keys->count; i++) {
+		const zone_key_t *key = &zone_keys->keys[i];
+		if (!use_key(key, &covered)) {
+			continue;
+		}
+
+		uint16_t keytag = dnssec_key_get_keytag(key->key);
+		bool found = false;
+		for (uint16_t j = 0; j < rrsigs.rrs.rr_count && !found; j++) {
+			found = knot_rrsig_type_covered(&rrsigs.rrs, j) == type &&
+			        knot_rrsig_key_tag(&rrsigs.rrs, j) == keytag;
+		}
+		if (!found) {
+			return false;
+		}
+	}
+
+	// Every signature is made by a key in use.
+	for (uint16_t j = 0; j < rrsigs.rrs.rr_count; j++) {
+		if (knot_rrsig_type_covered(&rrsigs.rrs, j) != type) {
+			continue;
+		}
+
+		uint16_t keytag = knot_rrsig_key_tag(&rrsigs.rrs, j);
+		bool found = false;
+		for (size_t i = 0; i < zone_keys->count && !found; i++) {
+			const zone_key_t *key = &zone_keys->keys[i];
+			found = use_key(key, &covered) &&
+			        dnssec_key_get_keytag(key->key) == keytag;
+		}
+		if (!found) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool knot_zone_sign_keys_match(const zone_contents_t *zone,
+                               const zone_keyset_t *zone_keys)
+{
+	if (zone == NULL || zone_keys == NULL) {
+		return false;
+	}
+
+	return apex_signed_by_keys(zone->apex, KNOT_RRTYPE_SOA, zone_keys) &&
+	       apex_signed_by_keys(zone->apex, KNOT_RRTYPE_DNSKEY, zone_keys);
+}
+
 static int sign_changeset(const zone_contents_t *zone,
                              const changeset_t *in_ch,
                              changeset_t *out_ch,
@@ -52,6 +52,42 @@ int knot_zone_sign(zone_update_t *update,
                    const kdnssec_ctx_t *dnssec_ctx,
                    knot_time_t *expire_at);
 
+/*!
+ * \brief Update only the zone signatures expiring within the refresh period.
+ *
+ * The expiring signatures are looked up in the RRSIG expiration index of the
+ * zone contents, so the cost doesn't depend on the zone size. Missing
+ * signatures of not indexed nodes are not added. At most the policy refresh
+ * limit of nodes is re-signed, the remaining ones are then reflected in the
+ * returned expiration.
+ *
+ * \param update      Zone Update containing the zone and to be updated with new RRSIGs.
+ * \param zone_keys   Zone keys.
+ * \param dnssec_ctx  DNSSEC context.
+ * \param expire_at   Time, when the oldest signature in the zone expires.
+ *
+ * \retval KNOT_ENOENT if the zone contents have no RRSIG expiration index.
+ * \return Error code, KNOT_EOK if successful.
+ */
+int knot_zone_sign_expiring(zone_update_t *update,
+                            zone_keyset_t *zone_keys,
+                            const kdnssec_ctx_t *dnssec_ctx,
+                            knot_time_t *expire_at);
+
+/*!
+ * \brief Check if the zone is signed by the keys in use.
+ *
+ * Each signing covers the apex SOA and DNSKEY, so their signatures reveal
+ * the keys the zone has been signed with.
+ *
+ * \param zone       Zone to be checked.
+ * \param zone_keys  Zone keys.
+ *
+ * \return True if the apex SOA and DNSKEY are signed exactly by the keys in use.
+ */
+bool knot_zone_sign_keys_match(const zone_contents_t *zone,
+                               const zone_keyset_t *zone_keys);
+
 /*!
  * \brief Check if zone SOA signatures are expired.
  *
@@ -34,20 +34,21 @@ typedef struct event_info {
 	zone_event_type_t type;
 	const zone_event_cb callback;
 	const char *name;
+	task_prio_t prio;
 } event_info_t;
 
 static const event_info_t EVENT_INFO[] = {
-	{ ZONE_EVENT_LOAD,         event_load,        "load" },
-	{ ZONE_EVENT_REFRESH,      event_refresh,     "refresh" },
-	{ ZONE_EVENT_UPDATE,       event_update,      "update" },
-	{ ZONE_EVENT_EXPIRE,       event_expire,      "expiration" },
-	{ ZONE_EVENT_FLUSH,        event_flush,       "journal flush" },
-	{ ZONE_EVENT_NOTIFY,       event_notify,      "notify" },
-	{ ZONE_EVENT_DNSSEC,       event_dnssec,      "DNSSEC re-sign" },
-	{ ZONE_EVENT_UFREEZE,      event_ufreeze,     "update freeze" },
-	{ ZONE_EVENT_UTHAW,        event_uthaw,       "update thaw" },
-	{ ZONE_EVENT_NSEC3RESALT,  event_nsec3resalt, "NSEC3 resalt" },
-	{ ZONE_EVENT_PARENT_DS_Q,  event_parent_ds_q, "parent DS query" },
+	{ ZONE_EVENT_LOAD,         event_load,        "load",            TASK_PRIO_NORMAL },
+	{ ZONE_EVENT_REFRESH,      event_refresh,     "refresh",         TASK_PRIO_NORMAL },
+	{ ZONE_EVENT_UPDATE,       event_update,      "update",          TASK_PRIO_HIGH },
+	{ ZONE_EVENT_EXPIRE,       event_expire,      "expiration",      TASK_PRIO_NORMAL },
+	{ ZONE_EVENT_FLUSH,        event_flush,       "journal flush",   TASK_PRIO_LOW },
+	{ ZONE_EVENT_NOTIFY,       event_notify,      "notify",          TASK_PRIO_NORMAL },
+	{ ZONE_EVENT_DNSSEC,       event_dnssec,      "DNSSEC re-sign",  TASK_PRIO_LOW },
+	{ ZONE_EVENT_UFREEZE,      event_ufreeze,     "update freeze",   TASK_PRIO_HIGH },
+	{ ZONE_EVENT_UTHAW,        event_uthaw,       "update thaw",     TASK_PRIO_HIGH },
+	{ ZONE_EVENT_NSEC3RESALT,  event_nsec3resalt, "NSEC3 resalt",    TASK_PRIO_LOW },
+	{ ZONE_EVENT_PARENT_DS_Q,  event_parent_ds_q, "parent DS query", TASK_PRIO_NORMAL },
 	{ 0 }
 };
 
@@ -188,13 +189,42 @@ static void reschedule(zone_events_t *events)
 	pthread_mutex_unlock(&events->reschedule_lock);
 }
 
+/*!
+ * \brief Free the context of the suspended event.
+ */
+static void suspend_data_free(zone_events_t *events)
+{
+	if (events->suspend_data != NULL && events->suspend_free != NULL) {
+		events->suspend_free(events->suspend_data);
+	}
+	events->suspend_data = NULL;
+	events->suspend_free = NULL;
+}
+
+/*!
+ * \brief Run the resumed event again, or finish it if the events are frozen.
+ *
+ * \note Expects the events lock held.
+ */
+static void event_continue(zone_events_t *events)
+{
+	if (events->frozen) {
+		events->resumed = false;
+		events->running = false;
+		suspend_data_free(events);
+		return;
+	}
+
+	worker_pool_assign(events->pool, &events->task);
+}
+
 /*!
  * \brief Zone event wrapper, expected to be called from a worker thread.
  *
- * 1. Takes the next planned event.
+ * 1. Takes the next planned event (or the resumed one).
  * 2. Resets the event's scheduled time (and forced flag).
  * 3. Perform the event's callback.
- * 4. Schedule next event planned event.
+ * 4. Schedule next event planned event (unless the event is suspended).
  */
 static void event_wrap(task_t *task)
 {
@@ -205,14 +235,21 @@ static void event_wrap(task_t *task)
 	zone_events_t *events = &zone->events;
 
 	pthread_mutex_lock(&events->mx);
-	zone_event_type_t type = get_next_event(events);
-	if (!valid_event(type)) {
-		events->running = false;
-		pthread_mutex_unlock(&events->mx);
-		return;
+	zone_event_type_t type = events->type;
+	if (events->resumed) {
+		events->resumed = false;
+	} else {
+		type = get_next_event(events);
+		if (!valid_event(type)) {
+			events->running = false;
+			pthread_mutex_unlock(&events->mx);
+			return;
+		}
+		event_set_time(events, type, 0);
+		events->forced[type] = false;
+		events->type = type;
 	}
-	event_set_time(events, type, 0);
-	events->forced[type] = false;
+	events->executing = true;
 	pthread_mutex_unlock(&events->mx);
 
 	const event_info_t *info = get_event_info(type);
@@ -234,6 +271,17 @@ static void event_wrap(task_t *task)
 	}
 
 	pthread_mutex_lock(&events->mx);
+	events->executing = false;
+	if (events->suspended) {
+		pthread_mutex_unlock(&events->mx);
+		return;
+	}
+	if (events->resumed) {
+		event_continue(events);
+		pthread_mutex_unlock(&events->mx);
+		return;
+	}
+	suspend_data_free(events);
 	events->running = false;
 	pthread_mutex_unlock(&events->mx);
 	reschedule(events);
@@ -250,9 +298,11 @@ static void event_dispatch(event_t *event)
 	zone_events_t *events = event->data;
 
 	pthread_mutex_lock(&events->mx);
-	if (!events->running && !events->frozen) {
+	zone_event_type_t type = get_next_event(events);
+	if (!events->running && !events->frozen && valid_event(type)) {
 		events->running = true;
-		worker_pool_assign(events->pool, &events->task);
+		events->task.prio = get_event_info(type)->prio;
+		evsched_assign(event, events->pool, &events->task);
 	}
 	pthread_mutex_unlock(&events->mx);
 }
@@ -268,6 +318,8 @@ int zone_events_init(zone_t *zone)
 	memset(&zone->events, 0, sizeof(zone->events));
 	pthread_mutex_init(&events->mx, NULL);
 	pthread_mutex_init(&events->reschedule_lock, NULL);
+	pthread_cond_init(&events->resume, NULL);
+	events->type = ZONE_EVENT_INVALID;
 	events->task.ctx = zone;
 	events->task.run = event_wrap;
 
@@ -303,8 +355,11 @@ void zone_events_deinit(zone_t *zone)
 	evsched_cancel(zone->events.event);
 	evsched_event_free(zone->events.event);
 
+	suspend_data_free(&zone->events);
+
 	pthread_mutex_destroy(&zone->events.mx);
 	pthread_mutex_destroy(&zone->events.reschedule_lock);
+	pthread_cond_destroy(&zone->events.resume);
 
 	memset(&zone->events, 0, sizeof(zone->events));
 }
@@ -374,6 +429,7 @@ void zone_events_enqueue(zone_t *zone, zone_event_type_t type)
 	    (!events->ufrozen || !ufreeze_applies(type))) {
 		events->running = true;
 		event_set_time(events, type, ZONE_EVENT_IMMEDIATE);
+		events->task.prio = get_event_info(type)->prio;
 		worker_pool_assign(events->pool, &events->task);
 		pthread_mutex_unlock(&events->mx);
 		return;
@@ -385,6 +441,59 @@ void zone_events_enqueue(zone_t *zone, zone_event_type_t type)
 	zone_events_schedule_now(zone, type);
 }
 
+void zone_events_suspend(zone_t *zone, void *data, void (*data_free)(void *))
+{
+	if (!zone) {
+		return;
+	}
+
+	zone_events_t *events = &zone->events;
+
+	pthread_mutex_lock(&events->mx);
+	assert(events->executing && !events->suspended);
+	events->suspended = true;
+	events->suspend_data = data;
+	events->suspend_free = data_free;
+	pthread_mutex_unlock(&events->mx);
+}
+
+void zone_events_resume(zone_t *zone)
+{
+	if (!zone) {
+		return;
+	}
+
+	zone_events_t *events = &zone->events;
+
+	pthread_mutex_lock(&events->mx);
+	assert(events->suspended);
+	events->suspended = false;
+	events->resumed = true;
+	pthread_cond_broadcast(&events->resume);
+	/* Continued by the callback wrapper if still executing. */
+	if (!events->executing) {
+		event_continue(events);
+	}
+	pthread_mutex_unlock(&events->mx);
+}
+
+void *zone_events_resumed(zone_t *zone)
+{
+	if (!zone) {
+		return NULL;
+	}
+
+	zone_events_t *events = &zone->events;
+
+	pthread_mutex_lock(&events->mx);
+	void *data = events->suspend_data;
+	events->suspend_data = NULL;
+	events->suspend_free = NULL;
+	pthread_mutex_unlock(&events->mx);
+
+	return data;
+}
+
 void zone_events_freeze(zone_t *zone)
 {
 	if (!zone) {
@@ -396,6 +505,10 @@ void zone_events_freeze(zone_t *zone)
 	/* Prevent new events being enqueued. */
 	pthread_mutex_lock(&events->mx);
 	events->frozen = true;
+	/* The asynchronous operation refers to the zone. */
+	while (events->suspended) {
+		pthread_cond_wait(&events->resume, &events->mx);
+	}
 	pthread_mutex_unlock(&events->mx);
 
 	/* Cancel current event. */
@@ -48,10 +48,18 @@ typedef enum zone_event_type {
 typedef struct zone_events {
 	pthread_mutex_t mx;		//!< Mutex protecting the struct.
 	pthread_mutex_t reschedule_lock;//!< Prevent concurrent reschedule() making mess.
+	pthread_cond_t resume;		//!< Signalled when a suspended event resumes.
 	bool running;			//!< Some zone event is being run.
+	bool executing;			//!< The event callback is being executed.
+	bool suspended;			//!< The running event waits for an asynchronous operation.
+	bool resumed;			//!< The suspended event is to be continued.
 	bool frozen;			//!< Terminated, don't schedule new events.
 	bool ufrozen;			//!< Updates to the zone temporarily frozen by user.
 
+	zone_event_type_t type;		//!< Type of the running event.
+	void *suspend_data;		//!< Context of the suspended event.
+	void (*suspend_free)(void *);	//!< Context destructor if the event can't continue.
+
 	event_t *event;			//!< Scheduler event.
 	worker_pool_t *pool;		//!< Server worker pool.
 	knot_db_t *timers_db;		//!< Persistent zone timers database.
@@ -136,9 +144,45 @@ void _zone_events_schedule_at(struct zone *zone, ...);
  */
 void zone_events_schedule_user(struct zone *zone, zone_event_type_t type);
 
+/*!
+ * \brief Keep the running event after its callback returns.
+ *
+ * The event waits for an asynchronous operation, which calls
+ * \ref zone_events_resume on completion. No other zone event is run meanwhile,
+ * but the worker is free. The event callback is then called again and takes
+ * the context back by \ref zone_events_resumed.
+ *
+ * \note Must be called from the event callback, before the operation starts.
+ *
+ * \param zone       Zone with the running event.
+ * \param data       Context of the event.
+ * \param data_free  Context destructor, used if the event can't continue.
+ */
+void zone_events_suspend(struct zone *zone, void *data, void (*data_free)(void *));
+
+/*!
+ * \brief Continue the suspended event in a worker.
+ *
+ * If the zone events are frozen, the event is finished and its context freed.
+ *
+ * \param zone  Zone with the suspended event.
+ */
+void zone_events_resume(struct zone *zone);
+
+/*!
+ * \brief Take over the context of the resumed event.
+ *
+ * \param zone  Zone with the running event.
+ *
+ * \return Context passed to \ref zone_events_suspend, NULL if not resumed.
+ */
+void *zone_events_resumed(struct zone *zone);
+
 /*!
  * \brief Freeze all zone events and prevent new events from running.
  *
+ * \note Waits for the asynchronous operation of a suspended event.
+ *
  * \param zone  Zone to freeze events for.
  */
 void zone_events_freeze(struct zone *zone);
@@ -74,7 +74,7 @@ int event_dnssec(conf_t *conf, zone_t *zone)
 		sign_flags = ZONE_SIGN_DROP_SIGNATURES;
 	} else {
 		log_zone_info(zone->name, "DNSSEC, signing zone");
-		sign_flags = 0;
+		sign_flags = ZONE_SIGN_EXPIRING;
 	}
 
 	if (zone_events_get_time(zone, ZONE_EVENT_NSEC3RESALT) <= time(NULL)) {
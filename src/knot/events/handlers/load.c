@@ -18,6 +18,7 @@
 
 #include "knot/common/log.h"
 #include "knot/conf/conf.h"
+#include "knot/conf/zones.h"
 #include "knot/dnssec/key-events.h"
 #include "knot/dnssec/zone-events.h"
 #include "knot/events/handlers.h"
@@ -39,8 +40,8 @@ int event_load(conf_t *conf, zone_t *zone)
 	bool old_contents_exist = (zone->contents != NULL);
 	uint32_t old_serial = (old_contents_exist ? zone_contents_serial(zone->contents) : 0);
 
-	conf_val_t val = conf_zone_get(conf, C_JOURNAL_CONTENT, zone->name);
-	unsigned load_from = conf_opt(&val);
+	conf_zone_t zconf = conf_zone(conf, zone->name);
+	unsigned load_from = zconf.journal_content;
 
 	unsigned zf_from = conf_zonefile_load(conf, zone->name);
 
@@ -105,8 +106,7 @@ int event_load(conf_t *conf, zone_t *zone)
 		}
 	}
 
-	val = conf_zone_get(conf, C_DNSSEC_SIGNING, zone->name);
-	bool dnssec_enable = conf_bool(&val);
+	bool dnssec_enable = zconf.dnssec_signing;
 	zone_update_t up = { 0 };
 
 	// Create zone_update structure according to current state.
@@ -15,6 +15,8 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "knot/common/log.h"
 #include "knot/conf/conf.h"
@@ -125,6 +127,147 @@ static int send_notify(conf_t *conf, zone_t *zone, const knot_rrset_t *soa,
 	return ret;
 }
 
+/*!
+ * \brief Asynchronous NOTIFY to one remote, its addresses are tried in order.
+ */
+struct notify_remote {
+	struct notify_data data;
+	struct knot_request_loop *loop;
+	knot_dname_t *zone;
+	knot_rrset_t *soa;
+	uint8_t *edns_data;
+	int timeout;
+	size_t count;
+	size_t cur;
+	struct {
+		conf_remote_t remote;
+		struct query_edns_data edns;
+	} addrs[];
+};
+
+static void notify_remote_free(struct notify_remote *rmt)
+{
+	for (size_t i = 0; i < rmt->count; i++) {
+		knot_tsig_key_deinit(&rmt->addrs[i].remote.key);
+	}
+	knot_rrset_free(&rmt->soa, NULL);
+	knot_dname_free(&rmt->zone, NULL);
+	free(rmt->edns_data);
+	free(rmt);
+}
+
+static int notify_remote_submit(struct notify_remote *rmt);
+
+static void notify_remote_done(struct knot_request *req, int ret, void *ctx)
+{
+	struct notify_remote *rmt = ctx;
+	const struct sockaddr *dst = (struct sockaddr *)&req->remote;
+
+	if (ret == KNOT_EOK) {
+		NOTIFY_LOG(LOG_INFO, rmt->zone, dst,
+			   "serial %u", knot_soa_serial(&rmt->soa->rrs));
+	} else if (knot_pkt_ext_rcode(req->resp) == 0) {
+		NOTIFY_LOG(LOG_WARNING, rmt->zone, dst,
+		           "failed (%s)", knot_strerror(ret));
+	} else {
+		NOTIFY_LOG(LOG_WARNING, rmt->zone, dst,
+		           "server responded with error '%s'",
+		           knot_pkt_ext_rcode_name(req->resp));
+	}
+
+	knot_request_free(req, NULL);
+
+	/* Try the next address of the remote. */
+	while (ret != KNOT_EOK && ret != KNOT_ENOTRUNNING && ++rmt->cur < rmt->count) {
+		ret = notify_remote_submit(rmt);
+		if (ret == KNOT_EOK) {
+			return;
+		}
+	}
+
+	notify_remote_free(rmt);
+}
+
+static int notify_remote_submit(struct notify_remote *rmt)
+{
+	const conf_remote_t *slave = &rmt->addrs[rmt->cur].remote;
+
+	rmt->data.remote = (struct sockaddr *)&slave->addr;
+	rmt->data.edns = rmt->addrs[rmt->cur].edns;
+
+	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	if (!pkt) {
+		return KNOT_ENOMEM;
+	}
+
+	const struct sockaddr *dst = (struct sockaddr *)&slave->addr;
+	const struct sockaddr *src = (struct sockaddr *)&slave->via;
+	struct knot_request *req = knot_request_make(NULL, dst, src, pkt, &slave->key, 0);
+	if (!req) {
+		knot_pkt_free(&pkt);
+		return KNOT_ENOMEM;
+	}
+
+	int ret = knot_request_loop_submit(rmt->loop, &NOTIFY_API, &rmt->data, req,
+	                                   rmt->timeout, notify_remote_done, rmt);
+	if (ret != KNOT_EOK) {
+		knot_request_free(req, NULL);
+	}
+
+	return ret;
+}
+
+static struct notify_remote *notify_remote_new(conf_t *conf, zone_t *zone,
+                                               const knot_rrset_t *soa,
+                                               conf_val_t *id, size_t count,
+                                               int timeout)
+{
+	struct notify_remote *rmt = calloc(1, sizeof(*rmt) + count * sizeof(rmt->addrs[0]));
+	if (rmt == NULL) {
+		return NULL;
+	}
+
+	rmt->loop = zone->requests;
+	rmt->timeout = timeout;
+	rmt->zone = knot_dname_copy(zone->name, NULL);
+	rmt->soa = knot_rrset_copy(soa, NULL);
+	if (rmt->zone == NULL || rmt->soa == NULL) {
+		notify_remote_free(rmt);
+		return NULL;
+	}
+	rmt->data.zone = rmt->zone;
+	rmt->data.soa = rmt->soa;
+
+	/* Keep own copies of the configuration data. */
+	for (size_t i = 0; i < count; i++) {
+		conf_remote_t slave = conf_remote(conf, id, i);
+		rmt->addrs[i].remote = slave;
+		memset(&rmt->addrs[i].remote.key, 0, sizeof(slave.key));
+		if (slave.key.name != NULL &&
+		    knot_tsig_key_copy(&rmt->addrs[i].remote.key, &slave.key) != KNOT_EOK) {
+			notify_remote_free(rmt);
+			return NULL;
+		}
+		rmt->count++;
+
+		struct query_edns_data *edns = &rmt->addrs[i].edns;
+		query_edns_data_init(edns, conf, zone->name, slave.addr.ss_family);
+		if (edns->custom_len > 0) {
+			if (rmt->edns_data == NULL) {
+				rmt->edns_data = malloc(edns->custom_len);
+				if (rmt->edns_data == NULL) {
+					notify_remote_free(rmt);
+					return NULL;
+				}
+				memcpy(rmt->edns_data, edns->custom_data, edns->custom_len);
+			}
+			edns->custom_data = rmt->edns_data;
+		}
+	}
+
+	return rmt;
+}
+
 int event_notify(conf_t *conf, zone_t *zone)
 {
 	assert(zone);
@@ -143,6 +286,20 @@ int event_notify(conf_t *conf, zone_t *zone)
 		conf_val_t addr = conf_id_get(conf, C_RMT, C_ADDR, &notify);
 		size_t addr_count = conf_val_count(&addr);
 
+		// asynchronously if possible, the remotes are notified in parallel
+		if (zone->requests != NULL && addr_count > 0) {
+			struct notify_remote *rmt = notify_remote_new(conf, zone, &soa,
+			                                              &notify, addr_count,
+			                                              timeout);
+			if (rmt != NULL && notify_remote_submit(rmt) == KNOT_EOK) {
+				conf_val_next(&notify);
+				continue;
+			}
+			if (rmt != NULL) {
+				notify_remote_free(rmt);
+			}
+		}
+
 		for (int i = 0; i < addr_count; i++) {
 			conf_remote_t slave = conf_remote(conf, &notify, i);
 			int ret = send_notify(conf, zone, &soa, &slave, timeout);
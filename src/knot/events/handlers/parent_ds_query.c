@@ -15,6 +15,8 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "knot/zone/zone.h"
 #include "knot/common/log.h"
@@ -106,6 +108,21 @@ static const knot_layer_api_t ds_query_api = {
 	.finish = NULL,
 };
 
+static int ds_query_result(struct ds_query_data *data, int ret)
+{
+	// alternative: we could put answer back through ctx instead of errcode
+	if (ret == KNOT_EOK && !data->ds_ok) {
+		ret = KNOT_ENORECORD;
+	}
+
+	if (ret != KNOT_EOK && !data->result_logged) {
+		ns_log(LOG_WARNING, data->zone->name, LOG_OPERATION_PARENT,
+		       LOG_DIRECTION_OUT, data->remote, "failed (%s)", knot_strerror(ret));
+	}
+
+	return ret;
+}
+
 static int try_ds(conf_t *conf, zone_t *zone, const conf_remote_t *parent, zone_key_t *key)
 {
 	// TODO: Abstract interface to issue DNS queries. This is almost copy-pasted.
@@ -146,29 +163,31 @@ static int try_ds(conf_t *conf, zone_t *zone, const conf_remote_t *parent, zone_
 	knot_request_free(req, NULL);
 	knot_requestor_clear(&requestor);
 
-	// alternative: we could put answer back through ctx instead of errcode
-	if (ret == KNOT_EOK && !data.ds_ok) {
-		ret = KNOT_ENORECORD;
-	}
-
-	if (ret != KNOT_EOK && !data.result_logged) {
-		ns_log(LOG_WARNING, zone->name, LOG_OPERATION_PARENT,
-		       LOG_DIRECTION_OUT, data.remote, "failed (%s)", knot_strerror(ret));
-	}
-
-	return ret;
+	return ds_query_result(&data, ret);
 }
 
-static bool parents_have_ds(zone_t *zone, conf_t *conf, zone_key_t *key)
+static conf_val_t zone_parents(conf_t *conf, zone_t *zone)
 {
 	conf_val_t policy = conf_zone_get(conf, C_DNSSEC_POLICY, zone->name);
 	conf_id_fix_default(&policy);
 	conf_val_t ksk_sbm = conf_id_get(conf, C_POLICY, C_KSK_SBM, &policy);
 	assert(conf_val_count(&ksk_sbm) < 2);
 	if (conf_val_count(&ksk_sbm) < 1) {
-		return false;
+		conf_val_t none = { .code = KNOT_ENOENT };
+		return none;
 	}
-	conf_val_t parents = conf_id_get(conf, C_SBM, C_PARENT, &ksk_sbm);
+	return conf_id_get(conf, C_SBM, C_PARENT, &ksk_sbm);
+}
+
+static bool ds_check_key(const zone_key_t *key)
+{
+	return dnssec_key_get_flags(key->key) == DNSKEY_FLAGS_KSK &&
+	       key->cds_priority > 1;
+}
+
+static bool parents_have_ds(zone_t *zone, conf_t *conf, zone_key_t *key)
+{
+	conf_val_t parents = zone_parents(conf, zone);
 
 	bool success = false;
 	while (parents.code == KNOT_EOK) {
@@ -190,8 +209,246 @@ static bool parents_have_ds(zone_t *zone, conf_t *conf, zone_key_t *key)
 	return success;
 }
 
+/*!
+ * \brief Asynchronous DS query of the parents.
+ *
+ * The queries are sent from the request loop one by one and the event is
+ * suspended meanwhile. The submitted KSK is confirmed in the resumed event.
+ */
+struct ds_check {
+	struct ds_query_data data;   //!< DS query processing.
+	kdnssec_ctx_t ctx;           //!< DNSSEC context kept for the confirmation.
+	zone_keyset_t keyset;        //!< Zone keys, the submitted KSKs are checked.
+	int timeout;                 //!< Request timeout (miliseconds).
+	int ret;                     //!< Result of the last query.
+	int result;                  //!< Result of the checked keys.
+	bool started;                //!< Some parent has been queried.
+	bool success;                //!< The current parent has the DS.
+	size_t key;                  //!< Currently checked key.
+	size_t count;                //!< Number of the parent addresses.
+	size_t cur;                  //!< Currently queried address.
+	struct {
+		conf_remote_t remote;
+		size_t parent;       //!< Index of the parent.
+	} addrs[];                   //!< Own copies of the parent addresses.
+};
+
+static void ds_check_free(void *ptr)
+{
+	struct ds_check *check = ptr;
+	if (check == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < check->count; i++) {
+		knot_tsig_key_deinit(&check->addrs[i].remote.key);
+	}
+	free_zone_keys(&check->keyset);
+	kdnssec_ctx_deinit(&check->ctx);
+	free(check);
+}
+
+static struct ds_check *ds_check_new(conf_t *conf, zone_t *zone)
+{
+	if (zone->requests == NULL) {
+		return NULL;
+	}
+
+	size_t count = 0;
+	conf_val_t parents = zone_parents(conf, zone);
+	while (parents.code == KNOT_EOK) {
+		conf_val_t addr = conf_id_get(conf, C_RMT, C_ADDR, &parents);
+		count += conf_val_count(&addr);
+		conf_val_next(&parents);
+	}
+	if (count == 0) {
+		return NULL;
+	}
+
+	struct ds_check *check = calloc(1, sizeof(*check) +
+	                                count * sizeof(check->addrs[0]));
+	if (check == NULL) {
+		return NULL;
+	}
+
+	check->data.zone = zone;
+	check->timeout = conf->cache.srv_tcp_reply_timeout * 1000;
+
+	size_t parent = 0;
+	parents = zone_parents(conf, zone);
+	while (parents.code == KNOT_EOK) {
+		conf_val_t addr = conf_id_get(conf, C_RMT, C_ADDR, &parents);
+		size_t addr_count = conf_val_count(&addr);
+
+		for (size_t i = 0; i < addr_count; i++) {
+			conf_remote_t remote = conf_remote(conf, &parents, i);
+			conf_remote_t *dst = &check->addrs[check->count].remote;
+			*dst = remote;
+			memset(&dst->key, 0, sizeof(dst->key));
+			check->addrs[check->count].parent = parent;
+			check->count++;
+			if (remote.key.name != NULL &&
+			    knot_tsig_key_copy(&dst->key, &remote.key) != KNOT_EOK) {
+				ds_check_free(check);
+				return NULL;
+			}
+		}
+
+		parent++;
+		conf_val_next(&parents);
+	}
+
+	return check;
+}
+
+static void ds_check_done(struct knot_request *req, int ret, void *ctx)
+{
+	struct ds_check *check = ctx;
+
+	check->ret = ret;
+	knot_request_free(req, NULL);
+
+	zone_events_resume(check->data.zone);
+}
+
+static void ds_check_submit(struct ds_check *check)
+{
+	struct ds_query_data *data = &check->data;
+	const conf_remote_t *parent = &check->addrs[check->cur].remote;
+
+	data->remote = (struct sockaddr *)&parent->addr;
+	data->key = &check->keyset.keys[check->key];
+	data->ds_ok = false;
+	data->result_logged = false;
+
+	zone_events_suspend(data->zone, check, ds_check_free);
+
+	struct knot_request *req = NULL;
+	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	if (pkt != NULL) {
+		const struct sockaddr *dst = (struct sockaddr *)&parent->addr;
+		const struct sockaddr *src = (struct sockaddr *)&parent->via;
+		req = knot_request_make(NULL, dst, src, pkt, &parent->key, 0);
+		if (req == NULL) {
+			knot_pkt_free(&pkt);
+		}
+	}
+
+	int ret = KNOT_ENOMEM;
+	if (req != NULL) {
+		ret = knot_request_loop_submit(data->zone->requests, &ds_query_api,
+		                               data, req, check->timeout,
+		                               ds_check_done, check);
+	}
+	if (ret != KNOT_EOK) {
+		// Completed with the error, the event continues with the next parent.
+		ds_check_done(req, ret, check);
+	}
+}
+
+/*!
+ * \brief Evaluate the last DS query and query the next parent.
+ *
+ * Like the synchronous check, a key is confirmed if the last parent has its
+ * DS at some of its addresses.
+ *
+ * \return KNOT_EAGAIN if the event is suspended for the next query.
+ */
+static int ds_check_next(struct ds_check *check)
+{
+	if (check->started) {
+		if (check->ret == KNOT_ENOTRUNNING) {
+			return check->ret;
+		}
+		int ret = ds_query_result(&check->data, check->ret);
+
+		size_t parent = check->addrs[check->cur].parent;
+		if (ret == KNOT_EOK) {
+			check->success = true;
+			// Skip the other addresses of the parent.
+			while (check->cur + 1 < check->count &&
+			       check->addrs[check->cur + 1].parent == parent) {
+				check->cur++;
+			}
+		}
+
+		if (++check->cur < check->count) {
+			if (check->addrs[check->cur].parent != parent) {
+				check->success = false;
+			}
+		} else {
+			if (check->success) {
+				check->result = knot_dnssec_ksk_sbm_confirm(&check->ctx);
+			} else {
+				check->result = KNOT_ENOENT;
+			}
+			check->success = false;
+			check->cur = 0;
+			check->key++;
+		}
+	}
+
+	while (check->key < check->keyset.count &&
+	       !ds_check_key(&check->keyset.keys[check->key])) {
+		check->key++;
+	}
+	if (check->key >= check->keyset.count) {
+		return check->result;
+	}
+
+	check->started = true;
+	ds_check_submit(check);
+
+	return KNOT_EAGAIN;
+}
+
+static void ds_reschedule(zone_t *zone, int ret, uint32_t check_interval)
+{
+	zone->timers.next_parent_ds_q = 0;
+	if (ret != KNOT_EOK) {
+		if (check_interval > 0) {
+			time_t next_check = time(NULL) + check_interval;
+			zone->timers.next_parent_ds_q = next_check;
+			zone_events_schedule_at(zone, ZONE_EVENT_PARENT_DS_Q, next_check);
+		}
+	} else {
+		zone_events_schedule_now(zone, ZONE_EVENT_DNSSEC);
+	}
+}
+
 int event_parent_ds_q(conf_t *conf, zone_t *zone)
 {
+	struct ds_check *check = zone_events_resumed(zone);
+	if (check == NULL) {
+		check = ds_check_new(conf, zone);
+		if (check != NULL) {
+			int ret = kdnssec_ctx_init(conf, &check->ctx, zone->name, NULL);
+			if (ret == KNOT_EOK) {
+				ret = load_zone_keys(check->ctx.zone, check->ctx.keystore,
+				                     false, check->ctx.now, &check->keyset,
+				                     false);
+			}
+			if (ret != KNOT_EOK) {
+				ds_check_free(check);
+				return ret;
+			}
+		}
+	}
+
+	if (check != NULL) {
+		int ret = ds_check_next(check);
+		if (ret == KNOT_EAGAIN) {
+			// Suspended until the DS query completes.
+			return KNOT_EOK;
+		}
+		if (ret != KNOT_ENOTRUNNING) {
+			ds_reschedule(zone, ret, check->ctx.policy->ksk_sbm_check_interval);
+		}
+		ds_check_free(check);
+
+		return KNOT_EOK;
+	}
+
 	kdnssec_ctx_t ctx = { 0 };
 
 	int ret = kdnssec_ctx_init(conf, &ctx, zone->name, NULL);
@@ -208,8 +465,7 @@ int event_parent_ds_q(conf_t *conf, zone_t *zone)
 
 	for (size_t i = 0; i < keyset.count; i++) {
 		zone_key_t *key = &keyset.keys[i];
-		if (dnssec_key_get_flags(key->key) == DNSKEY_FLAGS_KSK &&
-		    key->cds_priority > 1) {
+		if (ds_check_key(key)) {
 			if (parents_have_ds(zone, conf, key)) {
 				ret = knot_dnssec_ksk_sbm_confirm(&ctx);
 			} else {
@@ -218,16 +474,7 @@ int event_parent_ds_q(conf_t *conf, zone_t *zone)
 		}
 	}
 
-	zone->timers.next_parent_ds_q = 0;
-	if (ret != KNOT_EOK) {
-		if (ctx.policy->ksk_sbm_check_interval > 0) {
-			time_t next_check = time(NULL) + ctx.policy->ksk_sbm_check_interval;
-			zone->timers.next_parent_ds_q = next_check;
-			zone_events_schedule_at(zone, ZONE_EVENT_PARENT_DS_Q, next_check);
-		}
-	} else {
-		zone_events_schedule_now(zone, ZONE_EVENT_DNSSEC);
-	}
+	ds_reschedule(zone, ret, ctx.policy->ksk_sbm_check_interval);
 
 	free_zone_keys(&keyset);
 	kdnssec_ctx_deinit(&ctx);
@@ -16,12 +16,16 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "contrib/mempattern.h"
+#include "contrib/sockaddr.h"
 #include "contrib/trim.h"
 #include "dnssec/random.h"
 #include "knot/common/log.h"
 #include "knot/conf/conf.h"
+#include "knot/conf/zones.h"
 #include "knot/dnssec/zone-events.h"
 #include "knot/events/handlers.h"
 #include "knot/events/log.h"
@@ -102,8 +106,9 @@ struct refresh_data {
 	conf_t *conf;                     //!< Server configuration.
 	const struct sockaddr *remote;    //!< Remote endpoint.
 	const knot_rrset_t *soa;          //!< Local SOA (NULL for AXFR).
-	const size_t max_zone_size;       //!< Maximal zone size.
+	size_t max_zone_size;             //!< Maximal zone size.
 	struct query_edns_data edns;      //!< EDNS data to be used in queries.
+	bool deferred;                    //!< Transfer finalized by the caller.
 
 	// internal state, initialize with zeroes:
 
@@ -195,7 +200,7 @@ static void xfr_log_publish(const knot_dname_t *zone_name,
 
 static int axfr_init(struct refresh_data *data)
 {
-	zone_contents_t *new_zone = zone_contents_new(data->zone->name);
+	zone_contents_t *new_zone = zone_contents_new(data->zone->name, true);
 	if (new_zone == NULL) {
 		return KNOT_ENOMEM;
 	}
@@ -230,8 +235,8 @@ static int axfr_finalize(struct refresh_data *data)
 	bool bootstrap = (data->soa == NULL);
 	if ((!bootstrap || have_lastsigned) &&
 	    (serial_compare(master_serial, local_serial) != SERIAL_GREATER)) {
-		conf_val_t val = conf_zone_get(data->conf, C_SERIAL_POLICY, data->zone->name);
-		local_serial = serial_next(local_serial, conf_opt(&val));
+		unsigned policy = conf_zone(data->conf, data->zone->name).serial_policy;
+		local_serial = serial_next(local_serial, policy);
 		zone_contents_set_soa_serial(new_zone, local_serial);
 	}
 
@@ -241,8 +246,7 @@ static int axfr_finalize(struct refresh_data *data)
 		return ret;
 	}
 
-	conf_val_t val = conf_zone_get(data->conf, C_DNSSEC_SIGNING, data->zone->name);
-	bool dnssec_enable = conf_bool(&val);
+	bool dnssec_enable = conf_zone(data->conf, data->zone->name).dnssec_signing;
 	if (dnssec_enable) {
 		zone_sign_reschedule_t resch = { .allow_rollover = true };
 		ret = knot_dnssec_zone_sign(&up, ZONE_SIGN_KEEP_SERIAL, &resch);
@@ -424,8 +428,8 @@ static int ixfr_finalize(struct refresh_data *data)
 			local_serial = lastsigned_serial;
 		}
 		if (serial_compare(master_serial, local_serial) != SERIAL_GREATER) {
-			conf_val_t val = conf_zone_get(data->conf, C_SERIAL_POLICY, data->zone->name);
-			local_serial = serial_next(local_serial, conf_opt(&val));
+			unsigned policy = conf_zone(data->conf, data->zone->name).serial_policy;
+			local_serial = serial_next(local_serial, policy);
 			knot_soa_serial_set(&chs->soa_to->rrs, local_serial);
 		} else {
 			local_serial = master_serial;
@@ -456,8 +460,7 @@ static int ixfr_finalize(struct refresh_data *data)
 		return ret;
 	}
 
-	conf_val_t val = conf_zone_get(data->conf, C_DNSSEC_SIGNING, data->zone->name);
-	bool dnssec_enable = conf_bool(&val);
+	bool dnssec_enable = conf_zone(data->conf, data->zone->name).dnssec_signing;
 	if (dnssec_enable) {
 		zone_sign_reschedule_t resch = { .allow_rollover = true };
 		ret = knot_dnssec_sign_update(&up, &resch);
@@ -910,6 +913,11 @@ static int transfer_consume(knot_layer_t *layer, knot_pkt_t *pkt)
 			return KNOT_STATE_FAIL;
 		}
 
+		// Keep the result for the caller
+		if (data->deferred) {
+			return next;
+		}
+
 		// Finalize and publish the zone
 		int ret;
 		switch (data->xfr_type) {
@@ -947,6 +955,11 @@ static int refresh_begin(knot_layer_t *layer, void *_data)
 	layer->data = _data;
 	struct refresh_data *data = _data;
 
+	// Continue with the AXFR fallback of a deferred transfer
+	if (data->state == STATE_TRANSFER) {
+		return KNOT_STATE_PRODUCE;
+	}
+
 	if (data->soa) {
 		data->state = STATE_SOA_QUERY;
 		data->xfr_type = XFR_TYPE_IXFR;
@@ -1010,8 +1023,7 @@ static const knot_layer_api_t REFRESH_API = {
 
 static size_t max_zone_size(conf_t *conf, const knot_dname_t *zone)
 {
-	conf_val_t val = conf_zone_get(conf, C_MAX_ZONE_SIZE, zone);
-	return conf_int(&val);
+	return conf_zone(conf, zone).max_zone_size;
 }
 
 static int try_refresh(conf_t *conf, zone_t *zone, const conf_remote_t *master, void *ctx)
@@ -1073,30 +1085,315 @@ static int try_refresh(conf_t *conf, zone_t *zone, const conf_remote_t *master,
 	return ret;
 }
 
+/*!
+ * \brief Asynchronous refresh from the zone masters.
+ *
+ * The SOA query and the transfer are processed in the request loop and the
+ * event is suspended meanwhile. The transferred zone is finalized in the
+ * resumed event, which also falls back to AXFR or tries the next master.
+ */
+struct refresh_check {
+	struct refresh_data data;    //!< Refresh processing, must be first.
+	knot_rrset_t *soa;           //!< Copy of the local SOA, NULL for AXFR.
+	uint8_t *edns_data;          //!< Copy of the custom EDNS option data.
+	int timeout;                 //!< Request timeout (miliseconds).
+	int ret;                     //!< Result of the last request.
+	bool started;                //!< Some master has been queried.
+	size_t count;                //!< Number of the masters.
+	size_t cur;                  //!< Currently queried master.
+	conf_remote_t masters[];     //!< Own copies, the preferred master first.
+};
+
+static const knot_layer_api_t REFRESH_ASYNC_API = {
+	.begin = refresh_begin,
+	.produce = refresh_produce,
+	.consume = refresh_consume,
+	.reset = refresh_reset,
+};
+
+/*! \brief Drop the transfer result and the processing state. */
+static void refresh_check_reset(struct refresh_check *check)
+{
+	struct refresh_data *data = &check->data;
+
+	axfr_cleanup(data);
+	ixfr_cleanup(data);
+	knot_rrset_free(&data->initial_soa_copy, data->mm);
+
+	data->state = REFRESH_STATE_INVALID;
+	data->xfr_type = XFR_TYPE_UNDETERMINED;
+	data->change_size = 0;
+	data->updated = false;
+	memset(&data->stats, 0, sizeof(data->stats));
+}
+
+static void refresh_check_free(void *ptr)
+{
+	struct refresh_check *check = ptr;
+	if (check == NULL) {
+		return;
+	}
+
+	refresh_check_reset(check);
+	for (size_t i = 0; i < check->count; i++) {
+		knot_tsig_key_deinit(&check->masters[i].key);
+	}
+	knot_rrset_free(&check->soa, NULL);
+	free(check->edns_data);
+	free(check);
+}
+
+static struct refresh_check *refresh_check_new(conf_t *conf, zone_t *zone)
+{
+	if (zone->requests == NULL) {
+		return NULL;
+	}
+
+	size_t count = 0;
+	conf_val_t masters = conf_zone_get(conf, C_MASTER, zone->name);
+	while (masters.code == KNOT_EOK) {
+		conf_val_t addr = conf_id_get(conf, C_RMT, C_ADDR, &masters);
+		count += conf_val_count(&addr);
+		conf_val_next(&masters);
+	}
+	if (count == 0) {
+		return NULL;
+	}
+
+	struct refresh_check *check = calloc(1, sizeof(*check) +
+	                                     count * sizeof(check->masters[0]));
+	if (check == NULL) {
+		return NULL;
+	}
+
+	// Bootstrap and forced AXFR have no SOA query.
+	if (!zone_contents_is_empty(zone->contents) &&
+	    !(zone->flags & ZONE_FORCE_AXFR)) {
+		knot_rrset_t soa = node_rrset(zone->contents->apex, KNOT_RRTYPE_SOA);
+		check->soa = knot_rrset_copy(&soa, NULL);
+		if (check->soa == NULL) {
+			refresh_check_free(check);
+			return NULL;
+		}
+	}
+	check->data.zone = zone;
+	check->data.soa = check->soa;
+	check->data.max_zone_size = max_zone_size(conf, zone->name);
+	check->data.deferred = true;
+	check->timeout = conf->cache.srv_tcp_reply_timeout * 1000;
+
+	pthread_mutex_lock(&zone->preferred_lock);
+	bool preferred = (zone->preferred_master == NULL);
+	masters = conf_zone_get(conf, C_MASTER, zone->name);
+	while (masters.code == KNOT_EOK) {
+		conf_val_t addr = conf_id_get(conf, C_RMT, C_ADDR, &masters);
+		size_t addr_count = conf_val_count(&addr);
+
+		for (size_t i = 0; i < addr_count; i++) {
+			conf_remote_t master = conf_remote(conf, &masters, i);
+			conf_remote_t *dst = &check->masters[check->count];
+			if (!preferred &&
+			    sockaddr_net_match((struct sockaddr *)&master.addr,
+			                       (struct sockaddr *)zone->preferred_master,
+			                       -1)) {
+				memmove(&check->masters[1], &check->masters[0],
+				        check->count * sizeof(*dst));
+				dst = &check->masters[0];
+				preferred = true;
+			}
+
+			*dst = master;
+			memset(&dst->key, 0, sizeof(dst->key));
+			check->count++;
+			if (master.key.name != NULL &&
+			    knot_tsig_key_copy(&dst->key, &master.key) != KNOT_EOK) {
+				pthread_mutex_unlock(&zone->preferred_lock);
+				refresh_check_free(check);
+				return NULL;
+			}
+		}
+
+		conf_val_next(&masters);
+	}
+	pthread_mutex_unlock(&zone->preferred_lock);
+
+	// TODO: Flag on zone is ugly. Event specific parameters would be nice.
+	zone->flags &= ~ZONE_FORCE_AXFR;
+
+	return check;
+}
+
+static void refresh_check_done(struct knot_request *req, int ret, void *ctx)
+{
+	struct refresh_check *check = ctx;
+
+	check->ret = ret;
+	knot_request_free(req, NULL);
+
+	zone_events_resume(check->data.zone);
+}
+
+static void refresh_check_submit(conf_t *conf, struct refresh_check *check)
+{
+	struct refresh_data *data = &check->data;
+	const conf_remote_t *master = &check->masters[check->cur];
+
+	data->remote = (struct sockaddr *)&master->addr;
+
+	query_edns_data_init(&data->edns, conf, data->zone->name, master->addr.ss_family);
+	if (data->edns.custom_len > 0) {
+		free(check->edns_data);
+		check->edns_data = malloc(data->edns.custom_len);
+		if (check->edns_data == NULL) {
+			data->edns.custom_len = 0;
+		} else {
+			memcpy(check->edns_data, data->edns.custom_data, data->edns.custom_len);
+		}
+		data->edns.custom_data = check->edns_data;
+	}
+
+	zone_events_suspend(data->zone, check, refresh_check_free);
+
+	struct knot_request *req = NULL;
+	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	if (pkt != NULL) {
+		const struct sockaddr *dst = (struct sockaddr *)&master->addr;
+		const struct sockaddr *src = (struct sockaddr *)&master->via;
+		req = knot_request_make(NULL, dst, src, pkt, &master->key, 0);
+		if (req == NULL) {
+			knot_pkt_free(&pkt);
+		}
+	}
+
+	int ret = KNOT_ENOMEM;
+	if (req != NULL) {
+		ret = knot_request_loop_submit(data->zone->requests, &REFRESH_ASYNC_API,
+		                               data, req, check->timeout,
+		                               refresh_check_done, check);
+	}
+	if (ret != KNOT_EOK) {
+		// Completed with the error, the event continues with the next master.
+		refresh_check_done(req, ret, check);
+	}
+}
+
+/*! \brief Finalize and publish the transferred zone, if any. */
+static int refresh_check_finalize(conf_t *conf, struct refresh_data *data)
+{
+	// Only the SOA query if the zone is up-to-date.
+	if (data->state != STATE_TRANSFER) {
+		return KNOT_EOK;
+	}
+
+	data->conf = conf;
+
+	int ret;
+	switch (data->xfr_type) {
+	case XFR_TYPE_IXFR:
+		ret = ixfr_finalize(data);
+		break;
+	case XFR_TYPE_AXFR:
+		ret = axfr_finalize(data);
+		break;
+	default:
+		return KNOT_EOK;
+	}
+	if (ret == KNOT_EOK) {
+		data->updated = true;
+	}
+
+	return ret;
+}
+
+/*!
+ * \brief Evaluate the last request and continue with the next one.
+ *
+ * \return KNOT_EAGAIN if the event is suspended for the next request.
+ */
+static int refresh_check_next(conf_t *conf, zone_t *zone,
+                              struct refresh_check *check, bool *updated)
+{
+	struct refresh_data *data = &check->data;
+
+	if (check->started) {
+		const conf_remote_t *master = &check->masters[check->cur];
+		int ret = check->ret;
+		if (ret == KNOT_EOK) {
+			ret = refresh_check_finalize(conf, data);
+			if (ret == KNOT_EOK) {
+				*updated = data->updated;
+				return KNOT_EOK;
+			}
+		}
+		if (ret == KNOT_ENOTRUNNING) {
+			return ret;
+		}
+
+		// IXFR to AXFR failover
+		if (check->ret == KNOT_EOK && data->xfr_type == XFR_TYPE_IXFR) {
+			REFRESH_LOG(LOG_WARNING, zone->name, data->remote,
+			            "fallback to AXFR");
+			ixfr_cleanup(data);
+			data->xfr_type = XFR_TYPE_AXFR;
+			refresh_check_submit(conf, check);
+			return KNOT_EAGAIN;
+		}
+
+		REFRESH_LOG(LOG_WARNING, zone->name, (struct sockaddr *)&master->addr,
+		            "failed (%s)", knot_strerror(ret));
+		refresh_check_reset(check);
+		check->cur++;
+	}
+
+	if (check->cur >= check->count) {
+		return KNOT_ENOMASTER;
+	}
+
+	check->started = true;
+	refresh_check_submit(conf, check);
+
+	return KNOT_EAGAIN;
+}
+
 static int64_t min_refresh_interval(conf_t *conf, const knot_dname_t *zone)
 {
-	conf_val_t val = conf_zone_get(conf, C_MIN_REFRESH_INTERVAL, zone);
-	return conf_int(&val);
+	return conf_zone(conf, zone).min_refresh_interval;
 }
 
 static int64_t max_refresh_interval(conf_t *conf, const knot_dname_t *zone)
 {
-	conf_val_t val = conf_zone_get(conf, C_MAX_REFRESH_INTERVAL, zone);
-	return conf_int(&val);
+	return conf_zone(conf, zone).max_refresh_interval;
 }
 
 int event_refresh(conf_t *conf, zone_t *zone)
 {
 	assert(zone);
 
+	struct refresh_check *check = zone_events_resumed(zone);
+
 	if (!zone_is_slave(conf, zone)) {
+		refresh_check_free(check);
 		return KNOT_EOK;
 	}
 
+	if (check == NULL) {
+		check = refresh_check_new(conf, zone);
+	}
+
 	bool bootstrap = zone_contents_is_empty(zone->contents);
 	bool updated = false;
 
-	int ret = zone_master_try(conf, zone, try_refresh, &updated, "refresh");
+	int ret;
+	if (check != NULL) {
+		ret = refresh_check_next(conf, zone, check, &updated);
+		if (ret == KNOT_EAGAIN) {
+			// Suspended until the SOA query completes.
+			return KNOT_EOK;
+		}
+		refresh_check_free(check);
+	} else {
+		ret = zone_master_try(conf, zone, try_refresh, &updated, "refresh");
+	}
 	if (ret != KNOT_EOK) {
 		log_zone_error(zone->name, "refresh, failed (%s)", knot_strerror(ret));
 	}
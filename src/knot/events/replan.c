@@ -16,6 +16,7 @@
 
 #include <assert.h>
 
+#include "knot/conf/zones.h"
 #include "knot/events/replan.h"
 
 #define TIME_CANCEL 0
@@ -71,8 +72,7 @@ static void replan_dnssec(conf_t *conf, zone_t *zone)
 	assert(conf);
 	assert(zone);
 
-	conf_val_t val = conf_zone_get(conf, C_DNSSEC_SIGNING, zone->name);
-	if (conf_bool(&val)) {
+	if (conf_zone(conf, zone->name).dnssec_signing) {
 		zone_events_schedule_now(zone, ZONE_EVENT_DNSSEC);
 	}
 }
@@ -92,34 +92,33 @@ void replan_from_timers(conf_t *conf, zone_t *zone)
 
 	time_t now = time(NULL);
 
+	conf_zone_t zconf = conf_zone(conf, zone->name);
+
 	time_t refresh = TIME_CANCEL;
-	if (zone_is_slave(conf, zone)) {
+	if (zconf.is_slave) {
 		refresh = zone->timers.next_refresh;
 		assert(refresh > 0);
 	}
 
 	time_t expire_pre = TIME_IGNORE;
 	time_t expire = TIME_IGNORE;
-	if (zone_is_slave(conf, zone) && can_expire(zone)) {
+	if (zconf.is_slave && can_expire(zone)) {
 		expire_pre = TIME_CANCEL;
 		expire = zone->timers.last_refresh + zone->timers.soa_expire;
 	}
 
 	time_t flush = TIME_IGNORE;
-	if (!zone_is_slave(conf, zone) || can_expire(zone)) {
-		conf_val_t val = conf_zone_get(conf, C_ZONEFILE_SYNC, zone->name);
-		int64_t sync_timeout = conf_int(&val);
-		if (sync_timeout > 0) {
-			flush = zone->timers.last_flush + sync_timeout;
+	if (!zconf.is_slave || can_expire(zone)) {
+		if (zconf.zonefile_sync > 0) {
+			flush = zone->timers.last_flush + zconf.zonefile_sync;
 		}
 	}
 
 	time_t resalt = TIME_CANCEL;
-	conf_val_t val = conf_zone_get(conf, C_DNSSEC_SIGNING, zone->name);
-	if (conf_bool(&val)) {
+	if (zconf.dnssec_signing) {
 		conf_val_t policy = conf_zone_get(conf, C_DNSSEC_POLICY, zone->name);
 		conf_id_fix_default(&policy);
-		val = conf_id_get(conf, C_POLICY, C_NSEC3, &policy);
+		conf_val_t val = conf_id_get(conf, C_POLICY, C_NSEC3, &policy);
 		if (conf_bool(&val)) {
 			if (zone->timers.last_resalt == 0) {
 				resalt = now;
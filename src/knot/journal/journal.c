@@ -20,8 +20,11 @@
 
 #include "knot/journal/journal.h"
 #include "knot/common/log.h"
+#include "knot/conf/zones.h"
 #include "contrib/files.h"
 #include "contrib/endian.h"
+#include "contrib/macros.h"
+#include "contrib/time.h"
 
 /*! \brief Journal version. */
 #define JOURNAL_VERSION	"1.0"
@@ -29,6 +32,8 @@
 #define CHUNK_MAX	(70 * 1024)
 /*! \brief Max number of concurrent DB readers. */
 #define JOURNAL_MAX_READERS 630
+/*! \brief Max number of stores committed in one group. */
+#define JOURNAL_GROUP_MAX 64
 
 /*! \brief Various metadata DB key strings. Also hardcoded in macro txn_commit()! */
 #define MDKEY_GLOBAL_VERSION			"version"
@@ -63,8 +68,7 @@ enum {
 };
 
 static bool journal_flush_allowed(journal_t *j) {
-	conf_val_t val = conf_zone_get(conf(), C_ZONEFILE_SYNC, j->zone);
-	return conf_int(&val) >= 0;
+	return conf_zone(conf(), j->zone).zonefile_sync >= 0;
 }
 
 static bool journal_merge_allowed(journal_t *j) {
@@ -73,14 +77,12 @@ static bool journal_merge_allowed(journal_t *j) {
 
 static size_t journal_max_usage(journal_t *j)
 {
-	conf_val_t val = conf_zone_get(conf(), C_MAX_JOURNAL_USAGE, j->zone);
-	return conf_int(&val);
+	return conf_zone(conf(), j->zone).max_journal_usage;
 }
 
 static size_t journal_max_changesets(journal_t *j)
 {
-	conf_val_t val = conf_zone_get(conf(), C_MAX_JOURNAL_DEPTH, j->zone);
-	return conf_int(&val);
+	return conf_zone(conf(), j->zone).max_journal_depth;
 }
 
 static float journal_tofree_factor(journal_t *j)
@@ -124,6 +126,7 @@ typedef struct {
 	bool opened;
 
 	bool is_rw;
+	bool grouped; // The DB transaction is committed by the group leader.
 
 	knot_db_iter_t *iter;
 
@@ -264,8 +267,10 @@ static void txn_begin(txn_t *txn, bool write_allowed)
 		return;
 	}
 
-	txn->ret = txn->j->db->db_api->txn_begin(txn->j->db->db, txn->txn,
-	                                         (write_allowed ? 0 : KNOT_DB_RDONLY));
+	if (!txn->grouped) {
+		txn->ret = txn->j->db->db_api->txn_begin(txn->j->db->db, txn->txn,
+		                                         (write_allowed ? 0 : KNOT_DB_RDONLY));
+	}
 
 	txn->is_rw = write_allowed;
 	txn->opened = true;
@@ -365,7 +370,9 @@ static void txn_abort(txn_t *txn)
 {
 	if (txn->opened) {
 		txn_iter_finish(txn);
-		txn->j->db->db_api->txn_abort(txn->txn);
+		if (!txn->grouped) {
+			txn->j->db->db_api->txn_abort(txn->txn);
+		}
 		txn->opened = false;
 	}
 }
@@ -389,6 +396,10 @@ static void txn_commit(txn_t *txn)
 	}
 
 	txn_iter_finish(txn);
+	if (txn->grouped) {
+		txn->opened = false;
+		return;
+	}
 	txn->ret = txn->j->db->db_api->txn_commit(txn->txn);
 
 	if (txn->ret == KNOT_EOK) {
@@ -880,6 +891,181 @@ int journal_load_changesets(journal_t *j, list_t *dst, uint32_t from)
 	return txn->ret;
 }
 
+struct journal_read {
+	txn_t txn;
+	knot_db_txn_t db_txn;
+	uint32_t serial;     // Serial_from of the current changeset.
+	uint32_t serial_to;  // Serial_to of the current changeset.
+	uint32_t last;       // Serial_from of the last changeset.
+	bool merged;         // The current changeset is the merged one.
+	int chunk_index;     // Index of the current chunk.
+	int chunk_count;     // # of chunks of the current changeset.
+	wire_ctx_t wire;     // Unread part of the current chunk.
+	size_t offset;       // Read part of the current chunk while paused.
+};
+
+/*! \brief Find the current chunk, its data are valid until the txn ends. */
+static void read_chunk(journal_read_t *ctx)
+{
+	txn_t *txn = &ctx->txn;
+
+	txn_key_2u32(txn, txn->j->zone, ctx->serial, ctx->chunk_index);
+	txn_find_force(txn);
+	if (txn->ret != KNOT_EOK) {
+		return;
+	}
+	if (txn->val.len < JOURNAL_HEADER_SIZE) {
+		txn->ret = KNOT_EMALF;
+		return;
+	}
+
+	size_t header_size;
+	unmake_header(&txn->val, &ctx->serial_to, &ctx->chunk_count, &header_size);
+	ctx->wire = wire_ctx_init_const(txn->val.data + header_size,
+	                                txn->val.len - header_size);
+}
+
+/*! \brief Move to the next changeset, the merged one is followed regardless of the last serial. */
+static bool read_next_changeset(journal_read_t *ctx)
+{
+	if (!ctx->merged && serial_equal(ctx->serial, ctx->last)) {
+		return false;
+	}
+
+	ctx->serial = ctx->serial_to;
+	ctx->chunk_index = 0;
+	ctx->merged = false;
+	read_chunk(ctx);
+
+	return true;
+}
+
+/*! \brief Reopen the txn and find the paused position, the changeset must not change. */
+static void read_resume(journal_read_t *ctx)
+{
+	txn_t *txn = &ctx->txn;
+
+	txn_begin(txn, false);
+
+	uint32_t serial_to = ctx->serial_to;
+	int chunk_count = ctx->chunk_count;
+	read_chunk(ctx);
+	if (txn->ret != KNOT_EOK) {
+		return;
+	}
+	if (!serial_equal(serial_to, ctx->serial_to) || chunk_count != ctx->chunk_count) {
+		txn->ret = KNOT_ENOENT;
+		return;
+	}
+
+	wire_ctx_skip(&ctx->wire, ctx->offset);
+	txn->ret = ctx->wire.error;
+}
+
+int journal_read_begin(journal_t *j, uint32_t from, journal_read_t **ctx)
+{
+	if (j == NULL || j->db == NULL || ctx == NULL) return KNOT_EINVAL;
+
+	journal_read_t *r = calloc(1, sizeof(*r));
+	if (r == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	txn_init(&r->txn, &r->db_txn, j);
+	txn_begin(&r->txn, false);
+
+	r->serial = from;
+	r->last = r->txn.shadow_md.last_serial;
+	r->merged = md_flag(&r->txn, MERGED_SERIAL_VALID) &&
+	            serial_equal(r->txn.shadow_md.merged_serial, from);
+	read_chunk(r);
+
+	int ret = r->txn.ret;
+	if (ret != KNOT_EOK) {
+		journal_read_end(r);
+		return ret;
+	}
+
+	*ctx = r;
+	return KNOT_EOK;
+}
+
+int journal_read_rrset(journal_read_t *ctx, knot_rrset_t *rr)
+{
+	if (ctx == NULL || rr == NULL) return KNOT_EINVAL;
+
+	txn_t *txn = &ctx->txn;
+	if (!txn->opened && txn->ret == KNOT_EOK) {
+		read_resume(ctx);
+	}
+	txn_check_ret(txn);
+
+	knot_rrset_init_empty(rr);
+
+	// Skip to the next changeset if the current one is read.
+	while (wire_ctx_available(&ctx->wire) == 0) {
+		if (ctx->chunk_index < ctx->chunk_count - 1) {
+			ctx->chunk_index++;
+			read_chunk(ctx);
+		} else if (!read_next_changeset(ctx)) {
+			return KNOT_EOK;
+		}
+		txn_check_ret(txn);
+	}
+	bool changeset_begin = (ctx->chunk_index == 0 && wire_ctx_offset(&ctx->wire) == 0);
+
+	// The RR set may continue in the following chunks of the changeset.
+	knot_rrset_t rrset;
+	knot_rrset_init_empty(&rrset);
+	long phase = SERIALIZE_RRSET_INIT;
+	while (true) {
+		txn->ret = changeset_deserialize_rrset(&ctx->wire, &rrset, &phase);
+		if (txn->ret != KNOT_EOK || phase == SERIALIZE_RRSET_DONE) {
+			break;
+		}
+		if (ctx->chunk_index >= ctx->chunk_count - 1) {
+			txn->ret = KNOT_EMALF;
+			break;
+		}
+		ctx->chunk_index++;
+		read_chunk(ctx);
+		if (txn->ret != KNOT_EOK) {
+			break;
+		}
+	}
+
+	if (txn->ret == KNOT_EOK && changeset_begin && rrset.type != KNOT_RRTYPE_SOA) {
+		txn->ret = KNOT_EMALF;
+	}
+	if (txn->ret != KNOT_EOK) {
+		knot_rrset_clear(&rrset, NULL);
+		return txn->ret;
+	}
+
+	*rr = rrset;
+	return KNOT_EOK;
+}
+
+void journal_read_pause(journal_read_t *ctx)
+{
+	if (ctx == NULL || !ctx->txn.opened) {
+		return;
+	}
+
+	ctx->offset = wire_ctx_offset(&ctx->wire);
+	txn_abort(&ctx->txn);
+}
+
+void journal_read_end(journal_read_t *ctx)
+{
+	if (ctx == NULL) {
+		return;
+	}
+
+	txn_abort(&ctx->txn);
+	free(ctx);
+}
+
 int load_bootstrap_iterkeycb(iteration_ctx_t *ctx)
 {
 	txn_key_str_u32(ctx->txn, ctx->txn->j->zone, KEY_BOOTSTRAP_CHANGESET, ctx->chunk_index);
@@ -1253,7 +1439,13 @@ m_u_ch_end:
 		} \
 	}
 
-static int store_changesets(journal_t *j, list_t *changesets)
+/*!
+ * \brief Store changesets in a new DB transaction, or in the group one.
+ *
+ * In the group transaction, nothing is committed before all the stores of
+ * the group succeed. Oversized stores fail with KNOT_ELIMIT there.
+ */
+static int store_changesets(journal_t *j, knot_db_txn_t *group_txn, list_t *changesets)
 {
 	// PART 1 : initializers, compute serialized_sizes, transaction start
 	changeset_t *ch;
@@ -1270,7 +1462,7 @@ static int store_changesets(journal_t *j, list_t *changesets)
 	bool merged_into_bootstrap = false;
 	bool inserting_bootstrap = false;
 
-	size_t occupied_last, occupied_now = knot_db_lmdb_get_usage(j->db->db);
+	size_t occupied_last, occupied_now = 0;
 
 	WALK_LIST(ch, *changesets) {
 		nchs++;
@@ -1281,8 +1473,17 @@ static int store_changesets(journal_t *j, list_t *changesets)
 	}
 
 	local_txn_t(txn, j);
+	if (group_txn != NULL) {
+		txn->txn = group_txn;
+		txn->grouped = true;
+	}
 	txn_begin(txn, true);
 
+	// Measured in the transaction to see the previous stores of the group.
+	if (txn->ret == KNOT_EOK) {
+		occupied_now = knot_db_lmdb_get_usage_txn(txn->txn);
+	}
+
 	bool zone_in_journal = has_bootstrap_changeset(j, txn);
 	bool merge_allowed = journal_merge_allowed(j);
 
@@ -1448,6 +1649,10 @@ static int store_changesets(journal_t *j, list_t *changesets)
 			txn_insert(txn);
 			inserted_size += (vals+i)->len;
 			if ((float)inserted_size > journal_max_txn(j) * (float)j->db->fslimit) { // insert txn too large
+				if (txn->grouped) {
+					txn->ret = KNOT_ELIMIT;
+					break;
+				}
 				inserted_size = 0;
 				txn->shadow_md.dirty_serial = serial;
 				txn->shadow_md.flags |= DIRTY_SERIAL_VALID;
@@ -1499,7 +1704,7 @@ store_changeset_cleanup:
 
 	txn_commit(txn);
 
-	if (txn->ret != KNOT_EOK) {
+	if (txn->ret != KNOT_EOK && !txn->grouped) {
 		local_txn_t(ddtxn, j);
 		txn_begin(ddtxn, true);
 		if (md_flag(ddtxn, DIRTY_SERIAL_VALID)) {
@@ -1525,6 +1730,125 @@ store_changeset_cleanup:
 }
 #undef try_flush
 
+typedef struct {
+	node_t n;
+	journal_t *j;
+	list_t *changesets;
+	int ret;
+	bool done;
+} group_req_t;
+
+/*!
+ * \brief Commit the stores in one DB transaction.
+ *
+ * If any of the stores fails (e.g. the journal is full or the transaction
+ * would be too large), each store is repeated alone to get its own result.
+ */
+static void commit_group(journal_db_t *db, list_t *batch)
+{
+	group_req_t *req;
+
+	knot_db_txn_t db_txn;
+	int ret = db->db_api->txn_begin(db->db, &db_txn, 0);
+	if (ret == KNOT_EOK) {
+		WALK_LIST(req, *batch) {
+			ret = store_changesets(req->j, &db_txn, req->changesets);
+			if (ret != KNOT_EOK) {
+				break;
+			}
+		}
+		if (ret == KNOT_EOK) {
+			ret = db->db_api->txn_commit(&db_txn);
+		} else {
+			db->db_api->txn_abort(&db_txn);
+		}
+	}
+
+	WALK_LIST(req, *batch) {
+		req->ret = (ret == KNOT_EOK) ? KNOT_EOK :
+		           store_changesets(req->j, NULL, req->changesets);
+	}
+}
+
+/*!
+ * \brief Store changesets, possibly together with concurrent stores.
+ *
+ * The caller queues its request. If no group is being committed, it takes
+ * the queued requests and commits them, otherwise it waits until some
+ * other caller commits its request.
+ */
+static int store_changesets_grouped(journal_t *j, list_t *changesets)
+{
+	journal_group_t *group = &j->db->group;
+
+	group_req_t req = {
+		.j = j,
+		.changesets = changesets,
+		.ret = KNOT_EOK,
+		.done = false,
+	};
+
+	struct timespec begin = time_now();
+
+	pthread_mutex_lock(&group->mutex);
+	add_tail(&group->queue, &req.n);
+	while (!req.done) {
+		if (group->leader) {
+			pthread_cond_wait(&group->cond, &group->mutex);
+			continue;
+		}
+
+		list_t batch;
+		init_list(&batch);
+		size_t batch_size = 0;
+		group_req_t *it, *nxt;
+		WALK_LIST_DELSAFE(it, nxt, group->queue) {
+			if (batch_size == JOURNAL_GROUP_MAX) {
+				break;
+			}
+			rem_node(&it->n);
+			add_tail(&batch, &it->n);
+			batch_size++;
+		}
+		group->leader = true;
+		pthread_mutex_unlock(&group->mutex);
+
+		if (batch_size == 1) {
+			it = HEAD(batch);
+			it->ret = store_changesets(it->j, NULL, it->changesets);
+		} else {
+			commit_group(j->db, &batch);
+		}
+
+		pthread_mutex_lock(&group->mutex);
+		WALK_LIST(it, batch) {
+			it->done = true;
+		}
+		group->leader = false;
+		group->stats.commits++;
+		group->stats.stores += batch_size;
+		group->stats.max_batch = MAX(group->stats.max_batch, batch_size);
+		pthread_cond_broadcast(&group->cond);
+	}
+
+	struct timespec end = time_now();
+	group->stats.wait_usec += time_diff_ms(&begin, &end) * 1000;
+	pthread_mutex_unlock(&group->mutex);
+
+	return req.ret;
+}
+
+void journal_db_group_stats(journal_db_t *db, journal_group_stats_t *stats)
+{
+	if (db == NULL || stats == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&db->group.mutex);
+	*stats = db->group.stats;
+	pthread_mutex_unlock(&db->group.mutex);
+}
+
 int journal_store_changeset(journal_t *journal, changeset_t *ch)
 {
 	if (journal == NULL || journal->db == NULL || ch == NULL) return KNOT_EINVAL;
@@ -1538,7 +1862,7 @@ int journal_store_changeset(journal_t *journal, changeset_t *ch)
 	list_t list;
 	init_list(&list);
 	add_tail(&list, &ch_shallowcopy->n);
-	int ret = store_changesets(journal, &list);
+	int ret = store_changesets_grouped(journal, &list);
 
 	free(ch_shallowcopy);
 	return ret;
@@ -1547,7 +1871,7 @@ int journal_store_changeset(journal_t *journal, changeset_t *ch)
 int journal_store_changesets(journal_t *journal, list_t *src)
 {
 	if (journal == NULL || journal->db == NULL || src == NULL) return KNOT_EINVAL;
-	return store_changesets(journal, src);
+	return store_changesets_grouped(journal, src);
 }
 
 /*
@@ -1667,6 +1991,9 @@ int journal_db_init(journal_db_t **db, const char *lmdb_dir_path, size_t lmdb_fs
 	};
 	memcpy(*db, &dbinit, sizeof(journal_db_t));
 	pthread_mutex_init(&(*db)->db_mutex, NULL);
+	pthread_mutex_init(&(*db)->group.mutex, NULL);
+	pthread_cond_init(&(*db)->group.cond, NULL);
+	init_list(&(*db)->group.queue);
 	return KNOT_EOK;
 }
 
@@ -1675,6 +2002,8 @@ static void destroy_journal_db(journal_db_t **db)
 	assert((*db)->db == NULL);
 
 	pthread_mutex_destroy(&(*db)->db_mutex);
+	pthread_mutex_destroy(&(*db)->group.mutex);
+	pthread_cond_destroy(&(*db)->group.cond);
 	free((*db)->path);
 	free((*db));
 	*db = NULL;
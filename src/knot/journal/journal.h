@@ -32,6 +32,28 @@ typedef enum {
 	JOURNAL_MODE_ASYNC  = 1, // Asynchronous journal DB disk synchronization.
 } journal_mode_t;
 
+/*! \brief Group commit statistics. */
+typedef struct {
+	uint64_t commits;   // Number of committed groups of stores.
+	uint64_t stores;    // Number of stores committed in groups.
+	uint64_t max_batch; // Largest number of stores committed at once.
+	uint64_t wait_usec; // Total time the stores waited for their commit.
+} journal_group_stats_t;
+
+/*!
+ * \brief Group commit of concurrent changeset stores.
+ *
+ * Stores requested while another group is being committed are queued and
+ * then committed (and synced) in one DB transaction by one of the callers.
+ */
+typedef struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	list_t queue;                // Pending store requests.
+	bool leader;                 // A group is being committed.
+	journal_group_stats_t stats;
+} journal_group_t;
+
 typedef struct {
 	knot_db_t *db;
 	const knot_db_api_t *db_api;
@@ -39,6 +61,7 @@ typedef struct {
 	size_t fslimit;
 	journal_mode_t mode;
 	pthread_mutex_t db_mutex; // please delete this once you move DB opening from journal_open to db_init
+	journal_group_t group;
 } journal_db_t;
 
 typedef struct {
@@ -46,6 +69,9 @@ typedef struct {
 	knot_dname_t *zone;
 } journal_t;
 
+/*! \brief Sequential reader of the journal changesets. */
+typedef struct journal_read journal_read_t;
+
 typedef enum {
 	JOURNAL_CHECK_SILENT = 0, // No logging, just curious for return value.
 	JOURNAL_CHECK_WARN   = 1, // Log journal inconsistencies.
@@ -73,6 +99,14 @@ int journal_db_init(journal_db_t **db, const char *lmdb_dir_path, size_t lmdb_fs
  */
 void journal_db_close(journal_db_t **db);
 
+/*!
+ * \brief Get the group commit statistics of the journal DB.
+ *
+ * \param db     Shared journal DB.
+ * \param stats  Output statistics.
+ */
+void journal_db_group_stats(journal_db_t *db, journal_group_stats_t *stats);
+
 /*!
  * \brief List the zones contained in journal DB.
  *
@@ -146,9 +180,62 @@ int journal_load_changesets(journal_t *journal, list_t *dst, uint32_t from);
  */
 int journal_load_bootstrap(journal_t *journal, list_t *dst);
 
+/*!
+ * \brief Start reading changesets from journal since "from" serial.
+ *
+ * The changesets are read directly from the DB in a read-only transaction,
+ * which is kept open until journal_read_pause() or journal_read_end() is called.
+ *
+ * \param journal  Journal to read from.
+ * \param from     Start serial.
+ * \param ctx      Output reader context.
+ *
+ * \retval KNOT_EOK on success.
+ * \retval KNOT_ENOENT when the lookup of the first entry fails.
+ * \return < KNOT_EOK on other error.
+ */
+int journal_read_begin(journal_t *journal, uint32_t from, journal_read_t **ctx);
+
+/*!
+ * \brief Read next RR set of the changesets.
+ *
+ * The RR sets of each changeset are read in the IXFR order: SOA from, removals,
+ * SOA to, additions.
+ *
+ * \param ctx  Reader context.
+ * \param rr   Output RR set, to be cleared by the caller. Empty after the last
+ *             changeset.
+ *
+ * \retval KNOT_EOK on success.
+ * \return < KNOT_EOK on error.
+ */
+int journal_read_rrset(journal_read_t *ctx, knot_rrset_t *rr);
+
+/*!
+ * \brief Close the read-only transaction, keep the reading position.
+ *
+ * The next journal_read_rrset() opens a new transaction and continues from
+ * the same position. It fails with KNOT_ENOENT if the changeset being read
+ * has been deleted or replaced meanwhile.
+ *
+ * \param ctx  Reader context.
+ */
+void journal_read_pause(journal_read_t *ctx);
+
+/*!
+ * \brief Finish reading the changesets and free the reader context.
+ *
+ * \param ctx  Reader context.
+ */
+void journal_read_end(journal_read_t *ctx);
+
 /*!
  * \brief Store changesets in journal.
  *
+ * Concurrent stores into the same journal DB are committed in groups. The
+ * function returns after the changesets are committed (and synced in the
+ * robust mode).
+ *
  * \param journal  Journal to store in.
  * \param src      Changesets to store.
  *
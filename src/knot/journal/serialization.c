@@ -20,9 +20,6 @@
 #include "libknot/libknot.h"
 #include "contrib/wire_ctx.h"
 
-#define SERIALIZE_RRSET_INIT (-1)
-#define SERIALIZE_RRSET_DONE ((1L<<16)+1)
-
 static int serialize_rrset(wire_ctx_t *wire, const knot_rrset_t *rrset, long *phase)
 {
 	assert(wire != NULL && rrset != NULL && phase != NULL);
@@ -103,6 +100,15 @@ static int deserialize_rrset(wire_ctx_t *wire, knot_rrset_t *rrset, long *phase)
 	return KNOT_EOK;
 }
 
+int changeset_deserialize_rrset(wire_ctx_t *wire, knot_rrset_t *rrset, long *phase)
+{
+	if (wire == NULL || rrset == NULL || phase == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	return deserialize_rrset(wire, rrset, phase);
+}
+
 static int serialize_rrset_chunks(wire_ctx_t *wire, const knot_rrset_t *rrset,
                                   uint8_t *dst_chunks[], size_t chunk_size,
                                   size_t chunks_count, size_t *chunks_real_sizes,
@@ -19,6 +19,11 @@
 #include <stdint.h>
 #include "libknot/rrset.h"
 #include "knot/updates/changesets.h"
+#include "contrib/wire_ctx.h"
+
+/*! \brief Phases of a partial RR set (de)serialization. */
+#define SERIALIZE_RRSET_INIT (-1)
+#define SERIALIZE_RRSET_DONE ((1L<<16)+1)
 
 /*!
  * \brief Returns size of changeset in serialized form.
@@ -75,3 +80,17 @@ int changeset_deserialize(changeset_t *ch, uint8_t *src_chunks[],
  */
 int changeset_deserialize_bootstrap(changeset_t *ch, uint8_t *src_chunks[],
                                     const size_t *chunks_sizes, size_t chunks_count);
+
+/*!
+ * \brief Deserializes one RR set, or its part, from a chunk.
+ *
+ * If the RR set continues in the next chunk, call this function again with
+ * the next chunk until the phase is SERIALIZE_RRSET_DONE.
+ *
+ * \param[in]     wire   The chunk to deserialize from.
+ * \param[out]    rrset  The RR set, to be cleared by the caller.
+ * \param[in,out] phase  Deserialization phase, start with SERIALIZE_RRSET_INIT.
+ *
+ * \retval KNOT_E*
+ */
+int changeset_deserialize_rrset(wire_ctx_t *wire, knot_rrset_t *rrset, long *phase);
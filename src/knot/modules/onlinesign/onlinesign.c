@@ -15,13 +15,16 @@
 */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <string.h>
 
+#include "contrib/macros.h"
 #include "contrib/string.h"
 #include "dnssec/error.h"
 #include "knot/include/module.h"
 #include "knot/modules/onlinesign/nsec_next.h"
+#include "knot/modules/onlinesign/sign_cache.h"
 // Next dependencies force static module!
 #include "knot/dnssec/key-events.h"
 #include "knot/dnssec/rrset-sign.h"
@@ -49,6 +52,16 @@ const yp_item_t online_sign_conf[] = {
 
 #define RRSIG_LIFETIME (25*60*60)
 
+/*! \brief Number of cached RRSIGs and NSECs for each query processing thread. */
+#define CACHE_SLOTS 1024
+
+/*!
+ * \brief Cached records are used for this fraction of the RRSIG lifetime.
+ *
+ * The served signatures remain valid for most of their lifetime.
+ */
+#define CACHE_LIFETIME_DIV 10
+
 /*
  * TODO:
  *
@@ -84,9 +97,25 @@ static const uint16_t NSEC_FORCE_TYPES[] = {
 	0
 };
 
+/*!
+ * \brief Signing state of one query processing thread.
+ *
+ * The state is shared and the lock is contended only if there are more
+ * threads than shards.
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	dnssec_sign_ctx_t *sign_ctx;
+	sign_cache_t *rrsigs;  //!< RRSIGs by covered RR set.
+	sign_cache_t *nsecs;   //!< Synthesized NSECs by QNAME and QTYPE.
+} online_sign_shard_t;
+
 typedef struct {
 	dnssec_key_t *key;
+	uint16_t key_tag;
 	uint32_t rrsig_lifetime;
+	size_t shard_count;
+	online_sign_shard_t *shards;
 } online_sign_ctx_t;
 
 static bool want_dnssec(knotd_qdata_t *qdata)
@@ -193,7 +222,25 @@ static dnssec_nsec_bitmap_t *synth_bitmap(knot_pkt_t *pkt, const knotd_qdata_t *
 	return map;
 }
 
-static knot_rrset_t *synth_nsec(knot_pkt_t *pkt, knotd_qdata_t *qdata, knot_mm_t *mm)
+static online_sign_shard_t *shard_lock(online_sign_ctx_t *ctx, knotd_qdata_t *qdata)
+{
+	online_sign_shard_t *shard = &ctx->shards[qdata->params->thread_id % ctx->shard_count];
+	pthread_mutex_lock(&shard->lock);
+	return shard;
+}
+
+static void shard_unlock(online_sign_shard_t *shard)
+{
+	pthread_mutex_unlock(&shard->lock);
+}
+
+static uint32_t cache_expires(online_sign_ctx_t *ctx, uint32_t now)
+{
+	return now + ctx->rrsig_lifetime / CACHE_LIFETIME_DIV;
+}
+
+static knot_rrset_t *synth_nsec(knot_pkt_t *pkt, knotd_qdata_t *qdata,
+                                online_sign_ctx_t *module_ctx, knot_mm_t *mm)
 {
 	knot_rrset_t *nsec = knot_rrset_new(qdata->name, KNOT_RRTYPE_NSEC,
 	                                    KNOT_CLASS_IN, mm);
@@ -201,6 +248,27 @@ static knot_rrset_t *synth_nsec(knot_pkt_t *pkt, knotd_qdata_t *qdata, knot_mm_t
 		return NULL;
 	}
 
+	// The bitmap of ANY depends on the response, otherwise on the zone only.
+
+	uint16_t qtype = knot_pkt_qtype(qdata->query);
+	knot_rrset_t soa = knotd_qdata_zone_apex_rrset(qdata, KNOT_RRTYPE_SOA);
+	sign_cache_key_t key = {
+		.owner = qdata->name,
+		.type = qtype,
+		.tag = knot_soa_serial(&soa.rrs)
+	};
+	uint32_t now = time(NULL);
+
+	if (qtype != KNOT_RRTYPE_ANY) {
+		online_sign_shard_t *shard = shard_lock(module_ctx, qdata);
+		const knot_rdataset_t *cached = sign_cache_get(shard->nsecs, &key, now);
+		int r = (cached != NULL) ? knot_rdataset_copy(&nsec->rrs, cached, mm) : KNOT_ENOENT;
+		shard_unlock(shard);
+		if (r == KNOT_EOK) {
+			return nsec;
+		}
+	}
+
 	knot_dname_t *next = online_nsec_next(qdata->name, knotd_qdata_zone_name(qdata));
 	if (!next) {
 		knot_rrset_free(&nsec, mm);
@@ -230,32 +298,60 @@ static knot_rrset_t *synth_nsec(knot_pkt_t *pkt, knotd_qdata_t *qdata, knot_mm_t
 		return NULL;
 	}
 
+	if (qtype != KNOT_RRTYPE_ANY) {
+		online_sign_shard_t *shard = shard_lock(module_ctx, qdata);
+		(void)sign_cache_put(shard->nsecs, &key, &nsec->rrs,
+		                     cache_expires(module_ctx, now));
+		shard_unlock(shard);
+	}
+
 	return nsec;
 }
 
 static knot_rrset_t *sign_rrset(const knot_dname_t *owner,
                                 const knot_rrset_t *cover,
                                 online_sign_ctx_t *module_ctx,
-                                dnssec_sign_ctx_t *sign_ctx,
+                                online_sign_shard_t *shard,
+                                uint32_t now,
                                 knot_mm_t *mm)
 {
+	// resulting RRSIG
+
+	knot_rrset_t *rrsig = knot_rrset_new(owner, KNOT_RRTYPE_RRSIG, cover->rclass, mm);
+	if (!rrsig) {
+		return NULL;
+	}
+
+	// previously computed signature
+
+	sign_cache_key_t key = {
+		.owner = owner,
+		.type = cover->type,
+		.tag = module_ctx->key_tag,
+		.data = cover->rrs.data,
+		.data_len = knot_rdataset_size(&cover->rrs)
+	};
+
+	const knot_rdataset_t *cached = sign_cache_get(shard->rrsigs, &key, now);
+	if (cached) {
+		if (knot_rdataset_copy(&rrsig->rrs, cached, mm) != KNOT_EOK) {
+			knot_rrset_free(&rrsig, mm);
+			return NULL;
+		}
+		return rrsig;
+	}
+
 	// copy of RR set with replaced owner name
 
 	knot_rrset_t *copy = knot_rrset_new(owner, cover->type, cover->rclass, NULL);
 	if (!copy) {
+		knot_rrset_free(&rrsig, mm);
 		return NULL;
 	}
 
 	if (knot_rdataset_copy(&copy->rrs, &cover->rrs, NULL) != KNOT_EOK) {
 		knot_rrset_free(&copy, NULL);
-		return NULL;
-	}
-
-	// resulting RRSIG
-
-	knot_rrset_t *rrsig = knot_rrset_new(owner, KNOT_RRTYPE_RRSIG, copy->rclass, mm);
-	if (!rrsig) {
-		knot_rrset_free(&copy, NULL);
+		knot_rrset_free(&rrsig, mm);
 		return NULL;
 	}
 
@@ -266,11 +362,12 @@ static knot_rrset_t *sign_rrset(const knot_dname_t *owner,
 	};
 
 	kdnssec_ctx_t ksign_ctx = {
-		.now = time(NULL),
+		.now = now,
 		.policy = &policy
 	};
 
-	int r = knot_sign_rrset(rrsig, copy, module_ctx->key, sign_ctx, &ksign_ctx, mm);
+	int r = knot_sign_rrset(rrsig, copy, module_ctx->key, shard->sign_ctx,
+	                        &ksign_ctx, mm);
 
 	knot_rrset_free(&copy, NULL);
 
@@ -279,6 +376,9 @@ static knot_rrset_t *sign_rrset(const knot_dname_t *owner,
 		return NULL;
 	}
 
+	(void)sign_cache_put(shard->rrsigs, &key, &rrsig->rrs,
+	                     cache_expires(module_ctx, now));
+
 	return rrsig;
 }
 
@@ -291,11 +391,8 @@ static knotd_in_state_t sign_section(knotd_in_state_t state, knot_pkt_t *pkt,
 		return state;
 	}
 
-	dnssec_sign_ctx_t *sign_ctx = NULL;
-	int r = dnssec_sign_new(&sign_ctx, module_ctx->key);
-	if (r != DNSSEC_EOK) {
-		return KNOTD_IN_STATE_ERROR;
-	}
+	online_sign_shard_t *shard = shard_lock(module_ctx, qdata);
+	uint32_t now = time(NULL);
 
 	const knot_pktsection_t *section = knot_pkt_section(pkt, pkt->current);
 	assert(section);
@@ -309,13 +406,13 @@ static knotd_in_state_t sign_section(knotd_in_state_t state, knot_pkt_t *pkt,
 		knot_dname_unpack(owner, pkt->wire + rr_pos, sizeof(owner), pkt->wire);
 		knot_dname_to_lower(owner);
 
-		knot_rrset_t *rrsig = sign_rrset(owner, rr, module_ctx, sign_ctx, &pkt->mm);
+		knot_rrset_t *rrsig = sign_rrset(owner, rr, module_ctx, shard, now, &pkt->mm);
 		if (!rrsig) {
 			state = KNOTD_IN_STATE_ERROR;
 			break;
 		}
 
-		r = knot_pkt_put(pkt, KNOT_COMPR_HINT_NONE, rrsig, KNOT_PF_FREE);
+		int r = knot_pkt_put(pkt, KNOT_COMPR_HINT_NONE, rrsig, KNOT_PF_FREE);
 		if (r != KNOT_EOK) {
 			knot_rrset_free(&rrsig, &pkt->mm);
 			state = KNOTD_IN_STATE_ERROR;
@@ -323,7 +420,7 @@ static knotd_in_state_t sign_section(knotd_in_state_t state, knot_pkt_t *pkt,
 		}
 	}
 
-	dnssec_sign_free(sign_ctx);
+	shard_unlock(shard);
 
 	return state;
 }
@@ -338,7 +435,7 @@ static knotd_in_state_t synth_authority(knotd_in_state_t state, knot_pkt_t *pkt,
 	// synthesise NSEC
 
 	if (want_dnssec(qdata)) {
-		knot_rrset_t *nsec = synth_nsec(pkt, qdata, &pkt->mm);
+		knot_rrset_t *nsec = synth_nsec(pkt, qdata, knotd_mod_ctx(mod), &pkt->mm);
 		int r = knot_pkt_put(pkt, KNOT_COMPR_HINT_NONE, nsec, KNOT_PF_FREE);
 		if (r != DNSSEC_EOK) {
 			knot_rrset_free(&nsec, &pkt->mm);
@@ -422,7 +519,7 @@ static knotd_in_state_t synth_answer(knotd_in_state_t state, knot_pkt_t *pkt,
 	}
 
 	if (qtype_match(qdata, KNOT_RRTYPE_NSEC)) {
-		knot_rrset_t *nsec = synth_nsec(pkt, qdata, &pkt->mm);
+		knot_rrset_t *nsec = synth_nsec(pkt, qdata, ctx, &pkt->mm);
 		if (!nsec) {
 			return KNOTD_IN_STATE_ERROR;
 		}
@@ -482,8 +579,60 @@ fail:
 	return r;
 }
 
+static void online_sign_shards_free(online_sign_ctx_t *ctx)
+{
+	if (ctx->shards == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < ctx->shard_count; i++) {
+		online_sign_shard_t *shard = &ctx->shards[i];
+		pthread_mutex_destroy(&shard->lock);
+		dnssec_sign_free(shard->sign_ctx);
+		sign_cache_free(shard->rrsigs);
+		sign_cache_free(shard->nsecs);
+	}
+
+	free(ctx->shards);
+}
+
+static int online_sign_shards_init(online_sign_ctx_t *ctx, knotd_mod_t *mod)
+{
+	knotd_conf_t udp = knotd_conf_env(mod, KNOTD_CONF_ENV_WORKERS_UDP);
+	knotd_conf_t tcp = knotd_conf_env(mod, KNOTD_CONF_ENV_WORKERS_TCP);
+	size_t count = MAX(udp.single.integer + tcp.single.integer, 1);
+
+	ctx->shards = calloc(count, sizeof(*ctx->shards));
+	if (!ctx->shards) {
+		return KNOT_ENOMEM;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		online_sign_shard_t *shard = &ctx->shards[i];
+		if (pthread_mutex_init(&shard->lock, NULL) != 0) {
+			return KNOT_ENOMEM;
+		}
+		ctx->shard_count = i + 1;
+
+		int r = dnssec_sign_new(&shard->sign_ctx, ctx->key);
+		if (r != DNSSEC_EOK) {
+			return r;
+		}
+
+		shard->rrsigs = sign_cache_new(CACHE_SLOTS);
+		shard->nsecs = sign_cache_new(CACHE_SLOTS);
+		if (!shard->rrsigs || !shard->nsecs) {
+			return KNOT_ENOMEM;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
 static void online_sign_ctx_free(online_sign_ctx_t *ctx)
 {
+	online_sign_shards_free(ctx);
+
 	dnssec_key_free(ctx->key);
 
 	free(ctx);
@@ -502,6 +651,14 @@ static int online_sign_ctx_new(online_sign_ctx_t **ctx_ptr, knotd_mod_t *mod)
 		return r;
 	}
 
+	ctx->key_tag = dnssec_key_get_keytag(ctx->key);
+
+	r = online_sign_shards_init(ctx, mod);
+	if (r != KNOT_EOK) {
+		online_sign_ctx_free(ctx);
+		return r;
+	}
+
 	ctx->rrsig_lifetime = RRSIG_LIFETIME;
 	knotd_conf_t policy = knotd_conf_mod(mod, MOD_POLICY);
 	if (policy.count != 0) {
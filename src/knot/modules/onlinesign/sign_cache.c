@@ -0,0 +1,154 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "knot/modules/onlinesign/sign_cache.h"
+#include "contrib/murmurhash3/murmurhash3.h"
+#include "libknot/errcode.h"
+
+typedef struct {
+	uint32_t hash;
+	uint32_t expires;
+	uint16_t type;
+	uint32_t tag;
+	size_t data_len;
+	uint8_t *data;         /*!< Additional key data, after the owner. */
+	knot_rdataset_t rrs;   /*!< Cached record data. */
+	knot_dname_t owner[];
+} cache_entry_t;
+
+struct sign_cache {
+	size_t slots;
+	cache_entry_t *entries[];
+};
+
+static uint32_t key_hash(const sign_cache_key_t *key)
+{
+	uint32_t h = hash((const char *)key->owner, knot_dname_size(key->owner));
+	h ^= key->type * 0x9E3779B1U;
+	h ^= key->tag * 0x85EBCA77U;
+	if (key->data_len > 0) {
+		h ^= hash((const char *)key->data, key->data_len) * 0xC2B2AE3DU;
+	}
+
+	return h;
+}
+
+static bool key_match(const cache_entry_t *entry, const sign_cache_key_t *key,
+                      uint32_t h)
+{
+	return entry->hash == h &&
+	       entry->type == key->type &&
+	       entry->tag == key->tag &&
+	       entry->data_len == key->data_len &&
+	       knot_dname_is_equal(entry->owner, key->owner) &&
+	       (key->data_len == 0 ||
+	        memcmp(entry->data, key->data, key->data_len) == 0);
+}
+
+static void entry_free(cache_entry_t *entry)
+{
+	if (entry == NULL) {
+		return;
+	}
+
+	knot_rdataset_clear(&entry->rrs, NULL);
+	free(entry);
+}
+
+sign_cache_t *sign_cache_new(size_t slots)
+{
+	if (slots == 0) {
+		return NULL;
+	}
+
+	sign_cache_t *cache = calloc(1, sizeof(*cache) + slots * sizeof(cache_entry_t *));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	cache->slots = slots;
+
+	return cache;
+}
+
+void sign_cache_free(sign_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < cache->slots; i++) {
+		entry_free(cache->entries[i]);
+	}
+
+	free(cache);
+}
+
+const knot_rdataset_t *sign_cache_get(sign_cache_t *cache,
+                                      const sign_cache_key_t *key,
+                                      uint32_t now)
+{
+	assert(cache && key && key->owner);
+
+	uint32_t h = key_hash(key);
+	cache_entry_t *entry = cache->entries[h % cache->slots];
+	if (entry == NULL || !key_match(entry, key, h) || entry->expires <= now) {
+		return NULL;
+	}
+
+	return &entry->rrs;
+}
+
+int sign_cache_put(sign_cache_t *cache, const sign_cache_key_t *key,
+                   const knot_rdataset_t *rrs, uint32_t expires)
+{
+	assert(cache && key && key->owner && rrs);
+
+	size_t owner_size = knot_dname_size(key->owner);
+	cache_entry_t *entry = malloc(sizeof(*entry) + owner_size + key->data_len);
+	if (entry == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	entry->hash = key_hash(key);
+	entry->expires = expires;
+	entry->type = key->type;
+	entry->tag = key->tag;
+	entry->data_len = key->data_len;
+	entry->data = entry->owner + owner_size;
+	memcpy(entry->owner, key->owner, owner_size);
+	if (key->data_len > 0) {
+		memcpy(entry->data, key->data, key->data_len);
+	}
+
+	knot_rdataset_init(&entry->rrs);
+	int ret = knot_rdataset_copy(&entry->rrs, rrs, NULL);
+	if (ret != KNOT_EOK) {
+		free(entry);
+		return ret;
+	}
+
+	cache_entry_t **slot = &cache->entries[entry->hash % cache->slots];
+	entry_free(*slot);
+	*slot = entry;
+
+	return KNOT_EOK;
+}
@@ -0,0 +1,79 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libknot/dname.h"
+#include "libknot/rdataset.h"
+
+/*!
+ * \brief Bounded cache of synthesized records.
+ *
+ * The cache has a fixed number of slots, a new record replaces the record
+ * in its slot. The cache is not thread-safe.
+ *
+ * A record is looked up by its owner, type, tag, and arbitrary data. E.g.
+ * RRSIGs are looked up by the covered RR set and the key tag.
+ */
+typedef struct sign_cache sign_cache_t;
+
+/*! \brief Lookup key of a cached record. */
+typedef struct {
+	const knot_dname_t *owner; /*!< Owner name. */
+	uint16_t type;             /*!< Record type. */
+	uint32_t tag;              /*!< Additional numeric key. */
+	const uint8_t *data;       /*!< Additional key data. */
+	size_t data_len;           /*!< Length of the additional key data. */
+} sign_cache_key_t;
+
+/*!
+ * \brief Create a cache with the given number of slots.
+ */
+sign_cache_t *sign_cache_new(size_t slots);
+
+/*!
+ * \brief Free the cache and all the records.
+ */
+void sign_cache_free(sign_cache_t *cache);
+
+/*!
+ * \brief Find a record which has not expired yet.
+ *
+ * \param cache  Cache.
+ * \param key    Lookup key.
+ * \param now    Current time.
+ *
+ * \return Cached record data, valid until the next insertion, or NULL.
+ */
+const knot_rdataset_t *sign_cache_get(sign_cache_t *cache,
+                                      const sign_cache_key_t *key,
+                                      uint32_t now);
+
+/*!
+ * \brief Insert a record into the cache, possibly replacing another one.
+ *
+ * \param cache    Cache.
+ * \param key      Lookup key.
+ * \param rrs      Record data to be copied.
+ * \param expires  Time until which the record may be used.
+ *
+ * \return KNOT_EOK, KNOT_ENOMEM.
+ */
+int sign_cache_put(sign_cache_t *cache, const sign_cache_key_t *key,
+                   const knot_rdataset_t *rrs, uint32_t expires);
@@ -18,12 +18,13 @@
 #include <time.h>
 
 #include "knot/modules/rrl/functions.h"
+#include "contrib/macros.h"
 #include "contrib/murmurhash3/murmurhash3.h"
 #include "contrib/sockaddr.h"
 #include "dnssec/random.h"
 
-/* Hopscotch defines. */
-#define HOP_LEN (sizeof(unsigned)*8)
+/* Bucket neighbourhood size. */
+#define HOP_LEN 32
 /* Limits */
 #define RRL_CLSBLK_MAXLEN (4 + 8 + 1 + 256)
 /* CIDR block prefix lengths for v4/v6 */
@@ -32,6 +33,23 @@
 /* Defaults */
 #define RRL_SSTART 2 /* 1/Nth of the rate for slow start */
 #define RRL_PSIZE_LARGE 1024
+#define RRL_NTOK_MAX ((1 << 22) - 1) /* Limited by the packed state. */
+/* Reserved bucket keys. */
+#define RRL_KEY_EMPTY 0
+#define RRL_KEY_BUSY  1 /* Being claimed, the state isn't published yet. */
+
+#ifdef HAVE_ATOMIC
+ #define ATOMIC_GET(src)         __atomic_load_n(&(src), __ATOMIC_ACQUIRE)
+ #define ATOMIC_SET(dst, val)    __atomic_store_n(&(dst), val, __ATOMIC_RELEASE)
+ #define ATOMIC_CAS(dst, old, new) __atomic_compare_exchange_n(&(dst), &(old), new, \
+                                 false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+ #define ATOMIC_GET(src)         __sync_fetch_and_add(&(src), 0)
+ #define ATOMIC_SET(dst, val)    { __sync_synchronize(); (dst) = (val); }
+ #define ATOMIC_CAS(dst, old, new) ({ \
+                                 uint64_t prev_ = __sync_val_compare_and_swap(&(dst), old, new); \
+                                 bool ok_ = (prev_ == (old)); (old) = prev_; ok_; })
+#endif
 
 /* Classification */
 enum {
@@ -200,81 +218,55 @@ static int rrl_classify(char *dst, size_t maxlen, const struct sockaddr_storage
 	return blklen;
 }
 
-static int bucket_free(rrl_item_t *b, uint32_t now) {
-	return b->cls == CLS_NULL || (b->time + 1 < now);
-}
+/*! \brief Unpacked bucket state. */
+typedef struct {
+	uint32_t time;       /* Timestamp. */
+	uint32_t ntok;       /* Tokens available (22 bits). */
+	uint8_t  flags;      /* Flags (2 bits). */
+	uint8_t  cls;        /* Bucket class. */
+} rrl_state_t;
 
-static int bucket_match(rrl_item_t *b, rrl_item_t *m)
+static inline rrl_state_t state_unpack(uint64_t raw)
 {
-	return b->cls    == m->cls &&
-	       b->netblk == m->netblk &&
-	       b->qname  == m->qname;
+	rrl_state_t s = {
+		.time  = raw & 0xffffffff,
+		.ntok  = (raw >> 32) & RRL_NTOK_MAX,
+		.flags = (raw >> 54) & 0x03,
+		.cls   = (raw >> 56) & 0xff
+	};
+	return s;
 }
 
-static int find_free(rrl_table_t *t, unsigned i, uint32_t now)
+static inline uint64_t state_pack(const rrl_state_t *s)
 {
-	rrl_item_t *np = t->arr + t->size;
-	rrl_item_t *b = NULL;
-	for (b = t->arr + i; b != np; ++b) {
-		if (bucket_free(b, now)) {
-			return b - (t->arr + i);
-		}
-	}
-	np = t->arr + i;
-	for (b = t->arr; b != np; ++b) {
-		if (bucket_free(b, now)) {
-			return (b - t->arr) + (t->size - i);
-		}
-	}
-
-	/* this happens if table is full... force vacate current elm */
-	return i;
+	return (uint64_t)s->time |
+	       (uint64_t)MIN(s->ntok, RRL_NTOK_MAX) << 32 |
+	       (uint64_t)(s->flags & 0x03) << 54 |
+	       (uint64_t)s->cls << 56;
 }
 
-static inline unsigned find_match(rrl_table_t *t, uint32_t id, rrl_item_t *m)
+static bool bucket_free(uint64_t key, uint64_t state, uint32_t now)
 {
-	unsigned f = 0;
-	unsigned d = 0;
-	unsigned match = t->arr[id].hop;
-	while (match != 0) {
-		d = __builtin_ctz(match);
-		f = (id + d) % t->size;
-		if (bucket_match(t->arr + f, m)) {
-			return d;
-		} else {
-			match &= ~(1<<d); /* clear potential match */
-		}
-	}
-
-	return HOP_LEN + 1;
+	return key == RRL_KEY_EMPTY ||
+	       (key != RRL_KEY_BUSY && state_unpack(state).time + 1 < now);
 }
 
-static inline unsigned reduce_dist(rrl_table_t *t, unsigned id, unsigned d, unsigned *f)
+/*!
+ * \brief Claim the bucket if it still has the given key.
+ *
+ * The bucket is locked by a reserved key first, so that the new state is
+ * visible to anyone who finds the bucket by its new key.
+ */
+static bool bucket_claim(rrl_item_t *b, uint64_t old_key, uint64_t key,
+                         const rrl_state_t *init)
 {
-	unsigned rd = HOP_LEN - 1;
-	while (rd > 0) {
-		unsigned s = (t->size + *f - rd) % t->size; /* bucket to be vacated */
-		if (t->arr[s].hop != 0) {
-			unsigned o = __builtin_ctz(t->arr[s].hop);  /* offset of first valid bucket */
-			if (o < rd) {                               /* only offsets in <s, f> are interesting */
-				unsigned e = (s + o) % t->size;     /* this item will be displaced to [f] */
-				unsigned keep_hop = t->arr[*f].hop; /* unpredictable padding */
-				memcpy(t->arr + *f, t->arr + e, sizeof(rrl_item_t));
-				t->arr[*f].hop = keep_hop;
-				t->arr[e].cls = CLS_NULL;
-				t->arr[s].hop &= ~(1<<o);
-				t->arr[s].hop |= 1<<rd;
-				*f = e;
-				return d - (rd - o);
-			}
-		}
-		--rd;
+	if (old_key == RRL_KEY_BUSY || !ATOMIC_CAS(b->key, old_key, RRL_KEY_BUSY)) {
+		return false;
 	}
 
-	assert(rd == 0); /* this happens with p=1/fact(HOP_LEN) */
-	*f = id;
-	d = 0; /* force vacate initial element */
-	return d;
+	ATOMIC_SET(b->state, state_pack(init));
+	ATOMIC_SET(b->key, key);
+	return true;
 }
 
 static void rrl_log_state(knotd_mod_t *mod, const struct sockaddr_storage *ss,
@@ -307,7 +299,7 @@ rrl_table_t *rrl_create(size_t size)
 	if (!t) {
 		return NULL;
 	}
-	memset(t, 0, sizeof(rrl_table_t));
+	memset(t, 0, tbl_len);
 	t->size = size;
 	rrl_reseed(t);
 
@@ -329,110 +321,68 @@ uint32_t rrl_rate(rrl_table_t *rrl)
 	return rrl ? rrl->rate : 0;
 }
 
-int rrl_setlocks(rrl_table_t *rrl, unsigned granularity)
-{
-	if (!rrl) {
-		return KNOT_EINVAL;
-	}
-
-	assert(!rrl->lk); /* Cannot change while locks are used. */
-	assert(granularity <= rrl->size / 10); /* Due to int. division err. */
-
-	if (pthread_mutex_init(&rrl->ll, NULL) < 0) {
-		return KNOT_ENOMEM;
-	}
-
-	/* Alloc new locks. */
-	rrl->lk = malloc(granularity * sizeof(pthread_mutex_t));
-	if (!rrl->lk) {
-		return KNOT_ENOMEM;
-	}
-	memset(rrl->lk, 0, granularity * sizeof(pthread_mutex_t));
-
-	/* Initialize. */
-	for (size_t i = 0; i < granularity; ++i) {
-		if (pthread_mutex_init(rrl->lk + i, NULL) < 0) {
-			break;
-		}
-		++rrl->lk_count;
-	}
-
-	/* Incomplete initialization */
-	if (rrl->lk_count != granularity) {
-		for (size_t i = 0; i < rrl->lk_count; ++i) {
-			pthread_mutex_destroy(rrl->lk + i);
-		}
-		free(rrl->lk);
-		rrl->lk_count = 0;
-		return KNOT_ERROR;
-	}
-
-	return KNOT_EOK;
-}
-
 rrl_item_t *rrl_hash(rrl_table_t *t, const struct sockaddr_storage *a, rrl_req_t *p,
-                     const knot_dname_t *zone, uint32_t stamp, int *lock)
+                     const knot_dname_t *zone, uint32_t stamp)
 {
+	/* Both hashes must use the same seed, even if reseeded meanwhile. */
+	uint32_t seed = ATOMIC_GET(t->seed);
+
 	char buf[RRL_CLSBLK_MAXLEN];
-	int len = rrl_classify(buf, sizeof(buf), a, p, zone, t->seed);
+	int len = rrl_classify(buf, sizeof(buf), a, p, zone, seed);
 	if (len < 0) {
 		return NULL;
 	}
 
-	uint32_t id = hash(buf, len) % t->size;
+	uint32_t h = hash(buf, len);
+	uint32_t id = h % t->size;
 
-	/* Lock for lookup. */
-	pthread_mutex_lock(&t->ll);
+	/* Fingerprint extended by a hash with a different seed. */
+	uint32_t seed2 = ~seed;
+	memcpy(buf + len - sizeof(seed2), &seed2, sizeof(seed2));
+	uint64_t key = (uint64_t)hash(buf, len) << 32 | h;
+	if (key <= RRL_KEY_BUSY) {
+		key = RRL_KEY_BUSY + 1;
+	}
 
-	/* Find an exact match in <id, id + HOP_LEN). */
-	char *qname = buf + sizeof(uint8_t) + sizeof(uint64_t);
-	uint64_t netblk;
-	memcpy(&netblk, buf + sizeof(uint8_t), sizeof(netblk));
-	rrl_item_t match = {
-		.hop = 0,
-		.netblk = netblk,
+	rrl_state_t init = {
+		.time = stamp,
 		.ntok = t->rate * RRL_CAPACITY,
-		.cls = buf[0],
 		.flags = RRL_BF_NULL,
-		.qname = hash(qname + 1, *qname),
-		.time = stamp
+		.cls = buf[0]
 	};
 
-	unsigned d = find_match(t, id, &match);
-	if (d > HOP_LEN) { /* not an exact match, find free element [f] */
-		d = find_free(t, id, stamp);
-	}
+	/* Find an exact match in <id, id + HOP_LEN) or claim a free bucket. */
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		rrl_item_t *free_b = NULL;
+		uint64_t free_key = 0;
+		for (unsigned d = 0; d < HOP_LEN; ++d) {
+			rrl_item_t *b = t->arr + (id + d) % t->size;
+			uint64_t bkey = ATOMIC_GET(b->key);
+			if (bkey == key) {
+				return b;
+			}
+			if (free_b == NULL && bucket_free(bkey, ATOMIC_GET(b->state), stamp)) {
+				free_b = b;
+				free_key = bkey;
+			}
+		}
 
-	/* Reduce distance to fit <id, id + HOP_LEN) */
-	unsigned f = (id + d) % t->size;
-	while (d >= HOP_LEN) {
-		d = reduce_dist(t, id, d, &f);
+		if (free_b == NULL) {
+			break;
+		}
+		if (bucket_claim(free_b, free_key, key, &init)) {
+			return free_b;
+		}
+		/* Lost the race, maybe to the same key, so retry. */
 	}
 
-	/* Assign granular lock and unlock lookup. */
-	*lock = f % t->lk_count;
-	rrl_lock(t, *lock);
-	pthread_mutex_unlock(&t->ll);
-
-	/* found free elm 'k' which is in <id, id + HOP_LEN) */
-	t->arr[id].hop |= (1 << d);
-	rrl_item_t *b = t->arr + f;
-	assert(f == (id+d) % t->size);
-
-	/* Inspect bucket state. */
-	unsigned hop = b->hop;
-	if (b->cls == CLS_NULL) {
-		memcpy(b, &match, sizeof(rrl_item_t));
-		b->hop = hop;
-	}
-	/* Check for collisions. */
-	if (!bucket_match(b, &match)) {
-		if (!(b->flags & RRL_BF_SSTART)) {
-			memcpy(b, &match, sizeof(rrl_item_t));
-			b->hop = hop;
-			b->ntok = t->rate + t->rate / RRL_SSTART;
-			b->flags |= RRL_BF_SSTART;
-		}
+	/* Collision, reset the home bucket unless in slow-start. */
+	rrl_item_t *b = t->arr + id;
+	rrl_state_t state = state_unpack(ATOMIC_GET(b->state));
+	if (!(state.flags & RRL_BF_SSTART)) {
+		init.ntok = t->rate + t->rate / RRL_SSTART;
+		init.flags = RRL_BF_SSTART;
+		(void)bucket_claim(b, ATOMIC_GET(b->key), key, &init);
 	}
 
 	return b;
@@ -446,59 +396,68 @@ int rrl_query(rrl_table_t *rrl, const struct sockaddr_storage *a, rrl_req_t *req
 	}
 
 	/* Calculate hash and fetch */
-	int ret = KNOT_EOK;
-	int lock = -1;
 	uint32_t now = time(NULL);
-	rrl_item_t *b = rrl_hash(rrl, a, req, zone, now, &lock);
+	rrl_item_t *b = rrl_hash(rrl, a, req, zone, now);
 	if (!b) {
-		if (lock > -1) {
-			rrl_unlock(rrl, lock);
-		}
 		return KNOT_ERROR;
 	}
 
-	/* Calculate rate for dT */
-	uint32_t dt = now - b->time;
-	if (dt > RRL_CAPACITY) {
-		dt = RRL_CAPACITY;
-	}
-	/* Visit bucket. */
-	b->time = now;
-	if (dt > 0) { /* Window moved. */
-
-		/* Check state change. */
-		if ((b->ntok > 0 || dt > 1) && (b->flags & RRL_BF_ELIMIT)) {
-			b->flags &= ~RRL_BF_ELIMIT;
-			rrl_log_state(mod, a, b->flags, b->cls);
+	int ret;
+	rrl_state_t s;
+	bool leaves, enters;
+	uint64_t old_state = ATOMIC_GET(b->state);
+	do {
+		ret = KNOT_EOK;
+		leaves = false;
+		enters = false;
+		s = state_unpack(old_state);
+
+		/* Calculate rate for dT */
+		uint32_t dt = now - s.time;
+		if (dt > RRL_CAPACITY) {
+			dt = RRL_CAPACITY;
 		}
+		/* Visit bucket. */
+		s.time = now;
+		if (dt > 0) { /* Window moved. */
+
+			/* Check state change. */
+			if ((s.ntok > 0 || dt > 1) && (s.flags & RRL_BF_ELIMIT)) {
+				s.flags &= ~RRL_BF_ELIMIT;
+				leaves = true;
+			}
 
-		/* Add new tokens. */
-		uint32_t dn = rrl->rate * dt;
-		if (b->flags & RRL_BF_SSTART) { /* Bucket in slow-start. */
-			b->flags &= ~RRL_BF_SSTART;
+			/* Add new tokens. */
+			uint64_t dn = (uint64_t)rrl->rate * dt;
+			if (s.flags & RRL_BF_SSTART) { /* Bucket in slow-start. */
+				s.flags &= ~RRL_BF_SSTART;
+			}
+			s.ntok = MIN(s.ntok + dn, (uint64_t)RRL_CAPACITY * rrl->rate);
+			s.ntok = MIN(s.ntok, RRL_NTOK_MAX);
 		}
-		b->ntok += dn;
-		if (b->ntok > RRL_CAPACITY * rrl->rate) {
-			b->ntok = RRL_CAPACITY * rrl->rate;
+
+		/* Last item taken. */
+		if (s.ntok == 1 && !(s.flags & RRL_BF_ELIMIT)) {
+			s.flags |= RRL_BF_ELIMIT;
+			enters = true;
 		}
-	}
 
-	/* Last item taken. */
-	if (b->ntok == 1 && !(b->flags & RRL_BF_ELIMIT)) {
-		b->flags |= RRL_BF_ELIMIT;
-		rrl_log_state(mod, a, b->flags, b->cls);
-	}
+		/* Decay current bucket. */
+		if (s.ntok > 0) {
+			--s.ntok;
+		} else {
+			ret = KNOT_ELIMIT;
+		}
+	} while (!ATOMIC_CAS(b->state, old_state, state_pack(&s)));
 
-	/* Decay current bucket. */
-	if (b->ntok > 0) {
-		--b->ntok;
-	} else if (b->ntok == 0) {
-		ret = KNOT_ELIMIT;
+	/* Log state changes once the update is committed. */
+	if (leaves) {
+		rrl_log_state(mod, a, RRL_BF_NULL, s.cls);
 	}
-
-	if (lock > -1) {
-		rrl_unlock(rrl, lock);
+	if (enters) {
+		rrl_log_state(mod, a, RRL_BF_ELIMIT, s.cls);
 	}
+
 	return ret;
 }
 
@@ -514,57 +473,20 @@ bool rrl_slip_roll(int n_slip)
 
 int rrl_destroy(rrl_table_t *rrl)
 {
-	if (rrl) {
-		if (rrl->lk_count > 0) {
-			pthread_mutex_destroy(&rrl->ll);
-		}
-		for (size_t i = 0; i < rrl->lk_count; ++i) {
-			pthread_mutex_destroy(rrl->lk + i);
-		}
-		free(rrl->lk);
-	}
-
 	free(rrl);
 	return KNOT_EOK;
 }
 
 int rrl_reseed(rrl_table_t *rrl)
 {
-	/* Lock entire table. */
-	if (rrl->lk_count > 0) {
-		pthread_mutex_lock(&rrl->ll);
-		for (unsigned i = 0; i < rrl->lk_count; ++i) {
-			rrl_lock(rrl, i);
-		}
-	}
-
-	memset(rrl->arr, 0, rrl->size * sizeof(rrl_item_t));
-	rrl->seed = dnssec_random_uint32_t();
-
-	if (rrl->lk_count > 0) {
-		for (unsigned i = 0; i < rrl->lk_count; ++i) {
-			rrl_unlock(rrl, i);
+	/* Old keys don't match the new seed, the buckets are emptied to be reused. */
+	ATOMIC_SET(rrl->seed, dnssec_random_uint32_t());
+	for (size_t i = 0; i < rrl->size; ++i) {
+		uint64_t key = ATOMIC_GET(rrl->arr[i].key);
+		if (key != RRL_KEY_BUSY) {
+			(void)ATOMIC_CAS(rrl->arr[i].key, key, RRL_KEY_EMPTY);
 		}
-		pthread_mutex_unlock(&rrl->ll);
 	}
 
 	return KNOT_EOK;
 }
-
-int rrl_lock(rrl_table_t *t, int lk_id)
-{
-	assert(lk_id > -1);
-	if (pthread_mutex_lock(t->lk + lk_id) != 0) {
-		return KNOT_ERROR;
-	}
-	return KNOT_EOK;
-}
-
-int rrl_unlock(rrl_table_t *t, int lk_id)
-{
-	assert(lk_id > -1);
-	if (pthread_mutex_unlock(t->lk + lk_id)!= 0) {
-		return KNOT_ERROR;
-	}
-	return KNOT_EOK;
-}
@@ -17,7 +17,6 @@
 #pragma once
 
 #include <stdint.h>
-#include <pthread.h>
 #include <sys/socket.h>
 
 #include "libknot/libknot.h"
@@ -25,20 +24,18 @@
 
 /* Defaults */
 #define RRL_SLIP_MAX 100
-#define RRL_LOCK_GRANULARITY 32 /* Last digit granularity */
 #define RRL_CAPACITY 4 /* Window size in seconds */
 
 /*!
  * \brief RRL hash bucket.
+ *
+ * The bucket is identified by a keyed fingerprint of its classification
+ * block. Its state (timestamp, tokens, class and flags) is packed into
+ * a single word, so that it's updated with atomic compare-and-swap.
  */
 typedef struct {
-	unsigned hop;        /* Hop bitmap. */
-	uint64_t netblk;     /* Prefix associated. */
-	uint16_t ntok;       /* Tokens available. */
-	uint8_t  cls;        /* Bucket class. */
-	uint8_t  flags;      /* Flags. */
-	uint32_t qname;      /* imputed(QNAME) hash. */
-	uint32_t time;       /* Timestamp. */
+	uint64_t key;        /* Classification fingerprint (0 if empty). */
+	uint64_t state;      /* Packed bucket state. */
 } rrl_item_t;
 
 /*!
@@ -49,16 +46,13 @@ typedef struct {
  * When a bucket is in a slow-start mode, it cannot reset again for the time
  * period.
  *
- * To avoid lock contention, N locks are created and distributed amongst buckets.
- * As of now lock K for bucket N is calculated as K = N % (num_buckets).
+ * A bucket is looked up in a neighbourhood of its home position and a free
+ * (or expired) bucket is claimed there by compare-and-swap on its key, so
+ * no locking is needed.
  */
-
 typedef struct {
 	uint32_t rate;       /* Configured RRL limit. */
 	uint32_t seed;       /* Pseudorandom seed for hashing. */
-	pthread_mutex_t ll;
-	pthread_mutex_t *lk; /* Table locks. */
-	unsigned lk_count;   /* Table lock count (granularity). */
 	size_t size;         /* Number of buckets. */
 	rrl_item_t arr[];    /* Buckets. */
 } rrl_table_t;
@@ -104,16 +98,6 @@ uint32_t rrl_rate(rrl_table_t *rrl);
  */
 uint32_t rrl_setrate(rrl_table_t *rrl, uint32_t rate);
 
-/*!
- * \brief Set N distributed locks for the RRL table.
- *
- * \param rrl RRL table.
- * \param granularity Number of created locks.
- * \retval KNOT_EOK
- * \retval KNOT_EINVAL
- */
-int rrl_setlocks(rrl_table_t *rrl, unsigned granularity);
-
 /*!
  * \brief Get bucket for current combination of parameters.
  * \param t RRL table.
@@ -121,11 +105,10 @@ int rrl_setlocks(rrl_table_t *rrl, unsigned granularity);
  * \param p RRL request.
  * \param zone Relate zone name.
  * \param stamp Timestamp (current time).
- * \param lock Held lock.
  * \return assigned bucket
  */
 rrl_item_t *rrl_hash(rrl_table_t *t, const struct sockaddr_storage *a, rrl_req_t *p,
-                     const knot_dname_t *zone, uint32_t stamp, int *lock);
+                     const knot_dname_t *zone, uint32_t stamp);
 
 /*!
  * \brief Query the RRL table for accept or deny, when the rate limit is reached.
@@ -157,25 +140,10 @@ int rrl_destroy(rrl_table_t *rrl);
 
 /*!
  * \brief Reseed RRL table secret.
+ *
+ * \note All buckets are emptied.
+ *
  * \param rrl RRL table.
  * \return KNOT_EOK
  */
 int rrl_reseed(rrl_table_t *rrl);
-
-/*!
- * \brief Lock specified element lock.
- * \param rrl RRL table.
- * \param lk_id Specified lock.
- * \retval KNOT_EOK
- * \retval KNOT_ERROR
- */
-int rrl_lock(rrl_table_t *rrl, int lk_id);
-
-/*!
- * \brief Unlock specified element lock.
- * \param rrl RRL table.
- * \param lk_id Specified lock.
- * \retval KNOT_EOK
- * \retval KNOT_ERROR
- */
-int rrl_unlock(rrl_table_t *rrl, int lk_id);
@@ -191,16 +191,9 @@ int rrl_load(knotd_mod_t *mod)
 		return KNOT_ENOMEM;
 	}
 
-	// Set locks.
-	int ret = rrl_setlocks(ctx->rrl, RRL_LOCK_GRANULARITY);
-	if (ret != KNOT_EOK) {
-		ctx_free(ctx);
-		return ret;
-	}
-
 	// Set rate limit.
 	conf = knotd_conf_mod(mod, MOD_RATE_LIMIT);
-	ret = rrl_setrate(ctx->rrl, conf.single.integer);
+	int ret = rrl_setrate(ctx->rrl, conf.single.integer);
 	if (ret != KNOT_EOK) {
 		ctx_free(ctx);
 		return ret;
@@ -0,0 +1,224 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "knot/nameserver/answer_cache.h"
+#include "libknot/consts.h"
+#include "contrib/murmurhash3/murmurhash3.h"
+
+#ifdef HAVE_ATOMIC
+ #define ATOMIC_GET(src)         __atomic_load_n(&(src), __ATOMIC_ACQUIRE)
+ #define ATOMIC_SET(dst, val)    __atomic_store_n(&(dst), val, __ATOMIC_RELEASE)
+ #define ATOMIC_INC(dst)         __atomic_add_fetch(&(dst), 1, __ATOMIC_RELAXED)
+ #define ATOMIC_LOCK(dst, old)   __atomic_compare_exchange_n(&(dst), &(old), (old) + 1, \
+                                 false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+ #define ATOMIC_FENCE()          __atomic_thread_fence(__ATOMIC_ACQUIRE)
+ #define ATOMIC_WFENCE()         __atomic_thread_fence(__ATOMIC_RELEASE)
+#else
+ #define ATOMIC_GET(src)         __sync_fetch_and_add(&(src), 0)
+ #define ATOMIC_SET(dst, val)    { __sync_synchronize(); (dst) = (val); }
+ #define ATOMIC_INC(dst)         __sync_fetch_and_add(&(dst), 1)
+ #define ATOMIC_LOCK(dst, old)   __sync_bool_compare_and_swap(&(dst), (old), (old) + 1)
+ #define ATOMIC_FENCE()          __sync_synchronize()
+ #define ATOMIC_WFENCE()         __sync_synchronize()
+#endif
+
+/*! \brief Assumed CPU cache line size. */
+#define CACHE_LINE_SIZE 64
+
+/*! \brief Cached answer, consistent only if the sequence number is even. */
+typedef struct {
+	uint32_t seq;
+	uint32_t gen;
+	uint16_t qtype;
+	uint16_t qclass;
+	uint16_t max_size;
+	uint16_t flags;
+	uint16_t qname_size;
+	uint16_t wire_len;
+	uint8_t qname[KNOT_DNAME_MAXLEN];
+	uint8_t wire[ANSWER_CACHE_WIRE_MAX];
+} answer_slot_t;
+
+/*! \brief Statistics of one query processing thread, a cache line each. */
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint8_t pad[CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+} answer_stats_t;
+
+struct answer_cache {
+	uint32_t gen;     /* Empty slots have zero QNAME size and never match. */
+	uint32_t mask;
+	answer_stats_t *stats;
+	size_t stats_rows;
+	answer_slot_t slots[];
+};
+
+static answer_slot_t *slot_get(answer_cache_t *cache, const answer_cache_key_t *key)
+{
+	uint32_t h = hash((const char *)key->qname, key->qname_size);
+	h ^= (key->qtype * 0x9E3779B1U) ^ (key->flags << 16);
+
+	return &cache->slots[h & cache->mask];
+}
+
+static bool slot_match(const answer_slot_t *slot, const answer_cache_key_t *key,
+                       uint32_t gen)
+{
+	return slot->gen == gen &&
+	       slot->qtype == key->qtype &&
+	       slot->qclass == key->qclass &&
+	       slot->max_size == key->max_size &&
+	       slot->flags == key->flags &&
+	       slot->qname_size == key->qname_size &&
+	       memcmp(slot->qname, key->qname, key->qname_size) == 0;
+}
+
+answer_cache_t *answer_cache_new(size_t size, size_t threads)
+{
+	if (size == 0) {
+		return NULL;
+	}
+
+	size_t count = 1;
+	while (count < size) {
+		count <<= 1;
+	}
+
+	answer_cache_t *cache = calloc(1, sizeof(*cache) + count * sizeof(answer_slot_t));
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->mask = count - 1;
+
+	cache->stats_rows = (threads > 0) ? threads : 1;
+	size_t stats_size = cache->stats_rows * sizeof(answer_stats_t);
+	if (posix_memalign((void **)&cache->stats, CACHE_LINE_SIZE, stats_size) != 0) {
+		free(cache);
+		return NULL;
+	}
+	memset(cache->stats, 0, stats_size);
+
+	return cache;
+}
+
+void answer_cache_free(answer_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	free(cache->stats);
+	free(cache);
+}
+
+uint32_t answer_cache_gen(const answer_cache_t *cache)
+{
+	return ATOMIC_GET(((answer_cache_t *)cache)->gen);
+}
+
+void answer_cache_invalidate(answer_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	/* Full barrier, orders the increment after the contents switch. */
+	(void)__sync_add_and_fetch(&cache->gen, 1);
+}
+
+size_t answer_cache_get(answer_cache_t *cache, const answer_cache_key_t *key,
+                        uint32_t gen, unsigned thread_id, uint8_t *wire,
+                        size_t max_len)
+{
+	answer_slot_t *slot = slot_get(cache, key);
+
+	size_t len = 0;
+	uint32_t seq = ATOMIC_GET(slot->seq);
+	if ((seq & 1) == 0 && slot_match(slot, key, gen)) {
+		len = slot->wire_len;
+		if (len > max_len || len > ANSWER_CACHE_WIRE_MAX) {
+			len = 0;
+		} else {
+			memcpy(wire, slot->wire, len);
+		}
+
+		/* Discard if written meanwhile. */
+		ATOMIC_FENCE();
+		if (ATOMIC_GET(slot->seq) != seq) {
+			len = 0;
+		}
+	}
+
+	/* Rows are shared only if there are more threads than rows. */
+	answer_stats_t *stats = &cache->stats[thread_id % cache->stats_rows];
+	if (len > 0) {
+		ATOMIC_INC(stats->hits);
+	} else {
+		ATOMIC_INC(stats->misses);
+	}
+
+	return len;
+}
+
+void answer_cache_put(answer_cache_t *cache, const answer_cache_key_t *key,
+                      uint32_t gen, const uint8_t *wire, size_t len)
+{
+	if (len > ANSWER_CACHE_WIRE_MAX) {
+		return;
+	}
+
+	answer_slot_t *slot = slot_get(cache, key);
+
+	/* Skip if being written by another thread. */
+	uint32_t seq = ATOMIC_GET(slot->seq);
+	if ((seq & 1) != 0 || !ATOMIC_LOCK(slot->seq, seq)) {
+		return;
+	}
+
+	/* Order the odd sequence number before the payload stores. */
+	ATOMIC_WFENCE();
+
+	slot->gen = gen;
+	slot->qtype = key->qtype;
+	slot->qclass = key->qclass;
+	slot->max_size = key->max_size;
+	slot->flags = key->flags;
+	slot->qname_size = key->qname_size;
+	memcpy(slot->qname, key->qname, key->qname_size);
+	slot->wire_len = len;
+	memcpy(slot->wire, wire, len);
+
+	/* Release, publishes the payload with the even sequence number. */
+	ATOMIC_SET(slot->seq, seq + 2);
+}
+
+void answer_cache_stats(const answer_cache_t *cache, uint64_t *hits,
+                        uint64_t *misses)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < cache->stats_rows; i++) {
+		*hits += ATOMIC_GET(cache->stats[i].hits);
+		*misses += ATOMIC_GET(cache->stats[i].misses);
+	}
+}
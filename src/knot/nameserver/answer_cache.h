@@ -0,0 +1,116 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file
+ *
+ * \brief Per-zone cache of pre-rendered answers.
+ *
+ * Direct-mapped table of wire-format answers. Each slot is guarded by
+ * a sequence counter, so readers copy answers without locking and writers
+ * never wait (a busy slot is just not updated). All entries are invalidated
+ * at once by bumping the cache generation on zone contents switch.
+ *
+ * \addtogroup query_processing
+ * @{
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "libknot/dname.h"
+
+/*! \brief Maximal size of a cached answer. */
+#define ANSWER_CACHE_WIRE_MAX 1232
+
+/*! \brief Answer cache key flags. */
+enum {
+	ANSWER_CACHE_EDNS = 1 << 0, /*!< Query with EDNS. */
+	ANSWER_CACHE_DO   = 1 << 1, /*!< DNSSEC OK bit set. */
+};
+
+/*! \brief Answer cache key. */
+typedef struct {
+	const knot_dname_t *qname; /*!< Lowercased QNAME. */
+	size_t qname_size;         /*!< QNAME wire size. */
+	uint16_t qtype;
+	uint16_t qclass;
+	uint16_t max_size;         /*!< Maximal answer size (EDNS payload class). */
+	uint16_t flags;            /*!< Key flags and query processing flags. */
+} answer_cache_key_t;
+
+typedef struct answer_cache answer_cache_t;
+
+/*!
+ * \brief Creates an answer cache.
+ *
+ * \param size     Number of cached answers (rounded up to a power of 2).
+ * \param threads  Number of query processing threads (statistics rows).
+ *
+ * \return Answer cache or NULL if disabled (zero size) or error.
+ */
+answer_cache_t *answer_cache_new(size_t size, size_t threads);
+
+/*!
+ * \brief Frees the answer cache.
+ */
+void answer_cache_free(answer_cache_t *cache);
+
+/*!
+ * \brief Returns current cache generation.
+ *
+ * \note Must be read before accessing the zone contents the answer is
+ *       rendered from.
+ */
+uint32_t answer_cache_gen(const answer_cache_t *cache);
+
+/*!
+ * \brief Invalidates all cached answers.
+ */
+void answer_cache_invalidate(answer_cache_t *cache);
+
+/*!
+ * \brief Copies a cached answer of the given generation.
+ *
+ * \param cache      Answer cache.
+ * \param key        Answer key.
+ * \param gen        Cache generation.
+ * \param thread_id  Query processing thread identifier (for statistics).
+ * \param wire       Output wire.
+ * \param max_len    Output wire size.
+ *
+ * \return Answer size or 0 if not found.
+ */
+size_t answer_cache_get(answer_cache_t *cache, const answer_cache_key_t *key,
+                        uint32_t gen, unsigned thread_id, uint8_t *wire,
+                        size_t max_len);
+
+/*!
+ * \brief Stores an answer rendered in the given generation.
+ *
+ * \note The answer is silently not stored if too long or the slot is busy.
+ */
+void answer_cache_put(answer_cache_t *cache, const answer_cache_key_t *key,
+                      uint32_t gen, const uint8_t *wire, size_t len);
+
+/*!
+ * \brief Adds numbers of cache hits and misses to the given counters.
+ */
+void answer_cache_stats(const answer_cache_t *cache, uint64_t *hits,
+                        uint64_t *misses);
+
+/*! @} */
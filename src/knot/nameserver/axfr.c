@@ -19,6 +19,7 @@
 #include "contrib/mempattern.h"
 #include "contrib/sockaddr.h"
 #include "knot/nameserver/axfr.h"
+#include "knot/nameserver/axfr_cache.h"
 #include "knot/nameserver/internet.h"
 #include "knot/nameserver/log.h"
 #include "knot/nameserver/xfr.h"
@@ -34,8 +35,10 @@
 /* AXFR context. @note aliasing the generic xfr_proc */
 struct axfr_proc {
 	struct xfr_proc proc;
-	trie_it_t *i;
+	zone_tree_it_t i;
 	unsigned cur_rrset;
+	axfr_stream_t *stream;
+	size_t cur_msg;
 };
 
 static int axfr_put_rrsets(knot_pkt_t *pkt, zone_node_t *node,
@@ -70,34 +73,131 @@ static int axfr_process_node_tree(knot_pkt_t *pkt, const void *item,
 
 	struct axfr_proc *axfr = (struct axfr_proc*)state;
 
-	if (axfr->i == NULL) {
-		axfr->i = trie_it_begin((trie_t *)item);
+	if (axfr->i.it == NULL) {
+		int ret = zone_tree_it_begin((zone_tree_t *)item, &axfr->i);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
 	}
 
 	/* Put responses. */
 	int ret = KNOT_EOK;
-	while (!trie_it_finished(axfr->i)) {
-		zone_node_t *node = (zone_node_t *)*trie_it_val(axfr->i);
+	while (!zone_tree_it_finished(&axfr->i)) {
+		zone_node_t *node = zone_tree_it_val(&axfr->i);
 		ret = axfr_put_rrsets(pkt, node, axfr);
 		if (ret != KNOT_EOK) {
 			break;
 		}
-		trie_it_next(axfr->i);
+		zone_tree_it_next(&axfr->i);
 	}
 
 	/* Finished all nodes. */
 	if (ret == KNOT_EOK) {
-		trie_it_free(axfr->i);
-		axfr->i = NULL;
+		zone_tree_it_free(&axfr->i);
+	}
+	return ret;
+}
+
+static void axfr_put_nodes(struct axfr_proc *axfr, zone_contents_t *zone,
+                           knot_mm_t *mm)
+{
+	ptrlist_add(&axfr->proc.nodes, zone->nodes, mm);
+	/* Put NSEC3 data if exists. */
+	if (!zone_tree_is_empty(zone->nsec3_nodes)) {
+		ptrlist_add(&axfr->proc.nodes, zone->nsec3_nodes, mm);
+	}
+}
+
+static int axfr_stream_render(const zone_t *zone, axfr_stream_t *stream)
+{
+	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	if (pkt == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = knot_pkt_put_question(pkt, zone->name, KNOT_CLASS_IN,
+	                                KNOT_RRTYPE_AXFR);
+	if (ret == KNOT_EOK) {
+		ret = knot_pkt_reserve(pkt, AXFR_STREAM_RESERVE);
 	}
+	if (ret != KNOT_EOK) {
+		knot_pkt_free(&pkt);
+		return ret;
+	}
+
+	/* Render the messages the same way as a regular transfer. */
+	struct axfr_proc axfr;
+	memset(&axfr, 0, sizeof(axfr));
+	init_list(&axfr.proc.nodes);
+	xfr_stats_begin(&axfr.proc.stats);
+	axfr_put_nodes(&axfr, zone->contents, NULL);
+
+	knotd_qdata_extra_t extra = { .zone = zone, .ext = &axfr };
+	knotd_qdata_t qdata = { .extra = &extra };
+
+	/* Keep just the answer section, the question is the same in each message. */
+	do {
+		ret = xfr_process_list(pkt, &axfr_process_node_tree, &qdata);
+		if (ret == KNOT_EOK || ret == KNOT_ESPACE) {
+			int add = axfr_stream_add(stream, pkt);
+			if (add != KNOT_EOK) {
+				ret = add;
+			}
+		}
+		knot_pkt_clear_payload(pkt);
+	} while (ret == KNOT_ESPACE);
+
+	zone_tree_it_free(&axfr.i);
+	ptrlist_free(&axfr.proc.nodes, NULL);
+	knot_pkt_free(&pkt);
+
 	return ret;
 }
 
+static axfr_stream_t *axfr_stream_get(const zone_t *zone, uint32_t gen)
+{
+	axfr_stream_t *stream = NULL;
+	int ret = axfr_cache_get(zone->axfr_cache, gen, &stream);
+	switch (ret) {
+	case KNOT_EOK:    /* Rendered by another transfer. */
+		return stream;
+	case KNOT_ENOENT: /* To be rendered and shared. */
+		ret = axfr_stream_render(zone, stream);
+		if (ret != KNOT_EOK) {
+			axfr_cache_abort(zone->axfr_cache, stream);
+			return NULL;
+		}
+		axfr_cache_put(zone->axfr_cache, stream);
+		return stream;
+	default:          /* Being rendered, stale or not cacheable, walk the zone tree. */
+		return NULL;
+	}
+}
+
+static int axfr_stream_replay(knot_pkt_t *pkt, struct axfr_proc *axfr)
+{
+	const axfr_stream_t *stream = axfr->stream;
+	const axfr_msg_t *msg = &stream->msgs[axfr->cur_msg];
+
+	/* The question is equal to the rendered one, so is the compression. */
+	int ret = knot_pkt_put_wire(pkt, stream->data + msg->offset, msg->len,
+	                            stream->rr + msg->rr_pos,
+	                            stream->rr_info + msg->rr_pos, msg->rr_count);
+	if (ret != KNOT_EOK) {
+		return (ret == KNOT_ESPACE) ? KNOT_ENOXFR : ret;
+	}
+
+	xfr_stats_add(&axfr->proc.stats, pkt->size);
+
+	return (++axfr->cur_msg < stream->count) ? KNOT_ESPACE : KNOT_EOK;
+}
+
 static void axfr_query_cleanup(knotd_qdata_t *qdata)
 {
 	struct axfr_proc *axfr = (struct axfr_proc *)qdata->extra->ext;
 
-	trie_it_free(axfr->i);
+	axfr_cache_release(qdata->extra->zone->axfr_cache, axfr->stream);
+	zone_tree_it_free(&axfr->i);
 	ptrlist_free(&axfr->proc.nodes, qdata->mm);
 	mm_free(qdata->mm, axfr);
 
@@ -127,6 +227,10 @@ static int axfr_query_init(knotd_qdata_t *qdata)
 		}
 	}
 
+	/* Cache generation must be read before the zone contents. */
+	const zone_t *zone = qdata->extra->zone;
+	uint32_t gen = (zone->axfr_cache != NULL) ? axfr_cache_gen(zone->axfr_cache) : 0;
+
 	/* Create transfer processing context. */
 	knot_mm_t *mm = qdata->mm;
 	struct axfr_proc *axfr = mm_alloc(mm, sizeof(struct axfr_proc));
@@ -138,12 +242,7 @@ static int axfr_query_init(knotd_qdata_t *qdata)
 
 	/* Put data to process. */
 	xfr_stats_begin(&axfr->proc.stats);
-	zone_contents_t *zone = qdata->extra->zone->contents;
-	ptrlist_add(&axfr->proc.nodes, zone->nodes, mm);
-	/* Put NSEC3 data if exists. */
-	if (!zone_tree_is_empty(zone->nsec3_nodes)) {
-		ptrlist_add(&axfr->proc.nodes, zone->nsec3_nodes, mm);
-	}
+	axfr_put_nodes(axfr, zone->contents, mm);
 
 	/* Set up cleanup callback. */
 	qdata->extra->ext = axfr;
@@ -152,6 +251,11 @@ static int axfr_query_init(knotd_qdata_t *qdata)
 	/* No zone changes during multipacket answer (unlocked in axfr_answer_cleanup) */
 	rcu_read_lock();
 
+	/* Share the pre-rendered messages if enabled. */
+	if (zone->axfr_cache != NULL) {
+		axfr->stream = axfr_stream_get(zone, gen);
+	}
+
 	return KNOT_EOK;
 }
 
@@ -192,8 +296,26 @@ int axfr_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 	/* Reserve space for TSIG. */
 	knot_pkt_reserve(pkt, knot_tsig_wire_size(&qdata->sign.tsig_key));
 
+	/* Fill the messages as the pre-rendered ones, with or without them. */
+	const size_t limit = KNOT_WIRE_MAX_PKTSIZE - AXFR_STREAM_RESERVE;
+	if (pkt->max_size - pkt->reserved > limit) {
+		knot_pkt_reserve(pkt, pkt->max_size - pkt->reserved - limit);
+	}
+
+	/* Replay only if the messages fit, OPT and TSIG may not. */
+	if (axfr->stream != NULL && axfr->proc.stats.messages == 0 &&
+	    pkt->max_size - pkt->reserved < limit) {
+		axfr_cache_release(qdata->extra->zone->axfr_cache, axfr->stream);
+		axfr->stream = NULL;
+	}
+
 	/* Answer current packet (or continue). */
-	int ret = xfr_process_list(pkt, &axfr_process_node_tree, qdata);
+	int ret;
+	if (axfr->stream != NULL) {
+		ret = axfr_stream_replay(pkt, axfr);
+	} else {
+		ret = xfr_process_list(pkt, &axfr_process_node_tree, qdata);
+	}
 	switch (ret) {
 	case KNOT_ESPACE: /* Couldn't write more, send packet and continue. */
 		return KNOT_STATE_PRODUCE; /* Check for more. */
@@ -0,0 +1,301 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "knot/nameserver/axfr_cache.h"
+#include "libknot/errcode.h"
+
+struct axfr_cache {
+	pthread_mutex_t mutex;
+	size_t max_size;
+	bool keep;
+	uint32_t gen;
+	axfr_stream_t *stream;  /* Published stream of the current generation. */
+	bool rendering;         /* A stream of 'render_gen' is being rendered. */
+	uint32_t render_gen;
+	bool failed;            /* Rendering of 'failed_gen' failed, don't retry. */
+	uint32_t failed_gen;
+	uint64_t hits;
+	uint64_t misses;
+};
+
+static axfr_stream_t *stream_new(uint32_t gen, size_t max_size)
+{
+	axfr_stream_t *stream = calloc(1, sizeof(*stream));
+	if (stream == NULL) {
+		return NULL;
+	}
+	stream->gen = gen;
+	stream->refs = 1;
+	stream->max_size = max_size;
+
+	return stream;
+}
+
+static void stream_free(axfr_stream_t *stream)
+{
+	if (stream == NULL) {
+		return;
+	}
+
+	free(stream->msgs);
+	free(stream->data);
+	free(stream->rr);
+	free(stream->rr_info);
+	free(stream);
+}
+
+static void render_done(axfr_cache_t *cache, uint32_t gen)
+{
+	if (cache->rendering && cache->render_gen == gen) {
+		cache->rendering = false;
+	}
+}
+
+axfr_cache_t *axfr_cache_new(size_t max_size, bool keep)
+{
+	if (max_size == 0) {
+		return NULL;
+	}
+
+	axfr_cache_t *cache = calloc(1, sizeof(*cache));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&cache->mutex, NULL) != 0) {
+		free(cache);
+		return NULL;
+	}
+
+	cache->max_size = max_size;
+	cache->keep = keep;
+
+	return cache;
+}
+
+void axfr_cache_free(axfr_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	stream_free(cache->stream);
+	pthread_mutex_destroy(&cache->mutex);
+	free(cache);
+}
+
+uint32_t axfr_cache_gen(axfr_cache_t *cache)
+{
+	pthread_mutex_lock(&cache->mutex);
+	uint32_t gen = cache->gen;
+	pthread_mutex_unlock(&cache->mutex);
+
+	return gen;
+}
+
+void axfr_cache_invalidate(axfr_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+
+	cache->gen++;
+
+	/* Streams in use are freed by their last transfer. */
+	if (cache->stream != NULL && cache->stream->refs == 0) {
+		stream_free(cache->stream);
+	}
+	cache->stream = NULL;
+
+	/* The stream being rendered is stale, let the next transfer render. */
+	render_done(cache, cache->render_gen);
+
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+int axfr_cache_get(axfr_cache_t *cache, uint32_t gen, axfr_stream_t **stream)
+{
+	pthread_mutex_lock(&cache->mutex);
+
+	int ret;
+	if (gen != cache->gen || (cache->failed && cache->failed_gen == gen)) {
+		ret = KNOT_ENOTSUP; /* Stale or not cacheable. */
+	} else if (cache->stream != NULL) {
+		cache->stream->refs++;
+		cache->hits++;
+		*stream = cache->stream;
+		ret = KNOT_EOK;
+	} else if (cache->rendering) {
+		/* Don't wait, the transfer may hold the zone contents. */
+		cache->misses++;
+		ret = KNOT_EBUSY;
+	} else {
+		*stream = stream_new(gen, cache->max_size);
+		if (*stream != NULL) {
+			cache->rendering = true;
+			cache->render_gen = gen;
+			cache->misses++;
+			ret = KNOT_ENOENT;
+		} else {
+			ret = KNOT_ENOMEM;
+		}
+	}
+
+	pthread_mutex_unlock(&cache->mutex);
+
+	return ret;
+}
+
+void axfr_cache_put(axfr_cache_t *cache, axfr_stream_t *stream)
+{
+	pthread_mutex_lock(&cache->mutex);
+
+	/* Stale stream stays private to its transfer. */
+	if (stream->gen == cache->gen) {
+		cache->stream = stream;
+	}
+	render_done(cache, stream->gen);
+
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+void axfr_cache_abort(axfr_cache_t *cache, axfr_stream_t *stream)
+{
+	pthread_mutex_lock(&cache->mutex);
+
+	if (stream->gen == cache->gen) {
+		cache->failed = true;
+		cache->failed_gen = stream->gen;
+	}
+	render_done(cache, stream->gen);
+
+	pthread_mutex_unlock(&cache->mutex);
+
+	stream_free(stream);
+}
+
+void axfr_cache_release(axfr_cache_t *cache, axfr_stream_t *stream)
+{
+	if (stream == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+
+	if (--stream->refs == 0) {
+		if (stream != cache->stream) {
+			stream_free(stream);
+		} else if (!cache->keep) {
+			cache->stream = NULL;
+			stream_free(stream);
+		}
+	}
+
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+int axfr_stream_add(axfr_stream_t *stream, const knot_pkt_t *pkt)
+{
+	const knot_pktsection_t *answer = knot_pkt_section(pkt, KNOT_ANSWER);
+	if (answer->count == 0) {
+		return KNOT_EINVAL;
+	}
+
+	size_t begin = pkt->rr_info[answer->pos].pos;
+	size_t len = pkt->size - begin;
+	size_t rr_size = sizeof(*stream->rr) + sizeof(*stream->rr_info);
+	if (stream->size + len + (stream->rr_count + answer->count) * rr_size >
+	    stream->max_size) {
+		return KNOT_ELIMIT;
+	}
+
+	if (stream->count == stream->max_count) {
+		size_t max_count = (stream->max_count > 0) ? 2 * stream->max_count : 16;
+		axfr_msg_t *msgs = realloc(stream->msgs, max_count * sizeof(*msgs));
+		if (msgs == NULL) {
+			return KNOT_ENOMEM;
+		}
+		stream->msgs = msgs;
+		stream->max_count = max_count;
+	}
+
+	if (stream->rr_count + answer->count > stream->rr_max_count) {
+		size_t max_count = (stream->rr_max_count > 0) ? stream->rr_max_count : 256;
+		while (max_count < stream->rr_count + answer->count) {
+			max_count *= 2;
+		}
+		knot_rrset_t *rr = realloc(stream->rr, max_count * sizeof(*rr));
+		if (rr == NULL) {
+			return KNOT_ENOMEM;
+		}
+		stream->rr = rr;
+		knot_rrinfo_t *rr_info = realloc(stream->rr_info, max_count * sizeof(*rr_info));
+		if (rr_info == NULL) {
+			return KNOT_ENOMEM;
+		}
+		stream->rr_info = rr_info;
+		stream->rr_max_count = max_count;
+	}
+
+	if (stream->size + len > stream->capacity) {
+		size_t capacity = (stream->capacity > 0) ? stream->capacity : 65536;
+		while (capacity < stream->size + len) {
+			capacity *= 2;
+		}
+		if (capacity > stream->max_size) {
+			capacity = stream->max_size;
+		}
+		uint8_t *data = realloc(stream->data, capacity);
+		if (data == NULL) {
+			return KNOT_ENOMEM;
+		}
+		stream->data = data;
+		stream->capacity = capacity;
+	}
+
+	axfr_msg_t *msg = &stream->msgs[stream->count++];
+	msg->offset = stream->size;
+	msg->len = len;
+	msg->rr_pos = stream->rr_count;
+	msg->rr_count = answer->count;
+	memcpy(stream->data + stream->size, pkt->wire + begin, len);
+	stream->size += len;
+	memcpy(stream->rr + stream->rr_count, pkt->rr + answer->pos,
+	       answer->count * sizeof(*stream->rr));
+	memcpy(stream->rr_info + stream->rr_count, pkt->rr_info + answer->pos,
+	       answer->count * sizeof(*stream->rr_info));
+	stream->rr_count += answer->count;
+
+	return KNOT_EOK;
+}
+
+void axfr_cache_stats(axfr_cache_t *cache, uint64_t *hits, uint64_t *misses)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+	*hits += cache->hits;
+	*misses += cache->misses;
+	pthread_mutex_unlock(&cache->mutex);
+}
@@ -0,0 +1,151 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file
+ *
+ * \brief Per-zone cache of pre-rendered AXFR messages.
+ *
+ * The first outgoing AXFR of a zone version renders all its messages at once
+ * into a shared stream. Other transfers of the same version replay the stream,
+ * so only the message header, the question, and TSIG are processed per
+ * transfer. Transfers starting while the stream is being rendered walk the
+ * zone instead of waiting. The stream is reference counted and it's dropped on
+ * contents switch, or when the last transfer finishes if it's not to be kept.
+ *
+ * \addtogroup query_processing
+ * @{
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libknot/packet/pkt.h"
+
+/*! \brief Space left in each message for OPT and TSIG of the replaying transfer. */
+#define AXFR_STREAM_RESERVE 1024
+
+/*! \brief One pre-rendered message, the answer section only. */
+typedef struct {
+	size_t offset;     /*!< Offset of the answer section in the stream data. */
+	uint16_t len;      /*!< Size of the answer section. */
+	size_t rr_pos;     /*!< Index of the first RR set of the answer section. */
+	uint16_t rr_count; /*!< Number of RR sets in the answer section. */
+} axfr_msg_t;
+
+/*! \brief Pre-rendered messages of one zone version. */
+typedef struct {
+	uint32_t gen;        /*!< Cache generation of the rendered contents. */
+	unsigned refs;       /*!< Number of transfers using the stream. */
+	size_t count;        /*!< Number of messages. */
+	size_t max_count;    /*!< Allocated number of messages. */
+	size_t size;         /*!< Size of the message data. */
+	size_t capacity;     /*!< Allocated size of the message data. */
+	size_t rr_count;     /*!< Number of RR sets. */
+	size_t rr_max_count; /*!< Allocated number of RR sets. */
+	size_t max_size;     /*!< Size limit of the message data and RR sets. */
+	axfr_msg_t *msgs;
+	uint8_t *data;
+	knot_rrset_t *rr;        /*!< RR sets, referencing the rendered contents. */
+	knot_rrinfo_t *rr_info;  /*!< Positions of the RR sets in the messages. */
+} axfr_stream_t;
+
+typedef struct axfr_cache axfr_cache_t;
+
+/*!
+ * \brief Creates an AXFR cache.
+ *
+ * \param max_size  Maximal size of the rendered messages of the zone.
+ * \param keep      Keep the messages when the last transfer finishes.
+ *
+ * \return AXFR cache or NULL if disabled (zero size) or error.
+ */
+axfr_cache_t *axfr_cache_new(size_t max_size, bool keep);
+
+/*!
+ * \brief Frees the AXFR cache, there must be no transfers using it.
+ */
+void axfr_cache_free(axfr_cache_t *cache);
+
+/*!
+ * \brief Returns current cache generation.
+ *
+ * \note Must be read before accessing the zone contents the stream is
+ *       rendered from.
+ */
+uint32_t axfr_cache_gen(axfr_cache_t *cache);
+
+/*!
+ * \brief Drops the cached stream, it's freed when the last transfer finishes.
+ */
+void axfr_cache_invalidate(axfr_cache_t *cache);
+
+/*!
+ * \brief Gets the stream of the given generation.
+ *
+ * Never waits, so it can be called in an RCU read-side critical section.
+ *
+ * \param cache   AXFR cache.
+ * \param gen     Cache generation.
+ * \param stream  Output stream.
+ *
+ * \retval KNOT_EOK     if the stream is returned, release it after the transfer.
+ * \retval KNOT_ENOENT  if an empty stream is returned, render the transfer into
+ *                      it and publish it by axfr_cache_put() or discard it
+ *                      by axfr_cache_abort().
+ * \retval KNOT_EBUSY   if the stream is being rendered by another transfer.
+ * \return < KNOT_EOK if the transfer cannot be shared.
+ */
+int axfr_cache_get(axfr_cache_t *cache, uint32_t gen, axfr_stream_t **stream);
+
+/*!
+ * \brief Publishes a rendered stream, the caller keeps its reference.
+ */
+void axfr_cache_put(axfr_cache_t *cache, axfr_stream_t *stream);
+
+/*!
+ * \brief Discards a partially rendered stream, its generation won't be cached.
+ */
+void axfr_cache_abort(axfr_cache_t *cache, axfr_stream_t *stream);
+
+/*!
+ * \brief Releases the stream reference.
+ */
+void axfr_cache_release(axfr_cache_t *cache, axfr_stream_t *stream);
+
+/*!
+ * \brief Appends a message to the stream being rendered.
+ *
+ * The message must contain just the question and the answer section. Its RR
+ * sets must stay valid as long as the stream is of the current generation.
+ *
+ * \param stream   Stream.
+ * \param pkt      Rendered message.
+ *
+ * \retval KNOT_EOK on success.
+ * \retval KNOT_ELIMIT if the stream size limit would be exceeded.
+ * \retval KNOT_ENOMEM
+ */
+int axfr_stream_add(axfr_stream_t *stream, const knot_pkt_t *pkt);
+
+/*!
+ * \brief Adds numbers of shared and rendered transfers to the given counters.
+ */
+void axfr_cache_stats(axfr_cache_t *cache, uint64_t *hits, uint64_t *misses);
+
+/*! @} */
@@ -15,6 +15,7 @@
  */
 
 #include "libknot/libknot.h"
+#include "knot/conf/zones.h"
 #include "knot/nameserver/internet.h"
 #include "knot/nameserver/nsec_proofs.h"
 #include "knot/nameserver/query_module.h"
@@ -144,11 +145,10 @@ static int put_answer(knot_pkt_t *pkt, uint16_t type, knotd_qdata_t *qdata)
 	int ret = KNOT_EOK;
 	switch (type) {
 	case KNOT_RRTYPE_ANY: /* Append all RRSets. */ {
-		conf_val_t val = conf_zone_get(conf(), C_DISABLE_ANY,
-		                               qdata->extra->zone->name);
 		/* If ANY not allowed, set TC bit. */
 		if ((qdata->params->flags & KNOTD_QUERY_FLAG_LIMIT_ANY) &&
-		    conf_bool(&val)) {
+		    conf_zone(conf(), qdata->extra->zone->name).disable_any) {
+			qdata->extra->uncacheable = true;
 			knot_wire_set_tc(pkt->wire);
 			return KNOT_ESPACE;
 		}
@@ -248,6 +248,9 @@ static int put_additional(knot_pkt_t *pkt, const knot_rrset_t *rr,
 
 	additional_t *additional = (additional_t *)rr->additional;
 
+	/* Glue nodes are resolved to the version being read. */
+	bool second = binode_second(qdata->extra->zone->contents->apex);
+
 	/* Iterate over the additionals. */
 	for (uint16_t i = 0; i < additional->count; i++) {
 		glue_t *glue = &additional->glues[i];
@@ -260,9 +263,10 @@ static int put_additional(knot_pkt_t *pkt, const knot_rrset_t *rr,
 
 		uint16_t hint = knot_pkt_compr_hint(info, KNOT_COMPR_HINT_RDATA +
 		                                    glue->ns_pos);
-		knot_rrset_t rrsigs = node_rrset(glue->node, KNOT_RRTYPE_RRSIG);
+		const zone_node_t *node = binode_node(glue->node, second);
+		knot_rrset_t rrsigs = node_rrset(node, KNOT_RRTYPE_RRSIG);
 		for (int k = 0; k < ar_type_count; ++k) {
-			knot_rrset_t rrset = node_rrset(glue->node, ar_type_list[k]);
+			knot_rrset_t rrset = node_rrset(node, ar_type_list[k]);
 			if (knot_rrset_empty(&rrset)) {
 				continue;
 			}
@@ -16,6 +16,7 @@
 
 #include <urcu.h>
 
+#include "contrib/macros.h"
 #include "contrib/mempattern.h"
 #include "contrib/sockaddr.h"
 #include "knot/nameserver/axfr.h"
@@ -33,111 +34,96 @@
 	ns_log(priority, ZONE_NAME(qdata), LOG_OPERATION_IXFR, \
 	       LOG_DIRECTION_OUT, REMOTE(qdata), fmt)
 
-/*! \brief Helper macro for putting RRs into packet. */
-#define IXFR_SAFE_PUT(pkt, rr) \
-	int ret = knot_pkt_put((pkt), 0, (rr), KNOT_PF_NOTRUNC); \
-	if (ret != KNOT_EOK) { \
-		return ret; \
+/*! \brief Frees the RR sets of the previous (already sent) answer packet. */
+static void ixfr_release_sent(struct ixfr_proc *ixfr)
+{
+	for (size_t i = 0; i < ixfr->sent_count; i++) {
+		knot_rrset_clear(&ixfr->sent[i], NULL);
 	}
+	ixfr->sent_count = 0;
+}
 
-/*! \brief Puts current RR into packet, stores state for retries. */
-static int ixfr_put_chg_part(knot_pkt_t *pkt, struct ixfr_proc *ixfr,
-                             changeset_iter_t *itt)
+/*! \brief Puts current RR into packet, keeps it until the packet is sent. */
+static int ixfr_put_rr(knot_pkt_t *pkt, struct ixfr_proc *ixfr)
 {
-	assert(pkt);
-	assert(ixfr);
-	assert(itt);
-
-	if (knot_rrset_empty(&ixfr->cur_rr)) {
-		ixfr->cur_rr = changeset_iter_next(itt);
+	if (ixfr->sent_count == ixfr->sent_max) {
+		size_t max = MAX(2 * ixfr->sent_max, 64);
+		knot_rrset_t *sent = realloc(ixfr->sent, max * sizeof(*sent));
+		if (sent == NULL) {
+			return KNOT_ENOMEM;
+		}
+		ixfr->sent = sent;
+		ixfr->sent_max = max;
 	}
 
-	while (!knot_rrset_empty(&ixfr->cur_rr)) {
-		IXFR_SAFE_PUT(pkt, &ixfr->cur_rr);
-		ixfr->cur_rr = changeset_iter_next(itt);
+	int ret = knot_pkt_put(pkt, 0, &ixfr->cur_rr, KNOT_PF_NOTRUNC);
+	if (ret != KNOT_EOK) {
+		return ret;
 	}
 
+	ixfr->sent[ixfr->sent_count++] = ixfr->cur_rr;
+	knot_rrset_init_empty(&ixfr->cur_rr);
+
 	return KNOT_EOK;
 }
 
-/*! \brief Tests if iteration has started. */
-static bool iter_empty(struct ixfr_proc *ixfr)
+/*! \brief Reads next RR from the journal, follows the changeset sections. */
+static int ixfr_read_rr(struct ixfr_proc *ixfr)
 {
-	return EMPTY_LIST(ixfr->cur.iters) && knot_rrset_empty(&ixfr->cur_rr);
+	int ret = journal_read_rrset(ixfr->journal, &ixfr->cur_rr);
+	if (ret != KNOT_EOK || ixfr->cur_rr.type != KNOT_RRTYPE_SOA) {
+		return ret;
+	}
+
+	uint32_t serial = knot_soa_serial(&ixfr->cur_rr.rrs);
+	if (ixfr->state == IXFR_DEL) {
+		/* Finished change set. */
+		IXFROUT_LOG(LOG_DEBUG, ixfr->qdata, "serial %u -> %u",
+		            ixfr->cur_serial, serial);
+		ixfr->state = IXFR_ADD;
+	} else {
+		ixfr->cur_serial = serial;
+		ixfr->state = IXFR_DEL;
+	}
+
+	return KNOT_EOK;
 }
 
 /*!
- * \brief Process single changeset.
+ * \brief Process the changesets read from the journal.
  * \note Keep in mind that this function must be able to resume processing,
  *       for example if it fills a packet and returns ESPACE, it is called again
  *       with next empty answer and it must resume the processing exactly where
  *       it's left off.
  */
-static int ixfr_process_changeset(knot_pkt_t *pkt, const void *item,
-                                  struct xfr_proc *xfer)
+static int ixfr_process_journal(knot_pkt_t *pkt, const void *item,
+                                struct xfr_proc *xfer)
 {
-	int ret = KNOT_EOK;
 	struct ixfr_proc *ixfr = (struct ixfr_proc *)xfer;
-	changeset_t *chgset = (changeset_t *)item;
+	assert(ixfr->journal == item);
 
-	/* Put former SOA. */
-	if (ixfr->state == IXFR_SOA_DEL) {
-		IXFR_SAFE_PUT(pkt, chgset->soa_from);
-		ixfr->state = IXFR_DEL;
+	int ret = KNOT_EOK;
+	if (knot_rrset_empty(&ixfr->cur_rr)) {
+		ret = ixfr_read_rr(ixfr);
 	}
 
-	/* Put REMOVE RRSets. */
-	if (ixfr->state == IXFR_DEL) {
-		if (iter_empty(ixfr)) {
-			ret = changeset_iter_rem(&ixfr->cur, chgset);
-			if (ret != KNOT_EOK) {
-				return ret;
-			}
+	while (ret == KNOT_EOK && !knot_rrset_empty(&ixfr->cur_rr)) {
+		ret = ixfr_put_rr(pkt, ixfr);
+		if (ret == KNOT_EOK) {
+			ret = ixfr_read_rr(ixfr);
 		}
-		ret = ixfr_put_chg_part(pkt, ixfr, &ixfr->cur);
-		if (ret != KNOT_EOK) {
-			return ret;
-		}
-		changeset_iter_clear(&ixfr->cur);
-		ixfr->state = IXFR_SOA_ADD;
-	}
-
-	/* Put next SOA. */
-	if (ixfr->state == IXFR_SOA_ADD) {
-		IXFR_SAFE_PUT(pkt, chgset->soa_to);
-		ixfr->state = IXFR_ADD;
 	}
 
-	/* Put Add RRSets. */
-	if (ixfr->state == IXFR_ADD) {
-		if (iter_empty(ixfr)) {
-			ret = changeset_iter_add(&ixfr->cur, chgset);
-			if (ret != KNOT_EOK) {
-				return ret;
-			}
-		}
-		ret = ixfr_put_chg_part(pkt, ixfr, &ixfr->cur);
-		if (ret != KNOT_EOK) {
-			return ret;
-		}
-		changeset_iter_clear(&ixfr->cur);
-		ixfr->state = IXFR_SOA_DEL;
-	}
-
-	/* Finished change set. */
-	const uint32_t serial_from = knot_soa_serial(&chgset->soa_from->rrs);
-	const uint32_t serial_to = knot_soa_serial(&chgset->soa_to->rrs);
-	IXFROUT_LOG(LOG_DEBUG, ixfr->qdata, "serial %u -> %u", serial_from, serial_to);
+	/* Don't block the journal space reuse while the packet is sent. */
+	journal_read_pause(ixfr->journal);
 
 	return ret;
 }
 
-#undef IXFR_SAFE_PUT
-
-static int ixfr_load_chsets(list_t *chgsets, zone_t *zone,
-                            const knot_rrset_t *their_soa)
+static int ixfr_read_begin(journal_read_t **journal, zone_t *zone,
+                           const knot_rrset_t *their_soa)
 {
-	assert(chgsets);
+	assert(journal);
 	assert(zone);
 
 	/* Compare serials. */
@@ -147,12 +133,7 @@ static int ixfr_load_chsets(list_t *chgsets, zone_t *zone,
 		return KNOT_EUPTODATE;
 	}
 
-	int ret = zone_changes_load(conf(), zone, chgsets, serial_from);
-	if (ret != KNOT_EOK) {
-		changesets_free(chgsets);
-	}
-
-	return ret;
+	return zone_changes_read(conf(), zone, serial_from, journal);
 }
 
 static int ixfr_query_check(knotd_qdata_t *qdata)
@@ -180,8 +161,10 @@ static void ixfr_answer_cleanup(knotd_qdata_t *qdata)
 	knot_mm_t *mm = qdata->mm;
 
 	ptrlist_free(&ixfr->proc.nodes, mm);
-	changeset_iter_clear(&ixfr->cur);
-	changesets_free(&ixfr->changesets);
+	ixfr_release_sent(ixfr);
+	free(ixfr->sent);
+	knot_rrset_clear(&ixfr->cur_rr, NULL);
+	journal_read_end(ixfr->journal);
 	mm_free(mm, qdata->extra->ext);
 
 	/* Allow zone changes (finished). */
@@ -204,9 +187,8 @@ static int ixfr_answer_init(knotd_qdata_t *qdata)
 	/* Compare serials. */
 	const knot_pktsection_t *authority = knot_pkt_section(qdata->query, KNOT_AUTHORITY);
 	const knot_rrset_t *their_soa = knot_pkt_rr(authority, 0);
-	list_t chgsets;
-	init_list(&chgsets);
-	int ret = ixfr_load_chsets(&chgsets, (zone_t *)qdata->extra->zone, their_soa);
+	journal_read_t *journal = NULL;
+	int ret = ixfr_read_begin(&journal, (zone_t *)qdata->extra->zone, their_soa);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -215,31 +197,25 @@ static int ixfr_answer_init(knotd_qdata_t *qdata)
 	knot_mm_t *mm = qdata->mm;
 	struct ixfr_proc *xfer = mm_alloc(mm, sizeof(struct ixfr_proc));
 	if (xfer == NULL) {
-		changesets_free(&chgsets);
+		journal_read_end(journal);
 		return KNOT_ENOMEM;
 	}
 	memset(xfer, 0, sizeof(struct ixfr_proc));
 	xfr_stats_begin(&xfer->proc.stats);
 	xfer->state = IXFR_SOA_DEL;
 	init_list(&xfer->proc.nodes);
-	init_list(&xfer->changesets);
-	init_list(&xfer->cur.iters);
 	knot_rrset_init_empty(&xfer->cur_rr);
-	add_tail_list(&xfer->changesets, &chgsets);
+	xfer->journal = journal;
+	xfer->cur_serial = knot_soa_serial(&their_soa->rrs);
 	xfer->qdata = qdata;
 
-	/* Put all changesets to processing queue. */
-	changeset_t *chs = NULL;
-	WALK_LIST(chs, xfer->changesets) {
-		ptrlist_add(&xfer->proc.nodes, chs, mm);
+	/* The changesets are streamed from the journal as one item. */
+	if (ptrlist_add(&xfer->proc.nodes, journal, mm) == NULL) {
+		journal_read_end(journal);
+		mm_free(mm, xfer);
+		return KNOT_ENOMEM;
 	}
 
-	/* Keep first and last serial. */
-	chs = HEAD(xfer->changesets);
-	xfer->soa_from = chs->soa_from;
-	chs = TAIL(xfer->changesets);
-	xfer->soa_to = chs->soa_to;
-
 	/* Set up cleanup callback. */
 	qdata->extra->ext = xfer;
 	qdata->extra->ext_cleanup = &ixfr_answer_cleanup;
@@ -298,8 +274,8 @@ int ixfr_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 		switch (ret) {
 		case KNOT_EOK:       /* OK */
 			IXFROUT_LOG(LOG_INFO, qdata, "started, serial %u -> %u",
-			            knot_soa_serial(&ixfr->soa_from->rrs),
-			            knot_soa_serial(&ixfr->soa_to->rrs));
+			            ixfr->cur_serial,
+			            zone_contents_serial(qdata->extra->zone->contents));
 			break;
 		case KNOT_EUPTODATE: /* Our zone is same age/older, send SOA. */
 			IXFROUT_LOG(LOG_INFO, qdata, "zone is up-to-date");
@@ -324,8 +300,11 @@ int ixfr_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 	/* Reserve space for TSIG. */
 	knot_pkt_reserve(pkt, knot_tsig_wire_size(&qdata->sign.tsig_key));
 
+	/* Previous packet has been sent. */
+	ixfr_release_sent(ixfr);
+
 	/* Answer current packet (or continue). */
-	int ret = xfr_process_list(pkt, &ixfr_process_changeset, qdata);
+	int ret = xfr_process_list(pkt, &ixfr_process_journal, qdata);
 	switch (ret) {
 	case KNOT_ESPACE: /* Couldn't write more, send packet and continue. */
 		return KNOT_STATE_PRODUCE; /* Check for more. */
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "knot/journal/journal.h"
 #include "knot/nameserver/process_query.h"
 #include "knot/nameserver/xfr.h"
 #include "libknot/packet/pkt.h"
@@ -37,14 +38,17 @@ struct ixfr_proc {
 	struct xfr_proc proc;
 	enum ixfr_state state;
 
-	/* Changes to be sent. */
-	list_t changesets;
+	/* Changes to be sent, read from the journal. */
+	journal_read_t *journal;
 
 	/* Currenty processed changeset. */
 	knot_rrset_t cur_rr;
-	changeset_iter_t cur;
-	const knot_rrset_t *soa_from;
-	const knot_rrset_t *soa_to;
+	uint32_t cur_serial;
+
+	/* RR sets referenced by the current answer packet. */
+	knot_rrset_t *sent;
+	size_t sent_count;
+	size_t sent_max;
 
 	/* Processing context. */
 	knotd_qdata_t *qdata;
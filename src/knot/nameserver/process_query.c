@@ -18,7 +18,9 @@
 
 #include "dnssec/tsig.h"
 #include "knot/common/log.h"
+#include "knot/conf/zones.h"
 #include "knot/dnssec/rrset-sign.h"
+#include "knot/nameserver/answer_cache.h"
 #include "knot/nameserver/process_query.h"
 #include "knot/nameserver/query_module.h"
 #include "knot/nameserver/chaos.h"
@@ -356,9 +358,10 @@ static int prepare_answer(const knot_pkt_t *query, knot_pkt_t *resp, knot_layer_
 		return KNOT_ERROR;
 	}
 
-	/* Update maximal answer size. */
+	/* Update maximal answer size, within the answer buffer. */
 	bool has_limit = qdata->params->flags & KNOTD_QUERY_FLAG_LIMIT_SIZE;
 	if (has_limit) {
+		size_t buf_size = resp->max_size;
 		resp->max_size = KNOT_WIRE_MIN_PKTSIZE;
 		if (knot_pkt_has_edns(query)) {
 			uint16_t server;
@@ -376,6 +379,7 @@ static int prepare_answer(const knot_pkt_t *query, knot_pkt_t *resp, knot_layer_
 			uint16_t transfer = MIN(client, server);
 			resp->max_size = MAX(resp->max_size, transfer);
 		}
+		resp->max_size = MIN(resp->max_size, buf_size);
 	} else {
 		resp->max_size = KNOT_WIRE_MAX_PKTSIZE;
 	}
@@ -383,6 +387,93 @@ static int prepare_answer(const knot_pkt_t *query, knot_pkt_t *resp, knot_layer_
 	return ret;
 }
 
+/*!
+ * \brief Get answer cache and key for the query if the answer can be cached.
+ *
+ * Only plain UDP queries without TSIG and EDNS options, answered from a zone
+ * without any query module, are eligible.
+ */
+static answer_cache_t *answer_cache_prepare(knotd_qdata_t *qdata,
+                                            const knot_pkt_t *resp,
+                                            const struct query_plan *plan,
+                                            answer_cache_key_t *key)
+{
+	const zone_t *zone = qdata->extra->zone;
+	const knot_pkt_t *query = qdata->query;
+
+	if (zone == NULL || zone->answer_cache == NULL ||
+	    plan != NULL || zone->query_plan != NULL ||
+	    qdata->type != KNOTD_QUERY_TYPE_NORMAL ||
+	    !(qdata->params->flags & KNOTD_QUERY_FLAG_LIMIT_SIZE) ||
+	    query->tsig_rr != NULL || qdata->rcode != KNOT_RCODE_NOERROR ||
+	    knot_pkt_qclass(query) != KNOT_CLASS_IN) {
+		return NULL;
+	}
+
+	key->flags = qdata->params->flags << 8;
+	if (query->opt_rr != NULL) {
+		/* Options (e.g. NSID, cookies) may alter the answer. */
+		if (knot_rdata_rdlen(knot_rdataset_at(&query->opt_rr->rrs, 0)) > 0) {
+			return NULL;
+		}
+		key->flags |= ANSWER_CACHE_EDNS;
+		if (knot_pkt_has_dnssec(query)) {
+			key->flags |= ANSWER_CACHE_DO;
+		}
+	}
+
+	key->qname = knot_pkt_qname(query); /* Already lowercased. */
+	key->qname_size = query->qname_size;
+	key->qtype = knot_pkt_qtype(query);
+	key->qclass = knot_pkt_qclass(query);
+	key->max_size = resp->max_size;
+
+	return zone->answer_cache;
+}
+
+/*! \brief Put cached answer to the response, patch the query specific fields. */
+static bool answer_cache_answer(answer_cache_t *cache, const answer_cache_key_t *key,
+                                uint32_t gen, knot_pkt_t *resp, knotd_qdata_t *qdata)
+{
+	size_t len = answer_cache_get(cache, key, gen, qdata->params->thread_id,
+	                              resp->wire, resp->max_size);
+	if (len == 0) {
+		return false;
+	}
+	resp->size = len;
+
+	const uint8_t *query_wire = qdata->query->wire;
+	knot_wire_set_id(resp->wire, knot_wire_get_id(query_wire));
+	if (knot_wire_get_rd(query_wire)) {
+		knot_wire_set_rd(resp->wire);
+	} else {
+		knot_wire_clear_rd(resp->wire);
+	}
+	if (knot_wire_get_cd(query_wire)) {
+		knot_wire_set_cd(resp->wire);
+	} else {
+		knot_wire_clear_cd(resp->wire);
+	}
+	process_query_qname_case_restore(resp, qdata);
+
+	qdata->rcode = knot_wire_get_rcode(resp->wire);
+
+	return true;
+}
+
+/*! \brief Store the answer if it's complete and doesn't depend on the query. */
+static void answer_cache_store(answer_cache_t *cache, const answer_cache_key_t *key,
+                               uint32_t gen, const knot_pkt_t *resp,
+                               const knotd_qdata_t *qdata)
+{
+	if (qdata->extra->uncacheable || knot_wire_get_tc(resp->wire) ||
+	    (qdata->rcode != KNOT_RCODE_NOERROR && qdata->rcode != KNOT_RCODE_NXDOMAIN)) {
+		return;
+	}
+
+	answer_cache_put(cache, key, gen, resp->wire, resp->size);
+}
+
 static void set_rcode_to_packet(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 {
 	uint8_t ext_rcode = KNOT_EDNS_RCODE_HI(qdata->rcode);
@@ -475,6 +566,9 @@ static int process_query_out(knot_layer_t *ctx, knot_pkt_t *pkt)
 	struct query_plan *plan = conf()->query_plan;
 	struct query_plan *zone_plan = NULL;
 	struct query_step *step = NULL;
+	answer_cache_t *cache = NULL;
+	answer_cache_key_t cache_key;
+	uint32_t cache_gen = 0;
 
 	int next_state = KNOT_STATE_PRODUCE;
 
@@ -496,6 +590,17 @@ static int process_query_out(knot_layer_t *ctx, knot_pkt_t *pkt)
 		zone_plan = qdata->extra->zone->query_plan;
 	}
 
+	/* Try pre-rendered answer, generation must precede contents access. */
+	cache = answer_cache_prepare(qdata, pkt, plan, &cache_key);
+	if (cache != NULL) {
+		cache_gen = answer_cache_gen(cache);
+		if (answer_cache_answer(cache, &cache_key, cache_gen, pkt, qdata)) {
+			cache = NULL;
+			next_state = KNOT_STATE_DONE;
+			goto finish;
+		}
+	}
+
 	/* Before query processing code. */
 	PROCESS_BEGIN(plan, step, next_state, qdata);
 	PROCESS_BEGIN(zone_plan, step, next_state, qdata);
@@ -551,6 +656,9 @@ finish:
 		break;
 	default:
 		set_rcode_to_packet(pkt, qdata);
+		if (cache != NULL && next_state == KNOT_STATE_DONE) {
+			answer_cache_store(cache, &cache_key, cache_gen, pkt, qdata);
+		}
 	}
 
 	/* After query processing code. */
@@ -580,9 +688,16 @@ bool process_query_acl_check(conf_t *conf, const knot_dname_t *zone_name,
 		tsig.algorithm = knot_tsig_rdata_alg(query->tsig_rr);
 	}
 
-	/* Check if authenticated. */
-	conf_val_t acl = conf_zone_get(conf, C_ACL, zone_name);
-	if (!acl_allowed(conf, &acl, action, query_source, &tsig)) {
+	/* Check if authenticated, prefer the compiled ACL. */
+	bool allowed;
+	const acl_t *compiled = conf_zone_acl(conf, zone_name);
+	if (compiled != NULL) {
+		allowed = acl_match(compiled, action, query_source, &tsig);
+	} else {
+		conf_val_t acl = conf_zone_get(conf, C_ACL, zone_name);
+		allowed = acl_allowed(conf, &acl, action, query_source, &tsig);
+	}
+	if (!allowed) {
 		char addr_str[SOCKADDR_STRLEN] = { 0 };
 		sockaddr_tostr(addr_str, sizeof(addr_str), (struct sockaddr *)query_source);
 		const knot_lookup_t *act = knot_lookup_by_id((knot_lookup_t *)acl_actions,
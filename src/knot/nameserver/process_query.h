@@ -30,6 +30,7 @@ typedef struct knotd_qdata_extra {
 	list_t wildcards;    /*!< Visited wildcards. */
 	list_t rrsigs;       /*!< Section RRSIGs. */
 	uint8_t *opt_rr_pos; /*!< Place of the OPT RR in wire. */
+	bool uncacheable;    /*!< Answer depends on more than the answer cache key. */
 
 	/* Currently processed nodes. */
 	const zone_node_t *node, *encloser, *previous;
@@ -26,18 +26,29 @@
 #include "knot/conf/tools.h"
 #include "knot/nameserver/query_module.h"
 #include "knot/nameserver/process_query.h"
+#include "contrib/macros.h"
 #include "contrib/mempattern.h"
 
+/*! \brief Assumed CPU cache line size. */
+#define CACHE_LINE_SIZE 64
+#define CTRS_PER_LINE (CACHE_LINE_SIZE / sizeof(uint64_t))
+
 #ifdef HAVE_ATOMIC
  #define ATOMIC_ADD(dst, val) __atomic_add_fetch(dst, val, __ATOMIC_RELAXED);
  #define ATOMIC_SUB(dst, val) __atomic_sub_fetch(dst, val, __ATOMIC_RELAXED);
  #define ATOMIC_SET(dst, val) __atomic_store_n(dst, val, __ATOMIC_RELAXED);
+ #define ATOMIC_GET(src)      __atomic_load_n(src, __ATOMIC_RELAXED)
 #else
  #define ATOMIC_ADD(dst, val) __sync_fetch_and_add(dst, val);
  #define ATOMIC_SUB(dst, val) __sync_fetch_and_sub(dst, val);
  #define ATOMIC_SET(dst, val) // TODO: No __sync_* variant.
+ #define ATOMIC_GET(src)      __sync_fetch_and_add(src, 0)
 #endif
 
+/*! \brief Statistics row index of the current thread (1-based, 0 if unset). */
+static __thread unsigned stats_thread;
+static unsigned stats_threads;
+
 _public_
 int knotd_conf_check_ref(knotd_conf_check_args_t *args)
 {
@@ -220,6 +231,17 @@ void knotd_mod_vlog(knotd_mod_t *mod, int priority, const char *fmt, va_list arg
 	#undef LOG_ARGS
 }
 
+/*! \brief Number of statistics rows, one for each query processing thread. */
+static uint32_t stats_rows(knotd_mod_t *mod)
+{
+	conf_t *config = (mod->config != NULL) ? mod->config : conf();
+	if (config == NULL) {
+		return 1;
+	}
+
+	return MAX(1, conf_udp_threads(config) + conf_tcp_threads(config));
+}
+
 _public_
 int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_count,
                         knotd_mod_idx_to_str_f idx_to_str)
@@ -251,16 +273,17 @@ int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_cou
 
 	mod->stats_count++;
 
-	if (idx_count > 1) {
-		size_t size = idx_count * sizeof(((mod_ctr_t *)0)->counter);
-		stats->counters = mm_alloc(mod->mm, size);
-		if (stats->counters == NULL) {
-			knotd_mod_stats_free(mod);
-			return KNOT_ENOMEM;
-		}
-		memset(stats->counters, 0, size);
-		stats->idx_to_str = idx_to_str;
+	memset(stats, 0, sizeof(*stats));
+	stats->stride = (idx_count + CTRS_PER_LINE - 1) / CTRS_PER_LINE * CTRS_PER_LINE;
+	stats->rows = stats_rows(mod);
+	size_t size = stats->rows * stats->stride * sizeof(uint64_t);
+	if (posix_memalign((void **)&stats->counters, CACHE_LINE_SIZE, size) != 0) {
+		stats->counters = NULL;
+		knotd_mod_stats_free(mod);
+		return KNOT_ENOMEM;
 	}
+	memset(stats->counters, 0, size);
+	stats->idx_to_str = (idx_count > 1) ? idx_to_str : NULL;
 	stats->name = ctr_name;
 	stats->count = idx_count;
 
@@ -275,25 +298,45 @@ void knotd_mod_stats_free(knotd_mod_t *mod)
 	}
 
 	for (int i = 0; i < mod->stats_count; i++) {
-		if (mod->stats[i].count > 1) {
-			mm_free(mod->mm, mod->stats[i].counters);
-		}
+		free(mod->stats[i].counters);
 	}
 
 	mm_free(mod->mm, mod->stats);
 }
 
+uint64_t mod_ctr_get(const mod_ctr_t *ctr, uint32_t idx)
+{
+	assert(idx < ctr->count);
+
+	uint64_t sum = 0;
+	for (uint32_t row = 0; row < ctr->rows; row++) {
+		sum += ATOMIC_GET(&ctr->counters[row * ctr->stride + idx]);
+	}
+
+	return sum;
+}
+
+/*! \brief Returns the current thread's subcounter. */
+static uint64_t *ctr_local(mod_ctr_t *ctr, uint32_t idx)
+{
+	if (unlikely(stats_thread == 0)) {
+		stats_thread = __sync_add_and_fetch(&stats_threads, 1);
+	}
+
+	uint32_t row = (stats_thread - 1) % ctr->rows;
+	return &ctr->counters[row * ctr->stride + idx];
+}
+
+/*
+ * Rows are shared if there are more threads than rows, so the updates remain
+ * atomic, but without contention they don't bounce cache lines between CPUs.
+ */
 #define STATS_BODY(OPERATION) { \
 	if (mod == NULL) return; \
 	\
 	mod_ctr_t *ctr = mod->stats + ctr_id; \
-	if (ctr->count == 1) { \
-		assert(idx == 0); \
-		OPERATION(&ctr->counter, val); \
-	} else { \
-		assert(idx < ctr->count); \
-		OPERATION(&ctr->counters[idx], val); \
-	} \
+	assert(idx < ctr->count); \
+	OPERATION(ctr_local(ctr, idx), val); \
 }
 
 _public_
@@ -311,7 +354,18 @@ void knotd_mod_stats_decr(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx, uint6
 _public_
 void knotd_mod_stats_store(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx, uint64_t val)
 {
-	STATS_BODY(ATOMIC_SET)
+	if (mod == NULL) {
+		return;
+	}
+
+	/* Not atomic as a whole, the other rows are cleared. */
+	mod_ctr_t *ctr = mod->stats + ctr_id;
+	assert(idx < ctr->count);
+	uint64_t *local = ctr_local(ctr, idx);
+	for (uint32_t row = 0; row < ctr->rows; row++) {
+		uint64_t *cur = &ctr->counters[row * ctr->stride + idx];
+		ATOMIC_SET(cur, (cur == local) ? val : 0);
+	}
 }
 
 _public_
@@ -62,18 +62,24 @@ void query_module_close(knotd_mod_t *module);
 
 typedef char* (*mod_idx_to_str_f)(uint32_t idx, uint32_t count);
 
+/*!
+ * \brief Module statistics counter.
+ *
+ * Each thread updates its own row of subcounters, the rows are aligned to
+ * cache lines to avoid contention. The values are summed when read.
+ */
 typedef struct {
 	const char *name;
-	union {
-		uint64_t counter;
-		struct {
-			uint64_t *counters;
-			mod_idx_to_str_f idx_to_str;
-		};
-	};
-	uint32_t count;
+	mod_idx_to_str_f idx_to_str;
+	uint64_t *counters; /*!< Rows of subcounters, row per thread. */
+	uint32_t count;     /*!< Number of subcounters. */
+	uint32_t stride;    /*!< Row size in subcounters. */
+	uint32_t rows;      /*!< Number of rows. */
 } mod_ctr_t;
 
+/*! \brief Returns the subcounter value summed over all threads. */
+uint64_t mod_ctr_get(const mod_ctr_t *ctr, uint32_t idx);
+
 struct knotd_mod {
 	node_t node;
 	knot_mm_t *mm;
@@ -18,6 +18,7 @@
 
 #include "dnssec/random.h"
 #include "knot/common/log.h"
+#include "knot/conf/zones.h"
 #include "knot/dnssec/zone-events.h"
 #include "knot/events/log.h"
 #include "knot/query/capture.h"
@@ -157,8 +158,8 @@ static int process_normal(conf_t *conf, zone_t *zone, list_t *requests)
 	}
 
 	// Sign update.
-	conf_val_t val = conf_zone_get(conf, C_DNSSEC_SIGNING, zone->name);
-	bool dnssec_enable = (up.flags & UPDATE_SIGN) && conf_bool(&val);
+	bool dnssec_enable = (up.flags & UPDATE_SIGN) &&
+	                     conf_zone(conf, zone->name).dnssec_signing;
 	if (dnssec_enable) {
 		zone_sign_reschedule_t resch = { 0 };
 		ret = knot_dnssec_sign_update(&up, &resch);
@@ -218,18 +219,29 @@ static void process_requests(conf_t *conf, zone_t *zone, list_t *requests)
 	zone_events_schedule_at(zone, ZONE_EVENT_NOTIFY, time(NULL) + 1);
 }
 
-static int remote_forward(conf_t *conf, struct knot_request *request, conf_remote_t *remote)
+/*! \brief Copy the request and assign a new ID. */
+static knot_pkt_t *forward_query(const knot_pkt_t *orig)
 {
-	/* Copy request and assign new ID. */
-	knot_pkt_t *query = knot_pkt_new(NULL, request->query->max_size, NULL);
-	int ret = knot_pkt_copy(query, request->query);
+	knot_pkt_t *query = knot_pkt_new(NULL, orig->max_size, NULL);
+	int ret = knot_pkt_copy(query, orig);
 	if (ret != KNOT_EOK) {
 		knot_pkt_free(&query);
-		return ret;
+		return NULL;
 	}
 	knot_wire_set_id(query->wire, dnssec_random_uint16_t());
 	knot_tsig_append(query->wire, &query->size, query->max_size, query->tsig_rr);
 
+	return query;
+}
+
+static int remote_forward(conf_t *conf, struct knot_request *request, conf_remote_t *remote)
+{
+	/* Copy request and assign new ID. */
+	knot_pkt_t *query = forward_query(request->query);
+	if (query == NULL) {
+		return KNOT_ENOMEM;
+	}
+
 	/* Prepare packet capture layer. */
 	const knot_layer_api_t *capture = query_capture_api();
 	struct capture_param capture_param = {
@@ -238,7 +250,7 @@ static int remote_forward(conf_t *conf, struct knot_request *request, conf_remot
 
 	/* Create requestor instance. */
 	struct knot_requestor re;
-	ret = knot_requestor_init(&re, capture, &capture_param, NULL);
+	int ret = knot_requestor_init(&re, capture, &capture_param, NULL);
 	if (ret != KNOT_EOK) {
 		knot_pkt_free(&query);
 		return ret;
@@ -264,7 +276,25 @@ static int remote_forward(conf_t *conf, struct knot_request *request, conf_remot
 	return ret;
 }
 
-static void forward_request(conf_t *conf, zone_t *zone, struct knot_request *request)
+static void forward_finish(const knot_dname_t *zone_name, struct knot_request *request,
+                           int ret)
+{
+	/* Restore message ID and TSIG. */
+	knot_wire_set_id(request->resp->wire, knot_wire_get_id(request->query->wire));
+	knot_tsig_append(request->resp->wire, &request->resp->size,
+	                 request->resp->max_size, request->resp->tsig_rr);
+
+	/* Set RCODE if forwarding failed. */
+	if (ret != KNOT_EOK) {
+		knot_wire_set_rcode(request->resp->wire, KNOT_RCODE_SERVFAIL);
+		log_zone_error(zone_name, "DDNS, failed to forward updates to the master (%s)",
+		               knot_strerror(ret));
+	} else {
+		log_zone_info(zone_name, "DDNS, updates forwarded to the master");
+	}
+}
+
+static conf_val_t forward_remote(conf_t *conf, zone_t *zone)
 {
 	/* Read the ddns master or the first master. */
 	conf_val_t remote = conf_zone_get(conf, C_DDNS_MASTER, zone->name);
@@ -272,6 +302,13 @@ static void forward_request(conf_t *conf, zone_t *zone, struct knot_request *req
 		remote = conf_zone_get(conf, C_MASTER, zone->name);
 	}
 
+	return remote;
+}
+
+static void forward_request(conf_t *conf, zone_t *zone, struct knot_request *request)
+{
+	conf_val_t remote = forward_remote(conf, zone);
+
 	/* Get the number of remote addresses. */
 	conf_val_t addr = conf_id_get(conf, C_RMT, C_ADDR, &remote);
 	size_t addr_count = conf_val_count(&addr);
@@ -288,19 +325,130 @@ static void forward_request(conf_t *conf, zone_t *zone, struct knot_request *req
 		}
 	}
 
-	/* Restore message ID and TSIG. */
-	knot_wire_set_id(request->resp->wire, knot_wire_get_id(request->query->wire));
-	knot_tsig_append(request->resp->wire, &request->resp->size,
-	                 request->resp->max_size, request->resp->tsig_rr);
+	forward_finish(zone->name, request, ret);
+}
 
-	/* Set RCODE if forwarding failed. */
-	if (ret != KNOT_EOK) {
-		knot_wire_set_rcode(request->resp->wire, KNOT_RCODE_SERVFAIL);
-		log_zone_error(zone->name, "DDNS, failed to forward updates to the master (%s)",
-		               knot_strerror(ret));
+static void send_response(struct knot_request *req, int timeout)
+{
+	if (net_is_stream(req->fd)) {
+		net_dns_tcp_send(req->fd, req->resp->wire, req->resp->size, timeout);
 	} else {
-		log_zone_info(zone->name, "DDNS, updates forwarded to the master");
+		net_dgram_send(req->fd, req->resp->wire, req->resp->size,
+		               (struct sockaddr *)&req->remote);
+	}
+}
+
+static void free_request(struct knot_request *req)
+{
+	close(req->fd);
+	knot_pkt_free(&req->query);
+	knot_pkt_free(&req->resp);
+	free(req);
+}
+
+/*!
+ * \brief Asynchronous forwarding of one update, the addresses are tried in order.
+ *
+ * The response is sent and the update freed from the request loop.
+ */
+struct forward_ctx {
+	struct capture_param capture;
+	struct knot_request *request;   /*!< Forwarded update. */
+	struct knot_request_loop *loop;
+	knot_dname_t *zone;
+	int timeout;
+	size_t count;
+	size_t cur;
+	conf_remote_t remotes[];        /*!< Own copies without the keys. */
+};
+
+static void forward_ctx_free(struct forward_ctx *fwd)
+{
+	knot_dname_free(&fwd->zone, NULL);
+	free(fwd);
+}
+
+static int forward_submit(struct forward_ctx *fwd);
+
+static void forward_done(struct knot_request *req, int ret, void *ctx)
+{
+	struct forward_ctx *fwd = ctx;
+
+	knot_request_free(req, NULL);
+
+	/* Try the next address of the master. */
+	while (ret != KNOT_EOK && ret != KNOT_ENOTRUNNING && ++fwd->cur < fwd->count) {
+		ret = forward_submit(fwd);
+		if (ret == KNOT_EOK) {
+			return;
+		}
+	}
+
+	forward_finish(fwd->zone, fwd->request, ret);
+	send_response(fwd->request, fwd->timeout);
+	free_request(fwd->request);
+	forward_ctx_free(fwd);
+}
+
+static int forward_submit(struct forward_ctx *fwd)
+{
+	const conf_remote_t *remote = &fwd->remotes[fwd->cur];
+
+	knot_pkt_t *query = forward_query(fwd->request->query);
+	if (query == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	const struct sockaddr *dst = (const struct sockaddr *)&remote->addr;
+	const struct sockaddr *src = (const struct sockaddr *)&remote->via;
+	struct knot_request *req = knot_request_make(NULL, dst, src, query, NULL, 0);
+	if (req == NULL) {
+		knot_pkt_free(&query);
+		return KNOT_ENOMEM;
+	}
+
+	int ret = knot_request_loop_submit(fwd->loop, query_capture_api(),
+	                                   &fwd->capture, req, fwd->timeout,
+	                                   forward_done, fwd);
+	if (ret != KNOT_EOK) {
+		knot_request_free(req, NULL);
 	}
+
+	return ret;
+}
+
+static struct forward_ctx *forward_ctx_new(conf_t *conf, zone_t *zone,
+                                           struct knot_request *request)
+{
+	conf_val_t remote = forward_remote(conf, zone);
+	conf_val_t addr = conf_id_get(conf, C_RMT, C_ADDR, &remote);
+	size_t addr_count = conf_val_count(&addr);
+	assert(addr_count > 0);
+
+	struct forward_ctx *fwd = calloc(1, sizeof(*fwd) +
+	                                 addr_count * sizeof(fwd->remotes[0]));
+	if (fwd == NULL) {
+		return NULL;
+	}
+
+	fwd->zone = knot_dname_copy(zone->name, NULL);
+	if (fwd->zone == NULL) {
+		forward_ctx_free(fwd);
+		return NULL;
+	}
+	fwd->capture.sink = request->resp;
+	fwd->request = request;
+	fwd->loop = zone->requests;
+	fwd->timeout = 1000 * conf->cache.srv_tcp_reply_timeout;
+
+	/* The forwarded update keeps its own TSIG. */
+	for (size_t i = 0; i < addr_count; i++) {
+		fwd->remotes[i] = conf_remote(conf, &remote, i);
+		memset(&fwd->remotes[i].key, 0, sizeof(fwd->remotes[i].key));
+	}
+	fwd->count = addr_count;
+
+	return fwd;
 }
 
 static void forward_requests(conf_t *conf, zone_t *zone, list_t *requests)
@@ -308,9 +456,22 @@ static void forward_requests(conf_t *conf, zone_t *zone, list_t *requests)
 	assert(zone);
 	assert(requests);
 
-	ptrnode_t *node = NULL;
-	WALK_LIST(node, *requests) {
+	ptrnode_t *node = NULL, *nxt = NULL;
+	WALK_LIST_DELSAFE(node, nxt, *requests) {
 		struct knot_request *req = node->d;
+
+		/* Asynchronously if possible, the loop takes over the update. */
+		if (zone->requests != NULL) {
+			struct forward_ctx *fwd = forward_ctx_new(conf, zone, req);
+			if (fwd != NULL && forward_submit(fwd) == KNOT_EOK) {
+				ptrlist_rem(node, NULL);
+				continue;
+			}
+			if (fwd != NULL) {
+				forward_ctx_free(fwd);
+			}
+		}
+
 		forward_request(conf, zone, req);
 	}
 }
@@ -342,25 +503,10 @@ static void send_update_response(conf_t *conf, const zone_t *zone, struct knot_r
 			(void)process_query_sign_response(req->resp, &qdata);
 		}
 
-		if (net_is_stream(req->fd)) {
-			int timeout = 1000 * conf->cache.srv_tcp_reply_timeout;
-			net_dns_tcp_send(req->fd, req->resp->wire, req->resp->size,
-			                 timeout);
-		} else {
-			net_dgram_send(req->fd, req->resp->wire, req->resp->size,
-			               (struct sockaddr *)&req->remote);
-		}
+		send_response(req, 1000 * conf->cache.srv_tcp_reply_timeout);
 	}
 }
 
-static void free_request(struct knot_request *req)
-{
-	close(req->fd);
-	knot_pkt_free(&req->query);
-	knot_pkt_free(&req->resp);
-	free(req);
-}
-
 static void send_update_responses(conf_t *conf, const zone_t *zone, list_t *updates)
 {
 	ptrnode_t *node = NULL, *nxt = NULL;
@@ -15,13 +15,25 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <urcu.h>
 
 #include "libknot/attribute.h"
+#include "knot/common/fdset.h"
 #include "knot/query/requestor.h"
 #include "libknot/errcode.h"
+#include "contrib/macros.h"
 #include "contrib/mempattern.h"
 #include "contrib/net.h"
 #include "contrib/sockaddr.h"
+#include "contrib/ucw/lists.h"
+#include "contrib/wire.h"
 
 static bool use_tcp(struct knot_request *request)
 {
@@ -231,16 +243,11 @@ static int request_produce(struct knot_requestor *req,
 	return ret;
 }
 
-static int request_consume(struct knot_requestor *req,
-                           struct knot_request *last,
-                           int timeout_ms)
+/*! \brief Verify the received response and pass it to the processing layer. */
+static int response_consume(struct knot_requestor *req,
+                            struct knot_request *last)
 {
-	int ret = request_recv(last, timeout_ms);
-	if (ret < 0) {
-		return ret;
-	}
-
-	ret = knot_pkt_parse(last->resp, 0);
+	int ret = knot_pkt_parse(last->resp, 0);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -263,6 +270,18 @@ static int request_consume(struct knot_requestor *req,
 	return KNOT_EOK;
 }
 
+static int request_consume(struct knot_requestor *req,
+                           struct knot_request *last,
+                           int timeout_ms)
+{
+	int ret = request_recv(last, timeout_ms);
+	if (ret < 0) {
+		return ret;
+	}
+
+	return response_consume(req, last);
+}
+
 static bool layer_active(knot_layer_state_t state)
 {
 	switch (state) {
@@ -290,6 +309,27 @@ static int request_io(struct knot_requestor *req, struct knot_request *last,
 	}
 }
 
+/*! \brief Check the completed request and finish its processing. */
+static int request_finish(struct knot_requestor *req, struct knot_request *last)
+{
+	int ret = KNOT_EOK;
+
+	/* Expect complete request. */
+	if (req->layer.state != KNOT_STATE_DONE) {
+		ret = KNOT_LAYER_ERROR;
+	}
+
+	/* Verify last TSIG */
+	if (tsig_unsigned_count(&last->tsig) != 0) {
+		ret = KNOT_TSIG_EBADSIG;
+	}
+
+	/* Finish current query processing. */
+	knot_layer_finish(&req->layer);
+
+	return ret;
+}
+
 int knot_requestor_exec(struct knot_requestor *requestor,
                         struct knot_request *request,
                         int timeout_ms)
@@ -311,18 +351,489 @@ int knot_requestor_exec(struct knot_requestor *requestor,
 		}
 	}
 
-	/* Expect complete request. */
-	if (requestor->layer.state != KNOT_STATE_DONE) {
-		ret = KNOT_LAYER_ERROR;
+	return request_finish(requestor, request);
+}
+
+/*! \brief Sweep interval of the request loop (milliseconds). */
+#define LOOP_SWEEP_INTERVAL 1000
+
+/*! \brief Asynchronously processed request. */
+typedef struct {
+	node_t n;
+	struct knot_requestor requestor;
+	struct knot_request *request;
+	int timeout;          /*!< Timeout of each operation (seconds). */
+	knot_request_cb cb;
+	void *cb_ctx;
+	bool sending;         /*!< The query is being sent. */
+	bool reconnected;     /*!< The socket changed since the last wait. */
+	fdset_t *set;         /*!< Set watching the socket during I/O, or NULL. */
+	unsigned idx;         /*!< Index of the socket in the set. */
+	size_t pos;           /*!< Sent or received bytes of the message. */
+	uint8_t len[2];       /*!< DNS over TCP message length. */
+	int ret;
+} request_exch_t;
+
+/*! \brief Request loop thread with its own set of sockets. */
+typedef struct {
+	pthread_t thread;
+	pthread_mutex_t mx;
+	list_t queue;         /*!< Submitted requests, not yet started. */
+	bool stop;
+	int pipe[2];          /*!< Wake-up pipe. */
+	fdset_t set;          /*!< Sockets of the running requests. */
+} loop_thread_t;
+
+struct knot_request_loop {
+	unsigned count;
+	unsigned next;
+	loop_thread_t threads[];
+};
+
+static void exch_finish(request_exch_t *ex, int ret)
+{
+	struct knot_requestor *req = &ex->requestor;
+
+	if (ret == KNOT_EOK) {
+		ret = request_finish(req, ex->request);
+	} else {
+		knot_layer_finish(&req->layer);
 	}
 
-	/* Verify last TSIG */
-	if (tsig_unsigned_count(&request->tsig) != 0) {
-		ret = KNOT_TSIG_EBADSIG;
+	ex->cb(ex->request, ret, ex->cb_ctx);
+	free(ex);
+}
+
+/*!
+ * \brief Run the processing layer until an I/O is needed.
+ *
+ * \return Events to wait for, 0 if finished (result in ex->ret).
+ */
+static unsigned exch_run(request_exch_t *ex)
+{
+	struct knot_requestor *req = &ex->requestor;
+	struct knot_request *last = ex->request;
+
+	while (layer_active(req->layer.state)) {
+		int fd = last->fd;
+		int ret = KNOT_EOK;
+		switch (req->layer.state) {
+		case KNOT_STATE_PRODUCE:
+			knot_layer_produce(&req->layer, last->query);
+			ret = tsig_sign_packet(&last->tsig, last->query);
+			if (ret == KNOT_EOK && req->layer.state == KNOT_STATE_CONSUME) {
+				ret = request_ensure_connected(last);
+				ex->sending = true;
+				ex->pos = 0;
+			}
+			break;
+		case KNOT_STATE_CONSUME:
+			return ex->sending ? POLLOUT : POLLIN;
+		case KNOT_STATE_RESET:
+			/* The socket may be closed, unwatch it first. */
+			if (ex->set != NULL && (req->layer.flags & KNOT_RQ_LAYER_CLOSE)) {
+				ret = fdset_unwatch(ex->set, ex->idx);
+				ex->set = NULL;
+			}
+			if (ret == KNOT_EOK) {
+				ret = request_reset(req, last);
+			}
+			break;
+		default:
+			break;
+		}
+		if (last->fd != fd) {
+			ex->reconnected = true;
+		}
+		if (ret != KNOT_EOK) {
+			ex->ret = ret;
+			return 0;
+		}
 	}
 
-	/* Finish current query processing. */
-	knot_layer_finish(&requestor->layer);
+	ex->ret = KNOT_EOK;
+	return 0;
+}
 
-	return ret;
+/*! \brief Continue sending the query, KNOT_EAGAIN if not complete. */
+static int exch_send(request_exch_t *ex)
+{
+	struct knot_request *last = ex->request;
+	knot_pkt_t *query = last->query;
+
+	if (!use_tcp(last)) {
+		ssize_t ret = send(last->fd, query->wire, query->size, 0);
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return KNOT_EAGAIN;
+		}
+		return (ret == query->size) ? KNOT_EOK : KNOT_ECONN;
+	}
+
+	/* Check the non-blocking connect on the first write. */
+	if (ex->pos == 0) {
+		if (!net_is_connected(last->fd)) {
+			return KNOT_ECONN;
+		}
+		wire_write_u16(ex->len, query->size);
+	}
+
+	while (ex->pos < sizeof(ex->len) + query->size) {
+		struct iovec iov[2];
+		int iovcnt = 0;
+		if (ex->pos < sizeof(ex->len)) {
+			iov[iovcnt].iov_base = ex->len + ex->pos;
+			iov[iovcnt++].iov_len = sizeof(ex->len) - ex->pos;
+			iov[iovcnt].iov_base = query->wire;
+			iov[iovcnt++].iov_len = query->size;
+		} else {
+			size_t off = ex->pos - sizeof(ex->len);
+			iov[iovcnt].iov_base = query->wire + off;
+			iov[iovcnt++].iov_len = query->size - off;
+		}
+
+		ssize_t ret = writev(last->fd, iov, iovcnt);
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return KNOT_EAGAIN;
+		} else if (ret <= 0) {
+			return KNOT_ECONN;
+		}
+		ex->pos += ret;
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Continue receiving the response, KNOT_EAGAIN if not complete. */
+static int exch_recv(request_exch_t *ex)
+{
+	struct knot_request *last = ex->request;
+	knot_pkt_t *resp = last->resp;
+
+	if (ex->pos == 0) {
+		knot_pkt_clear(resp);
+	}
+
+	if (!use_tcp(last)) {
+		ssize_t ret = recv(last->fd, resp->wire, resp->max_size, 0);
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return KNOT_EAGAIN;
+		} else if (ret <= 0) {
+			return KNOT_ECONN;
+		}
+		resp->size = ret;
+		return KNOT_EOK;
+	}
+
+	while (true) {
+		uint8_t *buf;
+		size_t len;
+		if (ex->pos < sizeof(ex->len)) {
+			buf = ex->len + ex->pos;
+			len = sizeof(ex->len) - ex->pos;
+		} else {
+			size_t msg_len = wire_read_u16(ex->len);
+			if (msg_len > resp->max_size) {
+				return KNOT_ESPACE;
+			}
+			size_t off = ex->pos - sizeof(ex->len);
+			if (off == msg_len) {
+				resp->size = msg_len;
+				return KNOT_EOK;
+			}
+			buf = resp->wire + off;
+			len = msg_len - off;
+		}
+
+		ssize_t ret = recv(last->fd, buf, len, 0);
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return KNOT_EAGAIN;
+		} else if (ret <= 0) {
+			return KNOT_ECONN;
+		}
+		ex->pos += ret;
+	}
+}
+
+/*!
+ * \brief Process the socket events of the request.
+ *
+ * \return Events to wait for, 0 if finished (result in ex->ret).
+ */
+static unsigned exch_io(request_exch_t *ex)
+{
+	int ret;
+	if (ex->sending) {
+		ret = exch_send(ex);
+		if (ret == KNOT_EOK) {
+			ex->sending = false;
+			ex->pos = 0;
+			return POLLIN;
+		}
+	} else {
+		ret = exch_recv(ex);
+		if (ret == KNOT_EOK) {
+			ex->pos = 0;
+			ret = response_consume(&ex->requestor, ex->request);
+			if (ret == KNOT_EOK) {
+				return exch_run(ex);
+			}
+		}
+	}
+
+	if (ret == KNOT_EAGAIN) {
+		return ex->sending ? POLLOUT : POLLIN;
+	}
+
+	ex->ret = ret;
+	return 0;
+}
+
+/*! \brief Start watching the request socket, finish the request on error. */
+static void loop_watch(loop_thread_t *t, request_exch_t *ex, unsigned events)
+{
+	ex->reconnected = false;
+
+	int i = fdset_add(&t->set, ex->request->fd, events, ex);
+	if (i < 0) {
+		exch_finish(ex, i);
+		return;
+	}
+	fdset_set_watchdog(&t->set, i, ex->timeout);
+}
+
+static void loop_start(loop_thread_t *t)
+{
+	list_t queue;
+	init_list(&queue);
+
+	pthread_mutex_lock(&t->mx);
+	add_tail_list(&queue, &t->queue);
+	init_list(&t->queue);
+	pthread_mutex_unlock(&t->mx);
+
+	request_exch_t *ex = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(ex, next, queue) {
+		ex->requestor.layer.tsig = &ex->request->tsig;
+		unsigned events = exch_run(ex);
+		if (events == 0) {
+			exch_finish(ex, ex->ret);
+		} else {
+			loop_watch(t, ex, events);
+		}
+	}
+}
+
+static enum fdset_sweep_state loop_sweep(fdset_t *set, int i, void *data)
+{
+	request_exch_t *ex = set->ctx[i];
+	if (ex == NULL) {
+		return FDSET_KEEP;
+	}
+
+	int ret = fdset_unwatch(set, i);
+	exch_finish(ex, (ret == KNOT_EOK) ? KNOT_ETIMEOUT : ret);
+
+	return FDSET_SWEEP;
+}
+
+static void loop_wait(loop_thread_t *t)
+{
+	fdset_it_t it;
+	(void)fdset_poll(&t->set, &it, LOOP_SWEEP_INTERVAL);
+
+	for (; !fdset_it_done(&it); fdset_it_next(&it)) {
+		unsigned i = fdset_it_get_idx(&it);
+		request_exch_t *ex = t->set.ctx[i];
+
+		/* Wake-up pipe. */
+		if (ex == NULL) {
+			uint8_t buf[64];
+			while (read(t->pipe[0], buf, sizeof(buf)) > 0);
+			continue;
+		}
+
+		ex->set = &t->set;
+		ex->idx = i;
+		unsigned events = exch_io(ex);
+		ex->set = NULL;
+		if (events == 0 || ex->reconnected) {
+			int ret = fdset_it_remove(&it);
+			if (ret != KNOT_EOK && events != 0) {
+				ex->ret = ret;
+				events = 0;
+			}
+		}
+		if (events == 0) {
+			exch_finish(ex, ex->ret);
+		} else if (ex->reconnected) {
+			loop_watch(t, ex, events);
+		} else {
+			fdset_set_events(&t->set, i, events);
+			fdset_set_watchdog(&t->set, i, ex->timeout);
+		}
+	}
+	fdset_it_commit(&it);
+}
+
+static void *loop_thread(void *arg)
+{
+	loop_thread_t *t = arg;
+
+	/* The completion callbacks may read the zones and the configuration. */
+	rcu_register_thread();
+
+	while (true) {
+		loop_wait(t);
+
+		pthread_mutex_lock(&t->mx);
+		bool stop = t->stop;
+		pthread_mutex_unlock(&t->mx);
+		if (stop) {
+			break;
+		}
+
+		loop_start(t);
+		fdset_sweep(&t->set, &loop_sweep, NULL);
+	}
+
+	/* Cancel the remaining requests. */
+	for (unsigned i = 0; i < t->set.n; ++i) {
+		request_exch_t *ex = t->set.ctx[i];
+		if (ex != NULL) {
+			(void)fdset_unwatch(&t->set, i); /* The set is destroyed anyway. */
+			exch_finish(ex, KNOT_ENOTRUNNING);
+		}
+	}
+	request_exch_t *ex = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(ex, next, t->queue) {
+		exch_finish(ex, KNOT_ENOTRUNNING);
+	}
+
+	rcu_unregister_thread();
+
+	return NULL;
+}
+
+static void loop_thread_deinit(loop_thread_t *t)
+{
+	fdset_clear(&t->set);
+	if (t->pipe[0] >= 0) {
+		close(t->pipe[0]);
+		close(t->pipe[1]);
+	}
+	pthread_mutex_destroy(&t->mx);
+}
+
+static int loop_thread_init(loop_thread_t *t)
+{
+	t->pipe[0] = t->pipe[1] = -1;
+	init_list(&t->queue);
+
+	if (pthread_mutex_init(&t->mx, NULL) != 0) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = fdset_init(&t->set, FDSET_INIT_SIZE);
+	if (ret == KNOT_EOK && pipe(t->pipe) != 0) {
+		ret = knot_map_errno();
+	}
+	if (ret == KNOT_EOK) {
+		fcntl(t->pipe[0], F_SETFL, O_NONBLOCK);
+		ret = fdset_add(&t->set, t->pipe[0], POLLIN, NULL);
+	}
+	if (ret < 0) {
+		loop_thread_deinit(t);
+		return ret;
+	}
+
+	if (pthread_create(&t->thread, NULL, loop_thread, t) != 0) {
+		loop_thread_deinit(t);
+		return KNOT_ENOMEM;
+	}
+
+	return KNOT_EOK;
+}
+
+struct knot_request_loop *knot_request_loop_create(unsigned threads)
+{
+	if (threads == 0) {
+		return NULL;
+	}
+
+	struct knot_request_loop *loop = calloc(1, sizeof(*loop) +
+	                                        threads * sizeof(loop_thread_t));
+	if (loop == NULL) {
+		return NULL;
+	}
+
+	for (unsigned i = 0; i < threads; ++i) {
+		if (loop_thread_init(&loop->threads[i]) != KNOT_EOK) {
+			knot_request_loop_destroy(loop);
+			return NULL;
+		}
+		loop->count++;
+	}
+
+	return loop;
+}
+
+void knot_request_loop_destroy(struct knot_request_loop *loop)
+{
+	if (loop == NULL) {
+		return;
+	}
+
+	for (unsigned i = 0; i < loop->count; ++i) {
+		loop_thread_t *t = &loop->threads[i];
+		pthread_mutex_lock(&t->mx);
+		t->stop = true;
+		pthread_mutex_unlock(&t->mx);
+		(void)write(t->pipe[1], "", 1);
+	}
+
+	for (unsigned i = 0; i < loop->count; ++i) {
+		pthread_join(loop->threads[i].thread, NULL);
+		loop_thread_deinit(&loop->threads[i]);
+	}
+
+	free(loop);
+}
+
+int knot_request_loop_submit(struct knot_request_loop *loop,
+                             const knot_layer_api_t *proc, void *proc_param,
+                             struct knot_request *request, int timeout_ms,
+                             knot_request_cb cb, void *cb_ctx)
+{
+	if (loop == NULL || proc == NULL || request == NULL || cb == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	request_exch_t *ex = calloc(1, sizeof(*ex));
+	if (ex == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	knot_requestor_init(&ex->requestor, proc, proc_param, NULL);
+	ex->request = request;
+	ex->timeout = (timeout_ms < 0) ? -1 : MAX((timeout_ms + 999) / 1000, 1);
+	ex->cb = cb;
+	ex->cb_ctx = cb_ctx;
+
+	/* Distribute the requests among the threads. */
+	unsigned idx = __sync_fetch_and_add(&loop->next, 1) % loop->count;
+	loop_thread_t *t = &loop->threads[idx];
+
+	pthread_mutex_lock(&t->mx);
+	if (t->stop) {
+		pthread_mutex_unlock(&t->mx);
+		knot_layer_finish(&ex->requestor.layer);
+		free(ex);
+		return KNOT_ENOTRUNNING;
+	}
+	add_tail(&t->queue, &ex->n);
+	pthread_mutex_unlock(&t->mx);
+
+	(void)write(t->pipe[1], "", 1);
+
+	return KNOT_EOK;
 }
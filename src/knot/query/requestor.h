@@ -117,3 +117,59 @@ void knot_requestor_clear(struct knot_requestor *requestor);
 int knot_requestor_exec(struct knot_requestor *requestor,
                         struct knot_request *request,
                         int timeout_ms);
+
+/*! \brief Event loop processing requests asynchronously. */
+struct knot_request_loop;
+
+/*!
+ * \brief Completion callback of an asynchronous request.
+ *
+ * The callback is called from the loop thread and takes over the request.
+ * The loop threads are registered with RCU.
+ *
+ * \param request  Completed request.
+ * \param ret      Result, same as of knot_requestor_exec().
+ * \param ctx      Callback context.
+ */
+typedef void (*knot_request_cb)(struct knot_request *request, int ret, void *ctx);
+
+/*!
+ * \brief Create request loop and start its threads.
+ *
+ * Each thread multiplexes I/O of its requests over non-blocking sockets.
+ *
+ * \param threads  Number of loop threads.
+ *
+ * \return Request loop or NULL in case of error.
+ */
+struct knot_request_loop *knot_request_loop_create(unsigned threads);
+
+/*!
+ * \brief Stop the request loop threads and free the loop.
+ *
+ * Pending requests are completed with KNOT_ENOTRUNNING.
+ *
+ * \param loop  Request loop.
+ */
+void knot_request_loop_destroy(struct knot_request_loop *loop);
+
+/*!
+ * \brief Submit a request for asynchronous execution.
+ *
+ * The request must be made with a NULL memory context.
+ *
+ * \param loop        Request loop.
+ * \param proc        Response processing module.
+ * \param proc_param  Processing module context, valid until completion.
+ * \param request     Request instance.
+ * \param timeout_ms  Timeout of each operation in miliseconds (-1 for infinity),
+ *                    rounded up to whole seconds.
+ * \param cb          Completion callback.
+ * \param cb_ctx      Callback context.
+ *
+ * \return KNOT_EOK or error (the callback isn't called then).
+ */
+int knot_request_loop_submit(struct knot_request_loop *loop,
+                             const knot_layer_api_t *proc, void *proc_param,
+                             struct knot_request *request, int timeout_ms,
+                             knot_request_cb cb, void *cb_ctx);
@@ -38,6 +38,9 @@
 #include "contrib/sockaddr.h"
 #include "contrib/trim.h"
 
+/*! \brief Number of threads multiplexing asynchronous outgoing requests. */
+#define REQUEST_LOOP_THREADS 2
+
 /*! \brief Minimal send/receive buffer sizes. */
 enum {
 	UDP_MIN_RCVSIZE = 4096,
@@ -416,6 +419,13 @@ int server_init(server_t *server, int bg_workers)
 		return KNOT_ENOMEM;
 	}
 
+	server->requests = knot_request_loop_create(REQUEST_LOOP_THREADS);
+	if (server->requests == NULL) {
+		worker_pool_destroy(server->workers);
+		evsched_deinit(&server->sched);
+		return KNOT_ENOMEM;
+	}
+
 	char *journal_dir = conf_journalfile(conf());
 	conf_val_t journal_size = conf_default_get(conf(), C_MAX_JOURNAL_DB_SIZE);
 	conf_val_t journal_mode = conf_default_get(conf(), C_JOURNAL_DB_MODE);
@@ -423,6 +433,7 @@ int server_init(server_t *server, int bg_workers)
 	                          conf_int(&journal_size), conf_opt(&journal_mode));
 	free(journal_dir);
 	if (ret != KNOT_EOK) {
+		knot_request_loop_destroy(server->requests);
 		worker_pool_destroy(server->workers);
 		evsched_deinit(&server->sched);
 		return ret;
@@ -434,6 +445,7 @@ int server_init(server_t *server, int bg_workers)
 	free(kasp_dir);
 	if (ret != KNOT_EOK) {
 		journal_db_close(&server->journal_db);
+		knot_request_loop_destroy(server->requests);
 		worker_pool_destroy(server->workers);
 		evsched_deinit(&server->sched);
 		return ret;
@@ -457,7 +469,8 @@ void server_deinit(server_t *server)
 		free(server->ifaces);
 	}
 
-	/* Free threads and event handlers. */
+	/* Free threads and event handlers, request completions resume events. */
+	knot_request_loop_destroy(server->requests);
 	worker_pool_destroy(server->workers);
 
 	/* Free zone database. */
@@ -661,7 +674,7 @@ int server_reload(server_t *server)
 		                      &new_conf->query_plan);
 	}
 
-	conf_update_flag_t upd_flags = CONF_UPD_FNOFREE;
+	conf_update_flag_t upd_flags = CONF_UPD_FNOFREE | CONF_UPD_FZONES;
 	if (full) {
 		upd_flags |= CONF_UPD_FCONFIO;
 	}
@@ -907,6 +920,7 @@ ref_t *server_set_ifaces(server_t *server, fdset_t *fds, int index, int thread_i
 
 	rcu_read_lock();
 	fdset_clear(fds);
+	fdset_init(fds, list_size(&server->ifaces->l));
 
 	iface_t *i = NULL;
 	WALK_LIST(i, server->ifaces->l) {
@@ -33,6 +33,7 @@
 #include "knot/common/evsched.h"
 #include "knot/common/fdset.h"
 #include "knot/dnssec/kasp/kasp_db.h"
+#include "knot/query/requestor.h"
 #include "knot/server/dthreads.h"
 #include "knot/common/ref.h"
 #include "knot/worker/pool.h"
@@ -107,12 +108,18 @@ typedef struct server {
 	/*! \brief Background jobs. */
 	worker_pool_t *workers;
 
+	/*! \brief Asynchronous outgoing requests. */
+	struct knot_request_loop *requests;
+
 	/*! \brief Event scheduler. */
 	evsched_t sched;
 
 	/*! \brief List of interfaces. */
 	ifacelist_t *ifaces;
 
+	/*! \brief UDP queries dropped by the I/O backend. */
+	uint64_t udp_dropped;
+
 } server_t;
 
 /*!
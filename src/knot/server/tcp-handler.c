@@ -45,12 +45,48 @@
 #include "contrib/sockaddr.h"
 #include "contrib/time.h"
 #include "contrib/ucw/mempool.h"
+#include "contrib/wire.h"
+
+#define TCP_MSG_MAX  (sizeof(uint16_t) + KNOT_WIRE_MAX_PKTSIZE)
+#define TCP_RX_INIT  512               /*!< Initial connection RX buffer size. */
+#define TCP_TX_HIWAT (2 * TCP_MSG_MAX) /*!< Output queue limit for new answers. */
+
+/*! \brief Queued part of a length-prefixed outgoing message. */
+typedef struct tcp_outbuf {
+	struct tcp_outbuf *next;         /*!< Next queued message. */
+	size_t len;                      /*!< Message length (with prefix). */
+	size_t sent;                     /*!< Already sent bytes. */
+	uint8_t data[];                  /*!< Message data. */
+} tcp_outbuf_t;
+
+/*! \brief Zone transfer being streamed over a connection. */
+typedef struct {
+	knot_layer_t layer;              /*!< Transfer processing layer. */
+	knot_mm_t mm;                    /*!< Transfer memory context. */
+	knot_pkt_t *query;               /*!< Transfer query. */
+	knot_pkt_t *ans;                 /*!< Transfer answer buffer. */
+} tcp_stream_t;
+
+/*! \brief TCP connection state. */
+typedef struct {
+	struct sockaddr_storage addr;    /*!< Remote address. */
+	knotd_qdata_params_t params;     /*!< Query processing parameters. */
+	uint8_t *rx;                     /*!< Received, not processed data. */
+	size_t rx_len;                   /*!< Length of the received data. */
+	size_t rx_size;                  /*!< Size of the RX buffer. */
+	tcp_outbuf_t *tx_head;           /*!< First queued outgoing message. */
+	tcp_outbuf_t *tx_tail;           /*!< Last queued outgoing message. */
+	size_t tx_len;                   /*!< Total length of queued messages. */
+	tcp_stream_t *stream;            /*!< Zone transfer in progress. */
+	bool progress;                   /*!< Any message answered or sent. */
+	bool eof;                        /*!< Remote end closed for writing. */
+} tcp_conn_t;
 
 /*! \brief TCP context data. */
 typedef struct tcp_context {
 	knot_layer_t layer;              /*!< Query processing layer. */
 	server_t *server;                /*!< Name server structure. */
-	struct iovec iov[2];             /*!< TX/RX buffers. */
+	uint8_t *tx_buf;                 /*!< Answer buffer. */
 	unsigned client_threshold;       /*!< Index of first TCP client. */
 	struct timespec last_poll_time;  /*!< Time of the last socket poll. */
 	struct timespec throttle_end;    /*!< End of accept() throttling. */
@@ -69,12 +105,78 @@ static inline int tcp_throttle(void) {
 	return TCP_THROTTLE_LO + (dnssec_random_uint16_t() % TCP_THROTTLE_HI);
 }
 
+static void tcp_stream_free(tcp_stream_t *stream)
+{
+	if (stream == NULL) {
+		return;
+	}
+
+	knot_layer_finish(&stream->layer);
+	knot_pkt_free(&stream->query);
+	knot_pkt_free(&stream->ans);
+	mp_delete(stream->mm.ctx);
+	free(stream);
+}
+
+static tcp_conn_t *tcp_conn_new(tcp_context_t *tcp, int fd)
+{
+	tcp_conn_t *conn = calloc(1, sizeof(*conn));
+	if (conn == NULL) {
+		return NULL;
+	}
+
+	/* Receive peer name. */
+	socklen_t addrlen = sizeof(conn->addr);
+	if (getpeername(fd, (struct sockaddr *)&conn->addr, &addrlen) < 0) {
+		;
+	}
+
+	conn->params.remote = &conn->addr;
+	conn->params.socket = fd;
+	conn->params.server = tcp->server;
+	conn->params.thread_id = tcp->thread_id;
+
+	return conn;
+}
+
+static void tcp_conn_free(tcp_conn_t *conn)
+{
+	if (conn == NULL) {
+		return;
+	}
+
+	tcp_outbuf_t *buf = conn->tx_head;
+	while (buf != NULL) {
+		tcp_outbuf_t *next = buf->next;
+		free(buf);
+		buf = next;
+	}
+
+	tcp_stream_free(conn->stream);
+	free(conn->rx);
+	free(conn);
+}
+
+/*! \brief Close the connection and release its state. */
+static void tcp_conn_close(fdset_t *set, unsigned i)
+{
+	/* Unwatch first, a closed descriptor can't be removed from epoll. */
+	int fd = fdset_get_fd(set, i);
+	int ret = fdset_unwatch(set, i);
+	if (ret != KNOT_EOK) {
+		log_error("TCP, failed to unwatch connection (%s)", knot_strerror(ret));
+	}
+	close(fd);
+	tcp_conn_free(set->ctx[i]);
+	set->ctx[i] = NULL;
+}
+
 /*! \brief Sweep TCP connection. */
 static enum fdset_sweep_state tcp_sweep(fdset_t *set, int i, void *data)
 {
 	UNUSED(data);
 	assert(set && i < set->n && i >= 0);
-	int fd = set->pfd[i].fd;
+	int fd = fdset_get_fd(set, i);
 
 	/* Best-effort, name and shame. */
 	struct sockaddr_storage ss;
@@ -85,7 +187,7 @@ static enum fdset_sweep_state tcp_sweep(fdset_t *set, int i, void *data)
 		log_notice("TCP, terminated inactive client, address %s", addr_str);
 	}
 
-	close(fd);
+	tcp_conn_close(set, i);
 
 	return FDSET_SWEEP;
 }
@@ -100,68 +202,238 @@ static bool tcp_send_state(int state)
 	return (state != KNOT_STATE_FAIL && state != KNOT_STATE_NOOP);
 }
 
+static bool tcp_is_transfer(const knot_pkt_t *query)
+{
+	if (knot_wire_get_opcode(query->wire) != KNOT_OPCODE_QUERY) {
+		return false;
+	}
+
+	uint16_t qtype = knot_pkt_qtype(query);
+	return (qtype == KNOT_RRTYPE_AXFR || qtype == KNOT_RRTYPE_IXFR);
+}
+
+/*! \brief Check if the RX buffer starts with a complete message. */
+static bool tcp_msg_ready(const tcp_conn_t *conn)
+{
+	return conn->rx_len >= sizeof(uint16_t) &&
+	       conn->rx_len >= sizeof(uint16_t) + wire_read_u16(conn->rx);
+}
+
 /*!
- * \brief TCP event handler function.
+ * \brief Send queued messages without blocking.
+ *
+ * \retval KNOT_EOK if sent or the socket would block.
+ * \retval KNOT_ECONN on connection error.
  */
-static int tcp_handle(tcp_context_t *tcp, int fd,
-                      struct iovec *rx, struct iovec *tx)
+static int tcp_conn_flush(int fd, tcp_conn_t *conn)
 {
-	/* Create query processing parameter. */
-	struct sockaddr_storage ss = { 0 };
-	knotd_qdata_params_t params = {
-		.remote = &ss,
-		.socket = fd,
-		.server = tcp->server,
-		.thread_id = tcp->thread_id
-	};
-
-	rx->iov_len = KNOT_WIRE_MAX_PKTSIZE;
-	tx->iov_len = KNOT_WIRE_MAX_PKTSIZE;
+	while (conn->tx_head != NULL) {
+		tcp_outbuf_t *buf = conn->tx_head;
+		ssize_t ret = send(fd, buf->data + buf->sent, buf->len - buf->sent,
+		                   MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return (errno == EAGAIN || errno == EWOULDBLOCK) ?
+			       KNOT_EOK : KNOT_ECONN;
+		}
 
-	/* Receive peer name. */
-	socklen_t addrlen = sizeof(struct sockaddr_storage);
-	if (getpeername(fd, (struct sockaddr *)&ss, &addrlen) < 0) {
-		;
+		conn->progress = true;
+		buf->sent += ret;
+		conn->tx_len -= ret;
+		if (buf->sent < buf->len) {
+			return KNOT_EOK;
+		}
+
+		conn->tx_head = buf->next;
+		if (conn->tx_head == NULL) {
+			conn->tx_tail = NULL;
+		}
+		free(buf);
 	}
 
-	/* Timeout. */
-	rcu_read_lock();
-	int timeout = 1000 * conf()->cache.srv_tcp_reply_timeout;
-	rcu_read_unlock();
+	return KNOT_EOK;
+}
 
-	/* Receive data. */
-	int ret = net_dns_tcp_recv(fd, rx->iov_base, rx->iov_len, timeout);
-	if (ret <= 0) {
-		if (ret == KNOT_EAGAIN) {
-			char addr_str[SOCKADDR_STRLEN] = {0};
-			sockaddr_tostr(addr_str, sizeof(addr_str), (struct sockaddr *)&ss);
-			log_warning("TCP, connection timed out, address %s",
-			            addr_str);
+/*!
+ * \brief Send a DNS message, queue the unsent rest if the socket would block.
+ */
+static int tcp_conn_send(int fd, tcp_conn_t *conn, const uint8_t *wire, size_t size)
+{
+	uint8_t prefix[sizeof(uint16_t)];
+	wire_write_u16(prefix, size);
+
+	size_t total = sizeof(prefix) + size;
+	ssize_t sent = 0;
+
+	/* Try to send right away if nothing is queued. */
+	if (conn->tx_head == NULL) {
+		struct iovec iov[2] = {
+			{ .iov_base = prefix, .iov_len = sizeof(prefix) },
+			{ .iov_base = (void *)wire, .iov_len = size }
+		};
+		struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+		do {
+			sent = sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+		} while (sent < 0 && errno == EINTR);
+		if (sent < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				return KNOT_ECONN;
+			}
+			sent = 0;
+		} else {
+			conn->progress = true;
+		}
+		if (sent == total) {
+			return KNOT_EOK;
 		}
-		return KNOT_ECONNREFUSED;
+	}
+
+	/* Queue the rest. */
+	tcp_outbuf_t *buf = malloc(sizeof(*buf) + total);
+	if (buf == NULL) {
+		return KNOT_ENOMEM;
+	}
+	buf->next = NULL;
+	buf->len = total;
+	buf->sent = sent;
+	memcpy(buf->data, prefix, sizeof(prefix));
+	memcpy(buf->data + sizeof(prefix), wire, size);
+
+	if (conn->tx_tail != NULL) {
+		conn->tx_tail->next = buf;
 	} else {
-		rx->iov_len = ret;
+		conn->tx_head = buf;
+	}
+	conn->tx_tail = buf;
+	conn->tx_len += total - sent;
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Receive available data without blocking.
+ */
+static int tcp_conn_read(int fd, tcp_conn_t *conn)
+{
+	/* Make room for the whole pending message. */
+	size_t need = TCP_RX_INIT;
+	if (conn->rx_len >= sizeof(uint16_t)) {
+		need = MAX(need, sizeof(uint16_t) + wire_read_u16(conn->rx));
+	}
+	if (conn->rx_size < need) {
+		uint8_t *rx = realloc(conn->rx, need);
+		if (rx == NULL) {
+			return KNOT_ENOMEM;
+		}
+		conn->rx = rx;
+		conn->rx_size = need;
+	}
+
+	if (conn->rx_len == conn->rx_size) {
+		return KNOT_EOK;
+	}
+
+	ssize_t ret;
+	do {
+		ret = recv(fd, conn->rx + conn->rx_len, conn->rx_size - conn->rx_len,
+		           MSG_DONTWAIT);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret > 0) {
+		conn->rx_len += ret;
+	} else if (ret == 0) {
+		conn->eof = true;
+	} else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+		return KNOT_ECONN;
+	}
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Produce next zone transfer messages until the output queue fills up.
+ */
+static int tcp_stream_pump(int fd, tcp_conn_t *conn)
+{
+	while (conn->stream != NULL && conn->tx_len < TCP_TX_HIWAT) {
+		tcp_stream_t *stream = conn->stream;
+		if (!tcp_active_state(stream->layer.state)) {
+			tcp_stream_free(stream);
+			conn->stream = NULL;
+			break;
+		}
+
+		knot_layer_produce(&stream->layer, stream->ans);
+		/* Send, if response generation passed and wasn't ignored. */
+		if (stream->ans->size > 0 && tcp_send_state(stream->layer.state)) {
+			int ret = tcp_conn_send(fd, conn, stream->ans->wire,
+			                        stream->ans->size);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+		}
 	}
 
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Start a zone transfer, it's answered from its own processing context
+ *        so that other pipelined queries can be served in the meantime.
+ */
+static int tcp_stream_start(tcp_conn_t *conn, const uint8_t *wire, size_t len)
+{
+	tcp_stream_t *stream = calloc(1, sizeof(*stream));
+	if (stream == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	mm_ctx_mempool(&stream->mm, 16 * MM_DEFAULT_BLKSIZE);
+	knot_layer_init(&stream->layer, &stream->mm, process_query_layer());
+
+	stream->query = knot_pkt_new(NULL, len, &stream->mm);
+	stream->ans = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, &stream->mm);
+	if (stream->query == NULL || stream->ans == NULL) {
+		tcp_stream_free(stream);
+		return KNOT_ENOMEM;
+	}
+	memcpy(stream->query->wire, wire, len);
+	stream->query->size = len;
+
+	knot_layer_begin(&stream->layer, &conn->params);
+	(void) knot_pkt_parse(stream->query, 0);
+	knot_layer_consume(&stream->layer, stream->query);
+
+	conn->stream = stream;
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Answer a single query from the thread processing context.
+ */
+static int tcp_handle(tcp_context_t *tcp, int fd, tcp_conn_t *conn,
+                      knot_pkt_t *query)
+{
 	/* Initialize processing layer. */
-	knot_layer_begin(&tcp->layer, &params);
+	knot_layer_begin(&tcp->layer, &conn->params);
 
-	/* Create packets. */
-	knot_pkt_t *ans = knot_pkt_new(tx->iov_base, tx->iov_len, tcp->layer.mm);
-	knot_pkt_t *query = knot_pkt_new(rx->iov_base, rx->iov_len, tcp->layer.mm);
+	knot_pkt_t *ans = knot_pkt_new(tcp->tx_buf, KNOT_WIRE_MAX_PKTSIZE,
+	                               tcp->layer.mm);
 
 	/* Input packet. */
-	(void) knot_pkt_parse(query, 0);
 	knot_layer_consume(&tcp->layer, query);
 
 	/* Resolve until NOOP or finished. */
-	ret = KNOT_EOK;
+	int ret = KNOT_EOK;
 	while (tcp_active_state(tcp->layer.state)) {
 		knot_layer_produce(&tcp->layer, ans);
 		/* Send, if response generation passed and wasn't ignored. */
 		if (ans->size > 0 && tcp_send_state(tcp->layer.state)) {
-			if (net_dns_tcp_send(fd, ans->wire, ans->size, timeout) != ans->size) {
-				ret = KNOT_ECONNREFUSED;
+			ret = tcp_conn_send(fd, conn, ans->wire, ans->size);
+			if (ret != KNOT_EOK) {
 				break;
 			}
 		}
@@ -170,13 +442,76 @@ static int tcp_handle(tcp_context_t *tcp, int fd,
 	/* Reset after processing. */
 	knot_layer_finish(&tcp->layer);
 
-	/* Cleanup. */
-	knot_pkt_free(&query);
 	knot_pkt_free(&ans);
 
 	return ret;
 }
 
+/*!
+ * \brief Answer received complete queries in order of arrival.
+ *
+ * Processing stops when the output queue fills up or on a zone transfer
+ * request while another transfer is still in progress.
+ *
+ * \return Number of processed queries or error.
+ */
+static int tcp_conn_process(tcp_context_t *tcp, int fd, tcp_conn_t *conn)
+{
+	int processed = 0;
+	int ret = KNOT_EOK;
+	size_t off = 0;
+
+	while (conn->tx_len < TCP_TX_HIWAT && conn->rx_len - off >= sizeof(uint16_t)) {
+		uint8_t *wire = conn->rx + off + sizeof(uint16_t);
+		size_t len = wire_read_u16(conn->rx + off);
+		if (len < KNOT_WIRE_HEADER_SIZE) {
+			ret = KNOT_EMALF;
+			break;
+		}
+		if (conn->rx_len - off < sizeof(uint16_t) + len) {
+			break;
+		}
+
+		knot_pkt_t *query = knot_pkt_new(wire, len, tcp->layer.mm);
+		(void) knot_pkt_parse(query, 0);
+
+		if (tcp_is_transfer(query)) {
+			if (conn->stream != NULL) {
+				knot_pkt_free(&query);
+				break; /* Wait for the current transfer. */
+			}
+			ret = tcp_stream_start(conn, wire, len);
+		} else {
+			ret = tcp_handle(tcp, fd, conn, query);
+		}
+
+		knot_pkt_free(&query);
+
+		/* Flush per-query memory. */
+		mp_flush(tcp->layer.mm->ctx);
+
+		if (ret != KNOT_EOK) {
+			break;
+		}
+
+		off += sizeof(uint16_t) + len;
+		conn->progress = true;
+		processed++;
+	}
+
+	/* Shift unprocessed data. */
+	conn->rx_len -= off;
+	if (conn->rx_len > 0) {
+		memmove(conn->rx, conn->rx + off, conn->rx_len);
+	} else if (conn->rx_size > TCP_RX_INIT) {
+		free(conn->rx);
+		conn->rx = NULL;
+		conn->rx_size = 0;
+	}
+
+	return (ret == KNOT_EOK) ? processed : ret;
+}
+
 int tcp_accept(int fd)
 {
 	/* Accept incoming connection. */
@@ -203,12 +538,19 @@ int tcp_accept(int fd)
 static int tcp_event_accept(tcp_context_t *tcp, unsigned i)
 {
 	/* Accept client. */
-	int fd = tcp->set.pfd[i].fd;
+	int fd = fdset_get_fd(&tcp->set, i);
 	int client = tcp_accept(fd);
 	if (client >= 0) {
+		tcp_conn_t *conn = tcp_conn_new(tcp, client);
+		if (conn == NULL) {
+			close(client);
+			return KNOT_ENOMEM;
+		}
+
 		/* Assign to fdset. */
-		int next_id = fdset_add(&tcp->set, client, POLLIN, NULL);
+		int next_id = fdset_add(&tcp->set, client, POLLIN, conn);
 		if (next_id < 0) {
+			tcp_conn_free(conn);
 			close(client);
 			return next_id; /* Contains errno. */
 		}
@@ -225,30 +567,76 @@ static int tcp_event_accept(tcp_context_t *tcp, unsigned i)
 	return client;
 }
 
-static int tcp_event_serve(tcp_context_t *tcp, unsigned i)
+static int tcp_event_serve(tcp_context_t *tcp, unsigned i, unsigned revents)
 {
-	int fd = tcp->set.pfd[i].fd;
-	int ret = tcp_handle(tcp, fd, &tcp->iov[0], &tcp->iov[1]);
+	fdset_t *set = &tcp->set;
+	int fd = fdset_get_fd(set, i);
+	tcp_conn_t *conn = set->ctx[i];
+	conn->progress = false;
 
-	/* Flush per-query memory. */
-	mp_flush(tcp->layer.mm->ctx);
+	/* Send pending output. */
+	int ret = KNOT_EOK;
+	if (revents & POLLOUT) {
+		ret = tcp_conn_flush(fd, conn);
+	}
+
+	/* Receive more data. */
+	if (ret == KNOT_EOK && (revents & POLLIN)) {
+		ret = tcp_conn_read(fd, conn);
+	}
 
-	if (ret == KNOT_EOK) {
+	/* Answer pipelined queries and continue transfer in progress. */
+	while (ret == KNOT_EOK) {
+		ret = tcp_stream_pump(fd, conn);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+		ret = tcp_conn_process(tcp, fd, conn);
+		if (ret <= 0) {
+			break;
+		}
+		ret = KNOT_EOK;
+	}
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	bool pending = (conn->tx_head != NULL || conn->stream != NULL);
+	if (conn->eof && !pending) {
+		return KNOT_ECONN;
+	}
+
+	/* Don't read more while a complete query waits for processing. */
+	unsigned events = 0;
+	if (!conn->eof && !tcp_msg_ready(conn)) {
+		events |= POLLIN;
+	}
+	if (conn->tx_head != NULL) {
+		events |= POLLOUT;
+	}
+	ret = fdset_set_events(set, i, events);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	if (conn->progress) {
 		/* Update socket activity timer. */
 		rcu_read_lock();
-		int timeout = conf()->cache.srv_tcp_idle_timeout;
-		fdset_set_watchdog(&tcp->set, i, timeout);
+		int timeout = pending ? conf()->cache.srv_tcp_reply_timeout :
+		                        conf()->cache.srv_tcp_idle_timeout;
+		fdset_set_watchdog(set, i, timeout);
 		rcu_read_unlock();
 	}
 
-	return ret;
+	return KNOT_EOK;
 }
 
 static int tcp_wait_for_events(tcp_context_t *tcp)
 {
 	/* Wait for events. */
 	fdset_t *set = &tcp->set;
-	int nfds = poll(set->pfd, set->n, TCP_SWEEP_INTERVAL * 1000);
+	fdset_it_t it;
+	int nfds = fdset_poll(set, &it, TCP_SWEEP_INTERVAL * 1000);
 
 	/* Mark the time of last poll call. */
 	tcp->last_poll_time = time_now();
@@ -264,14 +652,13 @@ static int tcp_wait_for_events(tcp_context_t *tcp)
 	}
 
 	/* Process events. */
-	unsigned i = 0;
-	while (nfds > 0 && i < set->n) {
+	for (; !fdset_it_done(&it); fdset_it_next(&it)) {
 		bool should_close = false;
-		int fd = set->pfd[i].fd;
-		if (set->pfd[i].revents & (POLLERR|POLLHUP|POLLNVAL)) {
+		unsigned i = fdset_it_get_idx(&it);
+		unsigned revents = fdset_it_get_events(&it);
+		if (revents & (POLLERR|POLLHUP|POLLNVAL)) {
 			should_close = (i >= tcp->client_threshold);
-			--nfds;
-		} else if (set->pfd[i].revents & (POLLIN)) {
+		} else if (revents & (POLLIN|POLLOUT)) {
 			/* Master sockets */
 			if (i < tcp->client_threshold) {
 				if (!is_throttled && tcp_event_accept(tcp, i) == KNOT_EBUSY) {
@@ -280,21 +667,22 @@ static int tcp_wait_for_events(tcp_context_t *tcp)
 				}
 			/* Client sockets */
 			} else {
-				if (tcp_event_serve(tcp, i) != KNOT_EOK) {
+				if (tcp_event_serve(tcp, i, revents) != KNOT_EOK) {
 					should_close = true;
 				}
 			}
-			--nfds;
 		}
 
 		/* Evaluate */
 		if (should_close) {
-			fdset_remove(set, i);
-			close(fd);
-		} else {
-			++i;
+			tcp_conn_close(set, i);
+			(void)fdset_it_remove(&it); /* Already unwatched. */
 		}
 	}
+	int ret = fdset_it_commit(&it);
+	if (ret != KNOT_EOK) {
+		log_error("TCP, failed to update connections (%s)", knot_strerror(ret));
+	}
 
 	return nfds;
 }
@@ -326,14 +714,11 @@ int tcp_master(dthread_t *thread)
 	conf_val_t val = conf_get(conf(), C_SRV, C_LISTEN);
 	fdset_init(&tcp.set, conf_val_count(&val) + CONF_XFERS);
 
-	/* Create iovec abstraction. */
-	for (unsigned i = 0; i < 2; ++i) {
-		tcp.iov[i].iov_len = KNOT_WIRE_MAX_PKTSIZE;
-		tcp.iov[i].iov_base = malloc(tcp.iov[i].iov_len);
-		if (tcp.iov[i].iov_base == NULL) {
-			ret = KNOT_ENOMEM;
-			goto finish;
-		}
+	/* Create answer buffer. */
+	tcp.tx_buf = malloc(KNOT_WIRE_MAX_PKTSIZE);
+	if (tcp.tx_buf == NULL) {
+		ret = KNOT_ENOMEM;
+		goto finish;
 	}
 
 	/* Initialize sweep interval. */
@@ -348,7 +733,7 @@ int tcp_master(dthread_t *thread)
 
 			/* Cancel client connections. */
 			for (unsigned i = tcp.client_threshold; i < tcp.set.n; ++i) {
-				close(tcp.set.pfd[i].fd);
+				tcp_conn_close(&tcp.set, i);
 			}
 
 			ref_release(ref);
@@ -377,8 +762,10 @@ int tcp_master(dthread_t *thread)
 	}
 
 finish:
-	free(tcp.iov[0].iov_base);
-	free(tcp.iov[1].iov_base);
+	for (unsigned i = tcp.client_threshold; i < tcp.set.n; ++i) {
+		tcp_conn_close(&tcp.set, i);
+	}
+	free(tcp.tx_buf);
 	mp_delete(mm.ctx);
 	fdset_clear(&tcp.set);
 	ref_release(ref);
@@ -34,15 +34,26 @@
 #include <cap-ng.h>
 #endif /* HAVE_CAP_NG_H */
 
+#ifdef ENABLE_IO_URING
+#include <liburing.h>
+#endif /* ENABLE_IO_URING */
+
 #include "contrib/macros.h"
 #include "contrib/mempattern.h"
 #include "contrib/sockaddr.h"
 #include "contrib/ucw/mempool.h"
+#include "knot/common/log.h"
 #include "knot/nameserver/process_query.h"
 #include "knot/query/layer.h"
 #include "knot/server/server.h"
 #include "knot/server/udp-handler.h"
 
+#ifdef HAVE_ATOMIC
+ #define ATOMIC_ADD(dst, val) __atomic_add_fetch(&(dst), val, __ATOMIC_RELAXED)
+#else
+ #define ATOMIC_ADD(dst, val) __sync_add_and_fetch(&(dst), val)
+#endif
+
 /* Buffer identifiers. */
 enum {
 	RX = 0,
@@ -107,12 +118,25 @@ static void udp_handle(udp_context_t *udp, int fd, struct sockaddr_storage *ss,
 	knot_pkt_free(&ans);
 }
 
-/*! \brief Pointer to selected UDP master implementation. */
-static void* (*_udp_init)(void) = 0;
-static int (*_udp_deinit)(void *) = 0;
-static int (*_udp_recv)(int, void *) = 0;
-static int (*_udp_handle)(udp_context_t *, void *) = 0;
-static int (*_udp_send)(void *) = 0;
+/*! \brief UDP buffer limits of a worker. */
+typedef struct {
+	unsigned batch; /*!< Maximal number of datagrams handled at once. */
+	size_t rx_size; /*!< Receive buffer size for a datagram. */
+	size_t tx_size; /*!< Transmit buffer size for a datagram. */
+	unsigned ring;  /*!< Datagrams received or answered in parallel (io_uring). */
+} udp_limits_t;
+
+/*! \brief UDP master implementation (I/O backend). */
+typedef struct {
+	void* (*udp_init)(const udp_limits_t *);
+	int (*udp_deinit)(void *);
+	int (*udp_recv)(int, void *);
+	int (*udp_handle)(udp_context_t *, void *);
+	int (*udp_send)(void *);
+	/*! Optional event source replacing poll() and udp_recv(). */
+	int (*udp_track)(void *, const struct pollfd *, nfds_t);
+	int (*udp_wait)(void *);
+} udp_api_t;
 
 /*! \brief Control message to fit IP_PKTINFO or IPv6_RECVPKTINFO. */
 typedef union {
@@ -158,8 +182,10 @@ struct udp_recvfrom {
 	cmsg_pktinfo_t pktinfo;
 };
 
-static void *udp_recvfrom_init(void)
+static void *udp_recvfrom_init(const udp_limits_t *limits)
 {
+	UNUSED(limits);
+
 	struct udp_recvfrom *rq = malloc(sizeof(struct udp_recvfrom));
 	if (rq == NULL) {
 		return NULL;
@@ -241,16 +267,20 @@ static int udp_recvfrom_send(void *d)
 /* UDP recvmmsg() request struct. */
 struct udp_recvmmsg {
 	int fd;
-	struct sockaddr_storage addrs[RECVMMSG_BATCHLEN];
+	struct sockaddr_storage *addrs;
 	char *iobuf[NBUFS];
 	struct iovec *iov[NBUFS];
 	struct mmsghdr *msgs[NBUFS];
+	uint8_t *oversize;
+	size_t rx_size;
+	size_t tx_size;
+	unsigned batch;
 	unsigned rcvd;
 	knot_mm_t mm;
-	cmsg_pktinfo_t pktinfo[RECVMMSG_BATCHLEN];
+	cmsg_pktinfo_t *pktinfo;
 };
 
-static void *udp_recvmmsg_init(void)
+static void *udp_recvmmsg_init(const udp_limits_t *limits)
 {
 	knot_mm_t mm;
 	mm_ctx_mempool(&mm, sizeof(struct udp_recvmmsg));
@@ -259,17 +289,37 @@ static void *udp_recvmmsg_init(void)
 	memset(rq, 0, sizeof(*rq));
 	memcpy(&rq->mm, &mm, sizeof(knot_mm_t));
 
-	/* Initialize buffers. */
+	unsigned batch = limits->batch;
+	rq->batch = batch;
+	rq->rx_size = limits->rx_size;
+	rq->tx_size = limits->tx_size;
+	rq->addrs = mm_alloc(&mm, sizeof(struct sockaddr_storage) * batch);
+	rq->pktinfo = mm_alloc(&mm, sizeof(cmsg_pktinfo_t) * batch);
+	memset(rq->addrs, 0, sizeof(struct sockaddr_storage) * batch);
+
+	/* Datagrams exceeding the RX slot continue in the slot's own overflow
+	 * area, which is touched (and thus backed by memory) only if used. */
+	rq->oversize = mm_alloc(&mm, KNOT_WIRE_MAX_PKTSIZE * batch);
+
+	/* Initialize buffers, RX slots have two parts: own and overflow. */
+	const size_t slot_size[NBUFS] = { rq->rx_size, rq->tx_size };
+	const unsigned slot_iovs[NBUFS] = { 2, 1 };
 	for (unsigned i = 0; i < NBUFS; ++i) {
-		rq->iobuf[i] = mm_alloc(&mm, KNOT_WIRE_MAX_PKTSIZE * RECVMMSG_BATCHLEN);
-		rq->iov[i] = mm_alloc(&mm, sizeof(struct iovec) * RECVMMSG_BATCHLEN);
-		rq->msgs[i] = mm_alloc(&mm, sizeof(struct mmsghdr) * RECVMMSG_BATCHLEN);
-		memset(rq->msgs[i], 0, sizeof(struct mmsghdr) * RECVMMSG_BATCHLEN);
-		for (unsigned k = 0; k < RECVMMSG_BATCHLEN; ++k) {
-			rq->iov[i][k].iov_base = rq->iobuf[i] + k * KNOT_WIRE_MAX_PKTSIZE;
-			rq->iov[i][k].iov_len = KNOT_WIRE_MAX_PKTSIZE;
-			rq->msgs[i][k].msg_hdr.msg_iov = rq->iov[i] + k;
-			rq->msgs[i][k].msg_hdr.msg_iovlen = 1;
+		rq->iobuf[i] = mm_alloc(&mm, slot_size[i] * batch);
+		rq->iov[i] = mm_alloc(&mm, sizeof(struct iovec) * slot_iovs[i] * batch);
+		rq->msgs[i] = mm_alloc(&mm, sizeof(struct mmsghdr) * batch);
+		memset(rq->msgs[i], 0, sizeof(struct mmsghdr) * batch);
+		for (unsigned k = 0; k < batch; ++k) {
+			struct iovec *iov = rq->iov[i] + k * slot_iovs[i];
+			iov[0].iov_base = rq->iobuf[i] + k * slot_size[i];
+			iov[0].iov_len = slot_size[i];
+			if (i == RX) {
+				iov[1].iov_base = rq->oversize + k * KNOT_WIRE_MAX_PKTSIZE +
+				                  rq->rx_size;
+				iov[1].iov_len = KNOT_WIRE_MAX_PKTSIZE - rq->rx_size;
+			}
+			rq->msgs[i][k].msg_hdr.msg_iov = iov;
+			rq->msgs[i][k].msg_hdr.msg_iovlen = slot_iovs[i];
 			rq->msgs[i][k].msg_hdr.msg_name = rq->addrs + k;
 			rq->msgs[i][k].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
 			rq->msgs[i][k].msg_hdr.msg_control = &rq->pktinfo[k].cmsg;
@@ -294,7 +344,7 @@ static int udp_recvmmsg_recv(int fd, void *d)
 {
 	struct udp_recvmmsg *rq = (struct udp_recvmmsg *)d;
 
-	int n = recvmmsg(fd, rq->msgs[RX], RECVMMSG_BATCHLEN, MSG_DONTWAIT, NULL);
+	int n = recvmmsg(fd, rq->msgs[RX], rq->batch, MSG_DONTWAIT, NULL);
 	if (n > 0) {
 		rq->fd = fd;
 		rq->rcvd = n;
@@ -308,19 +358,24 @@ static int udp_recvmmsg_handle(udp_context_t *ctx, void *d)
 
 	/* Handle each received msg. */
 	for (unsigned i = 0; i < rq->rcvd; ++i) {
-		struct iovec *rx = rq->msgs[RX][i].msg_hdr.msg_iov;
+		struct iovec rx = {
+			.iov_base = rq->msgs[RX][i].msg_hdr.msg_iov->iov_base,
+			.iov_len = rq->msgs[RX][i].msg_len /* Received bytes. */
+		};
 		struct iovec *tx = rq->msgs[TX][i].msg_hdr.msg_iov;
-		rx->iov_len = rq->msgs[RX][i].msg_len; /* Received bytes. */
+
+		if (rx.iov_len > rq->rx_size) {
+			/* Make the oversized datagram contiguous in its overflow area. */
+			uint8_t *overflow = rq->oversize + i * KNOT_WIRE_MAX_PKTSIZE;
+			memcpy(overflow, rx.iov_base, rq->rx_size);
+			rx.iov_base = overflow;
+		}
 
 		udp_pktinfo_handle(&rq->msgs[RX][i].msg_hdr, &rq->msgs[TX][i].msg_hdr);
+		udp_handle(ctx, rq->fd, rq->addrs + i, &rx, tx);
 
-		udp_handle(ctx, rq->fd, rq->addrs + i, rx, tx);
 		rq->msgs[TX][i].msg_len = tx->iov_len;
-		rq->msgs[TX][i].msg_hdr.msg_namelen = 0;
-		if (tx->iov_len > 0) {
-			/* @note sendmmsg() workaround to prevent sending the packet */
-			rq->msgs[TX][i].msg_hdr.msg_namelen = rq->msgs[RX][i].msg_hdr.msg_namelen;
-		}
+		rq->msgs[TX][i].msg_hdr.msg_namelen = rq->msgs[RX][i].msg_hdr.msg_namelen;
 	}
 
 	return KNOT_EOK;
@@ -329,13 +384,29 @@ static int udp_recvmmsg_handle(udp_context_t *ctx, void *d)
 static int udp_recvmmsg_send(void *d)
 {
 	struct udp_recvmmsg *rq = (struct udp_recvmmsg *)d;
-	int rc = sendmmsg(rq->fd, rq->msgs[TX], rq->rcvd, 0);
+
+	/* Send runs of answers, sendmmsg() would stop at an empty one. */
+	int rc = 0;
+	for (unsigned i = 0; i < rq->rcvd; ) {
+		if (rq->msgs[TX][i].msg_len == 0) {
+			i++;
+			continue;
+		}
+		unsigned end = i + 1;
+		while (end < rq->rcvd && rq->msgs[TX][end].msg_len > 0) {
+			end++;
+		}
+		int ret = sendmmsg(rq->fd, rq->msgs[TX] + i, end - i, 0);
+		if (ret > 0) {
+			rc += ret;
+		}
+		i = end;
+	}
+
 	for (unsigned i = 0; i < rq->rcvd; ++i) {
 		/* Reset buffer size and address len. */
-		struct iovec *rx = rq->msgs[RX][i].msg_hdr.msg_iov;
 		struct iovec *tx = rq->msgs[TX][i].msg_hdr.msg_iov;
-		rx->iov_len = KNOT_WIRE_MAX_PKTSIZE; /* Reset RX buflen */
-		tx->iov_len = KNOT_WIRE_MAX_PKTSIZE;
+		tx->iov_len = rq->tx_size; /* Reset TX buflen */
 
 		memset(rq->addrs + i, 0, sizeof(struct sockaddr_storage));
 		rq->msgs[RX][i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
@@ -346,23 +417,437 @@ static int udp_recvmmsg_send(void *d)
 }
 #endif /* ENABLE_RECVMMSG */
 
-/*! \brief Initialize UDP master routine on run-time. */
-void __attribute__ ((constructor)) udp_master_init(void)
-{
-	/* Initialize defaults. */
-	_udp_init =   udp_recvfrom_init;
-	_udp_deinit = udp_recvfrom_deinit;
-	_udp_recv =   udp_recvfrom_recv;
-	_udp_handle = udp_recvfrom_handle;
-	_udp_send =   udp_recvfrom_send;
+static const udp_api_t udp_recvfrom_api = {
+	udp_recvfrom_init,
+	udp_recvfrom_deinit,
+	udp_recvfrom_recv,
+	udp_recvfrom_handle,
+	udp_recvfrom_send
+};
 
 #ifdef ENABLE_RECVMMSG
-	_udp_init =   udp_recvmmsg_init;
-	_udp_deinit = udp_recvmmsg_deinit;
-	_udp_recv =   udp_recvmmsg_recv;
-	_udp_handle = udp_recvmmsg_handle;
-	_udp_send =   udp_recvmmsg_send;
+static const udp_api_t udp_recvmmsg_api = {
+	udp_recvmmsg_init,
+	udp_recvmmsg_deinit,
+	udp_recvmmsg_recv,
+	udp_recvmmsg_handle,
+	udp_recvmmsg_send
+};
 #endif /* ENABLE_RECVMMSG */
+
+#ifdef ENABLE_IO_URING
+
+#define URING_BGID 0  /*!< Provided buffer group ID. */
+#define URING_CQES 64 /*!< Completions reaped at once. */
+
+/*! \brief RX buffer layout of a multishot recvmsg(). */
+#define URING_RX_BUFSIZE (sizeof(struct io_uring_recvmsg_out) + \
+                          sizeof(struct sockaddr_storage) + \
+                          sizeof(cmsg_pktinfo_t) + KNOT_WIRE_MAX_PKTSIZE)
+
+/*! \brief Completion identification (operation, socket or TX slot index). */
+enum {
+	URING_OP_RECV = 1,
+	URING_OP_SEND = 2
+};
+#define URING_DATA(op, idx) (((uint64_t)(op) << 32) | (idx))
+#define URING_DATA_OP(data) ((data) >> 32)
+#define URING_DATA_IDX(data) ((uint32_t)(data))
+
+/* UDP io_uring TX slot, valid until the send completes. */
+struct uring_tx {
+	int fd;
+	struct sockaddr_storage addr;
+	struct msghdr msg;
+	struct iovec iov;
+	cmsg_pktinfo_t pktinfo;
+	uint8_t *buf;
+};
+
+/* Received, not yet handled datagram. */
+struct uring_rx {
+	unsigned fd_idx;
+	unsigned bid;
+	int len;
+};
+
+/* UDP io_uring request struct. */
+struct udp_uring {
+	struct io_uring ring;
+	struct io_uring_buf_ring *br;
+	bool ring_ok;
+	struct msghdr rx_msg;           /* Multishot recvmsg() template. */
+	unsigned nbufs;                 /* Number of RX buffers and TX slots (power of 2). */
+	/* TX slot nbufs is reserved for answers sent synchronously. */
+	size_t tx_size;
+	uint8_t *rx_bufs;
+	uint8_t *tx_bufs;
+	struct uring_rx *rcvd;
+	unsigned nrcvd;
+	struct uring_tx *tx;
+	unsigned *tx_free;              /* Stack of free TX slots. */
+	unsigned tx_nfree;
+	unsigned *sendq;                /* TX slots to be sent. */
+	unsigned nsend;
+	const struct pollfd *fds;       /* Tracked sockets. */
+	nfds_t nfds;
+	bool *rearm;                    /* Receive must be (re)submitted. */
+	unsigned dropped;               /* Dropped datagrams not yet accounted. */
+};
+
+static void udp_uring_teardown(struct udp_uring *rq)
+{
+	if (rq->ring_ok) {
+		io_uring_free_buf_ring(&rq->ring, rq->br, rq->nbufs, URING_BGID);
+		io_uring_queue_exit(&rq->ring);
+		rq->ring_ok = false;
+	}
+}
+
+static int udp_uring_setup(struct udp_uring *rq)
+{
+	int ret = io_uring_queue_init(4 * rq->nbufs, &rq->ring, 0);
+	if (ret < 0) {
+		return knot_map_errno_code(-ret);
+	}
+
+	rq->br = io_uring_setup_buf_ring(&rq->ring, rq->nbufs, URING_BGID, 0, &ret);
+	if (rq->br == NULL) {
+		io_uring_queue_exit(&rq->ring);
+		return knot_map_errno_code(-ret);
+	}
+	rq->ring_ok = true;
+
+	/* Provide all RX buffers and free all TX slots. */
+	int mask = io_uring_buf_ring_mask(rq->nbufs);
+	for (unsigned i = 0; i < rq->nbufs; ++i) {
+		io_uring_buf_ring_add(rq->br, rq->rx_bufs + i * URING_RX_BUFSIZE,
+		                      URING_RX_BUFSIZE, i, mask, i);
+		rq->tx_free[i] = i;
+	}
+	io_uring_buf_ring_advance(rq->br, rq->nbufs);
+	rq->tx_nfree = rq->nbufs;
+	rq->nrcvd = 0;
+	rq->nsend = 0;
+
+	return KNOT_EOK;
+}
+
+static int udp_uring_deinit(void *d)
+{
+	struct udp_uring *rq = (struct udp_uring *)d;
+	if (rq) {
+		udp_uring_teardown(rq);
+		free(rq->rearm);
+		free(rq->sendq);
+		free(rq->tx_free);
+		free(rq->tx);
+		free(rq->rcvd);
+		free(rq->tx_bufs);
+		free(rq->rx_bufs);
+		free(rq);
+	}
+
+	return 0;
+}
+
+static void *udp_uring_init(const udp_limits_t *limits)
+{
+	struct udp_uring *rq = calloc(1, sizeof(struct udp_uring));
+	if (rq == NULL) {
+		return NULL;
+	}
+
+	/* Provided buffer ring size must be a power of 2. */
+	rq->nbufs = 1;
+	while (rq->nbufs < limits->ring) {
+		rq->nbufs <<= 1;
+	}
+	rq->tx_size = limits->tx_size;
+
+	/* Truncated multishot receives can't be recovered, keep full RX size. */
+	rq->rx_bufs = malloc(rq->nbufs * URING_RX_BUFSIZE);
+	rq->tx_bufs = malloc((rq->nbufs + 1) * rq->tx_size);
+	rq->rcvd = calloc(rq->nbufs, sizeof(struct uring_rx));
+	rq->tx = calloc(rq->nbufs + 1, sizeof(struct uring_tx));
+	rq->tx_free = calloc(rq->nbufs, sizeof(unsigned));
+	rq->sendq = calloc(rq->nbufs, sizeof(unsigned));
+	if (rq->rx_bufs == NULL || rq->tx_bufs == NULL || rq->rcvd == NULL ||
+	    rq->tx == NULL || rq->tx_free == NULL || rq->sendq == NULL) {
+		udp_uring_deinit(rq);
+		return NULL;
+	}
+
+	for (unsigned i = 0; i <= rq->nbufs; ++i) {
+		struct uring_tx *tx = &rq->tx[i];
+		tx->buf = rq->tx_bufs + i * rq->tx_size;
+		tx->iov.iov_base = tx->buf;
+		tx->msg.msg_name = &tx->addr;
+		tx->msg.msg_iov = &tx->iov;
+		tx->msg.msg_iovlen = 1;
+	}
+
+	rq->rx_msg.msg_namelen = sizeof(struct sockaddr_storage);
+	rq->rx_msg.msg_controllen = sizeof(cmsg_pktinfo_t);
+
+	/* Check for kernel support. */
+	if (udp_uring_setup(rq) != KNOT_EOK) {
+		udp_uring_deinit(rq);
+		return NULL;
+	}
+
+	return rq;
+}
+
+static int udp_uring_track(void *d, const struct pollfd *fds, nfds_t nfds)
+{
+	struct udp_uring *rq = (struct udp_uring *)d;
+
+	/* Start over with a new ring, it drops receives on previous sockets. */
+	if (rq->fds != NULL) {
+		udp_uring_teardown(rq);
+		int ret = udp_uring_setup(rq);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	bool *rearm = realloc(rq->rearm, nfds * sizeof(*rearm));
+	if (rearm == NULL) {
+		return KNOT_ENOMEM;
+	}
+	for (nfds_t i = 0; i < nfds; ++i) {
+		rearm[i] = true;
+	}
+	rq->rearm = rearm;
+	rq->fds = fds;
+	rq->nfds = nfds;
+
+	return KNOT_EOK;
+}
+
+/* Gets an SQE, submits the full submission queue first if needed. */
+static struct io_uring_sqe *udp_uring_get_sqe(struct udp_uring *rq)
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&rq->ring);
+	if (sqe == NULL && io_uring_submit(&rq->ring) >= 0) {
+		sqe = io_uring_get_sqe(&rq->ring);
+	}
+
+	return sqe;
+}
+
+/* Sends the answer synchronously if it can't go through the ring. */
+static void udp_uring_sendmsg(struct udp_uring *rq, unsigned slot)
+{
+	struct uring_tx *tx = &rq->tx[slot];
+	if (sendmsg(tx->fd, &tx->msg, 0) < 0) {
+		rq->dropped++;
+	}
+
+	if (slot < rq->nbufs) {
+		rq->tx_free[rq->tx_nfree++] = slot;
+	}
+}
+
+static int udp_uring_wait(void *d)
+{
+	struct udp_uring *rq = (struct udp_uring *)d;
+
+	/* Submit receives on sockets without an active one. */
+	for (nfds_t i = 0; i < rq->nfds; ++i) {
+		if (!rq->rearm[i]) {
+			continue;
+		}
+		struct io_uring_sqe *sqe = udp_uring_get_sqe(rq);
+		if (sqe == NULL) {
+			break;
+		}
+		io_uring_prep_recvmsg_multishot(sqe, rq->fds[i].fd, &rq->rx_msg, 0);
+		sqe->flags |= IOSQE_BUFFER_SELECT;
+		sqe->buf_group = URING_BGID;
+		io_uring_sqe_set_data64(sqe, URING_DATA(URING_OP_RECV, i));
+		rq->rearm[i] = false;
+	}
+
+	/* Submit queued sends and wait for datagrams in a single syscall. */
+	int ret = io_uring_submit_and_wait(&rq->ring, 1);
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
+
+	struct io_uring_cqe *cqes[URING_CQES];
+	unsigned count;
+	while ((count = io_uring_peek_batch_cqe(&rq->ring, cqes, URING_CQES)) > 0) {
+		for (unsigned i = 0; i < count; ++i) {
+			struct io_uring_cqe *cqe = cqes[i];
+			uint64_t data = io_uring_cqe_get_data64(cqe);
+			unsigned idx = URING_DATA_IDX(data);
+
+			if (URING_DATA_OP(data) == URING_OP_SEND) {
+				if (cqe->res < 0) {
+					rq->dropped++;
+				}
+				rq->tx_free[rq->tx_nfree++] = idx;
+				continue;
+			}
+
+			/* Multishot receive ended (e.g. out of buffers). */
+			if (!(cqe->flags & IORING_CQE_F_MORE) && idx < rq->nfds) {
+				rq->rearm[idx] = true;
+			}
+			if (cqe->res <= 0 || !(cqe->flags & IORING_CQE_F_BUFFER)) {
+				continue;
+			}
+
+			/* Each buffer is received at most once, so the list can't overflow. */
+			assert(rq->nrcvd < rq->nbufs);
+			rq->rcvd[rq->nrcvd].fd_idx = idx;
+			rq->rcvd[rq->nrcvd].bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+			rq->rcvd[rq->nrcvd].len = cqe->res;
+			rq->nrcvd++;
+		}
+		io_uring_cq_advance(&rq->ring, count);
+	}
+
+	return rq->nrcvd;
+}
+
+static int udp_uring_recv(int fd, void *d)
+{
+	UNUSED(fd);
+	UNUSED(d);
+
+	/* Datagrams are received by udp_uring_wait(). */
+	return 0;
+}
+
+static int udp_uring_handle(udp_context_t *ctx, void *d)
+{
+	struct udp_uring *rq = (struct udp_uring *)d;
+	int mask = io_uring_buf_ring_mask(rq->nbufs);
+
+	for (unsigned i = 0; i < rq->nrcvd; ++i) {
+		unsigned bid = rq->rcvd[i].bid;
+		uint8_t *buf = rq->rx_bufs + bid * URING_RX_BUFSIZE;
+		struct io_uring_recvmsg_out *out =
+			io_uring_recvmsg_validate(buf, rq->rcvd[i].len, &rq->rx_msg);
+
+		/* Skip truncated datagrams, answer synchronously if out of TX slots. */
+		if (out == NULL || (out->flags & MSG_TRUNC) ||
+		    rq->rcvd[i].fd_idx >= rq->nfds) {
+			rq->dropped++;
+		} else {
+			bool sync = (rq->tx_nfree == 0);
+			unsigned slot = sync ? rq->nbufs : rq->tx_free[--rq->tx_nfree];
+			struct uring_tx *tx = &rq->tx[slot];
+			tx->fd = rq->fds[rq->rcvd[i].fd_idx].fd;
+
+			/* Prepare TX address and control data. */
+			memset(&tx->addr, 0, sizeof(tx->addr));
+			memcpy(&tx->addr, io_uring_recvmsg_name(out),
+			       MIN(out->namelen, sizeof(tx->addr)));
+			tx->msg.msg_namelen = out->namelen;
+
+			struct msghdr rx_msg = { 0 };
+			struct cmsghdr *cmsg = io_uring_recvmsg_cmsg_firsthdr(out, &rq->rx_msg);
+			if (cmsg != NULL) {
+				rx_msg.msg_controllen = MIN(out->controllen, sizeof(tx->pktinfo));
+				memcpy(&tx->pktinfo, cmsg, rx_msg.msg_controllen);
+				rx_msg.msg_control = &tx->pktinfo;
+			}
+			udp_pktinfo_handle(&rx_msg, &tx->msg);
+
+			/* Process received pkt. */
+			struct iovec rx = {
+				.iov_base = io_uring_recvmsg_payload(out, &rq->rx_msg),
+				.iov_len = io_uring_recvmsg_payload_length(out, rq->rcvd[i].len,
+				                                           &rq->rx_msg)
+			};
+			tx->iov.iov_len = rq->tx_size;
+			udp_handle(ctx, tx->fd, &tx->addr, &rx, &tx->iov);
+
+			if (sync) {
+				if (tx->iov.iov_len > 0) {
+					udp_uring_sendmsg(rq, slot);
+				}
+			} else if (tx->iov.iov_len > 0) {
+				rq->sendq[rq->nsend++] = slot;
+			} else {
+				rq->tx_free[rq->tx_nfree++] = slot;
+			}
+		}
+
+		/* Give the buffer back to the kernel. */
+		io_uring_buf_ring_add(rq->br, buf, URING_RX_BUFSIZE, bid, mask, i);
+	}
+	io_uring_buf_ring_advance(rq->br, rq->nrcvd);
+	rq->nrcvd = 0;
+
+	/* Account drops including failed sends since the last call. */
+	if (rq->dropped > 0) {
+		ATOMIC_ADD(ctx->server->udp_dropped, rq->dropped);
+		rq->dropped = 0;
+	}
+
+	return KNOT_EOK;
+}
+
+static int udp_uring_send(void *d)
+{
+	struct udp_uring *rq = (struct udp_uring *)d;
+
+	/* Sends are submitted together with the next wait. */
+	unsigned queued = 0;
+	for (; queued < rq->nsend; ++queued) {
+		unsigned slot = rq->sendq[queued];
+		struct io_uring_sqe *sqe = udp_uring_get_sqe(rq);
+		if (sqe == NULL) {
+			udp_uring_sendmsg(rq, slot);
+			continue;
+		}
+		io_uring_prep_sendmsg(sqe, rq->tx[slot].fd, &rq->tx[slot].msg, 0);
+		io_uring_sqe_set_data64(sqe, URING_DATA(URING_OP_SEND, slot));
+	}
+	rq->nsend = 0;
+
+	return queued;
+}
+
+static const udp_api_t udp_uring_api = {
+	udp_uring_init,
+	udp_uring_deinit,
+	udp_uring_recv,
+	udp_uring_handle,
+	udp_uring_send,
+	udp_uring_track,
+	udp_uring_wait
+};
+#endif /* ENABLE_IO_URING */
+
+/*! \brief Select UDP master implementation configured at run-time. */
+static const udp_api_t *udp_api(unsigned backend)
+{
+	switch (backend) {
+	case UDP_BACKEND_IO_URING:
+#ifdef ENABLE_IO_URING
+		return &udp_uring_api;
+#else
+		log_warning("UDP, io_uring backend not available, using default");
+		break;
+#endif
+	case UDP_BACKEND_RECVFROM:
+		return &udp_recvfrom_api;
+	default:
+		break;
+	}
+
+#ifdef ENABLE_RECVMMSG
+	return &udp_recvmmsg_api;
+#else
+	return &udp_recvfrom_api;
+#endif
 }
 
 /*! \brief Get interface UDP descriptor for a given thread. */
@@ -438,9 +923,32 @@ int udp_master(dthread_t *thread)
 	unsigned thr_id = dt_get_id(thread);
 	iohandler_t *handler = (iohandler_t *)thread->data;
 	unsigned *iostate = &handler->thread_state[thr_id];
-	void *rq = _udp_init();
 	ifacelist_t *ref = NULL;
 
+	/* Initialize configured UDP master implementation. */
+	rcu_read_lock();
+	conf_val_t val = conf_get(conf(), C_SRV, C_UDP_BACKEND);
+	const udp_api_t *api = udp_api(conf_opt(&val));
+	val = conf_get(conf(), C_SRV, C_UDP_BATCH_SIZE);
+	udp_limits_t limits = { .batch = conf_int(&val) };
+	val = conf_get(conf(), C_SRV, C_UDP_RX_SIZE);
+	limits.rx_size = conf_int(&val);
+	val = conf_get(conf(), C_SRV, C_UDP_RING_SIZE);
+	limits.ring = conf_int(&val);
+	/* Answers never exceed the configured EDNS payload. */
+	limits.tx_size = MAX(conf()->cache.srv_max_ipv4_udp_payload,
+	                     conf()->cache.srv_max_ipv6_udp_payload);
+	rcu_read_unlock();
+	void *rq = api->udp_init(&limits);
+	if (rq == NULL && api != udp_api(0)) {
+		log_warning("UDP, failed to initialize configured backend, using default");
+		api = udp_api(0);
+		rq = api->udp_init(&limits);
+	}
+	if (rq == NULL) {
+		return KNOT_ENOMEM;
+	}
+
 	/* Create big enough memory cushion. */
 	knot_mm_t mm;
 	mm_ctx_mempool(&mm, 16 * MM_DEFAULT_BLKSIZE);
@@ -472,6 +980,11 @@ int udp_master(dthread_t *thread)
 			if (nfds == 0) {
 				break;
 			}
+			if (api->udp_track != NULL &&
+			    api->udp_track(rq, fds, nfds) != KNOT_EOK) {
+				log_error("UDP, failed to watch interfaces");
+				break;
+			}
 		}
 
 		/* Cancellation point. */
@@ -479,6 +992,22 @@ int udp_master(dthread_t *thread)
 			break;
 		}
 
+		/* Receive from all sockets at once if supported. */
+		if (api->udp_wait != NULL) {
+			int rcvd = api->udp_wait(rq);
+			if (rcvd < 0) {
+				if (errno == EINTR) continue;
+				break;
+			}
+			if (rcvd > 0) {
+				api->udp_handle(&udp, rq);
+				/* Flush allocated memory. */
+				mp_flush(mm.ctx);
+				api->udp_send(rq);
+			}
+			continue;
+		}
+
 		/* Wait for events. */
 		int events = poll(fds, nfds, -1);
 		if (events <= 0) {
@@ -493,16 +1022,16 @@ int udp_master(dthread_t *thread)
 			}
 			events -= 1;
 			int rcvd = 0;
-			if ((rcvd = _udp_recv(fds[i].fd, rq)) > 0) {
-				_udp_handle(&udp, rq);
+			if ((rcvd = api->udp_recv(fds[i].fd, rq)) > 0) {
+				api->udp_handle(&udp, rq);
 				/* Flush allocated memory. */
 				mp_flush(mm.ctx);
-				_udp_send(rq);
+				api->udp_send(rq);
 			}
 		}
 	}
 
-	_udp_deinit(rq);
+	api->udp_deinit(rq);
 	forget_ifaces(ref, &fds);
 	mp_delete(mm.ctx);
 	return KNOT_EOK;
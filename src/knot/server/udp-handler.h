@@ -32,7 +32,9 @@
 
 #include "knot/server/dthreads.h"
 
-#define RECVMMSG_BATCHLEN 10 /*!< Default recvmmsg() batch size. */
+#define RECVMMSG_BATCHLEN 10   /*!< Default recvmmsg() batch size. */
+#define UDP_RX_SIZE       1232 /*!< Default receive buffer size per datagram. */
+#define UDP_RING_SIZE     128  /*!< Default io_uring receive buffer count. */
 
 /*!
  * \brief UDP handler thread runnable.
@@ -14,7 +14,13 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "knot/updates/acl.h"
+#include "contrib/qp-trie/trie.h"
+#include "contrib/sockaddr.h"
 
 bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
                  const struct sockaddr_storage *addr, knot_tsig_key_t *tsig)
@@ -102,3 +108,504 @@ next_acl:
 
 	return false;
 }
+
+#define ACL_ACTIONS	(ACL_ACTION_UPDATE + 1)
+
+enum {
+	ACL_FAMILY_IPV4 = 0,
+	ACL_FAMILY_IPV6 = 1,
+	ACL_FAMILIES    = 2
+};
+
+enum {
+	ACL_RULE_DENY      = 1 << 0, /* Matching request is denied. */
+	ACL_RULE_NO_ACTION = 1 << 1, /* Empty action list (deny only). */
+};
+
+/*! \brief Binary prefix trie node. */
+typedef struct {
+	uint32_t child[2]; /* Child node indices, 0 if none. */
+	uint32_t rule;     /* First rule with this prefix + 1, 0 if none. */
+} acl_node_t;
+
+/*! \brief TSIG key used in the rules, the index 0 stands for no key. */
+typedef struct {
+	knot_dname_t *name;
+	dnssec_tsig_algorithm_t algorithm;
+	dnssec_binary_t secret;
+} acl_key_t;
+
+/*! \brief Evaluation start for an action and a key. */
+typedef struct {
+	uint32_t any;                /* First rule without address + 1. */
+	uint32_t root[ACL_FAMILIES]; /* Prefix trie roots. */
+} acl_start_t;
+
+struct acl {
+	uint8_t *rules;       /* Rule flags. */
+	size_t rules_count;
+	acl_key_t *keys;
+	size_t keys_count;    /* Including the no key item. */
+	trie_t *key_names;    /* Key name -> key index. */
+	acl_start_t *starts;  /* Indexed by action * keys_count + key. */
+	acl_node_t *nodes;    /* The node 0 is not used. */
+	size_t nodes_count;
+	size_t nodes_max;
+};
+
+static int family_index(int family, size_t *bits)
+{
+	switch (family) {
+	case AF_INET:
+		*bits = IPV4_PREFIXLEN;
+		return ACL_FAMILY_IPV4;
+	case AF_INET6:
+		*bits = IPV6_PREFIXLEN;
+		return ACL_FAMILY_IPV6;
+	default:
+		return -1;
+	}
+}
+
+static inline unsigned addr_bit(const uint8_t *raw, size_t i)
+{
+	return (raw[i / 8] >> (7 - i % 8)) & 1;
+}
+
+static uint32_t node_new(acl_t *acl)
+{
+	if (acl->nodes_count == acl->nodes_max) {
+		size_t max = (acl->nodes_max > 0) ? 2 * acl->nodes_max : 64;
+		if (max > UINT32_MAX) {
+			return 0;
+		}
+		acl_node_t *nodes = realloc(acl->nodes, max * sizeof(*nodes));
+		if (nodes == NULL) {
+			return 0;
+		}
+		acl->nodes = nodes;
+		acl->nodes_max = max;
+	}
+
+	uint32_t idx = acl->nodes_count++;
+	memset(&acl->nodes[idx], 0, sizeof(acl->nodes[idx]));
+
+	return idx;
+}
+
+static int insert_prefix(acl_t *acl, acl_start_t *start, int family,
+                         const uint8_t *raw, size_t prefix, uint32_t rule)
+{
+	/* Any address already matches a preceding rule. */
+	if (start->any != 0) {
+		return KNOT_EOK;
+	}
+
+	uint32_t cur = start->root[family];
+	if (cur == 0) {
+		cur = node_new(acl);
+		if (cur == 0) {
+			return KNOT_ENOMEM;
+		}
+		start->root[family] = cur;
+	}
+
+	for (size_t i = 0; i < prefix; i++) {
+		/* The prefix is covered by a preceding rule. */
+		if (acl->nodes[cur].rule != 0) {
+			return KNOT_EOK;
+		}
+
+		unsigned bit = addr_bit(raw, i);
+		uint32_t next = acl->nodes[cur].child[bit];
+		if (next == 0) {
+			next = node_new(acl);
+			if (next == 0) {
+				return KNOT_ENOMEM;
+			}
+			acl->nodes[cur].child[bit] = next;
+		}
+		cur = next;
+	}
+
+	/* First match wins. */
+	if (acl->nodes[cur].rule == 0) {
+		acl->nodes[cur].rule = rule + 1;
+	}
+
+	return KNOT_EOK;
+}
+
+static void set_low_bits(uint8_t *dst, const uint8_t *src, size_t len, size_t count)
+{
+	memcpy(dst, src, len);
+	for (size_t i = len; i > 0 && count > 0; i--) {
+		if (count >= 8) {
+			dst[i - 1] = 0xff;
+			count -= 8;
+		} else {
+			dst[i - 1] |= (1 << count) - 1;
+			count = 0;
+		}
+	}
+}
+
+static size_t low_zero_bits(const uint8_t *raw, size_t len)
+{
+	size_t count = 0;
+	for (size_t i = len; i > 0; i--) {
+		for (unsigned bit = 0; bit < 8; bit++) {
+			if (raw[i - 1] & (1 << bit)) {
+				return count;
+			}
+			count++;
+		}
+	}
+
+	return count;
+}
+
+static void increment(uint8_t *raw, size_t len)
+{
+	for (size_t i = len; i > 0; i--) {
+		if (++raw[i - 1] != 0) {
+			break;
+		}
+	}
+}
+
+static int insert_range(acl_t *acl, acl_start_t *start,
+                        const struct sockaddr_storage *min,
+                        const struct sockaddr_storage *max, uint32_t rule)
+{
+	size_t bits;
+	int family = family_index(min->ss_family, &bits);
+	if (family < 0 || min->ss_family != max->ss_family) {
+		return KNOT_EOK;
+	}
+
+	size_t len = bits / 8;
+	uint8_t cur[IPV6_PREFIXLEN / 8], end[IPV6_PREFIXLEN / 8];
+	memcpy(cur, sockaddr_raw((struct sockaddr *)min, &len), len);
+	memcpy(end, sockaddr_raw((struct sockaddr *)max, &len), len);
+	if (memcmp(cur, end, len) > 0) {
+		return KNOT_EOK;
+	}
+
+	/* Cover the range with the largest aligned prefixes. */
+	while (true) {
+		uint8_t last[IPV6_PREFIXLEN / 8];
+		size_t count = low_zero_bits(cur, len);
+		for (; count > 0; count--) {
+			set_low_bits(last, cur, len, count);
+			if (memcmp(last, end, len) <= 0) {
+				break;
+			}
+		}
+		if (count == 0) {
+			memcpy(last, cur, len);
+		}
+
+		int ret = insert_prefix(acl, start, family, cur, bits - count, rule);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		if (memcmp(last, end, len) == 0) {
+			return KNOT_EOK;
+		}
+		memcpy(cur, last, len);
+		increment(cur, len);
+	}
+}
+
+static int compile_addrs(acl_t *acl, conf_val_t *addrs, acl_start_t *start,
+                         uint32_t rule)
+{
+	/* No address list matches any address. */
+	if (addrs->code == KNOT_ENOENT) {
+		if (start->any == 0) {
+			start->any = rule + 1;
+		}
+		return KNOT_EOK;
+	}
+
+	conf_val_t range = *addrs;
+	if (range.code == KNOT_EOK) {
+		conf_val(&range);
+	}
+	while (range.code == KNOT_EOK) {
+		int prefix;
+		struct sockaddr_storage max;
+		struct sockaddr_storage min = conf_addr_range(&range, &max, &prefix);
+
+		int ret = KNOT_EOK;
+		size_t bits;
+		int family = family_index(min.ss_family, &bits);
+		if (max.ss_family != AF_UNSPEC) {
+			ret = insert_range(acl, start, &min, &max, rule);
+		} else if (family >= 0) {
+			size_t len;
+			const uint8_t *raw = sockaddr_raw((struct sockaddr *)&min, &len);
+			size_t plen = (prefix >= 0 && prefix < bits) ? prefix : bits;
+			ret = insert_prefix(acl, start, family, raw, plen, rule);
+		}
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		conf_val_next(&range);
+	}
+
+	return KNOT_EOK;
+}
+
+static int add_key(conf_t *conf, acl_t *acl, conf_val_t *key)
+{
+	const knot_dname_t *name = conf_dname(key);
+	trie_val_t *val = trie_get_ins(acl->key_names, (const char *)name,
+	                               knot_dname_size(name));
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+	if (*val != NULL) {
+		return KNOT_EOK;
+	}
+
+	acl_key_t *keys = realloc(acl->keys, (acl->keys_count + 1) * sizeof(*keys));
+	if (keys == NULL) {
+		return KNOT_ENOMEM;
+	}
+	acl->keys = keys;
+
+	acl_key_t *new_key = &acl->keys[acl->keys_count];
+	memset(new_key, 0, sizeof(*new_key));
+	*val = (trie_val_t)(uintptr_t)acl->keys_count++;
+
+	new_key->name = knot_dname_copy(name, NULL);
+	if (new_key->name == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	conf_val_t alg = conf_id_get(conf, C_KEY, C_ALG, key);
+	new_key->algorithm = conf_opt(&alg);
+
+	size_t size = 0;
+	conf_val_t secret = conf_id_get(conf, C_KEY, C_SECRET, key);
+	const uint8_t *data = conf_bin(&secret, &size);
+	if (size > 0) {
+		new_key->secret.data = malloc(size);
+		if (new_key->secret.data == NULL) {
+			return KNOT_ENOMEM;
+		}
+		memcpy(new_key->secret.data, data, size);
+		new_key->secret.size = size;
+	}
+
+	return KNOT_EOK;
+}
+
+static int compile_rule(conf_t *conf, acl_t *acl, conf_val_t *rule, uint32_t idx)
+{
+	conf_val_t val = conf_id_get(conf, C_ACL, C_DENY, rule);
+	if (conf_bool(&val)) {
+		acl->rules[idx] |= ACL_RULE_DENY;
+	}
+
+	/* The action check is skipped for ACL_ACTION_NONE. */
+	bool actions[ACL_ACTIONS] = { true };
+	val = conf_id_get(conf, C_ACL, C_ACTION, rule);
+	if (val.code == KNOT_ENOENT) {
+		acl->rules[idx] |= ACL_RULE_NO_ACTION;
+		for (int i = 0; i < ACL_ACTIONS; i++) {
+			actions[i] = true;
+		}
+	}
+	while (val.code == KNOT_EOK) {
+		unsigned action = conf_opt(&val);
+		if (action < ACL_ACTIONS) {
+			actions[action] = true;
+		}
+		conf_val_next(&val);
+	}
+
+	conf_val_t keys = conf_id_get(conf, C_ACL, C_KEY, rule);
+	conf_val_t addrs = conf_id_get(conf, C_ACL, C_ADDR, rule);
+
+	for (int action = 0; action < ACL_ACTIONS; action++) {
+		if (!actions[action]) {
+			continue;
+		}
+		acl_start_t *starts = &acl->starts[action * acl->keys_count];
+
+		/* Empty key list matches requests without TSIG. */
+		if (keys.code == KNOT_ENOENT) {
+			int ret = compile_addrs(acl, &addrs, &starts[0], idx);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+			continue;
+		}
+
+		conf_val_t key = keys;
+		if (key.code == KNOT_EOK) {
+			conf_val(&key);
+		}
+		while (key.code == KNOT_EOK) {
+			const knot_dname_t *name = conf_dname(&key);
+			trie_val_t *key_idx = trie_get_try(acl->key_names, (const char *)name,
+			                                   knot_dname_size(name));
+			assert(key_idx != NULL);
+
+			int ret = compile_addrs(acl, &addrs, &starts[(uintptr_t)*key_idx], idx);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+			conf_val_next(&key);
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+acl_t *acl_compile(conf_t *conf, conf_val_t *acl)
+{
+	if (conf == NULL || acl == NULL) {
+		return NULL;
+	}
+
+	acl_t *out = calloc(1, sizeof(*out));
+	if (out == NULL) {
+		return NULL;
+	}
+
+	/* The node 0 and the key 0 are placeholders. */
+	out->keys = calloc(1, sizeof(*out->keys));
+	out->key_names = trie_create(NULL);
+	if (out->keys == NULL || out->key_names == NULL || node_new(out) != 0) {
+		acl_free(out);
+		return NULL;
+	}
+	out->keys_count = 1;
+
+	/* Collect the keys and count the rules. */
+	conf_val_t rule = *acl;
+	if (rule.code == KNOT_EOK) {
+		conf_val(&rule);
+	}
+	while (rule.code == KNOT_EOK) {
+		conf_val_t key = conf_id_get(conf, C_ACL, C_KEY, &rule);
+		while (key.code == KNOT_EOK) {
+			if (add_key(conf, out, &key) != KNOT_EOK) {
+				acl_free(out);
+				return NULL;
+			}
+			conf_val_next(&key);
+		}
+
+		out->rules_count++;
+		conf_val_next(&rule);
+	}
+
+	out->rules = calloc(out->rules_count + 1, sizeof(*out->rules));
+	out->starts = calloc(ACL_ACTIONS * out->keys_count, sizeof(*out->starts));
+	if (out->rules == NULL || out->starts == NULL) {
+		acl_free(out);
+		return NULL;
+	}
+
+	/* Compile the rules in the configured order. */
+	rule = *acl;
+	if (rule.code == KNOT_EOK) {
+		conf_val(&rule);
+	}
+	for (uint32_t idx = 0; rule.code == KNOT_EOK; idx++) {
+		if (compile_rule(conf, out, &rule, idx) != KNOT_EOK) {
+			acl_free(out);
+			return NULL;
+		}
+		conf_val_next(&rule);
+	}
+
+	return out;
+}
+
+void acl_free(acl_t *acl)
+{
+	if (acl == NULL) {
+		return;
+	}
+
+	for (size_t i = 1; i < acl->keys_count; i++) {
+		knot_dname_free(&acl->keys[i].name, NULL);
+		free(acl->keys[i].secret.data);
+	}
+	free(acl->keys);
+	trie_free(acl->key_names);
+	free(acl->rules);
+	free(acl->starts);
+	free(acl->nodes);
+	free(acl);
+}
+
+bool acl_match(const acl_t *acl, acl_action_t action,
+               const struct sockaddr_storage *addr, knot_tsig_key_t *tsig)
+{
+	if (acl == NULL || addr == NULL || tsig == NULL || action >= ACL_ACTIONS) {
+		return false;
+	}
+
+	/* Find the key, each key id has exactly one algorithm. */
+	size_t key = 0;
+	if (tsig->name != NULL) {
+		trie_val_t *val = trie_get_try(acl->key_names, (const char *)tsig->name,
+		                               knot_dname_size(tsig->name));
+		if (val == NULL) {
+			return false;
+		}
+		key = (uintptr_t)*val;
+		if (acl->keys[key].algorithm != tsig->algorithm) {
+			return false;
+		}
+	}
+
+	/* Find the first matching rule. */
+	const acl_start_t *start = &acl->starts[action * acl->keys_count + key];
+	uint32_t rule = start->any;
+
+	size_t bits;
+	int family = family_index(addr->ss_family, &bits);
+	if (family >= 0) {
+		size_t len;
+		const uint8_t *raw = sockaddr_raw((struct sockaddr *)addr, &len);
+		uint32_t node = start->root[family];
+		for (size_t i = 0; node != 0; i++) {
+			const acl_node_t *n = &acl->nodes[node];
+			if (n->rule != 0 && (rule == 0 || n->rule < rule)) {
+				rule = n->rule;
+			}
+			if (i == bits) {
+				break;
+			}
+			node = n->child[addr_bit(raw, i)];
+		}
+	}
+
+	if (rule == 0) {
+		return false;
+	}
+
+	/* Check if denied. */
+	uint8_t flags = acl->rules[rule - 1];
+	if ((flags & ACL_RULE_DENY) ||
+	    ((flags & ACL_RULE_NO_ACTION) && action != ACL_ACTION_NONE)) {
+		return false;
+	}
+
+	/* Fill the output with tsig secret if provided. */
+	if (tsig->name != NULL) {
+		tsig->secret = acl->keys[key].secret;
+	}
+
+	return true;
+}
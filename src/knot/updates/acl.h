@@ -54,4 +54,48 @@ typedef enum {
 bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
                  const struct sockaddr_storage *addr, knot_tsig_key_t *tsig);
 
+/*!
+ * \brief Compiled access control list.
+ *
+ * The ACL rules are compiled into binary prefix tries of the address ranges
+ * for each action and TSIG key, so the evaluation doesn't depend on the number
+ * of rules. The compiled ACL is immutable, the evaluation is lock-free and
+ * doesn't allocate.
+ */
+typedef struct acl acl_t;
+
+/*!
+ * \brief Compiles the ACL list.
+ *
+ * \param conf  Configuration.
+ * \param acl   Pointer to ACL config multivalued identifier (can be empty).
+ *
+ * \return Compiled ACL or NULL if failed.
+ */
+acl_t *acl_compile(conf_t *conf, conf_val_t *acl);
+
+/*!
+ * \brief Frees the compiled ACL.
+ *
+ * \param acl  Compiled ACL.
+ */
+void acl_free(acl_t *acl);
+
+/*!
+ * \brief Checks if the address and/or tsig key matches the compiled ACL.
+ *
+ * The result is equal to acl_allowed() for the ACL list the compiled ACL was
+ * created from. If tsig.name is not empty, tsig.secret is filled with the data
+ * owned by the compiled ACL.
+ *
+ * \param acl     Compiled ACL.
+ * \param action  ACL action.
+ * \param addr    IP address.
+ * \param tsig    TSIG parameters.
+ *
+ * \retval True if authenticated.
+ */
+bool acl_match(const acl_t *acl, acl_action_t action,
+               const struct sockaddr_storage *addr, knot_tsig_key_t *tsig);
+
 /*! @} */
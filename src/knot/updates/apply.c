@@ -180,6 +180,20 @@ static int apply_add(apply_ctx_t *ctx, const changeset_t *chset)
 	return KNOT_EOK;
 }
 
+/*! \brief Records the changed node for incremental adjusting. */
+static int add_changed(apply_ctx_t *ctx, const knot_rrset_t *rr)
+{
+	return zone_tree_owners_add(knot_rrset_is_nsec3rel(rr) ? &ctx->changed_nsec3 :
+	                            &ctx->changed, rr->owner);
+}
+
+/*! \brief Adjusts the nodes affected by the changes. */
+static int adjust_changed(apply_ctx_t *ctx)
+{
+	return zone_contents_adjust_incremental(ctx->contents, ctx->changed,
+	                                        ctx->changed_nsec3);
+}
+
 /*! \brief Apply single change to zone contents structure. */
 static int apply_single(apply_ctx_t *ctx, const changeset_t *chset)
 {
@@ -223,6 +237,8 @@ void apply_init_ctx(apply_ctx_t *ctx, zone_contents_t *contents, uint32_t flags)
 	init_list(&ctx->old_data);
 	init_list(&ctx->new_data);
 
+	ctx->changed = NULL;
+	ctx->changed_nsec3 = NULL;
 	ctx->flags = flags;
 }
 
@@ -234,15 +250,22 @@ int apply_prepare_zone_copy(zone_contents_t *old_contents,
 	}
 
 	/*
-	 * Create a shallow copy of the zone, so that the structures may be
-	 * updated.
-	 *
-	 * This will create new zone contents structures (normal nodes' tree,
-	 * NSEC3 tree), and copy all nodes.
-	 * The data in the nodes (RRSets) remain the same though.
+	 * Create a copy-on-write version of the zone, so that the structures
+	 * may be updated. Only the changed nodes and zone tree paths will
+	 * be copied.
 	 */
 	zone_contents_t *contents_copy = NULL;
-	int ret = zone_contents_shallow_copy(old_contents, &contents_copy);
+	int ret = zone_contents_cow(old_contents, &contents_copy);
+	if (ret == KNOT_EINVAL || ret == KNOT_EBUSY) {
+		/*
+		 * Create a shallow copy of the zone if not possible.
+		 *
+		 * This will create new zone contents structures (normal nodes'
+		 * tree, NSEC3 tree), and copy all nodes.
+		 * The data in the nodes (RRSets) remain the same though.
+		 */
+		ret = zone_contents_shallow_copy(old_contents, &contents_copy);
+	}
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -256,17 +279,28 @@ int apply_add_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 {
 	zone_contents_t *contents = ctx->contents;
 
+	int ret = add_changed(ctx, rr);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	// Get or create node with this owner
 	zone_node_t *node = zone_contents_get_node_for_rr(contents, rr);
 	if (node == NULL) {
 		return KNOT_ENOMEM;
 	}
 
+	// Unshare the node data with the old version.
+	ret = binode_prepare_change(node, NULL);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	knot_rrset_t changed_rrset = node_rrset(node, rr->type);
 	if (!knot_rrset_empty(&changed_rrset)) {
 		// Modifying existing RRSet.
 		knot_rdata_t *old_data = changed_rrset.rrs.data;
-		int ret = replace_rdataset_with_copy(node, rr->type);
+		ret = replace_rdataset_with_copy(node, rr->type);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
@@ -280,7 +314,7 @@ int apply_add_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 	}
 
 	// Insert new RR to RRSet, data will be copied.
-	int ret = node_add_rrset(node, rr, NULL);
+	ret = node_add_rrset(node, rr, NULL);
 	if (ret == KNOT_EOK || ret == KNOT_ETTL) {
 		// RR added, store for possible rollback.
 		knot_rdataset_t *rrs = node_rdataset(node, rr->type);
@@ -319,9 +353,20 @@ int apply_remove_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 	zone_tree_t *tree = knot_rrset_is_nsec3rel(rr) ?
 	                    contents->nsec3_nodes : contents->nodes;
 
+	int ret = add_changed(ctx, rr);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	// Unshare the node data with the old version.
+	ret = binode_prepare_change(node, NULL);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	knot_rrset_t removed_rrset = node_rrset(node, rr->type);
 	knot_rdata_t *old_data = removed_rrset.rrs.data;
-	int ret = replace_rdataset_with_copy(node, rr->type);
+	ret = replace_rdataset_with_copy(node, rr->type);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -384,6 +429,11 @@ int apply_replace_soa(apply_ctx_t *ctx, const changeset_t *chset)
 
 int apply_prepare_to_sign(apply_ctx_t *ctx)
 {
+	/* Copies are adjusted incrementally, which is cheaper anyway. */
+	if (ctx->contents->cow_base != NULL) {
+		return adjust_changed(ctx);
+	}
+
 	return zone_contents_adjust_pointers(ctx->contents);
 }
 
@@ -415,7 +465,7 @@ int apply_changesets(apply_ctx_t *ctx, zone_contents_t *old_contents,
 
 	assert(contents_copy->apex != NULL);
 
-	ret = zone_contents_adjust_full(contents_copy);
+	ret = adjust_changed(ctx);
 	if (ret != KNOT_EOK) {
 		update_rollback(ctx);
 		update_free_zone(&ctx->contents);
@@ -449,7 +499,7 @@ int apply_changeset(apply_ctx_t *ctx, zone_contents_t *old_contents,
 		return ret;
 	}
 
-	ret = zone_contents_adjust_full(contents_copy);
+	ret = adjust_changed(ctx);
 	if (ret != KNOT_EOK) {
 		update_rollback(ctx);
 		update_free_zone(&ctx->contents);
@@ -475,7 +525,7 @@ int apply_changesets_directly(apply_ctx_t *ctx, list_t *chsets)
 		}
 	}
 
-	return zone_contents_adjust_full(ctx->contents);
+	return adjust_changed(ctx);
 }
 
 int apply_changeset_directly(apply_ctx_t *ctx, const changeset_t *ch)
@@ -490,7 +540,7 @@ int apply_changeset_directly(apply_ctx_t *ctx, const changeset_t *ch)
 		return ret;
 	}
 
-	ret = zone_contents_adjust_full(ctx->contents);
+	ret = adjust_changed(ctx);
 	if (ret != KNOT_EOK) {
 		update_rollback(ctx);
 		return ret;
@@ -501,7 +551,7 @@ int apply_changeset_directly(apply_ctx_t *ctx, const changeset_t *ch)
 
 int apply_finalize(apply_ctx_t *ctx)
 {
-	return zone_contents_adjust_full(ctx->contents);
+	return adjust_changed(ctx);
 }
 
 void update_cleanup(apply_ctx_t *ctx)
@@ -516,6 +566,9 @@ void update_cleanup(apply_ctx_t *ctx)
 	// Keep new RR data
 	ptrlist_free(&ctx->new_data, NULL);
 	init_list(&ctx->new_data);
+
+	zone_tree_owners_free(&ctx->changed);
+	zone_tree_owners_free(&ctx->changed_nsec3);
 }
 
 void update_rollback(apply_ctx_t *ctx)
@@ -530,6 +583,9 @@ void update_rollback(apply_ctx_t *ctx)
 	// Keep old RR data
 	ptrlist_free(&ctx->old_data, NULL);
 	init_list(&ctx->old_data);
+
+	zone_tree_owners_free(&ctx->changed);
+	zone_tree_owners_free(&ctx->changed_nsec3);
 }
 
 void update_free_zone(zone_contents_t **contents)
@@ -538,12 +594,16 @@ void update_free_zone(zone_contents_t **contents)
 		return;
 	}
 
+	zone_contents_cow_wait(*contents);
+
+	if ((*contents)->cow_base != NULL) {
+		zone_contents_cow_rollback(contents);
+		return;
+	}
+
 	zone_tree_apply((*contents)->nodes, free_additional, NULL);
 	zone_tree_deep_free(&(*contents)->nodes);
 	zone_tree_deep_free(&(*contents)->nsec3_nodes);
 
-	dnssec_nsec3_params_free(&(*contents)->nsec3_params);
-
-	free(*contents);
-	*contents = NULL;
+	zone_contents_free(contents);
 }
@@ -28,6 +28,8 @@ struct apply_ctx {
 	zone_contents_t *contents;
 	list_t old_data;          /*!< Old data, to be freed after successful update. */
 	list_t new_data;          /*!< New data, to be freed after failed update. */
+	trie_t *changed;          /*!< Owners of the changed nodes. */
+	trie_t *changed_nsec3;    /*!< Owners of the changed NSEC3 nodes. */
 	uint32_t flags;
 };
 
@@ -43,7 +45,10 @@ typedef struct apply_ctx apply_ctx_t;
 void apply_init_ctx(apply_ctx_t *ctx, zone_contents_t *contents, uint32_t flags);
 
 /*!
- * \brief Creates a shallow zone contents copy.
+ * \brief Creates a copy-on-write or shallow zone contents copy.
+ *
+ * The copy-on-write version is used if possible, it's finished by
+ * zone_switch_contents() or update_free_zone().
  *
  * \param old_contents  Source.
  * \param new_contents  Target.
@@ -145,7 +150,7 @@ int apply_changeset_directly(apply_ctx_t *ctx, const changeset_t *ch);
 /*!
  * \brief Finalizes the zone contents for publishing.
  *
- * Fully adjusts the zone.
+ * Adjusts the zone nodes affected by the applied changes.
  *
  * \param ctx  Apply context.
  *
@@ -171,6 +176,8 @@ void update_rollback(apply_ctx_t *ctx);
  * \brief Shallow frees zone contents - either shallow copy after failed update
  *        or original zone contents after successful update.
  *
+ * A copy-on-write version after failed update is rolled back.
+ *
  * \param contents  Contents to free.
  */
 void update_free_zone(zone_contents_t **contents);
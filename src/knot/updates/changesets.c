@@ -74,12 +74,14 @@ static int changeset_iter_init(changeset_iter_t *ch_it, size_t tries, ...)
 	va_start(args, tries);
 
 	for (size_t i = 0; i < tries; ++i) {
-		trie_t *t = va_arg(args, trie_t *);
+		zone_tree_t *t = va_arg(args, zone_tree_t *);
 		if (t == NULL) {
 			continue;
 		}
 
-		trie_it_t *it = trie_it_begin(t);
+		// Changeset trees are never copied-on-write, the nodes are stored directly.
+		assert(!(t->flags & ZONE_TREE_SECOND));
+		trie_it_t *it = trie_it_begin(t->trie);
 		if (it == NULL) {
 			cleanup_iter_list(&ch_it->iters);
 			va_end(args);
@@ -194,12 +196,12 @@ int changeset_init(changeset_t *ch, const knot_dname_t *apex)
 {
 	memset(ch, 0, sizeof(changeset_t));
 
-	// Init local changes
-	ch->add = zone_contents_new(apex);
+	// Init local changes, additions may become zone contents
+	ch->add = zone_contents_new(apex, true);
 	if (ch->add == NULL) {
 		return KNOT_ENOMEM;
 	}
-	ch->remove = zone_contents_new(apex);
+	ch->remove = zone_contents_new(apex, false);
 	if (ch->remove == NULL) {
 		zone_contents_free(&ch->add);
 		return KNOT_ENOMEM;
@@ -15,6 +15,7 @@
  */
 
 #include "knot/common/log.h"
+#include "knot/conf/zones.h"
 #include "knot/dnssec/zone-events.h"
 #include "knot/updates/zone-update.h"
 #include "knot/zone/serial.h"
@@ -38,7 +39,12 @@ static int init_incremental(zone_update_t *update, zone_t *zone)
 
 	update->new_cont_deep_copy = false;
 
-	ret = apply_prepare_zone_copy(zone->contents, &update->new_cont);
+	/* Long-lived control transactions don't block copy-on-write of events. */
+	if (update == zone->control_update) {
+		ret = zone_contents_shallow_copy(zone->contents, &update->new_cont);
+	} else {
+		ret = apply_prepare_zone_copy(zone->contents, &update->new_cont);
+	}
 	if (ret != KNOT_EOK) {
 		changeset_clear(&update->change);
 		return ret;
@@ -51,7 +57,7 @@ static int init_incremental(zone_update_t *update, zone_t *zone)
 	update->change.soa_from =
 		node_create_rrset(zone->contents->apex, KNOT_RRTYPE_SOA);
 	if (update->change.soa_from == NULL) {
-		zone_contents_free(&update->new_cont);
+		update_free_zone(&update->new_cont);
 		changeset_clear(&update->change);
 		return KNOT_ENOMEM;
 	}
@@ -61,7 +67,7 @@ static int init_incremental(zone_update_t *update, zone_t *zone)
 
 static int init_full(zone_update_t *update, zone_t *zone)
 {
-	update->new_cont = zone_contents_new(zone->name);
+	update->new_cont = zone_contents_new(zone->name, true);
 	if (update->new_cont == NULL) {
 		return KNOT_ENOMEM;
 	}
@@ -529,8 +535,7 @@ int zone_update_increment_soa(zone_update_t *update, conf_t *conf)
 		return KNOT_EINVAL;
 	}
 
-	conf_val_t val = conf_zone_get(conf, C_SERIAL_POLICY, update->zone->name);
-	return set_new_soa(update, conf_opt(&val));
+	return set_new_soa(update, conf_zone(conf, update->zone->name).serial_policy);
 }
 
 static int commit_incremental(conf_t *conf, zone_update_t *update,
@@ -565,8 +570,7 @@ static int commit_incremental(conf_t *conf, zone_update_t *update,
 	}
 
 	/* Write changes to journal if all went well. */
-	conf_val_t val = conf_zone_get(conf, C_JOURNAL_CONTENT, update->zone->name);
-	if (conf_opt(&val) != JOURNAL_CONTENT_NONE) {
+	if (conf_zone(conf, update->zone->name).journal_content != JOURNAL_CONTENT_NONE) {
 		ret = zone_change_store(conf, update->zone, &update->change);
 		if (ret != KNOT_EOK) {
 			return ret;
@@ -597,8 +601,7 @@ static int commit_full(conf_t *conf, zone_update_t *update, zone_contents_t **co
 	}
 
 	/* Store new zone contents in journal. */
-	conf_val_t val = conf_zone_get(conf, C_JOURNAL_CONTENT, update->zone->name);
-	if (conf_opt(&val) == JOURNAL_CONTENT_ALL) {
+	if (conf_zone(conf, update->zone->name).journal_content == JOURNAL_CONTENT_ALL) {
 		ret = zone_in_journal_store(conf, update->zone, update->new_cont);
 		if (ret != KNOT_EOK) {
 			return ret;
@@ -670,8 +673,8 @@ int zone_update_commit(conf_t *conf, zone_update_t *update)
 	}
 
 	/* Check the zone size. */
-	conf_val_t val = conf_zone_get(conf, C_MAX_ZONE_SIZE, update->zone->name);
-	size_t size_limit = conf_int(&val);
+	conf_zone_t zconf = conf_zone(conf, update->zone->name);
+	size_t size_limit = zconf.max_zone_size;
 
 	if (new_contents->size > size_limit) {
 		/* Recoverable error. */
@@ -699,8 +702,7 @@ int zone_update_commit(conf_t *conf, zone_update_t *update)
 	update->new_cont = NULL;
 
 	/* Sync zonefile immediately if configured. */
-	val = conf_zone_get(conf, C_ZONEFILE_SYNC, update->zone->name);
-	if (conf_int(&val) == 0) {
+	if (zconf.zonefile_sync == 0) {
 		zone_events_schedule_now(update->zone, ZONE_EVENT_FLUSH);
 	}
 
@@ -715,27 +717,31 @@ static int iter_init_tree_iters(zone_update_iter_t *it, zone_update_t *update,
 
 	/* Begin iteration. We can safely assume _contents is a valid pointer. */
 	zone_tree_t *tree = nsec3 ? _contents->nsec3_nodes : _contents->nodes;
-	it->tree_it = trie_it_begin(tree);
-	if (it->tree_it == NULL) {
-		return KNOT_ENOMEM;
+	int ret = zone_tree_it_begin(tree, &it->tree_it);
+	if (ret != KNOT_EOK) {
+		return ret;
 	}
 
-	it->cur_node = (zone_node_t *)(*trie_it_val(it->tree_it));
+	if (zone_tree_it_finished(&it->tree_it)) {
+		zone_tree_it_free(&it->tree_it);
+		it->cur_node = NULL;
+	} else {
+		it->cur_node = zone_tree_it_val(&it->tree_it);
+	}
 
 	return KNOT_EOK;
 }
 
 static int iter_get_next_node(zone_update_iter_t *it)
 {
-	trie_it_next(it->tree_it);
-	if (trie_it_finished(it->tree_it)) {
-		trie_it_free(it->tree_it);
-		it->tree_it = NULL;
+	zone_tree_it_next(&it->tree_it);
+	if (zone_tree_it_finished(&it->tree_it)) {
+		zone_tree_it_free(&it->tree_it);
 		it->cur_node = NULL;
 		return KNOT_ENOENT;
 	}
 
-	it->cur_node = (zone_node_t *)(*trie_it_val(it->tree_it));
+	it->cur_node = zone_tree_it_val(&it->tree_it);
 
 	return KNOT_EOK;
 }
@@ -746,14 +752,7 @@ static int iter_init(zone_update_iter_t *it, zone_update_t *update, const bool n
 
 	it->update = update;
 	it->nsec3 = nsec3;
-	int ret = iter_init_tree_iters(it, update, nsec3);
-	if (ret != KNOT_EOK) {
-		return ret;
-	}
-
-	it->cur_node = (zone_node_t *)(*trie_it_val(it->tree_it));
-
-	return KNOT_EOK;
+	return iter_init_tree_iters(it, update, nsec3);
 }
 
 int zone_update_iter(zone_update_iter_t *it, zone_update_t *update)
@@ -793,7 +792,7 @@ int zone_update_iter_next(zone_update_iter_t *it)
 		return KNOT_EINVAL;
 	}
 
-	if (it->tree_it != NULL) {
+	if (it->tree_it.it != NULL) {
 		int ret = iter_get_next_node(it);
 		if (ret != KNOT_EOK && ret != KNOT_ENOENT) {
 			return ret;
@@ -818,7 +817,7 @@ void zone_update_iter_finish(zone_update_iter_t *it)
 		return;
 	}
 
-	trie_it_free(it->tree_it);
+	zone_tree_it_free(&it->tree_it);
 }
 
 bool zone_update_no_change(zone_update_t *update)
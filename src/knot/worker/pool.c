@@ -24,25 +24,162 @@
 #include "knot/server/dthreads.h"
 #include "knot/worker/pool.h"
 
+#ifdef HAVE_ATOMIC
+ #define ATOMIC_GET(src)         __atomic_load_n(&(src), __ATOMIC_SEQ_CST)
+ #define ATOMIC_SET(dst, val)    __atomic_store_n(&(dst), val, __ATOMIC_SEQ_CST)
+ #define ATOMIC_ADD(dst, val)    __atomic_add_fetch(&(dst), val, __ATOMIC_SEQ_CST)
+ #define ATOMIC_SUB(dst, val)    __atomic_sub_fetch(&(dst), val, __ATOMIC_SEQ_CST)
+#else
+ #define ATOMIC_GET(src)         __sync_fetch_and_add(&(src), 0)
+ #define ATOMIC_SET(dst, val)    __sync_lock_test_and_set(&(dst), val)
+ #define ATOMIC_ADD(dst, val)    __sync_add_and_fetch(&(dst), val)
+ #define ATOMIC_SUB(dst, val)    __sync_sub_and_fetch(&(dst), val)
+#endif
+
+/*! \brief Order in which the priority classes are served. */
+static const task_prio_t PRIO_ORDER[TASK_PRIO_COUNT] = {
+	TASK_PRIO_HIGH, TASK_PRIO_NORMAL, TASK_PRIO_LOW
+};
+
+/*!
+ * \brief Worker state.
+ *
+ * Both the owner and the stealing workers take the tasks from the queue
+ * heads, so the tasks of a class are started in the order of assignment.
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	bool sleeping;
+	worker_queue_t tasks[TASK_PRIO_COUNT];
+} worker_t;
+
 /*!
  * \brief Worker pool state.
  */
 struct worker_pool {
 	dt_unit_t *threads;
+	worker_t *workers;
+	unsigned count;
 
 	pthread_mutex_t lock;
-	pthread_cond_t wake;
-
-	bool terminating;	/*!< Is the pool terminating? .*/
-	bool suspended;		/*!< Is execution temporarily suspended? .*/
-	int running;		/*!< Number of running threads. */
-	worker_queue_t tasks;
+	pthread_cond_t done;
+
+	int terminating;	/*!< Is the pool terminating? */
+	int suspended;		/*!< Is execution temporarily suspended? */
+	unsigned running;	/*!< Number of running tasks. */
+	unsigned pending;	/*!< Number of enqueued tasks. */
+	unsigned idle;		/*!< Number of sleeping workers. */
+	unsigned next;		/*!< Next worker to assign a task to. */
+	worker_pool_stats_t stats[TASK_PRIO_COUNT]; /*!< Also the pending tasks per class. */
 };
 
+static void worker_wake(worker_t *worker)
+{
+	pthread_mutex_lock(&worker->lock);
+	if (worker->sleeping) {
+		pthread_cond_signal(&worker->wake);
+	}
+	pthread_mutex_unlock(&worker->lock);
+}
+
+/*!
+ * \brief Wake up the worker with new tasks, or any idle worker to steal them.
+ */
+static void pool_wake(worker_pool_t *pool, unsigned target)
+{
+	worker_t *worker = &pool->workers[target];
+
+	pthread_mutex_lock(&worker->lock);
+	bool sleeping = worker->sleeping;
+	if (sleeping) {
+		pthread_cond_signal(&worker->wake);
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	if (sleeping || ATOMIC_GET(pool->idle) == 0) {
+		return;
+	}
+
+	for (unsigned i = 1; i < pool->count; i++) {
+		worker = &pool->workers[(target + i) % pool->count];
+		pthread_mutex_lock(&worker->lock);
+		sleeping = worker->sleeping;
+		if (sleeping) {
+			pthread_cond_signal(&worker->wake);
+		}
+		pthread_mutex_unlock(&worker->lock);
+		if (sleeping) {
+			return;
+		}
+	}
+}
+
+/*!
+ * \brief Take a task from the worker queue, the worker must be locked.
+ */
+static task_t *worker_take(worker_pool_t *pool, worker_t *worker,
+                           task_prio_t prio, bool steal)
+{
+	/* Checked under the lock, not to take tasks assigned after suspend. */
+	if (ATOMIC_GET(pool->suspended)) {
+		return NULL;
+	}
+
+	uint64_t wait_usec = 0;
+	task_t *task = worker_queue_take(&worker->tasks[prio], &wait_usec);
+	if (task == NULL) {
+		return NULL;
+	}
+
+	/* Running before not pending, so the pool never looks finished. */
+	ATOMIC_ADD(pool->running, 1);
+	ATOMIC_SUB(pool->pending, 1);
+
+	worker_pool_stats_t *stats = &pool->stats[prio];
+	ATOMIC_SUB(stats->queued, 1);
+	ATOMIC_ADD(stats->executed, 1);
+	ATOMIC_ADD(stats->wait_usec, wait_usec);
+	if (steal) {
+		ATOMIC_ADD(stats->stolen, 1);
+	}
+
+	return task;
+}
+
+/*!
+ * \brief Find the highest priority task, own queue first.
+ */
+static task_t *worker_next(worker_pool_t *pool, unsigned id)
+{
+	for (int p = 0; p < TASK_PRIO_COUNT; p++) {
+		task_prio_t prio = PRIO_ORDER[p];
+
+		/* Don't lock all the workers for an empty class. */
+		if (ATOMIC_GET(pool->stats[prio].queued) == 0) {
+			continue;
+		}
+
+		for (unsigned i = 0; i < pool->count; i++) {
+			worker_t *worker = &pool->workers[(id + i) % pool->count];
+
+			pthread_mutex_lock(&worker->lock);
+			task_t *task = worker_take(pool, worker, prio, i > 0);
+			pthread_mutex_unlock(&worker->lock);
+
+			if (task != NULL) {
+				return task;
+			}
+		}
+	}
+
+	return NULL;
+}
+
 /*!
  * \brief Worker thread.
  *
- * The thread takes a task from the tasks queue and runs it, while checking
+ * The thread takes a task from the tasks queues and runs it, while checking
  * if the dispatching of new tasks is allowed by the thread pool.
  *
  * An execution of a running thread cannot be enforced.
@@ -53,37 +190,42 @@ static int worker_main(dthread_t *thread)
 	assert(thread);
 
 	worker_pool_t *pool = thread->data;
-
-	pthread_mutex_lock(&pool->lock);
+	unsigned id = dt_get_id(thread);
+	assert(id < pool->count);
+	worker_t *self = &pool->workers[id];
 
 	for (;;) {
-		if (pool->terminating) {
+		if (ATOMIC_GET(pool->terminating)) {
 			break;
 		}
 
-		task_t *task = NULL;
-		if (!pool->suspended) {
-			task = worker_queue_dequeue(&pool->tasks);
-		}
-
-		if (task == NULL) {
-			pthread_cond_wait(&pool->wake, &pool->lock);
+		task_t *task = worker_next(pool, id);
+		if (task != NULL) {
+			assert(task->run);
+			task->run(task);
+
+			if (ATOMIC_SUB(pool->running, 1) == 0 &&
+			    ATOMIC_GET(pool->pending) == 0) {
+				pthread_mutex_lock(&pool->lock);
+				pthread_cond_broadcast(&pool->done);
+				pthread_mutex_unlock(&pool->lock);
+			}
 			continue;
 		}
 
-		assert(task->run);
-		pool->running += 1;
-
-		pthread_mutex_unlock(&pool->lock);
-		task->run(task);
-		pthread_mutex_lock(&pool->lock);
-
-		pool->running -= 1;
-		pthread_cond_broadcast(&pool->wake);
+		/* Sleep unless a task was assigned meanwhile. */
+		pthread_mutex_lock(&self->lock);
+		self->sleeping = true;
+		ATOMIC_ADD(pool->idle, 1);
+		if (!ATOMIC_GET(pool->terminating) &&
+		    (ATOMIC_GET(pool->pending) == 0 || ATOMIC_GET(pool->suspended))) {
+			pthread_cond_wait(&self->wake, &self->lock);
+		}
+		ATOMIC_SUB(pool->idle, 1);
+		self->sleeping = false;
+		pthread_mutex_unlock(&self->lock);
 	}
 
-	pthread_mutex_unlock(&pool->lock);
-
 	return KNOT_EOK;
 }
 
@@ -97,26 +239,39 @@ worker_pool_t *worker_pool_create(unsigned threads)
 	}
 
 	memset(pool, 0, sizeof(worker_pool_t));
-	pool->threads = dt_create(threads, worker_main, NULL, pool);
-	if (pool->threads == NULL) {
-		goto fail;
+	pool->workers = calloc(threads, sizeof(worker_t));
+	if (pool->workers == NULL) {
+		free(pool);
+		return NULL;
+	}
+	pool->count = threads;
+
+	for (unsigned i = 0; i < threads; i++) {
+		worker_t *worker = &pool->workers[i];
+		pthread_mutex_init(&worker->lock, NULL);
+		pthread_cond_init(&worker->wake, NULL);
+		for (int p = 0; p < TASK_PRIO_COUNT; p++) {
+			worker_queue_init(&worker->tasks[p]);
+		}
 	}
 
 	if (pthread_mutex_init(&pool->lock, NULL) != 0) {
 		goto fail;
 	}
 
-	if (pthread_cond_init(&pool->wake, NULL) != 0) {
+	if (pthread_cond_init(&pool->done, NULL) != 0) {
 		goto fail;
 	}
 
-	worker_queue_init(&pool->tasks);
+	pool->threads = dt_create(threads, worker_main, NULL, pool);
+	if (pool->threads == NULL) {
+		goto fail;
+	}
 
 	return pool;
 
 fail:
-	dt_delete(&pool->threads);
-	free(pool);
+	worker_pool_destroy(pool);
 	return NULL;
 }
 
@@ -129,9 +284,17 @@ void worker_pool_destroy(worker_pool_t *pool)
 	dt_delete(&pool->threads);
 
 	pthread_mutex_destroy(&pool->lock);
-	pthread_cond_destroy(&pool->wake);
-
-	worker_queue_deinit(&pool->tasks);
+	pthread_cond_destroy(&pool->done);
+
+	for (unsigned i = 0; i < pool->count; i++) {
+		worker_t *worker = &pool->workers[i];
+		pthread_mutex_destroy(&worker->lock);
+		pthread_cond_destroy(&worker->wake);
+		for (int p = 0; p < TASK_PRIO_COUNT; p++) {
+			worker_queue_deinit(&worker->tasks[p]);
+		}
+	}
+	free(pool->workers);
 
 	free(pool);
 }
@@ -151,10 +314,11 @@ void worker_pool_stop(worker_pool_t *pool)
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	pool->terminating = true;
-	pthread_cond_broadcast(&pool->wake);
-	pthread_mutex_unlock(&pool->lock);
+	ATOMIC_SET(pool->terminating, true);
+
+	for (unsigned i = 0; i < pool->count; i++) {
+		worker_wake(&pool->workers[i]);
+	}
 
 	dt_stop(pool->threads);
 }
@@ -165,9 +329,7 @@ void worker_pool_suspend(worker_pool_t *pool)
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	pool->suspended = true;
-	pthread_mutex_unlock(&pool->lock);
+	ATOMIC_SET(pool->suspended, true);
 }
 
 void worker_pool_resume(worker_pool_t *pool)
@@ -176,10 +338,11 @@ void worker_pool_resume(worker_pool_t *pool)
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	pool->suspended = false;
-	pthread_cond_broadcast(&pool->wake);
-	pthread_mutex_unlock(&pool->lock);
+	ATOMIC_SET(pool->suspended, false);
+
+	for (unsigned i = 0; i < pool->count; i++) {
+		worker_wake(&pool->workers[i]);
+	}
 }
 
 void worker_pool_join(worker_pool_t *pool)
@@ -198,22 +361,45 @@ void worker_pool_wait(worker_pool_t *pool)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	while (!EMPTY_LIST(pool->tasks.list) || pool->running > 0) {
-		pthread_cond_wait(&pool->wake, &pool->lock);
+	while (ATOMIC_GET(pool->pending) > 0 || ATOMIC_GET(pool->running) > 0) {
+		pthread_cond_wait(&pool->done, &pool->lock);
 	}
 	pthread_mutex_unlock(&pool->lock);
 }
 
 void worker_pool_assign(worker_pool_t *pool, struct task *task)
 {
-	if (!pool || !task) {
+	worker_pool_assign_batch(pool, &task, 1);
+}
+
+void worker_pool_assign_batch(worker_pool_t *pool, struct task **tasks,
+                              size_t count)
+{
+	if (!pool || !tasks || count == 0) {
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	worker_queue_enqueue(&pool->tasks, task);
-	pthread_cond_signal(&pool->wake);
-	pthread_mutex_unlock(&pool->lock);
+	/* Spread the tasks over the workers starting at the next one. */
+	unsigned first = ATOMIC_ADD(pool->next, count) - count;
+	unsigned workers = (count < pool->count) ? count : pool->count;
+
+	for (unsigned w = 0; w < workers; w++) {
+		unsigned target = (first + w) % pool->count;
+		worker_t *worker = &pool->workers[target];
+
+		pthread_mutex_lock(&worker->lock);
+		for (size_t i = w; i < count; i += workers) {
+			task_t *task = tasks[i];
+			assert(task->prio < TASK_PRIO_COUNT);
+			if (worker_queue_enqueue(&worker->tasks[task->prio], task)) {
+				ATOMIC_ADD(pool->stats[task->prio].queued, 1);
+				ATOMIC_ADD(pool->pending, 1);
+			}
+		}
+		pthread_mutex_unlock(&worker->lock);
+
+		pool_wake(pool, target);
+	}
 }
 
 void worker_pool_clear(worker_pool_t *pool)
@@ -222,8 +408,35 @@ void worker_pool_clear(worker_pool_t *pool)
 		return;
 	}
 
+	for (unsigned i = 0; i < pool->count; i++) {
+		worker_t *worker = &pool->workers[i];
+
+		pthread_mutex_lock(&worker->lock);
+		for (int p = 0; p < TASK_PRIO_COUNT; p++) {
+			while (worker_queue_take(&worker->tasks[p], NULL) != NULL) {
+				ATOMIC_SUB(pool->stats[p].queued, 1);
+				ATOMIC_SUB(pool->pending, 1);
+			}
+		}
+		pthread_mutex_unlock(&worker->lock);
+	}
+
+	/* Unblock the waiters if nothing is running. */
 	pthread_mutex_lock(&pool->lock);
-	worker_queue_deinit(&pool->tasks);
-	worker_queue_init(&pool->tasks);
+	pthread_cond_broadcast(&pool->done);
 	pthread_mutex_unlock(&pool->lock);
 }
+
+void worker_pool_stats(worker_pool_t *pool, task_prio_t prio,
+                       worker_pool_stats_t *stats)
+{
+	if (!pool || prio >= TASK_PRIO_COUNT || !stats) {
+		return;
+	}
+
+	worker_pool_stats_t *src = &pool->stats[prio];
+	stats->queued = ATOMIC_GET(src->queued);
+	stats->executed = ATOMIC_GET(src->executed);
+	stats->stolen = ATOMIC_GET(src->stolen);
+	stats->wait_usec = ATOMIC_GET(src->wait_usec);
+}
@@ -21,6 +21,16 @@
 struct worker_pool;
 typedef struct worker_pool worker_pool_t;
 
+/*!
+ * \brief Worker pool statistics of a task priority class.
+ */
+typedef struct {
+	uint64_t queued;    /*!< Number of tasks waiting in the queues. */
+	uint64_t executed;  /*!< Number of started tasks. */
+	uint64_t stolen;    /*!< Number of tasks taken from another worker. */
+	uint64_t wait_usec; /*!< Total time the started tasks spent in the queues. */
+} worker_pool_stats_t;
+
 /*!
  * \brief Initialize worker pool.
  *
@@ -68,10 +78,26 @@ void worker_pool_wait(worker_pool_t *pool);
 
 /*!
  * \brief Assign a task to be performed by a worker in the pool.
+ *
+ * The tasks are distributed among the worker queues, the idle workers steal
+ * the tasks from the busy ones. The higher priority tasks are always taken
+ * first.
  */
 void worker_pool_assign(worker_pool_t *pool, struct task *task);
 
+/*!
+ * \brief Assign several tasks at once, each worker queue is locked only once.
+ */
+void worker_pool_assign_batch(worker_pool_t *pool, struct task **tasks,
+                              size_t count);
+
 /*!
  * \brief Clear all tasks enqueued in pool processing queue.
  */
 void worker_pool_clear(worker_pool_t *pool);
+
+/*!
+ * \brief Get the statistics of the task priority class.
+ */
+void worker_pool_stats(worker_pool_t *pool, task_prio_t prio,
+                       worker_pool_stats_t *stats);
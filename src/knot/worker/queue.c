@@ -14,9 +14,17 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <time.h>
+
 #include "knot/worker/queue.h"
 #include "contrib/mempattern.h"
 
+typedef struct {
+	node_t n;
+	task_t *task;
+	struct timespec queued;
+} queue_node_t;
+
 void worker_queue_init(worker_queue_t *queue)
 {
 	if (!queue) {
@@ -31,32 +39,54 @@ void worker_queue_init(worker_queue_t *queue)
 
 void worker_queue_deinit(worker_queue_t *queue)
 {
-	ptrlist_free(&queue->list, &queue->mm_ctx);
+	node_t *n, *nxt;
+	WALK_LIST_DELSAFE(n, nxt, queue->list) {
+		mm_free(&queue->mm_ctx, n);
+	}
+	init_list(&queue->list);
 }
 
-void worker_queue_enqueue(worker_queue_t *queue, task_t *task)
+bool worker_queue_enqueue(worker_queue_t *queue, task_t *task)
 {
 	if (!queue || !task) {
-		return;
+		return false;
+	}
+
+	queue_node_t *node = mm_alloc(&queue->mm_ctx, sizeof(*node));
+	if (node == NULL) {
+		return false;
 	}
 
-	ptrlist_add(&queue->list, task, &queue->mm_ctx);
+	node->task = task;
+	clock_gettime(CLOCK_MONOTONIC, &node->queued);
+	add_tail(&queue->list, &node->n);
+
+	return true;
 }
 
 task_t *worker_queue_dequeue(worker_queue_t *queue)
 {
-	if (!queue) {
+	return worker_queue_take(queue, NULL);
+}
+
+task_t *worker_queue_take(worker_queue_t *queue, uint64_t *wait_usec)
+{
+	if (!queue || EMPTY_LIST(queue->list)) {
 		return NULL;
 	}
 
-	task_t *task = NULL;
+	queue_node_t *node = HEAD(queue->list);
+	task_t *task = node->task;
 
-	if (!EMPTY_LIST(queue->list)) {
-		ptrnode_t *node = HEAD(queue->list);
-		task = (void *)node->d;
-		rem_node(&node->n);
-		queue->mm_ctx.free(&node->n);
+	if (wait_usec != NULL) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		*wait_usec = (now.tv_sec - node->queued.tv_sec) * 1000000 +
+		             (now.tv_nsec - node->queued.tv_nsec) / 1000;
 	}
 
+	rem_node(&node->n);
+	mm_free(&queue->mm_ctx, node);
+
 	return task;
 }
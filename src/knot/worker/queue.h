@@ -16,17 +16,31 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "contrib/ucw/lists.h"
 
 struct task;
 typedef void (*task_cb)(struct task *);
 
+/*!
+ * \brief Task priority class.
+ */
+typedef enum {
+	TASK_PRIO_NORMAL = 0, /*!< Default class. */
+	TASK_PRIO_HIGH,       /*!< Latency-sensitive tasks. */
+	TASK_PRIO_LOW,        /*!< Background maintenance. */
+	TASK_PRIO_COUNT
+} task_prio_t;
+
 /*!
  * \brief Task executable by a worker.
  */
 typedef struct task {
 	void *ctx;
 	task_cb run;
+	task_prio_t prio;
 } task_t;
 
 /*!
@@ -49,8 +63,10 @@ void worker_queue_deinit(worker_queue_t *queue);
 
 /*!
  * \brief Insert new item into the queue.
+ *
+ * \return False if failed to allocate the item.
  */
-void worker_queue_enqueue(worker_queue_t *queue, task_t *task);
+bool worker_queue_enqueue(worker_queue_t *queue, task_t *task);
 
 /*!
  * \brief Remove item from the queue.
@@ -58,3 +74,13 @@ void worker_queue_enqueue(worker_queue_t *queue, task_t *task);
  * \return Task or NULL if the queue is empty.
  */
 task_t *worker_queue_dequeue(worker_queue_t *queue);
+
+/*!
+ * \brief Remove the oldest item from the queue.
+ *
+ * \param queue      Queue.
+ * \param wait_usec  Time the item spent in the queue (optional).
+ *
+ * \return Task or NULL if the queue is empty.
+ */
+task_t *worker_queue_take(worker_queue_t *queue, uint64_t *wait_usec);
@@ -15,13 +15,17 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
+#include <urcu.h>
 
 #include "dnssec/error.h"
 #include "knot/zone/contents.h"
 #include "knot/common/log.h"
+#include "knot/dnssec/nsec3-cache.h"
 #include "knot/dnssec/zone-nsec.h"
 #include "libknot/libknot.h"
 #include "contrib/qp-trie/trie.h"
+#include "contrib/wire.h"
 #include "contrib/macros.h"
 
 typedef struct {
@@ -33,8 +37,21 @@ typedef struct {
 	zone_node_t *first_node;
 	zone_contents_t *zone;
 	zone_node_t *previous_node;
+	trie_t *adds_index;
+	trie_t *nsec3_index;
+	trie_t *rrsig_index;
 } zone_adjust_arg_t;
 
+/*! \brief Nodes referring to a name, values of the contents indices. */
+typedef struct {
+	uint32_t count;
+	uint32_t size;
+	zone_node_t *nodes[];
+} node_refs_t;
+
+/*! \brief Maximal ratio of changed to all nodes for incremental adjusting. */
+#define ADJUST_INCREMENTAL_RATIO 8
+
 static int tree_apply_cb(zone_node_t **node, void *data)
 {
 	if (node == NULL || data == NULL) {
@@ -95,7 +112,8 @@ static int destroy_node_rrsets_from_tree(zone_node_t **node, void *data)
 
 static int create_nsec3_name(const zone_contents_t *zone,
                              const knot_dname_t *name,
-                             knot_dname_t **nsec3_name)
+                             knot_dname_t **nsec3_name,
+                             bool cached)
 {
 	assert(zone);
 	assert(nsec3_name);
@@ -104,8 +122,13 @@ static int create_nsec3_name(const zone_contents_t *zone,
 		return KNOT_ENSEC3PAR;
 	}
 
-	*nsec3_name = knot_create_nsec3_owner(name, zone->apex->owner,
-	                                      &zone->nsec3_params);
+	if (cached) {
+		*nsec3_name = knot_nsec3_cache_owner(name, zone->apex->owner,
+		                                     &zone->nsec3_params);
+	} else {
+		*nsec3_name = knot_create_nsec3_owner(name, zone->apex->owner,
+		                                      &zone->nsec3_params);
+	}
 	if (*nsec3_name == NULL) {
 		return KNOT_ERROR;
 	}
@@ -113,16 +136,36 @@ static int create_nsec3_name(const zone_contents_t *zone,
 	return KNOT_EOK;
 }
 
+/*! \brief Checks if the additional data consist of the given glues. */
+static bool additional_equal(const additional_t *additional, const glue_t *glues,
+                             uint16_t count)
+{
+	if (additional == NULL) {
+		return count == 0;
+	}
+
+	if (additional->count != count) {
+		return false;
+	}
+
+	for (uint16_t i = 0; i < count; i++) {
+		const glue_t *glue = &additional->glues[i];
+		if (glue->node != glues[i].node || glue->ns_pos != glues[i].ns_pos ||
+		    glue->optional != glues[i].optional) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 /*! \brief Link pointers to additional nodes for this RRSet. */
-static int discover_additionals(const knot_dname_t *owner, struct rr_data *rr_data,
+static int discover_additionals(zone_node_t *owner, uint16_t rr_pos,
                                 zone_contents_t *zone)
 {
-	assert(rr_data != NULL);
-
-	/* Drop possible previous additional nodes. */
-	additional_clear(rr_data->additional);
-	rr_data->additional = NULL;
+	assert(owner != NULL && rr_pos < owner->rrset_count);
 
+	struct rr_data *rr_data = &owner->rrs[rr_pos];
 	const knot_rdataset_t *rrs = &rr_data->rrs;
 	uint16_t rdcount = rrs->rr_count;
 
@@ -152,19 +195,39 @@ static int discover_additionals(const knot_dname_t *owner, struct rr_data *rr_da
 		glue_t *glue;
 		if ((node->flags & (NODE_FLAGS_DELEG | NODE_FLAGS_NONAUTH)) &&
 		    rr_data->type == KNOT_RRTYPE_NS &&
-		    knot_dname_in(owner, node->owner)) {
+		    knot_dname_in(owner->owner, node->owner)) {
 			glue = &mandatory[mandatory_count++];
 			glue->optional = false;
 		} else {
 			glue = &others[others_count++];
 			glue->optional = true;
 		}
-		glue->node = node;
+		/* Binode glues are resolved to the version being read. */
+		glue->node = binode_node(node, false);
 		glue->ns_pos = i;
 	}
 
-	/* Store sorted additionals by the type, mandatory first. */
-	size_t total_count = mandatory_count + others_count;
+	/* Sort additionals by the type, mandatory first. */
+	uint16_t total_count = mandatory_count + others_count;
+	glue_t glues[total_count + 1];
+	memcpy(glues, mandatory, mandatory_count * sizeof(glue_t));
+	memcpy(glues + mandatory_count, others, others_count * sizeof(glue_t));
+
+	/* Keep unchanged additionals, they may be shared with the other version. */
+	if (additional_equal(rr_data->additional, glues, total_count)) {
+		return KNOT_EOK;
+	}
+
+	int ret = binode_prepare_change(owner, NULL);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	rr_data = &owner->rrs[rr_pos];
+
+	/* Drop possible previous additional nodes. */
+	additional_clear(rr_data->additional);
+	rr_data->additional = NULL;
+
 	if (total_count > 0) {
 		rr_data->additional = malloc(sizeof(additional_t));
 		if (rr_data->additional == NULL) {
@@ -176,31 +239,211 @@ static int discover_additionals(const knot_dname_t *owner, struct rr_data *rr_da
 		rr_data->additional->glues = malloc(size);
 		if (rr_data->additional->glues == NULL) {
 			free(rr_data->additional);
+			rr_data->additional = NULL;
 			return KNOT_ENOMEM;
 		}
 
-		size_t mandatory_size = mandatory_count * sizeof(glue_t);
-		memcpy(rr_data->additional->glues, mandatory, mandatory_size);
-		memcpy(rr_data->additional->glues + mandatory_count, others,
-		       size - mandatory_size);
+		memcpy(rr_data->additional->glues, glues, size);
 	}
 
 	return KNOT_EOK;
 }
 
-static int adjust_pointers(zone_node_t **tnode, void *data)
+static node_refs_t *refs_get(trie_t *index, const knot_dname_t *name)
 {
-	assert(tnode != NULL);
-	assert(data != NULL);
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, name, NULL);
 
-	zone_adjust_arg_t *args = (zone_adjust_arg_t *)data;
-	zone_node_t *node = *tnode;
+	trie_val_t *val = trie_get_try(index, (char*)lf+1, *lf);
+	return (val != NULL) ? *val : NULL;
+}
 
-	// remember first node
-	if (args->first_node == NULL) {
-		args->first_node = node;
+static int refs_add(trie_t *index, const knot_dname_t *name,
+                    const zone_node_t *node)
+{
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, name, NULL);
+
+	trie_val_t *val = trie_get_ins(index, (char*)lf+1, *lf);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	node_refs_t *refs = *val;
+	if (refs == NULL || refs->count == refs->size) {
+		uint32_t size = (refs == NULL) ? 1 : 2 * refs->size;
+		node_refs_t *new_refs = realloc(refs, sizeof(*refs) +
+		                                      size * sizeof(zone_node_t *));
+		if (new_refs == NULL) {
+			if (refs == NULL) {
+				(void)trie_del(index, (char*)lf+1, *lf, NULL);
+			}
+			return KNOT_ENOMEM;
+		}
+		if (refs == NULL) {
+			new_refs->count = 0;
+		}
+		new_refs->size = size;
+		*val = refs = new_refs;
+	}
+
+	refs->nodes[refs->count++] = binode_node(node, false);
+
+	return KNOT_EOK;
+}
+
+static void refs_remove(trie_t *index, const knot_dname_t *name,
+                        const zone_node_t *node)
+{
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, name, NULL);
+
+	trie_val_t *val = trie_get_try(index, (char*)lf+1, *lf);
+	if (val == NULL) {
+		return;
+	}
+
+	node_refs_t *refs = *val;
+	zone_node_t *binode = binode_node(node, false);
+	for (uint32_t i = 0; i < refs->count; ++i) {
+		if (refs->nodes[i] == binode) {
+			refs->nodes[i] = refs->nodes[--refs->count];
+			break;
+		}
+	}
+
+	if (refs->count == 0) {
+		free(refs);
+		(void)trie_del(index, (char*)lf+1, *lf, NULL);
+	}
+}
+
+static int free_refs(trie_val_t *val, void *data)
+{
+	UNUSED(data);
+	free(*val);
+	return KNOT_EOK;
+}
+
+static void index_free(trie_t **index)
+{
+	if (*index != NULL) {
+		(void)trie_apply(*index, free_refs, NULL);
+		trie_free(*index);
+		*index = NULL;
+	}
+}
+
+/*!
+ * \brief Adds or removes the node as a referrer of in-zone names in the RDATA
+ *        of its RRs with additional records.
+ */
+static int adds_index_update(trie_t *index, const zone_node_t *node,
+                             const knot_dname_t *apex, bool add)
+{
+	for (uint16_t i = 0; i < node->rrset_count; ++i) {
+		const struct rr_data *rr_data = &node->rrs[i];
+		if (!knot_rrtype_additional_needed(rr_data->type)) {
+			continue;
+		}
+
+		for (uint16_t j = 0; j < rr_data->rrs.rr_count; ++j) {
+			const knot_dname_t *name = knot_rdata_name(&rr_data->rrs, j,
+			                                           rr_data->type);
+			if (!knot_dname_in(apex, name)) {
+				continue;
+			}
+			if (!add) {
+				refs_remove(index, name, node);
+				continue;
+			}
+			int ret = refs_add(index, name, node);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Maximal length of an RRSIG index key. */
+#define RRSIG_KEY_MAXLEN (sizeof(uint32_t) + 1 + KNOT_DNAME_MAXLEN)
+
+/*!
+ * \brief Creates an RRSIG index key of the node, ordered by the earliest
+ *        expiration of its RRSIGs.
+ *
+ * \return Key length or 0 if the node has no RRSIGs.
+ */
+static uint32_t rrsig_index_key(uint8_t *key, const zone_node_t *node, bool nsec3)
+{
+	const knot_rdataset_t *rrsigs = node_rdataset(node, KNOT_RRTYPE_RRSIG);
+	if (rrsigs == NULL || rrsigs->rr_count == 0) {
+		return 0;
+	}
+
+	uint32_t expire = knot_rrsig_sig_expiration(rrsigs, 0);
+	for (uint16_t i = 1; i < rrsigs->rr_count; ++i) {
+		expire = MIN(expire, knot_rrsig_sig_expiration(rrsigs, i));
+	}
+
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, node->owner, NULL);
+
+	wire_write_u32(key, expire);
+	key[sizeof(uint32_t)] = nsec3;
+	memcpy(key + sizeof(uint32_t) + 1, lf + 1, *lf);
+
+	return sizeof(uint32_t) + 1 + *lf;
+}
+
+/*! \brief Adds or removes the node to/from the RRSIG expiration index. */
+static int rrsig_index_update(trie_t *index, const zone_node_t *node,
+                              bool nsec3, bool add)
+{
+	uint8_t key[RRSIG_KEY_MAXLEN];
+	uint32_t len = rrsig_index_key(key, node, nsec3);
+	if (len == 0) {
+		return KNOT_EOK;
+	}
+
+	if (!add) {
+		(void)trie_del(index, (char *)key, len, NULL);
+		return KNOT_EOK;
+	}
+
+	trie_val_t *val = trie_get_ins(index, (char *)key, len);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
 	}
+	*val = binode_node(node, false);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Checks if the indices are shared with the copy-on-write base. */
+static bool indices_borrowed(const zone_contents_t *contents)
+{
+	return contents->cow_base != NULL &&
+	       contents->adds_index == contents->cow_base->adds_index;
+}
+
+static void indices_free(zone_contents_t *contents)
+{
+	if (!indices_borrowed(contents)) {
+		index_free(&contents->adds_index);
+		index_free(&contents->nsec3_index);
+		trie_free(contents->rrsig_index);
+	}
+	contents->adds_index = NULL;
+	contents->nsec3_index = NULL;
+	contents->rrsig_index = NULL;
+}
 
+/*! \brief Sets node flags (delegation point, non-authoritative). */
+static void adjust_flags(zone_node_t *node, const zone_node_t *apex)
+{
 	// clear Removed NSEC flag so that no relicts remain
 	node->flags &= ~NODE_FLAGS_REMOVED_NSEC;
 
@@ -215,13 +458,30 @@ static int adjust_pointers(zone_node_t **tnode, void *data)
 	    (node->parent->flags & NODE_FLAGS_DELEG ||
 	     node->parent->flags & NODE_FLAGS_NONAUTH)) {
 		node->flags |= NODE_FLAGS_NONAUTH;
-	} else if (node_rrtype_exists(node, KNOT_RRTYPE_NS) && node != args->zone->apex) {
+	} else if (node_rrtype_exists(node, KNOT_RRTYPE_NS) && node != apex) {
 		node->flags |= NODE_FLAGS_DELEG;
 	} else {
-		// Default.
-		node->flags = NODE_FLAGS_AUTH;
+		// Default, keep binode flags.
+		node->flags = NODE_FLAGS_AUTH |
+		              (node->flags & (NODE_FLAGS_BINODE | NODE_FLAGS_SECOND));
+	}
+}
+
+static int adjust_pointers(zone_node_t **tnode, void *data)
+{
+	assert(tnode != NULL);
+	assert(data != NULL);
+
+	zone_adjust_arg_t *args = (zone_adjust_arg_t *)data;
+	zone_node_t *node = *tnode;
+
+	// remember first node
+	if (args->first_node == NULL) {
+		args->first_node = node;
 	}
 
+	adjust_flags(node, args->zone->apex);
+
 	// set pointer to previous node
 	node->prev = args->previous_node;
 
@@ -244,11 +504,14 @@ static int adjust_nsec3_pointers(zone_node_t **tnode, void *data)
 	// Connect to NSEC3 node (only if NSEC3 tree is not empty)
 	zone_node_t *nsec3 = NULL;
 	knot_dname_t *nsec3_name = NULL;
-	int ret = create_nsec3_name(args->zone, node->owner, &nsec3_name);
+	int ret = create_nsec3_name(args->zone, node->owner, &nsec3_name, false);
 	if (ret == KNOT_EOK) {
 		assert(nsec3_name);
 		zone_tree_get(args->zone->nsec3_nodes, nsec3_name, &nsec3);
 		node->nsec3_node = nsec3;
+		if (nsec3 != NULL && args->nsec3_index != NULL) {
+			ret = refs_add(args->nsec3_index, nsec3->owner, node);
+		}
 	} else if (ret == KNOT_ENSEC3PAR) {
 		node->nsec3_node = NULL;
 		ret = KNOT_EOK;
@@ -293,7 +556,15 @@ static int adjust_normal_node(zone_node_t **tnode, void *data)
 		return ret;
 	}
 
-	measure_size(*tnode, &((zone_adjust_arg_t *)data)->zone->size);
+	zone_adjust_arg_t *args = (zone_adjust_arg_t *)data;
+	measure_size(*tnode, &args->zone->size);
+
+	if (args->rrsig_index != NULL) {
+		ret = rrsig_index_update(args->rrsig_index, *tnode, false, true);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
 
 	// Connect nodes to their NSEC3 nodes
 	return adjust_nsec3_pointers(tnode, data);
@@ -328,6 +599,10 @@ static int adjust_nsec3_node(zone_node_t **tnode, void *data)
 
 	measure_size(*tnode, &args->zone->size);
 
+	if (args->rrsig_index != NULL) {
+		return rrsig_index_update(args->rrsig_index, node, true, true);
+	}
+
 	return KNOT_EOK;
 }
 
@@ -342,15 +617,19 @@ static int adjust_additional(zone_node_t **tnode, void *data)
 
 	/* Lookup additional records for specific nodes. */
 	for(uint16_t i = 0; i < node->rrset_count; ++i) {
-		struct rr_data *rr_data = &node->rrs[i];
-		if (knot_rrtype_additional_needed(rr_data->type)) {
-			int ret = discover_additionals(node->owner, rr_data, args->zone);
+		if (knot_rrtype_additional_needed(node->rrs[i].type)) {
+			int ret = discover_additionals(node, i, args->zone);
 			if (ret != KNOT_EOK) {
 				return ret;
 			}
 		}
 	}
 
+	if (args->adds_index != NULL) {
+		return adds_index_update(args->adds_index, node,
+		                         args->zone->apex->owner, true);
+	}
+
 	return KNOT_EOK;
 }
 
@@ -406,7 +685,7 @@ static bool nsec3_params_match(const knot_rdataset_t *rrs,
 		          params->salt.size) == 0);
 }
 
-zone_contents_t *zone_contents_new(const knot_dname_t *apex_name)
+zone_contents_t *zone_contents_new(const knot_dname_t *apex_name, bool use_binodes)
 {
 	if (apex_name == NULL) {
 		return NULL;
@@ -418,13 +697,13 @@ zone_contents_t *zone_contents_new(const knot_dname_t *apex_name)
 	}
 
 	memset(contents, 0, sizeof(zone_contents_t));
-	contents->apex = node_new(apex_name, NULL);
-	if (contents->apex == NULL) {
+	contents->nodes = zone_tree_create(use_binodes ? ZONE_TREE_BINODES : 0);
+	if (contents->nodes == NULL) {
 		goto cleanup;
 	}
 
-	contents->nodes = zone_tree_create();
-	if (contents->nodes == NULL) {
+	contents->apex = zone_tree_node_new(contents->nodes, apex_name);
+	if (contents->apex == NULL) {
 		goto cleanup;
 	}
 
@@ -435,8 +714,8 @@ zone_contents_t *zone_contents_new(const knot_dname_t *apex_name)
 	return contents;
 
 cleanup:
-	free(contents->nodes);
-	free(contents->nsec3_nodes);
+	node_free(&contents->apex, NULL);
+	zone_tree_free(&contents->nodes);
 	free(contents);
 	return NULL;
 }
@@ -495,7 +774,7 @@ static int add_node(zone_contents_t *zone, zone_node_t *node, bool create_parent
 		while (parent != NULL && !(next_node = get_node(zone, parent))) {
 
 			/* Create a new node. */
-			next_node = node_new(parent, NULL);
+			next_node = zone_tree_node_new(zone->nodes, parent);
 			if (next_node == NULL) {
 				return KNOT_ENOMEM;
 			}
@@ -539,7 +818,7 @@ static int add_nsec3_node(zone_contents_t *zone, zone_node_t *node)
 
 	/* Create NSEC3 tree if not exists. */
 	if (zone->nsec3_nodes == NULL) {
-		zone->nsec3_nodes = zone_tree_create();
+		zone->nsec3_nodes = zone_tree_create(zone->nodes->flags);
 		if (zone->nsec3_nodes == NULL) {
 			return KNOT_ENOMEM;
 		}
@@ -594,7 +873,7 @@ static int insert_rr(zone_contents_t *z, const knot_rrset_t *rr,
 		*n = nsec3 ? get_nsec3_node(z, rr->owner) : get_node(z, rr->owner);
 		if (*n == NULL) {
 			// Create new, insert
-			*n = node_new(rr->owner, NULL);
+			*n = zone_tree_node_new(z->nodes, rr->owner);
 			if (*n == NULL) {
 				return KNOT_ENOMEM;
 			}
@@ -631,9 +910,14 @@ static int remove_rr(zone_contents_t *z, const knot_rrset_t *rr,
 		node = *n;
 	}
 
+	int ret = binode_prepare_change(node, NULL);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	knot_rdataset_t *node_rrs = node_rdataset(node, rr->type);
 	// Subtract changeset RRS from node RRS.
-	int ret = knot_rdataset_subtract(node_rrs, &rr->rrs, false, NULL);
+	ret = knot_rdataset_subtract(node_rrs, &rr->rrs, false, NULL);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -653,7 +937,7 @@ static int remove_rr(zone_contents_t *z, const knot_rrset_t *rr,
 
 static int recreate_normal_tree(const zone_contents_t *z, zone_contents_t *out)
 {
-	out->nodes = trie_create(NULL);
+	out->nodes = zone_tree_create(z->nodes->flags & ZONE_TREE_BINODES);
 	if (out->nodes == NULL) {
 		return KNOT_ENOMEM;
 	}
@@ -673,68 +957,70 @@ static int recreate_normal_tree(const zone_contents_t *z, zone_contents_t *out)
 
 	out->apex = apex_cpy;
 
-	trie_it_t *itt = trie_it_begin(z->nodes);
-	if (itt == NULL) {
-		return KNOT_ENOMEM;
+	zone_tree_it_t itt;
+	ret = zone_tree_it_begin(z->nodes, &itt);
+	if (ret != KNOT_EOK) {
+		return ret;
 	}
 
-	while (!trie_it_finished(itt)) {
-		const zone_node_t *to_cpy = (zone_node_t *)*trie_it_val(itt);
+	while (!zone_tree_it_finished(&itt)) {
+		const zone_node_t *to_cpy = zone_tree_it_val(&itt);
 		if (to_cpy == z->apex) {
 			// Inserted already.
-			trie_it_next(itt);
+			zone_tree_it_next(&itt);
 			continue;
 		}
 		zone_node_t *to_add = node_shallow_copy(to_cpy, NULL);
 		if (to_add == NULL) {
-			trie_it_free(itt);
+			zone_tree_it_free(&itt);
 			return KNOT_ENOMEM;
 		}
 
 		int ret = add_node(out, to_add, true);
 		if (ret != KNOT_EOK) {
 			node_free(&to_add, NULL);
-			trie_it_free(itt);
+			zone_tree_it_free(&itt);
 			return ret;
 		}
-		trie_it_next(itt);
+		zone_tree_it_next(&itt);
 	}
 
-	trie_it_free(itt);
+	zone_tree_it_free(&itt);
 
 	return KNOT_EOK;
 }
 
 static int recreate_nsec3_tree(const zone_contents_t *z, zone_contents_t *out)
 {
-	out->nsec3_nodes = trie_create(NULL);
+	out->nsec3_nodes = zone_tree_create(z->nsec3_nodes->flags & ZONE_TREE_BINODES);
 	if (out->nsec3_nodes == NULL) {
 		return KNOT_ENOMEM;
 	}
 
-	trie_it_t *itt = trie_it_begin(z->nsec3_nodes);
-	if (itt == NULL) {
-		return KNOT_ENOMEM;
+	zone_tree_it_t itt;
+	int ret = zone_tree_it_begin(z->nsec3_nodes, &itt);
+	if (ret != KNOT_EOK) {
+		return ret;
 	}
-	while (!trie_it_finished(itt)) {
-		const zone_node_t *to_cpy = (zone_node_t *)*trie_it_val(itt);
+	while (!zone_tree_it_finished(&itt)) {
+		const zone_node_t *to_cpy = zone_tree_it_val(&itt);
 		zone_node_t *to_add = node_shallow_copy(to_cpy, NULL);
 		if (to_add == NULL) {
-			trie_it_free(itt);
+			zone_tree_it_free(&itt);
 			return KNOT_ENOMEM;
 		}
 
 		int ret = add_nsec3_node(out, to_add);
 		if (ret != KNOT_EOK) {
-			trie_it_free(itt);
+			zone_tree_it_free(&itt);
 			node_free(&to_add, NULL);
 			return ret;
 		}
 
-		trie_it_next(itt);
+		zone_tree_it_next(&itt);
 	}
 
-	trie_it_free(itt);
+	zone_tree_it_free(&itt);
 
 	return KNOT_EOK;
 }
@@ -771,7 +1057,7 @@ zone_node_t *zone_contents_get_node_for_rr(zone_contents_t *zone, const knot_rrs
 	zone_node_t *node = nsec3 ? get_nsec3_node(zone, rrset->owner) :
 	                            get_node(zone, rrset->owner);
 	if (node == NULL) {
-		node = node_new(rrset->owner, NULL);
+		node = zone_tree_node_new(zone->nodes, rrset->owner);
 		int ret = nsec3 ? add_nsec3_node(zone, node) : add_node(zone, node, true);
 		if (ret != KNOT_EOK) {
 			node_free(&node, NULL);
@@ -873,7 +1159,7 @@ int zone_contents_find_nsec3_for_name(const zone_contents_t *zone,
 	}
 
 	knot_dname_t *nsec3_name = NULL;
-	int ret = create_nsec3_name(zone, name, &nsec3_name);
+	int ret = create_nsec3_name(zone, name, &nsec3_name, true);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -993,17 +1279,26 @@ static int load_nsec3param(zone_contents_t *contents)
 	return KNOT_EOK;
 }
 
+static int adjust_nsec3param(zone_contents_t *contents)
+{
+	int ret = load_nsec3param(contents);
+	if (ret != KNOT_EOK) {
+		log_zone_error(contents->apex->owner,
+		               "failed to load NSEC3 parameters (%s)",
+		               knot_strerror(ret));
+	}
+
+	return ret;
+}
+
 static int contents_adjust(zone_contents_t *contents, bool normal)
 {
 	if (contents == NULL || contents->apex == NULL) {
 		return KNOT_EINVAL;
 	}
 
-	int ret = load_nsec3param(contents);
+	int ret = adjust_nsec3param(contents);
 	if (ret != KNOT_EOK) {
-		log_zone_error(contents->apex->owner,
-		               "failed to load NSEC3 parameters (%s)",
-		               knot_strerror(ret));
 		return ret;
 	}
 
@@ -1011,20 +1306,51 @@ static int contents_adjust(zone_contents_t *contents, bool normal)
 		.zone = contents
 	};
 
+	/* The indices are needed only for incremental adjusting of copies. */
+	if (normal && contents->nodes->flags & ZONE_TREE_BINODES) {
+		arg.adds_index = trie_create(NULL);
+		arg.nsec3_index = trie_create(NULL);
+		arg.rrsig_index = trie_create(NULL);
+		if (arg.adds_index == NULL || arg.nsec3_index == NULL ||
+		    arg.rrsig_index == NULL) {
+			ret = KNOT_ENOMEM;
+			goto cleanup;
+		}
+	}
+
 	contents->size = 0;
 
 	ret = adjust_nodes(contents->nodes, &arg,
 	                   normal ? adjust_normal_node : adjust_pointers);
 	if (ret != KNOT_EOK) {
-		return ret;
+		goto cleanup;
 	}
 
 	ret = adjust_nodes(contents->nsec3_nodes, &arg, adjust_nsec3_node);
 	if (ret != KNOT_EOK) {
-		return ret;
+		goto cleanup;
+	}
+
+	ret = adjust_nodes(contents->nodes, &arg, adjust_additional);
+	if (ret != KNOT_EOK) {
+		goto cleanup;
 	}
 
-	return adjust_nodes(contents->nodes, &arg, adjust_additional);
+	indices_free(contents);
+	contents->adds_index = arg.adds_index;
+	contents->nsec3_index = arg.nsec3_index;
+	contents->rrsig_index = arg.rrsig_index;
+
+	/* All binodes may have changed. */
+	zone_tree_owners_free(&contents->cow_adjusted);
+	zone_tree_owners_free(&contents->cow_adjusted_nsec3);
+
+	return KNOT_EOK;
+cleanup:
+	index_free(&arg.adds_index);
+	index_free(&arg.nsec3_index);
+	trie_free(arg.rrsig_index);
+	return ret;
 }
 
 int zone_contents_adjust_pointers(zone_contents_t *contents)
@@ -1037,68 +1363,594 @@ int zone_contents_adjust_full(zone_contents_t *contents)
 	return contents_adjust(contents, true);
 }
 
-int zone_contents_apply(zone_contents_t *contents,
-                        zone_contents_apply_cb_t function, void *data)
+/*! \brief Incremental adjusting context. */
+typedef struct {
+	zone_adjust_arg_t arg;
+	zone_contents_t *base;   /*!< Version the changes are relative to. */
+	trie_t *region;          /*!< Changed owners, their parents and subtrees. */
+	trie_t *subtrees;        /*!< Subtrees of changed zone cuts. */
+	trie_t *linked;          /*!< NSEC3 owners linked from the region. */
+	trie_t *adjusted;        /*!< Owners of the adjusted nodes. */
+	trie_t *adjusted_nsec3;  /*!< Owners of the adjusted NSEC3 nodes. */
+	size_t size;             /*!< Size of the adjusted contents. */
+	bool full;               /*!< Changes require full adjusting. */
+} adjust_incr_t;
+
+typedef int (*adjust_incr_cb_t)(adjust_incr_t *ctx, const knot_dname_t *owner);
+
+static int owners_apply(trie_t *owners, adjust_incr_cb_t cb, adjust_incr_t *ctx)
 {
-	if (contents == NULL) {
-		return KNOT_EINVAL;
+	if (owners == NULL) {
+		return KNOT_EOK;
 	}
 
-	zone_tree_func_t f = {
-		.func = function,
-		.data = data
-	};
+	trie_it_t *it = trie_it_begin(owners);
+	if (it == NULL) {
+		return KNOT_ENOMEM;
+	}
 
-	return zone_tree_apply(contents->nodes, tree_apply_cb, &f);
+	int ret = KNOT_EOK;
+	for (; !trie_it_finished(it) && ret == KNOT_EOK && !ctx->full;
+	     trie_it_next(it)) {
+		ret = cb(ctx, *trie_it_val(it));
+	}
+	trie_it_free(it);
+
+	return ret;
 }
 
-int zone_contents_nsec3_apply(zone_contents_t *contents,
-                              zone_contents_apply_cb_t function, void *data)
+static bool owners_contain(trie_t *owners, const knot_dname_t *owner)
 {
-	if (contents == NULL) {
-		return KNOT_EINVAL;
+	if (owners == NULL) {
+		return false;
 	}
 
-	zone_tree_func_t f = {
-		.func = function,
-		.data = data
-	};
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, owner, NULL);
 
-	return zone_tree_apply(contents->nsec3_nodes, tree_apply_cb, &f);
+	return trie_get_try(owners, (char*)lf+1, *lf) != NULL;
 }
 
-int zone_contents_shallow_copy(const zone_contents_t *from, zone_contents_t **to)
+static zone_node_t *tree_lookup(zone_tree_t *tree, const knot_dname_t *owner)
 {
-	if (from == NULL || to == NULL) {
-		return KNOT_EINVAL;
-	}
+	zone_node_t *node = NULL;
+	(void)zone_tree_get(tree, owner, &node);
+	return node;
+}
 
-	/* Copy to same destination as source. */
-	if (from == *to) {
-		return KNOT_EINVAL;
-	}
+/*! \brief Checks if the owner's node is not the same binode in both versions. */
+static bool binode_replaced(const zone_node_t *node, const zone_node_t *old)
+{
+	return binode_node(node, false) != binode_node(old, false);
+}
 
-	zone_contents_t *contents = calloc(1, sizeof(zone_contents_t));
-	if (contents == NULL) {
-		return KNOT_ENOMEM;
-	}
+static bool nsec3_params_equal(const dnssec_nsec3_params_t *a,
+                               const dnssec_nsec3_params_t *b)
+{
+	return a->algorithm == b->algorithm &&
+	       a->flags == b->flags &&
+	       a->iterations == b->iterations &&
+	       dnssec_binary_cmp(&a->salt, &b->salt) == 0;
+}
 
-	int ret = recreate_normal_tree(from, contents);
-	if (ret != KNOT_EOK) {
-		zone_tree_free(&contents->nodes);
-		free(contents);
-		return ret;
-	}
+static int incr_add_parents(adjust_incr_t *ctx, const knot_dname_t *owner)
+{
+	const knot_dname_t *apex = ctx->arg.zone->apex->owner;
 
-	if (from->nsec3_nodes) {
-		ret = recreate_nsec3_tree(from, contents);
+	while (true) {
+		int ret = zone_tree_owners_add(&ctx->region, owner);
 		if (ret != KNOT_EOK) {
-			zone_tree_free(&contents->nodes);
-			zone_tree_free(&contents->nsec3_nodes);
-			free(contents);
 			return ret;
 		}
-	} else {
+		if (*owner == '\0' || knot_dname_is_equal(owner, apex)) {
+			return KNOT_EOK;
+		}
+		owner = knot_wire_next_label(owner, NULL);
+	}
+}
+
+/*! \brief Sets node flags, the wildcard child flag isn't left to the child. */
+static void incr_adjust_flags(zone_node_t *node, zone_contents_t *zone)
+{
+	adjust_flags(node, zone->apex);
+	if (zone_contents_find_wildcard_child(zone, node) != NULL) {
+		node->flags |= NODE_FLAGS_WILDCARD_CHILD;
+	}
+}
+
+/*! \brief Adjusts flags of the nodes below a changed zone cut. */
+static int incr_adjust_subtree(adjust_incr_t *ctx, const zone_node_t *node)
+{
+	zone_contents_t *zone = ctx->arg.zone;
+
+	zone_tree_it_t it = { 0 };
+	int ret = zone_tree_it_begin_leq(zone->nodes, node->owner, &it);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	for (zone_tree_it_next(&it); !zone_tree_it_finished(&it) && ret == KNOT_EOK;
+	     zone_tree_it_next(&it)) {
+		zone_node_t *child = zone_tree_it_val(&it);
+		if (!knot_dname_in(node->owner, child->owner)) {
+			break;
+		}
+		incr_adjust_flags(child, zone);
+		ret = zone_tree_owners_add(&ctx->subtrees, child->owner);
+	}
+	zone_tree_it_free(&it);
+
+	return ret;
+}
+
+static int incr_adjust_node(adjust_incr_t *ctx, const knot_dname_t *owner)
+{
+	zone_contents_t *zone = ctx->arg.zone;
+	zone_node_t *node = tree_lookup(zone->nodes, owner);
+	zone_node_t *old = tree_lookup(ctx->base->nodes, owner);
+
+	/* Nodes matching a wildcard aren't indexed by the additional names. */
+	if (knot_dname_is_wildcard(owner) && binode_replaced(node, old)) {
+		ctx->full = true;
+		return KNOT_EOK;
+	}
+
+	/* Removed nodes are dropped from the indices at commit. */
+	if (node == NULL) {
+		return (old != NULL) ? zone_tree_owners_add(&ctx->adjusted, owner) : KNOT_EOK;
+	}
+
+	uint8_t flags = node->flags;
+	incr_adjust_flags(node, zone);
+
+	/* Compare with both the base and a possible previous adjusting. */
+	const uint8_t cut_flags = NODE_FLAGS_DELEG | NODE_FLAGS_NONAUTH;
+	uint8_t old_flags = (old != NULL) ? old->flags : flags;
+	if (((flags ^ node->flags) | (old_flags ^ node->flags)) & cut_flags) {
+		int ret = incr_adjust_subtree(ctx, node);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	int ret = adjust_nsec3_pointers(&node, &ctx->arg);
+	if (ret == KNOT_EOK && node->nsec3_node != NULL) {
+		ret = zone_tree_owners_add(&ctx->linked, node->nsec3_node->owner);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_tree_owners_add(&ctx->adjusted, owner);
+	}
+
+	return ret;
+}
+
+static int incr_add_subtree(adjust_incr_t *ctx, const knot_dname_t *owner)
+{
+	int ret = zone_tree_owners_add(&ctx->region, owner);
+	if (ret == KNOT_EOK) {
+		ret = zone_tree_owners_add(&ctx->adjusted, owner);
+	}
+
+	return ret;
+}
+
+static bool prev_target(const zone_node_t *node, bool nsec3)
+{
+	return nsec3 || (!(node->flags & NODE_FLAGS_NONAUTH) && node->rrset_count > 0);
+}
+
+/*!
+ * \brief Fixes previous pointers of the nodes following a changed position,
+ *        up to the first node which can be a previous one itself.
+ *
+ * As in adjust_nodes(), the first node points to the last possible previous
+ * node, the following nodes point to the nearest possible previous node.
+ */
+static int incr_adjust_prev(zone_tree_t *tree, const knot_dname_t *owner,
+                            bool nsec3, trie_t **adjusted)
+{
+	if (zone_tree_is_empty(tree)) {
+		return KNOT_EOK;
+	}
+
+	zone_node_t *found = tree_lookup(tree, owner);
+
+	/* Find the first node not preceding the owner. */
+	zone_tree_it_t it = { 0 };
+	int ret = zone_tree_it_begin_leq(tree, owner, &it);
+	if (ret == KNOT_EOK && !zone_tree_it_finished(&it) && found == NULL) {
+		zone_tree_it_next(&it);
+	}
+	if (ret == KNOT_EOK && zone_tree_it_finished(&it)) {
+		zone_tree_it_free(&it);
+		ret = zone_tree_it_begin(tree, &it);
+	}
+	if (ret != KNOT_EOK) {
+		zone_tree_it_free(&it);
+		return ret;
+	}
+	zone_node_t *node = zone_tree_it_val(&it);
+
+	/* Find its previous node. */
+	zone_node_t *prev = NULL;
+	zone_tree_it_t back = { 0 };
+	ret = zone_tree_it_begin_leq(tree, node->owner, &back);
+	if (ret == KNOT_EOK) {
+		zone_tree_it_prev(&back);
+		if (zone_tree_it_finished(&back)) {
+			zone_tree_it_free(&back);
+			ret = zone_tree_it_begin_leq(tree, NULL, &back);
+		}
+	}
+	for (; ret == KNOT_EOK && !zone_tree_it_finished(&back);
+	     zone_tree_it_prev(&back)) {
+		if (prev_target(zone_tree_it_val(&back), nsec3)) {
+			prev = zone_tree_it_val(&back);
+			break;
+		}
+	}
+	zone_tree_it_free(&back);
+
+	while (ret == KNOT_EOK) {
+		node->prev = prev;
+		ret = zone_tree_owners_add(adjusted, node->owner);
+
+		bool target = prev_target(node, nsec3);
+		if (target) {
+			prev = node;
+		}
+		if (ret != KNOT_EOK || (target && node != found)) {
+			break;
+		}
+
+		zone_tree_it_next(&it);
+		if (zone_tree_it_finished(&it)) {
+			zone_tree_it_free(&it);
+			ret = zone_tree_it_begin(tree, &it);
+			if (ret == KNOT_EOK) {
+				node = zone_tree_it_val(&it);
+				node->prev = prev;
+				ret = zone_tree_owners_add(adjusted, node->owner);
+			}
+			break;
+		}
+		node = zone_tree_it_val(&it);
+	}
+	zone_tree_it_free(&it);
+
+	return ret;
+}
+
+static int incr_adjust_prev_normal(adjust_incr_t *ctx, const knot_dname_t *owner)
+{
+	return incr_adjust_prev(ctx->arg.zone->nodes, owner, false, &ctx->adjusted);
+}
+
+static int incr_adjust_prev_nsec3(adjust_incr_t *ctx, const knot_dname_t *owner)
+{
+	return incr_adjust_prev(ctx->arg.zone->nsec3_nodes, owner, true,
+	                        &ctx->adjusted_nsec3);
+}
+
+/*! \brief Adjusts a node referring to a changed one, if still in the zone. */
+static int incr_adjust_referrer(adjust_incr_t *ctx, zone_node_t *binode,
+                                zone_tree_apply_cb_t callback)
+{
+	zone_tree_t *tree = ctx->arg.zone->nodes;
+	zone_node_t *node = binode_node(binode, tree->flags & ZONE_TREE_SECOND);
+	if (tree_lookup(tree, node->owner) != node) {
+		return KNOT_EOK;
+	}
+
+	int ret = callback(&node, &ctx->arg);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	return zone_tree_owners_add(&ctx->adjusted, node->owner);
+}
+
+static int incr_adjust_additional(adjust_incr_t *ctx, const knot_dname_t *owner)
+{
+	zone_contents_t *zone = ctx->arg.zone;
+
+	zone_node_t *node = tree_lookup(zone->nodes, owner);
+	if (node != NULL) {
+		int ret = adjust_additional(&node, &ctx->arg);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	node_refs_t *refs = refs_get(zone->adds_index, owner);
+	for (uint32_t i = 0; refs != NULL && i < refs->count; ++i) {
+		int ret = incr_adjust_referrer(ctx, refs->nodes[i], adjust_additional);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static int incr_adjust_nsec3_node(adjust_incr_t *ctx, const knot_dname_t *owner)
+{
+	zone_contents_t *zone = ctx->arg.zone;
+
+	int ret = incr_adjust_prev_nsec3(ctx, owner);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	zone_node_t *node = tree_lookup(zone->nsec3_nodes, owner);
+	zone_node_t *old = tree_lookup(ctx->base->nsec3_nodes, owner);
+	if (node == NULL && old != NULL) {
+		ret = zone_tree_owners_add(&ctx->adjusted_nsec3, owner);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+	if (!binode_replaced(node, old)) {
+		return KNOT_EOK;
+	}
+
+	/* A new NSEC3 node may be linked from an unknown node. */
+	if (old == NULL) {
+		ctx->full = !owners_contain(ctx->linked, owner);
+		return KNOT_EOK;
+	}
+
+	node_refs_t *refs = refs_get(zone->nsec3_index, owner);
+	for (uint32_t i = 0; refs != NULL && i < refs->count; ++i) {
+		ret = incr_adjust_referrer(ctx, refs->nodes[i], adjust_nsec3_pointers);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static int incr_measure_node(adjust_incr_t *ctx, const knot_dname_t *owner)
+{
+	size_t old_size = 0;
+	zone_node_t *old = tree_lookup(ctx->base->nodes, owner);
+	if (old != NULL) {
+		measure_size(old, &old_size);
+	}
+
+	zone_node_t *node = tree_lookup(ctx->arg.zone->nodes, owner);
+	if (node != NULL) {
+		measure_size(node, &ctx->size);
+	}
+	ctx->size -= old_size;
+
+	return KNOT_EOK;
+}
+
+static int incr_measure_nsec3_node(adjust_incr_t *ctx, const knot_dname_t *owner)
+{
+	size_t old_size = 0;
+	zone_node_t *old = tree_lookup(ctx->base->nsec3_nodes, owner);
+	if (old != NULL) {
+		measure_size(old, &old_size);
+	}
+
+	zone_node_t *node = tree_lookup(ctx->arg.zone->nsec3_nodes, owner);
+	if (node != NULL) {
+		measure_size(node, &ctx->size);
+	}
+	ctx->size -= old_size;
+
+	return KNOT_EOK;
+}
+
+static int incr_adjust(adjust_incr_t *ctx, trie_t *nodes, trie_t *nsec3_nodes)
+{
+	/* Flags and NSEC3 links of the changed nodes and their parents. */
+	int ret = owners_apply(nodes, incr_add_parents, ctx);
+	if (ret == KNOT_EOK) {
+		ret = owners_apply(ctx->region, incr_adjust_node, ctx);
+	}
+	if (ret == KNOT_EOK) {
+		ret = owners_apply(ctx->subtrees, incr_add_subtree, ctx);
+	}
+
+	/* Previous pointers around the changed positions. */
+	if (ret == KNOT_EOK) {
+		ret = owners_apply(ctx->region, incr_adjust_prev_normal, ctx);
+	}
+
+	/* Additionals of the changed nodes and of the nodes referring to them. */
+	if (ret == KNOT_EOK) {
+		ret = owners_apply(ctx->region, incr_adjust_additional, ctx);
+	}
+
+	/* Previous pointers of the NSEC3 nodes and links to the changed ones. */
+	if (ret == KNOT_EOK) {
+		ret = owners_apply(nsec3_nodes, incr_adjust_nsec3_node, ctx);
+	}
+
+	if (ret == KNOT_EOK) {
+		ret = owners_apply(ctx->region, incr_measure_node, ctx);
+	}
+	if (ret == KNOT_EOK) {
+		ret = owners_apply(nsec3_nodes, incr_measure_nsec3_node, ctx);
+	}
+
+	return ret;
+}
+
+int zone_contents_adjust_incremental(zone_contents_t *contents, trie_t *nodes,
+                                     trie_t *nsec3_nodes)
+{
+	if (contents == NULL || contents->apex == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	zone_contents_t *base = contents->cow_base;
+	size_t changes = (nodes != NULL ? trie_weight(nodes) : 0) +
+	                 (nsec3_nodes != NULL ? trie_weight(nsec3_nodes) : 0);
+
+	/* Previous changes, if any, were adjusted incrementally. */
+	if (base == NULL || base->adds_index == NULL || !indices_borrowed(contents) ||
+	    changes > zone_tree_count(contents->nodes) / ADJUST_INCREMENTAL_RATIO) {
+		return contents_adjust(contents, true);
+	}
+
+	int ret = adjust_nsec3param(contents);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	if (!nsec3_params_equal(&contents->nsec3_params, &base->nsec3_params)) {
+		return contents_adjust(contents, true);
+	}
+
+	adjust_incr_t ctx = {
+		.arg = { .zone = contents },
+		.base = base,
+		.size = base->size
+	};
+
+	ret = incr_adjust(&ctx, nodes, nsec3_nodes);
+	if (ret == KNOT_EOK && ctx.full) {
+		ret = contents_adjust(contents, true);
+	} else if (ret == KNOT_EOK) {
+		/* Empty sets, as NULL means all binodes. */
+		if (ctx.adjusted == NULL) {
+			ctx.adjusted = trie_create(NULL);
+		}
+		if (ctx.adjusted_nsec3 == NULL) {
+			ctx.adjusted_nsec3 = trie_create(NULL);
+		}
+		if (ctx.adjusted == NULL || ctx.adjusted_nsec3 == NULL) {
+			ret = KNOT_ENOMEM;
+		} else {
+			zone_tree_owners_free(&contents->cow_adjusted);
+			zone_tree_owners_free(&contents->cow_adjusted_nsec3);
+			contents->cow_adjusted = ctx.adjusted;
+			contents->cow_adjusted_nsec3 = ctx.adjusted_nsec3;
+			ctx.adjusted = NULL;
+			ctx.adjusted_nsec3 = NULL;
+			contents->size = ctx.size;
+		}
+	}
+
+	zone_tree_owners_free(&ctx.region);
+	zone_tree_owners_free(&ctx.subtrees);
+	zone_tree_owners_free(&ctx.linked);
+	zone_tree_owners_free(&ctx.adjusted);
+	zone_tree_owners_free(&ctx.adjusted_nsec3);
+
+	return ret;
+}
+
+int zone_contents_rrsig_expiring(zone_contents_t *contents, knot_time_t until,
+                                 size_t limit, zone_tree_apply_cb_t function,
+                                 void *data, knot_time_t *next)
+{
+	if (contents == NULL || function == NULL || next == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (contents->rrsig_index == NULL) {
+		return KNOT_ENOENT;
+	}
+
+	trie_it_t *it = trie_it_begin(contents->rrsig_index);
+	if (it == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	*next = 0;
+
+	size_t count = 0;
+	int ret = KNOT_EOK;
+	for (; !trie_it_finished(it) && ret == KNOT_EOK; trie_it_next(it)) {
+		size_t len = 0;
+		const uint8_t *key = (const uint8_t *)trie_it_key(it, &len);
+		knot_time_t expire = knot_time_from_u32(wire_read_u32(key));
+		if (knot_time_cmp(expire, until) > 0 || (limit > 0 && count == limit)) {
+			*next = expire;
+			break;
+		}
+
+		const zone_node_t *binode = *trie_it_val(it);
+		bool nsec3 = key[sizeof(uint32_t)];
+		zone_node_t *node = tree_lookup(nsec3 ? contents->nsec3_nodes :
+		                                        contents->nodes, binode->owner);
+		if (node != NULL) {
+			ret = function(&node, data);
+			count++;
+		}
+	}
+	trie_it_free(it);
+
+	return ret;
+}
+
+int zone_contents_apply(zone_contents_t *contents,
+                        zone_contents_apply_cb_t function, void *data)
+{
+	if (contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	zone_tree_func_t f = {
+		.func = function,
+		.data = data
+	};
+
+	return zone_tree_apply(contents->nodes, tree_apply_cb, &f);
+}
+
+int zone_contents_nsec3_apply(zone_contents_t *contents,
+                              zone_contents_apply_cb_t function, void *data)
+{
+	if (contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	zone_tree_func_t f = {
+		.func = function,
+		.data = data
+	};
+
+	return zone_tree_apply(contents->nsec3_nodes, tree_apply_cb, &f);
+}
+
+int zone_contents_shallow_copy(const zone_contents_t *from, zone_contents_t **to)
+{
+	if (from == NULL || to == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	/* Copy to same destination as source. */
+	if (from == *to) {
+		return KNOT_EINVAL;
+	}
+
+	zone_contents_t *contents = calloc(1, sizeof(zone_contents_t));
+	if (contents == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = recreate_normal_tree(from, contents);
+	if (ret != KNOT_EOK) {
+		zone_tree_free(&contents->nodes);
+		free(contents);
+		return ret;
+	}
+
+	if (from->nsec3_nodes) {
+		ret = recreate_nsec3_tree(from, contents);
+		if (ret != KNOT_EOK) {
+			zone_tree_free(&contents->nodes);
+			zone_tree_free(&contents->nsec3_nodes);
+			free(contents);
+			return ret;
+		}
+	} else {
 		contents->nsec3_nodes = NULL;
 	}
 
@@ -1106,16 +1958,313 @@ int zone_contents_shallow_copy(const zone_contents_t *from, zone_contents_t **to
 	return KNOT_EOK;
 }
 
+/*!
+ * \brief Frees a node dropped from one version of the zone.
+ *
+ * Additional data of both binode halves are freed, RR data are kept.
+ */
+static int free_dropped_node(zone_node_t **node, void *data)
+{
+	UNUSED(data);
+
+	zone_node_t *first = binode_node(*node, false);
+	zone_node_t *second = binode_node(*node, true);
+	for (uint16_t i = 0; i < first->rrset_count; ++i) {
+		additional_clear(first->rrs[i].additional);
+	}
+	if (second != first && second->rrs != first->rrs) {
+		for (uint16_t i = 0; i < second->rrset_count; ++i) {
+			additional_clear(second->rrs[i].additional);
+		}
+	}
+
+	node_free(node, NULL);
+
+	return KNOT_EOK;
+}
+
+int zone_contents_cow(zone_contents_t *from, zone_contents_t **to)
+{
+	if (from == NULL || to == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (!(from->nodes->flags & ZONE_TREE_BINODES)) {
+		return KNOT_EINVAL;
+	}
+
+	/* The other halves are unified by the previous commit. */
+	zone_contents_cow_wait(from);
+
+	zone_contents_t *contents = calloc(1, sizeof(zone_contents_t));
+	if (contents == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	if (!__sync_bool_compare_and_swap(&from->cow_next, NULL, contents)) {
+		free(contents);
+		return KNOT_EBUSY;
+	}
+
+	/* Both halves must be equal, which is not the case of a new zone. */
+	if (!(from->nodes->flags & ZONE_TREE_UNIFIED)) {
+		zone_tree_unify_binodes(from->nodes, NULL);
+	}
+	if (from->nsec3_nodes != NULL &&
+	    !(from->nsec3_nodes->flags & ZONE_TREE_UNIFIED)) {
+		zone_tree_unify_binodes(from->nsec3_nodes, NULL);
+	}
+
+	int ret = zone_tree_cow(from->nodes, &contents->nodes);
+	if (ret == KNOT_EOK && from->nsec3_nodes != NULL) {
+		ret = zone_tree_cow(from->nsec3_nodes, &contents->nsec3_nodes);
+		if (ret != KNOT_EOK) {
+			zone_tree_cow_rollback(from->nodes, &contents->nodes, NULL, NULL);
+		}
+	}
+	if (ret != KNOT_EOK) {
+		from->cow_next = NULL;
+		free(contents);
+		return ret;
+	}
+
+	contents->apex = binode_counterpart(from->apex);
+	contents->size = from->size;
+	contents->adds_index = from->adds_index;
+	contents->nsec3_index = from->nsec3_index;
+	contents->rrsig_index = from->rrsig_index;
+	contents->cow_base = from;
+
+	*to = contents;
+	return KNOT_EOK;
+}
+
+/*! \brief Updates the indices of the base by the adjusted nodes of the copy. */
+static int update_indices(zone_contents_t *contents)
+{
+	zone_contents_t *base = contents->cow_base;
+	const knot_dname_t *apex = contents->apex->owner;
+
+	trie_it_t *it = trie_it_begin(contents->cow_adjusted);
+	if (it == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	for (; !trie_it_finished(it) && ret == KNOT_EOK; trie_it_next(it)) {
+		const knot_dname_t *owner = *trie_it_val(it);
+
+		zone_node_t *old = tree_lookup(base->nodes, owner);
+		if (old != NULL) {
+			(void)adds_index_update(contents->adds_index, old, apex, false);
+			if (old->nsec3_node != NULL) {
+				refs_remove(contents->nsec3_index, old->nsec3_node->owner, old);
+			}
+			(void)rrsig_index_update(contents->rrsig_index, old, false, false);
+		}
+
+		zone_node_t *node = tree_lookup(contents->nodes, owner);
+		if (node != NULL) {
+			ret = adds_index_update(contents->adds_index, node, apex, true);
+			if (ret == KNOT_EOK && node->nsec3_node != NULL) {
+				ret = refs_add(contents->nsec3_index, node->nsec3_node->owner, node);
+			}
+			if (ret == KNOT_EOK) {
+				ret = rrsig_index_update(contents->rrsig_index, node, false, true);
+			}
+		}
+	}
+	trie_it_free(it);
+
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	it = trie_it_begin(contents->cow_adjusted_nsec3);
+	if (it == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	for (; !trie_it_finished(it) && ret == KNOT_EOK; trie_it_next(it)) {
+		const knot_dname_t *owner = *trie_it_val(it);
+
+		zone_node_t *old = tree_lookup(base->nsec3_nodes, owner);
+		if (old != NULL) {
+			(void)rrsig_index_update(contents->rrsig_index, old, true, false);
+		}
+
+		zone_node_t *node = tree_lookup(contents->nsec3_nodes, owner);
+		if (node != NULL) {
+			ret = rrsig_index_update(contents->rrsig_index, node, true, true);
+		}
+	}
+	trie_it_free(it);
+
+	return ret;
+}
+
+/*! \brief Passes the indices to the copy, updated if adjusted incrementally. */
+static void commit_indices(zone_contents_t *contents)
+{
+	zone_contents_t *base = contents->cow_base;
+
+	if (!indices_borrowed(contents)) {
+		index_free(&base->adds_index);
+		index_free(&base->nsec3_index);
+		trie_free(base->rrsig_index);
+		base->rrsig_index = NULL;
+		return;
+	}
+
+	base->adds_index = NULL;
+	base->nsec3_index = NULL;
+	base->rrsig_index = NULL;
+
+	/* Without the indices, the next copy will be adjusted fully. */
+	if (contents->cow_adjusted == NULL || contents->adds_index == NULL ||
+	    update_indices(contents) != KNOT_EOK) {
+		index_free(&contents->adds_index);
+		index_free(&contents->nsec3_index);
+		trie_free(contents->rrsig_index);
+		contents->rrsig_index = NULL;
+	}
+}
+
+void zone_contents_cow_commit(zone_contents_t *contents)
+{
+	if (contents == NULL || contents->cow_base == NULL) {
+		return;
+	}
+
+	zone_contents_t *base = contents->cow_base;
+
+	commit_indices(contents);
+
+	zone_tree_cow_commit(&base->nodes, contents->nodes, free_dropped_node, NULL);
+	if (contents->nsec3_nodes != NULL && contents->nsec3_nodes->cow != NULL) {
+		zone_tree_cow_commit(&base->nsec3_nodes, contents->nsec3_nodes,
+		                     free_dropped_node, NULL);
+	}
+
+	/* Prepare the other halves for the next copy. */
+	zone_tree_unify_binodes(contents->nodes, contents->cow_adjusted);
+	zone_tree_unify_binodes(contents->nsec3_nodes, contents->cow_adjusted_nsec3);
+	zone_tree_owners_free(&contents->cow_adjusted);
+	zone_tree_owners_free(&contents->cow_adjusted_nsec3);
+
+	base->apex = NULL;
+	base->cow_next = NULL;
+	contents->cow_base = NULL;
+}
+
+/*! \brief Signals the finished deferred commits. */
+static pthread_mutex_t cow_deferred_mx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cow_deferred_done = PTHREAD_COND_INITIALIZER;
+
+typedef struct {
+	struct rcu_head rcuhead;
+	zone_contents_t *contents;
+} cow_deferred_t;
+
+static void cow_commit_release(zone_contents_t *contents)
+{
+	zone_contents_t *base = contents->cow_base;
+
+	zone_contents_cow_commit(contents);
+	zone_contents_free(&base);
+
+	pthread_mutex_lock(&cow_deferred_mx);
+	contents->cow_deferred = false;
+	pthread_cond_broadcast(&cow_deferred_done);
+	pthread_mutex_unlock(&cow_deferred_mx);
+}
+
+static void cow_deferred_cb(struct rcu_head *head)
+{
+	cow_deferred_t *ctx = (cow_deferred_t *)head;
+	cow_commit_release(ctx->contents);
+	free(ctx);
+}
+
+void zone_contents_cow_commit_rcu(zone_contents_t *contents)
+{
+	if (contents == NULL || contents->cow_base == NULL) {
+		return;
+	}
+
+	cow_deferred_t *ctx = malloc(sizeof(*ctx));
+	if (ctx == NULL) {
+		synchronize_rcu();
+		cow_commit_release(contents);
+		return;
+	}
+
+	ctx->contents = contents;
+	contents->cow_deferred = true;
+	call_rcu(&ctx->rcuhead, cow_deferred_cb);
+}
+
+void zone_contents_cow_wait(zone_contents_t *contents)
+{
+	if (contents == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&cow_deferred_mx);
+	while (contents->cow_deferred) {
+		pthread_cond_wait(&cow_deferred_done, &cow_deferred_mx);
+	}
+	pthread_mutex_unlock(&cow_deferred_mx);
+}
+
+void zone_contents_cow_rollback(zone_contents_t **contents)
+{
+	if (contents == NULL || *contents == NULL || (*contents)->cow_base == NULL) {
+		return;
+	}
+
+	zone_contents_t *copy = *contents;
+	zone_contents_t *base = copy->cow_base;
+
+	zone_tree_cow_rollback(base->nodes, &copy->nodes, free_dropped_node, NULL);
+	if (copy->nsec3_nodes != NULL && copy->nsec3_nodes->cow != NULL) {
+		zone_tree_cow_rollback(base->nsec3_nodes, &copy->nsec3_nodes,
+		                       free_dropped_node, NULL);
+	} else if (copy->nsec3_nodes != NULL) {
+		// Created within the copy.
+		zone_tree_apply(copy->nsec3_nodes, free_dropped_node, NULL);
+		zone_tree_free(&copy->nsec3_nodes);
+	}
+
+	/* Drop changes of the shared nodes. */
+	zone_tree_unify_binodes(base->nodes, NULL);
+	zone_tree_unify_binodes(base->nsec3_nodes, NULL);
+
+	base->cow_next = NULL;
+
+	indices_free(copy);
+	zone_tree_owners_free(&copy->cow_adjusted);
+	zone_tree_owners_free(&copy->cow_adjusted_nsec3);
+	dnssec_nsec3_params_free(&copy->nsec3_params);
+	free(copy);
+	*contents = NULL;
+}
+
 void zone_contents_free(zone_contents_t **contents)
 {
 	if (contents == NULL || *contents == NULL) {
 		return;
 	}
 
+	zone_contents_cow_wait(*contents);
+
 	// free the zone tree, but only the structure
 	zone_tree_free(&(*contents)->nodes);
 	zone_tree_free(&(*contents)->nsec3_nodes);
 
+	indices_free(*contents);
+	zone_tree_owners_free(&(*contents)->cow_adjusted);
+	zone_tree_owners_free(&(*contents)->cow_adjusted_nsec3);
 	dnssec_nsec3_params_free(&(*contents)->nsec3_params);
 
 	free(*contents);
@@ -1128,6 +2277,8 @@ void zone_contents_deep_free(zone_contents_t **contents)
 		return;
 	}
 
+	zone_contents_cow_wait(*contents);
+
 	if (*contents != NULL) {
 		// Delete NSEC3 tree
 		zone_tree_apply((*contents)->nsec3_nodes, destroy_node_rrsets_from_tree, NULL);
@@ -24,6 +24,7 @@
 
 #pragma once
 
+#include "contrib/time.h"
 #include "dnssec/nsec.h"
 #include "libknot/rrtype/nsec3param.h"
 #include "knot/zone/node.h"
@@ -42,6 +43,16 @@ typedef struct zone_contents {
 
 	dnssec_nsec3_params_t nsec3_params;
 	size_t size;
+
+	struct zone_contents *cow_base; /*!< Base of pending copy-on-write. */
+	struct zone_contents *cow_next; /*!< Pending copy-on-write of this version. */
+	bool cow_deferred;              /*!< Commit waits for readers of the base. */
+
+	trie_t *adds_index;  /*!< Nodes referring to names with additional records. */
+	trie_t *nsec3_index; /*!< Nodes linked to NSEC3 nodes. */
+	trie_t *rrsig_index; /*!< Nodes ordered by the earliest RRSIG expiration. */
+	trie_t *cow_adjusted;       /*!< Adjusted owners, NULL if all. */
+	trie_t *cow_adjusted_nsec3; /*!< Adjusted NSEC3 owners, NULL if all. */
 } zone_contents_t;
 
 /*!
@@ -52,11 +63,12 @@ typedef int (*zone_contents_apply_cb_t)(zone_node_t *node, void *data);
 /*!
  * \brief Allocate and create new zone contents.
  *
- * \param apex_name  Name of the root node.
+ * \param apex_name    Name of the root node.
+ * \param use_binodes  Use binodes to allow copy-on-write of the contents.
  *
  * \return New contents or NULL on error.
  */
-zone_contents_t *zone_contents_new(const knot_dname_t *apex_name);
+zone_contents_t *zone_contents_new(const knot_dname_t *apex_name, bool use_binodes);
 
 /*!
  * \brief Add an RR to contents.
@@ -190,6 +202,47 @@ int zone_contents_adjust_pointers(zone_contents_t *contents);
  */
 int zone_contents_adjust_full(zone_contents_t *contents);
 
+/*!
+ * \brief Adjusts only the nodes affected by the given changes.
+ *
+ * Besides the changed nodes, their parents, the subtrees of changed zone
+ * cuts, the neighbours with changed previous pointers and the nodes
+ * referring to the changed names (additionals and NSEC3 links) are adjusted.
+ * Falls back to zone_contents_adjust_full() if the contents are not
+ * a copy-on-write of adjusted contents, NSEC3 parameters or wildcards
+ * changed, or there are too many changes.
+ *
+ * \param contents     Zone contents to be adjusted.
+ * \param nodes        Owners of the changed nodes (see zone_tree_owners_add()).
+ * \param nsec3_nodes  Owners of the changed NSEC3 nodes.
+ */
+int zone_contents_adjust_incremental(zone_contents_t *contents, trie_t *nodes,
+                                     trie_t *nsec3_nodes);
+
+/*!
+ * \brief Applies the given function to the nodes (NSEC3 ones too) with
+ *        an RRSIG expiring until the given time.
+ *
+ * The nodes are found in an index of the earliest RRSIG expirations, which
+ * is built by zone_contents_adjust_full() and kept up-to-date by incremental
+ * adjusting of copy-on-write updates. The contents must not be changed since
+ * the last adjusting.
+ *
+ * \param contents  Zone contents.
+ * \param until     Expiration limit.
+ * \param limit     Maximal number of the nodes (0 for no limit).
+ * \param function  Function to be applied to the nodes.
+ * \param data      Arbitrary data to be passed to the function.
+ * \param next      Output: the earliest expiration of the nodes not applied
+ *                  to (0 if none).
+ *
+ * \retval KNOT_ENOENT if the index isn't available.
+ * \return KNOT_E*
+ */
+int zone_contents_rrsig_expiring(zone_contents_t *contents, knot_time_t until,
+                                 size_t limit, zone_tree_apply_cb_t function,
+                                 void *data, knot_time_t *next);
+
 /*!
  * \brief Applies the given function to each regular node in the zone.
  *
@@ -229,6 +282,65 @@ int zone_contents_nsec3_apply(zone_contents_t *contents,
  */
 int zone_contents_shallow_copy(const zone_contents_t *from, zone_contents_t **to);
 
+/*!
+ * \brief Creates a copy-on-write version of zone contents.
+ *
+ * The new version shares all nodes with the old one. Changed nodes and paths
+ * of the zone trees are copied on demand, so the old version can be still
+ * read by other threads and it must not be changed until the copy is
+ * committed or rolled back.
+ *
+ * \param from  Original zone, must use binodes.
+ * \param to    Copy of the zone.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_EBUSY if there is already a pending copy of the zone.
+ * \retval KNOT_EINVAL if the zone doesn't use binodes.
+ * \retval KNOT_ENOMEM
+ */
+int zone_contents_cow(zone_contents_t *from, zone_contents_t **to);
+
+/*!
+ * \brief Finishes the copy-on-write, keeping the new version.
+ *
+ * Nodes and zone tree parts used only by the old version are freed,
+ * the old version is left empty.
+ *
+ * \note The old version mustn't be read anymore (synchronize RCU first).
+ *
+ * \param contents  New version of the zone.
+ */
+void zone_contents_cow_commit(zone_contents_t *contents);
+
+/*!
+ * \brief Finishes the copy-on-write once the old version isn't read anymore.
+ *
+ * The commit is deferred by call_rcu(), so the new version must be already
+ * published. The old version is freed with the commit. Copying or freeing
+ * the new version waits for the deferred commit.
+ *
+ * \param contents  New version of the zone.
+ */
+void zone_contents_cow_commit_rcu(zone_contents_t *contents);
+
+/*!
+ * \brief Waits for the deferred copy-on-write commit of the contents.
+ *
+ * \param contents  Zone contents.
+ */
+void zone_contents_cow_wait(zone_contents_t *contents);
+
+/*!
+ * \brief Finishes the copy-on-write, keeping the old version.
+ *
+ * Nodes and zone tree parts used only by the new version are freed,
+ * including the new version itself. RR data changes must be reverted
+ * by the caller.
+ *
+ * \param contents  New version of the zone.
+ */
+void zone_contents_cow_rollback(zone_contents_t **contents);
+
 /*!
  * \brief Deallocate directly owned data of zone contents.
  *
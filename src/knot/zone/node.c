@@ -85,13 +85,15 @@ static bool ttl_error(struct rr_data *node_data, const knot_rrset_t *rrset)
 	return inserted_ttl != node_ttl;
 }
 
-zone_node_t *node_new(const knot_dname_t *owner, knot_mm_t *mm)
+zone_node_t *node_new(const knot_dname_t *owner, bool binode, bool second,
+                      knot_mm_t *mm)
 {
-	zone_node_t *ret = mm_alloc(mm, sizeof(zone_node_t));
+	size_t count = binode ? 2 : 1;
+	zone_node_t *ret = mm_alloc(mm, count * sizeof(zone_node_t));
 	if (ret == NULL) {
 		return NULL;
 	}
-	memset(ret, 0, sizeof(*ret));
+	memset(ret, 0, count * sizeof(*ret));
 
 	if (owner) {
 		ret->owner = knot_dname_copy(owner, mm);
@@ -104,9 +106,105 @@ zone_node_t *node_new(const knot_dname_t *owner, knot_mm_t *mm)
 	// Node is authoritative by default.
 	ret->flags = NODE_FLAGS_AUTH;
 
+	if (binode) {
+		ret[0].flags |= NODE_FLAGS_BINODE;
+		ret[1].owner = ret[0].owner;
+		ret[1].flags = ret[0].flags | NODE_FLAGS_SECOND;
+		return second ? &ret[1] : &ret[0];
+	}
+
 	return ret;
 }
 
+/*! \brief Copies additional data of RRSet entries. */
+static int additional_copy(struct rr_data *rrs, uint16_t count, knot_mm_t *mm)
+{
+	for (uint16_t i = 0; i < count; ++i) {
+		additional_t *src = rrs[i].additional;
+		if (src == NULL) {
+			continue;
+		}
+
+		additional_t *dst = malloc(sizeof(*dst));
+		glue_t *glues = malloc(src->count * sizeof(glue_t));
+		if (dst == NULL || glues == NULL) {
+			free(dst);
+			free(glues);
+			// Drop the copies made so far.
+			for (uint16_t j = 0; j < i; ++j) {
+				additional_clear(rrs[j].additional);
+			}
+			return KNOT_ENOMEM;
+		}
+		memcpy(glues, src->glues, src->count * sizeof(glue_t));
+		dst->glues = glues;
+		dst->count = src->count;
+		rrs[i].additional = dst;
+	}
+
+	return KNOT_EOK;
+}
+
+int binode_prepare_change(zone_node_t *node, knot_mm_t *mm)
+{
+	if (node == NULL || !(node->flags & NODE_FLAGS_BINODE)) {
+		return KNOT_EOK;
+	}
+
+	zone_node_t *counterpart = binode_counterpart(node);
+	if (node->rrs == NULL || node->rrs != counterpart->rrs) {
+		return KNOT_EOK;
+	}
+
+	size_t rrlen = node->rrset_count * sizeof(struct rr_data);
+	struct rr_data *rrs = mm_alloc(mm, rrlen);
+	if (rrs == NULL) {
+		return KNOT_ENOMEM;
+	}
+	memcpy(rrs, node->rrs, rrlen);
+
+	int ret = additional_copy(rrs, node->rrset_count, mm);
+	if (ret != KNOT_EOK) {
+		mm_free(mm, rrs);
+		return ret;
+	}
+
+	node->rrs = rrs;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Frees RRSet array of a binode half unless shared with the other one. */
+static void binode_free_rrs(zone_node_t *node, knot_mm_t *mm)
+{
+	zone_node_t *counterpart = binode_counterpart(node);
+	if (node->rrs == counterpart->rrs) {
+		return;
+	}
+
+	for (uint16_t i = 0; i < node->rrset_count; ++i) {
+		additional_clear(node->rrs[i].additional);
+	}
+	mm_free(mm, node->rrs);
+}
+
+void binode_unify(zone_node_t *node, knot_mm_t *mm)
+{
+	if (node == NULL || !(node->flags & NODE_FLAGS_BINODE)) {
+		return;
+	}
+
+	zone_node_t *counterpart = binode_counterpart(node);
+	bool second = binode_second(counterpart);
+
+	binode_free_rrs(counterpart, mm);
+	*counterpart = *node;
+	counterpart->flags ^= NODE_FLAGS_SECOND;
+	counterpart->parent = binode_node(node->parent, second);
+	counterpart->prev = binode_node(node->prev, second);
+	counterpart->nsec3_node = binode_node(node->nsec3_node, second);
+}
+
 void node_free_rrsets(zone_node_t *node, knot_mm_t *mm)
 {
 	if (node == NULL) {
@@ -117,6 +215,14 @@ void node_free_rrsets(zone_node_t *node, knot_mm_t *mm)
 		rr_data_clear(&node->rrs[i], mm);
 	}
 
+	if (node->flags & NODE_FLAGS_BINODE) {
+		zone_node_t *counterpart = binode_counterpart(node);
+		if (counterpart->rrs == node->rrs) {
+			counterpart->rrs = NULL;
+			counterpart->rrset_count = 0;
+		}
+	}
+
 	mm_free(mm, node->rrs);
 	node->rrs = NULL;
 	node->rrset_count = 0;
@@ -128,13 +234,21 @@ void node_free(zone_node_t **node, knot_mm_t *mm)
 		return;
 	}
 
-	if ((*node)->rrs != NULL) {
-		mm_free(mm, (*node)->rrs);
+	zone_node_t *first = binode_node(*node, false);
+	if (first->flags & NODE_FLAGS_BINODE) {
+		zone_node_t *second = binode_node(first, true);
+		if (second->rrs != first->rrs) {
+			mm_free(mm, second->rrs);
+		}
 	}
 
-	knot_dname_free(&(*node)->owner, mm);
+	if (first->rrs != NULL) {
+		mm_free(mm, first->rrs);
+	}
+
+	knot_dname_free(&first->owner, mm);
 
-	mm_free(mm, *node);
+	mm_free(mm, first);
 	*node = NULL;
 }
 
@@ -145,12 +259,14 @@ zone_node_t *node_shallow_copy(const zone_node_t *src, knot_mm_t *mm)
 	}
 
 	// create new node
-	zone_node_t *dst = node_new(src->owner, mm);
+	bool binode = (src->flags & NODE_FLAGS_BINODE);
+	zone_node_t *dst = node_new(src->owner, binode, false, mm);
 	if (dst == NULL) {
 		return NULL;
 	}
 
-	dst->flags = src->flags;
+	const uint8_t binode_flags = NODE_FLAGS_BINODE | NODE_FLAGS_SECOND;
+	dst->flags = (src->flags & ~binode_flags) | (dst->flags & binode_flags);
 
 	// copy RRSets
 	dst->rrset_count = src->rrset_count;
@@ -176,6 +292,11 @@ int node_add_rrset(zone_node_t *node, const knot_rrset_t *rrset, knot_mm_t *mm)
 		return KNOT_EINVAL;
 	}
 
+	int ret = binode_prepare_change(node, mm);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	for (uint16_t i = 0; i < node->rrset_count; ++i) {
 		if (node->rrs[i].type == rrset->type) {
 			struct rr_data *node_data = &node->rrs[i];
@@ -207,6 +328,7 @@ void node_remove_rdataset(zone_node_t *node, uint16_t type)
 
 	for (int i = 0; i < node->rrset_count; ++i) {
 		if (node->rrs[i].type == type) {
+			additional_clear(node->rrs[i].additional);
 			memmove(node->rrs + i, node->rrs + i + 1,
 			        (node->rrset_count - i - 1) * sizeof(struct rr_data));
 			--node->rrset_count;
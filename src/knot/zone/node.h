@@ -78,7 +78,11 @@ enum node_flags {
 	/*! \brief Node is empty and will be deleted after update. */
 	NODE_FLAGS_EMPTY =           1 << 3,
 	/*! \brief Node has a wildcard child. */
-	NODE_FLAGS_WILDCARD_CHILD =  1 << 4
+	NODE_FLAGS_WILDCARD_CHILD =  1 << 4,
+	/*! \brief Node is a half of a binode, see node_new(). */
+	NODE_FLAGS_BINODE =          1 << 5,
+	/*! \brief Node is the second half of a binode. */
+	NODE_FLAGS_SECOND =          1 << 6
 };
 
 /*!
@@ -91,17 +95,83 @@ void additional_clear(additional_t *additional);
 /*!
  * \brief Creates and initializes new node structure.
  *
- * \param owner  Node's owner, will be duplicated.
- * \param mm     Memory context to use.
+ * A binode is a pair of nodes with a common owner, one for each of two
+ * versions of the zone contents. The halves share the RRSet data until
+ * one of them is changed, see binode_prepare_change() and binode_unify().
+ *
+ * \param owner   Node's owner, will be duplicated.
+ * \param binode  Create a binode.
+ * \param second  Return the second half of the binode.
+ * \param mm      Memory context to use.
  *
  * \return Newly created node or NULL if an error occurred.
  */
-zone_node_t *node_new(const knot_dname_t *owner, knot_mm_t *mm);
+zone_node_t *node_new(const knot_dname_t *owner, bool binode, bool second,
+                      knot_mm_t *mm);
+
+/*!
+ * \brief Returns the half of a binode used by the given version.
+ *
+ * \param node    Any half of a binode, or an ordinary node.
+ * \param second  Return the second half.
+ *
+ * \return The binode half, or the node itself if not a binode.
+ */
+static inline zone_node_t *binode_node(const zone_node_t *node, bool second)
+{
+	if (node == NULL || !(node->flags & NODE_FLAGS_BINODE)) {
+		return (zone_node_t *)node;
+	}
+
+	int is_second = (node->flags & NODE_FLAGS_SECOND) ? 1 : 0;
+	return (zone_node_t *)node + ((second ? 1 : 0) - is_second);
+}
+
+/*!
+ * \brief Checks if the node is the second half of a binode.
+ */
+static inline bool binode_second(const zone_node_t *node)
+{
+	return node != NULL && (node->flags & NODE_FLAGS_SECOND);
+}
+
+/*!
+ * \brief Returns the other half of a binode.
+ */
+static inline zone_node_t *binode_counterpart(const zone_node_t *node)
+{
+	return binode_node(node, !binode_second(node));
+}
+
+/*!
+ * \brief Unshares the RRSet array of a binode half before changing it.
+ *
+ * The additional data are copied too, the RR data remain shared.
+ *
+ * \param node  Binode half to be changed, ordinary nodes are ignored.
+ * \param mm    Memory context to use.
+ *
+ * \return KNOT_E*
+ */
+int binode_prepare_change(zone_node_t *node, knot_mm_t *mm);
+
+/*!
+ * \brief Makes the other half of a binode a copy of the given half.
+ *
+ * The RRSet array of the other half is dropped unless shared, and the given
+ * one is shared instead. Node pointers are translated to the other halves.
+ *
+ * \param node  Binode half to be copied, ordinary nodes are ignored.
+ * \param mm    Memory context to use.
+ */
+void binode_unify(zone_node_t *node, knot_mm_t *mm);
 
 /*!
  * \brief Destroys allocated data within the node
  *        structure, but not the node itself.
  *
+ * The other half of a binode sharing the data is left without RRSets.
+ *
  * \param node  Node that contains data to be destroyed.
  * \param mm    Memory context to use.
  */
@@ -110,8 +180,8 @@ void node_free_rrsets(zone_node_t *node, knot_mm_t *mm);
 /*!
  * \brief Destroys the node structure.
  *
- * Does not destroy the data within the node.
- * Also sets the given pointer to NULL.
+ * Does not destroy the data within the node. Both halves of a binode
+ * are destroyed. Also sets the given pointer to NULL.
  *
  * \param node  Node to be destroyed.
  * \param mm    Memory context to use.
@@ -121,6 +191,8 @@ void node_free(zone_node_t **node, knot_mm_t *mm);
 /*!
  * \brief Creates a shallow copy of node structure, RR data are shared.
  *
+ * A copy of a binode half is the first half of a new binode.
+ *
  * \param src  Source of the copy.
  * \param mm   Memory context to use.
  *
@@ -15,6 +15,7 @@
 */
 
 #include "knot/common/log.h"
+#include "knot/conf/zones.h"
 #include "knot/journal/journal.h"
 #include "knot/journal/old_journal.h"
 #include "knot/zone/zone-diff.h"
@@ -33,10 +34,10 @@ int zone_load_contents(conf_t *conf, const knot_dname_t *zone_name,
 	}
 
 	char *zonefile = conf_zonefile(conf, zone_name);
-	conf_val_t val = conf_zone_get(conf, C_SEM_CHECKS, zone_name);
+	bool sem_checks = conf_zone(conf, zone_name).sem_checks;
 
 	zloader_t zl;
-	int ret = zonefile_open(&zl, zonefile, zone_name, conf_bool(&val), time(NULL));
+	int ret = zonefile_open(&zl, zonefile, zone_name, sem_checks, time(NULL));
 	free(zonefile);
 	if (ret != KNOT_EOK) {
 		return ret;
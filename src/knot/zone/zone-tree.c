@@ -16,15 +16,44 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "knot/zone/zone-tree.h"
 #include "libknot/consts.h"
 #include "libknot/errcode.h"
 #include "contrib/macros.h"
 
-zone_tree_t* zone_tree_create()
+/*! \brief Returns the node half used by the tree. */
+static zone_node_t *tree_node(const zone_tree_t *tree, trie_val_t val)
 {
-	return trie_create(NULL);
+	return binode_node(val, tree->flags & ZONE_TREE_SECOND);
+}
+
+zone_tree_t* zone_tree_create(zone_tree_flags_t flags)
+{
+	zone_tree_t *tree = calloc(1, sizeof(*tree));
+	if (tree == NULL) {
+		return NULL;
+	}
+
+	tree->trie = trie_create(NULL);
+	if (tree->trie == NULL) {
+		free(tree);
+		return NULL;
+	}
+	tree->flags = flags & (ZONE_TREE_BINODES | ZONE_TREE_SECOND);
+
+	return tree;
+}
+
+zone_node_t *zone_tree_node_new(const zone_tree_t *tree, const knot_dname_t *owner)
+{
+	if (tree == NULL) {
+		return NULL;
+	}
+
+	return node_new(owner, tree->flags & ZONE_TREE_BINODES,
+	                tree->flags & ZONE_TREE_SECOND, NULL);
 }
 
 size_t zone_tree_count(const zone_tree_t *tree)
@@ -33,7 +62,7 @@ size_t zone_tree_count(const zone_tree_t *tree)
 		return 0;
 	}
 
-	return trie_weight(tree);
+	return trie_weight(tree->trie);
 }
 
 int zone_tree_is_empty(const zone_tree_t *tree)
@@ -51,10 +80,98 @@ int zone_tree_insert(zone_tree_t *tree, zone_node_t *node)
 	uint8_t lf[KNOT_DNAME_MAXLEN];
 	knot_dname_lf(lf, node->owner, NULL);
 
-	*trie_get_ins(tree, (char*)lf+1, *lf) = node;
+	trie_val_t *val;
+	if (tree->cow != NULL) {
+		val = trie_get_cow(tree->cow, (char*)lf+1, *lf);
+	} else {
+		val = trie_get_ins(tree->trie, (char*)lf+1, *lf);
+		tree->flags &= ~ZONE_TREE_UNIFIED;
+	}
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	*val = binode_node(node, false);
 	return KNOT_EOK;
 }
 
+/*! \brief Node with its owner in the lookup format, for sorting. */
+typedef struct {
+	const uint8_t *lf;
+	zone_node_t *node;
+} tree_load_t;
+
+static int tree_load_cmp(const void *a, const void *b)
+{
+	const uint8_t *lf1 = ((const tree_load_t *)a)->lf;
+	const uint8_t *lf2 = ((const tree_load_t *)b)->lf;
+
+	int ret = memcmp(lf1 + 1, lf2 + 1, MIN(*lf1, *lf2));
+	return (ret != 0) ? ret : (int)*lf1 - (int)*lf2;
+}
+
+int zone_tree_load(zone_tree_t *tree, zone_node_t *nodes[], size_t count)
+{
+	if (tree == NULL || tree->cow != NULL || !zone_tree_is_empty(tree) ||
+	    (count > 0 && nodes == NULL)) {
+		return KNOT_EINVAL;
+	}
+
+	if (count == 0) {
+		return KNOT_EOK;
+	}
+
+	// The lookup format takes one byte more than the wire format at most.
+	size_t lf_size = 0;
+	for (size_t i = 0; i < count; i++) {
+		lf_size += knot_dname_size(nodes[i]->owner) + 1;
+	}
+
+	tree_load_t *sorted = malloc(count * sizeof(*sorted));
+	const char **keys = malloc(count * sizeof(*keys));
+	uint32_t *lens = malloc(count * sizeof(*lens));
+	trie_val_t *vals = malloc(count * sizeof(*vals));
+	uint8_t *lf = malloc(lf_size);
+	if (sorted == NULL || keys == NULL || lens == NULL || vals == NULL ||
+	    lf == NULL) {
+		free(sorted);
+		free(keys);
+		free(lens);
+		free(vals);
+		free(lf);
+		return KNOT_ENOMEM;
+	}
+
+	uint8_t *pos = lf;
+	for (size_t i = 0; i < count; i++) {
+		knot_dname_lf(pos, nodes[i]->owner, NULL);
+		sorted[i].lf = pos;
+		sorted[i].node = nodes[i];
+		pos += *pos + 1;
+	}
+
+	qsort(sorted, count, sizeof(*sorted), tree_load_cmp);
+
+	for (size_t i = 0; i < count; i++) {
+		keys[i] = (const char *)sorted[i].lf + 1;
+		lens[i] = *sorted[i].lf;
+		vals[i] = binode_node(sorted[i].node, false);
+	}
+
+	int ret = trie_load_sorted(tree->trie, keys, lens, vals, count);
+	if (ret == KNOT_EOK) {
+		tree->flags &= ~ZONE_TREE_UNIFIED;
+	}
+
+	free(sorted);
+	free(keys);
+	free(lens);
+	free(vals);
+	free(lf);
+
+	return ret;
+}
+
 int zone_tree_get(zone_tree_t *tree, const knot_dname_t *owner,
                   zone_node_t **found)
 {
@@ -69,11 +186,11 @@ int zone_tree_get(zone_tree_t *tree, const knot_dname_t *owner,
 	uint8_t lf[KNOT_DNAME_MAXLEN];
 	knot_dname_lf(lf, owner, NULL);
 
-	trie_val_t *val = trie_get_try(tree, (char*)lf+1, *lf);
+	trie_val_t *val = trie_get_try(tree->trie, (char*)lf+1, *lf);
 	if (val == NULL) {
 		*found = NULL;
 	} else {
-		*found = (zone_node_t*)(*val);
+		*found = tree_node(tree, *val);
 	}
 
 	return KNOT_EOK;
@@ -95,10 +212,11 @@ int zone_tree_get_less_or_equal(zone_tree_t *tree,
 	uint8_t lf[KNOT_DNAME_MAXLEN];
 	knot_dname_lf(lf, owner, NULL);
 
+	trie_t *trie = tree->trie;
 	trie_val_t *fval = NULL;
-	int ret = trie_get_leq(tree, (char*)lf+1, *lf, &fval);
+	int ret = trie_get_leq(trie, (char*)lf+1, *lf, &fval);
 	if (fval) {
-		*found = (zone_node_t *)(*fval);
+		*found = tree_node(tree, *fval);
 	}
 
 	int exact_match = 0;
@@ -116,8 +234,8 @@ int zone_tree_get_less_or_equal(zone_tree_t *tree,
 		 * cases like NSEC3, there is no such sort of thing (name wise).
 		 */
 		/*! \todo We could store rightmost node in zonetree probably. */
-		trie_it_t *i = trie_it_begin(tree);
-		*previous = *(zone_node_t **)trie_it_val(i); /* leftmost */
+		trie_it_t *i = trie_it_begin(trie);
+		*previous = tree_node(tree, *trie_it_val(i)); /* leftmost */
 		*previous = (*previous)->prev; /* rightmost */
 		*found = NULL;
 		trie_it_free(i);
@@ -126,9 +244,15 @@ int zone_tree_get_less_or_equal(zone_tree_t *tree,
 	return exact_match;
 }
 
-int zone_tree_remove(zone_tree_t *tree,
-                     const knot_dname_t *owner,
-                     zone_node_t **removed)
+/*!
+ * \brief Removes node from the tree.
+ *
+ * \retval KNOT_EOK if removed.
+ * \retval 1 if removed and the node was inserted within pending copy-on-write.
+ * \retval KNOT_E* if not removed.
+ */
+static int tree_remove(zone_tree_t *tree, const knot_dname_t *owner,
+                       zone_node_t **removed)
 {
 	if (owner == NULL) {
 		return KNOT_EINVAL;
@@ -141,15 +265,27 @@ int zone_tree_remove(zone_tree_t *tree,
 	uint8_t lf[KNOT_DNAME_MAXLEN];
 	knot_dname_lf(lf, owner, NULL);
 
-	trie_val_t *rval = trie_get_try(tree, (char*)lf+1, *lf);
-	if (rval == NULL) {
-		return KNOT_ENOENT;
+	trie_val_t val = NULL;
+	int ret;
+	if (tree->cow != NULL) {
+		ret = trie_del_cow(tree->cow, (char*)lf+1, *lf, &val);
 	} else {
-		*removed = (zone_node_t *)(*rval);
+		ret = trie_del(tree->trie, (char*)lf+1, *lf, &val);
+		tree->flags &= ~ZONE_TREE_UNIFIED;
+	}
+	if (ret >= 0) {
+		*removed = tree_node(tree, val);
 	}
 
-	trie_del(tree, (char*)lf+1, *lf, NULL);
-	return KNOT_EOK;
+	return ret;
+}
+
+int zone_tree_remove(zone_tree_t *tree,
+                     const knot_dname_t *owner,
+                     zone_node_t **removed)
+{
+	int ret = tree_remove(tree, owner, removed);
+	return ret > 0 ? KNOT_EOK : ret;
 }
 
 /*! \brief Clears wildcard child if set in parent node. */
@@ -181,16 +317,32 @@ int zone_tree_delete_empty_node(zone_tree_t *tree, zone_node_t *node)
 			}
 		}
 
-		// Delete node
+		// Delete node, unless still used by the old version of the tree.
 		zone_node_t *removed_node = NULL;
-		zone_tree_remove(tree, node->owner, &removed_node);
+		int ret = tree_remove(tree, node->owner, &removed_node);
 		UNUSED(removed_node);
-		node_free(&node, NULL);
+		if (tree->cow == NULL || ret > 0) {
+			node_free(&node, NULL);
+		}
 	}
 
 	return KNOT_EOK;
 }
 
+/*! \brief Context for applying a function to the resolved nodes. */
+typedef struct {
+	zone_tree_apply_cb_t func;
+	void *data;
+	bool second;
+} tree_apply_t;
+
+static int tree_apply_cb(trie_val_t *val, void *data)
+{
+	tree_apply_t *ctx = data;
+	zone_node_t *node = binode_node(*val, ctx->second);
+	return ctx->func(&node, ctx->data);
+}
+
 int zone_tree_apply(zone_tree_t *tree, zone_tree_apply_cb_t function, void *data)
 {
 	if (function == NULL) {
@@ -201,7 +353,242 @@ int zone_tree_apply(zone_tree_t *tree, zone_tree_apply_cb_t function, void *data
 		return KNOT_EOK;
 	}
 
-	return trie_apply(tree, (int (*)(trie_val_t *, void *))function, data);
+	tree_apply_t ctx = {
+		.func = function,
+		.data = data,
+		.second = tree->flags & ZONE_TREE_SECOND
+	};
+
+	return trie_apply(tree->trie, tree_apply_cb, &ctx);
+}
+
+int zone_tree_cow(zone_tree_t *from, zone_tree_t **to)
+{
+	if (from == NULL || to == NULL || from->cow != NULL ||
+	    !(from->flags & ZONE_TREE_BINODES)) {
+		return KNOT_EINVAL;
+	}
+
+	zone_tree_t *tree = calloc(1, sizeof(*tree));
+	if (tree == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	tree->cow = trie_cow(from->trie);
+	if (tree->cow == NULL) {
+		free(tree);
+		return KNOT_ENOMEM;
+	}
+	tree->trie = trie_cow_new(tree->cow);
+	tree->flags = (from->flags ^ ZONE_TREE_SECOND) & ~ZONE_TREE_UNIFIED;
+
+	*to = tree;
+	return KNOT_EOK;
+}
+
+static void tree_cow_cb(trie_val_t val, void *data)
+{
+	tree_apply_t *ctx = data;
+	zone_node_t *node = binode_node(val, ctx->second);
+	(void)ctx->func(&node, ctx->data);
+}
+
+void zone_tree_cow_commit(zone_tree_t **from, zone_tree_t *to,
+                          zone_tree_apply_cb_t function, void *data)
+{
+	assert(from && *from && to && to->cow);
+
+	tree_apply_t ctx = {
+		.func = function,
+		.data = data,
+		.second = (*from)->flags & ZONE_TREE_SECOND
+	};
+
+	to->trie = trie_cow_commit(to->cow, function ? tree_cow_cb : NULL, &ctx);
+	to->cow = NULL;
+
+	free(*from);
+	*from = NULL;
+}
+
+void zone_tree_cow_rollback(zone_tree_t *from, zone_tree_t **to,
+                            zone_tree_apply_cb_t function, void *data)
+{
+	assert(from && to && *to && (*to)->cow);
+
+	tree_apply_t ctx = {
+		.func = function,
+		.data = data,
+		.second = (*to)->flags & ZONE_TREE_SECOND
+	};
+
+	(void)trie_cow_rollback((*to)->cow, function ? tree_cow_cb : NULL, &ctx);
+
+	free(*to);
+	*to = NULL;
+}
+
+static int unify_binode(zone_node_t **node, void *data)
+{
+	UNUSED(data);
+	binode_unify(*node, NULL);
+	return KNOT_EOK;
+}
+
+void zone_tree_unify_binodes(zone_tree_t *tree, trie_t *owners)
+{
+	if (tree == NULL || !(tree->flags & ZONE_TREE_BINODES)) {
+		return;
+	}
+
+	if (owners == NULL) {
+		(void)zone_tree_apply(tree, unify_binode, NULL);
+		tree->flags |= ZONE_TREE_UNIFIED;
+		return;
+	}
+
+	trie_it_t *it = trie_it_begin(owners);
+	if (it == NULL) {
+		(void)zone_tree_apply(tree, unify_binode, NULL);
+		tree->flags |= ZONE_TREE_UNIFIED;
+		return;
+	}
+
+	/* The owners sets are keyed the same way as the trees. */
+	for (; !trie_it_finished(it); trie_it_next(it)) {
+		size_t len = 0;
+		const char *key = trie_it_key(it, &len);
+		trie_val_t *val = trie_get_try(tree->trie, key, len);
+		if (val != NULL) {
+			binode_unify(tree_node(tree, *val), NULL);
+		}
+	}
+	trie_it_free(it);
+
+	tree->flags |= ZONE_TREE_UNIFIED;
+}
+
+int zone_tree_owners_add(trie_t **owners, const knot_dname_t *owner)
+{
+	if (owners == NULL || owner == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (*owners == NULL) {
+		*owners = trie_create(NULL);
+		if (*owners == NULL) {
+			return KNOT_ENOMEM;
+		}
+	}
+
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, owner, NULL);
+
+	trie_val_t *val = trie_get_ins(*owners, (char*)lf+1, *lf);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	if (*val == NULL) {
+		*val = knot_dname_copy(owner, NULL);
+		if (*val == NULL) {
+			(void)trie_del(*owners, (char*)lf+1, *lf, NULL);
+			return KNOT_ENOMEM;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static int free_owner(trie_val_t *val, void *data)
+{
+	UNUSED(data);
+	knot_dname_free((knot_dname_t **)val, NULL);
+	return KNOT_EOK;
+}
+
+void zone_tree_owners_free(trie_t **owners)
+{
+	if (owners == NULL || *owners == NULL) {
+		return;
+	}
+
+	(void)trie_apply(*owners, free_owner, NULL);
+	trie_free(*owners);
+	*owners = NULL;
+}
+
+int zone_tree_it_begin(zone_tree_t *tree, zone_tree_it_t *it)
+{
+	if (it == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	it->tree = tree;
+	it->it = NULL;
+	if (tree == NULL) {
+		return KNOT_EOK;
+	}
+
+	it->it = trie_it_begin(tree->trie);
+	if (it->it == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	return KNOT_EOK;
+}
+
+int zone_tree_it_begin_leq(zone_tree_t *tree, const knot_dname_t *owner,
+                           zone_tree_it_t *it)
+{
+	if (it == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	it->tree = tree;
+	it->it = NULL;
+	if (tree == NULL) {
+		return KNOT_EOK;
+	}
+
+	if (owner != NULL) {
+		uint8_t lf[KNOT_DNAME_MAXLEN];
+		knot_dname_lf(lf, owner, NULL);
+		it->it = trie_it_begin_leq(tree->trie, (char*)lf+1, *lf);
+	} else {
+		it->it = trie_it_begin_last(tree->trie);
+	}
+	if (it->it == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	return KNOT_EOK;
+}
+
+bool zone_tree_it_finished(zone_tree_it_t *it)
+{
+	return it->it == NULL || trie_it_finished(it->it);
+}
+
+zone_node_t *zone_tree_it_val(zone_tree_it_t *it)
+{
+	return tree_node(it->tree, *trie_it_val(it->it));
+}
+
+void zone_tree_it_next(zone_tree_it_t *it)
+{
+	trie_it_next(it->it);
+}
+
+void zone_tree_it_prev(zone_tree_it_t *it)
+{
+	trie_it_prev(it->it);
+}
+
+void zone_tree_it_free(zone_tree_it_t *it)
+{
+	trie_it_free(it->it);
+	it->it = NULL;
 }
 
 void zone_tree_free(zone_tree_t **tree)
@@ -209,7 +596,9 @@ void zone_tree_free(zone_tree_t **tree)
 	if (tree == NULL || *tree == NULL) {
 		return;
 	}
-	trie_free(*tree);
+	assert((*tree)->cow == NULL);
+	trie_free((*tree)->trie);
+	free(*tree);
 	*tree = NULL;
 }
 
@@ -27,7 +27,30 @@
 #include "contrib/qp-trie/trie.h"
 #include "knot/zone/node.h"
 
-typedef trie_t zone_tree_t;
+/*! \brief Zone tree flags. */
+typedef enum {
+	ZONE_TREE_BINODES = 1 << 0, /*!< The nodes are binodes. */
+	ZONE_TREE_SECOND  = 1 << 1, /*!< The second halves of binodes are used. */
+	ZONE_TREE_UNIFIED = 1 << 2, /*!< Both halves of all binodes are equal. */
+} zone_tree_flags_t;
+
+/*!
+ * \brief Zone tree.
+ *
+ * The trie stores the first halves of binodes, the tree resolves them
+ * to the halves of its version.
+ */
+typedef struct {
+	trie_t *trie;
+	trie_cow_t *cow;   /*!< Pending copy-on-write, in the new version only. */
+	zone_tree_flags_t flags;
+} zone_tree_t;
+
+/*! \brief Zone tree iterator. */
+typedef struct {
+	zone_tree_t *tree;
+	trie_it_t *it;
+} zone_tree_it_t;
 
 /*!
  * \brief Signature of callback for zone apply functions.
@@ -37,9 +60,21 @@ typedef int (*zone_tree_apply_cb_t)(zone_node_t **node, void *data);
 /*!
  * \brief Creates the zone tree.
  *
+ * \param flags  Binode flags of the tree (ZONE_TREE_BINODES, ZONE_TREE_SECOND).
+ *
  * \return created zone tree structure.
  */
-zone_tree_t* zone_tree_create(void);
+zone_tree_t* zone_tree_create(zone_tree_flags_t flags);
+
+/*!
+ * \brief Creates a node fitting into the tree.
+ *
+ * \param tree   Zone tree the node will be inserted into.
+ * \param owner  Node's owner, will be duplicated.
+ *
+ * \return Newly created node or NULL if an error occurred.
+ */
+zone_node_t *zone_tree_node_new(const zone_tree_t *tree, const knot_dname_t *owner);
 
 /*!
  * \brief Return number of nodes in the zone tree.
@@ -69,6 +104,22 @@ int zone_tree_is_empty(const zone_tree_t *tree);
  */
 int zone_tree_insert(zone_tree_t *tree, zone_node_t *node);
 
+/*!
+ * \brief Inserts the given nodes into an empty zone tree at once.
+ *
+ * The nodes are sorted by their owners and the tree is built directly,
+ * which is much faster than inserting them one by one.
+ *
+ * \param tree   Empty zone tree to insert the nodes into.
+ * \param nodes  Nodes to insert, in any order.
+ * \param count  Number of nodes.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_EINVAL if the tree is not empty or the owners are not unique.
+ * \retval KNOT_ENOMEM
+ */
+int zone_tree_load(zone_tree_t *tree, zone_node_t *nodes[], size_t count);
+
 /*!
  * \brief Finds node with the given owner in the zone tree.
  *
@@ -142,6 +193,117 @@ int zone_tree_delete_empty_node(zone_tree_t *tree, zone_node_t *node);
  */
 int zone_tree_apply(zone_tree_t *tree, zone_tree_apply_cb_t function, void *data);
 
+/*!
+ * \brief Starts a copy-on-write version of the tree.
+ *
+ * The new tree shares the nodes with the old one and uses the other halves
+ * of the binodes. The old tree must not be modified until the new one is
+ * committed or rolled back.
+ *
+ * \param from  Old version of the tree (with binodes).
+ * \param to    New version of the tree.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_EINVAL
+ * \retval KNOT_ENOMEM
+ */
+int zone_tree_cow(zone_tree_t *from, zone_tree_t **to);
+
+/*!
+ * \brief Keeps the new version of a copy-on-write tree.
+ *
+ * The parts of the trie used only by the old version are freed, together
+ * with the old tree structure.
+ *
+ * \param from      Old version of the tree.
+ * \param to        New version of the tree.
+ * \param function  Function applied to the nodes removed in the new version.
+ * \param data      Arbitrary data to be passed to the function.
+ */
+void zone_tree_cow_commit(zone_tree_t **from, zone_tree_t *to,
+                          zone_tree_apply_cb_t function, void *data);
+
+/*!
+ * \brief Drops the new version of a copy-on-write tree.
+ *
+ * The parts of the trie used only by the new version are freed, together
+ * with the new tree structure.
+ *
+ * \param from      Old version of the tree.
+ * \param to        New version of the tree.
+ * \param function  Function applied to the nodes inserted in the new version.
+ * \param data      Arbitrary data to be passed to the function.
+ */
+void zone_tree_cow_rollback(zone_tree_t *from, zone_tree_t **to,
+                            zone_tree_apply_cb_t function, void *data);
+
+/*!
+ * \brief Makes both halves of all binodes in the tree equal.
+ *
+ * The halves not used by the tree become copies of the used ones.
+ *
+ * \param tree    Zone tree.
+ * \param owners  Owners of the only binodes which may differ, NULL if unknown.
+ */
+void zone_tree_unify_binodes(zone_tree_t *tree, trie_t *owners);
+
+/*!
+ * \brief Adds an owner into a set of owners.
+ *
+ * The set is a trie keyed in the same way as zone trees and valued by owner
+ * copies. It's created if empty.
+ *
+ * \param owners  Set of owners.
+ * \param owner   Owner to add.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_EINVAL
+ * \retval KNOT_ENOMEM
+ */
+int zone_tree_owners_add(trie_t **owners, const knot_dname_t *owner);
+
+/*! \brief Frees a set of owners. */
+void zone_tree_owners_free(trie_t **owners);
+
+/*!
+ * \brief Starts iteration over the zone tree in order.
+ *
+ * \param tree  Zone tree to iterate over, NULL means empty.
+ * \param it    Iterator to initialize.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_ENOMEM
+ */
+int zone_tree_it_begin(zone_tree_t *tree, zone_tree_it_t *it);
+
+/*!
+ * \brief Starts iteration over the zone tree at the less-or-equal node.
+ *
+ * \param tree   Zone tree to iterate over, NULL means empty.
+ * \param owner  Owner to search for, NULL means the last node.
+ * \param it     Iterator to initialize, finished if there is no such node.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_ENOMEM
+ */
+int zone_tree_it_begin_leq(zone_tree_t *tree, const knot_dname_t *owner,
+                           zone_tree_it_t *it);
+
+/*! \brief Checks if the iteration has finished. */
+bool zone_tree_it_finished(zone_tree_it_t *it);
+
+/*! \brief Returns the current node. */
+zone_node_t *zone_tree_it_val(zone_tree_it_t *it);
+
+/*! \brief Moves to the next node. */
+void zone_tree_it_next(zone_tree_it_t *it);
+
+/*! \brief Moves to the previous node. */
+void zone_tree_it_prev(zone_tree_it_t *it);
+
+/*! \brief Frees the iterator, it's OK to call it on a finished one. */
+void zone_tree_it_free(zone_tree_it_t *it);
+
 /*!
  * \brief Destroys the zone tree, not touching the saved data.
  *
@@ -14,6 +14,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -21,7 +22,10 @@
 
 #include "knot/common/log.h"
 #include "knot/conf/module.h"
+#include "knot/conf/zones.h"
 #include "knot/dnssec/kasp/kasp_db.h"
+#include "knot/nameserver/answer_cache.h"
+#include "knot/nameserver/axfr_cache.h"
 #include "knot/nameserver/process_query.h"
 #include "knot/query/requestor.h"
 #include "knot/updates/zone-update.h"
@@ -96,8 +100,8 @@ static int flush_journal(conf_t *conf, zone_t *zone, bool allow_empty_zone)
 	}
 
 	/* Check for disabled zonefile synchronization. */
-	conf_val_t val = conf_zone_get(conf, C_ZONEFILE_SYNC, zone->name);
-	if (conf_int(&val) < 0 && !force) {
+	conf_zone_t zconf = conf_zone(conf, zone->name);
+	if (zconf.zonefile_sync < 0 && !force) {
 		log_zone_warning(zone->name, "zonefile synchronization disabled, "
 		                             "use force command to override it");
 		return KNOT_EOK;
@@ -166,8 +170,7 @@ static int flush_journal(conf_t *conf, zone_t *zone, bool allow_empty_zone)
 flush_journal_replan:
 	/* Plan next journal flush after proper period. */
 	zone->timers.last_flush = time(NULL);
-	val = conf_zone_get(conf, C_ZONEFILE_SYNC, zone->name);
-	int64_t sync_timeout = conf_int(&val);
+	int64_t sync_timeout = conf_zone(conf, zone->name).zonefile_sync;
 	if (sync_timeout > 0) {
 		time_t next_flush = zone->timers.last_flush + sync_timeout;
 		zone_events_schedule_at(zone, ZONE_EVENT_FLUSH, 0,
@@ -262,6 +265,9 @@ void zone_free(zone_t **zone_ptr)
 
 	conf_deactivate_modules(&zone->query_modules, &zone->query_plan);
 
+	answer_cache_free(zone->answer_cache);
+	axfr_cache_free(zone->axfr_cache);
+
 	free(zone);
 	*zone_ptr = NULL;
 }
@@ -338,6 +344,25 @@ int zone_changes_load(conf_t *conf, zone_t *zone, list_t *dst, uint32_t from)
 	return ret;
 }
 
+int zone_changes_read(conf_t *conf, zone_t *zone, uint32_t from, journal_read_t **ctx)
+{
+	if (conf == NULL || zone == NULL || ctx == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	int ret = KNOT_ENOENT;
+
+	if (journal_exists(zone->journal_db, zone->name)) {
+		ret = open_journal(zone);
+	}
+
+	if (ret == KNOT_EOK) {
+		ret = journal_read_begin(zone->journal, from, ctx);
+	}
+
+	return ret;
+}
+
 int zone_in_journal_load(conf_t *conf, zone_t *zone, list_t *dst)
 {
 	if (conf == NULL || zone == NULL || dst == NULL) {
@@ -413,6 +438,16 @@ zone_contents_t *zone_switch_contents(zone_t *zone, zone_contents_t *new_content
 	zone_contents_t **current_contents = &zone->contents;
 	old_contents = rcu_xchg_pointer(current_contents, new_contents);
 
+	answer_cache_invalidate(zone->answer_cache);
+	axfr_cache_invalidate(zone->axfr_cache);
+
+	/* Release the old version with its changed paths once not read. */
+	if (new_contents != NULL && new_contents->cow_base != NULL) {
+		assert(new_contents->cow_base == old_contents);
+		zone_contents_cow_commit_rcu(new_contents);
+		return NULL;
+	}
+
 	return old_contents;
 }
 
@@ -422,8 +457,7 @@ bool zone_is_slave(conf_t *conf, const zone_t *zone)
 		return false;
 	}
 
-	conf_val_t val = conf_zone_get(conf, C_MASTER, zone->name);
-	return conf_val_count(&val) > 0 ? true : false;
+	return conf_zone(conf, zone->name).is_slave;
 }
 
 void zone_set_preferred_master(zone_t *zone, const struct sockaddr_storage *addr)
@@ -37,6 +37,9 @@
 #include "libknot/dname.h"
 #include "libknot/packet/pkt.h"
 
+struct answer_cache;
+struct knot_request_loop;
+struct axfr_cache;
 struct process_query_param;
 struct zone_update;
 
@@ -89,6 +92,9 @@ typedef struct zone
 	/*! \brief Ptr to journal DB (in struct server) */
 	journal_db_t **journal_db;
 
+	/*! \brief Ptr to asynchronous request loop (in struct server), can be NULL. */
+	struct knot_request_loop *requests;
+
 	/*! \brief Preferred master lock. */
 	pthread_mutex_t preferred_lock;
 	/*! \brief Preferred master for remote operation. */
@@ -97,6 +103,12 @@ typedef struct zone
 	/*! \brief Query modules. */
 	list_t query_modules;
 	struct query_plan *query_plan;
+
+	/*! \brief Pre-rendered answers, invalidated on contents switch. */
+	struct answer_cache *answer_cache;
+
+	/*! \brief Pre-rendered AXFR messages, invalidated on contents switch. */
+	struct axfr_cache *axfr_cache;
 } zone_t;
 
 /*!
@@ -127,6 +139,7 @@ void zone_control_clear(zone_t *zone);
 int zone_change_store(conf_t *conf, zone_t *zone, changeset_t *change);
 int zone_changes_store(conf_t *conf, zone_t *zone, list_t *chgs);
 int zone_changes_load(conf_t *conf, zone_t *zone, list_t *dst, uint32_t from);
+int zone_changes_read(conf_t *conf, zone_t *zone, uint32_t from, journal_read_t **ctx);
 int zone_in_journal_load(conf_t *conf, zone_t *zone, list_t *dst);
 int zone_in_journal_store(conf_t *conf, zone_t *zone, zone_contents_t *new_contents);
 int zone_journal_serial(conf_t *conf, zone_t *zone, bool *is_empty, uint32_t *serial_to);
@@ -136,6 +149,12 @@ int zone_flush_journal(conf_t *conf, zone_t *zone);
 
 /*!
  * \brief Atomically switch the content of the zone.
+ *
+ * If the new contents is a copy-on-write version of the current one,
+ * the current one including the parts used only by it is freed after
+ * the RCU grace period without blocking, and NULL is returned.
+ *
+ * \return Old contents to be freed by the caller, or NULL.
  */
 zone_contents_t *zone_switch_contents(zone_t *zone, zone_contents_t *new_contents);
 
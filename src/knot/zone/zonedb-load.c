@@ -20,6 +20,8 @@
 #include "knot/common/log.h"
 #include "knot/conf/module.h"
 #include "knot/events/replan.h"
+#include "knot/nameserver/answer_cache.h"
+#include "knot/nameserver/axfr_cache.h"
 #include "knot/zone/timers.h"
 #include "knot/zone/zone-load.h"
 #include "knot/zone/zone.h"
@@ -51,6 +53,7 @@ static zone_t *create_zone_from(const knot_dname_t *name, server_t *server)
 	}
 
 	zone->journal_db = &server->journal_db;
+	zone->requests = server->requests;
 
 	int result = zone_events_setup(zone, server->workers, &server->sched,
 	                               server->timers_db);
@@ -260,6 +263,16 @@ static knot_zonedb_t *create_zonedb(conf_t *conf, server_t *server)
 		conf_activate_modules(conf, zone->name, &zone->query_modules,
 		                      &zone->query_plan);
 
+		conf_val_t val = conf_zone_get(conf, C_ANSWER_CACHE, zone->name);
+		zone->answer_cache = answer_cache_new(conf_int(&val),
+		                                      conf_udp_threads(conf) +
+		                                      conf_tcp_threads(conf));
+
+		val = conf_zone_get(conf, C_AXFR_CACHE, zone->name);
+		size_t axfr_size = conf_int(&val);
+		val = conf_zone_get(conf, C_AXFR_CACHE_KEEP, zone->name);
+		zone->axfr_cache = axfr_cache_new(axfr_size, conf_bool(&val));
+
 		knot_zonedb_insert(db_new, zone);
 	}
 
@@ -286,11 +299,15 @@ static void remove_old_zonedb(conf_t *conf, knot_zonedb_t *db_old,
 	bool full = !(conf->io.flags & CONF_IO_FACTIVE) ||
 	            (conf->io.flags & CONF_IO_FRLD_ZONES);
 
-	knot_zonedb_iter_t it;
-	knot_zonedb_iter_begin(db_old, &it);
+	knot_zonedb_iter_t *it = knot_zonedb_iter_begin(db_old);
+	if (it == NULL) {
+		/* Reused contents can't be told apart, rather leak the zones. */
+		log_error("failed to release the old zone database");
+		return;
+	}
 
-	while (!knot_zonedb_iter_finished(&it)) {
-		zone_t *zone = knot_zonedb_iter_val(&it);
+	while (!knot_zonedb_iter_finished(it)) {
+		zone_t *zone = knot_zonedb_iter_val(it);
 
 		if (full) {
 			/* Check if reloaded (reused contents). */
@@ -310,8 +327,9 @@ static void remove_old_zonedb(conf_t *conf, knot_zonedb_t *db_old,
 			/* Completely reused zone. */
 		}
 
-		knot_zonedb_iter_next(&it);
+		knot_zonedb_iter_next(it);
 	}
+	knot_zonedb_iter_free(it);
 
 	if (full) {
 		knot_zonedb_deep_free(&db_old);
@@ -343,9 +361,6 @@ void zonedb_reload(conf_t *conf, server_t *server)
 		return;
 	}
 
-	/* Rebuild zone database search stack. */
-	knot_zonedb_build_index(db_new);
-
 	/* Switch the databases. */
 	knot_zonedb_t **db_current = &server->zone_db;
 	knot_zonedb_t *db_old = rcu_xchg_pointer(db_current, db_new);
@@ -44,8 +44,42 @@ static void discard_zone(zone_t *zone)
 	zone_free(&zone);
 }
 
+/*!
+ * \brief Converts a domain name to the trie key.
+ *
+ * The labels are stored in reverse order including their length octets,
+ * e.g. \\x04lake\\x07example\\x03com\\x00 -> \\x03com\\x07example\\x04lake
+ *
+ * \return Key length or -1 if invalid name.
+ */
+static int name_to_key(uint8_t key[KNOT_DNAME_MAXLEN], const knot_dname_t *name)
+{
+	const uint8_t *labels[KNOT_DNAME_MAXLABELS];
+	int count = 0;
+	int len = 0;
+	while (*name != '\0') {
+		if (count == KNOT_DNAME_MAXLABELS || len + *name + 1 >= KNOT_DNAME_MAXLEN) {
+			return -1;
+		}
+		labels[count++] = name;
+		len += *name + 1;
+		name = knot_wire_next_label(name, NULL);
+	}
+
+	uint8_t *pos = key;
+	while (count > 0) {
+		const uint8_t *label = labels[--count];
+		memcpy(pos, label, *label + 1);
+		pos += *label + 1;
+	}
+
+	return len;
+}
+
 knot_zonedb_t *knot_zonedb_new(uint32_t size)
 {
+	UNUSED(size);
+
 	/* Create memory pool context. */
 	knot_mm_t mm = {0};
 	mm_ctx_mempool(&mm, MM_DEFAULT_BLKSIZE);
@@ -54,10 +88,9 @@ knot_zonedb_t *knot_zonedb_new(uint32_t size)
 		return NULL;
 	}
 
-	db->maxlabels = 0;
-	db->hash = hhash_create_mm((size + 1) * 2, &mm);
-	if (db->hash == NULL) {
-		mm_free(&mm, db);
+	db->trie = trie_create(NULL);
+	if (db->trie == NULL) {
+		mp_delete(mm.ctx);
 		return NULL;
 	}
 
@@ -71,12 +104,19 @@ int knot_zonedb_insert(knot_zonedb_t *db, zone_t *zone)
 		return KNOT_EINVAL;
 	}
 
-	int name_size = knot_dname_size(zone->name);
-	if (name_size < 0) {
+	uint8_t key[KNOT_DNAME_MAXLEN];
+	int key_len = name_to_key(key, zone->name);
+	if (key_len < 0) {
 		return KNOT_EINVAL;
 	}
 
-	return hhash_insert(db->hash, (const char*)zone->name, name_size, zone);
+	trie_val_t *val = trie_get_ins(db->trie, (const char *)key, key_len);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+	*val = zone;
+
+	return KNOT_EOK;
 }
 
 int knot_zonedb_del(knot_zonedb_t *db, const knot_dname_t *zone_name)
@@ -85,87 +125,90 @@ int knot_zonedb_del(knot_zonedb_t *db, const knot_dname_t *zone_name)
 		return KNOT_EINVAL;
 	}
 
-	/* Can't guess maximum label count now. */
-	db->maxlabels = KNOT_DNAME_MAXLABELS;
-	/* Attempt to remove zone. */
-	int name_size = knot_dname_size(zone_name);
-	return hhash_del(db->hash, (const char*)zone_name, name_size);
+	uint8_t key[KNOT_DNAME_MAXLEN];
+	int key_len = name_to_key(key, zone_name);
+	if (key_len < 0) {
+		return KNOT_EINVAL;
+	}
+
+	int ret = trie_del(db->trie, (const char *)key, key_len, NULL);
+	return (ret == KNOT_ENOENT) ? KNOT_ENOZONE : ret;
 }
 
-int knot_zonedb_build_index(knot_zonedb_t *db)
+zone_t *knot_zonedb_find(knot_zonedb_t *db, const knot_dname_t *zone_name)
 {
-	if (db == NULL) {
-		return KNOT_EINVAL;
+	if (db == NULL || zone_name == NULL) {
+		return NULL;
 	}
 
-	/* Rebuild order index. */
-	hhash_build_index(db->hash);
+	uint8_t key[KNOT_DNAME_MAXLEN];
+	int key_len = name_to_key(key, zone_name);
+	if (key_len < 0) {
+		return NULL;
+	}
 
-	/* Calculate maxlabels. */
-	db->maxlabels = 0;
-	knot_zonedb_iter_t it;
-	knot_zonedb_iter_begin(db, &it);
-	while (!knot_zonedb_iter_finished(&it)) {
-		zone_t *zone = knot_zonedb_iter_val(&it);
-		db->maxlabels = MAX(db->maxlabels, knot_dname_labels(zone->name, NULL));
-		knot_zonedb_iter_next(&it);
+	trie_val_t *val = trie_get_try(db->trie, (const char *)key, key_len);
+	if (val == NULL) {
+		return NULL;
 	}
 
-	return KNOT_EOK;
+	return *val;
 }
 
-static value_t *find_name(knot_zonedb_t *db, const knot_dname_t *dname, uint16_t size)
+zone_t *knot_zonedb_find_suffix(knot_zonedb_t *db, const knot_dname_t *dname)
 {
-	assert(db);
-	assert(dname);
-
-	return hhash_find(db->hash, (const char*)dname, size);
-}
+	if (db == NULL || dname == NULL) {
+		return NULL;
+	}
 
-zone_t *knot_zonedb_find(knot_zonedb_t *db, const knot_dname_t *zone_name)
-{
-	int name_size = knot_dname_size(zone_name);
-	if (!db || name_size < 1) {
+	uint8_t key[KNOT_DNAME_MAXLEN];
+	int key_len = name_to_key(key, dname);
+	if (key_len < 0) {
 		return NULL;
 	}
 
-	value_t *ret = find_name(db, zone_name, name_size);
-	if (ret == NULL) {
+	/* The longest stored prefix is the closest enclosing zone. */
+	trie_val_t *val = trie_get_lpm(db->trie, (const char *)key, key_len);
+	if (val == NULL) {
 		return NULL;
 	}
 
-	return *ret;
+	return *val;
 }
 
-zone_t *knot_zonedb_find_suffix(knot_zonedb_t *db, const knot_dname_t *dname)
+zone_t *knot_zonedb_find_next(knot_zonedb_t *db, const knot_dname_t *zone_name)
 {
-	if (db == NULL || dname == NULL) {
+	if (db == NULL) {
 		return NULL;
 	}
 
-	/* We know we have at most N label zones, so let's compare only those
-	 * N last labels. */
-	int zone_labels = knot_dname_labels(dname, NULL);
-	while (zone_labels > db->maxlabels) {
-		dname = knot_wire_next_label(dname, NULL);
-		--zone_labels;
-	}
+	trie_it_t *it = NULL;
+	if (zone_name == NULL) {
+		it = trie_it_begin(db->trie);
+	} else {
+		uint8_t key[KNOT_DNAME_MAXLEN];
+		int key_len = name_to_key(key, zone_name);
+		if (key_len < 0) {
+			return NULL;
+		}
 
-	/* Compare possible suffixes. */
-	value_t *val = NULL;
-	int name_size = knot_dname_size(dname);
-	while (name_size > 0) { /* Include root label. */
-		val = find_name(db, dname, name_size);
-		if (val != NULL) {
-			return *val;
+		it = trie_it_begin_leq(db->trie, (const char *)key, key_len);
+		if (it != NULL && trie_it_finished(it)) {
+			/* All the stored names follow the given one. */
+			trie_it_free(it);
+			it = trie_it_begin(db->trie);
+		} else if (it != NULL) {
+			trie_it_next(it);
 		}
+	}
 
-		/* Next label */
-		name_size -= (dname[0] + 1);
-		dname = knot_wire_next_label(dname, NULL);
+	zone_t *zone = NULL;
+	if (it != NULL && !trie_it_finished(it)) {
+		zone = *trie_it_val(it);
 	}
+	trie_it_free(it);
 
-	return NULL;
+	return zone;
 }
 
 size_t knot_zonedb_size(const knot_zonedb_t *db)
@@ -174,7 +217,7 @@ size_t knot_zonedb_size(const knot_zonedb_t *db)
 		return 0;
 	}
 
-	return db->hash->weight;
+	return trie_weight(db->trie);
 }
 
 void knot_zonedb_free(knot_zonedb_t **db)
@@ -183,6 +226,7 @@ void knot_zonedb_free(knot_zonedb_t **db)
 		return;
 	}
 
+	trie_free((*db)->trie);
 	mp_delete((*db)->mm.ctx);
 	*db = NULL;
 }
@@ -193,9 +237,6 @@ void knot_zonedb_deep_free(knot_zonedb_t **db)
 		return;
 	}
 
-	/* Reindex for iteration. */
-	knot_zonedb_build_index(*db);
-
 	/* Free zones and database. */
 	knot_zonedb_foreach(*db, discard_zone);
 	knot_zonedb_free(db);
@@ -29,43 +29,43 @@
 
 #include "knot/zone/zone.h"
 #include "libknot/dname.h"
-#include "contrib/hhash.h"
+#include "contrib/qp-trie/trie.h"
 
 /*
  * Zone DB represents a list of managed zones.
- * Hashing should be avoided as it is expensive when only a small number of
- * zones is present (TLD case). Fortunately hhash is able to do linear scan if
- * it has only a handful of names present. Furthermore, we track the name with
- * the most labels in the database. So if we have for example a 'a.b.' in the
- * database and search for 'c.d.a.b.' we can trim the 'c.d.' and search for
- * the suffix as we now there can't be a closer match.
+ * Zones are indexed in a QP-trie by their names with labels in reverse order
+ * (each label keeps its length octet, so that a name's suffixes are exactly
+ * the key prefixes ending on a label boundary). So the closest enclosing zone
+ * for 'c.d.a.b.' is the longest stored prefix of 'b.a.d.c.' found in a single
+ * trie walk regardless of the number of labels.
  */
 typedef struct {
-	uint16_t maxlabels;
-	hhash_t *hash;
+	trie_t *trie;
 	knot_mm_t mm;
 } knot_zonedb_t;
 
 /*
  * Mapping of iterators to internal data structure.
+ * The iterator is allocated (NULL on error) and must be freed.
  */
-typedef hhash_iter_t knot_zonedb_iter_t;
-#define knot_zonedb_iter_begin(db, it) hhash_iter_begin((db)->hash, it, true)
-#define knot_zonedb_iter_finished(it) hhash_iter_finished(it)
-#define knot_zonedb_iter_next(it) hhash_iter_next(it)
-#define knot_zonedb_iter_val(it) *hhash_iter_val(it)
+typedef trie_it_t knot_zonedb_iter_t;
+#define knot_zonedb_iter_begin(db) trie_it_begin((db)->trie)
+#define knot_zonedb_iter_finished(it) ((it) == NULL || trie_it_finished(it))
+#define knot_zonedb_iter_next(it) trie_it_next(it)
+#define knot_zonedb_iter_val(it) *trie_it_val(it)
+#define knot_zonedb_iter_free(it) trie_it_free(it)
 
 /*
  * Simple foreach() access with callback and variable number of callback params.
  */
 #define knot_zonedb_foreach(db, callback, ...) \
 { \
-	knot_zonedb_iter_t it; \
-	knot_zonedb_iter_begin((db), &it); \
-	while(!knot_zonedb_iter_finished(&it)) { \
-		callback((zone_t *)knot_zonedb_iter_val(&it), ##__VA_ARGS__); \
-		knot_zonedb_iter_next(&it); \
+	knot_zonedb_iter_t *it = knot_zonedb_iter_begin((db)); \
+	while(!knot_zonedb_iter_finished(it)) { \
+		callback((zone_t *)knot_zonedb_iter_val(it), ##__VA_ARGS__); \
+		knot_zonedb_iter_next(it); \
 	} \
+	knot_zonedb_iter_free(it); \
 }
 
 /*!
@@ -98,11 +98,6 @@ int knot_zonedb_insert(knot_zonedb_t *db, zone_t *zone);
  */
 int knot_zonedb_del(knot_zonedb_t *db, const knot_dname_t *zone_name);
 
-/*!
- * \brief Build zone stack for faster lookup.
- */
-int knot_zonedb_build_index(knot_zonedb_t *db);
-
 /*!
  * \brief Finds zone exactly matching the given zone name.
  *
@@ -125,6 +120,19 @@ zone_t *knot_zonedb_find(knot_zonedb_t *db, const knot_dname_t *zone_name);
  */
 zone_t *knot_zonedb_find_suffix(knot_zonedb_t *db, const knot_dname_t *dname);
 
+/*!
+ * \brief Finds the zone following the given zone name in the database order.
+ *
+ * The given zone doesn't have to be present in the database, which allows
+ * to resume an iteration over a database changed in the meantime.
+ *
+ * \param db Zone database to search in.
+ * \param zone_name Preceding zone name, NULL for the first zone.
+ *
+ * \return The following zone or NULL if there is no such zone.
+ */
+zone_t *knot_zonedb_find_next(knot_zonedb_t *db, const knot_dname_t *zone_name);
+
 size_t knot_zonedb_size(const knot_zonedb_t *db);
 
 /*!
@@ -241,34 +241,51 @@ void knot_ctl_unbind(knot_ctl_t *ctx)
 	close_sock(&ctx->listen_sock);
 }
 
-_public_
-int knot_ctl_accept(knot_ctl_t *ctx)
+static int accept_client(knot_ctl_t *ctx, knot_ctl_t *client, int timeout_ms)
 {
-	if (ctx == NULL) {
+	if (ctx == NULL || client == NULL) {
 		return KNOT_EINVAL;
 	}
 
-	knot_ctl_close(ctx);
+	knot_ctl_close(client);
 
 	// Control interface.
 	struct pollfd pfd = { .fd = ctx->listen_sock, .events = POLLIN };
-	int ret = poll(&pfd, 1, -1);
-	if (ret <= 0) {
+	int ret = poll(&pfd, 1, timeout_ms);
+	if (ret == 0) {
+		return KNOT_ETIMEOUT;
+	} else if (ret < 0) {
 		return knot_map_errno();
 	}
 
-	int client = net_accept(ctx->listen_sock, NULL);
-	if (client < 0) {
-		return client;
+	int sock = net_accept(ctx->listen_sock, NULL);
+	if (sock < 0) {
+		return sock;
 	}
 
-	ctx->sock = client;
+	client->sock = sock;
 
-	reset_buffers(ctx);
+	reset_buffers(client);
 
 	return KNOT_EOK;
 }
 
+_public_
+int knot_ctl_accept(knot_ctl_t *ctx)
+{
+	return accept_client(ctx, ctx, -1);
+}
+
+_public_
+int knot_ctl_accept_client(knot_ctl_t *ctx, knot_ctl_t *client)
+{
+	if (ctx == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	return accept_client(ctx, client, ctx->timeout);
+}
+
 _public_
 int knot_ctl_connect(knot_ctl_t *ctx, const char *path)
 {
@@ -124,6 +124,22 @@ int knot_ctl_connect(knot_ctl_t *ctx, const char *path);
  */
 int knot_ctl_accept(knot_ctl_t *ctx);
 
+/*!
+ * Waits for an incoming connection and assigns it to another control context.
+ *
+ * This allows processing of several connections at once. Unlike
+ * knot_ctl_accept(), the waiting is limited by the timeout of the bound
+ * context so that the caller can check for other events.
+ *
+ * \note Server operation.
+ *
+ * \param[in] ctx     Control context with the bound socket.
+ * \param[in] client  Control context for the connection.
+ *
+ * \return Error code, KNOT_ETIMEOUT if no connection, KNOT_EOK if successful.
+ */
+int knot_ctl_accept_client(knot_ctl_t *ctx, knot_ctl_t *client);
+
 /*!
  * Closes the remote connections.
  *
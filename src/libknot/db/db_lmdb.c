@@ -538,15 +538,22 @@ size_t knot_db_lmdb_get_mapsize(knot_db_t *db)
 _public_
 size_t knot_db_lmdb_get_usage(knot_db_t *db)
 {
-	struct lmdb_env *env = db;
 	knot_db_txn_t txn;
 	knot_db_lmdb_txn_begin(db, &txn, NULL, KNOT_DB_RDONLY);
+	size_t usage = knot_db_lmdb_get_usage_txn(&txn);
+	txn_abort(&txn);
+
+	return usage;
+}
+
+_public_
+size_t knot_db_lmdb_get_usage_txn(knot_db_txn_t *txn)
+{
+	struct lmdb_env *env = txn->db;
 	MDB_stat st;
-	if (mdb_stat(txn.txn, env->dbi, &st) != MDB_SUCCESS) {
-		txn_abort(&txn);
+	if (mdb_stat(txn->txn, env->dbi, &st) != MDB_SUCCESS) {
 		return 0;
 	}
-	txn_abort(&txn);
 
 	size_t pgs_used = st.ms_branch_pages + st.ms_leaf_pages + st.ms_overflow_pages;
 
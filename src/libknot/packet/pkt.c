@@ -594,6 +594,47 @@ int knot_pkt_put(knot_pkt_t *pkt, uint16_t compr_hint, const knot_rrset_t *rr,
 	return KNOT_EOK;
 }
 
+_public_
+int knot_pkt_put_wire(knot_pkt_t *pkt, const uint8_t *wire, uint16_t len,
+                      const knot_rrset_t *rr, const knot_rrinfo_t *rr_info,
+                      uint16_t count)
+{
+	if (pkt == NULL || wire == NULL || rr == NULL || rr_info == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (len > pkt_remaining(pkt)) {
+		return KNOT_ESPACE;
+	}
+
+	/* Reserve memory for RR descriptors. */
+	int ret = pkt_rr_array_alloc(pkt, pkt->rrset_count + count);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	for (uint16_t i = 0; i < count; ++i) {
+		knot_rrinfo_t *rrinfo = &pkt->rr_info[pkt->rrset_count];
+		*rrinfo = rr_info[i];
+		rrinfo->flags &= ~KNOT_PF_FREE;
+		memcpy(pkt->rr + pkt->rrset_count, &rr[i], sizeof(knot_rrset_t));
+
+		/* Keep reference to special types. */
+		if (rr[i].type == KNOT_RRTYPE_OPT) {
+			pkt->opt_rr = &pkt->rr[pkt->rrset_count];
+		}
+
+		pkt->rrset_count += 1;
+		pkt->sections[pkt->current].count += 1;
+		pkt_rr_wirecount_add(pkt, pkt->current, rr[i].rrs.rr_count);
+	}
+
+	memcpy(pkt->wire + pkt->size, wire, len);
+	pkt->size += len;
+
+	return KNOT_EOK;
+}
+
 _public_
 const knot_pktsection_t *knot_pkt_section(const knot_pkt_t *pkt,
                                           knot_section_t section_id)
@@ -221,6 +221,25 @@ int knot_pkt_put_question(knot_pkt_t *pkt, const knot_dname_t *qname,
 int knot_pkt_put(knot_pkt_t *pkt, uint16_t compr_hint, const knot_rrset_t *rr,
                  uint16_t flags);
 
+/*!
+ * \brief Put RRSets already converted to wire format into packet.
+ *
+ * The wire is copied as is, so it must have been written at the current
+ * packet size after the same question, as well as the RRSet positions and
+ * compression pointers. The RRSets are referenced, not freed with the packet.
+ *
+ * \param pkt
+ * \param wire Wire format of the RRSets.
+ * \param len Size of the wire format.
+ * \param rr Given RRSets.
+ * \param rr_info Positions and compression hints of the RRSets in the wire.
+ * \param count Number of the RRSets.
+ * \return KNOT_EOK, KNOT_ESPACE, various errors
+ */
+int knot_pkt_put_wire(knot_pkt_t *pkt, const uint8_t *wire, uint16_t len,
+                      const knot_rrset_t *rr, const knot_rrinfo_t *rr_info,
+                      uint16_t count);
+
 /*! \brief Get description of the given packet section. */
 const knot_pktsection_t *knot_pkt_section(const knot_pkt_t *pkt,
                                           knot_section_t section_id);
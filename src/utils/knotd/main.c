@@ -17,9 +17,13 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <sys/stat.h>
@@ -44,6 +48,7 @@
 #include "knot/common/stats.h"
 #include "knot/server/server.h"
 #include "knot/server/tcp-handler.h"
+#include "knot/worker/pool.h"
 #include "knot/zone/timers.h"
 
 #define PROGRAM_NAME "knotd"
@@ -123,7 +128,7 @@ static const struct signal SIGNALS[] = {
 	{ SIGHUP,  true  },  /* Reload server. */
 	{ SIGINT,  true  },  /* Terminate server .*/
 	{ SIGTERM, true  },
-	{ SIGALRM, false },  /* Internal thread synchronization. */
+	{ SIGALRM, true  },  /* Internal thread synchronization. */
 	{ SIGPIPE, false },  /* Ignored. Some I/O errors. */
 	{ 0 }
 };
@@ -217,6 +222,128 @@ static void setup_capabilities(void)
 #endif /* HAVE_CAP_NG_H */
 }
 
+/*! \brief Number of control connections processed at once. */
+#define CTL_WORKERS	4
+/*! \brief Maximum number of accepted control connections. */
+#define CTL_CLIENTS	(4 * CTL_WORKERS)
+/*! \brief Longest waiting for a new connection before checking the signals. */
+#define CTL_ACCEPT_MS	1000
+
+struct ctl_clients;
+
+/*! \brief Accepted control connection. */
+typedef struct {
+	task_t task;
+	knot_ctl_t *ctl;
+	struct ctl_clients *clients;
+} ctl_client_t;
+
+/*! \brief Control connections processed by the control workers. */
+typedef struct ctl_clients {
+	server_t *server;
+	pthread_t main;
+	worker_pool_t *workers;
+	pthread_mutex_t mx;
+	pthread_cond_t released;
+	ctl_client_t *free[CTL_CLIENTS];
+	size_t free_count;
+	ctl_client_t all[CTL_CLIENTS];
+} ctl_clients_t;
+
+static void ctl_client_release(ctl_clients_t *clients, ctl_client_t *client)
+{
+	pthread_mutex_lock(&clients->mx);
+	clients->free[clients->free_count++] = client;
+	pthread_cond_signal(&clients->released);
+	pthread_mutex_unlock(&clients->mx);
+}
+
+/*! \brief Get an unused connection, wait a while if all are processed. */
+static ctl_client_t *ctl_client_acquire(ctl_clients_t *clients)
+{
+	struct timespec timeout;
+	clock_gettime(CLOCK_REALTIME, &timeout);
+	timeout.tv_sec += 1;
+
+	ctl_client_t *client = NULL;
+
+	pthread_mutex_lock(&clients->mx);
+	if (clients->free_count == 0) {
+		pthread_cond_timedwait(&clients->released, &clients->mx, &timeout);
+	}
+	if (clients->free_count > 0) {
+		client = clients->free[--clients->free_count];
+	}
+	pthread_mutex_unlock(&clients->mx);
+
+	return client;
+}
+
+/*! \brief Control worker processing one connection. */
+static void ctl_client_process(task_t *task)
+{
+	ctl_client_t *client = task->ctx;
+	ctl_clients_t *clients = client->clients;
+
+	int ret = ctl_process(client->ctl, clients->server);
+	knot_ctl_close(client->ctl);
+	if (ret == KNOT_CTL_ESTOP) {
+		/* Interrupt the waiting for a new connection, the signal coming
+		 * right before the waiting started is caught by its timeout. */
+		sig_req_stop = true;
+		pthread_kill(clients->main, SIGALRM);
+	}
+
+	ctl_client_release(clients, client);
+}
+
+static void ctl_clients_deinit(ctl_clients_t *clients)
+{
+	if (clients->workers != NULL) {
+		worker_pool_stop(clients->workers);
+		worker_pool_join(clients->workers);
+		worker_pool_destroy(clients->workers);
+	}
+
+	for (int i = 0; i < CTL_CLIENTS; i++) {
+		knot_ctl_free(clients->all[i].ctl);
+	}
+
+	pthread_mutex_destroy(&clients->mx);
+	pthread_cond_destroy(&clients->released);
+}
+
+static int ctl_clients_init(ctl_clients_t *clients, server_t *server)
+{
+	memset(clients, 0, sizeof(*clients));
+	clients->server = server;
+	clients->main = pthread_self();
+	pthread_mutex_init(&clients->mx, NULL);
+	pthread_cond_init(&clients->released, NULL);
+
+	for (int i = 0; i < CTL_CLIENTS; i++) {
+		ctl_client_t *client = &clients->all[i];
+		client->ctl = knot_ctl_alloc();
+		if (client->ctl == NULL) {
+			ctl_clients_deinit(clients);
+			return KNOT_ENOMEM;
+		}
+		client->clients = clients;
+		client->task.ctx = client;
+		client->task.run = ctl_client_process;
+		clients->free[clients->free_count++] = client;
+	}
+
+	clients->workers = worker_pool_create(CTL_WORKERS);
+	if (clients->workers == NULL) {
+		ctl_clients_deinit(clients);
+		return KNOT_ENOMEM;
+	}
+	worker_pool_start(clients->workers);
+
+	return KNOT_EOK;
+}
+
 /*! \brief Event loop listening for signals and remote commands. */
 static void event_loop(server_t *server, const char *socket)
 {
@@ -227,9 +354,6 @@ static void event_loop(server_t *server, const char *socket)
 		return;
 	}
 
-	// Set control timeout.
-	knot_ctl_set_timeout(ctl, conf()->cache.ctl_timeout);
-
 	/* Get control socket configuration. */
 	char *listen;
 	if (socket == NULL) {
@@ -259,6 +383,19 @@ static void event_loop(server_t *server, const char *socket)
 	}
 	free(listen);
 
+	/* Prepare the concurrent processing. */
+	ctl_clients_t clients;
+	ret = ctl_clients_init(&clients, server);
+	if (ret != KNOT_EOK) {
+		knot_ctl_unbind(ctl);
+		knot_ctl_free(ctl);
+		log_fatal("control, failed to initialize (%s)",
+		          knot_strerror(ret));
+		return;
+	}
+
+	knot_ctl_set_timeout(ctl, CTL_ACCEPT_MS);
+
 	enable_signals();
 
 	/* Run event loop. */
@@ -269,27 +406,34 @@ static void event_loop(server_t *server, const char *socket)
 		}
 		if (sig_req_reload) {
 			sig_req_reload = false;
+			ctl_lock();
 			server_reload(server);
+			ctl_unlock();
+		}
+
+		ctl_client_t *client = ctl_client_acquire(&clients);
+		if (client == NULL) {
+			continue;
 		}
 
 		// Update control timeout.
-		knot_ctl_set_timeout(ctl, conf()->cache.ctl_timeout);
+		knot_ctl_set_timeout(client->ctl, conf()->cache.ctl_timeout);
 
-		ret = knot_ctl_accept(ctl);
+		ret = knot_ctl_accept_client(ctl, client->ctl);
 		if (ret != KNOT_EOK) {
+			ctl_client_release(&clients, client);
 			continue;
 		}
 
-		ret = ctl_process(ctl, server);
-		knot_ctl_close(ctl);
-		if (ret == KNOT_CTL_ESTOP) {
-			break;
-		}
+		worker_pool_assign(clients.workers, &client->task);
 	}
 
 	/* Unbind the control socket. */
 	knot_ctl_unbind(ctl);
 	knot_ctl_free(ctl);
+
+	/* Finish the connections being processed. */
+	ctl_clients_deinit(&clients);
 }
 
 static void print_help(void)
@@ -372,7 +516,7 @@ static int set_config(const char *confdb, const char *config)
 	                      &new_conf->query_plan);
 
 	/* Update to the new config. */
-	conf_update(new_conf, CONF_UPD_FNONE);
+	conf_update(new_conf, CONF_UPD_FZONES);
 
 	return KNOT_EOK;
 }
@@ -14,6 +14,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -102,6 +103,13 @@ static bool str_key_get_leq(trie_t *trie, char **keys, size_t i, size_t size)
 
 }
 
+static void count_dropped(trie_val_t val, void *d)
+{
+	UNUSED(val);
+	size_t *count = d;
+	*count += 1;
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -172,6 +180,44 @@ int main(int argc, char *argv[])
 	}
 	ok(passed, "trie: find lesser or equal for all keys");
 
+	/* Longest prefix lookup. */
+	passed = true;
+	for (unsigned i = 0; i < key_count; ++i) {
+		char key_buf[KEY_MAXLEN + 4];
+		size_t key_len = strlen(keys[i]) + 1;
+		memcpy(key_buf, keys[i], key_len);
+		memcpy(key_buf + key_len, "xyz", 3);
+		val = trie_get_lpm(trie, key_buf, key_len + 3);
+		if (val == NULL || strcmp(*val, keys[i]) != 0) {
+			diag("trie: longest prefix mismatch on element '%u'", i);
+			passed = false;
+			break;
+		}
+		if (trie_get_lpm(trie, key_buf, key_len - 1) != NULL) {
+			diag("trie: longest prefix found for short element '%u'", i);
+			passed = false;
+			break;
+		}
+	}
+	ok(passed, "trie: find longest prefix for all keys");
+
+	/* Nested prefixes. */
+	trie_t *nested = trie_create(NULL);
+	static const char *prefixes[] = { "", "a", "ab", "abcd" };
+	for (unsigned i = 0; i < sizeof(prefixes) / sizeof(*prefixes); ++i) {
+		*trie_get_ins(nested, prefixes[i], strlen(prefixes[i])) = (void *)prefixes[i];
+	}
+	*trie_get_ins(nested, "b", 1) = (void *)"b";
+	val = trie_get_lpm(nested, "abc", 3);
+	ok(val != NULL && *val == prefixes[2], "trie: longest prefix among nested keys");
+	val = trie_get_lpm(nested, "abcde", 5);
+	ok(val != NULL && *val == prefixes[3], "trie: longest prefix is the longest key");
+	val = trie_get_lpm(nested, "c", 1);
+	ok(val != NULL && *val == prefixes[0], "trie: longest prefix is the empty key");
+	trie_del(nested, "", 0, NULL);
+	ok(trie_get_lpm(nested, "c", 1) == NULL, "trie: no longest prefix");
+	trie_free(nested);
+
 	/* Sorted iteration. */
 	char key_buf[KEY_MAXLEN] = {'\0'};
 	size_t iterated = 0;
@@ -192,6 +238,144 @@ int main(int argc, char *argv[])
 	is_int(inserted, iterated, "trie: sorted iteration");
 	trie_it_free(it);
 
+	/* Reverse iteration. */
+	iterated = 0;
+	passed = true;
+	it = trie_it_begin_last(trie);
+	while (!trie_it_finished(it)) {
+		size_t cur_key_len = 0;
+		const char *cur_key = trie_it_key(it, &cur_key_len);
+		if (iterated > 0 && strcmp(key_buf, cur_key) <= 0) {
+			diag("'%s' > '%s' FAIL\n", key_buf, cur_key);
+			passed = false;
+			break;
+		}
+		++iterated;
+		memcpy(key_buf, cur_key, cur_key_len);
+		trie_it_prev(it);
+	}
+	ok(passed && iterated == inserted, "trie: reverse iteration");
+	trie_it_free(it);
+
+	/* Iteration from the lesser key, just before the searched one. */
+	passed = true;
+	for (unsigned i = 0; i < key_count && passed; i += 97) {
+		int j = (int)i - 1;
+		while (j >= 0 && strcmp(keys[j], keys[i]) == 0) {
+			--j;
+		}
+		it = trie_it_begin_leq(trie, keys[i], strlen(keys[i]));
+		if (j < 0) {
+			passed = trie_it_finished(it);
+		} else {
+			passed = !trie_it_finished(it) &&
+			         strcmp(trie_it_key(it, NULL), keys[j]) == 0;
+			if (passed) {
+				trie_it_next(it);
+				passed = strcmp(trie_it_key(it, NULL), keys[i]) == 0;
+				trie_it_prev(it);
+				passed = passed && strcmp(trie_it_key(it, NULL), keys[j]) == 0;
+			}
+		}
+		trie_it_free(it);
+		if (!passed) {
+			diag("trie: iteration from lesser key failed on element '%u'", i);
+		}
+	}
+	it = trie_it_begin_leq(trie, keys[key_count - 1], strlen(keys[key_count - 1]) + 1);
+	passed = passed && strcmp(trie_it_key(it, NULL), keys[key_count - 1]) == 0;
+	trie_it_free(it);
+	ok(passed, "trie: iteration from lesser or equal keys");
+
+	/* Bulk load of the unique sorted keys. */
+	const char **load_keys = malloc(sizeof(char *) * inserted);
+	uint32_t *load_lens = malloc(sizeof(uint32_t) * inserted);
+	trie_val_t *load_vals = malloc(sizeof(trie_val_t) * inserted);
+	size_t loaded = 0;
+	for (unsigned i = 0; i < key_count; ++i) {
+		if (i > 0 && strcmp(keys[i - 1], keys[i]) == 0) {
+			continue;
+		}
+		load_keys[loaded] = keys[i];
+		load_lens[loaded] = strlen(keys[i]) + 1;
+		load_vals[loaded] = keys[i];
+		++loaded;
+	}
+	trie_t *bulk = trie_create(NULL);
+	int ret = trie_load_sorted(bulk, load_keys, load_lens, load_vals, loaded);
+	passed = ret == KNOT_EOK && loaded == inserted && trie_weight(bulk) == inserted;
+	for (unsigned i = 0; i < key_count && passed; ++i) {
+		val = trie_get_try(bulk, keys[i], strlen(keys[i]) + 1);
+		passed = val != NULL && strcmp(*val, keys[i]) == 0;
+	}
+	trie_it_t *it1 = trie_it_begin(trie), *it2 = trie_it_begin(bulk);
+	while (passed && !trie_it_finished(it1) && !trie_it_finished(it2)) {
+		passed = strcmp(trie_it_key(it1, NULL), trie_it_key(it2, NULL)) == 0;
+		trie_it_next(it1);
+		trie_it_next(it2);
+	}
+	passed = passed && trie_it_finished(it1) && trie_it_finished(it2);
+	trie_it_free(it1);
+	trie_it_free(it2);
+	ok(passed, "trie: bulk load of sorted keys");
+	ret = trie_load_sorted(bulk, load_keys, load_lens, load_vals, loaded);
+	trie_free(bulk);
+	bulk = trie_create(NULL);
+	load_keys[1] = load_keys[0];
+	load_lens[1] = load_lens[0];
+	ret += trie_load_sorted(bulk, load_keys, load_lens, load_vals, loaded);
+	ok(ret == 2 * KNOT_EINVAL && trie_weight(bulk) == 0,
+	   "trie: bulk load into non-empty trie or of unsorted keys");
+	trie_free(bulk);
+	free(load_keys);
+	free(load_lens);
+	free(load_vals);
+
+	/* Copy-on-write, rolled back and then committed. */
+	for (int commit = 0; commit <= 1; ++commit) {
+		trie_cow_t *cow = trie_cow(trie);
+		trie_t *new = trie_cow_new(cow);
+		size_t deleted = 0, added = 0;
+		passed = true;
+		for (unsigned i = 0; i < key_count; i += 2) {
+			if (trie_del_cow(cow, keys[i], strlen(keys[i]) + 1, NULL) == KNOT_EOK) {
+				++deleted;
+			}
+		}
+		for (unsigned i = 0; i < 1000; ++i) {
+			char key[16];
+			(void)snprintf(key, sizeof(key), "Z%u", i);
+			val = trie_get_cow(cow, key, strlen(key) + 1);
+			if (val != NULL && *val == NULL) {
+				*val = keys[i];
+				++added;
+			}
+		}
+		passed = passed && trie_del_cow(cow, "Z0", 3, NULL) == 1;
+		passed = passed && trie_weight(new) == inserted - deleted + added - 1;
+		for (unsigned i = 0; i < key_count; ++i) {
+			val = trie_get_try(trie, keys[i], strlen(keys[i]) + 1);
+			passed = passed && val != NULL && strcmp(*val, keys[i]) == 0;
+		}
+		passed = passed && trie_weight(trie) == inserted;
+		ok(passed, "trie: copy-on-write keeps the old version");
+
+		size_t dropped = 0;
+		if (commit) {
+			trie = trie_cow_commit(cow, count_dropped, &dropped);
+			ok(trie == new && dropped == deleted &&
+			   trie_get_try(trie, keys[0], strlen(keys[0]) + 1) == NULL &&
+			   trie_get_try(trie, "Z1", 3) != NULL,
+			   "trie: copy-on-write commit");
+		} else {
+			trie_t *old = trie_cow_rollback(cow, count_dropped, &dropped);
+			ok(old == trie && dropped == added - 1 &&
+			   trie_weight(trie) == inserted &&
+			   trie_get_try(trie, keys[0], strlen(keys[0]) + 1) != NULL,
+			   "trie: copy-on-write rollback");
+		}
+	}
+
 	/* Cleanup */
 	for (unsigned i = 0; i < key_count; ++i) {
 		free(keys[i]);
@@ -104,16 +104,26 @@ static void ctl_client(const char *socket, size_t argc, knot_ctl_data_t *argv)
 	knot_ctl_free(ctl);
 }
 
-static void ctl_server(const char *socket, size_t argc, knot_ctl_data_t *argv)
+static void ctl_server(const char *socket, size_t argc, knot_ctl_data_t *argv,
+                       bool separate)
 {
-	knot_ctl_t *ctl = knot_ctl_alloc();
-	ok(ctl != NULL, "Allocate control");
+	knot_ctl_t *listener = knot_ctl_alloc();
+	ok(listener != NULL, "Allocate control");
 
-	int ret = knot_ctl_bind(ctl, socket);
+	int ret = knot_ctl_bind(listener, socket);
 	is_int(KNOT_EOK, ret, "Bind control socket");
 
-	ret = knot_ctl_accept(ctl);
-	is_int(KNOT_EOK, ret, "Accept a connection");
+	knot_ctl_t *ctl = listener;
+	if (separate) {
+		ctl = knot_ctl_alloc();
+		ok(ctl != NULL, "Allocate client control");
+
+		ret = knot_ctl_accept_client(listener, ctl);
+		is_int(KNOT_EOK, ret, "Accept a connection to client control");
+	} else {
+		ret = knot_ctl_accept(ctl);
+		is_int(KNOT_EOK, ret, "Accept a connection");
+	}
 
 	diag("BEGIN: Server <- Client");
 
@@ -169,11 +179,14 @@ static void ctl_server(const char *socket, size_t argc, knot_ctl_data_t *argv)
 	diag("END: Server -> Client");
 
 	knot_ctl_close(ctl);
-	knot_ctl_unbind(ctl);
-	knot_ctl_free(ctl);
+	if (separate) {
+		knot_ctl_free(ctl);
+	}
+	knot_ctl_unbind(listener);
+	knot_ctl_free(listener);
 }
 
-static void test_client_server_client(void)
+static void test_client_server_client(bool separate)
 {
 	char *socket = test_mktemp();
 	ok(socket != NULL, "Make a temporary socket file '%s'", socket);
@@ -197,9 +210,9 @@ static void test_client_server_client(void)
 	if (child_pid == 0) {
 		ctl_client(socket, data_len, data);
 		free(socket);
-		return;
+		exit(EXIT_SUCCESS);
 	} else {
-		ctl_server(socket, data_len, data);
+		ctl_server(socket, data_len, data, separate);
 	}
 
 	int status = 0;
@@ -210,12 +223,41 @@ static void test_client_server_client(void)
 	free(socket);
 }
 
+static void test_accept_timeout(void)
+{
+	char *socket = test_mktemp();
+	ok(socket != NULL, "Make a temporary socket file '%s'", socket);
+
+	knot_ctl_t *listener = knot_ctl_alloc();
+	knot_ctl_t *ctl = knot_ctl_alloc();
+	ok(listener != NULL && ctl != NULL, "Allocate controls");
+
+	int ret = knot_ctl_bind(listener, socket);
+	is_int(KNOT_EOK, ret, "Bind control socket");
+
+	knot_ctl_set_timeout(listener, 10);
+	ret = knot_ctl_accept_client(listener, ctl);
+	is_int(KNOT_ETIMEOUT, ret, "Accept a connection with timeout");
+
+	knot_ctl_free(ctl);
+	knot_ctl_unbind(listener);
+	knot_ctl_free(listener);
+	test_rm_rf(socket);
+	free(socket);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
 
 	diag("Client -> Server -> Client");
-	test_client_server_client();
+	test_client_server_client(false);
+
+	diag("Client -> Server (client control) -> Client");
+	test_client_server_client(true);
+
+	diag("Server accept timeout");
+	test_accept_timeout();
 
 	return 0;
 }
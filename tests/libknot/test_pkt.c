@@ -187,6 +187,42 @@ int main(int argc, char *argv[])
 	/* Compare copied packet to original. */
 	packet_match(in, copy);
 
+	/*
+	 * Packet with copied wire format tests.
+	 */
+	knot_pkt_t *wired = knot_pkt_new(NULL, MM_DEFAULT_BLKSIZE, &mm);
+	knot_wire_set_qr(wired->wire);
+	ret = knot_pkt_put_question(wired, knot_pkt_qname(out), KNOT_CLASS_IN,
+	                            KNOT_RRTYPE_A);
+	is_int(KNOT_EOK, ret, "pkt: put question for wire");
+
+	/* Copy the sections of the written packet. */
+	knot_section_t sections[] = { KNOT_ANSWER, KNOT_AUTHORITY, KNOT_ADDITIONAL };
+	for (unsigned i = 0; i < 3 && ret == KNOT_EOK; ++i) {
+		const knot_pktsection_t *section = knot_pkt_section(out, sections[i]);
+		uint16_t begin = out->rr_info[section->pos].pos;
+		uint16_t end = (section->pos + section->count < out->rrset_count) ?
+		               out->rr_info[section->pos + section->count].pos : out->size;
+		ret = knot_pkt_begin(wired, sections[i]);
+		if (ret == KNOT_EOK) {
+			ret = knot_pkt_put_wire(wired, out->wire + begin, end - begin,
+			                        out->rr + section->pos,
+			                        out->rr_info + section->pos, section->count);
+		}
+	}
+	is_int(KNOT_EOK, ret, "pkt: put wire");
+	ok(wired->size == out->size && memcmp(wired->wire, out->wire, out->size) == 0,
+	   "pkt: wire match");
+	ok(wired->opt_rr == &wired->rr[NAMECOUNT], "pkt: OPT RR referenced");
+
+	/* Compare packet with copied wire to the written one. */
+	packet_match(out, wired);
+
+	ret = knot_pkt_put_wire(wired, out->wire, wired->max_size - wired->size + 1,
+	                        out->rr, out->rr_info, 1);
+	is_int(KNOT_ESPACE, ret, "pkt: put wire over limit");
+	knot_pkt_free(&wired);
+
 	/* Free packets. */
 	knot_pkt_free(&copy);
 	knot_pkt_free(&out);
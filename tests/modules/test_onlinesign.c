@@ -18,9 +18,12 @@
 #include <assert.h>
 
 #include "knot/modules/onlinesign/nsec_next.h"
+#include "knot/modules/onlinesign/sign_cache.h"
 #include "libknot/consts.h"
+#include "libknot/descriptor.h"
 #include "libknot/dname.h"
 #include "libknot/errcode.h"
+#include "libknot/rdataset.h"
 
 /*!
  * \brief Assert that a domain name in a static buffer is valid.
@@ -57,6 +60,59 @@ static void _test_nsec_next(const char *msg,
 	_test_nsec_next(msg, input, apex, expected); \
 }
 
+static void test_sign_cache(void)
+{
+	sign_cache_t *cache = sign_cache_new(4);
+	ok(cache != NULL, "sign_cache, create");
+
+	uint8_t data[] = { 1, 2, 3, 4 };
+	uint8_t rdata[knot_rdata_array_size(sizeof(data))];
+	knot_rdata_init(rdata, sizeof(data), data, 3600);
+	knot_rdataset_t rrs;
+	knot_rdataset_init(&rrs);
+	(void)knot_rdataset_add(&rrs, rdata, NULL);
+
+	sign_cache_key_t key = {
+		.owner = (const knot_dname_t *)"\x07""example""\x03""com",
+		.type = KNOT_RRTYPE_A,
+		.tag = 12345,
+		.data = data,
+		.data_len = sizeof(data)
+	};
+
+	ok(sign_cache_get(cache, &key, 100) == NULL, "sign_cache, empty");
+
+	int ret = sign_cache_put(cache, &key, &rrs, 200);
+	const knot_rdataset_t *found = sign_cache_get(cache, &key, 100);
+	ok(ret == KNOT_EOK && found != NULL && knot_rdataset_eq(found, &rrs),
+	   "sign_cache, hit");
+
+	ok(sign_cache_get(cache, &key, 200) == NULL, "sign_cache, expired");
+
+	sign_cache_key_t other = key;
+	other.data_len -= 1;
+	ok(sign_cache_get(cache, &other, 100) == NULL, "sign_cache, different data");
+	other = key;
+	other.tag += 1;
+	ok(sign_cache_get(cache, &other, 100) == NULL, "sign_cache, different tag");
+	other = key;
+	other.owner = (const knot_dname_t *)"\x03""com";
+	ok(sign_cache_get(cache, &other, 100) == NULL, "sign_cache, different owner");
+
+	// Fill all the slots, the first record is replaced eventually.
+	bool replaced = false;
+	for (uint32_t tag = 0; tag < 100 && !replaced; tag++) {
+		other = key;
+		other.tag = tag;
+		(void)sign_cache_put(cache, &other, &rrs, 200);
+		replaced = sign_cache_get(cache, &key, 100) == NULL;
+	}
+	ok(replaced, "sign_cache, bounded");
+
+	knot_rdataset_clear(&rrs, NULL);
+	sign_cache_free(cache);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -198,5 +254,7 @@ int main(int argc, char *argv[])
 		APEX
 	);
 
+	test_sign_cache();
+
 	return 0;
 }
@@ -14,6 +14,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
+#include <time.h>
 #include <tap/basic.h>
 
 #include "dnssec/crypto.h"
@@ -27,18 +29,8 @@
 #define RRL_SIZE 196613
 #define RRL_THREADS 8
 #define RRL_INSERTS (RRL_SIZE/(5*RRL_THREADS)) /* lf = 1/5 */
-#define RRL_LOCKS 64
-
-/* Disabled as default as it depends on random input.
- * Table may be consistent even if some collision occur (and they may occur).
- * Note: Disabled due to reported problems when running on VMs due to time
- * flow inconsistencies. Should work alright on a host machine.
- */
-#ifdef ENABLE_TIMED_TESTS
-struct bucketmap {
-	unsigned i;
-	uint64_t x;
-};
+#define RRL_STRESS_QUERIES 100000
+#define RRL_STRESS_CLIENTS 8192
 
 /*! \brief Unit runnable. */
 struct runnable_data {
@@ -47,6 +39,9 @@ struct runnable_data {
 	struct sockaddr_storage *addr;
 	rrl_req_t *rq;
 	knot_dname_t *zone;
+	uint32_t now;
+	unsigned hot_passed;
+	unsigned hot_total;
 };
 
 static void* rrl_runnable(void *arg)
@@ -54,24 +49,21 @@ static void* rrl_runnable(void *arg)
 	struct runnable_data *d = (struct runnable_data *)arg;
 	struct sockaddr_storage addr;
 	memcpy(&addr, d->addr, sizeof(struct sockaddr_storage));
-	int lock = -1;
-	uint32_t now = time(NULL);
-	struct bucketmap *m = malloc(RRL_INSERTS * sizeof(struct bucketmap));
+	struct sockaddr_in *ipv4 = (struct sockaddr_in *)&addr;
+	uint32_t *m = malloc(RRL_INSERTS * sizeof(uint32_t));
+	rrl_item_t **b = malloc(RRL_INSERTS * sizeof(rrl_item_t *));
 	for (unsigned i = 0; i < RRL_INSERTS; ++i) {
-		m[i].i = dnssec_random_uint32_t();
-		((struct sockaddr_in *) &addr)->sin_addr.s_addr = m[i].i;
-		rrl_item_t *b = rrl_hash(d->rrl, &addr, d->rq, d->zone, now, &lock);
-		rrl_unlock(d->rrl, lock);
-		m[i].x = b->netblk;
+		m[i] = dnssec_random_uint32_t();
+		ipv4->sin_addr.s_addr = m[i];
+		b[i] = rrl_hash(d->rrl, &addr, d->rq, d->zone, d->now);
 	}
 	for (unsigned i = 0; i < RRL_INSERTS; ++i) {
-		((struct sockaddr_in *) &addr)->sin_addr.s_addr = m[i].i;
-		rrl_item_t *b = rrl_hash(d->rrl, &addr, d->rq, d->zone, now, &lock);
-		rrl_unlock(d->rrl, lock);
-		if (b->netblk != m[i].x) {
-			d->passed = 0;
+		ipv4->sin_addr.s_addr = m[i];
+		if (rrl_hash(d->rrl, &addr, d->rq, d->zone, d->now) != b[i]) {
+			__sync_fetch_and_and(&d->passed, 0);
 		}
 	}
+	free(b);
 	free(m);
 	return NULL;
 }
@@ -79,6 +71,7 @@ static void* rrl_runnable(void *arg)
 static void rrl_hopscotch(struct runnable_data* rd)
 {
 	rd->passed = 1;
+	rd->now = time(NULL);
 	pthread_t thr[RRL_THREADS];
 	for (unsigned i = 0; i < RRL_THREADS; ++i) {
 		pthread_create(thr + i, NULL, &rrl_runnable, rd);
@@ -87,14 +80,66 @@ static void rrl_hopscotch(struct runnable_data* rd)
 		pthread_join(thr[i], NULL);
 	}
 }
-#endif
+
+/*! \brief Mixed traffic, every 4th query from a single (hot) client. */
+static void* rrl_stress_runnable(void *arg)
+{
+	struct runnable_data *d = (struct runnable_data *)arg;
+	struct sockaddr_storage addr;
+	memcpy(&addr, d->addr, sizeof(struct sockaddr_storage));
+	struct sockaddr_in *ipv4 = (struct sockaddr_in *)&addr;
+	unsigned passed = 0, total = 0;
+	for (unsigned i = 0; i < RRL_STRESS_QUERIES; ++i) {
+		if (i % 4 == 0) {
+			ipv4->sin_addr.s_addr = htonl(0x0a000000);
+			total += 1;
+			passed += (rrl_query(d->rrl, &addr, d->rq, d->zone, NULL) == KNOT_EOK);
+		} else {
+			uint32_t client = dnssec_random_uint16_t() % RRL_STRESS_CLIENTS + 1;
+			ipv4->sin_addr.s_addr = htonl(0x0a000000 | client << 8);
+			(void)rrl_query(d->rrl, &addr, d->rq, d->zone, NULL);
+		}
+	}
+	__sync_fetch_and_add(&d->hot_passed, passed);
+	__sync_fetch_and_add(&d->hot_total, total);
+	return NULL;
+}
+
+static void rrl_stress(struct runnable_data* rd)
+{
+	rrl_reseed(rd->rrl);
+	rd->hot_passed = 0;
+	rd->hot_total = 0;
+
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	pthread_t thr[RRL_THREADS];
+	for (unsigned i = 0; i < RRL_THREADS; ++i) {
+		pthread_create(thr + i, NULL, &rrl_stress_runnable, rd);
+	}
+	for (unsigned i = 0; i < RRL_THREADS; ++i) {
+		pthread_join(thr[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	/* No token may be lost or given twice, refill is at most rate per second. */
+	double elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+	uint32_t rate = rrl_rate(rd->rrl);
+	unsigned max_passed = rate * RRL_CAPACITY + rate * ((unsigned)elapsed + 1);
+	ok(rd->hot_passed >= rate * RRL_CAPACITY && rd->hot_passed <= max_passed,
+	   "rrl: stress %u threads, hot client passed %u of %u",
+	   RRL_THREADS, rd->hot_passed, rd->hot_total);
+
+	ok(1, "rrl: stress %u threads, %.0f queries/s", RRL_THREADS,
+	   RRL_THREADS * RRL_STRESS_QUERIES / elapsed);
+}
 
 int main(int argc, char *argv[])
 {
 #ifdef ENABLE_TIMED_TESTS
-	plan(10);
+	plan(11);
 #else
-	plan(5);
+	plan(9);
 #endif
 
 	dnssec_crypto_init();
@@ -134,11 +179,7 @@ int main(int argc, char *argv[])
 	rrl_setrate(rrl, rate);
 	is_int(rate, rrl_rate(rrl), "rrl: setrate");
 
-	/* 3. setlocks */
-	ret = rrl_setlocks(rrl, RRL_LOCKS);
-	is_int(KNOT_EOK, ret, "rrl: setlocks");
-
-	/* 4. N unlimited requests. */
+	/* 3. N unlimited requests. */
 	knot_dname_t *zone = knot_dname_from_str_alloc("rrl.");
 
 	struct sockaddr_storage addr;
@@ -156,42 +197,42 @@ int main(int argc, char *argv[])
 	is_int(0, ret, "rrl: unlimited IPv4/v6 requests");
 
 #ifdef ENABLE_TIMED_TESTS
-	/* 5. limited request */
+	/* 4. limited request */
 	ret = rrl_query(rrl, &addr, &rq, zone, NULL);
 	is_int(KNOT_ELIMIT, ret, "rrl: throttled IPv4 request");
 
-	/* 6. limited IPv6 request */
+	/* 5. limited IPv6 request */
 	ret = rrl_query(rrl, &addr6, &rq, zone, NULL);
 	is_int(KNOT_ELIMIT, ret, "rrl: throttled IPv6 request");
 #endif
 
-	/* 7. invalid values. */
+	/* 6. invalid values. */
 	ret = 0;
 	rrl_create(0);            // NULL
 	ret += rrl_setrate(0, 0); // 0
 	ret += rrl_rate(0);       // 0
-	ret += rrl_setlocks(0,0); // -1
 	ret += rrl_query(0, 0, 0, 0, NULL); // -1
 	ret += rrl_query(rrl, 0, 0, 0, NULL); // -1
 	ret += rrl_query(rrl, (void*)0x1, 0, 0, NULL); // -1
 	ret += rrl_destroy(0); // -1
-	is_int(-88, ret, "rrl: not crashed while executing functions on NULL context");
+	is_int(-66, ret, "rrl: not crashed while executing functions on NULL context");
 
-#ifdef ENABLE_TIMED_TESTS
-	/* 8. hopscotch test */
+	/* 7. hopscotch test */
 	struct runnable_data rd = {
 		1, rrl, &addr, &rq, zone
 	};
 	rrl_hopscotch(&rd);
 	ok(rd.passed, "rrl: hashtable is ~ consistent");
 
-	/* 9. reseed */
+	/* 8. reseed */
 	is_int(0, rrl_reseed(rrl), "rrl: reseed");
 
-	/* 10. hopscotch after reseed. */
+	/* 9. hopscotch after reseed. */
 	rrl_hopscotch(&rd);
 	ok(rd.passed, "rrl: hashtable is ~ consistent");
-#endif
+
+	/* 10. concurrent queries */
+	rrl_stress(&rd);
 
 	knot_dname_free(&zone, NULL);
 	knot_pkt_free(&query);
@@ -14,12 +14,19 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <tap/basic.h>
+#include <time.h>
 
 #include "test_conf.h"
 #include "libknot/libknot.h"
+#include "knot/conf/confio.h"
+#include "knot/conf/zones.h"
 #include "knot/updates/acl.h"
 #include "contrib/sockaddr.h"
 
@@ -28,6 +35,51 @@
 #define KEY2	"key2_md5"
 #define KEY3	"key3_sha256"
 
+#define BENCH_ACLS	100
+#define BENCH_ADDRS	100
+#define BENCH_LINEAR	20
+#define BENCH_COMPILED	1000000
+
+static const char *test_conf_str =
+	"key:\n"
+	"  - id: "KEY1"\n"
+	"    algorithm: hmac-md5\n"
+	"    secret: Zm9v\n"
+	"  - id: "KEY2"\n"
+	"    algorithm: hmac-md5\n"
+	"    secret: Zm9v\n"
+	"  - id: "KEY3"\n"
+	"    algorithm: hmac-sha256\n"
+	"    secret: Zm8=\n"
+	"\n"
+	"acl:\n"
+	"  - id: acl_key_addr\n"
+	"    address: [ 2001::1 ]\n"
+	"    key: [ key1_md5 ]\n"
+	"    action: [ transfer ]\n"
+	"  - id: acl_deny\n"
+	"    address: [ 240.0.0.2 ]\n"
+	"    action: [ notify ]\n"
+	"    deny: on\n"
+	"  - id: acl_no_action_deny\n"
+	"    address: [ 240.0.0.3 ]\n"
+	"    deny: on\n"
+	"  - id: acl_multi_addr\n"
+	"    address: [ 192.168.1.1, 240.0.0.0/24 ]\n"
+	"    action: [ notify, update ]\n"
+	"  - id: acl_multi_key\n"
+	"    key: [ key2_md5, key3_sha256 ]\n"
+	"    action: [ notify, update ]\n"
+	"  - id: acl_range_addr\n"
+	"    address: [ 100.0.0.0-100.0.0.5, ::0-::5 ]\n"
+	"    action: [ transfer ]\n"
+	"\n"
+	"zone:\n"
+	"  - domain: "ZONE"\n"
+	"    acl: [ acl_key_addr, acl_deny, acl_no_action_deny ]\n"
+	"    acl: [ acl_multi_addr, acl_multi_key ]\n"
+	"    acl: [ acl_range_addr ]";
+
 static void check_sockaddr_set(struct sockaddr_storage *ss, int family,
                                const char *straddr, int port)
 {
@@ -55,47 +107,7 @@ static void test_acl_allowed(void)
 	knot_tsig_key_t key2 = { DNSSEC_TSIG_HMAC_MD5,    key2_name };
 	knot_tsig_key_t key3 = { DNSSEC_TSIG_HMAC_SHA256, key3_name };
 
-	const char *conf_str =
-		"key:\n"
-		"  - id: "KEY1"\n"
-		"    algorithm: hmac-md5\n"
-		"    secret: Zm9v\n"
-		"  - id: "KEY2"\n"
-		"    algorithm: hmac-md5\n"
-		"    secret: Zm9v\n"
-		"  - id: "KEY3"\n"
-		"    algorithm: hmac-sha256\n"
-		"    secret: Zm8=\n"
-		"\n"
-		"acl:\n"
-		"  - id: acl_key_addr\n"
-		"    address: [ 2001::1 ]\n"
-		"    key: [ key1_md5 ]\n"
-		"    action: [ transfer ]\n"
-		"  - id: acl_deny\n"
-		"    address: [ 240.0.0.2 ]\n"
-		"    action: [ notify ]\n"
-		"    deny: on\n"
-		"  - id: acl_no_action_deny\n"
-		"    address: [ 240.0.0.3 ]\n"
-		"    deny: on\n"
-		"  - id: acl_multi_addr\n"
-		"    address: [ 192.168.1.1, 240.0.0.0/24 ]\n"
-		"    action: [ notify, update ]\n"
-		"  - id: acl_multi_key\n"
-		"    key: [ key2_md5, key3_sha256 ]\n"
-		"    action: [ notify, update ]\n"
-		"  - id: acl_range_addr\n"
-		"    address: [ 100.0.0.0-100.0.0.5, ::0-::5 ]\n"
-		"    action: [ transfer ]\n"
-		"\n"
-		"zone:\n"
-		"  - domain: "ZONE"\n"
-		"    acl: [ acl_key_addr, acl_deny, acl_no_action_deny ]\n"
-		"    acl: [ acl_multi_addr, acl_multi_key ]\n"
-		"    acl: [ acl_range_addr ]";
-
-	ret = test_conf(conf_str, NULL);
+	ret = test_conf(test_conf_str, NULL);
 	is_int(KNOT_EOK, ret, "Prepare configuration");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
@@ -182,13 +194,243 @@ static void test_acl_allowed(void)
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_TRANSFER, &addr, &key0);
 	ok(ret == true, "IPv6 address from range, no key, action match");
 
-	conf_free(conf());
+	conf_update(NULL, CONF_UPD_FNONE);
 	knot_dname_free(&zone_name, NULL);
 	knot_dname_free(&key1_name, NULL);
 	knot_dname_free(&key2_name, NULL);
 	knot_dname_free(&key3_name, NULL);
 }
 
+typedef struct {
+	int family;
+	const char *addr;
+	acl_action_t action;
+	int key;
+	bool result;
+} acl_case_t;
+
+static const acl_case_t acl_cases[] = {
+	{ AF_INET6, "2001::1",     ACL_ACTION_NONE,     1, true },
+	{ AF_INET6, "2001::1",     ACL_ACTION_TRANSFER, 1, true },
+	{ AF_INET6, "2001::2",     ACL_ACTION_TRANSFER, 1, false },
+	{ AF_INET6, "2001::1",     ACL_ACTION_TRANSFER, 0, false },
+	{ AF_INET6, "2001::1",     ACL_ACTION_TRANSFER, 2, false },
+	{ AF_INET6, "2001::1",     ACL_ACTION_NOTIFY,   1, false },
+	{ AF_INET,  "240.0.0.1",   ACL_ACTION_NOTIFY,   0, true },
+	{ AF_INET,  "240.0.0.1",   ACL_ACTION_NOTIFY,   1, false },
+	{ AF_INET,  "240.0.0.2",   ACL_ACTION_NOTIFY,   0, false },
+	{ AF_INET,  "240.0.0.2",   ACL_ACTION_UPDATE,   0, true },
+	{ AF_INET,  "240.0.0.3",   ACL_ACTION_UPDATE,   0, false },
+	{ AF_INET,  "240.0.0.3",   ACL_ACTION_NONE,     0, false },
+	{ AF_INET,  "240.0.1.1",   ACL_ACTION_NOTIFY,   0, false },
+	{ AF_INET,  "192.168.1.1", ACL_ACTION_UPDATE,   0, true },
+	{ AF_INET,  "192.168.1.2", ACL_ACTION_UPDATE,   0, false },
+	{ AF_INET,  "1.1.1.1",     ACL_ACTION_UPDATE,   3, true },
+	{ AF_INET,  "1.1.1.1",     ACL_ACTION_NOTIFY,   2, true },
+	{ AF_INET,  "1.1.1.1",     ACL_ACTION_TRANSFER, 2, false },
+	{ AF_INET,  "1.1.1.1",     ACL_ACTION_UPDATE,   4, false },
+	{ AF_INET,  "100.0.0.0",   ACL_ACTION_TRANSFER, 0, true },
+	{ AF_INET,  "100.0.0.1",   ACL_ACTION_TRANSFER, 0, true },
+	{ AF_INET,  "100.0.0.5",   ACL_ACTION_TRANSFER, 0, true },
+	{ AF_INET,  "100.0.0.6",   ACL_ACTION_TRANSFER, 0, false },
+	{ AF_INET,  "99.255.255.255", ACL_ACTION_TRANSFER, 0, false },
+	{ AF_INET6, "::",          ACL_ACTION_TRANSFER, 0, true },
+	{ AF_INET6, "::1",         ACL_ACTION_TRANSFER, 0, true },
+	{ AF_INET6, "::6",         ACL_ACTION_TRANSFER, 0, false },
+	{ AF_INET6, "::1",         ACL_ACTION_UPDATE,   0, false },
+	{ 0 }
+};
+
+static void test_acl_match(void)
+{
+	knot_dname_t *zone_name = knot_dname_from_str_alloc(ZONE);
+	knot_dname_t *key1_name = knot_dname_from_str_alloc(KEY1);
+	knot_dname_t *key2_name = knot_dname_from_str_alloc(KEY2);
+	knot_dname_t *key3_name = knot_dname_from_str_alloc(KEY3);
+
+	const knot_tsig_key_t keys[] = {
+		{ 0 },
+		{ DNSSEC_TSIG_HMAC_MD5,    key1_name },
+		{ DNSSEC_TSIG_HMAC_MD5,    key2_name },
+		{ DNSSEC_TSIG_HMAC_SHA256, key3_name },
+		{ DNSSEC_TSIG_HMAC_SHA256, key1_name }, // Algorithm mismatch.
+	};
+
+	int ret = test_conf(test_conf_str, NULL);
+	is_int(KNOT_EOK, ret, "Prepare configuration");
+
+	conf_val_t val = conf_zone_get(conf(), C_ACL, zone_name);
+	acl_t *acl = acl_compile(conf(), &val);
+	ok(acl != NULL, "Compile zone ACL");
+
+	for (const acl_case_t *c = acl_cases; c->addr != NULL; c++) {
+		struct sockaddr_storage addr = { 0 };
+		sockaddr_set(&addr, c->family, c->addr, 0);
+
+		knot_tsig_key_t key_ref = keys[c->key];
+		val = conf_zone_get(conf(), C_ACL, zone_name);
+		bool ref = acl_allowed(conf(), &val, c->action, &addr, &key_ref);
+
+		knot_tsig_key_t key = keys[c->key];
+		bool res = acl_match(acl, c->action, &addr, &key);
+		ok(res == c->result && ref == c->result,
+		   "Compiled ACL, address %s, key %i, action %i",
+		   c->addr, c->key, c->action);
+		if (res && key.name != NULL) {
+			ok(key.secret.size == key_ref.secret.size &&
+			   memcmp(key.secret.data, key_ref.secret.data, key.secret.size) == 0,
+			   "Compiled ACL, key secret");
+		}
+	}
+
+	acl_free(acl);
+
+	// Empty ACL.
+	val = conf_zone_get(conf(), C_ACL, key1_name);
+	acl = acl_compile(conf(), &val);
+	ok(acl != NULL, "Compile empty ACL");
+	struct sockaddr_storage addr = { 0 };
+	sockaddr_set(&addr, AF_INET, "1.1.1.1", 53);
+	knot_tsig_key_t key = keys[0];
+	ok(!acl_match(acl, ACL_ACTION_NONE, &addr, &key), "Empty ACL");
+	acl_free(acl);
+
+	conf_update(NULL, CONF_UPD_FNONE);
+	knot_dname_free(&zone_name, NULL);
+	knot_dname_free(&key1_name, NULL);
+	knot_dname_free(&key2_name, NULL);
+	knot_dname_free(&key3_name, NULL);
+}
+
+static void test_acl_update(void)
+{
+	knot_dname_t *zone_name = knot_dname_from_str_alloc(ZONE);
+
+	struct sockaddr_storage addr = { 0 };
+	sockaddr_set(&addr, AF_INET, "100.0.0.1", 0);
+	knot_tsig_key_t key = { 0 };
+
+	int ret = test_conf(test_conf_str, NULL);
+	is_int(KNOT_EOK, ret, "Prepare configuration");
+
+	// Compile the zone settings like the server does.
+	conf_t *new_conf = NULL;
+	ret = conf_clone(&new_conf);
+	is_int(KNOT_EOK, ret, "Clone configuration");
+	conf_update(new_conf, CONF_UPD_FZONES);
+
+	const acl_t *acl = conf_zone_acl(conf(), zone_name);
+	ok(acl != NULL && acl_match(acl, ACL_ACTION_TRANSFER, &addr, &key),
+	   "Compiled ACL allows");
+
+	// Change just the ACL section, no zone is marked.
+	ret = conf_io_begin(false);
+	is_int(KNOT_EOK, ret, "Begin configuration transaction");
+	ret = conf_io_set("acl", "deny", "acl_range_addr", "on");
+	is_int(KNOT_EOK, ret, "Set ACL deny");
+	ret = conf_io_commit(false);
+	is_int(KNOT_EOK, ret, "Commit configuration transaction");
+
+	// Reload the configuration like the server does.
+	new_conf = NULL;
+	ret = conf_clone(&new_conf);
+	is_int(KNOT_EOK, ret, "Clone configuration");
+	conf_t *old_conf = conf_update(new_conf, CONF_UPD_FNOFREE | CONF_UPD_FZONES);
+	conf_free(old_conf);
+
+	conf_val_t val = conf_zone_get(conf(), C_ACL, zone_name);
+	ok(!acl_allowed(conf(), &val, ACL_ACTION_TRANSFER, &addr, &key),
+	   "Updated ACL denies");
+	acl = conf_zone_acl(conf(), zone_name);
+	ok(acl != NULL && !acl_match(acl, ACL_ACTION_TRANSFER, &addr, &key),
+	   "Recompiled ACL denies");
+
+	conf_update(NULL, CONF_UPD_FNONE);
+	knot_dname_free(&zone_name, NULL);
+}
+
+static double elapsed_ns(const struct timespec *begin, unsigned count)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return ((end.tv_sec - begin->tv_sec) * 1e9 +
+	        (end.tv_nsec - begin->tv_nsec)) / count;
+}
+
+static void test_acl_bench(void)
+{
+	knot_dname_t *zone_name = knot_dname_from_str_alloc(ZONE);
+
+	// Every address is a separate rule, IPv4 and IPv6 alternately.
+	size_t size = 64 + BENCH_ACLS * (64 + BENCH_ADDRS * 32);
+	char *bench_conf = malloc(size);
+	char *pos = bench_conf;
+	pos += sprintf(pos, "acl:\n");
+	for (int i = 0; i < BENCH_ACLS; i++) {
+		pos += sprintf(pos, "  - id: a%i\n    action: transfer\n", i);
+		for (int j = 0; j < BENCH_ADDRS; j++) {
+			int n = i * BENCH_ADDRS + j;
+			if (n % 2 == 0) {
+				pos += sprintf(pos, "    address: 10.%i.%i.0/24\n",
+				               n / 256, n % 256);
+			} else {
+				pos += sprintf(pos, "    address: 2001:db8::%x\n", n);
+			}
+		}
+	}
+	pos += sprintf(pos, "zone:\n  - domain: "ZONE"\n");
+	for (int i = 0; i < BENCH_ACLS; i++) {
+		pos += sprintf(pos, "    acl: a%i\n", i);
+	}
+	assert(pos < bench_conf + size);
+
+	int ret = test_conf(bench_conf, NULL);
+	is_int(KNOT_EOK, ret, "Prepare %i ACL rules", BENCH_ACLS * BENCH_ADDRS);
+	free(bench_conf);
+
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	conf_val_t val = conf_zone_get(conf(), C_ACL, zone_name);
+	acl_t *acl = acl_compile(conf(), &val);
+	ok(acl != NULL, "Compile %i ACL rules", BENCH_ACLS * BENCH_ADDRS);
+	diag("compilation %.0f us", elapsed_ns(&begin, 1000));
+
+	// The last rules are the worst case for the linear evaluation.
+	struct sockaddr_storage addrs[3];
+	sockaddr_set(&addrs[0], AF_INET, "10.39.14.1", 53);
+	sockaddr_set(&addrs[1], AF_INET6, "2001:db8::270f", 53);
+	sockaddr_set(&addrs[2], AF_INET, "192.0.2.1", 53);
+	const bool results[] = { true, true, false };
+
+	knot_tsig_key_t key = { 0 };
+	bool equal = true;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int i = 0; i < BENCH_LINEAR; i++) {
+		val = conf_zone_get(conf(), C_ACL, zone_name);
+		equal &= acl_allowed(conf(), &val, ACL_ACTION_TRANSFER, &addrs[i % 3],
+		                     &key) == results[i % 3];
+	}
+	double linear = elapsed_ns(&begin, BENCH_LINEAR);
+	ok(equal, "Linear evaluation results");
+
+	equal = true;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int i = 0; i < BENCH_COMPILED; i++) {
+		equal &= acl_match(acl, ACL_ACTION_TRANSFER, &addrs[i % 3],
+		                   &key) == results[i % 3];
+	}
+	double compiled = elapsed_ns(&begin, BENCH_COMPILED);
+	ok(equal, "Compiled evaluation results");
+
+	diag("linear evaluation %.0f ns, compiled evaluation %.0f ns",
+	     linear, compiled);
+
+	acl_free(acl);
+	conf_update(NULL, CONF_UPD_FNONE);
+	knot_dname_free(&zone_name, NULL);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -196,5 +438,14 @@ int main(int argc, char *argv[])
 	diag("acl_allowed");
 	test_acl_allowed();
 
+	diag("acl_match");
+	test_acl_match();
+
+	diag("acl_update");
+	test_acl_update();
+
+	diag("acl_bench");
+	test_acl_bench();
+
 	return 0;
 }
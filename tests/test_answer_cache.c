@@ -0,0 +1,93 @@
+/*  Copyright (C) 2014 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <tap/basic.h>
+#include <string.h>
+
+#include "knot/nameserver/answer_cache.h"
+#include "libknot/descriptor.h"
+
+int main(void)
+{
+	plan_lazy();
+
+	ok(answer_cache_new(0, 1) == NULL, "disabled cache");
+
+	answer_cache_t *cache = answer_cache_new(100, 2);
+	ok(cache != NULL, "create cache");
+
+	const knot_dname_t *qname = (const knot_dname_t *)"\x03""www""\x07""example""\x03""com";
+	answer_cache_key_t key = {
+		.qname = qname,
+		.qname_size = knot_dname_size(qname),
+		.qtype = KNOT_RRTYPE_A,
+		.qclass = KNOT_CLASS_IN,
+		.max_size = 512,
+		.flags = 0
+	};
+
+	uint8_t wire[ANSWER_CACHE_WIRE_MAX] = { 0 };
+	uint8_t out[ANSWER_CACHE_WIRE_MAX] = { 0 };
+	memset(wire, 0xAB, sizeof(wire));
+
+	// lookup and store
+
+	uint32_t gen = answer_cache_gen(cache);
+	ok(answer_cache_get(cache, &key, gen, 0, out, sizeof(out)) == 0, "miss on empty cache");
+
+	answer_cache_put(cache, &key, gen, wire, 100);
+	ok(answer_cache_get(cache, &key, gen, 0, out, sizeof(out)) == 100 &&
+	   memcmp(out, wire, 100) == 0, "hit after store");
+	ok(answer_cache_get(cache, &key, gen, 0, out, 99) == 0, "miss on short buffer");
+	ok(answer_cache_get(cache, &key, gen, 3, out, sizeof(out)) == 100,
+	   "hit from other thread");
+
+	answer_cache_key_t other = key;
+	other.qtype = KNOT_RRTYPE_AAAA;
+	ok(answer_cache_get(cache, &other, gen, 0, out, sizeof(out)) == 0, "miss on other type");
+	other = key;
+	other.max_size = 1232;
+	ok(answer_cache_get(cache, &other, gen, 0, out, sizeof(out)) == 0, "miss on other payload size");
+	other = key;
+	other.flags = ANSWER_CACHE_EDNS | ANSWER_CACHE_DO;
+	ok(answer_cache_get(cache, &other, gen, 0, out, sizeof(out)) == 0, "miss on other flags");
+
+	answer_cache_put(cache, &other, gen, wire, ANSWER_CACHE_WIRE_MAX + 1);
+	ok(answer_cache_get(cache, &other, gen, 0, out, sizeof(out)) == 0, "oversized answer not stored");
+
+	// invalidation
+
+	answer_cache_invalidate(cache);
+	uint32_t new_gen = answer_cache_gen(cache);
+	ok(new_gen != gen, "generation bumped");
+	ok(answer_cache_get(cache, &key, new_gen, 0, out, sizeof(out)) == 0, "miss after invalidation");
+
+	answer_cache_put(cache, &key, gen, wire, 100);
+	ok(answer_cache_get(cache, &key, new_gen, 0, out, sizeof(out)) == 0, "stale answer not served");
+
+	// statistics
+
+	uint64_t hits = 0, misses = 0;
+	answer_cache_stats(cache, &hits, &misses);
+	ok(hits == 2 && misses == 8, "statistics");
+	answer_cache_stats(NULL, &hits, &misses);
+	ok(hits == 2 && misses == 8, "statistics of disabled cache");
+
+	answer_cache_free(cache);
+	answer_cache_free(NULL);
+
+	return 0;
+}
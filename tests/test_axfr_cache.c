@@ -0,0 +1,394 @@
+/*  Copyright (C) 2014 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <tap/basic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_conf.h"
+#include "contrib/mempattern.h"
+#include "contrib/sockaddr.h"
+#include "contrib/ucw/mempool.h"
+#include "knot/nameserver/axfr_cache.h"
+#include "knot/nameserver/process_query.h"
+#include "knot/nameserver/tsig_ctx.h"
+#include "knot/server/server.h"
+#include "libknot/libknot.h"
+
+#define ZONE_DNAME ((const uint8_t *)"\x04""test")
+#define ZONE_NODES 1500
+#define MAX_MSGS 64
+
+static const uint8_t SOA_RDATA[] = {
+	0x02, 'n', 's', 0x00,
+	0x04, 'm', 'a', 'i', 'l', 0x00,
+	0x00, 0x00, 0x00, 0x0a,
+	0x00, 0x00, 0x0e, 0x10,
+	0x00, 0x00, 0x0e, 0x10,
+	0x00, 0x00, 0x0e, 0x10,
+	0x00, 0x00, 0x0e, 0x10
+};
+
+static const char *CONF_STR =
+	"key:\n"
+	"  - id: key.\n"
+	"    algorithm: hmac-sha256\n"
+	"    secret: Zm9vYmFyZm9vYmFyZm9vYmFy\n"
+	"acl:\n"
+	"  - id: plain\n"
+	"    address: 127.0.0.1\n"
+	"    action: transfer\n"
+	"  - id: signed\n"
+	"    address: 127.0.0.1\n"
+	"    key: key.\n"
+	"    action: transfer\n"
+	"zone:\n"
+	"  - domain: test.\n"
+	"    acl: [ plain, signed ]\n";
+
+/*! \brief Messages of one outgoing transfer. */
+typedef struct {
+	size_t count;
+	uint8_t *wire[MAX_MSGS];
+	size_t size[MAX_MSGS];
+	bool done;       /*!< Transfer finished successfully. */
+	bool consistent; /*!< Answer sections match the wire. */
+	bool verified;   /*!< All messages are signed and valid. */
+} xfr_t;
+
+static void put_answer(knot_pkt_t *pkt, const knot_rrset_t *rr, int count)
+{
+	knot_pkt_clear_payload(pkt);
+	for (int i = 0; i < count; i++) {
+		knot_pkt_put(pkt, 0, &rr[i], 0);
+	}
+}
+
+static void test_cache(void)
+{
+	ok(axfr_cache_new(0, true) == NULL, "disabled cache");
+
+	knot_rrset_t rr[3];
+	knot_dname_t *owners[3];
+	for (int i = 0; i < 3; i++) {
+		char name[16];
+		(void)snprintf(name, sizeof(name), "a%i.test.", i);
+		owners[i] = knot_dname_from_str_alloc(name);
+		knot_rrset_init(&rr[i], owners[i], KNOT_RRTYPE_A, KNOT_CLASS_IN);
+		uint8_t addr[4] = { 192, 0, 2, i };
+		knot_rrset_add_rdata(&rr[i], addr, sizeof(addr), 3600, NULL);
+	}
+
+	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	knot_pkt_put_question(pkt, ZONE_DNAME, KNOT_CLASS_IN, KNOT_RRTYPE_AXFR);
+	size_t answer = pkt->size;
+
+	// Room for the three RR sets, but not for one more.
+	size_t rr_size = sizeof(knot_rrset_t) + sizeof(knot_rrinfo_t);
+	put_answer(pkt, rr, 3);
+	size_t limit = pkt->size - answer + 3 * rr_size;
+
+	axfr_cache_t *cache = axfr_cache_new(limit, true);
+	ok(cache != NULL, "create cache");
+
+	// render and share
+
+	uint32_t gen = axfr_cache_gen(cache);
+	axfr_stream_t *stream = NULL;
+	ok(axfr_cache_get(cache, gen, &stream) == KNOT_ENOENT && stream != NULL,
+	   "render on empty cache");
+	axfr_stream_t *other = NULL;
+	ok(axfr_cache_get(cache, gen, &other) == KNOT_EBUSY && other == NULL,
+	   "don't wait for rendering");
+
+	put_answer(pkt, rr, 2);
+	int ret = axfr_stream_add(stream, pkt);
+	size_t first_len = pkt->size - answer;
+	uint8_t first[128];
+	memcpy(first, pkt->wire + answer, first_len);
+	put_answer(pkt, rr + 2, 1);
+	ok(ret == KNOT_EOK && axfr_stream_add(stream, pkt) == KNOT_EOK, "add messages");
+	ok(axfr_stream_add(stream, pkt) == KNOT_ELIMIT, "size limit");
+	ok(stream->count == 2 && stream->rr_count == 3 &&
+	   stream->msgs[0].len == first_len && stream->msgs[0].rr_count == 2 &&
+	   stream->msgs[1].offset == first_len && stream->msgs[1].rr_pos == 2 &&
+	   stream->msgs[1].rr_count == 1 && stream->rr[2].owner == owners[2] &&
+	   stream->rr_info[2].pos == answer, "stream layout");
+	axfr_cache_put(cache, stream);
+
+	axfr_stream_t *shared = NULL;
+	ok(axfr_cache_get(cache, gen, &shared) == KNOT_EOK && shared == stream &&
+	   stream->refs == 2, "share rendered stream");
+	axfr_cache_release(cache, shared);
+	axfr_cache_release(cache, stream);
+
+	ok(axfr_cache_get(cache, gen, &shared) == KNOT_EOK && shared == stream &&
+	   memcmp(shared->data, first, first_len) == 0, "keep released stream");
+
+	// invalidate
+
+	axfr_cache_invalidate(cache);
+	ok(axfr_cache_get(cache, gen, &stream) == KNOT_ENOTSUP, "stale generation");
+	axfr_cache_release(cache, shared);
+
+	gen = axfr_cache_gen(cache);
+	ok(axfr_cache_get(cache, gen, &stream) == KNOT_ENOENT, "render after invalidate");
+	axfr_cache_abort(cache, stream);
+	ok(axfr_cache_get(cache, gen, &stream) == KNOT_ENOTSUP, "no retry after failure");
+
+	uint64_t hits = 0, misses = 0;
+	axfr_cache_stats(cache, &hits, &misses);
+	ok(hits == 2 && misses == 3, "statistics");
+
+	axfr_cache_free(cache);
+
+	// drop when not kept
+
+	cache = axfr_cache_new(limit, false);
+	gen = axfr_cache_gen(cache);
+	ok(axfr_cache_get(cache, gen, &stream) == KNOT_ENOENT &&
+	   axfr_stream_add(stream, pkt) == KNOT_EOK, "render stream");
+	axfr_cache_put(cache, stream);
+	axfr_cache_release(cache, stream);
+	ok(axfr_cache_get(cache, gen, &stream) == KNOT_ENOENT, "dropped unused stream");
+	axfr_cache_abort(cache, stream);
+
+	axfr_cache_free(cache);
+
+	knot_pkt_free(&pkt);
+	for (int i = 0; i < 3; i++) {
+		knot_rdataset_clear(&rr[i].rrs, NULL);
+		knot_dname_free(&owners[i], NULL);
+	}
+}
+
+static zone_t *create_zone(void)
+{
+	zone_t *zone = zone_new(ZONE_DNAME);
+	zone->contents = zone_contents_new(zone->name, true);
+
+	knot_rrset_t rr;
+	knot_rrset_init(&rr, zone->name, KNOT_RRTYPE_SOA, KNOT_CLASS_IN);
+	knot_rrset_add_rdata(&rr, SOA_RDATA, sizeof(SOA_RDATA), 3600, NULL);
+	zone_node_t *node = NULL;
+	int ret = zone_contents_add_rr(zone->contents, &rr, &node);
+	knot_rdataset_clear(&rr.rrs, NULL);
+
+	// Enough TXT records for several messages.
+	uint8_t txt[201] = { 200 };
+	memset(txt + 1, 'x', 200);
+	for (int i = 0; i < ZONE_NODES && ret == KNOT_EOK; i++) {
+		char name[32];
+		(void)snprintf(name, sizeof(name), "n%i.test.", i);
+		knot_dname_t *owner = knot_dname_from_str_alloc(name);
+		knot_rrset_init(&rr, owner, KNOT_RRTYPE_TXT, KNOT_CLASS_IN);
+		knot_rrset_add_rdata(&rr, txt, sizeof(txt), 3600, NULL);
+		node = NULL;
+		ret = zone_contents_add_rr(zone->contents, &rr, &node);
+		knot_rdataset_clear(&rr.rrs, NULL);
+		knot_dname_free(&owner, NULL);
+	}
+
+	if (ret != KNOT_EOK || zone_contents_adjust_full(zone->contents) != KNOT_EOK) {
+		zone_free(&zone);
+	}
+
+	return zone;
+}
+
+/*! \brief Checks that the answer section structures describe the wire. */
+static bool answer_consistent(const knot_pkt_t *pkt)
+{
+	const knot_pktsection_t *answer = knot_pkt_section(pkt, KNOT_ANSWER);
+	if (answer->count == 0 ||
+	    knot_pkt_rr_offset(answer, 0) != KNOT_WIRE_HEADER_SIZE + knot_pkt_question_size(pkt)) {
+		return false;
+	}
+
+	uint16_t count = 0;
+	for (uint16_t i = 0; i < answer->count; i++) {
+		count += knot_pkt_rr(answer, i)->rrs.rr_count;
+	}
+
+	return count == knot_wire_get_ancount(pkt->wire);
+}
+
+static void transfer(server_t *server, uint16_t id, uint16_t qtype,
+                     const knot_tsig_key_t *key, xfr_t *xfr)
+{
+	knot_mm_t mm;
+	mm_ctx_mempool(&mm, MM_DEFAULT_BLKSIZE);
+	knot_layer_t layer;
+	knot_layer_init(&layer, &mm, process_query_layer());
+
+	struct sockaddr_storage ss;
+	sockaddr_set(&ss, AF_INET, "127.0.0.1", 53);
+	knotd_qdata_params_t params = {
+		.remote = &ss,
+		.server = server
+	};
+	knot_layer_begin(&layer, &params);
+
+	knot_pkt_t *query = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	knot_wire_set_id(query->wire, id);
+	knot_pkt_put_question(query, ZONE_DNAME, KNOT_CLASS_IN, qtype);
+	knot_rrset_t soa;
+	knot_rrset_init(&soa, (knot_dname_t *)ZONE_DNAME, KNOT_RRTYPE_SOA, KNOT_CLASS_IN);
+	knot_rrset_add_rdata(&soa, SOA_RDATA, sizeof(SOA_RDATA), 3600, NULL);
+	knot_soa_serial_set(&soa.rrs, 1);
+	if (qtype == KNOT_RRTYPE_IXFR) {
+		knot_pkt_begin(query, KNOT_AUTHORITY);
+		knot_pkt_put(query, KNOT_COMPR_HINT_QNAME, &soa, 0);
+	}
+
+	tsig_ctx_t tsig;
+	tsig_init(&tsig, key);
+	tsig_sign_packet(&tsig, query);
+	knot_pkt_parse(query, 0);
+	knot_layer_consume(&layer, query);
+
+	memset(xfr, 0, sizeof(*xfr));
+	xfr->consistent = true;
+	xfr->verified = true;
+	while (layer.state == KNOT_STATE_PRODUCE && xfr->count < MAX_MSGS) {
+		knot_pkt_t *answer = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, &mm);
+		knot_layer_produce(&layer, answer);
+		xfr->consistent = xfr->consistent && answer_consistent(answer);
+
+		uint8_t *wire = malloc(answer->size);
+		memcpy(wire, answer->wire, answer->size);
+		xfr->wire[xfr->count] = wire;
+		xfr->size[xfr->count++] = answer->size;
+
+		if (key != NULL) {
+			knot_pkt_t *copy = knot_pkt_new(NULL, answer->size, NULL);
+			memcpy(copy->wire, wire, answer->size);
+			copy->size = answer->size;
+			xfr->verified = xfr->verified &&
+			                knot_pkt_parse(copy, 0) == KNOT_EOK &&
+			                copy->tsig_rr != NULL &&
+			                tsig_verify_packet(&tsig, copy) == KNOT_EOK;
+			knot_pkt_free(&copy);
+		}
+		knot_pkt_free(&answer);
+	}
+	xfr->done = (layer.state == KNOT_STATE_DONE);
+
+	knot_layer_finish(&layer);
+	tsig_cleanup(&tsig);
+	knot_rdataset_clear(&soa.rrs, NULL);
+	knot_pkt_free(&query);
+	mp_delete(mm.ctx);
+}
+
+static void xfr_clear(xfr_t *xfr)
+{
+	for (size_t i = 0; i < xfr->count; i++) {
+		free(xfr->wire[i]);
+	}
+	xfr->count = 0;
+}
+
+/*! \brief Compares the transfers apart from the message ID. */
+static bool xfr_equal(const xfr_t *xfr1, const xfr_t *xfr2)
+{
+	if (xfr1->count != xfr2->count) {
+		return false;
+	}
+
+	for (size_t i = 0; i < xfr1->count; i++) {
+		if (xfr1->size[i] != xfr2->size[i] ||
+		    memcmp(xfr1->wire[i] + 2, xfr2->wire[i] + 2, xfr1->size[i] - 2) != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void test_transfers(void)
+{
+	int ret = test_conf(CONF_STR, NULL);
+	is_int(KNOT_EOK, ret, "load configuration");
+
+	server_t server;
+	ret = server_init(&server, 1);
+	is_int(KNOT_EOK, ret, "initialize server");
+
+	zone_t *zone = create_zone();
+	ok(zone != NULL, "create zone");
+	knot_zonedb_free(&server.zone_db);
+	server.zone_db = knot_zonedb_new(1);
+	knot_zonedb_insert(server.zone_db, zone);
+
+	// tree walk
+
+	xfr_t walk, walk_ixfr, xfr;
+	transfer(&server, 1, KNOT_RRTYPE_AXFR, NULL, &walk);
+	ok(walk.done && walk.consistent && walk.count > 1, "AXFR walk, %zu messages",
+	   walk.count);
+	transfer(&server, 2, KNOT_RRTYPE_IXFR, NULL, &walk_ixfr);
+	ok(walk_ixfr.done && walk_ixfr.consistent && walk_ixfr.count == walk.count,
+	   "IXFR fallback to AXFR walk");
+
+	// replay
+
+	zone->axfr_cache = axfr_cache_new(16 * 1024 * 1024, true);
+	ok(zone->axfr_cache != NULL, "enable AXFR cache");
+
+	transfer(&server, 3, KNOT_RRTYPE_AXFR, NULL, &xfr);
+	ok(xfr.done && xfr.consistent && xfr_equal(&walk, &xfr),
+	   "rendered AXFR equal to walk");
+	xfr_clear(&xfr);
+
+	transfer(&server, 4, KNOT_RRTYPE_AXFR, NULL, &xfr);
+	ok(xfr.done && xfr.consistent && xfr_equal(&walk, &xfr),
+	   "replayed AXFR equal to walk");
+	xfr_clear(&xfr);
+
+	transfer(&server, 5, KNOT_RRTYPE_IXFR, NULL, &xfr);
+	ok(xfr.done && xfr.consistent && xfr_equal(&walk_ixfr, &xfr),
+	   "replayed IXFR fallback equal to walk");
+	xfr_clear(&xfr);
+
+	knot_tsig_key_t key;
+	knot_tsig_key_init(&key, "hmac-sha256", "key.", "Zm9vYmFyZm9vYmFyZm9vYmFy");
+	transfer(&server, 6, KNOT_RRTYPE_AXFR, &key, &xfr);
+	ok(xfr.done && xfr.consistent && xfr.verified && xfr.count == walk.count,
+	   "replayed AXFR signed");
+	xfr_clear(&xfr);
+	knot_tsig_key_deinit(&key);
+
+	uint64_t hits = 0, misses = 0;
+	axfr_cache_stats(zone->axfr_cache, &hits, &misses);
+	ok(hits == 3 && misses == 1, "AXFR cache statistics");
+
+	xfr_clear(&walk);
+	xfr_clear(&walk_ixfr);
+	server_deinit(&server);
+	conf_free(conf());
+}
+
+int main(void)
+{
+	plan_lazy();
+
+	test_cache();
+
+	test_transfers();
+
+	return 0;
+}
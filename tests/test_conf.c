@@ -17,6 +17,8 @@
 #include <tap/basic.h>
 
 #include "knot/conf/conf.c"
+#include "knot/conf/confio.h"
+#include "knot/conf/zones.h"
 #include "test_conf.h"
 
 #define ZONE_ARPA	"0/25.2.0.192.in-addr.arpa."
@@ -196,6 +198,121 @@ static void test_conf_zonefile(void)
 	knot_dname_free(&zone_unknown, NULL);
 }
 
+static void test_conf_zones(void)
+{
+	knot_dname_t *zone_1label = knot_dname_from_str_alloc(ZONE_1LABEL);
+	knot_dname_t *zone_3label = knot_dname_from_str_alloc(ZONE_3LABEL);
+	knot_dname_t *zone_unknown = knot_dname_from_str_alloc(ZONE_UNKNOWN);
+
+	const char *conf_str =
+		"remote:\n"
+		"  - id: master\n"
+		"    address: 127.0.0.1\n"
+		"\n"
+		"template:\n"
+		"  - id: default\n"
+		"    disable-any: on\n"
+		"    zonefile-sync: 10\n"
+		"  - id: tpl\n"
+		"    serial-policy: unixtime\n"
+		"\n"
+		"zone:\n"
+		"  - domain: "ZONE_1LABEL"\n"
+		"    master: master\n"
+		"    zonefile-sync: -1\n"
+		"  - domain: "ZONE_3LABEL"\n"
+		"    template: tpl\n";
+
+	int ret = test_conf(conf_str, NULL);
+	is_int(KNOT_EOK, ret, "Prepare configuration");
+
+	// Settings resolved from the database.
+	conf_zone_t zconf = conf_zone(conf(), zone_1label);
+	ok(zconf.is_slave && zconf.disable_any && zconf.zonefile_sync == -1,
+	   "Resolve settings without compiled table");
+
+	// Compile all zones.
+	conf_zones_t *zones = conf_zones_compile(conf(), NULL, NULL);
+	ok(zones != NULL, "Compile zone settings");
+	is_int(2, conf_zones_count(zones), "Compiled zones count");
+
+	// Recompile changed zones, the unknown one is skipped.
+	trie_t *changed = trie_create(NULL);
+	*trie_get_ins(changed, (const char *)zone_3label, knot_dname_size(zone_3label)) = NULL;
+	*trie_get_ins(changed, (const char *)zone_unknown, knot_dname_size(zone_unknown)) = NULL;
+	conf_zones_t *updated = conf_zones_compile(conf(), zones, changed);
+	ok(updated != NULL, "Compile changed zone settings");
+	is_int(2, conf_zones_count(updated), "Compiled zones count");
+	trie_free(changed);
+	conf_zones_release(updated);
+	conf_zones_release(zones);
+
+	// Compile on configuration update.
+	conf_t *new_conf = NULL;
+	ret = conf_clone(&new_conf);
+	is_int(KNOT_EOK, ret, "Clone configuration");
+	conf_update(new_conf, CONF_UPD_FZONES);
+	is_int(2, conf_zones_count(conf()->zones), "Compiled zones on update");
+
+	zconf = conf_zone(conf(), zone_1label);
+	ok(zconf.is_slave && zconf.disable_any && zconf.zonefile_sync == -1 &&
+	   zconf.serial_policy == SERIAL_POLICY_INCREMENT,
+	   "Compiled explicit zone values");
+
+	zconf = conf_zone(conf(), zone_3label);
+	ok(!zconf.is_slave && !zconf.disable_any && zconf.zonefile_sync == 0 &&
+	   zconf.serial_policy == SERIAL_POLICY_UNIXTIME,
+	   "Compiled template values");
+
+	zconf = conf_zone(conf(), zone_unknown);
+	ok(!zconf.is_slave && zconf.disable_any && zconf.zonefile_sync == 10 &&
+	   zconf.serial_policy == SERIAL_POLICY_INCREMENT,
+	   "Default template values for unknown zone");
+
+	// Clones share the compiled settings.
+	conf_t *clone = NULL;
+	ret = conf_clone(&clone);
+	is_int(KNOT_EOK, ret, "Clone configuration");
+	ok(clone->zones == conf()->zones, "Shared compiled settings");
+	conf_free(clone);
+
+	// Change template items and a zone template, reload like the server.
+	ret = conf_io_begin(false);
+	is_int(KNOT_EOK, ret, "Begin configuration transaction");
+	ret = conf_io_set("template", "disable-any", "default", "off");
+	is_int(KNOT_EOK, ret, "Set template item");
+	ret = conf_io_set("template", "zonefile-sync", "tpl", "20");
+	is_int(KNOT_EOK, ret, "Set template item");
+	ret = conf_io_set("zone", "template", ZONE_1LABEL, "tpl");
+	is_int(KNOT_EOK, ret, "Set zone template");
+	ret = conf_io_commit(false);
+	is_int(KNOT_EOK, ret, "Commit configuration transaction");
+
+	new_conf = NULL;
+	ret = conf_clone(&new_conf);
+	is_int(KNOT_EOK, ret, "Clone configuration");
+	conf_t *old_conf = conf_update(new_conf, CONF_UPD_FNOFREE | CONF_UPD_FZONES);
+	conf_free(old_conf);
+
+	zconf = conf_zone(conf(), zone_1label);
+	ok(zconf.is_slave && !zconf.disable_any && zconf.zonefile_sync == -1 &&
+	   zconf.serial_policy == SERIAL_POLICY_UNIXTIME,
+	   "Recompiled zone template change");
+
+	zconf = conf_zone(conf(), zone_3label);
+	ok(zconf.zonefile_sync == 20 && zconf.serial_policy == SERIAL_POLICY_UNIXTIME,
+	   "Recompiled template change");
+
+	zconf = conf_zone(conf(), zone_unknown);
+	ok(!zconf.disable_any && zconf.zonefile_sync == 10,
+	   "Default template change for unknown zone");
+
+	conf_update(NULL, CONF_UPD_FNONE);
+	knot_dname_free(&zone_1label, NULL);
+	knot_dname_free(&zone_3label, NULL);
+	knot_dname_free(&zone_unknown, NULL);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -203,6 +320,9 @@ int main(int argc, char *argv[])
 	diag("get_filename");
 	test_get_filename();
 
+	diag("conf_zone");
+	test_conf_zones();
+
 	diag("conf_zonefile");
 	test_conf_zonefile();
 
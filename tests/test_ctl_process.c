@@ -0,0 +1,320 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <urcu.h>
+#include <tap/basic.h>
+#include <tap/files.h>
+
+#include "test_conf.h"
+#include "knot/ctl/process.h"
+#include "knot/server/server.h"
+#include "knot/zone/zonedb.h"
+#include "libknot/libknot.h"
+
+#define ZONES	4
+#define NODES	5000	/*!< Enough output to fill the socket buffers. */
+#define WORKERS	2
+
+static server_t server;
+static knot_ctl_t *listener;
+static char socket_path[1024];
+
+static zone_t *create_zone(unsigned idx)
+{
+	char name_str[KNOT_DNAME_TXT_MAXLEN + 1];
+	(void)snprintf(name_str, sizeof(name_str), "z%u.", idx);
+
+	knot_dname_t *name = knot_dname_from_str_alloc(name_str);
+	zone_t *zone = zone_new(name);
+	knot_dname_free(&name, NULL);
+	if (zone == NULL) {
+		return NULL;
+	}
+	zone->journal_db = &server.journal_db;
+	zone->contents = zone_contents_new(zone->name, true);
+
+	static const uint8_t SOA_RDATA[] = {
+		0x02, 'n', 's', 0x00,
+		0x04, 'm', 'a', 'i', 'l', 0x00,
+		0x00, 0x00, 0x00, 0x01,
+		0x00, 0x00, 0x0e, 0x10,
+		0x00, 0x00, 0x0e, 0x10,
+		0x00, 0x00, 0x0e, 0x10,
+		0x00, 0x00, 0x0e, 0x10
+	};
+
+	knot_rrset_t soa;
+	knot_rrset_init(&soa, zone->name, KNOT_RRTYPE_SOA, KNOT_CLASS_IN);
+	knot_rrset_add_rdata(&soa, SOA_RDATA, sizeof(SOA_RDATA), 3600, NULL);
+	zone_node_t *node = NULL;
+	int ret = zone_contents_add_rr(zone->contents, &soa, &node);
+	knot_rdataset_clear(&soa.rrs, NULL);
+
+	for (unsigned i = 0; i < NODES && ret == KNOT_EOK; i++) {
+		uint8_t owner[KNOT_DNAME_MAXLEN];
+		(void)snprintf(name_str, sizeof(name_str), "n%u.z%u.", i, idx);
+		knot_dname_from_str(owner, name_str, sizeof(owner));
+
+		uint8_t addr[4] = { 192, 0, i / 256, i % 256 };
+		knot_rrset_t a;
+		knot_rrset_init(&a, owner, KNOT_RRTYPE_A, KNOT_CLASS_IN);
+		knot_rrset_add_rdata(&a, addr, sizeof(addr), 3600, NULL);
+		node = NULL;
+		ret = zone_contents_add_rr(zone->contents, &a, &node);
+		knot_rdataset_clear(&a.rrs, NULL);
+	}
+
+	if (ret != KNOT_EOK || zone_contents_adjust_full(zone->contents) != KNOT_EOK) {
+		zone_free(&zone);
+		return NULL;
+	}
+
+	return zone;
+}
+
+static knot_zonedb_t *create_zonedb(void)
+{
+	knot_zonedb_t *db = knot_zonedb_new(ZONES);
+	for (unsigned i = 0; i < ZONES; i++) {
+		zone_t *zone = create_zone(i);
+		if (zone == NULL || knot_zonedb_insert(db, zone) != KNOT_EOK) {
+			zone_free(&zone);
+			knot_zonedb_deep_free(&db);
+			return NULL;
+		}
+	}
+
+	return db;
+}
+
+static void *ctl_worker(void *arg)
+{
+	(void)arg;
+	rcu_register_thread();
+
+	knot_ctl_t *ctl = knot_ctl_alloc();
+	knot_ctl_set_timeout(ctl, 0);
+	if (knot_ctl_accept_client(listener, ctl) == KNOT_EOK) {
+		(void)ctl_process(ctl, &server);
+		knot_ctl_close(ctl);
+	}
+	knot_ctl_free(ctl);
+
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static knot_ctl_t *ctl_client(void)
+{
+	knot_ctl_t *ctl = knot_ctl_alloc();
+	if (knot_ctl_connect(ctl, socket_path) != KNOT_EOK) {
+		knot_ctl_free(ctl);
+		return NULL;
+	}
+
+	return ctl;
+}
+
+static int ctl_cmd(knot_ctl_t *ctl, const char *cmd, const char *zone,
+                   const char *filter)
+{
+	knot_ctl_data_t data = {
+		[KNOT_CTL_IDX_CMD] = cmd,
+		[KNOT_CTL_IDX_ZONE] = zone,
+		[KNOT_CTL_IDX_FILTER] = filter
+	};
+
+	int ret = knot_ctl_send(ctl, KNOT_CTL_TYPE_DATA, &data);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	return knot_ctl_send(ctl, KNOT_CTL_TYPE_BLOCK, NULL);
+}
+
+/*! Receives a reply block, counts its data units and keeps the last value. */
+static int ctl_reply(knot_ctl_t *ctl, size_t *count, char *last, size_t last_len)
+{
+	*count = 0;
+
+	while (true) {
+		knot_ctl_type_t type;
+		knot_ctl_data_t data;
+		int ret = knot_ctl_receive(ctl, &type, &data);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		switch (type) {
+		case KNOT_CTL_TYPE_DATA:
+		case KNOT_CTL_TYPE_EXTRA:
+			if (data[KNOT_CTL_IDX_ERROR] != NULL) {
+				return KNOT_ERROR;
+			}
+			if (data[KNOT_CTL_IDX_DATA] != NULL && last != NULL) {
+				(void)snprintf(last, last_len, "%s", data[KNOT_CTL_IDX_DATA]);
+			}
+			(*count)++;
+			break;
+		case KNOT_CTL_TYPE_BLOCK:
+			return KNOT_EOK;
+		default:
+			return KNOT_EMALF;
+		}
+	}
+}
+
+typedef struct {
+	sem_t done;
+	knot_zonedb_t *db;
+} swap_t;
+
+static void *swap_zonedb(void *arg)
+{
+	swap_t *swap = arg;
+	rcu_register_thread();
+
+	knot_zonedb_t *old = rcu_xchg_pointer(&server.zone_db, swap->db);
+	synchronize_rcu();
+	knot_zonedb_deep_free(&old);
+
+	rcu_unregister_thread();
+	sem_post(&swap->done);
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	pthread_t workers[WORKERS];
+	for (int i = 0; i < WORKERS; i++) {
+		pthread_create(&workers[i], NULL, ctl_worker, NULL);
+	}
+
+	// Start a zone-read and don't receive its output.
+	knot_ctl_t *reader = ctl_client();
+	ok(reader != NULL, "connect reader");
+	int ret = ctl_cmd(reader, "zone-read", NULL, NULL);
+	is_int(KNOT_EOK, ret, "send zone-read");
+	sleep(1);
+
+	// Run exclusive commands meanwhile.
+	knot_ctl_t *writer = ctl_client();
+	ok(writer != NULL, "connect writer");
+
+	size_t count;
+	char value[64] = "";
+	ret = ctl_cmd(writer, "zone-begin", "z1.", NULL);
+	if (ret == KNOT_EOK) {
+		ret = ctl_reply(writer, &count, NULL, 0);
+	}
+	is_int(KNOT_EOK, ret, "zone-begin during a stalled zone-read");
+
+	ret = ctl_cmd(writer, "zone-status", "z1.", "t");
+	if (ret == KNOT_EOK) {
+		ret = ctl_reply(writer, &count, value, sizeof(value));
+	}
+	ok(ret == KNOT_EOK && strcmp(value, "open") == 0,
+	   "zone-status during a stalled zone-read");
+
+	ret = ctl_cmd(writer, "zone-abort", "z1.", NULL);
+	if (ret == KNOT_EOK) {
+		ret = ctl_reply(writer, &count, NULL, 0);
+	}
+	is_int(KNOT_EOK, ret, "zone-abort during a stalled zone-read");
+
+	// Replace the zone database, the stalled reader mustn't block it.
+	swap_t swap = { .db = create_zonedb() };
+	ok(swap.db != NULL, "create new zone database");
+	sem_init(&swap.done, 0, 0);
+	pthread_t swapper;
+	pthread_create(&swapper, NULL, swap_zonedb, &swap);
+
+	struct timespec timeout;
+	clock_gettime(CLOCK_REALTIME, &timeout);
+	timeout.tv_sec += 5;
+	ret = sem_timedwait(&swap.done, &timeout);
+	ok(ret == 0, "zone database replaced during a stalled zone-read");
+	if (ret != 0) {
+		// Don't hang on a reader holding the RCU read lock.
+		exit(1);
+	}
+	pthread_join(swapper, NULL);
+	sem_destroy(&swap.done);
+
+	// The read continues in the new database without gaps or duplicates.
+	ret = ctl_reply(reader, &count, NULL, 0);
+	is_int(KNOT_EOK, ret, "receive zone-read");
+	is_int(ZONES * (NODES + 1), count, "complete zone-read");
+
+	knot_ctl_send(writer, KNOT_CTL_TYPE_END, NULL);
+	knot_ctl_send(reader, KNOT_CTL_TYPE_END, NULL);
+	for (int i = 0; i < WORKERS; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	knot_ctl_close(writer);
+	knot_ctl_free(writer);
+	knot_ctl_close(reader);
+	knot_ctl_free(reader);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	rcu_register_thread();
+
+	char *dir = test_mkdtemp();
+	ok(dir != NULL, "make temporary directory");
+	(void)snprintf(socket_path, sizeof(socket_path), "%s/knot.sock", dir);
+
+	int ret = test_conf("server:\n"
+	                    "template:\n  - id: default\n    zonefile-sync: -1\n"
+	                    "zone:\n  - domain: z0.\n  - domain: z1.\n"
+	                    "  - domain: z2.\n  - domain: z3.\n", NULL);
+	is_int(KNOT_EOK, ret, "load configuration");
+
+	ret = server_init(&server, 1);
+	is_int(KNOT_EOK, ret, "initialize server");
+
+	server.zone_db = create_zonedb();
+	ok(server.zone_db != NULL, "create zone database");
+
+	listener = knot_ctl_alloc();
+	ret = knot_ctl_bind(listener, socket_path);
+	is_int(KNOT_EOK, ret, "bind control socket");
+
+	test_concurrent();
+
+	knot_ctl_unbind(listener);
+	knot_ctl_free(listener);
+
+	server_deinit(&server);
+	conf_free(conf());
+
+	test_rm_rf(dir);
+	free(dir);
+
+	rcu_unregister_thread();
+
+	return 0;
+}
@@ -0,0 +1,370 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <tap/basic.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libknot/errcode.h"
+#include "knot/common/evsched.h"
+#include "knot/worker/pool.h"
+
+#define EVENTS		100
+#define MAX_DELAY	300	// Spans several level 1 slots.
+#define BENCH_EVENTS	1000000
+#define BENCH_THREADS	4
+
+typedef struct {
+	pthread_mutex_t mx;
+	pthread_cond_t cond;
+	unsigned fired;
+	unsigned early;
+} fire_log_t;
+
+typedef struct {
+	fire_log_t *log;
+	struct timespec due;
+	task_t task;
+	worker_pool_t *pool;
+} fire_ctx_t;
+
+static fire_log_t fire_log = {
+	.mx = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+static struct timespec time_in(uint32_t dt)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += dt / 1000;
+	ts.tv_nsec += (dt % 1000) * 1000000L;
+	if (ts.tv_nsec > 999999999L) {
+		ts.tv_sec += 1;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	return ts;
+}
+
+static bool time_passed(const struct timespec *ts)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec > ts->tv_sec ||
+	       (now.tv_sec == ts->tv_sec && now.tv_nsec >= ts->tv_nsec);
+}
+
+static void log_fire(fire_log_t *log, bool early)
+{
+	pthread_mutex_lock(&log->mx);
+	log->fired += 1;
+	log->early += early ? 1 : 0;
+	pthread_cond_broadcast(&log->cond);
+	pthread_mutex_unlock(&log->mx);
+}
+
+static unsigned log_reset(fire_log_t *log)
+{
+	pthread_mutex_lock(&log->mx);
+	unsigned fired = log->fired;
+	log->fired = 0;
+	log->early = 0;
+	pthread_mutex_unlock(&log->mx);
+
+	return fired;
+}
+
+static bool log_wait(fire_log_t *log, unsigned count)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += 5;
+
+	pthread_mutex_lock(&log->mx);
+	int ret = 0;
+	while (log->fired < count && ret == 0) {
+		ret = pthread_cond_timedwait(&log->cond, &log->mx, &ts);
+	}
+	bool done = (log->fired >= count);
+	pthread_mutex_unlock(&log->mx);
+
+	return done;
+}
+
+static void event_fire(event_t *ev)
+{
+	fire_ctx_t *ctx = ev->data;
+	log_fire(ctx->log, !time_passed(&ctx->due));
+}
+
+static void task_fire(task_t *task)
+{
+	fire_ctx_t *ctx = task->ctx;
+	log_fire(ctx->log, false);
+}
+
+static void event_assign(event_t *ev)
+{
+	fire_ctx_t *ctx = ev->data;
+	evsched_assign(ev, ctx->pool, &ctx->task);
+}
+
+static void test_expiration(evsched_t *sched)
+{
+	event_t *events[EVENTS];
+	fire_ctx_t ctx[EVENTS];
+
+	for (int i = 0; i < EVENTS; i++) {
+		uint32_t dt = (i * 7919) % MAX_DELAY;
+		ctx[i].log = &fire_log;
+		ctx[i].due = time_in(dt);
+		events[i] = evsched_event_create(sched, event_fire, &ctx[i]);
+		evsched_schedule(events[i], dt);
+	}
+
+	ok(log_wait(&fire_log, EVENTS), "all events expired");
+	ok(fire_log.early == 0, "no event expired early");
+	ok(log_reset(&fire_log) == EVENTS, "each event expired once");
+
+	// Reschedule to a later time, then to now.
+	fire_ctx_t later = { .log = &fire_log, .due = time_in(0) };
+	events[0]->data = &later;
+	evsched_schedule(events[0], 1000000);
+	evsched_schedule(events[0], 0);
+	ok(log_wait(&fire_log, 1), "rescheduled event expired");
+
+	// Reschedule to a later time.
+	evsched_schedule(events[1], 50);
+	evsched_schedule(events[1], 1000000);
+	usleep(150000);
+	ok(log_reset(&fire_log) == 1, "postponed event not expired");
+
+	// Cancel.
+	evsched_schedule(events[2], 50);
+	int ret = evsched_cancel(events[2]);
+	ok(ret == KNOT_EOK, "cancel event");
+	usleep(150000);
+	ok(log_reset(&fire_log) == 0, "canceled event not expired");
+
+	// Far events stay in the upper levels.
+	evsched_schedule(events[3], UINT32_MAX);
+	evsched_schedule(events[4], UINT32_MAX / 2);
+	ok(events[3]->bucket != NULL && events[4]->bucket != NULL,
+	   "far events scheduled");
+	evsched_cancel(events[3]);
+	ok(events[3]->bucket == NULL, "far event canceled");
+
+	for (int i = 0; i < EVENTS; i++) {
+		evsched_cancel(events[i]);
+		evsched_event_free(events[i]);
+	}
+}
+
+static void test_assign(evsched_t *sched)
+{
+	worker_pool_t *pool = worker_pool_create(2);
+	ok(pool != NULL, "create worker pool");
+	worker_pool_start(pool);
+
+	event_t *events[EVENTS];
+	fire_ctx_t ctx[EVENTS];
+
+	for (int i = 0; i < EVENTS; i++) {
+		ctx[i].log = &fire_log;
+		ctx[i].pool = pool;
+		ctx[i].task.ctx = &ctx[i];
+		ctx[i].task.run = task_fire;
+		ctx[i].task.prio = TASK_PRIO_NORMAL;
+		events[i] = evsched_event_create(sched, event_assign, &ctx[i]);
+		evsched_schedule(events[i], 10);
+	}
+
+	ok(log_wait(&fire_log, EVENTS), "all deferred tasks executed");
+	worker_pool_wait(pool);
+	ok(log_reset(&fire_log) == EVENTS, "each deferred task executed once");
+
+	for (int i = 0; i < EVENTS; i++) {
+		evsched_cancel(events[i]);
+		evsched_event_free(events[i]);
+	}
+
+	worker_pool_stop(pool);
+	worker_pool_join(pool);
+	worker_pool_destroy(pool);
+}
+
+typedef struct {
+	fire_log_t *log;
+	event_t *other;
+} cancel_ctx_t;
+
+static void event_cancel(event_t *ev)
+{
+	cancel_ctx_t *ctx = ev->data;
+	evsched_cancel(ctx->other);
+	evsched_cancel(ev);
+	log_fire(ctx->log, false);
+}
+
+static void test_cancel(evsched_t *sched)
+{
+	// The first event cancels itself and the second one in the same batch.
+	cancel_ctx_t ctx[2] = { { .log = &fire_log }, { .log = &fire_log } };
+	event_t *events[2];
+	for (int i = 0; i < 2; i++) {
+		events[i] = evsched_event_create(sched, event_cancel, &ctx[i]);
+	}
+	ctx[0].other = events[1];
+	ctx[1].other = events[0];
+
+	for (int i = 0; i < 2; i++) {
+		evsched_schedule(events[i], 20);
+	}
+
+	bool done = log_wait(&fire_log, 1);
+	ok(done, "cancel from a callback");
+	if (!done) {
+		// The scheduler thread is deadlocked.
+		exit(1);
+	}
+	usleep(50000);
+	ok(log_reset(&fire_log) == 1, "event canceled in a callback not expired");
+
+	for (int i = 0; i < 2; i++) {
+		evsched_cancel(events[i]);
+		evsched_event_free(events[i]);
+	}
+}
+
+typedef struct {
+	event_t **events;
+	size_t count;
+} bench_ctx_t;
+
+static void *bench_reschedule(void *data)
+{
+	bench_ctx_t *ctx = data;
+	for (size_t i = 0; i < ctx->count; i++) {
+		evsched_schedule(ctx->events[i], 3600000 + (i * 7919) % 86400000);
+	}
+
+	return NULL;
+}
+
+static double elapsed_ns(const struct timespec *begin, size_t count)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return ((end.tv_sec - begin->tv_sec) * 1e9 +
+	        (end.tv_nsec - begin->tv_nsec)) / count;
+}
+
+static void test_bench(evsched_t *sched)
+{
+	event_t **events = malloc(BENCH_EVENTS * sizeof(event_t *));
+	fire_ctx_t ctx = { .log = &fire_log };
+	bool created = (events != NULL);
+	for (size_t i = 0; created && i < BENCH_EVENTS; i++) {
+		events[i] = evsched_event_create(sched, event_fire, &ctx);
+		created = (events[i] != NULL);
+	}
+	ok(created, "create %i events", BENCH_EVENTS);
+	if (!created) {
+		return;
+	}
+
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	bench_ctx_t all = { events, BENCH_EVENTS };
+	bench_reschedule(&all);
+	diag("schedule %.0f ns", elapsed_ns(&begin, BENCH_EVENTS));
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	bench_reschedule(&all);
+	diag("reschedule %.0f ns", elapsed_ns(&begin, BENCH_EVENTS));
+
+	pthread_t threads[BENCH_THREADS];
+	bench_ctx_t parts[BENCH_THREADS];
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (int i = 0; i < BENCH_THREADS; i++) {
+		parts[i].events = events + i * (BENCH_EVENTS / BENCH_THREADS);
+		parts[i].count = BENCH_EVENTS / BENCH_THREADS;
+		pthread_create(&threads[i], NULL, bench_reschedule, &parts[i]);
+	}
+	for (int i = 0; i < BENCH_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	diag("reschedule from %i threads %.0f ns", BENCH_THREADS,
+	     elapsed_ns(&begin, BENCH_EVENTS));
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (size_t i = 0; i < BENCH_EVENTS; i++) {
+		evsched_cancel(events[i]);
+	}
+	diag("cancel %.0f ns", elapsed_ns(&begin, BENCH_EVENTS));
+
+	ok(log_reset(&fire_log) == 0, "no benchmark event expired");
+
+	for (size_t i = 0; i < BENCH_EVENTS; i++) {
+		evsched_event_free(events[i]);
+	}
+	free(events);
+}
+
+static void interrupt_handle(int s)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	struct sigaction sa;
+	sa.sa_handler = interrupt_handle;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGALRM, &sa, NULL); // Interrupt
+
+	evsched_t sched;
+	int ret = evsched_init(&sched, NULL);
+	ok(ret == KNOT_EOK, "create scheduler");
+	evsched_start(&sched);
+
+	diag("expiration");
+	test_expiration(&sched);
+
+	diag("assign");
+	test_assign(&sched);
+
+	diag("cancel");
+	test_cancel(&sched);
+
+	diag("benchmark");
+	test_bench(&sched);
+
+	evsched_stop(&sched);
+	evsched_join(&sched);
+	evsched_deinit(&sched);
+
+	return 0;
+}
@@ -23,7 +23,10 @@
 #include <tap/basic.h>
 #include <time.h>
 
+#include <sys/resource.h>
+
 #include "knot/common/fdset.h"
+#include "contrib/macros.h"
 
 #define WRITE_PATTERN ((char) 0xde)
 #define WRITE_PATTERN_LEN sizeof(char)
@@ -79,9 +82,89 @@ void* thr_action(void *arg)
 	return NULL;
 }
 
+static enum fdset_sweep_state sweep_cb(fdset_t *set, int i, void *data)
+{
+	UNUSED(set);
+	UNUSED(i);
+	(*(unsigned *)data)++;
+	return FDSET_SWEEP;
+}
+
+static double time_diff_us(const struct timespec *from, const struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1e6 + (to->tv_nsec - from->tv_nsec) / 1e3;
+}
+
+/*!
+ * \brief Measure wakeup cost with a single active descriptor among \a count.
+ */
+static void bench_wakeup(unsigned count)
+{
+	const unsigned rounds = 1000;
+
+	unsigned npipes = count / 2;
+	struct rlimit lim;
+	getrlimit(RLIMIT_NOFILE, &lim);
+	if (lim.rlim_cur < count + 64) {
+		lim.rlim_cur = MIN(lim.rlim_max, count + 64);
+		setrlimit(RLIMIT_NOFILE, &lim);
+	}
+	if (lim.rlim_cur < count + 64) {
+		skip("fdset: bench %u fds, descriptor limit too low", count);
+		return;
+	}
+
+	fdset_t set;
+	fdset_init(&set, count);
+	int *fds = malloc(count * sizeof(*fds));
+	for (unsigned i = 0; i < npipes; ++i) {
+		if (pipe(fds + 2 * i) != 0) {
+			npipes = i;
+			break;
+		}
+		/* Watch both ends, the write end for reading is always idle. */
+		fdset_add(&set, fds[2 * i], POLLIN, NULL);
+		fdset_add(&set, fds[2 * i + 1], POLLIN, NULL);
+		fdset_set_watchdog(&set, set.n - 1, 3600);
+	}
+
+	int active_w = fds[2 * (npipes / 2) + 1];
+
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	unsigned woken = 0;
+	for (unsigned r = 0; r < rounds; ++r) {
+		char c = WRITE_PATTERN;
+		if (write(active_w, &c, 1) != 1) {
+			break;
+		}
+		fdset_it_t it;
+		fdset_poll(&set, &it, 1000);
+		for (; !fdset_it_done(&it); fdset_it_next(&it)) {
+			int fd = fdset_get_fd(&set, fdset_it_get_idx(&it));
+			if (read(fd, &c, 1) == 1) {
+				woken++;
+			}
+		}
+		/* Idle descriptors shouldn't be visited by the sweep. */
+		fdset_sweep(&set, sweep_cb, &woken);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ok(woken == rounds && set.n == 2 * npipes,
+	   "fdset: bench %u fds, %.2f us per wakeup", 2 * npipes,
+	   time_diff_us(&begin, &end) / rounds);
+
+	for (unsigned i = 0; i < 2 * npipes; ++i) {
+		close(fds[i]);
+	}
+	free(fds);
+	fdset_clear(&set);
+}
+
 int main(int argc, char *argv[])
 {
-	plan(12);
+	plan(20);
 
 	/* 1. Create fdset. */
 	fdset_t set;
@@ -107,27 +190,50 @@ int main(int argc, char *argv[])
 	pthread_create(&t, 0, thr_action, &fds[1]);
 
 	/* 4. Watch fdset. */
-	int nfds = poll(set.pfd, set.n, 60 * 1000);
+	fdset_it_t it;
+	int nfds = fdset_poll(&set, &it, 60 * 1000);
 	gettimeofday(&te, 0);
 	size_t diff = timeval_diff(&ts, &te);
 
 	ok(nfds > 0, "fdset: poll returned %d events in %zu ms", nfds, diff);
 
 	/* 5. Prepare event set. */
-	ok(set.pfd[0].revents & POLLIN, "fdset: pipe is active");
+	ok(!fdset_it_done(&it) && fdset_it_get_idx(&it) == 0 &&
+	   (fdset_it_get_events(&it) & POLLIN), "fdset: pipe is active");
 
 	/* 6. Receive data. */
 	char buf = 0x00;
-	ret = read(set.pfd[0].fd, &buf, WRITE_PATTERN_LEN);
+	ret = read(fdset_get_fd(&set, 0), &buf, WRITE_PATTERN_LEN);
 	ok(ret >= 0 && buf == WRITE_PATTERN, "fdset: contains valid data");
 
+	/* Removal through the iterator. */
+	fdset_it_remove(&it);
+	fdset_it_next(&it);
+	ok(fdset_it_done(&it), "fdset: iterated all events");
+	fdset_it_commit(&it);
+	ok(set.n == 1 && fdset_get_fd(&set, 0) == tmpfds[0],
+	   "fdset: remove through iterator works");
+	ret = fdset_add(&set, fds[0], POLLIN, NULL);
+	is_int(1, ret, "fdset: add to set works (2)");
+
+	/* Watchdog. */
+	unsigned swept = 0;
+	fdset_set_watchdog(&set, 0, 3600);
+	fdset_set_watchdog(&set, 1, 0);
+	fdset_sweep(&set, sweep_cb, &swept);
+	ok(swept == 1 && set.n == 1 && fdset_get_fd(&set, 0) == tmpfds[0],
+	   "fdset: sweep removes only expired descriptors");
+	fdset_add(&set, fds[0], POLLIN, NULL);
+
 	/* 7-9. Remove from event set. */
 	ret = fdset_remove(&set, 0);
 	is_int(0, ret, "fdset: remove from fdset works");
+	ret = fdset_unwatch(&set, 0);
+	ok(ret == 0 && fdset_get_fd(&set, 0) == -1, "fdset: unwatch works");
 	close(fds[0]);
 	close(fds[1]);
 	ret = fdset_remove(&set, 0);
-	close(tmpfds[1]);
+	close(tmpfds[0]);
 	close(tmpfds[1]);
 	is_int(0, ret, "fdset: remove from fdset works (2)");
 	ret = fdset_remove(&set, 0);
@@ -145,6 +251,11 @@ int main(int argc, char *argv[])
 	ret = fdset_clear(&set);
 	is_int(0, ret, "fdset: destroyed");
 
+	/* Wakeup cost with mostly idle descriptors. */
+	bench_wakeup(1000);
+	bench_wakeup(10000);
+	bench_wakeup(100000);
+
 	/* Cleanup. */
 	pthread_join(t, 0);
 
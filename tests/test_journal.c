@@ -592,6 +592,354 @@ static changeset_t * tm_chs(const knot_dname_t * apex, int x)
 	return ret;
 }
 
+/*! \brief Test committing stores of two zones in one DB transaction. */
+static void test_group_commit(void)
+{
+	set_conf(1000, 512 * 1024);
+
+	int ret = drop_journal(j, NULL);
+	ok(ret == KNOT_EOK, "journal: drop_journal must be ok");
+
+	const knot_dname_t *apex2 = (const uint8_t *)"\5test2";
+	journal_t *j2 = journal_new();
+	ret = journal_open(j2, &db, apex2);
+	ok(ret == KNOT_EOK, "journal: group commit, open second journal (%d)", ret);
+
+	changeset_t *ch1 = changeset_new(apex);
+	changeset_t *ch2 = changeset_new(apex2);
+	init_random_changeset(ch1, 0, 1, 128, apex, false);
+	init_random_changeset(ch2, 0, 1, 128, apex2, false);
+	list_t l1, l2;
+	init_list(&l1);
+	init_list(&l2);
+	add_tail(&l1, &ch1->n);
+	add_tail(&l2, &ch2->n);
+
+	group_req_t req1 = { .j = j, .changesets = &l1 };
+	group_req_t req2 = { .j = j2, .changesets = &l2 };
+	list_t batch;
+	init_list(&batch);
+	add_tail(&batch, &req1.n);
+	add_tail(&batch, &req2.n);
+	commit_group(db, &batch);
+	ok(req1.ret == KNOT_EOK && req2.ret == KNOT_EOK, "journal: group commit");
+
+	list_t l;
+	init_list(&l);
+	ret = journal_load_changesets(j, &l, 0);
+	ok(ret == KNOT_EOK && changesets_list_eq(&l, &l1), "journal: group commit, load first");
+	changesets_free(&l);
+	ret = journal_load_changesets(j2, &l, 0);
+	ok(ret == KNOT_EOK && changesets_list_eq(&l, &l2), "journal: group commit, load second");
+	changesets_free(&l);
+	changesets_free(&l1);
+	changesets_free(&l2);
+
+	/* A failed store doesn't affect the other stores of the group. */
+	ch1 = changeset_new(apex);
+	ch2 = changeset_new(apex2);
+	init_random_changeset(ch1, 1, 2, 128, apex, false);
+	init_random_changeset(ch2, 5, 6, 128, apex2, false);
+	add_tail(&l1, &ch1->n);
+	add_tail(&l2, &ch2->n);
+	changeset_t *boot = changeset_new(apex2);
+	init_random_changeset(boot, 0, 1, 128, apex2, true);
+	ret = journal_store_changeset(j2, boot);
+	changeset_free(boot);
+	ok(ret == KNOT_EOK, "journal: group commit, store bootstrap (%d)", ret);
+
+	init_list(&batch);
+	add_tail(&batch, &req2.n);
+	add_tail(&batch, &req1.n);
+	commit_group(db, &batch);
+	ok(req1.ret == KNOT_EOK && req2.ret == KNOT_ERANGE,
+	   "journal: group commit with a failed store (%d, %d)", req1.ret, req2.ret);
+	ret = journal_load_changesets(j, &l, 1);
+	ok(ret == KNOT_EOK && changesets_list_eq(&l, &l1), "journal: group commit, load after failure");
+	changesets_free(&l);
+	changesets_free(&l1);
+	changesets_free(&l2);
+
+	journal_group_stats_t before, after;
+	journal_db_group_stats(db, &before);
+	ch1 = changeset_new(apex);
+	init_random_changeset(ch1, 2, 3, 128, apex, false);
+	ret = journal_store_changeset(j, ch1);
+	changeset_free(ch1);
+	journal_db_group_stats(db, &after);
+	ok(ret == KNOT_EOK && after.commits == before.commits + 1 &&
+	   after.stores == before.stores + 1 && after.max_batch >= 1,
+	   "journal: group commit statistics");
+
+	ret = drop_journal(j2, NULL);
+	assert(ret == KNOT_EOK);
+	journal_close(j2);
+	journal_free(&j2);
+	ret = drop_journal(j, NULL);
+	assert(ret == KNOT_EOK);
+
+	unset_conf();
+}
+
+#define GROUP_THREADS 4
+
+typedef struct {
+	journal_t *j;
+	list_t changesets;
+	int ret;
+} group_thread_t;
+
+static void *group_store(void *arg)
+{
+	group_thread_t *t = arg;
+	t->ret = journal_store_changesets(t->j, &t->changesets);
+	return NULL;
+}
+
+/*! \brief Test concurrent stores of several zones committed by a group leader. */
+static void test_group_threads(void)
+{
+	set_conf(1000, 512 * 1024);
+
+	journal_group_t *group = &db->group;
+	journal_group_stats_t before, after;
+	journal_db_group_stats(db, &before);
+
+	/* Hold the leadership, so that all the stores get queued. */
+	pthread_mutex_lock(&group->mutex);
+	group->leader = true;
+	pthread_mutex_unlock(&group->mutex);
+
+	uint8_t apexes[GROUP_THREADS][8];
+	group_thread_t t[GROUP_THREADS];
+	pthread_t threads[GROUP_THREADS];
+	for (int i = 0; i < GROUP_THREADS; i++) {
+		snprintf((char *)apexes[i], sizeof(apexes[i]), "\5zone%i", i);
+		t[i].j = journal_new();
+		int ret = journal_open(t[i].j, &db, apexes[i]);
+		assert(ret == KNOT_EOK);
+		changeset_t *ch = changeset_new(apexes[i]);
+		init_random_changeset(ch, 0, 1, 128, apexes[i], false);
+		init_list(&t[i].changesets);
+		add_tail(&t[i].changesets, &ch->n);
+		pthread_create(&threads[i], NULL, group_store, &t[i]);
+	}
+
+	size_t queued = 0;
+	while (queued < GROUP_THREADS) {
+		usleep(1000);
+		pthread_mutex_lock(&group->mutex);
+		queued = list_size(&group->queue);
+		pthread_mutex_unlock(&group->mutex);
+	}
+
+	pthread_mutex_lock(&group->mutex);
+	group->leader = false;
+	pthread_cond_broadcast(&group->cond);
+	pthread_mutex_unlock(&group->mutex);
+
+	bool stored = true;
+	for (int i = 0; i < GROUP_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		stored = stored && (t[i].ret == KNOT_EOK);
+	}
+	ok(stored, "journal: concurrent group stores");
+
+	journal_db_group_stats(db, &after);
+	ok(after.commits == before.commits + 1 &&
+	   after.stores == before.stores + GROUP_THREADS &&
+	   after.max_batch >= GROUP_THREADS,
+	   "journal: concurrent stores committed by one leader");
+
+	/* Each zone of the group is charged for its own changeset. */
+	for (int i = 0; i < GROUP_THREADS; i++) {
+		list_t l;
+		init_list(&l);
+		int ret = journal_load_changesets(t[i].j, &l, 0);
+		ok(ret == KNOT_EOK && changesets_list_eq(&l, &t[i].changesets),
+		   "journal: concurrent group stores, load zone %i", i);
+		changesets_free(&l);
+
+		uint64_t occupied = 0;
+		journal_metadata_info(t[i].j, NULL, NULL, NULL, NULL, NULL, &occupied);
+		ok(occupied > 0, "journal: concurrent group stores, zone %i occupied", i);
+
+		changesets_free(&t[i].changesets);
+		ret = drop_journal(t[i].j, NULL);
+		assert(ret == KNOT_EOK);
+		journal_close(t[i].j);
+		journal_free(&t[i].j);
+	}
+
+	unset_conf();
+}
+
+/*! \brief Check that the reader yields the RR sets of the changeset in the IXFR order. */
+static bool read_changeset_eq(journal_read_t *read, changeset_t *ch)
+{
+	knot_rrset_t rr;
+	bool eq = (journal_read_rrset(read, &rr) == KNOT_EOK &&
+	           knot_rrset_equal(&rr, ch->soa_from, KNOT_RRSET_COMPARE_WHOLE));
+	knot_rrset_clear(&rr, NULL);
+
+	for (int section = 0; section < 2 && eq; section++) {
+		changeset_iter_t it;
+		int ret = (section == 0 ? changeset_iter_rem(&it, ch) : changeset_iter_add(&it, ch));
+		if (ret != KNOT_EOK) {
+			return false;
+		}
+		if (section == 1) {
+			eq = (journal_read_rrset(read, &rr) == KNOT_EOK &&
+			      knot_rrset_equal(&rr, ch->soa_to, KNOT_RRSET_COMPARE_WHOLE));
+			knot_rrset_clear(&rr, NULL);
+		}
+		knot_rrset_t exp = changeset_iter_next(&it);
+		while (eq && !knot_rrset_empty(&exp)) {
+			eq = (journal_read_rrset(read, &rr) == KNOT_EOK &&
+			      knot_rrset_equal(&rr, &exp, KNOT_RRSET_COMPARE_WHOLE));
+			knot_rrset_clear(&rr, NULL);
+			exp = changeset_iter_next(&it);
+		}
+		changeset_iter_clear(&it);
+	}
+
+	return eq;
+}
+
+/*! \brief Test reading changesets RR set by RR set. */
+static void test_read(void)
+{
+	set_conf(1000, 512 * 1024);
+
+	int ret = drop_journal(j, NULL);
+	ok(ret == KNOT_EOK, "journal: drop_journal must be ok");
+
+	/* The first changeset spans several chunks. */
+	list_t l;
+	init_list(&l);
+	for (uint32_t serial = 0; serial < 3; serial++) {
+		changeset_t *ch = changeset_new(apex);
+		init_random_changeset(ch, serial, serial + 1, serial == 0 ? 2000 : 64, apex, false);
+		add_tail(&l, &ch->n);
+	}
+	ret = journal_store_changesets(j, &l);
+	ok(ret == KNOT_EOK, "journal: read, store changesets (%d)", ret);
+
+	journal_read_t *read = NULL;
+	ret = journal_read_begin(j, 0, &read);
+	ok(ret == KNOT_EOK, "journal: read begin (%d)", ret);
+	bool eq = (ret == KNOT_EOK);
+	changeset_t *ch = NULL;
+	WALK_LIST(ch, l) {
+		eq = eq && read_changeset_eq(read, ch);
+	}
+	ok(eq, "journal: read changesets");
+	knot_rrset_t rr;
+	ret = journal_read_rrset(read, &rr);
+	ok(ret == KNOT_EOK && knot_rrset_empty(&rr), "journal: read after the last changeset");
+	journal_read_end(read);
+
+	ret = journal_read_begin(j, 1, &read);
+	ch = (changeset_t *)TAIL(l);
+	ok(ret == KNOT_EOK && read_changeset_eq(read, (changeset_t *)ch->n.prev) &&
+	   read_changeset_eq(read, ch), "journal: read since a serial");
+	journal_read_end(read);
+
+	ret = journal_read_begin(j, 5, &read);
+	ok(ret == KNOT_ENOENT, "journal: read since a missing serial (%d)", ret);
+
+	changesets_free(&l);
+	ret = drop_journal(j, NULL);
+	assert(ret == KNOT_EOK);
+
+	unset_conf();
+}
+
+/*! \brief Store changesets until the journal is full, then flush it, in rounds. */
+static bool store_rounds(changeset_t *ch, uint32_t serial, int rounds)
+{
+	for (int i = 0; i < rounds; ++i) {
+		int ret, count = 0;
+		while (true) {
+			changeset_set_soa_serials(ch, serial, serial + 1, apex);
+			ret = journal_store_changeset(j, ch);
+			if (ret != KNOT_EOK) {
+				break;
+			}
+			serial++;
+			count++;
+		}
+
+		if (count == 0 || ret != KNOT_EBUSY || journal_flush(j) != KNOT_EOK) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*! \brief Test that a paused reader doesn't hold the DB space. */
+static void test_read_pause(void)
+{
+	set_conf(1000, 512 * 1024);
+
+	int ret = drop_journal(j, NULL);
+	ok(ret == KNOT_EOK, "journal: drop_journal must be ok");
+
+	list_t l;
+	init_list(&l);
+	for (uint32_t serial = 0; serial < 3; serial++) {
+		changeset_t *ch = changeset_new(apex);
+		init_random_changeset(ch, serial, serial + 1, 64, apex, false);
+		add_tail(&l, &ch->n);
+	}
+	ret = journal_store_changesets(j, &l);
+	ok(ret == KNOT_EOK, "journal: read pause, store changesets (%d)", ret);
+
+	/* Resume after a store, the reading stops at the last serial at the beginning. */
+	journal_read_t *read = NULL;
+	ret = journal_read_begin(j, 0, &read);
+	changeset_t *ch = (changeset_t *)HEAD(l);
+	ok(ret == KNOT_EOK && read_changeset_eq(read, ch), "journal: read before pause");
+	journal_read_pause(read);
+
+	changeset_t *next = changeset_new(apex);
+	init_random_changeset(next, 3, 4, 64, apex, false);
+	ret = journal_store_changeset(j, next);
+	ok(ret == KNOT_EOK, "journal: store while paused (%d)", ret);
+	changeset_free(next);
+
+	knot_rrset_t rr;
+	ch = (changeset_t *)ch->n.next;
+	ok(read_changeset_eq(read, ch) && read_changeset_eq(read, (changeset_t *)ch->n.next) &&
+	   journal_read_rrset(read, &rr) == KNOT_EOK && knot_rrset_empty(&rr),
+	   "journal: read after pause");
+	journal_read_end(read);
+	changesets_free(&l);
+
+	/* Stores succeed while a reader of deleted changesets is parked. */
+	ret = journal_read_begin(j, 0, &read);
+	ok(ret == KNOT_EOK && journal_read_rrset(read, &rr) == KNOT_EOK,
+	   "journal: read before parking");
+	knot_rrset_clear(&rr, NULL);
+	journal_read_pause(read);
+
+	changeset_t big;
+	changeset_init(&big, apex);
+	init_random_changeset(&big, 0, 1, 400, apex, false);
+	ok(store_rounds(&big, 4, 6), "journal: fillup runs with a parked reader");
+	changeset_clear(&big);
+
+	ret = journal_read_rrset(read, &rr);
+	is_int(KNOT_ENOENT, ret, "journal: resume a deleted changeset");
+	journal_read_end(read);
+
+	ret = drop_journal(j, NULL);
+	assert(ret == KNOT_EOK);
+
+	unset_conf();
+}
+
 static int merged_present(void)
 {
 	local_txn_t(txn, j);
@@ -718,6 +1066,14 @@ int main(int argc, char *argv[])
 
 	test_store_load();
 
+	test_group_commit();
+
+	test_group_threads();
+
+	test_read();
+
+	test_read_pause();
+
 	test_merge();
 
 	test_stress(j);
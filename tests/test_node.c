@@ -51,17 +51,17 @@ static knot_rrset_t *create_dummy_rrsig(const knot_dname_t *owner,
 
 int main(int argc, char *argv[])
 {
-	plan(23);
+	plan(27);
 
 	knot_dname_t *dummy_owner = knot_dname_from_str_alloc("test.");
 	// Test new
-	zone_node_t *node = node_new(dummy_owner, NULL);
+	zone_node_t *node = node_new(dummy_owner, false, false, NULL);
 	ok(node != NULL, "Node: new");
 	assert(node);
 	ok(knot_dname_is_equal(node->owner, dummy_owner), "Node: new - set fields");
 
 	// Test parent setting
-	zone_node_t *parent = node_new(dummy_owner, NULL);
+	zone_node_t *parent = node_new(dummy_owner, false, false, NULL);
 	assert(parent);
 	node_set_parent(node, parent);
 	ok(node->parent == parent && parent->children == 1, "Node: set parent.");
@@ -154,6 +154,33 @@ int main(int argc, char *argv[])
 	node_free(&node, NULL);
 	ok(node == NULL, "Node: free.");
 
+	// Test binodes
+	zone_node_t *second = node_new(dummy_owner, true, true, NULL);
+	zone_node_t *first = binode_node(second, false);
+	ok(second != NULL && binode_second(second) && !binode_second(first) &&
+	   binode_counterpart(first) == second && first->owner == second->owner,
+	   "Node: new binode.");
+
+	dummy_rrset = create_dummy_rrset(dummy_owner, KNOT_RRTYPE_TXT);
+	ret = node_add_rrset(first, dummy_rrset, NULL);
+	assert(ret == KNOT_EOK);
+	binode_unify(first, NULL);
+	ok(second->rrs == first->rrs && second->rrset_count == 1 &&
+	   binode_second(second), "Node: unify binode.");
+
+	ret = binode_prepare_change(second, NULL);
+	ok(ret == KNOT_EOK && second->rrs != first->rrs &&
+	   second->rrs[0].rrs.data == first->rrs[0].rrs.data,
+	   "Node: prepare binode change.");
+
+	node_remove_rdataset(second, KNOT_RRTYPE_TXT);
+	ok(second->rrset_count == 0 && node_rrtype_exists(first, KNOT_RRTYPE_TXT),
+	   "Node: change binode half.");
+
+	node_free_rrsets(first, NULL);
+	node_free(&second, NULL);
+	knot_rrset_free(&dummy_rrset, NULL);
+
 	knot_dname_free(&dummy_owner, NULL);
 
 	return 0;
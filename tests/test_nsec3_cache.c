@@ -0,0 +1,90 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <tap/basic.h>
+
+#include "knot/dnssec/nsec3-cache.h"
+#include "knot/dnssec/zone-nsec.h"
+#include "libknot/libknot.h"
+
+static bool check_owner(const char *name_str, const knot_dname_t *apex,
+                        const dnssec_nsec3_params_t *params)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc(name_str);
+	knot_dname_t *cached = knot_nsec3_cache_owner(name, apex, params);
+	knot_dname_t *expected = knot_create_nsec3_owner(name, apex, params);
+
+	bool ok = cached != NULL && expected != NULL &&
+	          knot_dname_is_equal(cached, expected);
+
+	knot_dname_free(&name, NULL);
+	knot_dname_free(&cached, NULL);
+	knot_dname_free(&expected, NULL);
+
+	return ok;
+}
+
+static bool check_names(int count, const knot_dname_t *apex,
+                        const dnssec_nsec3_params_t *params)
+{
+	for (int i = 0; i < count; i++) {
+		char name[64];
+		(void)snprintf(name, sizeof(name), "n%d.example.", i);
+		if (!check_owner(name, apex, params)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	knot_dname_t *apex = knot_dname_from_str_alloc("example.");
+
+	uint8_t salt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+	dnssec_nsec3_params_t params = {
+		.algorithm = DNSSEC_NSEC3_ALGORITHM_SHA1,
+		.iterations = 10,
+		.salt = { .data = salt, .size = sizeof(salt) }
+	};
+
+	ok(knot_nsec3_cache_owner(NULL, apex, &params) == NULL, "cache: no owner");
+
+	// miss and hit
+	ok(check_owner("example.", apex, &params), "cache: apex, miss");
+	ok(check_owner("example.", apex, &params), "cache: apex, hit");
+	ok(check_owner("*.example.", apex, &params), "cache: wildcard");
+
+	// changed parameters must not reuse the cached hashes
+	params.iterations = 0;
+	ok(check_owner("example.", apex, &params), "cache: changed iterations");
+	salt[0] = 0x00;
+	ok(check_owner("example.", apex, &params), "cache: changed salt");
+	params.salt.size = 0;
+	ok(check_owner("example.", apex, &params), "cache: empty salt");
+
+	// more names than the cache capacity
+	ok(check_names(2000, apex, &params), "cache: eviction, first pass");
+	ok(check_names(2000, apex, &params), "cache: eviction, second pass");
+
+	knot_dname_free(&apex, NULL);
+
+	return 0;
+}
@@ -15,6 +15,7 @@
  */
 
 #include <tap/basic.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -23,6 +24,10 @@
 #include "libknot/packet/pkt.h"
 #include "contrib/mempattern.h"
 #include "contrib/ucw/mempool.h"
+#include "test_conf.h"
+
+#define STATS_THREADS 8
+#define STATS_ROUNDS 100000
 
 /* Universal processing stage. */
 unsigned state_visit(unsigned state, knot_pkt_t *pkt, knotd_qdata_t *qdata,
@@ -35,6 +40,60 @@ unsigned state_visit(unsigned state, knot_pkt_t *pkt, knotd_qdata_t *qdata,
 	return state + 1;
 }
 
+/* Concurrent statistics updates. */
+static void *stats_update(void *arg)
+{
+	knotd_mod_t *mod = arg;
+	for (unsigned i = 0; i < STATS_ROUNDS; ++i) {
+		knotd_mod_stats_incr(mod, 0, 0, 1);
+		knotd_mod_stats_incr(mod, 1, i % 10, 2);
+		knotd_mod_stats_decr(mod, 1, 9, 1);
+	}
+
+	return NULL;
+}
+
+static void test_stats(knot_mm_t *mm)
+{
+	const char *conf_str = "server:\n"
+	                       "  udp-workers: 3\n"
+	                       "  tcp-workers: 1\n";
+	int ret = test_conf(conf_str, NULL);
+	is_int(KNOT_EOK, ret, "stats: prepare configuration");
+
+	knotd_mod_t mod = { .mm = mm };
+	ret = knotd_mod_stats_add(&mod, "single", 1, NULL);
+	is_int(KNOT_EOK, ret, "stats: add single counter");
+	ret = knotd_mod_stats_add(&mod, "array", 10, NULL);
+	is_int(KNOT_EOK, ret, "stats: add counter array");
+
+	mod_ctr_t *ctr = mod.stats + 1;
+	ok(ctr->rows == 4 && ctr->stride % 8 == 0 &&
+	   ((uintptr_t)ctr->counters % 64) == 0, "stats: counter rows per thread");
+
+	pthread_t thr[STATS_THREADS];
+	for (unsigned i = 0; i < STATS_THREADS; ++i) {
+		pthread_create(thr + i, NULL, stats_update, &mod);
+	}
+	for (unsigned i = 0; i < STATS_THREADS; ++i) {
+		pthread_join(thr[i], NULL);
+	}
+
+	const uint64_t total = (uint64_t)STATS_THREADS * STATS_ROUNDS;
+	bool passed = mod_ctr_get(mod.stats, 0) == total;
+	for (unsigned i = 0; i < 9; ++i) {
+		passed = passed && mod_ctr_get(ctr, i) == 2 * total / 10;
+	}
+	passed = passed && mod_ctr_get(ctr, 9) == 2 * total / 10 - total;
+	ok(passed, "stats: concurrent updates summed");
+
+	knotd_mod_stats_store(&mod, 0, 0, 42);
+	ok(mod_ctr_get(mod.stats, 0) == 42, "stats: store");
+
+	knotd_mod_stats_free(&mod);
+	conf_free(conf());
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -85,6 +144,9 @@ int main(int argc, char *argv[])
 	/* Free the query plan. */
 	query_plan_free(plan);
 
+	/* Module statistics. */
+	test_stats(&mm);
+
 	/* Cleanup. */
 	mp_delete((struct mempool *)mm.ctx);
 
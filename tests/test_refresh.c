@@ -0,0 +1,317 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <tap/basic.h>
+#include <tap/files.h>
+
+#include "test_conf.h"
+#include "contrib/net.h"
+#include "contrib/sockaddr.h"
+#include "contrib/time.h"
+#include "knot/common/evsched.h"
+#include "knot/dnssec/kasp/kasp_db.h"
+#include "knot/events/events.h"
+#include "knot/query/requestor.h"
+#include "knot/worker/pool.h"
+#include "knot/zone/zone.h"
+#include "libknot/libknot.h"
+
+#define DELAY_MS	1000	/*!< Answer delay of the master. */
+#define SOA_REFRESH	3600
+
+static const uint8_t SOA_RDATA[] = {
+	0x02, 'n', 's', 0x00,
+	0x04, 'm', 'a', 'i', 'l', 0x00,
+	0x00, 0x00, 0x00, 0x01,
+	0x00, 0x00, 0x0e, 0x10,
+	0x00, 0x00, 0x0e, 0x10,
+	0x00, 0x00, 0x0e, 0x10,
+	0x00, 0x00, 0x0e, 0x10
+};
+
+static const uint8_t NS_RDATA[] = {
+	0x02, 'n', 's', 0x00
+};
+
+/*! Serial of the zone at the master. */
+static volatile uint32_t master_serial = 1;
+
+/* Answer the SOA query, or transfer the zone with the SOA and NS records. */
+static void master_answer(int client, const knot_pkt_t *query, knot_pkt_t *resp)
+{
+	knot_dname_t *owner = (knot_dname_t *)knot_pkt_qname(query);
+
+	knot_rrset_t soa;
+	knot_rrset_init(&soa, owner, KNOT_RRTYPE_SOA, KNOT_CLASS_IN);
+	knot_rrset_add_rdata(&soa, SOA_RDATA, sizeof(SOA_RDATA), 3600, NULL);
+	knot_soa_serial_set(&soa.rrs, master_serial);
+
+	knot_rrset_t ns;
+	knot_rrset_init(&ns, owner, KNOT_RRTYPE_NS, KNOT_CLASS_IN);
+	knot_rrset_add_rdata(&ns, NS_RDATA, sizeof(NS_RDATA), 3600, NULL);
+
+	int ret = knot_pkt_begin(resp, KNOT_ANSWER);
+	if (ret == KNOT_EOK) {
+		ret = knot_pkt_put(resp, KNOT_COMPR_HINT_QNAME, &soa, 0);
+	}
+	if (ret == KNOT_EOK && knot_pkt_qtype(query) != KNOT_RRTYPE_SOA) {
+		ret = knot_pkt_put(resp, KNOT_COMPR_HINT_QNAME, &ns, 0);
+		if (ret == KNOT_EOK) {
+			ret = knot_pkt_put(resp, KNOT_COMPR_HINT_QNAME, &soa, 0);
+		}
+	}
+	if (ret == KNOT_EOK) {
+		net_dns_tcp_send(client, resp->wire, resp->size, -1);
+	}
+
+	knot_rdataset_clear(&soa.rrs, NULL);
+	knot_rdataset_clear(&ns.rrs, NULL);
+}
+
+/* Stand-in master answering each query on a connection after a delay. */
+static void *master_thread(void *arg)
+{
+	int fd = *(int *)arg;
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+	while (true) {
+		int client = accept(fd, NULL, NULL);
+		if (client < 0) {
+			break;
+		}
+		int len;
+		while ((len = net_dns_tcp_recv(client, buf, sizeof(buf), -1)) >=
+		       KNOT_WIRE_HEADER_SIZE) {
+			usleep(DELAY_MS * 1000);
+
+			knot_pkt_t *query = knot_pkt_new(buf, len, NULL);
+			knot_pkt_t *resp = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+			if (knot_pkt_parse(query, 0) == KNOT_EOK &&
+			    knot_pkt_init_response(resp, query) == KNOT_EOK) {
+				master_answer(client, query, resp);
+			}
+			knot_pkt_free(&query);
+			knot_pkt_free(&resp);
+		}
+		close(client);
+	}
+
+	return NULL;
+}
+
+static zone_t *create_zone(void)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc("test.");
+	zone_t *zone = zone_new(name);
+	knot_dname_free(&name, NULL);
+	if (zone == NULL) {
+		return NULL;
+	}
+	zone->contents = zone_contents_new(zone->name, true);
+
+	knot_rrset_t soa;
+	knot_rrset_init(&soa, zone->name, KNOT_RRTYPE_SOA, KNOT_CLASS_IN);
+	knot_rrset_add_rdata(&soa, SOA_RDATA, sizeof(SOA_RDATA), 3600, NULL);
+	zone_node_t *node = NULL;
+	int ret = zone_contents_add_rr(zone->contents, &soa, &node);
+	knot_rdataset_clear(&soa.rrs, NULL);
+
+	if (ret != KNOT_EOK || zone_contents_adjust_full(zone->contents) != KNOT_EOK) {
+		zone_free(&zone);
+		return NULL;
+	}
+
+	return zone;
+}
+
+/*! Waits until the running event is suspended or finished. */
+static bool wait_event(zone_t *zone, bool suspended)
+{
+	for (int i = 0; i < 5 * DELAY_MS / 10; i++) {
+		pthread_mutex_lock(&zone->events.mx);
+		bool done = suspended ? zone->events.suspended : !zone->events.running;
+		pthread_mutex_unlock(&zone->events.mx);
+		if (done) {
+			return true;
+		}
+		usleep(10 * 1000);
+	}
+
+	return false;
+}
+
+static void task_post(task_t *task)
+{
+	sem_post(task->ctx);
+}
+
+/*! Checks that the only worker runs a task soon. */
+static bool worker_free(worker_pool_t *pool)
+{
+	sem_t done;
+	sem_init(&done, 0, 0);
+	task_t task = { .run = task_post, .ctx = &done };
+	worker_pool_assign(pool, &task);
+
+	struct timespec timeout;
+	clock_gettime(CLOCK_REALTIME, &timeout);
+	timeout.tv_nsec += DELAY_MS / 2 * 1000000L;
+	timeout.tv_sec += timeout.tv_nsec / 1000000000L;
+	timeout.tv_nsec %= 1000000000L;
+	bool free = (sem_timedwait(&done, &timeout) == 0);
+	sem_destroy(&done);
+
+	return free;
+}
+
+static void test_refresh(zone_t *zone, worker_pool_t *pool)
+{
+	zone_events_enqueue(zone, ZONE_EVENT_REFRESH);
+	ok(wait_event(zone, true), "refresh suspended for the SOA query");
+
+	// The only worker is free while the master answers.
+	ok(worker_free(pool), "worker free during the SOA query");
+	ok(zone->timers.last_refresh == 0, "no refresh before the answer");
+
+	ok(wait_event(zone, false), "refresh finished");
+	time_t now = time(NULL);
+	ok(zone->timers.last_refresh > 0 && zone->timers.last_refresh <= now,
+	   "last refresh set");
+	ok(zone->timers.next_refresh > now + SOA_REFRESH / 2 &&
+	   zone->timers.next_refresh <= now + SOA_REFRESH,
+	   "next refresh planned by the SOA");
+}
+
+static void test_transfer(zone_t *zone, worker_pool_t *pool)
+{
+	zone->timers.last_refresh = 0;
+	master_serial = 2;
+
+	zone_events_enqueue(zone, ZONE_EVENT_REFRESH);
+	ok(wait_event(zone, true), "refresh suspended for the SOA query");
+
+	// After the SOA answer, the master answers the transfer query.
+	usleep(DELAY_MS * 1000);
+	ok(worker_free(pool), "worker free during the transfer");
+	ok(zone->events.suspended, "refresh suspended for the transfer");
+	ok(zone->timers.last_refresh == 0, "no refresh before the transfer");
+
+	ok(wait_event(zone, false), "refresh finished");
+	ok(zone->timers.last_refresh > 0, "last refresh set");
+	is_int(2, zone_contents_serial(zone->contents), "zone transferred");
+}
+
+static void test_freeze(zone_t *zone)
+{
+	zone->timers.last_refresh = 0;
+
+	zone_events_enqueue(zone, ZONE_EVENT_REFRESH);
+	ok(wait_event(zone, true), "refresh suspended for the SOA query");
+
+	struct timespec begin = time_now();
+	zone_events_freeze(zone);
+	struct timespec end = time_now();
+
+	ok(time_diff_ms(&begin, &end) >= DELAY_MS / 2, "freeze waits for the SOA query");
+	ok(!zone->events.running && !zone->events.suspended, "refresh finished by freeze");
+	ok(zone->timers.last_refresh == 0, "frozen refresh not continued");
+}
+
+static void interrupt_handle(int s)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	struct sigaction sa;
+	sa.sa_handler = interrupt_handle;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGALRM, &sa, NULL); // Interrupt
+
+	char *dir = test_mkdtemp();
+	ok(dir != NULL, "make temporary directory");
+
+	int ret = kasp_db_init(kaspdb(), dir, 10 * 1024 * 1024);
+	is_int(KNOT_EOK, ret, "initialize KASP database");
+
+	// Start the master.
+	struct sockaddr_storage master = { 0 };
+	sockaddr_set(&master, AF_INET, "127.0.0.1", 0);
+	int master_fd = net_bound_socket(SOCK_STREAM, (struct sockaddr *)&master, 0);
+	ok(master_fd >= 0 && listen(master_fd, 10) == 0, "start master");
+	socklen_t addr_len = sockaddr_len((struct sockaddr *)&master);
+	getsockname(master_fd, (struct sockaddr *)&master, &addr_len);
+	pthread_t thread;
+	pthread_create(&thread, NULL, master_thread, &master_fd);
+
+	char conf_str[512];
+	(void)snprintf(conf_str, sizeof(conf_str),
+	               "remote:\n  - id: master\n    address: 127.0.0.1@%d\n"
+	               "zone:\n  - domain: test.\n    master: master\n",
+	               sockaddr_port((struct sockaddr *)&master));
+	ret = test_conf(conf_str, NULL);
+	is_int(KNOT_EOK, ret, "load configuration");
+
+	evsched_t sched = { 0 };
+	ret = evsched_init(&sched, NULL);
+	is_int(KNOT_EOK, ret, "create scheduler");
+	worker_pool_t *pool = worker_pool_create(1);
+	ok(pool != NULL, "create worker pool");
+	worker_pool_start(pool);
+	struct knot_request_loop *loop = knot_request_loop_create(1);
+	ok(loop != NULL, "create request loop");
+
+	zone_t *zone = create_zone();
+	ok(zone != NULL, "create zone");
+	ret = zone_events_setup(zone, pool, &sched, NULL);
+	is_int(KNOT_EOK, ret, "zone events setup");
+	zone->requests = loop;
+
+	test_refresh(zone, pool);
+	test_transfer(zone, pool);
+	test_freeze(zone);
+
+	zone_free(&zone);
+	knot_request_loop_destroy(loop);
+	worker_pool_stop(pool);
+	worker_pool_join(pool);
+	worker_pool_destroy(pool);
+	evsched_deinit(&sched);
+
+	shutdown(master_fd, SHUT_RDWR);
+	pthread_join(thread, NULL);
+	close(master_fd);
+
+	conf_free(conf());
+	kasp_db_close(kaspdb());
+	test_rm_rf(dir);
+	free(dir);
+
+	return 0;
+}
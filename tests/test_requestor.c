@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #include "libknot/descriptor.h"
 #include "libknot/errcode.h"
@@ -28,6 +29,7 @@
 #include "contrib/mempattern.h"
 #include "contrib/net.h"
 #include "contrib/sockaddr.h"
+#include "contrib/time.h"
 #include "contrib/ucw/mempool.h"
 
 /* @note Purpose of this test is not to verify process_answer functionality,
@@ -40,6 +42,10 @@ static int out(knot_layer_t *ctx, knot_pkt_t *pkt) { return KNOT_STATE_CONSUME;
 
 static const int TIMEOUT = 2000;
 
+/* Delayed answers of the asynchronous requests. */
+#define DELAY_MS    500
+#define ASYNC_COUNT 32
+
 /*! \brief Dummy answer processing module. */
 const knot_layer_api_t dummy_module = {
         &begin, &reset, &finish, &in, &out
@@ -76,26 +82,140 @@ static void *responder_thread(void *arg)
 	return NULL;
 }
 
+/* Stand-in master answering each UDP query after a delay. */
+static void *delayed_responder_thread(void *arg)
+{
+	int fd = *(int *)arg;
+
+	struct {
+		struct sockaddr_storage addr;
+		socklen_t addr_len;
+		uint8_t buf[512];
+		ssize_t len;
+		struct timespec due;
+	} queue[ASYNC_COUNT];
+	unsigned head = 0, tail = 0;
+
+	while (true) {
+		int timeout = -1;
+		if (head < tail) {
+			struct timespec now = time_now();
+			double wait = time_diff_ms(&now, &queue[head % ASYNC_COUNT].due);
+			timeout = (wait > 0) ? (int)wait + 1 : 0;
+		}
+
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		if (poll(&pfd, 1, timeout) > 0 && tail - head < ASYNC_COUNT) {
+			typeof(queue[0]) *q = &queue[tail % ASYNC_COUNT];
+			q->addr_len = sizeof(q->addr);
+			q->len = recvfrom(fd, q->buf, sizeof(q->buf), 0,
+			                  (struct sockaddr *)&q->addr, &q->addr_len);
+			if (q->len < KNOT_WIRE_HEADER_SIZE) {
+				break;
+			}
+			q->due = time_now();
+			q->due.tv_nsec += DELAY_MS * 1000000L;
+			q->due.tv_sec += q->due.tv_nsec / 1000000000L;
+			q->due.tv_nsec %= 1000000000L;
+			tail++;
+		}
+
+		struct timespec now = time_now();
+		while (head < tail) {
+			typeof(queue[0]) *q = &queue[head % ASYNC_COUNT];
+			if (time_diff_ms(&now, &q->due) > 0) {
+				break;
+			}
+			knot_wire_set_qr(q->buf);
+			sendto(fd, q->buf, q->len, 0, (struct sockaddr *)&q->addr,
+			       q->addr_len);
+			head++;
+		}
+	}
+
+	return NULL;
+}
+
 /* Test implementations. */
 
-static struct knot_request *make_query(struct knot_requestor *requestor,
+static struct knot_request *make_query(knot_mm_t *mm,
                                        const struct sockaddr_storage *dst,
-                                       const struct sockaddr_storage *src)
+                                       const struct sockaddr_storage *src,
+                                       unsigned flags)
 {
-	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, requestor->mm);
+	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, mm);
 	assert(pkt);
 	static const knot_dname_t *root = (uint8_t *)"";
 	knot_pkt_put_question(pkt, root, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
 
-	return knot_request_make(requestor->mm, (struct sockaddr *)dst,
-	                         (struct sockaddr *)src, pkt, NULL, 0);
+	return knot_request_make(mm, (struct sockaddr *)dst,
+	                         (struct sockaddr *)src, pkt, NULL, flags);
+}
+
+/* Completion of asynchronous requests. */
+struct async_result {
+	pthread_mutex_t mx;
+	pthread_cond_t cond;
+	unsigned done;
+	unsigned ok;
+	int ret;
+};
+
+static void async_done(struct knot_request *req, int ret, void *ctx)
+{
+	struct async_result *res = ctx;
+
+	pthread_mutex_lock(&res->mx);
+	res->done++;
+	res->ok += (ret == KNOT_EOK);
+	res->ret = ret;
+	pthread_cond_broadcast(&res->cond);
+	pthread_mutex_unlock(&res->mx);
+
+	knot_request_free(req, NULL);
+}
+
+static void async_init(struct async_result *res)
+{
+	memset(res, 0, sizeof(*res));
+	pthread_mutex_init(&res->mx, NULL);
+	pthread_cond_init(&res->cond, NULL);
+}
+
+static void async_wait(struct async_result *res, unsigned count)
+{
+	pthread_mutex_lock(&res->mx);
+	while (res->done < count) {
+		pthread_cond_wait(&res->cond, &res->mx);
+	}
+	pthread_mutex_unlock(&res->mx);
+}
+
+static void async_deinit(struct async_result *res)
+{
+	pthread_cond_destroy(&res->cond);
+	pthread_mutex_destroy(&res->mx);
+}
+
+static int async_submit(struct knot_request_loop *loop,
+                        const struct sockaddr_storage *dst,
+                        const struct sockaddr_storage *src,
+                        unsigned flags, int timeout, struct async_result *res)
+{
+	struct knot_request *req = make_query(NULL, dst, src, flags);
+	int ret = knot_request_loop_submit(loop, &dummy_module, NULL, req,
+	                                   timeout, async_done, res);
+	if (ret != KNOT_EOK) {
+		knot_request_free(req, NULL);
+	}
+	return ret;
 }
 
 static void test_disconnected(struct knot_requestor *requestor,
                               const struct sockaddr_storage *dst,
                               const struct sockaddr_storage *src)
 {
-	struct knot_request *req = make_query(requestor, dst, src);
+	struct knot_request *req = make_query(requestor->mm, dst, src, 0);
 	int ret = knot_requestor_exec(requestor, req, TIMEOUT);
 	is_int(KNOT_ECONN, ret, "requestor: disconnected/exec");
 	knot_request_free(req, requestor->mm);
@@ -107,12 +227,88 @@ static void test_connected(struct knot_requestor *requestor,
                            const struct sockaddr_storage *src)
 {
 	/* Enqueue packet. */
-	struct knot_request *req = make_query(requestor, dst, src);
+	struct knot_request *req = make_query(requestor->mm, dst, src, 0);
 	int ret = knot_requestor_exec(requestor, req, TIMEOUT);
 	is_int(KNOT_EOK, ret, "requestor: connected/exec");
 	knot_request_free(req, requestor->mm);
 }
 
+static void test_async_delayed(struct knot_request_loop *loop,
+                               const struct sockaddr_storage *dst,
+                               const struct sockaddr_storage *src)
+{
+	struct async_result res;
+	async_init(&res);
+
+	struct timespec begin = time_now();
+	unsigned submitted = 0;
+	for (unsigned i = 0; i < ASYNC_COUNT; ++i) {
+		submitted += (async_submit(loop, dst, src, KNOT_RQ_UDP, TIMEOUT,
+		                           &res) == KNOT_EOK);
+	}
+	ok(submitted == ASYNC_COUNT, "requestor: async/submit");
+
+	async_wait(&res, submitted);
+	struct timespec end = time_now();
+
+	ok(res.ok == ASYNC_COUNT, "requestor: async/delayed answers");
+	ok(time_diff_ms(&begin, &end) < 4 * DELAY_MS,
+	   "requestor: async/concurrent exchanges");
+
+	async_deinit(&res);
+}
+
+static void test_async_tcp(struct knot_request_loop *loop,
+                           const struct sockaddr_storage *dst,
+                           const struct sockaddr_storage *src)
+{
+	struct async_result res;
+	async_init(&res);
+
+	int ret = async_submit(loop, dst, src, 0, TIMEOUT, &res);
+	if (ret == KNOT_EOK) {
+		async_wait(&res, 1);
+		ret = res.ret;
+	}
+	is_int(KNOT_EOK, ret, "requestor: async/tcp");
+
+	async_deinit(&res);
+}
+
+static void test_async_timeout(struct knot_request_loop *loop,
+                               const struct sockaddr_storage *dst,
+                               const struct sockaddr_storage *src)
+{
+	struct async_result res;
+	async_init(&res);
+
+	int ret = async_submit(loop, dst, src, KNOT_RQ_UDP, 1000, &res);
+	if (ret == KNOT_EOK) {
+		async_wait(&res, 1);
+		ret = res.ret;
+	}
+	is_int(KNOT_ETIMEOUT, ret, "requestor: async/timeout");
+
+	async_deinit(&res);
+}
+
+static void test_async_cancel(const struct sockaddr_storage *dst,
+                              const struct sockaddr_storage *src)
+{
+	struct async_result res;
+	async_init(&res);
+
+	struct knot_request_loop *loop = knot_request_loop_create(1);
+	int ret = async_submit(loop, dst, src, KNOT_RQ_UDP, -1, &res);
+	knot_request_loop_destroy(loop);
+	if (ret == KNOT_EOK) {
+		ret = res.ret;
+	}
+	ok(res.done == 1 && ret == KNOT_ENOTRUNNING, "requestor: async/cancel");
+
+	async_deinit(&res);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -149,8 +345,45 @@ int main(int argc, char *argv[])
 	/* Test requestor in connected environment. */
 	test_connected(&requestor, &server, &client);
 
+	int conn;
+
+	/* Start delaying master and a silent one. */
+	struct sockaddr_storage delayed = { 0 };
+	sockaddr_set(&delayed, AF_INET, "127.0.0.1", 0);
+	int delayed_fd = net_bound_socket(SOCK_DGRAM, (struct sockaddr *)&delayed, 0);
+	assert(delayed_fd >= 0);
+	addr_len = sockaddr_len((struct sockaddr *)&delayed);
+	getsockname(delayed_fd, (struct sockaddr *)&delayed, &addr_len);
+	pthread_t delayed_thread;
+	pthread_create(&delayed_thread, 0, delayed_responder_thread, &delayed_fd);
+
+	struct sockaddr_storage silent = { 0 };
+	sockaddr_set(&silent, AF_INET, "127.0.0.1", 0);
+	int silent_fd = net_bound_socket(SOCK_DGRAM, (struct sockaddr *)&silent, 0);
+	assert(silent_fd >= 0);
+	addr_len = sockaddr_len((struct sockaddr *)&silent);
+	getsockname(silent_fd, (struct sockaddr *)&silent, &addr_len);
+
+	/* Test asynchronous requests. */
+	struct knot_request_loop *loop = knot_request_loop_create(2);
+	ok(loop != NULL, "requestor: async/create loop");
+	test_async_delayed(loop, &delayed, &client);
+	test_async_tcp(loop, &server, &client);
+	test_async_timeout(loop, &silent, &client);
+	knot_request_loop_destroy(loop);
+	test_async_cancel(&silent, &client);
+
+	/* Terminate delaying master. */
+	conn = net_connected_socket(SOCK_DGRAM, (struct sockaddr *)&delayed, NULL);
+	assert(conn > 0);
+	send(conn, "", 1, 0);
+	close(conn);
+	pthread_join(delayed_thread, NULL);
+	close(delayed_fd);
+	close(silent_fd);
+
 	/* Terminate responder. */
-	int conn = net_connected_socket(SOCK_STREAM, (struct sockaddr *)&server, NULL);
+	conn = net_connected_socket(SOCK_STREAM, (struct sockaddr *)&server, NULL);
 	assert(conn > 0);
 	conn = net_dns_tcp_send(conn, (uint8_t *)"", 1, TIMEOUT);
 	assert(conn > 0);
@@ -43,7 +43,7 @@ static inline void create_root_zone(server_t *server, knot_mm_t *mm)
 	/* Insert root zone. */
 	zone_t *root = zone_new(ROOT_DNAME);
 	root->journal_db = &server->journal_db;
-	root->contents = zone_contents_new(root->name);
+	root->contents = zone_contents_new(root->name, true);
 
 	knot_rrset_t *soa = knot_rrset_new(root->name, KNOT_RRTYPE_SOA, KNOT_CLASS_IN, mm);
 	knot_rrset_add_rdata(soa, SOA_RDATA, SOA_RDLEN, 7200, mm);
@@ -57,7 +57,6 @@ static inline void create_root_zone(server_t *server, knot_mm_t *mm)
 	knot_zonedb_free(&server->zone_db);
 	server->zone_db = knot_zonedb_new(1);
 	knot_zonedb_insert(server->zone_db, root);
-	knot_zonedb_build_index(server->zone_db);
 }
 
 /* Create fake server. */
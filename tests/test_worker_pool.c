@@ -21,6 +21,7 @@
 #include <sched.h>
 #include <signal.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "knot/worker/pool.h"
 #include "knot/worker/queue.h"
@@ -61,6 +62,246 @@ static void task_counting(task_t *task)
 	pthread_mutex_unlock(&log->mx);
 }
 
+/*!
+ * Task execution order log.
+ */
+typedef struct order_log {
+	pthread_mutex_t mx;
+	task_prio_t order[TASKS_BATCH];
+	unsigned count;
+} order_log_t;
+
+/*!
+ * Records the task priority in the order log.
+ */
+static void task_ordering(task_t *task)
+{
+	order_log_t *log = task->ctx;
+
+	pthread_mutex_lock(&log->mx);
+	if (log->count < TASKS_BATCH) {
+		log->order[log->count++] = task->prio;
+	}
+	pthread_mutex_unlock(&log->mx);
+}
+
+/*!
+ * Task start order log.
+ */
+typedef struct seq_log {
+	pthread_mutex_t mx;
+	task_t *tasks;
+	unsigned order[TASKS_BATCH];
+	unsigned count;
+} seq_log_t;
+
+/*!
+ * Records the task index in the start order log.
+ */
+static void task_sequence(task_t *task)
+{
+	seq_log_t *log = task->ctx;
+
+	pthread_mutex_lock(&log->mx);
+	if (log->count < TASKS_BATCH) {
+		log->order[log->count++] = task - log->tasks;
+	}
+	pthread_mutex_unlock(&log->mx);
+}
+
+/*!
+ * Blocks until the log lock is released.
+ */
+static void task_blocking(task_t *task)
+{
+	task_log_t *log = task->ctx;
+
+	pthread_mutex_lock(&log->mx);
+	pthread_mutex_unlock(&log->mx);
+}
+
+/*!
+ * Wait until the count of executed tasks is reached.
+ */
+static bool executed_wait(task_log_t *log, unsigned count)
+{
+	for (int i = 0; i < 5000; i++) {
+		pthread_mutex_lock(&log->mx);
+		bool done = (log->executed >= count);
+		pthread_mutex_unlock(&log->mx);
+		if (done) {
+			return true;
+		}
+		usleep(1000);
+	}
+
+	return false;
+}
+
+static void test_priority(void)
+{
+	worker_pool_t *pool = worker_pool_create(1);
+	ok(pool != NULL, "priority: create worker pool");
+	if (!pool) {
+		return;
+	}
+
+	order_log_t log = {
+		.mx = PTHREAD_MUTEX_INITIALIZER,
+	};
+
+	// enqueue in the reverse order while the pool is stopped
+
+	const task_prio_t prios[] = { TASK_PRIO_LOW, TASK_PRIO_NORMAL, TASK_PRIO_HIGH };
+	task_t tasks[TASKS_BATCH];
+	for (int i = 0; i < TASKS_BATCH; i++) {
+		tasks[i].run = task_ordering;
+		tasks[i].ctx = &log;
+		tasks[i].prio = prios[i * 3 / TASKS_BATCH];
+		worker_pool_assign(pool, &tasks[i]);
+	}
+
+	worker_pool_stats_t stats;
+	worker_pool_stats(pool, TASK_PRIO_HIGH, &stats);
+	ok(stats.queued > 0 && stats.executed == 0, "priority: queued stats");
+
+	worker_pool_start(pool);
+	worker_pool_wait(pool);
+
+	bool ordered = (log.count == TASKS_BATCH);
+	for (int i = 1; ordered && i < TASKS_BATCH; i++) {
+		// HIGH, NORMAL, LOW order of the classes.
+		static const int rank[TASK_PRIO_COUNT] = { 1, 0, 2 };
+		ordered = rank[log.order[i - 1]] <= rank[log.order[i]];
+	}
+	ok(ordered, "priority: higher classes executed first");
+
+	unsigned executed = 0;
+	for (task_prio_t prio = 0; prio < TASK_PRIO_COUNT; prio++) {
+		worker_pool_stats(pool, prio, &stats);
+		executed += stats.executed;
+		ok(stats.queued == 0, "priority: class %i drained", prio);
+	}
+	ok(executed == TASKS_BATCH, "priority: executed stats");
+
+	worker_pool_stop(pool);
+	worker_pool_join(pool);
+	worker_pool_destroy(pool);
+	pthread_mutex_destroy(&log.mx);
+}
+
+static void test_stealing(void)
+{
+	worker_pool_t *pool = worker_pool_create(2);
+	ok(pool != NULL, "stealing: create worker pool");
+	if (!pool) {
+		return;
+	}
+	worker_pool_start(pool);
+
+	task_log_t block = {
+		.mx = PTHREAD_MUTEX_INITIALIZER,
+	};
+	task_log_t log = {
+		.mx = PTHREAD_MUTEX_INITIALIZER,
+	};
+
+	// one worker is blocked, the other one must take over its queue
+
+	pthread_mutex_lock(&block.mx);
+	task_t blocker = { .run = task_blocking, .ctx = &block };
+	worker_pool_assign(pool, &blocker);
+
+	task_t task = { .run = task_counting, .ctx = &log };
+	for (int i = 0; i < TASKS_BATCH; i++) {
+		worker_pool_assign(pool, &task);
+	}
+
+	ok(executed_wait(&log, TASKS_BATCH), "stealing: all tasks executed");
+	pthread_mutex_unlock(&block.mx);
+	worker_pool_wait(pool);
+
+	worker_pool_stats_t stats;
+	worker_pool_stats(pool, TASK_PRIO_NORMAL, &stats);
+	ok(stats.stolen > 0, "stealing: stolen stats");
+
+	worker_pool_stop(pool);
+	worker_pool_join(pool);
+	worker_pool_destroy(pool);
+	pthread_mutex_destroy(&block.mx);
+	pthread_mutex_destroy(&log.mx);
+}
+
+static void test_stealing_order(void)
+{
+	worker_pool_t *pool = worker_pool_create(2);
+	ok(pool != NULL, "stealing order: create worker pool");
+	if (!pool) {
+		return;
+	}
+	worker_pool_start(pool);
+
+	// block both workers
+
+	task_log_t block[2];
+	task_t blockers[2];
+	for (int i = 0; i < 2; i++) {
+		pthread_mutex_init(&block[i].mx, NULL);
+		pthread_mutex_lock(&block[i].mx);
+		blockers[i] = (task_t){ .run = task_blocking, .ctx = &block[i] };
+		worker_pool_assign(pool, &blockers[i]);
+	}
+
+	worker_pool_stats_t stats = { 0 };
+	for (int i = 0; i < 5000 && stats.executed < 2; i++) {
+		worker_pool_stats(pool, TASK_PRIO_NORMAL, &stats);
+		usleep(1000);
+	}
+
+	// the tasks are spread over both queues, one worker serves them all
+
+	task_t tasks[TASKS_BATCH];
+	seq_log_t log = {
+		.mx = PTHREAD_MUTEX_INITIALIZER,
+		.tasks = tasks,
+	};
+	for (int i = 0; i < TASKS_BATCH; i++) {
+		tasks[i] = (task_t){ .run = task_sequence, .ctx = &log };
+		worker_pool_assign(pool, &tasks[i]);
+	}
+	pthread_mutex_unlock(&block[0].mx);
+
+	unsigned count = 0;
+	for (int i = 0; i < 5000 && count < TASKS_BATCH; i++) {
+		pthread_mutex_lock(&log.mx);
+		count = log.count;
+		pthread_mutex_unlock(&log.mx);
+		usleep(1000);
+	}
+
+	// the own and the stolen tasks are both started from the oldest
+
+	bool ordered = (count == TASKS_BATCH);
+	unsigned last[2] = { 0, 1 };
+	for (int i = 0; ordered && i < TASKS_BATCH; i++) {
+		unsigned idx = log.order[i];
+		ordered = (idx == last[idx % 2]);
+		last[idx % 2] += 2;
+	}
+	ok(ordered, "stealing order: tasks started in assignment order");
+
+	pthread_mutex_unlock(&block[1].mx);
+	worker_pool_wait(pool);
+
+	worker_pool_stop(pool);
+	worker_pool_join(pool);
+	worker_pool_destroy(pool);
+	for (int i = 0; i < 2; i++) {
+		pthread_mutex_destroy(&block[i].mx);
+	}
+	pthread_mutex_destroy(&log.mx);
+}
+
 static void interrupt_handle(int s)
 {
 }
@@ -112,6 +353,17 @@ int main(void)
 	worker_pool_wait(pool);
 	ok(executed_reset(&log) == TASKS_BATCH, "executed count after add");
 
+	// add jobs at once
+
+	task_t *tasks[TASKS_BATCH];
+	for (int i = 0; i < TASKS_BATCH; i++) {
+		tasks[i] = &task;
+	}
+	worker_pool_assign_batch(pool, tasks, TASKS_BATCH);
+
+	worker_pool_wait(pool);
+	ok(executed_reset(&log) == TASKS_BATCH, "executed count after batch add");
+
 	// temporary suspension
 
 	worker_pool_suspend(pool);
@@ -148,5 +400,9 @@ int main(void)
 
 	pthread_mutex_destroy(&log.mx);
 
+	test_priority();
+	test_stealing();
+	test_stealing_order();
+
 	return 0;
 }
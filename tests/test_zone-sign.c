@@ -0,0 +1,232 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <tap/basic.h>
+#include <tap/files.h>
+
+#include "dnssec/crypto.h"
+#include "dnssec/error.h"
+#include "dnssec/keystore.h"
+#include "dnssec/sign.h"
+#include "knot/dnssec/zone-sign.h"
+#include "knot/updates/zone-update.h"
+#include "libknot/libknot.h"
+
+#define NODES	5000	/*!< Enough nodes for four signing ranges. */
+#define NOW	1500000000
+
+static const uint8_t SOA_RDATA[] = {
+	0x02, 'n', 's', 0x00,
+	0x04, 'm', 'a', 'i', 'l', 0x00,
+	0x00, 0x00, 0x00, 0x01,
+	0x00, 0x00, 0x0e, 0x10,
+	0x00, 0x00, 0x0e, 0x10,
+	0x00, 0x00, 0x0e, 0x10,
+	0x00, 0x00, 0x0e, 0x10
+};
+
+static zone_contents_t *create_contents(const knot_dname_t *apex)
+{
+	zone_contents_t *contents = zone_contents_new(apex, false);
+	if (contents == NULL) {
+		return NULL;
+	}
+
+	knot_rrset_t soa;
+	knot_rrset_init(&soa, (knot_dname_t *)apex, KNOT_RRTYPE_SOA, KNOT_CLASS_IN);
+	knot_rrset_add_rdata(&soa, SOA_RDATA, sizeof(SOA_RDATA), 3600, NULL);
+	zone_node_t *node = NULL;
+	int ret = zone_contents_add_rr(contents, &soa, &node);
+	knot_rdataset_clear(&soa.rrs, NULL);
+
+	for (unsigned i = 0; i < NODES && ret == KNOT_EOK; i++) {
+		char name_str[KNOT_DNAME_TXT_MAXLEN + 1];
+		(void)snprintf(name_str, sizeof(name_str), "n%u.test.", i);
+		uint8_t owner[KNOT_DNAME_MAXLEN];
+		knot_dname_from_str(owner, name_str, sizeof(owner));
+
+		uint8_t addr[4] = { 192, 0, i / 256, i % 256 };
+		knot_rrset_t a;
+		knot_rrset_init(&a, owner, KNOT_RRTYPE_A, KNOT_CLASS_IN);
+		knot_rrset_add_rdata(&a, addr, sizeof(addr), 3600, NULL);
+		node = NULL;
+		ret = zone_contents_add_rr(contents, &a, &node);
+		knot_rdataset_clear(&a.rrs, NULL);
+	}
+
+	if (ret != KNOT_EOK || zone_contents_adjust_full(contents) != KNOT_EOK) {
+		zone_contents_deep_free(&contents);
+		return NULL;
+	}
+
+	return contents;
+}
+
+/*! Generates a ZSK with deterministic signatures. */
+static int create_keyset(const char *dir, const knot_dname_t *apex,
+                         dnssec_keystore_t **store, zone_keyset_t *keyset)
+{
+	char *id = NULL;
+	int ret = dnssec_keystore_init_pkcs8_dir(store);
+	if (ret == DNSSEC_EOK) {
+		ret = dnssec_keystore_init(*store, dir);
+	}
+	if (ret == DNSSEC_EOK) {
+		ret = dnssec_keystore_open(*store, dir);
+	}
+	if (ret == DNSSEC_EOK) {
+		ret = dnssec_keystore_generate_key(*store, DNSSEC_KEY_ALGORITHM_RSA_SHA256,
+		                                   1024, &id);
+	}
+	if (ret != DNSSEC_EOK) {
+		return ret;
+	}
+
+	keyset->keys = calloc(1, sizeof(zone_key_t));
+	if (keyset->keys == NULL) {
+		free(id);
+		return DNSSEC_ENOMEM;
+	}
+	keyset->count = 1;
+
+	zone_key_t *key = &keyset->keys[0];
+	key->is_zsk = true;
+	key->is_active = true;
+	key->is_public = true;
+
+	ret = dnssec_key_new(&key->key);
+	if (ret == DNSSEC_EOK) {
+		dnssec_key_set_dname(key->key, apex);
+		dnssec_key_set_flags(key->key, 256);
+		dnssec_key_set_algorithm(key->key, DNSSEC_KEY_ALGORITHM_RSA_SHA256);
+		ret = dnssec_key_import_keystore(key->key, *store, id);
+	}
+	if (ret == DNSSEC_EOK) {
+		ret = dnssec_sign_new(&key->ctx, key->key);
+	}
+	free(id);
+
+	return ret;
+}
+
+static int sign(zone_t *zone, zone_keyset_t *keyset, size_t threads,
+                zone_update_t *update)
+{
+	zone_contents_t *contents = create_contents(zone->name);
+	if (contents == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = zone_update_from_contents(update, zone, contents, UPDATE_INCREMENTAL);
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&contents);
+		return ret;
+	}
+
+	knot_kasp_policy_t policy = {
+		.rrsig_lifetime = 14 * 24 * 3600,
+		.rrsig_refresh_before = 7 * 24 * 3600,
+		.signing_threads = threads,
+	};
+	kdnssec_ctx_t ctx = {
+		.now = NOW,
+		.policy = &policy,
+	};
+
+	knot_time_t expire = 0;
+	return knot_zone_sign(update, keyset, &ctx, &expire);
+}
+
+/*! Checks that every node got a signature and the changesets are the same. */
+static void test_changesets(const changeset_t *single, const changeset_t *parallel)
+{
+	changeset_iter_t it_single, it_parallel;
+	changeset_iter_add(&it_single, single);
+	changeset_iter_add(&it_parallel, parallel);
+
+	size_t rrsigs = 0;
+	bool equal = true;
+	knot_rrset_t rr_single = changeset_iter_next(&it_single);
+	knot_rrset_t rr_parallel = changeset_iter_next(&it_parallel);
+	while (!knot_rrset_empty(&rr_single) || !knot_rrset_empty(&rr_parallel)) {
+		if (!knot_rrset_equal(&rr_single, &rr_parallel, KNOT_RRSET_COMPARE_WHOLE)) {
+			equal = false;
+		}
+		if (rr_parallel.type == KNOT_RRTYPE_RRSIG) {
+			rrsigs++;
+		}
+		rr_single = changeset_iter_next(&it_single);
+		rr_parallel = changeset_iter_next(&it_parallel);
+	}
+	changeset_iter_clear(&it_single);
+	changeset_iter_clear(&it_parallel);
+
+	changeset_iter_rem(&it_parallel, parallel);
+	rr_parallel = changeset_iter_next(&it_parallel);
+	ok(knot_rrset_empty(&rr_parallel), "no removals");
+	changeset_iter_clear(&it_parallel);
+	is_int(NODES + 1, rrsigs, "every node signed");
+	ok(equal, "same as single-thread signing");
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	dnssec_crypto_init();
+
+	char *dir = test_mkdtemp();
+	ok(dir != NULL, "make temporary directory");
+
+	knot_dname_t *apex = knot_dname_from_str_alloc("test.");
+	zone_t *zone = zone_new(apex);
+	ok(zone != NULL, "create zone");
+
+	dnssec_keystore_t *store = NULL;
+	zone_keyset_t keyset = { 0 };
+	int ret = create_keyset(dir, apex, &store, &keyset);
+	is_int(DNSSEC_EOK, ret, "create zone key");
+
+	zone_update_t single, parallel;
+	ret = sign(zone, &keyset, 1, &single);
+	is_int(KNOT_EOK, ret, "sign zone with one thread");
+	ret = sign(zone, &keyset, 4, &parallel);
+	is_int(KNOT_EOK, ret, "sign zone with four threads");
+
+	is_int(changeset_size(&single.change), changeset_size(&parallel.change),
+	       "changeset size");
+	test_changesets(&single.change, &parallel.change);
+
+	zone_update_clear(&single);
+	zone_update_clear(&parallel);
+
+	if (keyset.count > 0) {
+		dnssec_key_free(keyset.keys[0].key);
+	}
+	free_zone_keys(&keyset);
+	dnssec_keystore_deinit(store);
+	zone_free(&zone);
+	knot_dname_free(&apex, NULL);
+
+	dnssec_crypto_cleanup();
+
+	test_rm_rf(dir);
+	free(dir);
+
+	return 0;
+}
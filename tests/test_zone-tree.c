@@ -66,14 +66,88 @@ static int ztree_iter_data(zone_node_t **node, void *data)
 	return result;
 }
 
+static int count_node(zone_node_t **node, void *data)
+{
+	unsigned *count = data;
+	(*count)++;
+	node_free(node, NULL);
+	return KNOT_EOK;
+}
+
+static zone_node_t *ztree_get(zone_tree_t *tree, const knot_dname_t *owner)
+{
+	zone_node_t *node = NULL;
+	(void)zone_tree_get(tree, owner, &node);
+	return node;
+}
+
+static void test_cow(bool commit)
+{
+	const char *prefix = commit ? "ztree: cow commit" : "ztree: cow rollback";
+
+	zone_tree_t *from = zone_tree_create(ZONE_TREE_BINODES);
+	for (unsigned i = 0; i < NCOUNT; ++i) {
+		zone_node_t *node = zone_tree_node_new(from, NAME[i]);
+		node->rrset_count = 1;
+		(void)zone_tree_insert(from, node);
+	}
+	zone_tree_unify_binodes(from, NULL);
+
+	zone_tree_t *to = NULL;
+	int ret = zone_tree_cow(from, &to);
+	ok(ret == KNOT_EOK && to->flags == (ZONE_TREE_BINODES | ZONE_TREE_SECOND),
+	   "%s: create", prefix);
+
+	/* Change a shared node, remove one and insert a new one. */
+	zone_node_t *changed = ztree_get(to, NAME[2]);
+	changed->rrset_count = 2;
+	zone_node_t *removed = NULL;
+	ret = zone_tree_remove(to, NAME[3], &removed);
+	knot_dname_t *new_name = knot_dname_from_str_alloc("new.ac.");
+	zone_node_t *added = zone_tree_node_new(to, new_name);
+	ret += zone_tree_insert(to, added);
+	ok(ret == KNOT_EOK && binode_second(changed) && binode_second(removed) &&
+	   binode_second(added) && ztree_get(to, NAME[3]) == NULL &&
+	   ztree_get(to, new_name) == added && zone_tree_count(to) == NCOUNT,
+	   "%s: new version changed", prefix);
+
+	zone_node_t *old = ztree_get(from, NAME[2]);
+	ok(old == binode_counterpart(changed) && old->rrset_count == 1 &&
+	   ztree_get(from, NAME[3]) == binode_counterpart(removed) &&
+	   ztree_get(from, new_name) == NULL && zone_tree_count(from) == NCOUNT,
+	   "%s: old version intact", prefix);
+
+	unsigned dropped = 0;
+	if (commit) {
+		zone_tree_cow_commit(&from, to, count_node, &dropped);
+		old = ztree_get(to, NAME[2]);
+		ok(from == NULL && to->cow == NULL && dropped == 1 &&
+		   old == changed && ztree_get(to, new_name) == added,
+		   "%s: finished", prefix);
+		zone_tree_unify_binodes(to, NULL);
+		zone_tree_deep_free(&to);
+	} else {
+		zone_tree_cow_rollback(from, &to, count_node, &dropped);
+		zone_tree_unify_binodes(from, NULL);
+		old = ztree_get(from, NAME[2]);
+		ok(to == NULL && dropped == 1 && old->rrset_count == 1 &&
+		   binode_counterpart(old)->rrset_count == 1 &&
+		   ztree_get(from, NAME[3]) != NULL && ztree_get(from, new_name) == NULL,
+		   "%s: finished", prefix);
+		zone_tree_deep_free(&from);
+	}
+
+	knot_dname_free(&new_name, NULL);
+}
+
 int main(int argc, char *argv[])
 {
-	plan(5);
+	plan(16);
 
 	ztree_init_data();
 
 	/* 1. create test */
-	zone_tree_t* t = zone_tree_create();
+	zone_tree_t* t = zone_tree_create(0);
 	ok(t != NULL, "ztree: created");
 
 	/* 2. insert test */
@@ -112,6 +186,32 @@ int main(int argc, char *argv[])
 	ok (ret == KNOT_EOK, "ztree: ordered traversal");
 
 	zone_tree_free(&t);
+
+	/* 6. bulk load in reverse order */
+	t = zone_tree_create(0);
+	zone_node_t *nodes[NCOUNT];
+	for (unsigned j = 0; j < NCOUNT; ++j) {
+		nodes[j] = NODE + NCOUNT - 1 - j;
+	}
+	ret = zone_tree_load(t, nodes, NCOUNT);
+	ok(ret == KNOT_EOK && zone_tree_count(t) == NCOUNT, "ztree: bulk load");
+	i = 0;
+	ret = zone_tree_apply(t, ztree_iter_data, &i);
+	ok(ret == KNOT_EOK && ztree_get(t, NAME[1]) == NODE + 1,
+	   "ztree: bulk load ordered traversal");
+	ret = zone_tree_load(t, nodes, NCOUNT);
+	zone_tree_free(&t);
+	t = zone_tree_create(0);
+	nodes[1] = nodes[0];
+	ret += zone_tree_load(t, nodes, NCOUNT);
+	ok(ret == 2 * KNOT_EINVAL && zone_tree_is_empty(t),
+	   "ztree: bulk load into non-empty tree or with duplicates");
+	zone_tree_free(&t);
+
+	/* 7. copy-on-write */
+	test_cow(false);
+	test_cow(true);
+
 	ztree_free_data();
 	return 0;
 }
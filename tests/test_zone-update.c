@@ -15,13 +15,19 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <urcu.h>
 #include <tap/basic.h>
 #include <tap/files.h>
 
 #include "test_conf.h"
 #include "contrib/macros.h"
 #include "contrib/getline.h"
+#include "knot/updates/apply.h"
 #include "knot/updates/zone-update.h"
+#include "knot/dnssec/zone-nsec.h"
 #include "knot/zone/node.h"
 #include "zscanner/scanner.h"
 #include "knot/server/server.h"
@@ -203,6 +209,8 @@ void test_incremental(zone_t *zone, zs_scanner_t *sc)
 	const zone_node_t *synth_node = zone_update_get_apex(&update);
 	ok(synth_node && node_rdataset(synth_node, KNOT_RRTYPE_TXT)->rr_count == 2,
 	   "incremental zone update: add change");
+	ok(node_rdataset(zone->contents->apex, KNOT_RRTYPE_TXT)->rr_count == 1,
+	   "incremental zone update: old version intact");
 
 	if (zs_set_input_string(sc, del_str, strlen(del_str)) != 0 ||
 	    zs_parse_all(sc) != 0) {
@@ -280,6 +288,575 @@ void test_incremental(zone_t *zone, zs_scanner_t *sc)
 	knot_rdataset_clear(&rrset.rrs, NULL);
 }
 
+static double time_diff_ns(const struct timespec *from, const struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1e9 + (to->tv_nsec - from->tv_nsec);
+}
+
+static int add_a_rr(zone_contents_t *contents, apply_ctx_t *ctx, const char *owner)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc(owner);
+	const uint8_t addr[4] = { 192, 0, 2, 1 };
+	knot_rrset_t rr;
+	knot_rrset_init(&rr, name, KNOT_RRTYPE_A, KNOT_CLASS_IN);
+	int ret = knot_rrset_add_rdata(&rr, addr, sizeof(addr), 3600, NULL);
+	if (ret == KNOT_EOK) {
+		if (ctx != NULL) {
+			ret = apply_add_rr(ctx, &rr);
+		} else {
+			zone_node_t *node = NULL;
+			ret = zone_contents_add_rr(contents, &rr, &node);
+		}
+	}
+	knot_rrset_clear(&rr, NULL);
+
+	return ret;
+}
+
+static char nsec3_owner[KNOT_DNAME_TXT_MAXLEN + 1];
+
+static int rr_str(zs_scanner_t *sc, zone_contents_t *contents, apply_ctx_t *ctx,
+                  const char *str, bool add)
+{
+	/* The NSEC3 owner of the h1 node is substituted. */
+	char buf[256];
+	if (strstr(str, "%s") != NULL) {
+		snprintf(buf, sizeof(buf), str, nsec3_owner);
+		str = buf;
+	}
+
+	if (zs_set_input_string(sc, str, strlen(str)) != 0 ||
+	    zs_parse_all(sc) != 0) {
+		return KNOT_EPARSEFAIL;
+	}
+
+	zone_node_t *node = NULL;
+	int ret = (ctx == NULL) ? zone_contents_add_rr(contents, &rrset, &node) :
+	          add ? apply_add_rr(ctx, &rrset) : apply_remove_rr(ctx, &rrset);
+	knot_rdataset_clear(&rrset.rrs, NULL);
+
+	return ret;
+}
+
+static int copy_node(zone_node_t *node, void *data)
+{
+	zone_contents_t *copy = data;
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		knot_rrset_t rr = node_rrset_at(node, i);
+		zone_node_t *n = NULL;
+		int ret = zone_contents_add_rr(copy, &rr, &n);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static zone_node_t *get_node(zone_tree_t *tree, const zone_node_t *node)
+{
+	zone_node_t *found = NULL;
+	if (node != NULL) {
+		(void)zone_tree_get(tree, node->owner, &found);
+	}
+
+	return found;
+}
+
+/*! \brief Checks pointers to the current nodes with the same owners as in ref. */
+static bool same_node(zone_tree_t *tree, const zone_node_t *node,
+                      const zone_node_t *ref)
+{
+	if (node == NULL || ref == NULL) {
+		return node == ref;
+	}
+
+	return knot_dname_is_equal(node->owner, ref->owner) &&
+	       binode_node(node, false) == binode_node(get_node(tree, node), false);
+}
+
+static bool same_adjusting(zone_contents_t *contents, zone_tree_t *tree,
+                           const zone_node_t *node, const zone_node_t *ref)
+{
+	const uint8_t mask = NODE_FLAGS_DELEG | NODE_FLAGS_NONAUTH |
+	                     NODE_FLAGS_WILDCARD_CHILD;
+	if (node == NULL || (node->flags & mask) != (ref->flags & mask) ||
+	    !same_node(tree, node->prev, ref->prev) ||
+	    !same_node(contents->nsec3_nodes, node->nsec3_node, ref->nsec3_node) ||
+	    node->rrset_count != ref->rrset_count) {
+		return false;
+	}
+
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		const additional_t *a = node->rrs[i].additional;
+		const additional_t *b = ref->rrs[i].additional;
+		if ((a != NULL ? a->count : 0) != (b != NULL ? b->count : 0)) {
+			return false;
+		}
+		for (uint16_t j = 0; a != NULL && j < a->count; j++) {
+			if (!same_node(contents->nodes, a->glues[j].node, b->glues[j].node) ||
+			    a->glues[j].optional != b->glues[j].optional ||
+			    a->glues[j].ns_pos != b->glues[j].ns_pos) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool same_tree_adjusting(zone_contents_t *contents, zone_tree_t *tree,
+                                zone_tree_t *ref)
+{
+	if (zone_tree_count(tree) != zone_tree_count(ref)) {
+		return false;
+	}
+
+	bool same = true;
+	zone_tree_it_t it = { 0 };
+	(void)zone_tree_it_begin(ref, &it);
+	for (; !zone_tree_it_finished(&it) && same; zone_tree_it_next(&it)) {
+		const zone_node_t *ref_node = zone_tree_it_val(&it);
+		same = same_adjusting(contents, tree, get_node(tree, ref_node), ref_node);
+	}
+	zone_tree_it_free(&it);
+
+	return same;
+}
+
+/*! \brief Compares incrementally adjusted contents with a fully adjusted copy. */
+static bool same_as_full_adjust(zone_contents_t *contents)
+{
+	zone_contents_t *ref = zone_contents_new(contents->apex->owner, false);
+	bool same = ref != NULL &&
+	            zone_contents_apply(contents, copy_node, ref) == KNOT_EOK &&
+	            zone_contents_nsec3_apply(contents, copy_node, ref) == KNOT_EOK &&
+	            zone_contents_adjust_full(ref) == KNOT_EOK &&
+	            contents->size == ref->size &&
+	            same_tree_adjusting(contents, contents->nodes, ref->nodes) &&
+	            same_tree_adjusting(contents, contents->nsec3_nodes, ref->nsec3_nodes);
+	zone_contents_deep_free(&ref);
+
+	return same;
+}
+
+#define NSEC3_RDATA "1 0 0 - 0P9MHAVEQVM6T7VBL5LOP2U3T2RP3TOM A"
+
+static const char *adjust_zone[] = {
+	"test. IN NS ns1.test.\n",
+	"test. IN NS ns2.test.\n",
+	"test. IN NSEC3PARAM 1 0 0 -\n",
+	"ns1.test. IN A 192.0.2.1\n",
+	"ns2.test. IN A 192.0.2.2\n",
+	"mx.test. IN MX 10 mail.test.\n",
+	"sub.test. IN NS ns.sub.test.\n",
+	"ns.sub.test. IN A 192.0.2.3\n",
+	"cut.test. IN TXT \"cut\"\n",
+	"a.cut.test. IN A 192.0.2.4\n",
+	"b.cut.test. IN MX 10 a.cut.test.\n",
+	"0p9mhaveqvm6t7vbl5lop2u3t2rp3tom.test. IN NSEC3 " NSEC3_RDATA "\n",
+	"7tf2s5c5p8qjjc1n1p0j7o6ja8j1t8ba.test. IN NSEC3 " NSEC3_RDATA "\n",
+	"%s IN NSEC3 " NSEC3_RDATA "\n",
+};
+
+/*! \brief Changes, the removed RRs prefixed with '-'. */
+static const struct {
+	const char *name;
+	bool incremental;
+	const char *rrs[4];
+} adjust_changes[] = {
+	{ "new additional target", true,
+	  { "mail.test. IN A 192.0.2.5\n" } },
+	{ "removed additional target", true,
+	  { "-ns2.test. IN A 192.0.2.2\n" } },
+	{ "new zone cut", true,
+	  { "cut.test. IN NS a.cut.test.\n" } },
+	{ "removed zone cut", true,
+	  { "-cut.test. IN NS a.cut.test.\n" } },
+	{ "replaced nodes", true,
+	  { "-h5.test. IN A 192.0.2.1\n", "h5x.test. IN A 192.0.2.1\n",
+	    "-7tf2s5c5p8qjjc1n1p0j7o6ja8j1t8ba.test. IN NSEC3 " NSEC3_RDATA "\n",
+	    "7tf2s5c5p8qjjc1n1p0j7o6ja8j1t8ba.test. IN NSEC3 " NSEC3_RDATA " MX\n" } },
+	{ "replaced linked NSEC3 node", true,
+	  { "-%s IN NSEC3 " NSEC3_RDATA "\n", "%s IN NSEC3 " NSEC3_RDATA " MX\n" } },
+	{ "new NSEC3 node", false,
+	  { "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa.test. IN NSEC3 " NSEC3_RDATA "\n" } },
+	{ "new empty non-terminal", true,
+	  { "x.y.test. IN A 192.0.2.6\n", "ns2.test. IN A 192.0.2.2\n" } },
+	{ "new wildcard", false,
+	  { "*.w.test. IN A 192.0.2.7\n" } },
+	{ "name matching a wildcard", true,
+	  { "h7.test. IN MX 10 foo.w.test.\n" } },
+	{ "removed name matching a wildcard", true,
+	  { "-h7.test. IN MX 10 foo.w.test.\n", "-h8.test. IN A 192.0.2.1\n" } },
+};
+
+static void test_adjust_incremental(zs_scanner_t *sc)
+{
+	knot_dname_t *apex = knot_dname_from_str_alloc("test.");
+	zone_contents_t *contents = zone_contents_new(apex, true);
+
+	/* The NSEC3 owner of h1 is linked from the zone, unlike the others. */
+	knot_dname_t *h1 = knot_dname_from_str_alloc("h1.test.");
+	dnssec_nsec3_params_t params = { .algorithm = 1 };
+	knot_dname_t *h1_nsec3 = knot_create_nsec3_owner(h1, apex, &params);
+	(void)knot_dname_to_str(nsec3_owner, h1_nsec3, sizeof(nsec3_owner));
+	knot_dname_free(&h1_nsec3, NULL);
+	knot_dname_free(&h1, NULL);
+	knot_dname_free(&apex, NULL);
+
+	int ret = rr_str(sc, contents, NULL, zone_str1, true);
+	for (size_t i = 0; i < sizeof(adjust_zone) / sizeof(*adjust_zone) &&
+	                   ret == KNOT_EOK; i++) {
+		ret = rr_str(sc, contents, NULL, adjust_zone[i], true);
+	}
+
+	char owner[64];
+	for (unsigned i = 0; i < 64 && ret == KNOT_EOK; i++) {
+		snprintf(owner, sizeof(owner), "h%u.test.", i);
+		ret = add_a_rr(contents, NULL, owner);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(contents);
+	}
+	ok(ret == KNOT_EOK && same_as_full_adjust(contents),
+	   "incremental adjusting: create zone");
+
+	for (size_t i = 0; i < sizeof(adjust_changes) / sizeof(*adjust_changes) &&
+	                   ret == KNOT_EOK; i++) {
+		zone_contents_t *new_contents = NULL;
+		ret = zone_contents_cow(contents, &new_contents);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+
+		apply_ctx_t ctx;
+		apply_init_ctx(&ctx, new_contents, 0);
+		for (size_t j = 0; j < 4 && adjust_changes[i].rrs[j] != NULL &&
+		                   ret == KNOT_EOK; j++) {
+			const char *str = adjust_changes[i].rrs[j];
+			ret = rr_str(sc, NULL, &ctx, str + (*str == '-'), *str != '-');
+		}
+		if (ret == KNOT_EOK) {
+			ret = apply_finalize(&ctx);
+		}
+		if (ret != KNOT_EOK) {
+			update_rollback(&ctx);
+			update_free_zone(&new_contents);
+			break;
+		}
+
+		bool incremental = (new_contents->cow_adjusted != NULL);
+		ok(incremental == adjust_changes[i].incremental &&
+		   same_as_full_adjust(new_contents),
+		   "incremental adjusting: %s", adjust_changes[i].name);
+
+		zone_contents_cow_commit(new_contents);
+		update_cleanup(&ctx);
+		update_free_zone(&contents);
+		contents = new_contents;
+	}
+	ok(ret == KNOT_EOK, "incremental adjusting: apply changes");
+
+	zone_contents_deep_free(&contents);
+}
+
+#define RRSIG_RDATA(covered, expire) \
+	covered " 8 1 3600 " expire " 1000 12345 test. AAAA\n"
+
+static const char *rrsig_zone[] = {
+	"test. IN NSEC3PARAM 1 0 0 -\n",
+	"a.test. IN A 192.0.2.1\n",
+	"a.test. IN RRSIG " RRSIG_RDATA("A", "1100"),
+	"b.test. IN A 192.0.2.2\n",
+	"b.test. IN TXT \"b\"\n",
+	"b.test. IN RRSIG " RRSIG_RDATA("A", "1300"),
+	"b.test. IN RRSIG " RRSIG_RDATA("TXT", "1200"),
+	"c.test. IN A 192.0.2.3\n",
+	"%s IN NSEC3 " NSEC3_RDATA "\n",
+	"%s IN RRSIG " RRSIG_RDATA("NSEC3", "1150"),
+};
+
+static const char *rrsig_changes[] = {
+	"-a.test. IN RRSIG " RRSIG_RDATA("A", "1100"),
+	"a.test. IN RRSIG " RRSIG_RDATA("A", "1400"),
+	"-b.test. IN A 192.0.2.2\n",
+	"-b.test. IN TXT \"b\"\n",
+	"-b.test. IN RRSIG " RRSIG_RDATA("A", "1300"),
+	"-b.test. IN RRSIG " RRSIG_RDATA("TXT", "1200"),
+	"d.test. IN A 192.0.2.4\n",
+	"d.test. IN RRSIG " RRSIG_RDATA("A", "1120"),
+};
+
+static int print_owner(zone_node_t **node, void *data)
+{
+	char *str = data;
+	size_t len = strlen(str);
+	if (knot_dname_to_str(str + len, (*node)->owner, 255 - len) != NULL) {
+		strcat(str, " ");
+	}
+
+	return KNOT_EOK;
+}
+
+static bool check_expiring(zone_contents_t *contents, knot_time_t until,
+                           size_t limit, const char *expected,
+                           knot_time_t expected_next)
+{
+	char owners[256] = "";
+	char expected_owners[256];
+	snprintf(expected_owners, sizeof(expected_owners), expected, nsec3_owner);
+
+	knot_time_t next = 1;
+	int ret = zone_contents_rrsig_expiring(contents, until, limit, print_owner,
+	                                       owners, &next);
+
+	return ret == KNOT_EOK && next == expected_next &&
+	       strcmp(owners, expected_owners) == 0;
+}
+
+static void test_rrsig_index(zs_scanner_t *sc)
+{
+	knot_dname_t *apex = knot_dname_from_str_alloc("test.");
+	zone_contents_t *contents = zone_contents_new(apex, true);
+	knot_dname_free(&apex, NULL);
+
+	int ret = rr_str(sc, contents, NULL, zone_str1, true);
+	for (size_t i = 0; i < sizeof(rrsig_zone) / sizeof(*rrsig_zone) &&
+	                   ret == KNOT_EOK; i++) {
+		ret = rr_str(sc, contents, NULL, rrsig_zone[i], true);
+	}
+
+	/* Enough unsigned nodes for the changes to be adjusted incrementally. */
+	char owner[64];
+	for (unsigned i = 0; i < 64 && ret == KNOT_EOK; i++) {
+		snprintf(owner, sizeof(owner), "h%u.test.", i);
+		ret = add_a_rr(contents, NULL, owner);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(contents);
+	}
+	ok(ret == KNOT_EOK, "RRSIG index: create zone");
+
+	ok(check_expiring(contents, 1000, 0, "", 1100),
+	   "RRSIG index: nothing expiring");
+	ok(check_expiring(contents, 1150, 0, "a.test. %s ", 1200),
+	   "RRSIG index: expiring nodes ordered");
+	ok(check_expiring(contents, 1200, 0, "a.test. %s b.test. ", 0),
+	   "RRSIG index: earliest expiration of a node");
+	ok(check_expiring(contents, 1200, 2, "a.test. %s ", 1200),
+	   "RRSIG index: limited number of nodes");
+
+	zone_contents_t *new_contents = NULL;
+	ret = zone_contents_cow(contents, &new_contents);
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&contents);
+		return;
+	}
+
+	apply_ctx_t ctx;
+	apply_init_ctx(&ctx, new_contents, 0);
+	for (size_t i = 0; i < sizeof(rrsig_changes) / sizeof(*rrsig_changes) &&
+	                   ret == KNOT_EOK; i++) {
+		const char *str = rrsig_changes[i];
+		ret = rr_str(sc, NULL, &ctx, str + (*str == '-'), *str != '-');
+	}
+	if (ret == KNOT_EOK) {
+		ret = apply_finalize(&ctx);
+	}
+	ok(ret == KNOT_EOK && new_contents->cow_adjusted != NULL,
+	   "RRSIG index: incremental update");
+	if (ret != KNOT_EOK) {
+		update_rollback(&ctx);
+		update_free_zone(&new_contents);
+		zone_contents_deep_free(&contents);
+		return;
+	}
+
+	zone_contents_cow_commit(new_contents);
+	update_cleanup(&ctx);
+	update_free_zone(&contents);
+	contents = new_contents;
+
+	ok(check_expiring(contents, 1130, 0, "d.test. ", 1150),
+	   "RRSIG index: added node");
+	ok(check_expiring(contents, 2000, 0, "d.test. %s a.test. ", 0),
+	   "RRSIG index: changed and removed nodes");
+
+	zone_contents_deep_free(&contents);
+}
+
+/*!
+ * \brief Measure the latency of a single-record update of a zone with
+ *        \a count nodes, using either the full or copy-on-write zone copy.
+ */
+static void test_update_latency(zs_scanner_t *sc, unsigned count)
+{
+	const unsigned rounds = 10;
+
+	knot_dname_t *apex = knot_dname_from_str_alloc("test.");
+	zone_contents_t *contents = zone_contents_new(apex, true);
+	knot_dname_free(&apex, NULL);
+
+	if (zs_set_input_string(sc, zone_str1, strlen(zone_str1)) != 0 ||
+	    zs_parse_all(sc) != 0) {
+		assert(0);
+	}
+	zone_node_t *node = NULL;
+	int ret = zone_contents_add_rr(contents, &rrset, &node);
+	knot_rdataset_clear(&rrset.rrs, NULL);
+
+	char owner[64];
+	for (unsigned i = 0; i < count && ret == KNOT_EOK; i++) {
+		snprintf(owner, sizeof(owner), "n%u.test.", i);
+		ret = add_a_rr(contents, NULL, owner);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(contents);
+	}
+	if (ret != KNOT_EOK) {
+		ok(0, "zone update latency: create zone with %u nodes", count);
+		zone_contents_deep_free(&contents);
+		return;
+	}
+
+	for (int cow = 0; cow <= 1; cow++) {
+		struct timespec begin, end;
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		for (unsigned r = 0; r < rounds && ret == KNOT_EOK; r++) {
+			zone_contents_t *new_contents = NULL;
+			ret = cow ? zone_contents_cow(contents, &new_contents) :
+			            zone_contents_shallow_copy(contents, &new_contents);
+			if (ret != KNOT_EOK) {
+				break;
+			}
+
+			apply_ctx_t ctx;
+			apply_init_ctx(&ctx, new_contents, 0);
+			snprintf(owner, sizeof(owner), "u%u-%d.test.", r, cow);
+			ret = add_a_rr(NULL, &ctx, owner);
+			if (ret == KNOT_EOK) {
+				ret = apply_finalize(&ctx);
+			}
+			if (ret != KNOT_EOK) {
+				update_rollback(&ctx);
+				update_free_zone(&new_contents);
+				break;
+			}
+
+			if (cow) {
+				zone_contents_cow_commit(new_contents);
+			}
+			update_cleanup(&ctx);
+			update_free_zone(&contents);
+			contents = new_contents;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		ok(ret == KNOT_EOK, "zone update latency: %u nodes, %s, %.0f us per update",
+		   count, cow ? "copy-on-write" : "full copy",
+		   time_diff_ns(&begin, &end) / rounds / 1000);
+	}
+
+	zone_contents_deep_free(&contents);
+}
+
+#define READER_HOLD_MS	200	/*!< Read-side section of the slow reader. */
+
+/*! \brief Holds the RCU read lock like an outgoing zone transfer. */
+static void *slow_reader(void *arg)
+{
+	volatile bool *stop = arg;
+
+	rcu_register_thread();
+	while (!*stop) {
+		rcu_read_lock();
+		usleep(READER_HOLD_MS * 1000);
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+
+	return NULL;
+}
+
+/*!
+ * \brief Check that committing a copy-on-write update doesn't wait for
+ *        the readers of the old zone version.
+ */
+static void test_commit_latency(zone_t *zone, zs_scanner_t *sc)
+{
+	const unsigned rounds = 5;
+
+	knot_dname_t *apex = knot_dname_from_str_alloc("test.");
+	zone_contents_t *contents = zone_contents_new(apex, true);
+	knot_dname_free(&apex, NULL);
+
+	if (zs_set_input_string(sc, zone_str1, strlen(zone_str1)) != 0 ||
+	    zs_parse_all(sc) != 0) {
+		assert(0);
+	}
+	zone_node_t *node = NULL;
+	int ret = zone_contents_add_rr(contents, &rrset, &node);
+	knot_rdataset_clear(&rrset.rrs, NULL);
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(contents);
+	}
+	zone_contents_t *orig = zone_switch_contents(zone, contents);
+
+	volatile bool stop = false;
+	pthread_t reader;
+	pthread_create(&reader, NULL, slow_reader, (void *)&stop);
+
+	double max_switch = 0, total = 0;
+	char owner[64];
+	for (unsigned r = 0; r < rounds && ret == KNOT_EOK; r++) {
+		struct timespec begin, switched, end;
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+
+		zone_contents_t *new_contents = NULL;
+		ret = zone_contents_cow(zone->contents, &new_contents);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+
+		apply_ctx_t ctx;
+		apply_init_ctx(&ctx, new_contents, 0);
+		snprintf(owner, sizeof(owner), "c%u.test.", r);
+		ret = add_a_rr(NULL, &ctx, owner);
+		if (ret == KNOT_EOK) {
+			ret = apply_finalize(&ctx);
+		}
+		if (ret != KNOT_EOK) {
+			update_rollback(&ctx);
+			update_free_zone(&new_contents);
+			break;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &switched);
+		zone_contents_t *old = zone_switch_contents(zone, new_contents);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		ok(old == NULL, "zone commit latency: old version released with the commit");
+
+		synchronize_rcu();
+		update_cleanup(&ctx);
+
+		max_switch = MAX(max_switch, time_diff_ns(&switched, &end));
+		total += time_diff_ns(&begin, &end);
+	}
+
+	stop = true;
+	pthread_join(reader, NULL);
+
+	ok(ret == KNOT_EOK && max_switch < READER_HOLD_MS * 1e6 / 2,
+	   "zone commit latency: %.0f us max switch, %.0f us per update, "
+	   "reader holding %u ms", max_switch / 1000, total / rounds / 1000,
+	   READER_HOLD_MS);
+
+	contents = zone_switch_contents(zone, orig);
+	synchronize_rcu();
+	zone_contents_deep_free(&contents);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -322,6 +899,20 @@ int main(int argc, char *argv[])
 	test_full(zone, &sc);
 	test_incremental(zone, &sc);
 
+	/* Compare incremental and full adjusting */
+	test_adjust_incremental(&sc);
+
+	/* Check the RRSIG expiration index */
+	test_rrsig_index(&sc);
+
+	/* Compare update latency of the full and copy-on-write zone copy */
+	test_update_latency(&sc, 1000);
+	test_update_latency(&sc, 10000);
+	test_update_latency(&sc, 100000);
+
+	/* Commit while the old version is being read */
+	test_commit_latency(zone, &sc);
+
 	zs_deinit(&sc);
 	zone_free(&zone);
 	server_deinit(&server);
@@ -14,6 +14,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
+#include <time.h>
 #include <tap/basic.h>
 
 #include "knot/zone/zone.h"
@@ -35,9 +37,78 @@ static const char *zone_list[ZONE_COUNT] = {
         "b.b.b.b.net",
 };
 
+#define BENCH_POOL 1024
+
+/*! \brief Zone name of the given index, TLD-style and deeper delegations mixed. */
+static knot_dname_t *bench_name(knot_dname_t *buf, const char *prefix, unsigned i)
+{
+	static const char *parents[] = { "", "com.", "co.uk.", "a.b.c.d.e.f.net." };
+
+	char str[KNOT_DNAME_TXT_MAXLEN];
+	(void)snprintf(str, sizeof(str), "%sz%u.%s", prefix, i, parents[i % 4]);
+	return knot_dname_from_str(buf, str, KNOT_DNAME_MAXLEN);
+}
+
+static double time_diff_ns(const struct timespec *from, const struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1e9 + (to->tv_nsec - from->tv_nsec);
+}
+
+/*!
+ * \brief Measure the closest zone lookup among \a count zones.
+ *
+ * Only the zone name is needed for indexing, so a small pool of zone
+ * structures is reused to keep the memory footprint low.
+ */
+static void bench_find_suffix(unsigned count)
+{
+	const unsigned rounds = 1000000;
+	const unsigned queries = 4096;
+
+	zone_t *pool = calloc(BENCH_POOL, sizeof(*pool));
+	knot_dname_t *qnames = malloc(queries * KNOT_DNAME_MAXLEN);
+	knot_zonedb_t *db = knot_zonedb_new(count);
+	if (pool == NULL || qnames == NULL || db == NULL) {
+		skip("zonedb: bench %u zones, not enough memory", count);
+		goto cleanup;
+	}
+
+	knot_dname_t name[KNOT_DNAME_MAXLEN];
+	for (unsigned i = 0; i < count; ++i) {
+		pool[i % BENCH_POOL].name = bench_name(name, "", i);
+		if (knot_zonedb_insert(db, &pool[i % BENCH_POOL]) != KNOT_EOK) {
+			skip("zonedb: bench %u zones, insertion failed", count);
+			goto cleanup;
+		}
+	}
+
+	for (unsigned i = 0; i < queries; ++i) {
+		bench_name(qnames + i * KNOT_DNAME_MAXLEN, "www.x.", (i * 7919) % count);
+	}
+
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	unsigned found = 0;
+	for (unsigned r = 0; r < rounds; ++r) {
+		unsigned i = r % queries;
+		zone_t *zone = knot_zonedb_find_suffix(db, qnames + i * KNOT_DNAME_MAXLEN);
+		found += (zone == &pool[((i * 7919) % count) % BENCH_POOL]);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ok(found == rounds && knot_zonedb_size(db) == count,
+	   "zonedb: bench %u zones, %.1f ns per lookup", count,
+	   time_diff_ns(&begin, &end) / rounds);
+
+cleanup:
+	knot_zonedb_free(&db);
+	free(qnames);
+	free(pool);
+}
+
 int main(int argc, char *argv[])
 {
-	plan(6);
+	plan(9);
 
 	/* Create database. */
 	char buf[KNOT_DNAME_MAXLEN];
@@ -65,9 +136,6 @@ int main(int argc, char *argv[])
 	}
 	ok(nr_passed == ZONE_COUNT, "zonedb: add zones");
 
-	/* Build search index. */
-	ok(knot_zonedb_build_index(db) == KNOT_EOK, "zonedb: build search index");
-
 	/* Lookup of exact names. */
 	nr_passed = 0;
 	for (unsigned i = 0; i < ZONE_COUNT; ++i) {
@@ -98,6 +166,20 @@ int main(int argc, char *argv[])
 	}
 	ok(nr_passed == ZONE_COUNT, "zonedb: find zones for subnames");
 
+	/* Walk all zones. */
+	nr_passed = 0;
+	zone_t *zone = knot_zonedb_find_next(db, NULL);
+	while (zone != NULL && nr_passed < ZONE_COUNT) {
+		++nr_passed;
+		zone = knot_zonedb_find_next(db, zone->name);
+	}
+	/* Resume after a name not in the database. */
+	dname = knot_dname_from_str_alloc("b.com");
+	zone_t *next = knot_zonedb_find_next(db, dname);
+	knot_dname_free(&dname, NULL);
+	ok(nr_passed == ZONE_COUNT && zone == NULL && next == zones[8],
+	   "zonedb: walk all zones");
+
 	/* Remove all zones. */
 	nr_passed = 0;
 	for (unsigned i = 0; i < ZONE_COUNT; ++i) {
@@ -114,5 +196,11 @@ int main(int argc, char *argv[])
 
 cleanup:
 	knot_zonedb_deep_free(&db);
+
+	/* Lookup performance. */
+	bench_find_suffix(1);
+	bench_find_suffix(1000);
+	bench_find_suffix(1000000);
+
 	return 0;
 }